@@ -137,8 +137,13 @@ static int check_key_size(size_t keylen, const char *alg_name,
 	return 0;
 }
 
-int cryptodev_cipher_init(struct cipher_data *out, const char *alg_name,
-				uint8_t *keyp, size_t keylen, int stream, int aead)
+/*
+ * Like cryptodev_cipher_init(), @mask is passed to the tfm allocation, e.g.
+ * CRYPTO_ALG_ASYNC to get a synchronous (CPU) implementation.
+ */
+int cryptodev_cipher_init_mask(struct cipher_data *out, const char *alg_name,
+			       uint8_t *keyp, size_t keylen, int stream, int aead,
+			       u32 mask)
 {
 	int ret;
 
@@ -150,7 +155,7 @@ int cryptodev_cipher_init(struct cipher_data *out, const char *alg_name,
 		struct ablkcipher_alg *alg;
 #endif
 
-		out->async.s = cryptodev_crypto_alloc_blkcipher(alg_name, 0, 0);
+		out->async.s = cryptodev_crypto_alloc_blkcipher(alg_name, 0, mask);
 		if (unlikely(IS_ERR(out->async.s))) {
 			ddebug(1, "Failed to load cipher %s", alg_name);
 			return PTR_ERR(out->async.s);
@@ -194,7 +199,7 @@ int cryptodev_cipher_init(struct cipher_data *out, const char *alg_name,
 
 		ret = cryptodev_crypto_blkcipher_setkey(out->async.s, keyp, keylen);
 	} else {
-		out->async.as = crypto_alloc_aead(alg_name, 0, 0);
+		out->async.as = crypto_alloc_aead(alg_name, 0, mask);
 		if (unlikely(IS_ERR(out->async.as))) {
 			ddebug(1, "Failed to load cipher %s", alg_name);
 			return PTR_ERR(out->async.as);
@@ -258,6 +263,13 @@ int cryptodev_cipher_init(struct cipher_data *out, const char *alg_name,
 	return ret;
 }
 
+int cryptodev_cipher_init(struct cipher_data *out, const char *alg_name,
+				uint8_t *keyp, size_t keylen, int stream, int aead)
+{
+	return cryptodev_cipher_init_mask(out, alg_name, keyp, keylen,
+					  stream, aead, 0);
+}
+
 void cryptodev_cipher_deinit(struct cipher_data *cdata)
 {
 	if (cdata->init) {
@@ -35,6 +35,9 @@ struct cipher_data {
 
 int cryptodev_cipher_init(struct cipher_data *out, const char *alg_name,
 			  uint8_t *key, size_t keylen, int stream, int aead);
+int cryptodev_cipher_init_mask(struct cipher_data *out, const char *alg_name,
+			       uint8_t *key, size_t keylen, int stream, int aead,
+			       u32 mask);
 void cryptodev_cipher_deinit(struct cipher_data *cdata);
 int cryptodev_get_cipher_key(uint8_t *key, struct session_op *sop, int aead);
 int cryptodev_get_cipher_keylen(unsigned int *keylen, struct session_op *sop,
@@ -161,6 +161,8 @@ struct csession {
 	struct list_head entry;
 	struct mutex sem;
 	struct cipher_data cdata;
+	/* CPU implementation of cdata, for small requests */
+	struct cipher_data cpu_cdata;
 	struct hash_data hdata;
 	uint32_t sid;
 	uint32_t alignmask;
@@ -112,6 +112,7 @@ crypto_create_session(struct fcrypt *fcr, struct session_op *sop)
 	int ret = 0;
 	const char *alg_name = NULL;
 	const char *hash_name = NULL;
+	const char *cpu_name;
 	int hmac_mode = 1, stream = 0, aead = 0;
 	/*
 	 * With composite aead ciphers, only ckey is used and it can cover all the
@@ -279,6 +280,13 @@ crypto_create_session(struct fcrypt *fcr, struct session_op *sop)
 			ddebug(1, "Failed to load cipher for %s", alg_name);
 			goto session_error;
 		}
+
+		/* optional, lets rk_cryptodev route small requests to the CPU */
+		cpu_name = rk_get_cipher_cpu_name(sop->cipher);
+		if (cpu_name && !aead && !hash_name &&
+		    cryptodev_cipher_init_mask(&ses_new->cpu_cdata, cpu_name, keys.ckey,
+					       keylen, stream, aead, CRYPTO_ALG_ASYNC) < 0)
+			ddebug(2, "no cpu cipher for %s", cpu_name);
 	}
 
 	if (hash_name && aead == 0) {
@@ -365,6 +373,7 @@ crypto_create_session(struct fcrypt *fcr, struct session_op *sop)
 session_error:
 	cryptodev_hash_deinit(&ses_new->hdata);
 	cryptodev_cipher_deinit(&ses_new->cdata);
+	cryptodev_cipher_deinit(&ses_new->cpu_cdata);
 	kfree(ses_new->sg);
 	kfree(ses_new->pages);
 	kfree(ses_new);
@@ -389,6 +398,7 @@ crypto_destroy_session(struct csession *ses_ptr)
 	}
 
 	cryptodev_cipher_deinit(&ses_ptr->cdata);
+	cryptodev_cipher_deinit(&ses_ptr->cpu_cdata);
 	cryptodev_hash_deinit(&ses_ptr->hdata);
 	ddebug(2, "freeing space for %d user pages", ses_ptr->array_size);
 	kfree(ses_ptr->pages);
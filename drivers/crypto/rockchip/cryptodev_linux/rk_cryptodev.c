@@ -17,6 +17,11 @@
 #include <linux/dma-direct.h>
 #include <linux/dma-buf.h>
 #include <linux/list.h>
+#include <linux/moduleparam.h>
+#include <linux/sizes.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+#include <linux/timekeeping.h>
 
 #include "version.h"
 #include "cipherapi.h"
@@ -192,9 +197,9 @@ static int kcop_fd_to_user(struct kernel_crypt_fd_op *kcop,
 }
 
 static int
-hash_n_crypt_fd(struct csession *ses_ptr, struct crypt_fd_op *cop,
-		struct scatterlist *src_sg, struct scatterlist *dst_sg,
-		uint32_t len)
+hash_n_crypt_fd(struct csession *ses_ptr, struct cipher_data *cdata,
+		struct crypt_fd_op *cop, struct scatterlist *src_sg,
+		struct scatterlist *dst_sg, uint32_t len)
 {
 	int ret;
 
@@ -209,7 +214,7 @@ hash_n_crypt_fd(struct csession *ses_ptr, struct crypt_fd_op *cop,
 				goto out_err;
 		}
 		if (ses_ptr->cdata.init != 0) {
-			ret = cryptodev_cipher_encrypt(&ses_ptr->cdata,
+			ret = cryptodev_cipher_encrypt(cdata,
 						       src_sg, dst_sg, len);
 
 			if (unlikely(ret))
@@ -217,7 +222,7 @@ hash_n_crypt_fd(struct csession *ses_ptr, struct crypt_fd_op *cop,
 		}
 	} else {
 		if (ses_ptr->cdata.init != 0) {
-			ret = cryptodev_cipher_decrypt(&ses_ptr->cdata,
+			ret = cryptodev_cipher_decrypt(cdata,
 						       src_sg, dst_sg, len);
 
 			if (unlikely(ret))
@@ -338,9 +343,130 @@ static struct dma_fd_map_node *dma_fd_find_node(struct fcrypt *fcr, int dma_fd)
 	return NULL;
 }
 
+/*
+ * CPU/engine routing of dma-fd cipher requests.
+ *
+ * Sessions that have a CPU implementation next to the engine one send
+ * requests up to route_threshold bytes to the CPU, and requests up to four
+ * times that when route_qdepth requests are already on the engine. With
+ * route_auto the threshold follows the measured cost of both paths for
+ * requests close to it; one in ROUTE_PROBE_INTERVAL of those is sent the
+ * other way so that both costs stay current.
+ */
+#define ROUTE_THRESHOLD_MIN	256
+#define ROUTE_THRESHOLD_MAX	SZ_1M
+#define ROUTE_PROBE_INTERVAL	32
+
+enum {
+	ROUTE_ENGINE,
+	ROUTE_CPU,
+	ROUTE_NR,
+};
+
+struct route_path {
+	atomic64_t ops;
+	atomic64_t bytes;
+	/* ns per KiB near the threshold, 1/8 weighted moving average */
+	u64 ns_per_kb;
+};
+
+static unsigned int route_threshold = 2048;
+module_param(route_threshold, uint, 0644);
+MODULE_PARM_DESC(route_threshold, "Largest request in bytes sent to the CPU, 0 for engine only");
+
+static bool route_auto = true;
+module_param(route_auto, bool, 0644);
+MODULE_PARM_DESC(route_auto, "Tune route_threshold from the measured cost of both paths");
+
+static unsigned int route_qdepth = 4;
+module_param(route_qdepth, uint, 0644);
+MODULE_PARM_DESC(route_qdepth, "Engine requests in flight above which mid size requests go to the CPU");
+
+static struct route_path route_paths[ROUTE_NR];
+static atomic_t route_engine_inflight = ATOMIC_INIT(0);
+static atomic_t route_probe = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(route_lock);
+
+static int route_stats_get(char *buf, const struct kernel_param *kp)
+{
+	return sysfs_emit(buf, "engine %lld ops %lld bytes, cpu %lld ops %lld bytes, inflight %d\n",
+			  atomic64_read(&route_paths[ROUTE_ENGINE].ops),
+			  atomic64_read(&route_paths[ROUTE_ENGINE].bytes),
+			  atomic64_read(&route_paths[ROUTE_CPU].ops),
+			  atomic64_read(&route_paths[ROUTE_CPU].bytes),
+			  atomic_read(&route_engine_inflight));
+}
+
+static const struct kernel_param_ops route_stats_ops = {
+	.get = route_stats_get,
+};
+module_param_cb(route_stats, &route_stats_ops, NULL, 0444);
+MODULE_PARM_DESC(route_stats, "Requests and bytes per path");
+
+static bool route_near_threshold(u32 len, unsigned int threshold)
+{
+	return len >= threshold / 2 && len <= threshold * 2;
+}
+
+static int route_pick(struct csession *ses_ptr, u32 len)
+{
+	unsigned int threshold = READ_ONCE(route_threshold);
+	int path;
+
+	if (!ses_ptr->cpu_cdata.init || !threshold)
+		return ROUTE_ENGINE;
+
+	if (len <= threshold)
+		path = ROUTE_CPU;
+	else if (len <= threshold * 4 &&
+		 atomic_read(&route_engine_inflight) >= READ_ONCE(route_qdepth))
+		path = ROUTE_CPU;
+	else
+		path = ROUTE_ENGINE;
+
+	if (READ_ONCE(route_auto) && route_near_threshold(len, threshold) &&
+	    !(atomic_inc_return(&route_probe) % ROUTE_PROBE_INTERVAL))
+		path = path == ROUTE_CPU ? ROUTE_ENGINE : ROUTE_CPU;
+
+	return path;
+}
+
+static void route_account(int path, u32 len, u64 ns)
+{
+	struct route_path *rp = &route_paths[path];
+	unsigned int threshold;
+	u64 cost, cpu, engine;
+
+	atomic64_inc(&rp->ops);
+	atomic64_add(len, &rp->bytes);
+
+	threshold = READ_ONCE(route_threshold);
+	if (!READ_ONCE(route_auto) || !threshold || !len ||
+	    !route_near_threshold(len, threshold))
+		return;
+
+	cost = div_u64(ns * SZ_1K, len);
+
+	spin_lock(&route_lock);
+	rp->ns_per_kb = rp->ns_per_kb ? rp->ns_per_kb - (rp->ns_per_kb >> 3) + (cost >> 3) : cost;
+
+	cpu = route_paths[ROUTE_CPU].ns_per_kb;
+	engine = route_paths[ROUTE_ENGINE].ns_per_kb;
+	if (cpu && engine) {
+		if (cpu * 8 < engine * 7)
+			threshold += threshold / 8;
+		else if (cpu * 8 > engine * 9)
+			threshold -= threshold / 8;
+		WRITE_ONCE(route_threshold,
+			   clamp_t(unsigned int, threshold, ROUTE_THRESHOLD_MIN,
+				   ROUTE_THRESHOLD_MAX));
+	}
+	spin_unlock(&route_lock);
+}
+
 /* This is the main crypto function - zero-copy edition */
 static int __crypto_fd_run(struct fcrypt *fcr, struct csession *ses_ptr,
-			   struct kernel_crypt_fd_op *kcop)
+			   struct cipher_data *cdata, struct kernel_crypt_fd_op *kcop)
 {
 	struct crypt_fd_op *cop = &kcop->cop;
 	struct dma_buf *dma_buf_in = NULL, *dma_buf_out = NULL;
@@ -380,7 +506,7 @@ static int __crypto_fd_run(struct fcrypt *fcr, struct csession *ses_ptr,
 		sg_tbl_out = &sg_tmp;
 	}
 
-	ret = hash_n_crypt_fd(ses_ptr, cop, sg_tbl_in->sgl, sg_tbl_out->sgl, cop->len);
+	ret = hash_n_crypt_fd(ses_ptr, cdata, cop, sg_tbl_in->sgl, sg_tbl_out->sgl, cop->len);
 
 exit:
 	if (dma_buf_in)
@@ -397,7 +523,10 @@ static int crypto_fd_run(struct fcrypt *fcr, struct kernel_crypt_fd_op *kcop)
 {
 	struct csession *ses_ptr;
 	struct crypt_fd_op *cop = &kcop->cop;
+	struct cipher_data *cdata;
 	int ret = -EINVAL;
+	int path;
+	u64 start;
 
 	if (unlikely(cop->op != COP_ENCRYPT && cop->op != COP_DECRYPT)) {
 		ddebug(1, "invalid operation op=%u", cop->op);
@@ -419,6 +548,9 @@ static int crypto_fd_run(struct fcrypt *fcr, struct kernel_crypt_fd_op *kcop)
 		}
 	}
 
+	path = route_pick(ses_ptr, cop->len);
+	cdata = path == ROUTE_CPU ? &ses_ptr->cpu_cdata : &ses_ptr->cdata;
+
 	if (ses_ptr->cdata.init != 0) {
 		int blocksize = ses_ptr->cdata.blocksize;
 
@@ -429,18 +561,27 @@ static int crypto_fd_run(struct fcrypt *fcr, struct kernel_crypt_fd_op *kcop)
 			goto out_unlock;
 		}
 
-		cryptodev_cipher_set_iv(&ses_ptr->cdata, kcop->iv,
+		cryptodev_cipher_set_iv(cdata, kcop->iv,
 					min(ses_ptr->cdata.ivsize, kcop->ivlen));
 	}
 
 	if (likely(cop->len)) {
-		ret = __crypto_fd_run(fcr, ses_ptr, kcop);
+		start = ktime_get_ns();
+		if (path == ROUTE_ENGINE)
+			atomic_inc(&route_engine_inflight);
+
+		ret = __crypto_fd_run(fcr, ses_ptr, cdata, kcop);
+
+		if (path == ROUTE_ENGINE)
+			atomic_dec(&route_engine_inflight);
 		if (unlikely(ret))
 			goto out_unlock;
+
+		route_account(path, cop->len, ktime_get_ns() - start);
 	}
 
 	if (ses_ptr->cdata.init != 0) {
-		cryptodev_cipher_get_iv(&ses_ptr->cdata, kcop->iv,
+		cryptodev_cipher_get_iv(cdata, kcop->iv,
 					min(ses_ptr->cdata.ivsize, kcop->ivlen));
 	}
 
@@ -462,6 +603,287 @@ static int crypto_fd_run(struct fcrypt *fcr, struct kernel_crypt_fd_op *kcop)
 	return ret;
 }
 
+struct batch_fd_map {
+	int fd;
+	struct sg_table *sgtbl;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *dma_attach;
+};
+
+struct batch_req {
+	cryptodev_blkcipher_request_t *req;
+	struct sg_table src;
+	struct sg_table dst;
+	struct crypt_fd_batch_range *range;
+	struct batch_ctx *ctx;
+	__u8 iv[EALG_MAX_BLOCK_LEN];
+};
+
+struct batch_ctx {
+	atomic_t pending;
+	struct completion done;
+	/* every distinct dma fd of the batch is attached once */
+	struct batch_fd_map maps[RK_CRYPT_BATCH_MAX * 2];
+	int nr_maps;
+	struct batch_req reqs[RK_CRYPT_BATCH_MAX];
+};
+
+static struct sg_table *batch_get_fd(struct fcrypt *fcr, struct batch_ctx *ctx, int fd)
+{
+	struct dma_fd_map_node *node;
+	struct batch_fd_map *map;
+	int i, ret;
+
+	for (i = 0; i < ctx->nr_maps; i++) {
+		if (ctx->maps[i].fd == fd)
+			return ctx->maps[i].sgtbl;
+	}
+
+	/* mapped with RIOCCRYPT_FD_MAP, nothing to attach */
+	node = dma_fd_find_node(fcr, fd);
+	if (node)
+		return node->sgtbl;
+
+	map = &ctx->maps[ctx->nr_maps];
+	ret = get_dmafd_sgtbl(fd, 0, DMA_BIDIRECTIONAL,
+			      &map->sgtbl, &map->dma_attach, &map->dmabuf);
+	if (unlikely(ret))
+		return ERR_PTR(ret);
+
+	map->fd = fd;
+	ctx->nr_maps++;
+
+	return map->sgtbl;
+}
+
+static void batch_put_fds(struct batch_ctx *ctx)
+{
+	struct batch_fd_map *map;
+	int i;
+
+	for (i = 0; i < ctx->nr_maps; i++) {
+		map = &ctx->maps[i];
+		put_dmafd_sgtbl(map->fd, DMA_BIDIRECTIONAL,
+				map->sgtbl, map->dma_attach, map->dmabuf);
+	}
+	ctx->nr_maps = 0;
+}
+
+/* build a page based scatterlist of [offset, offset + len) of a dma-buf */
+static int batch_sg_range(struct sg_table *out, struct sg_table *sgt,
+			  u32 offset, u32 len)
+{
+	u64 start = offset, end = (u64)offset + len, pos = 0;
+	struct scatterlist *sg, *dst;
+	unsigned int i, nents = 0;
+	int ret;
+
+	for_each_sgtable_sg(sgt, sg, i) {
+		if (pos + sg->length > start && pos < end)
+			nents++;
+		pos += sg->length;
+	}
+
+	if (unlikely(!len || pos < end))
+		return -EINVAL;
+
+	ret = sg_alloc_table(out, nents, GFP_KERNEL);
+	if (unlikely(ret))
+		return ret;
+
+	pos = 0;
+	dst = out->sgl;
+	for_each_sgtable_sg(sgt, sg, i) {
+		u64 s = max(pos, start), e = min(pos + sg->length, end);
+
+		if (s < e) {
+			sg_set_page(dst, sg_page(sg), e - s, sg->offset + (s - pos));
+			dst = sg_next(dst);
+		}
+
+		pos += sg->length;
+		if (pos >= end)
+			break;
+	}
+
+	return 0;
+}
+
+static void batch_req_done(struct batch_req *breq, int err)
+{
+	breq->range->status = err;
+	if (atomic_dec_and_test(&breq->ctx->pending))
+		complete(&breq->ctx->done);
+}
+
+static void batch_req_complete(struct crypto_async_request *req, int err)
+{
+	struct batch_req *breq = req->data;
+
+	/* moved from the backlog to the queue, not finished yet */
+	if (err == -EINPROGRESS)
+		return;
+
+	batch_req_done(breq, err);
+}
+
+static int batch_prepare_req(struct fcrypt *fcr, struct csession *ses_ptr,
+			     struct batch_ctx *ctx, struct batch_req *breq,
+			     struct crypt_fd_batch_range *range)
+{
+	struct sg_table *sgt;
+	int ret;
+
+	if (unlikely(range->len % ses_ptr->cdata.blocksize)) {
+		derr(1, "data size (%u) isn't a multiple of block size (%u)",
+		     range->len, ses_ptr->cdata.blocksize);
+		return -EINVAL;
+	}
+
+	sgt = batch_get_fd(fcr, ctx, range->src_fd);
+	if (IS_ERR(sgt))
+		return PTR_ERR(sgt);
+
+	ret = batch_sg_range(&breq->src, sgt, range->src_offset, range->len);
+	if (unlikely(ret))
+		return ret;
+
+	sgt = batch_get_fd(fcr, ctx, range->dst_fd);
+	if (IS_ERR(sgt))
+		return PTR_ERR(sgt);
+
+	ret = batch_sg_range(&breq->dst, sgt, range->dst_offset, range->len);
+	if (unlikely(ret))
+		return ret;
+
+	breq->req = cryptodev_blkcipher_request_alloc(ses_ptr->cdata.async.s, GFP_KERNEL);
+	if (unlikely(!breq->req))
+		return -ENOMEM;
+
+	memcpy(breq->iv, range->iv, min_t(size_t, ses_ptr->cdata.ivsize, sizeof(range->iv)));
+	cryptodev_blkcipher_request_set_callback(breq->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+						 batch_req_complete, breq);
+	cryptodev_blkcipher_request_set_crypt(breq->req, breq->src.sgl, breq->dst.sgl,
+					      range->len, breq->iv);
+
+	return 0;
+}
+
+/*
+ * Queue every range of a batch to the cipher before waiting for any of
+ * them, so the engine sees the whole batch instead of one request per
+ * syscall.
+ */
+static int crypto_fd_batch_run(struct fcrypt *fcr, struct crypt_fd_batch_op *bop,
+			       struct crypt_fd_batch_range *ranges)
+{
+	struct csession *ses_ptr;
+	struct batch_ctx *ctx;
+	struct batch_req *breq;
+	u32 i;
+	int ret;
+
+	if (unlikely(bop->op != COP_ENCRYPT && bop->op != COP_DECRYPT))
+		return -EINVAL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	/* this also enters ses_ptr->sem */
+	ses_ptr = crypto_get_session_by_sid(fcr, bop->ses);
+	if (unlikely(!ses_ptr)) {
+		derr(1, "invalid session ID=0x%08X", bop->ses);
+		ret = -EINVAL;
+		goto out_free;
+	}
+
+	if (unlikely(!ses_ptr->cdata.init || ses_ptr->cdata.aead || ses_ptr->hdata.init)) {
+		derr(1, "batch needs a plain cipher session");
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	init_completion(&ctx->done);
+
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		breq->ctx = ctx;
+		breq->range = &ranges[i];
+		ret = batch_prepare_req(fcr, ses_ptr, ctx, breq, &ranges[i]);
+		if (unlikely(ret))
+			goto out_reqs;
+	}
+
+	/* one extra reference so the batch can't complete while queuing */
+	atomic_set(&ctx->pending, bop->count + 1);
+	atomic_add(bop->count, &route_engine_inflight);
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		if (bop->op == COP_ENCRYPT)
+			ret = cryptodev_crypto_blkcipher_encrypt(breq->req);
+		else
+			ret = cryptodev_crypto_blkcipher_decrypt(breq->req);
+
+		if (ret != -EINPROGRESS && ret != -EBUSY)
+			batch_req_done(breq, ret);
+	}
+
+	if (!atomic_dec_and_test(&ctx->pending))
+		wait_for_completion(&ctx->done);
+	atomic_sub(bop->count, &route_engine_inflight);
+
+	if (bop->flags & COP_FLAG_WRITE_IV) {
+		for (i = 0; i < bop->count; i++)
+			memcpy(ranges[i].iv, ctx->reqs[i].iv,
+			       min_t(size_t, ses_ptr->cdata.ivsize, sizeof(ranges[i].iv)));
+	}
+	ret = 0;
+
+out_reqs:
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		if (breq->req)
+			cryptodev_blkcipher_request_free(breq->req);
+		sg_free_table(&breq->src);
+		sg_free_table(&breq->dst);
+	}
+	batch_put_fds(ctx);
+out_unlock:
+	crypto_put_session(ses_ptr);
+out_free:
+	kfree(ctx);
+
+	return ret;
+}
+
+static int crypto_fd_batch_ioctl(struct fcrypt *fcr, void __user *arg)
+{
+	struct crypt_fd_batch_range *ranges;
+	struct crypt_fd_batch_op bop;
+	size_t size;
+	int ret;
+
+	if (unlikely(copy_from_user(&bop, arg, sizeof(bop))))
+		return -EFAULT;
+
+	if (unlikely(!bop.count || bop.count > RK_CRYPT_BATCH_MAX))
+		return -EINVAL;
+
+	size = array_size(bop.count, sizeof(*ranges));
+	ranges = memdup_user(u64_to_user_ptr(bop.ranges), size);
+	if (IS_ERR(ranges))
+		return PTR_ERR(ranges);
+
+	ret = crypto_fd_batch_run(fcr, &bop, ranges);
+	if (!ret && copy_to_user(u64_to_user_ptr(bop.ranges), ranges, size))
+		ret = -EFAULT;
+
+	kfree(ranges);
+
+	return ret;
+}
+
 static int kcop_map_fd_from_user(struct kernel_crypt_fd_map_op *kcop,
 			struct fcrypt *fcr, void __user *arg)
 {
@@ -748,6 +1170,213 @@ static int crypto_rsa_run(struct fcrypt *fcr, struct kernel_crypt_rsa_op *krop)
 	return ret;
 }
 
+struct rsa_batch_req {
+	struct akcipher_request *req;
+	struct crypt_rsa_batch_item *item;
+	struct rsa_batch_ctx *ctx;
+	struct scatterlist src, dst;
+	u8 *in, *out;
+};
+
+struct rsa_batch_ctx {
+	atomic_t pending;
+	struct completion done;
+	struct rsa_batch_req reqs[RK_RSA_BATCH_MAX];
+};
+
+static void rsa_batch_req_done(struct rsa_batch_req *breq, int err)
+{
+	breq->item->status = err;
+	if (atomic_dec_and_test(&breq->ctx->pending))
+		complete(&breq->ctx->done);
+}
+
+static void rsa_batch_req_complete(struct crypto_async_request *req, int err)
+{
+	/* moved from the backlog to the queue, not finished yet */
+	if (err == -EINPROGRESS)
+		return;
+
+	rsa_batch_req_done(req->data, err);
+}
+
+static int rsa_batch_prepare_req(struct crypto_akcipher *tfm, struct rsa_batch_req *breq,
+				 u32 out_len_max)
+{
+	struct crypt_rsa_batch_item *item = breq->item;
+
+	if (item->in_len > RK_RSA_KEY_MAX_BYTES ||
+	    item->out_len > RK_RSA_KEY_MAX_BYTES ||
+	    (item->op != AOP_ENCRYPT && item->op != AOP_DECRYPT))
+		return -EINVAL;
+
+	breq->in = memdup_user(u64_to_user_ptr(item->in), item->in_len);
+	if (IS_ERR(breq->in)) {
+		int ret = PTR_ERR(breq->in);
+
+		breq->in = NULL;
+		return ret;
+	}
+
+	breq->out = kzalloc(out_len_max, GFP_KERNEL);
+	if (!breq->out)
+		return -ENOMEM;
+
+	breq->req = akcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!breq->req)
+		return -ENOMEM;
+
+	sg_init_one(&breq->src, breq->in, item->in_len);
+	sg_init_one(&breq->dst, breq->out, out_len_max);
+	akcipher_request_set_crypt(breq->req, &breq->src, &breq->dst,
+				   item->in_len, out_len_max);
+	akcipher_request_set_callback(breq->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				      rsa_batch_req_complete, breq);
+
+	return 0;
+}
+
+/*
+ * One tfm and one key decode for the whole batch, and all requests are on
+ * the engine queue before the first wait, so the PKA is never idle waiting
+ * for the next syscall.
+ */
+static int crypto_rsa_batch_run(struct crypt_rsa_batch_op *bop,
+				struct crypt_rsa_batch_item *items)
+{
+	bool is_priv_key = (bop->flags & COP_FLAG_RSA_PRIV) == COP_FLAG_RSA_PRIV;
+	const char *driver = "rsa-rk";
+	struct crypto_akcipher *tfm;
+	struct rsa_batch_ctx *ctx;
+	struct rsa_batch_req *breq;
+	u32 i, out_len_max;
+	u8 *key = NULL;
+	int ret;
+
+	/* The key size cannot exceed RK_RSA_BER_KEY_MAX Byte */
+	if (bop->key_len > RK_RSA_BER_KEY_MAX)
+		return -ENOKEY;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	tfm = crypto_alloc_akcipher(driver, 0, 0);
+	if (IS_ERR(tfm)) {
+		ddebug(2, "alg: akcipher: Failed to load tfm for %s: %ld\n",
+		       driver, PTR_ERR(tfm));
+		ret = PTR_ERR(tfm);
+		goto out_ctx;
+	}
+
+	key = memdup_user(u64_to_user_ptr(bop->key), bop->key_len);
+	if (IS_ERR(key)) {
+		ret = PTR_ERR(key);
+		key = NULL;
+		goto out_tfm;
+	}
+
+	if (is_priv_key)
+		ret = crypto_akcipher_set_priv_key(tfm, key, bop->key_len);
+	else
+		ret = crypto_akcipher_set_pub_key(tfm, key, bop->key_len);
+	if (ret) {
+		derr(1, "crypto_akcipher_set_%s_key error[%d]",
+		     is_priv_key ? "priv" : "pub", ret);
+		ret = -ENOKEY;
+		goto out_tfm;
+	}
+
+	out_len_max = crypto_akcipher_maxsize(tfm);
+	init_completion(&ctx->done);
+
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		breq->ctx = ctx;
+		breq->item = &items[i];
+		ret = rsa_batch_prepare_req(tfm, breq, out_len_max);
+		if (ret)
+			goto out_reqs;
+	}
+
+	/* one extra reference so the batch can't complete while queuing */
+	atomic_set(&ctx->pending, bop->count + 1);
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		if (breq->item->op == AOP_ENCRYPT)
+			ret = crypto_akcipher_encrypt(breq->req);
+		else
+			ret = crypto_akcipher_decrypt(breq->req);
+
+		if (ret != -EINPROGRESS && ret != -EBUSY)
+			rsa_batch_req_done(breq, ret);
+	}
+
+	if (!atomic_dec_and_test(&ctx->pending))
+		wait_for_completion(&ctx->done);
+
+	ret = 0;
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		if (breq->item->status)
+			continue;
+
+		if (breq->req->dst_len > breq->item->out_len) {
+			breq->item->status = -EOVERFLOW;
+			continue;
+		}
+
+		if (unlikely(copy_to_user(u64_to_user_ptr(breq->item->out), breq->out,
+					  breq->req->dst_len))) {
+			ret = -EFAULT;
+			break;
+		}
+		breq->item->out_len = breq->req->dst_len;
+	}
+
+out_reqs:
+	for (i = 0; i < bop->count; i++) {
+		breq = &ctx->reqs[i];
+		akcipher_request_free(breq->req);
+		kfree(breq->out);
+		kfree(breq->in);
+	}
+out_tfm:
+	kfree(key);
+	crypto_free_akcipher(tfm);
+out_ctx:
+	kfree(ctx);
+
+	return ret;
+}
+
+static int crypto_rsa_batch_ioctl(struct fcrypt *fcr, void __user *arg)
+{
+	struct crypt_rsa_batch_item *items;
+	struct crypt_rsa_batch_op bop;
+	size_t size;
+	int ret;
+
+	if (unlikely(copy_from_user(&bop, arg, sizeof(bop))))
+		return -EFAULT;
+
+	if (unlikely(!bop.count || bop.count > RK_RSA_BATCH_MAX))
+		return -EINVAL;
+
+	size = array_size(bop.count, sizeof(*items));
+	items = memdup_user(u64_to_user_ptr(bop.items), size);
+	if (IS_ERR(items))
+		return PTR_ERR(items);
+
+	ret = crypto_rsa_batch_run(&bop, items);
+	if (!ret && copy_to_user(u64_to_user_ptr(bop.items), items, size))
+		ret = -EFAULT;
+
+	kfree(items);
+
+	return ret;
+}
+
 /* Typical AEAD (i.e. GCM) encryption/decryption.
  * During decryption the tag is verified.
  */
@@ -1164,6 +1793,12 @@ rk_cryptodev_ioctl(struct fcrypt *fcr, unsigned int cmd, unsigned long arg_)
 		}
 
 		return kcaop_fd_to_user(&kcaop, fcr, arg);
+	case RIOCCRYPT_FD_BATCH:
+		ret = crypto_fd_batch_ioctl(fcr, arg);
+		if (unlikely(ret))
+			dwarning(1, "Error in crypto_fd_batch_run");
+
+		return ret;
 	case RIOCCRYPT_FD_MAP:
 		ret = kcop_map_fd_from_user(&kmop, fcr, arg);
 		if (unlikely(ret)) {
@@ -1228,6 +1863,12 @@ rk_cryptodev_ioctl(struct fcrypt *fcr, unsigned int cmd, unsigned long arg_)
 		}
 
 		return kcop_rsa_to_user(&krop, fcr, arg);
+	case RIOCCRYPT_RSA_BATCH:
+		ret = crypto_rsa_batch_ioctl(fcr, arg);
+		if (unlikely(ret))
+			dwarning(1, "Error in rsa_batch_run");
+
+		return ret;
 	default:
 		return -EINVAL;
 	}
@@ -1424,6 +2065,8 @@ struct cipher_algo_name_map {
 	const char	*name;
 	int		is_stream;
 	int		is_aead;
+	/* generic name, resolved to a CPU implementation */
+	const char	*cpu_name;
 };
 
 struct hash_algo_name_map {
@@ -1433,32 +2076,32 @@ struct hash_algo_name_map {
 };
 
 static const struct cipher_algo_name_map c_algo_map_tbl[] = {
-	{CRYPTO_RK_DES_ECB,     "ecb-des-rk",      0, 0},
-	{CRYPTO_RK_DES_CBC,     "cbc-des-rk",      0, 0},
-	{CRYPTO_RK_DES_CFB,     "cfb-des-rk",      0, 0},
-	{CRYPTO_RK_DES_OFB,     "ofb-des-rk",      0, 0},
-	{CRYPTO_RK_3DES_ECB,    "ecb-des3_ede-rk", 0, 0},
-	{CRYPTO_RK_3DES_CBC,    "cbc-des3_ede-rk", 0, 0},
-	{CRYPTO_RK_3DES_CFB,    "cfb-des3_ede-rk", 0, 0},
-	{CRYPTO_RK_3DES_OFB,    "ofb-des3_ede-rk", 0, 0},
-	{CRYPTO_RK_SM4_ECB,     "ecb-sm4-rk",      0, 0},
-	{CRYPTO_RK_SM4_CBC,     "cbc-sm4-rk",      0, 0},
-	{CRYPTO_RK_SM4_CFB,     "cfb-sm4-rk",      0, 0},
-	{CRYPTO_RK_SM4_OFB,     "ofb-sm4-rk",      0, 0},
-	{CRYPTO_RK_SM4_CTS,     "cts-sm4-rk",      0, 0},
-	{CRYPTO_RK_SM4_CTR,     "ctr-sm4-rk",      1, 0},
-	{CRYPTO_RK_SM4_XTS,     "xts-sm4-rk",      0, 0},
-	{CRYPTO_RK_SM4_CCM,     "ccm-sm4-rk",      1, 1},
-	{CRYPTO_RK_SM4_GCM,     "gcm-sm4-rk",      1, 1},
-	{CRYPTO_RK_AES_ECB,     "ecb-aes-rk",      0, 0},
-	{CRYPTO_RK_AES_CBC,     "cbc-aes-rk",      0, 0},
-	{CRYPTO_RK_AES_CFB,     "cfb-aes-rk",      0, 0},
-	{CRYPTO_RK_AES_OFB,     "ofb-aes-rk",      0, 0},
-	{CRYPTO_RK_AES_CTS,     "cts-aes-rk",      0, 0},
-	{CRYPTO_RK_AES_CTR,     "ctr-aes-rk",      1, 0},
-	{CRYPTO_RK_AES_XTS,     "xts-aes-rk",      0, 0},
-	{CRYPTO_RK_AES_CCM,     "ccm-aes-rk",      1, 1},
-	{CRYPTO_RK_AES_GCM,     "gcm-aes-rk",      1, 1},
+	{CRYPTO_RK_DES_ECB,     "ecb-des-rk",      0, 0, "ecb(des)"},
+	{CRYPTO_RK_DES_CBC,     "cbc-des-rk",      0, 0, "cbc(des)"},
+	{CRYPTO_RK_DES_CFB,     "cfb-des-rk",      0, 0, "cfb(des)"},
+	{CRYPTO_RK_DES_OFB,     "ofb-des-rk",      0, 0, "ofb(des)"},
+	{CRYPTO_RK_3DES_ECB,    "ecb-des3_ede-rk", 0, 0, "ecb(des3_ede)"},
+	{CRYPTO_RK_3DES_CBC,    "cbc-des3_ede-rk", 0, 0, "cbc(des3_ede)"},
+	{CRYPTO_RK_3DES_CFB,    "cfb-des3_ede-rk", 0, 0, "cfb(des3_ede)"},
+	{CRYPTO_RK_3DES_OFB,    "ofb-des3_ede-rk", 0, 0, "ofb(des3_ede)"},
+	{CRYPTO_RK_SM4_ECB,     "ecb-sm4-rk",      0, 0, "ecb(sm4)"},
+	{CRYPTO_RK_SM4_CBC,     "cbc-sm4-rk",      0, 0, "cbc(sm4)"},
+	{CRYPTO_RK_SM4_CFB,     "cfb-sm4-rk",      0, 0, "cfb(sm4)"},
+	{CRYPTO_RK_SM4_OFB,     "ofb-sm4-rk",      0, 0, "ofb(sm4)"},
+	{CRYPTO_RK_SM4_CTS,     "cts-sm4-rk",      0, 0, "cts(cbc(sm4))"},
+	{CRYPTO_RK_SM4_CTR,     "ctr-sm4-rk",      1, 0, "ctr(sm4)"},
+	{CRYPTO_RK_SM4_XTS,     "xts-sm4-rk",      0, 0, "xts(sm4)"},
+	{CRYPTO_RK_SM4_CCM,     "ccm-sm4-rk",      1, 1, NULL},
+	{CRYPTO_RK_SM4_GCM,     "gcm-sm4-rk",      1, 1, NULL},
+	{CRYPTO_RK_AES_ECB,     "ecb-aes-rk",      0, 0, "ecb(aes)"},
+	{CRYPTO_RK_AES_CBC,     "cbc-aes-rk",      0, 0, "cbc(aes)"},
+	{CRYPTO_RK_AES_CFB,     "cfb-aes-rk",      0, 0, "cfb(aes)"},
+	{CRYPTO_RK_AES_OFB,     "ofb-aes-rk",      0, 0, "ofb(aes)"},
+	{CRYPTO_RK_AES_CTS,     "cts-aes-rk",      0, 0, "cts(cbc(aes))"},
+	{CRYPTO_RK_AES_CTR,     "ctr-aes-rk",      1, 0, "ctr(aes)"},
+	{CRYPTO_RK_AES_XTS,     "xts-aes-rk",      0, 0, "xts(aes)"},
+	{CRYPTO_RK_AES_CCM,     "ccm-aes-rk",      1, 1, NULL},
+	{CRYPTO_RK_AES_GCM,     "gcm-aes-rk",      1, 1, NULL},
 };
 
 static const struct hash_algo_name_map h_algo_map_tbl[] = {
@@ -1501,6 +2144,18 @@ const char *rk_get_cipher_name(uint32_t id, int *is_stream, int *is_aead)
 	return NULL;
 }
 
+const char *rk_get_cipher_cpu_name(uint32_t id)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(c_algo_map_tbl); i++) {
+		if (id == c_algo_map_tbl[i].id)
+			return c_algo_map_tbl[i].cpu_name;
+	}
+
+	return NULL;
+}
+
 const char *rk_get_hash_name(uint32_t id, int *is_hmac)
 {
 	uint32_t i;
@@ -102,6 +102,8 @@ rk_compat_cryptodev_ioctl(struct fcrypt *fcr, unsigned int cmd, unsigned long ar
 
 const char *rk_get_cipher_name(uint32_t id, int *is_stream, int *is_aead);
 
+const char *rk_get_cipher_cpu_name(uint32_t id);
+
 const char *rk_get_hash_name(uint32_t id, int *is_hmac);
 
 bool rk_cryptodev_multi_thread(const char *name);
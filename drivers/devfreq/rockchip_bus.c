@@ -18,6 +18,7 @@
 #include <linux/rockchip/rockchip_sip.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <soc/rockchip/rockchip_csu.h>
 #include <soc/rockchip/rockchip_opp_select.h>
 #include <soc/rockchip/rockchip_system_monitor.h>
 #include <../drivers/devfreq/governor.h>
@@ -36,6 +37,12 @@ struct busfreq_table {
 	unsigned long volt;
 };
 
+/* csu divider the hardware may apply on idle, from the bus rate up */
+struct csu_div_table {
+	unsigned long freq;
+	unsigned int div;
+};
+
 struct relate_clk {
 	struct clk *clk;
 	unsigned long normal_rate;
@@ -54,6 +61,9 @@ struct rockchip_bus {
 	struct monitor_dev_info *mdev_info;
 	struct opp_table *opp_table;
 	struct relate_clk *relate_clks;
+	struct csu_clk *csu;
+	struct csu_div_table *csu_table;
+	unsigned int csu_cnt;
 #if defined(CONFIG_ROCKCHIP_EARLYSUSPEND)
 	struct early_suspend early_suspend;
 	unsigned long early_suspend_rate;
@@ -573,6 +583,72 @@ static int set_relate_clks_normal(struct rockchip_bus *bus)
 	return 0;
 }
 
+static int rockchip_bus_parse_csu(struct rockchip_bus *bus)
+{
+	struct device_node *np = bus->dev->of_node;
+	char *prop_name = "rockchip,csu-div-table";
+	int count, i;
+	u32 val;
+
+	if (!of_find_property(np, "rockchip,csu", NULL))
+		return 0;
+
+	count = of_property_count_u32_elems(np, prop_name);
+	if (count <= 0)
+		return 0;
+	if (count % 2) {
+		dev_err(bus->dev, "Invalid count of %s\n", prop_name);
+		return -EINVAL;
+	}
+
+	bus->csu = rockchip_csu_get(bus->dev, NULL);
+	if (IS_ERR(bus->csu)) {
+		dev_info(bus->dev, "without csu\n");
+		bus->csu = NULL;
+		return 0;
+	}
+
+	bus->csu_table = devm_kcalloc(bus->dev, count / 2,
+				      sizeof(*bus->csu_table), GFP_KERNEL);
+	if (!bus->csu_table)
+		return -ENOMEM;
+
+	/* <freq-in-KHz div>, in ascending order of freq */
+	for (i = 0; i < count / 2; i++) {
+		of_property_read_u32_index(np, prop_name, 2 * i, &val);
+		bus->csu_table[i].freq = val * 1000UL;
+		of_property_read_u32_index(np, prop_name, 2 * i + 1, &val);
+		bus->csu_table[i].div = val;
+	}
+	bus->csu_cnt = count / 2;
+
+	return 0;
+}
+
+/*
+ * The csu lowers the bus clock by itself while the noc is idle. Let it
+ * divide more when the bus runs fast, so the idle clock stays about the
+ * same whatever rate devfreq picked.
+ */
+static void rockchip_bus_csu_update(struct rockchip_bus *bus,
+				    unsigned long rate)
+{
+	unsigned int div = 1;
+	int i;
+
+	if (!bus->csu)
+		return;
+
+	for (i = 0; i < bus->csu_cnt; i++) {
+		if (rate < bus->csu_table[i].freq)
+			break;
+		div = bus->csu_table[i].div;
+	}
+
+	if (rockchip_csu_set_div(bus->csu, div))
+		dev_err(bus->dev, "failed to set csu div %u\n", div);
+}
+
 static int bus_devfreq_target(struct device *dev, unsigned long *freq,
 			      u32 flags)
 {
@@ -615,6 +691,8 @@ static int bus_devfreq_target(struct device *dev, unsigned long *freq,
 		return ret;
 	}
 
+	rockchip_bus_csu_update(bus, *freq);
+
 	if (*freq >= bus->normal_rate) {
 		ret = set_relate_clks_normal(bus);
 		if (ret)
@@ -741,6 +819,10 @@ static int rockchip_bus_devfreq(struct rockchip_bus *bus)
 		return ret;
 	}
 
+	ret = rockchip_bus_parse_csu(bus);
+	if (ret)
+		return ret;
+
 	ret = rockchip_init_opp_table(bus->dev, &bus->opp_info, NULL, "bus");
 	if (ret) {
 		dev_info(bus->dev, "Unsupported bus dvfs\n");
@@ -778,6 +860,7 @@ static int rockchip_bus_devfreq(struct rockchip_bus *bus)
 	}
 	bus->cur_rate = clk_get_rate(bus->clk);
 	bus->target_rate = bus->cur_rate;
+	rockchip_bus_csu_update(bus, bus->cur_rate);
 	bus->devfreq->previous_freq = bus->cur_rate;
 	if (bus->devfreq->suspend_freq)
 		bus->devfreq->resume_freq = bus->cur_rate;
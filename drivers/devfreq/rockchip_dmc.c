@@ -22,6 +22,7 @@
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_irq.h>
+#include <linux/perf_event.h>
 #include <linux/platform_device.h>
 #include <linux/pm_opp.h>
 #include <linux/pm_qos.h>
@@ -29,6 +30,7 @@
 #include <linux/regulator/consumer.h>
 #include <linux/rockchip/rockchip_sip.h>
 #include <linux/rwsem.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/suspend.h>
@@ -63,6 +65,11 @@
 
 #define FALLBACK_STATIC_TEMPERATURE	55000
 #define MAX_FREQ_COUNT			6
+#define DMCFREQ_VBLANK_WAIT_MS		50
+#define DMCFREQ_LAT_BUCKETS		16
+#define DMCFREQ_LAT_RATES		16
+#define DMC_MAX_EVENTS			16
+#define DMC_PMU_POLL_MS			50
 
 struct dmc_freq_table {
 	unsigned long freq;
@@ -104,6 +111,18 @@ struct rockchip_dmcfreq_ondemand_data {
 	unsigned int downdifferential;
 };
 
+/*
+ * A bus master measured by a "nocp-<name>" devfreq-event. Demand of the
+ * latency-critical masters is a floor for the dmc rate, the background ones
+ * can only raise it up to background_max_rate.
+ */
+struct rockchip_dmcfreq_master {
+	const char *name;
+	struct freq_map_table *bw_tbl;
+	int edev_id;
+	bool background;
+};
+
 struct rockchip_dmcfreq {
 	struct device *dev;
 	struct dmcfreq_common_info info;
@@ -122,7 +141,28 @@ struct rockchip_dmcfreq {
 	struct share_params *set_rate_params;
 	struct rockchip_opp_info opp_info;
 
+	struct rockchip_dmcfreq_master *masters;
 	unsigned long *nocp_bw;
+
+	/*
+	 * Running totals of the devfreq-events since probe: dfi busy and total
+	 * cycles, and bytes of every nocp master. The governor and the perf
+	 * pmu both take their deltas from here, as reading an event restarts
+	 * its counters.
+	 */
+	spinlock_t count_lock;
+	u64 *counts;
+	u64 dfi_total;
+	ktime_t count_time;
+	u64 *gov_counts;
+	u64 gov_dfi_total;
+	ktime_t gov_time;
+#ifdef CONFIG_PERF_EVENTS
+	struct pmu pmu;
+	struct delayed_work pmu_work;
+	int pmu_active;
+	int pmu_cpu;
+#endif
 	unsigned long rate;
 	unsigned long volt, mem_volt;
 	unsigned long sleep_volt, sleep_mem_volt;
@@ -144,6 +184,7 @@ struct rockchip_dmcfreq {
 	unsigned long boost_rate;
 	unsigned long fixed_rate;
 	unsigned long low_power_rate;
+	unsigned long background_max_rate;
 
 	unsigned long freq_count;
 	unsigned long freq_info_rate[MAX_FREQ_COUNT];
@@ -158,9 +199,12 @@ struct rockchip_dmcfreq {
 	int edev_count;
 	int dfi_id;
 	int nocp_cpu_id;
+	int master_count;
 
 	bool is_fixed;
+	bool background_only;
 	bool is_set_rate_direct;
+	bool vblank_sync;
 
 	unsigned int touchboostpulse_duration_val;
 	u64 touchboostpulse_endtime;
@@ -336,6 +380,92 @@ static int rk_drm_get_lcdc_type(void)
 	return lcdc_type;
 }
 
+/*
+ * Transition latency, from the SIP call (or clk_set_rate) until the new rate
+ * is running, in log2 microsecond buckets: bucket n counts [2^(n-1), 2^n) us.
+ */
+struct dmcfreq_trans_lat_rate {
+	unsigned long rate;
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static struct dmcfreq_trans_lat {
+	spinlock_t lock; /* protects the counters against the reader */
+	u64 hist[DMCFREQ_LAT_BUCKETS];
+	u64 waits;
+	u64 errors;
+	struct dmcfreq_trans_lat_rate rates[DMCFREQ_LAT_RATES];
+} trans_lat = {
+	.lock = __SPIN_LOCK_UNLOCKED(trans_lat.lock),
+};
+
+static void rockchip_dmcfreq_record_trans(unsigned long rate, u64 ns, int err)
+{
+	struct dmcfreq_trans_lat_rate *r = NULL;
+	unsigned long flags;
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int i;
+
+	spin_lock_irqsave(&trans_lat.lock, flags);
+	if (err) {
+		trans_lat.errors++;
+		goto out;
+	}
+	trans_lat.hist[min_t(int, fls64(us), DMCFREQ_LAT_BUCKETS - 1)]++;
+	for (i = 0; i < DMCFREQ_LAT_RATES; i++) {
+		if (!trans_lat.rates[i].rate)
+			trans_lat.rates[i].rate = rate;
+		if (trans_lat.rates[i].rate == rate) {
+			r = &trans_lat.rates[i];
+			break;
+		}
+	}
+	if (r) {
+		r->count++;
+		r->total_ns += ns;
+		r->max_ns = max(r->max_ns, ns);
+	}
+out:
+	spin_unlock_irqrestore(&trans_lat.lock, flags);
+}
+
+void rockchip_dmcfreq_trans_latency_show(struct seq_file *m)
+{
+	struct dmcfreq_trans_lat_rate *r;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&trans_lat.lock, flags);
+	seq_printf(m, "waits: %llu errors: %llu\n", trans_lat.waits,
+		   trans_lat.errors);
+	seq_puts(m, "latency(us)        count\n");
+	for (i = 0; i < DMCFREQ_LAT_BUCKETS; i++) {
+		if (!trans_lat.hist[i])
+			continue;
+		if (!i)
+			seq_printf(m, "%8s-%-8u %llu\n", "0", 1, trans_lat.hist[i]);
+		else if (i == DMCFREQ_LAT_BUCKETS - 1)
+			seq_printf(m, "%8u-%-8s %llu\n", 1 << (i - 1), "",
+				   trans_lat.hist[i]);
+		else
+			seq_printf(m, "%8u-%-8u %llu\n", 1 << (i - 1), 1 << i,
+				   trans_lat.hist[i]);
+	}
+	seq_puts(m, "rate(MHz)     count   avg(us)   max(us)\n");
+	for (i = 0; i < DMCFREQ_LAT_RATES; i++) {
+		r = &trans_lat.rates[i];
+		if (!r->count)
+			continue;
+		seq_printf(m, "%9lu %9llu %9llu %9llu\n", r->rate / 1000000,
+			   r->count, div64_u64(r->total_ns, r->count * NSEC_PER_USEC),
+			   div_u64(r->max_ns, NSEC_PER_USEC));
+	}
+	spin_unlock_irqrestore(&trans_lat.lock, flags);
+}
+EXPORT_SYMBOL(rockchip_dmcfreq_trans_latency_show);
+
 static int rockchip_ddr_set_rate(unsigned long target_rate)
 {
 	struct arm_smccc_res res;
@@ -391,6 +521,7 @@ static int rockchip_dmcfreq_opp_set_rate(struct device *dev,
 	struct cpufreq_policy *policy;
 	bool is_cpufreq_changed = false;
 	unsigned int cpu_cur, cpufreq_cur;
+	ktime_t trans_start;
 	int ret = 0;
 
 	vdd_reg = opp_info->regulators[0];
@@ -476,16 +607,35 @@ static int rockchip_dmcfreq_opp_set_rate(struct device *dev,
 		cond_resched();
 	dev_dbg(dev, "%lu Hz --> %lu Hz\n", old_freq, new_freq);
 
+	/*
+	 * Switch inside the vertical blanking of the display, so the rate
+	 * can scale with the panel on. Without a window try again later.
+	 */
+	if (dmcfreq->vblank_sync) {
+		ret = rockchip_drm_wait_vblank_window(DMCFREQ_VBLANK_WAIT_MS);
+		if (ret && ret != -ENODEV && ret != -EOPNOTSUPP) {
+			rockchip_dmcfreq_write_unlock();
+			dev_dbg(dev, "no vblank window for %lu Hz: %d\n", new_freq, ret);
+			goto restore_voltage;
+		}
+		ret = 0;
+	}
+
 	if (dmcfreq->set_rate_params) {
 		dmcfreq->set_rate_params->lcdc_type = rk_drm_get_lcdc_type();
 		dmcfreq->set_rate_params->wait_flag1 = 1;
 		dmcfreq->set_rate_params->wait_flag0 = 1;
 	}
 
+	trans_start = ktime_get();
 	if (dmcfreq->is_set_rate_direct)
 		ret = rockchip_ddr_set_rate(new_freq);
 	else
 		ret = clk_set_rate(clk, new_freq);
+	rockchip_dmcfreq_record_trans(new_freq,
+				      ktime_to_ns(ktime_sub(ktime_get(),
+							    trans_start)),
+				      ret);
 
 	rockchip_dmcfreq_write_unlock();
 	if (ret) {
@@ -597,12 +747,49 @@ static int rockchip_dmcfreq_target(struct device *dev, unsigned long *freq,
 	return ret;
 }
 
+/* Called with the dvfs lock held */
+static int rockchip_dmcfreq_update_counts(struct rockchip_dmcfreq *dmcfreq)
+{
+	struct devfreq_event_data edata[DMC_MAX_EVENTS];
+	unsigned long flags;
+	ktime_t now;
+	u64 dt;
+	int i, ret;
+
+	for (i = 0; i < dmcfreq->edev_count; i++) {
+		ret = devfreq_event_get_event(dmcfreq->edev[i], &edata[i]);
+		if (ret < 0) {
+			dev_err(dmcfreq->dev, "failed to get event %s\n",
+				dmcfreq->edev[i]->desc->name);
+			return ret;
+		}
+	}
+
+	spin_lock_irqsave(&dmcfreq->count_lock, flags);
+	now = ktime_get();
+	dt = ktime_to_ns(ktime_sub(now, dmcfreq->count_time));
+	dmcfreq->count_time = now;
+	for (i = 0; i < dmcfreq->edev_count; i++) {
+		if (i == dmcfreq->dfi_id) {
+			dmcfreq->counts[i] += edata[i].load_count;
+			dmcfreq->dfi_total += edata[i].total_count;
+		} else {
+			/* nocp load_count is MB/s over the interval */
+			dmcfreq->counts[i] += div_u64((u64)edata[i].load_count * dt,
+						      NSEC_PER_USEC);
+		}
+	}
+	spin_unlock_irqrestore(&dmcfreq->count_lock, flags);
+
+	return 0;
+}
+
 static int rockchip_dmcfreq_get_dev_status(struct device *dev,
 					   struct devfreq_dev_status *stat)
 {
 	struct rockchip_dmcfreq *dmcfreq = dev_get_drvdata(dev);
 	struct rockchip_opp_info *opp_info = &dmcfreq->opp_info;
-	struct devfreq_event_data edata;
+	u64 dt;
 	int i, ret = 0;
 
 	if (!dmcfreq->info.auto_freq_en)
@@ -613,20 +800,24 @@ static int rockchip_dmcfreq_get_dev_status(struct device *dev,
 	 * registers at same time.
 	 */
 	rockchip_opp_dvfs_lock(opp_info);
+	ret = rockchip_dmcfreq_update_counts(dmcfreq);
+	if (ret)
+		goto out;
+
+	dt = ktime_to_ns(ktime_sub(dmcfreq->count_time, dmcfreq->gov_time));
 	for (i = 0; i < dmcfreq->edev_count; i++) {
-		ret = devfreq_event_get_event(dmcfreq->edev[i], &edata);
-		if (ret < 0) {
-			dev_err(dev, "failed to get event %s\n",
-				dmcfreq->edev[i]->desc->name);
-			goto out;
-		}
 		if (i == dmcfreq->dfi_id) {
-			stat->busy_time = edata.load_count;
-			stat->total_time = edata.total_count;
-		} else {
-			dmcfreq->nocp_bw[i] = edata.load_count;
+			stat->busy_time = dmcfreq->counts[i] - dmcfreq->gov_counts[i];
+			stat->total_time = dmcfreq->dfi_total - dmcfreq->gov_dfi_total;
+		} else if (dt) {
+			dmcfreq->nocp_bw[i] =
+				div64_u64((dmcfreq->counts[i] - dmcfreq->gov_counts[i]) *
+					  NSEC_PER_USEC, dt);
 		}
+		dmcfreq->gov_counts[i] = dmcfreq->counts[i];
 	}
+	dmcfreq->gov_dfi_total = dmcfreq->dfi_total;
+	dmcfreq->gov_time = dmcfreq->count_time;
 
 out:
 	rockchip_opp_dvfs_unlock(opp_info);
@@ -1140,12 +1331,16 @@ static irqreturn_t wait_dcf_complete_irq(int irqno, void *dev_id)
 int rockchip_dmcfreq_wait_complete(void)
 {
 	struct arm_smccc_res res;
+	unsigned long flags;
 
 	if (!wait_ctrl.wait_en) {
 		pr_err("%s: Do not support time out!\n", __func__);
 		return 0;
 	}
 	wait_ctrl.wait_flag = -1;
+	spin_lock_irqsave(&trans_lat.lock, flags);
+	trans_lat.waits++;
+	spin_unlock_irqrestore(&trans_lat.lock, flags);
 
 	enable_irq(wait_ctrl.complt_irq);
 	/*
@@ -2715,22 +2910,66 @@ static ssize_t downdifferential_store(struct device *dev,
 
 static DEVICE_ATTR_RW(downdifferential);
 
-static unsigned long get_nocp_req_rate(struct rockchip_dmcfreq *dmcfreq)
+static ssize_t master_bw_show(struct device *dev,
+			      struct device_attribute *attr,
+			      char *buf)
 {
-	unsigned long target = 0, cpu_bw = 0;
+	struct rockchip_dmcfreq *dmcfreq = dev_get_drvdata(dev->parent);
+	struct rockchip_dmcfreq_master *master;
+	ssize_t len = 0;
 	int i;
 
-	if (!dmcfreq->cpu_bw_tbl || dmcfreq->nocp_cpu_id < 0)
-		goto out;
+	for (i = 0; i < dmcfreq->master_count; i++) {
+		master = &dmcfreq->masters[i];
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%-8s %10lu%s\n",
+				 master->name,
+				 dmcfreq->nocp_bw[master->edev_id],
+				 master->background ? " background" : "");
+	}
+
+	return len;
+}
+
+static DEVICE_ATTR_RO(master_bw);
+
+static unsigned long get_bw_req_rate(struct freq_map_table *tbl,
+				     unsigned long bw)
+{
+	unsigned long target = 0;
+	int i;
 
-	cpu_bw = dmcfreq->nocp_bw[dmcfreq->nocp_cpu_id];
+	if (!tbl)
+		return 0;
 
-	for (i = 0; dmcfreq->cpu_bw_tbl[i].freq != CPUFREQ_TABLE_END; i++) {
-		if (cpu_bw >= dmcfreq->cpu_bw_tbl[i].min)
-			target = dmcfreq->cpu_bw_tbl[i].freq;
+	for (i = 0; tbl[i].freq != DMCFREQ_TABLE_END; i++) {
+		if (bw >= tbl[i].min)
+			target = tbl[i].freq;
 	}
 
-out:
+	return target;
+}
+
+static unsigned long get_nocp_req_rate(struct rockchip_dmcfreq *dmcfreq)
+{
+	struct rockchip_dmcfreq_master *master;
+	unsigned long target = 0, rate;
+	bool critical = false;
+	int i;
+
+	for (i = 0; i < dmcfreq->master_count; i++) {
+		master = &dmcfreq->masters[i];
+		rate = get_bw_req_rate(master->bw_tbl,
+				       dmcfreq->nocp_bw[master->edev_id]);
+		if (master->background) {
+			if (dmcfreq->background_max_rate)
+				rate = min(rate, dmcfreq->background_max_rate);
+		} else if (rate) {
+			critical = true;
+		}
+		target = max(target, rate);
+	}
+	dmcfreq->background_only = !critical;
+
 	return target;
 }
 
@@ -2745,6 +2984,7 @@ static int devfreq_dmc_ondemand_func(struct devfreq *df,
 	unsigned int upthreshold = data->upthreshold;
 	unsigned int downdifferential = data->downdifferential;
 	unsigned long target_freq = 0, nocp_req_rate = 0;
+	unsigned long load_max_freq = DEVFREQ_MAX_FREQ;
 	u64 now;
 
 	if (dmcfreq->info.auto_freq_en && !dmcfreq->is_fixed) {
@@ -2755,6 +2995,14 @@ static int devfreq_dmc_ondemand_func(struct devfreq *df,
 		nocp_req_rate = get_nocp_req_rate(dmcfreq);
 		target_freq = max3(target_freq, nocp_req_rate,
 				   dmcfreq->info.vop_req_rate);
+		target_freq = max(target_freq, dmcfreq->info.bw_req_rate);
+		/*
+		 * No latency-critical master needs more bandwidth, so the
+		 * utilization comes from background traffic that does not
+		 * deserve the top rates.
+		 */
+		if (dmcfreq->background_only && dmcfreq->background_max_rate)
+			load_max_freq = dmcfreq->background_max_rate;
 		now = ktime_to_us(ktime_get());
 		if (now < dmcfreq->touchboostpulse_endtime)
 			target_freq = max(target_freq, dmcfreq->boost_rate);
@@ -2785,7 +3033,7 @@ static int devfreq_dmc_ondemand_func(struct devfreq *df,
 
 	/* Assume MAX if it is going to be divided by zero */
 	if (stat->total_time == 0) {
-		*freq = DEVFREQ_MAX_FREQ;
+		*freq = max(target_freq, load_max_freq);
 		return 0;
 	}
 
@@ -2798,20 +3046,21 @@ static int devfreq_dmc_ondemand_func(struct devfreq *df,
 	/* Set MAX if it's busy enough */
 	if (stat->busy_time * 100 >
 	    stat->total_time * upthreshold) {
-		*freq = DEVFREQ_MAX_FREQ;
+		*freq = max(target_freq, load_max_freq);
 		return 0;
 	}
 
 	/* Set MAX if we do not know the initial frequency */
 	if (stat->current_frequency == 0) {
-		*freq = DEVFREQ_MAX_FREQ;
+		*freq = max(target_freq, load_max_freq);
 		return 0;
 	}
 
 	/* Keep the current frequency */
 	if (stat->busy_time * 100 >
 	    stat->total_time * (upthreshold - downdifferential)) {
-		*freq = max(target_freq, stat->current_frequency);
+		*freq = max(target_freq,
+			    min(stat->current_frequency, load_max_freq));
 		return 0;
 	}
 
@@ -2821,6 +3070,7 @@ static int devfreq_dmc_ondemand_func(struct devfreq *df,
 	b = div_u64(a, stat->total_time);
 	b *= 100;
 	b = div_u64(b, (upthreshold - downdifferential / 2));
+	b = min_t(unsigned long long, b, load_max_freq);
 	*freq = max_t(unsigned long, target_freq, b);
 
 	return 0;
@@ -2873,6 +3123,271 @@ static struct devfreq_governor devfreq_dmc_ondemand = {
 	.event_handler = devfreq_dmc_ondemand_handler,
 };
 
+#ifdef CONFIG_PERF_EVENTS
+/*
+ * "rockchip_ddr" perf pmu over the devfreq-events of the dmc. The per
+ * master events count bytes from the nocp probes, dfi_busy and dfi_cycles
+ * the dfi cycles. Counts advance when the governor samples the events or,
+ * while an event is counting, every DMC_PMU_POLL_MS.
+ */
+#define to_dmcfreq_pmu(p) container_of(p, struct rockchip_dmcfreq, pmu)
+
+#define DMC_PMU_EDEV(config)	((config) & 0xff)
+#define DMC_PMU_TOTAL		BIT(8)
+
+static u64 rockchip_dmcfreq_pmu_count(struct rockchip_dmcfreq *dmcfreq,
+				      u64 config)
+{
+	unsigned long flags;
+	u64 val;
+
+	spin_lock_irqsave(&dmcfreq->count_lock, flags);
+	if (config & DMC_PMU_TOTAL)
+		val = dmcfreq->dfi_total;
+	else
+		val = dmcfreq->counts[DMC_PMU_EDEV(config)];
+	spin_unlock_irqrestore(&dmcfreq->count_lock, flags);
+
+	return val;
+}
+
+static void rockchip_dmcfreq_pmu_work(struct work_struct *work)
+{
+	struct rockchip_dmcfreq *dmcfreq =
+		container_of(to_delayed_work(work), struct rockchip_dmcfreq,
+			     pmu_work);
+
+	rockchip_opp_dvfs_lock(&dmcfreq->opp_info);
+	rockchip_dmcfreq_update_counts(dmcfreq);
+	rockchip_opp_dvfs_unlock(&dmcfreq->opp_info);
+
+	if (READ_ONCE(dmcfreq->pmu_active))
+		queue_delayed_work(system_freezable_power_efficient_wq,
+				   &dmcfreq->pmu_work,
+				   msecs_to_jiffies(DMC_PMU_POLL_MS));
+}
+
+static int rockchip_dmcfreq_pmu_event_init(struct perf_event *event)
+{
+	struct rockchip_dmcfreq *dmcfreq = to_dmcfreq_pmu(event->pmu);
+	u64 config = event->attr.config;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+	/* counting only, and not per task */
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EOPNOTSUPP;
+	if (event->cpu < 0)
+		return -EINVAL;
+	if (DMC_PMU_EDEV(config) >= dmcfreq->edev_count ||
+	    config & ~(DMC_PMU_TOTAL | 0xff))
+		return -EINVAL;
+	if (config & DMC_PMU_TOTAL && DMC_PMU_EDEV(config) != dmcfreq->dfi_id)
+		return -EINVAL;
+
+	event->cpu = dmcfreq->pmu_cpu;
+
+	return 0;
+}
+
+static void rockchip_dmcfreq_pmu_read(struct perf_event *event)
+{
+	struct rockchip_dmcfreq *dmcfreq = to_dmcfreq_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = rockchip_dmcfreq_pmu_count(dmcfreq, event->attr.config);
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	local64_add(now - prev, &event->count);
+}
+
+static void rockchip_dmcfreq_pmu_start(struct perf_event *event, int flags)
+{
+	struct rockchip_dmcfreq *dmcfreq = to_dmcfreq_pmu(event->pmu);
+
+	local64_set(&event->hw.prev_count,
+		    rockchip_dmcfreq_pmu_count(dmcfreq, event->attr.config));
+	event->hw.state = 0;
+	if (dmcfreq->pmu_active++ == 0)
+		queue_delayed_work(system_freezable_power_efficient_wq,
+				   &dmcfreq->pmu_work,
+				   msecs_to_jiffies(DMC_PMU_POLL_MS));
+}
+
+static void rockchip_dmcfreq_pmu_stop(struct perf_event *event, int flags)
+{
+	struct rockchip_dmcfreq *dmcfreq = to_dmcfreq_pmu(event->pmu);
+
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	rockchip_dmcfreq_pmu_read(event);
+	event->hw.state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (--dmcfreq->pmu_active == 0)
+		cancel_delayed_work(&dmcfreq->pmu_work);
+}
+
+static int rockchip_dmcfreq_pmu_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (flags & PERF_EF_START)
+		rockchip_dmcfreq_pmu_start(event, flags);
+
+	return 0;
+}
+
+static void rockchip_dmcfreq_pmu_del(struct perf_event *event, int flags)
+{
+	rockchip_dmcfreq_pmu_stop(event, PERF_EF_UPDATE);
+}
+
+static ssize_t cpumask_show(struct device *dev, struct device_attribute *attr,
+			    char *buf)
+{
+	struct rockchip_dmcfreq *dmcfreq = to_dmcfreq_pmu(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(dmcfreq->pmu_cpu));
+}
+
+static DEVICE_ATTR_RO(cpumask);
+
+static struct attribute *rockchip_dmcfreq_pmu_cpumask_attrs[] = {
+	&dev_attr_cpumask.attr,
+	NULL,
+};
+
+static const struct attribute_group rockchip_dmcfreq_pmu_cpumask_group = {
+	.attrs = rockchip_dmcfreq_pmu_cpumask_attrs,
+};
+
+PMU_FORMAT_ATTR(edev, "config:0-7");
+PMU_FORMAT_ATTR(total, "config:8");
+
+static struct attribute *rockchip_dmcfreq_pmu_format_attrs[] = {
+	&format_attr_edev.attr,
+	&format_attr_total.attr,
+	NULL,
+};
+
+static const struct attribute_group rockchip_dmcfreq_pmu_format_group = {
+	.name = "format",
+	.attrs = rockchip_dmcfreq_pmu_format_attrs,
+};
+
+static int rockchip_dmcfreq_pmu_add_event(struct device *dev,
+					  struct attribute **attrs, int *n,
+					  const char *name, const char *str)
+{
+	struct perf_pmu_events_attr *pattr;
+
+	if (!name || !str)
+		return -ENOMEM;
+
+	pattr = devm_kzalloc(dev, sizeof(*pattr), GFP_KERNEL);
+	if (!pattr)
+		return -ENOMEM;
+
+	sysfs_attr_init(&pattr->attr.attr);
+	pattr->attr.attr.name = name;
+	pattr->attr.attr.mode = 0444;
+	pattr->attr.show = perf_event_sysfs_show;
+	pattr->event_str = str;
+	attrs[(*n)++] = &pattr->attr.attr;
+
+	return 0;
+}
+
+/* One named event per devfreq-event, e.g. rockchip_ddr/gpu_bytes/ */
+static int rockchip_dmcfreq_pmu_events(struct rockchip_dmcfreq *dmcfreq,
+				       struct attribute_group *group)
+{
+	struct device *dev = dmcfreq->dev;
+	struct attribute **attrs;
+	const char *name, *str;
+	int i, n = 0, ret;
+
+	attrs = devm_kcalloc(dev, dmcfreq->edev_count + 2, sizeof(*attrs),
+			     GFP_KERNEL);
+	if (!attrs)
+		return -ENOMEM;
+
+	for (i = 0; i < dmcfreq->edev_count; i++) {
+		name = dmcfreq->edev[i]->desc->name;
+		str = devm_kasprintf(dev, GFP_KERNEL, "edev=%d", i);
+		if (i == dmcfreq->dfi_id) {
+			ret = rockchip_dmcfreq_pmu_add_event(dev, attrs, &n,
+							     "dfi_busy", str);
+			str = devm_kasprintf(dev, GFP_KERNEL, "edev=%d,total=1", i);
+			if (!ret)
+				ret = rockchip_dmcfreq_pmu_add_event(dev, attrs, &n,
+								     "dfi_cycles",
+								     str);
+		} else if (!strncmp(name, "nocp-", 5)) {
+			name = devm_kasprintf(dev, GFP_KERNEL, "%s_bytes",
+					      name + 5);
+			ret = rockchip_dmcfreq_pmu_add_event(dev, attrs, &n,
+							     name, str);
+		} else {
+			continue;
+		}
+		if (ret)
+			return ret;
+	}
+
+	group->name = "events";
+	group->attrs = attrs;
+
+	return 0;
+}
+
+static void rockchip_dmcfreq_pmu_init(struct rockchip_dmcfreq *dmcfreq)
+{
+	struct device *dev = dmcfreq->dev;
+	const struct attribute_group **groups;
+	struct attribute_group *events;
+	int ret;
+
+	if (!dmcfreq->info.auto_freq_en || !dmcfreq->edev_count)
+		return;
+
+	groups = devm_kcalloc(dev, 4, sizeof(*groups), GFP_KERNEL);
+	events = devm_kzalloc(dev, sizeof(*events), GFP_KERNEL);
+	if (!groups || !events)
+		return;
+	if (rockchip_dmcfreq_pmu_events(dmcfreq, events))
+		return;
+	groups[0] = &rockchip_dmcfreq_pmu_cpumask_group;
+	groups[1] = &rockchip_dmcfreq_pmu_format_group;
+	groups[2] = events;
+
+	INIT_DELAYED_WORK(&dmcfreq->pmu_work, rockchip_dmcfreq_pmu_work);
+	dmcfreq->pmu_cpu = raw_smp_processor_id();
+	dmcfreq->pmu = (struct pmu) {
+		.module = THIS_MODULE,
+		.task_ctx_nr = perf_invalid_context,
+		.capabilities = PERF_PMU_CAP_NO_EXCLUDE,
+		.attr_groups = groups,
+		.event_init = rockchip_dmcfreq_pmu_event_init,
+		.add = rockchip_dmcfreq_pmu_add,
+		.del = rockchip_dmcfreq_pmu_del,
+		.start = rockchip_dmcfreq_pmu_start,
+		.stop = rockchip_dmcfreq_pmu_stop,
+		.read = rockchip_dmcfreq_pmu_read,
+	};
+
+	ret = perf_pmu_register(&dmcfreq->pmu, "rockchip_ddr", -1);
+	if (ret)
+		dev_err(dev, "failed to register perf pmu: %d\n", ret);
+}
+#else
+static inline void rockchip_dmcfreq_pmu_init(struct rockchip_dmcfreq *dmcfreq)
+{
+}
+#endif
+
 static int rockchip_dmcfreq_enable_event(struct rockchip_dmcfreq *dmcfreq)
 {
 	int i, ret;
@@ -2949,6 +3464,10 @@ static int rockchip_dmcfreq_get_event(struct rockchip_dmcfreq *dmcfreq)
 		dev_dbg(dev, "failed to get available devfreq-event\n");
 		return 0;
 	}
+	if (available_count > DMC_MAX_EVENTS) {
+		dev_err(dev, "too many devfreq-events\n");
+		return -EINVAL;
+	}
 	dmcfreq->edev_count = available_count;
 	dmcfreq->edev = devm_kzalloc(dev,
 				     sizeof(*dmcfreq->edev) * available_count,
@@ -2983,6 +3502,16 @@ static int rockchip_dmcfreq_get_event(struct rockchip_dmcfreq *dmcfreq)
 			     GFP_KERNEL);
 	if (!dmcfreq->nocp_bw)
 		return -ENOMEM;
+	dmcfreq->counts = devm_kcalloc(dev, available_count,
+				       sizeof(*dmcfreq->counts), GFP_KERNEL);
+	dmcfreq->gov_counts = devm_kcalloc(dev, available_count,
+					   sizeof(*dmcfreq->gov_counts),
+					   GFP_KERNEL);
+	if (!dmcfreq->counts || !dmcfreq->gov_counts)
+		return -ENOMEM;
+	spin_lock_init(&dmcfreq->count_lock);
+	dmcfreq->count_time = ktime_get();
+	dmcfreq->gov_time = dmcfreq->count_time;
 
 	return 0;
 }
@@ -3043,6 +3572,63 @@ static void rockchip_dmcfreq_level_rate_init(struct rockchip_dmcfreq *dmcfreq)
 	dmcfreq->auto_min_rate = dmcfreq->rate_low;
 }
 
+static void rockchip_dmcfreq_masters_init(struct rockchip_dmcfreq *dmcfreq)
+{
+	struct device *dev = dmcfreq->dev;
+	struct device_node *np = dev->of_node;
+	struct rockchip_dmcfreq_master *master;
+	struct freq_map_table *tbl;
+	const char *name;
+	char prop[32];
+	u32 background_max_freq = 0;
+	int i;
+
+	if (!dmcfreq->edev_count)
+		return;
+
+	dmcfreq->masters = devm_kcalloc(dev, dmcfreq->edev_count,
+					sizeof(*dmcfreq->masters), GFP_KERNEL);
+	if (!dmcfreq->masters)
+		return;
+
+	for (i = 0; i < dmcfreq->edev_count; i++) {
+		name = dmcfreq->edev[i]->desc->name;
+		if (strncmp(name, "nocp-", 5))
+			continue;
+		name += 5;
+
+		tbl = NULL;
+		if (i == dmcfreq->nocp_cpu_id) {
+			tbl = dmcfreq->cpu_bw_tbl;
+		} else {
+			snprintf(prop, sizeof(prop), "%s-bw-dmc-level", name);
+			if (rockchip_get_level_map_talbe(np, prop, dmcfreq,
+							 &tbl)) {
+				snprintf(prop, sizeof(prop), "%s-bw-dmc-freq",
+					 name);
+				if (rockchip_get_freq_map_talbe(np, prop, &tbl))
+					tbl = NULL;
+			}
+		}
+
+		master = &dmcfreq->masters[dmcfreq->master_count];
+		master->background =
+			of_property_match_string(np,
+						 "rockchip,bw-background-masters",
+						 name) >= 0;
+		if (!tbl && !master->background)
+			continue;
+		master->name = name;
+		master->bw_tbl = tbl;
+		master->edev_id = i;
+		dmcfreq->master_count++;
+	}
+
+	of_property_read_u32(np, "rockchip,bw-background-max-freq",
+			     &background_max_freq);
+	dmcfreq->background_max_rate = background_max_freq * 1000UL;
+}
+
 static void rockchip_dmcfreq_parse_dt(struct rockchip_dmcfreq *dmcfreq)
 {
 	struct device *dev = dmcfreq->dev;
@@ -3054,6 +3640,7 @@ static void rockchip_dmcfreq_parse_dt(struct rockchip_dmcfreq *dmcfreq)
 		dmcfreq->system_status_en = true;
 
 	of_property_read_u32(np, "min-cpu-freq", &dmcfreq->min_cpu_freq);
+	dmcfreq->vblank_sync = of_property_read_bool(np, "vblank-sync-dfs");
 
 	of_property_read_u32(np, "upthreshold",
 			     &dmcfreq->ondemand_data.upthreshold);
@@ -3074,6 +3661,16 @@ static void rockchip_dmcfreq_parse_dt(struct rockchip_dmcfreq *dmcfreq)
 						&dmcfreq->cpu_bw_tbl))
 			dev_dbg(dev, "failed to get cpu bandwidth to dmc rate\n");
 	}
+	rockchip_dmcfreq_masters_init(dmcfreq);
+	if (rockchip_get_level_map_talbe(np, "bw-req-dmc-level", dmcfreq,
+					 &dmcfreq->info.bw_req_tbl)) {
+		if (rockchip_get_freq_map_talbe(np, "bw-req-dmc-freq",
+						&dmcfreq->info.bw_req_tbl))
+			dev_dbg(dev, "failed to get bandwidth request to dmc rate\n");
+	}
+	dmcfreq->info.bw_background_max_rate = dmcfreq->background_max_rate;
+	of_property_read_u32(np, "rockchip,bw-realtime-qos-priority",
+			     &dmcfreq->info.bw_realtime_qos_prio);
 	if (rockchip_get_level_map_talbe(np, "vop-frame-bw-dmc-level", dmcfreq,
 					 &dmcfreq->info.vop_frame_bw_tbl)) {
 		if (rockchip_get_freq_map_talbe(np, "vop-frame-bw-dmc-freq",
@@ -3183,6 +3780,10 @@ static void rockchip_dmcfreq_add_interface(struct rockchip_dmcfreq *dmcfreq)
 			      &dev_attr_downdifferential.attr))
 		dev_err(dmcfreq->dev,
 			"failed to register downdifferential sysfs file\n");
+	if (dmcfreq->master_count &&
+	    sysfs_create_file(&devfreq->dev.kobj, &dev_attr_master_bw.attr))
+		dev_err(dmcfreq->dev,
+			"failed to register master_bw sysfs file\n");
 
 	if (!rockchip_add_system_status_interface(&devfreq->dev))
 		return;
@@ -3351,6 +3952,7 @@ static int rockchip_dmcfreq_probe(struct platform_device *pdev)
 
 	rockchip_dmcfreq_register_notifier(data);
 	rockchip_dmcfreq_add_interface(data);
+	rockchip_dmcfreq_pmu_init(data);
 	rockchip_dmcfreq_boost_init(data);
 	rockchip_dmcfreq_vop_bandwidth_init(&data->info);
 
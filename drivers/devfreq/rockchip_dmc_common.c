@@ -7,6 +7,7 @@
  */
 
 #include <linux/module.h>
+#include <soc/rockchip/pm_domains.h>
 #include <soc/rockchip/rockchip_dmc.h>
 
 #define msch_rl_to_dmcfreq(work) container_of(to_delayed_work(work), \
@@ -16,6 +17,8 @@
 
 static struct dmcfreq_common_info *common_info;
 static DECLARE_RWSEM(rockchip_dmcfreq_sem);
+static LIST_HEAD(bw_request_list);
+static DEFINE_MUTEX(bw_request_lock);
 
 void rockchip_dmcfreq_lock(void)
 {
@@ -70,7 +73,10 @@ int rockchip_dmcfreq_vop_bandwidth_init(struct dmcfreq_common_info *info)
 {
 	if (info->set_msch_readlatency)
 		INIT_DELAYED_WORK(&info->msch_rl_work, set_msch_rl_work);
+	mutex_lock(&bw_request_lock);
 	common_info = info;
+	bw_request_aggregate();
+	mutex_unlock(&bw_request_lock);
 
 	return 0;
 }
@@ -166,6 +172,140 @@ int rockchip_dmcfreq_vop_bandwidth_request(struct dmcfreq_vop_info *vop_info)
 }
 EXPORT_SYMBOL(rockchip_dmcfreq_vop_bandwidth_request);
 
+static unsigned long bw_req_to_rate(unsigned int bw_mbyte)
+{
+	unsigned long target = 0;
+	int i;
+
+	if (!bw_mbyte)
+		return 0;
+
+	for (i = 0; common_info->bw_req_tbl[i].freq != DMCFREQ_TABLE_END; i++) {
+		if (bw_mbyte >= common_info->bw_req_tbl[i].min)
+			target = common_info->bw_req_tbl[i].freq;
+	}
+
+	return target;
+}
+
+static void bw_request_update_qos(struct rockchip_bw_request *req)
+{
+	bool raise = req->class == ROCKCHIP_BW_REALTIME && req->bw_mbyte &&
+		     common_info && common_info->bw_realtime_qos_prio;
+
+	if (raise == req->is_qos_raised || !req->dev)
+		return;
+
+	if (raise) {
+		if (!rockchip_raise_qos_priority(req->dev,
+						 common_info->bw_realtime_qos_prio))
+			req->is_qos_raised = true;
+	} else {
+		rockchip_reset_qos_priority(req->dev);
+		req->is_qos_raised = false;
+	}
+}
+
+/*
+ * Sum the declared bandwidth of all requests and turn it into a dmc rate.
+ * Background traffic alone may not raise the rate above
+ * bw_background_max_rate. Called with bw_request_lock held.
+ */
+static void bw_request_aggregate(void)
+{
+	struct rockchip_bw_request *req;
+	unsigned int fg_bw = 0, bg_bw = 0;
+	unsigned long last_rate, target, bg_target;
+
+	if (!common_info || !common_info->bw_req_tbl)
+		return;
+
+	list_for_each_entry(req, &bw_request_list, node) {
+		if (req->class == ROCKCHIP_BW_BACKGROUND)
+			bg_bw += req->bw_mbyte;
+		else
+			fg_bw += req->bw_mbyte;
+	}
+
+	target = bw_req_to_rate(fg_bw);
+	bg_target = bw_req_to_rate(fg_bw + bg_bw);
+	if (common_info->bw_background_max_rate)
+		bg_target = min(bg_target, common_info->bw_background_max_rate);
+	target = max(target, bg_target);
+
+	last_rate = common_info->bw_req_rate;
+	common_info->bw_req_rate = target;
+	dev_dbg(common_info->dev, "bw req fg=%u bg=%u rate=%lu\n",
+		fg_bw, bg_bw, target);
+
+	if (target > last_rate && common_info->auto_freq_en &&
+	    common_info->devfreq) {
+		mutex_lock(&common_info->devfreq->lock);
+		update_devfreq(common_info->devfreq);
+		mutex_unlock(&common_info->devfreq->lock);
+	}
+}
+
+/**
+ * rockchip_dmcfreq_bw_request_add() - register a bandwidth request
+ * @req: request owned by the caller, valid until removed
+ * @dev: master device, whose noc priority is raised for ROCKCHIP_BW_REALTIME
+ * @class: latency class of the master
+ *
+ * The request starts with no bandwidth, the driver declares its needs with
+ * rockchip_dmcfreq_bw_request_update() when it starts and stops a job.
+ */
+int rockchip_dmcfreq_bw_request_add(struct rockchip_bw_request *req,
+				    struct device *dev,
+				    enum rockchip_bw_class class)
+{
+	if (!req || class > ROCKCHIP_BW_REALTIME)
+		return -EINVAL;
+
+	req->dev = dev;
+	req->class = class;
+	req->bw_mbyte = 0;
+	req->is_qos_raised = false;
+
+	mutex_lock(&bw_request_lock);
+	list_add_tail(&req->node, &bw_request_list);
+	mutex_unlock(&bw_request_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(rockchip_dmcfreq_bw_request_add);
+
+/**
+ * rockchip_dmcfreq_bw_request_update() - change the declared bandwidth
+ * @req: registered request
+ * @bw_mbyte: bandwidth in MB/s, 0 when idle
+ *
+ * May sleep, the dmc rate is raised before returning.
+ */
+void rockchip_dmcfreq_bw_request_update(struct rockchip_bw_request *req,
+					unsigned int bw_mbyte)
+{
+	mutex_lock(&bw_request_lock);
+	if (req->bw_mbyte != bw_mbyte) {
+		req->bw_mbyte = bw_mbyte;
+		bw_request_update_qos(req);
+		bw_request_aggregate();
+	}
+	mutex_unlock(&bw_request_lock);
+}
+EXPORT_SYMBOL(rockchip_dmcfreq_bw_request_update);
+
+void rockchip_dmcfreq_bw_request_remove(struct rockchip_bw_request *req)
+{
+	mutex_lock(&bw_request_lock);
+	list_del(&req->node);
+	req->bw_mbyte = 0;
+	bw_request_update_qos(req);
+	bw_request_aggregate();
+	mutex_unlock(&bw_request_lock);
+}
+EXPORT_SYMBOL(rockchip_dmcfreq_bw_request_remove);
+
 unsigned int rockchip_dmcfreq_get_stall_time_ns(void)
 {
 	if (!common_info)
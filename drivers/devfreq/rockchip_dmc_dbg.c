@@ -13,6 +13,7 @@
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 
+#include <soc/rockchip/rockchip_dmc.h>
 #include <soc/rockchip/rockchip_sip.h>
 
 #include "rockchip_dmc_timing.h"
@@ -29,6 +30,7 @@
 #define PROC_DMCDBG_DRVODT			"drvodt"
 #define PROC_DMCDBG_DESKEW			"deskew"
 #define PROC_DMCDBG_REGS_INFO			"regsinfo"
+#define PROC_DMCDBG_TRANS_LATENCY		"translatency"
 
 #define DDRDBG_FUNC_GET_VERSION			(0x01)
 #define DDRDBG_FUNC_GET_SUPPORTED		(0x02)
@@ -914,6 +916,34 @@ static int proc_regsinfo_init(void)
 	return 0;
 }
 
+static int translatency_proc_show(struct seq_file *m, void *v)
+{
+	rockchip_dmcfreq_trans_latency_show(m);
+
+	return 0;
+}
+
+static int translatency_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, translatency_proc_show, NULL);
+}
+
+static const struct file_operations translatency_proc_fops = {
+	.open		= translatency_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int proc_translatency_init(void)
+{
+	/* create translatency file */
+	proc_create(PROC_DMCDBG_TRANS_LATENCY, 0444, proc_dmcdbg_dir,
+		    &translatency_proc_fops);
+
+	return 0;
+}
+
 static void rv1126_get_skew_parameter(void)
 {
 	struct skew_info_rv1126 *p_skew;
@@ -1010,6 +1040,7 @@ static __maybe_unused int rv1126_dmcdbg_init(struct platform_device *pdev,
 	proc_drvodt_init();
 	proc_skew_init();
 	proc_regsinfo_init();
+	proc_translatency_init();
 	return 0;
 }
 
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * DMA-BUF accounting by exporter, importer device and owner process.
+ *
+ * The counters are updated at export/release and attach/detach time, so
+ * reading them costs O(accounts) instead of a walk over every dma-buf under
+ * db_list.lock. Readers only take rcu_read_lock().
+ *
+ * Copyright (C) 2023 Rockchip Electronics Co. Ltd.
+ */
+
+#include <linux/atomic.h>
+#include <linux/device.h>
+#include <linux/dma-buf.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+
+#include "dma-buf-acct.h"
+
+#define DMA_BUF_ACCT_HASH_BITS	6
+
+struct dma_buf_acct {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	enum dma_buf_acct_type type;
+	pid_t pid;
+	u32 hash;
+	/* number of buffers, or of attachments for devices */
+	atomic_t count;
+	atomic_long_t bytes;
+	atomic_long_t peak;
+	char name[DMA_BUF_ACCT_NAME_LEN];
+};
+
+static DEFINE_HASHTABLE(dma_buf_acct_hash, DMA_BUF_ACCT_HASH_BITS);
+static DEFINE_SPINLOCK(dma_buf_acct_lock);
+
+static bool dma_buf_acct_match(struct dma_buf_acct *acct,
+			       enum dma_buf_acct_type type, pid_t pid,
+			       u32 hash, const char *name)
+{
+	return acct->hash == hash && acct->type == type && acct->pid == pid &&
+	       !strncmp(acct->name, name, DMA_BUF_ACCT_NAME_LEN - 1);
+}
+
+static struct dma_buf_acct *dma_buf_acct_lookup(enum dma_buf_acct_type type,
+						pid_t pid, u32 hash,
+						const char *name)
+{
+	struct dma_buf_acct *acct;
+
+	hash_for_each_possible_rcu(dma_buf_acct_hash, acct, node, hash) {
+		/* a zero count means the account is on its way out */
+		if (dma_buf_acct_match(acct, type, pid, hash, name) &&
+		    atomic_inc_not_zero(&acct->count))
+			return acct;
+	}
+
+	return NULL;
+}
+
+static struct dma_buf_acct *dma_buf_acct_get(enum dma_buf_acct_type type,
+					     pid_t pid, const char *name)
+{
+	struct dma_buf_acct *acct, *new;
+	u32 hash;
+
+	if (!name)
+		name = "<none>";
+
+	hash = jhash(name, strnlen(name, DMA_BUF_ACCT_NAME_LEN - 1),
+		     (u32)pid ^ type);
+
+	rcu_read_lock();
+	acct = dma_buf_acct_lookup(type, pid, hash, name);
+	rcu_read_unlock();
+	if (acct)
+		return acct;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return NULL;
+
+	new->type = type;
+	new->pid = pid;
+	new->hash = hash;
+	atomic_set(&new->count, 1);
+	strscpy(new->name, name, sizeof(new->name));
+
+	spin_lock(&dma_buf_acct_lock);
+	acct = dma_buf_acct_lookup(type, pid, hash, name);
+	if (!acct) {
+		hash_add_rcu(dma_buf_acct_hash, &new->node, hash);
+		acct = new;
+		new = NULL;
+	}
+	spin_unlock(&dma_buf_acct_lock);
+
+	kfree(new);
+
+	return acct;
+}
+
+static void dma_buf_acct_put(struct dma_buf_acct *acct)
+{
+	if (!acct)
+		return;
+
+	if (!atomic_dec_and_lock(&acct->count, &dma_buf_acct_lock))
+		return;
+
+	hash_del_rcu(&acct->node);
+	spin_unlock(&dma_buf_acct_lock);
+
+	kfree_rcu(acct, rcu);
+}
+
+static void dma_buf_acct_add(struct dma_buf_acct *acct, size_t size)
+{
+	long bytes, peak;
+
+	if (!acct)
+		return;
+
+	bytes = atomic_long_add_return(size, &acct->bytes);
+	peak = atomic_long_read(&acct->peak);
+	while (bytes > peak && !atomic_long_try_cmpxchg(&acct->peak, &peak, bytes))
+		;
+}
+
+static void dma_buf_acct_sub(struct dma_buf_acct *acct, size_t size)
+{
+	if (acct)
+		atomic_long_sub(size, &acct->bytes);
+}
+
+void dma_buf_acct_export(struct dma_buf *dmabuf)
+{
+	char comm[TASK_COMM_LEN];
+
+	dmabuf->acct[DMA_BUF_ACCT_EXPORTER] =
+		dma_buf_acct_get(DMA_BUF_ACCT_EXPORTER, 0, dmabuf->exp_name);
+	dma_buf_acct_add(dmabuf->acct[DMA_BUF_ACCT_EXPORTER], dmabuf->size);
+
+	get_task_comm(comm, current->group_leader);
+	dmabuf->acct[DMA_BUF_ACCT_PROCESS] =
+		dma_buf_acct_get(DMA_BUF_ACCT_PROCESS, task_tgid_nr(current), comm);
+	dma_buf_acct_add(dmabuf->acct[DMA_BUF_ACCT_PROCESS], dmabuf->size);
+}
+
+void dma_buf_acct_release(struct dma_buf *dmabuf)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(dmabuf->acct); i++) {
+		dma_buf_acct_sub(dmabuf->acct[i], dmabuf->size);
+		dma_buf_acct_put(dmabuf->acct[i]);
+		dmabuf->acct[i] = NULL;
+	}
+}
+
+void dma_buf_acct_attach(struct dma_buf_attachment *attach)
+{
+	attach->acct = dma_buf_acct_get(DMA_BUF_ACCT_DEVICE, 0,
+					dev_name(attach->dev));
+	dma_buf_acct_add(attach->acct, attach->dmabuf->size);
+}
+
+void dma_buf_acct_detach(struct dma_buf_attachment *attach)
+{
+	dma_buf_acct_sub(attach->acct, attach->dmabuf->size);
+	dma_buf_acct_put(attach->acct);
+	attach->acct = NULL;
+}
+
+/**
+ * dma_buf_acct_for_each - call @callback for every account of a type
+ * @type:	[in]	exporter, device or process accounts
+ * @callback:	[in]	called under rcu_read_lock(), must not sleep
+ * @private:	[in]	passed to @callback
+ *
+ * Stops at the first non-zero return of @callback and returns it.
+ */
+int dma_buf_acct_for_each(enum dma_buf_acct_type type,
+			  int (*callback)(const struct dma_buf_acct_info *info,
+					  void *private),
+			  void *private)
+{
+	struct dma_buf_acct_info info;
+	struct dma_buf_acct *acct;
+	int bkt, ret = 0;
+
+	rcu_read_lock();
+	hash_for_each_rcu(dma_buf_acct_hash, bkt, acct, node) {
+		if (acct->type != type)
+			continue;
+
+		info.name = acct->name;
+		info.pid = acct->pid;
+		info.count = atomic_read(&acct->count);
+		info.bytes = atomic_long_read(&acct->bytes);
+		info.peak = atomic_long_read(&acct->peak);
+		ret = callback(&info, private);
+		if (ret)
+			break;
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(dma_buf_acct_for_each);
+
+/**
+ * dma_buf_acct_reset_peak - restart peak tracking of every account
+ */
+void dma_buf_acct_reset_peak(void)
+{
+	struct dma_buf_acct *acct;
+	int bkt;
+
+	rcu_read_lock();
+	hash_for_each_rcu(dma_buf_acct_hash, bkt, acct, node)
+		atomic_long_set(&acct->peak, atomic_long_read(&acct->bytes));
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(dma_buf_acct_reset_peak);
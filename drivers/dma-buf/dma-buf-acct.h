@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * DMA-BUF accounting by exporter, importer device and owner process.
+ *
+ * Copyright (C) 2023 Rockchip Electronics Co. Ltd.
+ */
+
+#ifndef _DMA_BUF_ACCT_H
+#define _DMA_BUF_ACCT_H
+
+#include <linux/dma-buf.h>
+
+#if IS_ENABLED(CONFIG_RK_DMABUF_DEBUG)
+
+void dma_buf_acct_export(struct dma_buf *dmabuf);
+void dma_buf_acct_release(struct dma_buf *dmabuf);
+void dma_buf_acct_attach(struct dma_buf_attachment *attach);
+void dma_buf_acct_detach(struct dma_buf_attachment *attach);
+#else
+
+static inline void dma_buf_acct_export(struct dma_buf *dmabuf) {}
+static inline void dma_buf_acct_release(struct dma_buf *dmabuf) {}
+static inline void dma_buf_acct_attach(struct dma_buf_attachment *attach) {}
+static inline void dma_buf_acct_detach(struct dma_buf_attachment *attach) {}
+#endif
+#endif /* _DMA_BUF_ACCT_H */
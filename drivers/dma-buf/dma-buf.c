@@ -32,6 +32,7 @@
 #include <uapi/linux/dma-buf.h>
 #include <uapi/linux/magic.h>
 
+#include "dma-buf-acct.h"
 #include "dma-buf-sysfs-stats.h"
 
 static inline int is_dma_buf_file(struct file *);
@@ -83,32 +84,21 @@ static size_t db_peak_size;
 void dma_buf_reset_peak_size(void)
 {
 	mutex_lock(&db_list.lock);
-	db_peak_size = 0;
+	WRITE_ONCE(db_peak_size, 0);
 	mutex_unlock(&db_list.lock);
 }
 EXPORT_SYMBOL_GPL(dma_buf_reset_peak_size);
 
+/* written under db_list.lock, readers don't need it */
 size_t dma_buf_get_peak_size(void)
 {
-	size_t sz;
-
-	mutex_lock(&db_list.lock);
-	sz = db_peak_size;
-	mutex_unlock(&db_list.lock);
-
-	return sz;
+	return READ_ONCE(db_peak_size);
 }
 EXPORT_SYMBOL_GPL(dma_buf_get_peak_size);
 
 size_t dma_buf_get_total_size(void)
 {
-	size_t sz;
-
-	mutex_lock(&db_list.lock);
-	sz = db_total_size;
-	mutex_unlock(&db_list.lock);
-
-	return sz;
+	return READ_ONCE(db_total_size);
 }
 EXPORT_SYMBOL_GPL(dma_buf_get_total_size);
 #endif
@@ -178,10 +168,11 @@ static int dma_buf_file_release(struct inode *inode, struct file *file)
 	if (dmabuf) {
 		mutex_lock(&db_list.lock);
 #if IS_ENABLED(CONFIG_RK_DMABUF_DEBUG)
-		db_total_size -= dmabuf->size;
+		WRITE_ONCE(db_total_size, db_total_size - dmabuf->size);
 #endif
 		list_del(&dmabuf->list_node);
 		mutex_unlock(&db_list.lock);
+		dma_buf_acct_release(dmabuf);
 	}
 
 	return 0;
@@ -814,6 +805,7 @@ struct dma_buf *dma_buf_export(const struct dma_buf_export_info *exp_info)
 	dmabuf->size = exp_info->size;
 	dmabuf->exp_name = exp_info->exp_name;
 	dmabuf->owner = exp_info->owner;
+	dmabuf->uncached = exp_info->uncached;
 	spin_lock_init(&dmabuf->name_lock);
 #ifdef CONFIG_DMABUF_CACHE
 	mutex_init(&dmabuf->cache_lock);
@@ -842,11 +834,13 @@ struct dma_buf *dma_buf_export(const struct dma_buf_export_info *exp_info)
 	mutex_lock(&db_list.lock);
 	list_add(&dmabuf->list_node, &db_list.head);
 #if IS_ENABLED(CONFIG_RK_DMABUF_DEBUG)
-	db_total_size += dmabuf->size;
-	db_peak_size = max(db_total_size, db_peak_size);
+	WRITE_ONCE(db_total_size, db_total_size + dmabuf->size);
+	WRITE_ONCE(db_peak_size, max(db_total_size, db_peak_size));
 #endif
 	mutex_unlock(&db_list.lock);
 
+	dma_buf_acct_export(dmabuf);
+
 	if (IS_ENABLED(CONFIG_RK_DMABUF_DEBUG))
 		dma_buf_set_default_name(dmabuf);
 
@@ -1028,6 +1022,7 @@ dma_buf_dynamic_attach(struct dma_buf *dmabuf, struct device *dev,
 	dma_resv_lock(dmabuf->resv, NULL);
 	list_add(&attach->node, &dmabuf->attachments);
 	dma_resv_unlock(dmabuf->resv);
+	dma_buf_acct_attach(attach);
 
 	/* When either the importer or the exporter can't handle dynamic
 	 * mappings we cache the mapping here to avoid issues with the
@@ -1130,6 +1125,7 @@ void dma_buf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
 	dma_resv_lock(dmabuf->resv, NULL);
 	list_del(&attach->node);
 	dma_resv_unlock(dmabuf->resv);
+	dma_buf_acct_detach(attach);
 	if (dmabuf->ops->detach)
 		dmabuf->ops->detach(dmabuf, attach);
 
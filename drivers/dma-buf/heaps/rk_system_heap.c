@@ -15,10 +15,13 @@
 #include <linux/dma-mapping.h>
 #include <linux/dma-heap.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/shrinker.h>
 #include <linux/slab.h>
 #include <linux/swiotlb.h>
 #include <linux/vmalloc.h>
@@ -74,6 +77,30 @@ static unsigned int orders[] = {8, 4, 0};
 struct dmabuf_page_pool *pools[NUM_ORDERS];
 struct dmabuf_page_pool *dma32_pools[NUM_ORDERS];
 
+/*
+ * Per-order watermarks of the system pools, in pool items (pages of the
+ * matching order). When a pool drops below its low watermark the refill
+ * thread tops it up to the high watermark with pre-zeroed pages, so that
+ * stream start does not have to zero the buffers in the allocation path.
+ * All zero (the default) disables the background refill.
+ */
+static unsigned int pool_low_wmark[NUM_ORDERS];
+module_param_array(pool_low_wmark, uint, NULL, 0644);
+MODULE_PARM_DESC(pool_low_wmark, "per order pool low watermark in pages of {1M, 64K, 4K}");
+
+static unsigned int pool_high_wmark[NUM_ORDERS];
+module_param_array(pool_high_wmark, uint, NULL, 0644);
+MODULE_PARM_DESC(pool_high_wmark, "per order pool high watermark in pages of {1M, 64K, 4K}");
+
+/* how long the refill backs off after the shrinker ran */
+static unsigned int refill_backoff_ms = 1000;
+module_param(refill_backoff_ms, uint, 0644);
+MODULE_PARM_DESC(refill_backoff_ms, "pool refill back off time after memory pressure");
+
+static struct task_struct *refill_task;
+static DECLARE_WAIT_QUEUE_HEAD(refill_wait);
+static unsigned long refill_backoff;
+
 static struct sg_table *dup_sg_table(struct sg_table *table)
 {
 	struct sg_table *new_table;
@@ -471,6 +498,125 @@ static void system_heap_dma_buf_release(struct dma_buf *dmabuf)
 	deferred_free(&buffer->deferred_free, system_heap_buf_free, npages);
 }
 
+static int system_heap_pool_count(struct dmabuf_page_pool *pool)
+{
+	return READ_ONCE(pool->count[POOL_LOWPAGE]) +
+	       READ_ONCE(pool->count[POOL_HIGHPAGE]);
+}
+
+static bool system_heap_refill_backoff(void)
+{
+	return time_before(jiffies, READ_ONCE(refill_backoff));
+}
+
+static void system_heap_refill_defer(void)
+{
+	WRITE_ONCE(refill_backoff, jiffies + msecs_to_jiffies(refill_backoff_ms));
+}
+
+static bool system_heap_need_refill(void)
+{
+	int i;
+
+	if (system_heap_refill_backoff())
+		return false;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (system_heap_pool_count(pools[i]) < pool_low_wmark[i])
+			return true;
+	}
+
+	return false;
+}
+
+static void system_heap_refill_pools(void)
+{
+	struct dmabuf_page_pool *pool;
+	struct page *page;
+	unsigned int high;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		pool = pools[i];
+		high = max(pool_low_wmark[i], pool_high_wmark[i]);
+
+		while (system_heap_pool_count(pool) < high) {
+			if (kthread_should_stop() || system_heap_refill_backoff())
+				return;
+
+			/*
+			 * The pool gfp_mask carries __GFP_ZERO, so the pages
+			 * land in the pool already zeroed. Don't push into
+			 * reclaim from the background, give up instead.
+			 */
+			page = alloc_pages(pool->gfp_mask | __GFP_NOWARN | __GFP_NORETRY,
+					   pool->order);
+			if (!page) {
+				system_heap_refill_defer();
+				return;
+			}
+
+			dmabuf_page_pool_free(pool, page);
+			cond_resched();
+		}
+	}
+}
+
+static int system_heap_refill_thread(void *data)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(refill_wait, system_heap_need_refill() ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		system_heap_refill_pools();
+	}
+
+	return 0;
+}
+
+static void system_heap_wake_refill(struct dmabuf_page_pool **pool)
+{
+	if (refill_task && pool == pools && system_heap_need_refill())
+		wake_up(&refill_wait);
+}
+
+/*
+ * The pages themselves are given back by the dmabuf page pool shrinker,
+ * this one only keeps the refill thread from putting them right back
+ * while the system is short on memory.
+ */
+static unsigned long system_heap_refill_count(struct shrinker *shrinker,
+					      struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (pool_low_wmark[i] || pool_high_wmark[i])
+			count += system_heap_pool_count(pools[i]) << pools[i]->order;
+	}
+
+	return count;
+}
+
+static unsigned long system_heap_refill_scan(struct shrinker *shrinker,
+					     struct shrink_control *sc)
+{
+	system_heap_refill_defer();
+
+	return SHRINK_STOP;
+}
+
+static struct shrinker system_heap_refill_shrinker = {
+	.count_objects = system_heap_refill_count,
+	.scan_objects = system_heap_refill_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static const struct dma_buf_ops system_heap_buf_ops = {
 	.attach = system_heap_attach,
 	.detach = system_heap_detach,
@@ -609,12 +755,15 @@ static struct dma_buf *system_heap_do_allocate(struct dma_heap *heap,
 	exp_info.size = buffer->len;
 	exp_info.flags = fd_flags;
 	exp_info.priv = buffer;
+	exp_info.uncached = buffer->uncached;
 	dmabuf = dma_buf_export(&exp_info);
 	if (IS_ERR(dmabuf)) {
 		ret = PTR_ERR(dmabuf);
 		goto free_pages;
 	}
 
+	system_heap_wake_refill(buffer->pools);
+
 	/*
 	 * For uncached buffers, we need to initially flush cpu cache, since
 	 * the __GFP_ZERO on the allocation means the zeroing was done by the
@@ -830,6 +979,19 @@ static int system_heap_create(void)
 		bank_bit_mask = ddr_map_info->bank_bit_mask;
 	}
 
+	if (register_shrinker(&system_heap_refill_shrinker, "system-heap-refill")) {
+		pr_warn("%s: pool refill disabled\n", __func__);
+		return 0;
+	}
+
+	refill_task = kthread_run(system_heap_refill_thread, NULL, "system_heap_refill");
+	if (IS_ERR(refill_task)) {
+		pr_warn("%s: pool refill thread failed\n", __func__);
+		unregister_shrinker(&system_heap_refill_shrinker);
+		refill_task = NULL;
+		return 0;
+	}
+
 	return 0;
 err_dma32_pool:
 	for (i = 0; i < NUM_ORDERS; i++)
@@ -32,18 +32,38 @@
 
 #define RK3588_SRAM_BASE 0xff001000
 
+/*
+ * Bytes of sram only handed out to SRAM_HEAP_FLAG_HOT allocations, so a
+ * burst of bulk buffers can not push the latency critical ones to ddr.
+ */
+static unsigned int hot_reserve;
+module_param(hot_reserve, uint, 0644);
+MODULE_PARM_DESC(hot_reserve, "sram bytes reserved for hot allocations");
+
 struct sram_dma_heap {
 	struct dma_heap *heap;
 	struct gen_pool *pool;
 };
 
+struct sram_heap_client {
+	const char *name;
+	spinlock_t lock;
+	size_t quota;
+	size_t used;
+	size_t peak;
+	unsigned long fallback_cnt;
+};
+
 struct sram_dma_heap_buffer {
 	struct gen_pool *pool;
+	struct sram_heap_client *client;
 	struct list_head attachments;
 	struct mutex attachments_lock;
 	unsigned long len;
 	void *vaddr;
 	phys_addr_t paddr;
+	/* SRAM_HEAP_FLAG_FALLBACK_DDR buffer backed by cached pages */
+	bool ddr;
 };
 
 struct dma_heap_attachment {
@@ -79,7 +99,8 @@ static int dma_heap_attach(struct dma_buf *dmabuf,
 	 *
 	 * page cannot support kmap func.
 	 */
-	sg_set_page(table->sgl, pfn_to_page(PFN_DOWN(buffer->paddr)), buffer->len, 0);
+	sg_set_page(table->sgl, pfn_to_page(PFN_DOWN(buffer->paddr)), buffer->len,
+		    offset_in_page(buffer->paddr));
 
 	a->table = table;
 	a->dev = attachment->dev;
@@ -118,11 +139,14 @@ static void dma_heap_detatch(struct dma_buf *dmabuf,
 static struct sg_table *dma_heap_map_dma_buf(struct dma_buf_attachment *attachment,
 					     enum dma_data_direction direction)
 {
+	struct sram_dma_heap_buffer *buffer = attachment->dmabuf->priv;
 	struct dma_heap_attachment *a = attachment->priv;
 	struct sg_table *table = a->table;
 	int ret = 0;
 
-	ret = dma_map_sgtable(attachment->dev, table, direction, DMA_ATTR_SKIP_CPU_SYNC);
+	/* only the ddr fall back is cached */
+	ret = dma_map_sgtable(attachment->dev, table, direction,
+			      buffer->ddr ? 0 : DMA_ATTR_SKIP_CPU_SYNC);
 	if (ret)
 		return ERR_PTR(-ENOMEM);
 
@@ -133,22 +157,84 @@ static void dma_heap_unmap_dma_buf(struct dma_buf_attachment *attachment,
 				   struct sg_table *table,
 				   enum dma_data_direction direction)
 {
-	dma_unmap_sgtable(attachment->dev, table, direction, DMA_ATTR_SKIP_CPU_SYNC);
+	struct sram_dma_heap_buffer *buffer = attachment->dmabuf->priv;
+
+	dma_unmap_sgtable(attachment->dev, table, direction,
+			  buffer->ddr ? 0 : DMA_ATTR_SKIP_CPU_SYNC);
 }
 
-static void dma_heap_dma_buf_release(struct dma_buf *dmabuf)
+static int dma_heap_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
+					     enum dma_data_direction direction)
 {
 	struct sram_dma_heap_buffer *buffer = dmabuf->priv;
+	struct dma_heap_attachment *a;
 
-	gen_pool_free(buffer->pool, (unsigned long)buffer->vaddr, buffer->len);
+	if (!buffer->ddr)
+		return 0;
+
+	mutex_lock(&buffer->attachments_lock);
+	list_for_each_entry(a, &buffer->attachments, list)
+		dma_sync_sgtable_for_cpu(a->dev, a->table, direction);
+	mutex_unlock(&buffer->attachments_lock);
+
+	return 0;
+}
+
+static int dma_heap_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
+					   enum dma_data_direction direction)
+{
+	struct sram_dma_heap_buffer *buffer = dmabuf->priv;
+	struct dma_heap_attachment *a;
+
+	if (!buffer->ddr)
+		return 0;
+
+	mutex_lock(&buffer->attachments_lock);
+	list_for_each_entry(a, &buffer->attachments, list)
+		dma_sync_sgtable_for_device(a->dev, a->table, direction);
+	mutex_unlock(&buffer->attachments_lock);
+
+	return 0;
+}
+
+static void sram_heap_buffer_free(struct sram_dma_heap_buffer *buffer)
+{
+	struct sram_heap_client *client = buffer->client;
+
+	if (buffer->ddr)
+		free_pages_exact(buffer->vaddr, buffer->len);
+	else
+		gen_pool_free(buffer->pool, (unsigned long)buffer->vaddr, buffer->len);
+
+	if (client) {
+		spin_lock(&client->lock);
+		client->used -= buffer->len;
+		spin_unlock(&client->lock);
+	}
 	kfree(buffer);
 }
 
+static void dma_heap_dma_buf_release(struct dma_buf *dmabuf)
+{
+	sram_heap_buffer_free(dmabuf->priv);
+}
+
 static int dma_heap_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
 {
 	struct sram_dma_heap_buffer *buffer = dmabuf->priv;
 	int ret;
 
+	/* a sub-page buffer shares its page with other clients */
+	if (!PAGE_ALIGNED(buffer->paddr) || !PAGE_ALIGNED(buffer->len))
+		return -EINVAL;
+
+	if (vma->vm_end - vma->vm_start > buffer->len)
+		return -EINVAL;
+
+	if (buffer->ddr)
+		return remap_pfn_range(vma, vma->vm_start, PFN_DOWN(buffer->paddr),
+				       vma->vm_end - vma->vm_start, vma->vm_page_prot);
+
 	/* SRAM mappings are not cached */
 	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
@@ -171,41 +257,108 @@ static const struct dma_buf_ops sram_dma_heap_buf_ops = {
 	.detach = dma_heap_detatch,
 	.map_dma_buf = dma_heap_map_dma_buf,
 	.unmap_dma_buf = dma_heap_unmap_dma_buf,
+	.begin_cpu_access = dma_heap_dma_buf_begin_cpu_access,
+	.end_cpu_access = dma_heap_dma_buf_end_cpu_access,
 	.release = dma_heap_dma_buf_release,
 	.mmap = dma_heap_mmap,
 	.vmap = dma_heap_vmap,
 };
 
-static struct dma_buf *sram_dma_heap_allocate(struct dma_heap *heap,
-				unsigned long len,
-				unsigned long fd_flags,
-				unsigned long heap_flags)
+static unsigned long sram_heap_pool_alloc(struct gen_pool *pool, size_t len,
+					  size_t align)
+{
+	struct genpool_data_align data = { .align = align };
+
+	if (!align)
+		return gen_pool_alloc(pool, len);
+
+	return gen_pool_alloc_algo(pool, len, gen_pool_first_fit_align, &data);
+}
+
+static bool sram_heap_client_charge(struct sram_heap_client *client, size_t len)
+{
+	bool ok = true;
+
+	if (!client)
+		return true;
+
+	spin_lock(&client->lock);
+	if (client->quota && client->used + len > client->quota) {
+		ok = false;
+	} else {
+		client->used += len;
+		client->peak = max(client->peak, client->used);
+	}
+	spin_unlock(&client->lock);
+
+	return ok;
+}
+
+static struct dma_buf *sram_heap_buffer_export(struct sram_dma_heap *sram_dma_heap,
+					       struct sram_heap_client *client,
+					       size_t len, size_t align,
+					       unsigned int flags,
+					       unsigned long fd_flags)
 {
-	struct sram_dma_heap *sram_dma_heap = dma_heap_get_drvdata(heap);
 	struct sram_dma_heap_buffer *buffer;
 
 	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
 	struct dma_buf *dmabuf;
+	bool charged = false;
 	int ret = -ENOMEM;
 
+	if (!sram_dma_heap && !(flags & SRAM_HEAP_FLAG_FALLBACK_DDR))
+		return ERR_PTR(-ENODEV);
+
 	buffer = kzalloc(sizeof(*buffer), GFP_KERNEL);
 	if (!buffer)
 		return ERR_PTR(-ENOMEM);
-	buffer->pool = sram_dma_heap->pool;
+	buffer->pool = sram_dma_heap ? sram_dma_heap->pool : NULL;
 	INIT_LIST_HEAD(&buffer->attachments);
 	mutex_init(&buffer->attachments_lock);
 	buffer->len = len;
 
-	buffer->vaddr = (void *)gen_pool_alloc(buffer->pool, buffer->len);
+	/* cold buffers leave hot_reserve bytes of the sram untouched */
+	if (buffer->pool && ((flags & SRAM_HEAP_FLAG_HOT) ||
+	    gen_pool_avail(buffer->pool) >= len + READ_ONCE(hot_reserve)))
+		charged = sram_heap_client_charge(client, len);
+
+	if (charged) {
+		buffer->vaddr = (void *)sram_heap_pool_alloc(buffer->pool, len, align);
+		if (buffer->vaddr) {
+			buffer->client = client;
+		} else if (client) {
+			spin_lock(&client->lock);
+			client->used -= len;
+			spin_unlock(&client->lock);
+		}
+	}
+
+	if (!buffer->vaddr && (flags & SRAM_HEAP_FLAG_FALLBACK_DDR)) {
+		buffer->vaddr = alloc_pages_exact(len, GFP_KERNEL | __GFP_ZERO);
+		if (buffer->vaddr) {
+			buffer->ddr = true;
+			buffer->paddr = virt_to_phys(buffer->vaddr);
+			if (client) {
+				spin_lock(&client->lock);
+				client->fallback_cnt++;
+				spin_unlock(&client->lock);
+			}
+		}
+	}
+
 	if (!buffer->vaddr) {
 		ret = -ENOMEM;
 		goto free_buffer;
 	}
 
-	buffer->paddr = gen_pool_virt_to_phys(buffer->pool, (unsigned long)buffer->vaddr);
-	if (buffer->paddr == -1) {
-		ret = -ENOMEM;
-		goto free_pool;
+	if (!buffer->ddr) {
+		buffer->paddr = gen_pool_virt_to_phys(buffer->pool,
+						      (unsigned long)buffer->vaddr);
+		if (buffer->paddr == -1) {
+			ret = -ENOMEM;
+			goto free_pool;
+		}
 	}
 
 	/* create the dmabuf */
@@ -222,13 +375,24 @@ static struct dma_buf *sram_dma_heap_allocate(struct dma_heap *heap,
 	return dmabuf;
 
 free_pool:
-	gen_pool_free(buffer->pool, (unsigned long)buffer->vaddr, buffer->len);
+	sram_heap_buffer_free(buffer);
+	return ERR_PTR(ret);
 free_buffer:
 	kfree(buffer);
 
 	return ERR_PTR(ret);
 }
 
+static struct dma_buf *sram_dma_heap_allocate(struct dma_heap *heap,
+				unsigned long len,
+				unsigned long fd_flags,
+				unsigned long heap_flags)
+{
+	struct sram_dma_heap *sram_dma_heap = dma_heap_get_drvdata(heap);
+
+	return sram_heap_buffer_export(sram_dma_heap, NULL, len, 0, 0, fd_flags);
+}
+
 static struct dma_heap_ops sram_dma_heap_ops = {
 	.allocate = sram_dma_heap_allocate,
 };
@@ -267,52 +431,7 @@ static int sram_dma_heap_export(const char *name,
 
 struct dma_buf *sram_heap_alloc_dma_buf(size_t size)
 {
-	struct sram_dma_heap *sram_dma_heap = sram_dma_heap_global;
-	struct sram_dma_heap_buffer *buffer;
-
-	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
-	struct dma_buf *dmabuf;
-	int ret = -ENOMEM;
-
-	buffer = kzalloc(sizeof(*buffer), GFP_KERNEL);
-	if (!buffer)
-		return ERR_PTR(-ENOMEM);
-
-	buffer->pool = sram_dma_heap->pool;
-	INIT_LIST_HEAD(&buffer->attachments);
-	mutex_init(&buffer->attachments_lock);
-	buffer->len = size;
-
-	buffer->vaddr = (void *)gen_pool_alloc(buffer->pool, buffer->len);
-	if (!buffer->vaddr) {
-		ret = -ENOMEM;
-		goto free_buffer;
-	}
-
-	buffer->paddr = gen_pool_virt_to_phys(buffer->pool, (unsigned long)buffer->vaddr);
-	if (buffer->paddr == -1) {
-		ret = -ENOMEM;
-		goto free_pool;
-	}
-
-	/* create the dmabuf */
-	exp_info.ops = &sram_dma_heap_buf_ops;
-	exp_info.size = buffer->len;
-	exp_info.priv = buffer;
-	dmabuf = dma_buf_export(&exp_info);
-	if (IS_ERR(dmabuf)) {
-		ret = PTR_ERR(dmabuf);
-		goto free_pool;
-	}
-
-	return dmabuf;
-
-free_pool:
-	gen_pool_free(buffer->pool, (unsigned long)buffer->vaddr, buffer->len);
-free_buffer:
-	kfree(buffer);
-
-	return ERR_PTR(ret);
+	return sram_heap_buffer_export(sram_dma_heap_global, NULL, size, 0, 0, 0);
 }
 EXPORT_SYMBOL_GPL(sram_heap_alloc_dma_buf);
 
@@ -387,6 +506,63 @@ void sram_heap_free_dma_buf(struct dma_buf *dmabuf)
 }
 EXPORT_SYMBOL_GPL(sram_heap_free_dma_buf);
 
+struct sram_heap_client *sram_heap_client_create(const char *name, size_t quota)
+{
+	struct sram_heap_client *client;
+
+	client = kzalloc(sizeof(*client), GFP_KERNEL);
+	if (!client)
+		return ERR_PTR(-ENOMEM);
+
+	client->name = name;
+	client->quota = quota;
+	spin_lock_init(&client->lock);
+
+	return client;
+}
+EXPORT_SYMBOL_GPL(sram_heap_client_create);
+
+void sram_heap_client_destroy(struct sram_heap_client *client)
+{
+	if (IS_ERR_OR_NULL(client))
+		return;
+
+	WARN(client->used, "%s destroyed with %zu sram bytes in use\n",
+	     client->name, client->used);
+	pr_debug("%s peak %zu of %zu bytes, %lu ddr fall backs\n", client->name,
+		 client->peak, client->quota, client->fallback_cnt);
+	kfree(client);
+}
+EXPORT_SYMBOL_GPL(sram_heap_client_destroy);
+
+struct dma_buf *sram_heap_client_alloc(struct sram_heap_client *client,
+				       size_t size, size_t align,
+				       unsigned int flags)
+{
+	if (!size)
+		return ERR_PTR(-EINVAL);
+
+	/*
+	 * Round to an alignment class, so buffers of a class pack next to
+	 * each other and small ones stay off page boundaries.
+	 */
+	align = roundup_pow_of_two(max_t(size_t, align, SRAM_HEAP_ALIGN_MIN));
+	if (align > PAGE_SIZE)
+		return ERR_PTR(-EINVAL);
+
+	return sram_heap_buffer_export(sram_dma_heap_global, client,
+				       ALIGN(size, align), align, flags, 0);
+}
+EXPORT_SYMBOL_GPL(sram_heap_client_alloc);
+
+bool sram_heap_is_sram(struct dma_buf *dmabuf)
+{
+	struct sram_dma_heap_buffer *buffer = dmabuf->priv;
+
+	return !buffer->ddr;
+}
+EXPORT_SYMBOL_GPL(sram_heap_is_sram);
+
 void *sram_heap_get_vaddr(struct dma_buf *dmabuf)
 {
 	struct sram_dma_heap_buffer *buffer = dmabuf->priv;
@@ -19,23 +19,61 @@
 #include <linux/err.h>
 #include <linux/highmem.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <uapi/linux/rk-dma-heap.h>
 #include <linux/proc_fs.h>
 #include "../../../mm/cma.h"
 #include "rk-dma-heap.h"
 
+/*
+ * Place allocations in the smallest free extent that fits instead of the
+ * first one, so that large extents stay available for large video buffers.
+ */
+static bool best_fit = true;
+module_param(best_fit, bool, 0644);
+MODULE_PARM_DESC(best_fit, "best fit placement of cma heap allocations");
+
+/*
+ * Migrate the movable pages the buddy allocator borrowed out of the largest
+ * free extents, up to this much memory, so that allocating from them later
+ * does not pay the migration. 0 disables the background compaction.
+ */
+static unsigned int compact_kb;
+module_param(compact_kb, uint, 0644);
+MODULE_PARM_DESC(compact_kb, "free cma kept migrated out in the background, in KiB");
+
+static unsigned int compact_interval_ms = 10000;
+module_param(compact_interval_ms, uint, 0644);
+MODULE_PARM_DESC(compact_interval_ms, "background cma compaction interval");
+
+struct rk_cma_heap_stats {
+	u64 alloc_count;
+	u64 alloc_fail;
+	u64 alloc_ns;
+	u64 alloc_max_ns;
+	u64 best_fit_miss;
+	u64 compact_runs;
+	u64 compact_pages;
+	u64 compact_ns;
+};
+
 struct rk_cma_heap {
 	struct rk_dma_heap *heap;
 	struct cma *cma;
+	struct delayed_work compact_work;
+	spinlock_t stats_lock;
+	struct rk_cma_heap_stats stats;
 };
 
 struct rk_cma_heap_buffer {
 	struct rk_cma_heap *heap;
+	struct cma *cma;
 	struct list_head attachments;
 	struct mutex lock;
 	unsigned long len;
@@ -400,8 +438,9 @@ static void rk_cma_heap_dma_buf_release(struct dma_buf *dmabuf)
 	/* free page list */
 	kfree(buffer->pages);
 	/* release memory */
-	cma_release(cma_heap->cma, buffer->cma_pages, buffer->pagecount);
+	cma_release(buffer->cma, buffer->cma_pages, buffer->pagecount);
 	rk_dma_heap_total_dec(heap, buffer->len);
+	rk_cma_heap_kick_compact(cma_heap);
 
 	kfree(buffer);
 }
@@ -424,6 +463,136 @@ static const struct dma_buf_ops rk_cma_heap_buf_ops = {
 	.release = rk_cma_heap_dma_buf_release,
 };
 
+static unsigned long rk_cma_bitmap_count(struct cma *cma, unsigned long pages)
+{
+	return ALIGN(pages, 1UL << cma->order_per_bit) >> cma->order_per_bit;
+}
+
+/*
+ * Smallest free extent of the bitmap that holds @bits bits at the alignment,
+ * the bits are set on success. Called with cma->lock held.
+ */
+static long rk_cma_best_fit_reserve(struct cma *cma, unsigned long bits,
+				    unsigned int align)
+{
+	unsigned long maxno = cma_bitmap_maxno(cma);
+	unsigned long mask = 0, offset = 0;
+	unsigned long start, end, pos;
+	long best = -1;
+	unsigned long best_len = ULONG_MAX;
+
+	if (align > cma->order_per_bit) {
+		mask = (1UL << (align - cma->order_per_bit)) - 1;
+		offset = (cma->base_pfn & ((1UL << align) - 1)) >> cma->order_per_bit;
+	}
+
+	for (start = find_first_zero_bit(cma->bitmap, maxno); start < maxno;
+	     start = find_next_zero_bit(cma->bitmap, maxno, end)) {
+		end = find_next_bit(cma->bitmap, maxno, start);
+		pos = ALIGN(start + offset, mask + 1) - offset;
+		if (pos + bits > end)
+			continue;
+
+		if (end - start < best_len) {
+			best = pos;
+			best_len = end - start;
+			if (best_len == bits)
+				break;
+		}
+	}
+
+	if (best >= 0)
+		bitmap_set(cma->bitmap, best, bits);
+
+	return best;
+}
+
+static struct page *rk_cma_heap_best_fit_alloc(struct cma *cma,
+					       unsigned long count,
+					       unsigned int align)
+{
+	unsigned long bits = rk_cma_bitmap_count(cma, count);
+	unsigned long pfn;
+	long bitno;
+	int ret;
+
+	spin_lock_irq(&cma->lock);
+	bitno = rk_cma_best_fit_reserve(cma, bits, align);
+	spin_unlock_irq(&cma->lock);
+	if (bitno < 0)
+		return NULL;
+
+	pfn = cma->base_pfn + (bitno << cma->order_per_bit);
+	ret = alloc_contig_range(pfn, pfn + count, MIGRATE_CMA,
+				 GFP_KERNEL | __GFP_NOWARN);
+	if (!ret)
+		return pfn_to_page(pfn);
+
+	spin_lock_irq(&cma->lock);
+	bitmap_clear(cma->bitmap, bitno, bits);
+	spin_unlock_irq(&cma->lock);
+
+	return NULL;
+}
+
+/*
+ * Best fit first, a busy extent (pinned movable pages) falls back to the
+ * first fit search of cma_alloc(), which retries across the whole area.
+ */
+static struct page *rk_cma_heap_alloc_range(struct rk_cma_heap *cma_heap,
+					    struct cma *cma,
+					    unsigned long count,
+					    unsigned int align)
+{
+	struct rk_cma_heap_stats *stats = &cma_heap->stats;
+	struct page *page = NULL;
+	bool miss = false;
+	ktime_t start;
+	u64 ns;
+
+	start = ktime_get();
+	if (best_fit) {
+		page = rk_cma_heap_best_fit_alloc(cma, count, align);
+		miss = !page;
+	}
+	if (!page)
+		page = cma_alloc(cma, count, align, GFP_KERNEL);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&cma_heap->stats_lock);
+	stats->alloc_count++;
+	if (!page)
+		stats->alloc_fail++;
+	if (miss)
+		stats->best_fit_miss++;
+	stats->alloc_ns += ns;
+	stats->alloc_max_ns = max(stats->alloc_max_ns, ns);
+	spin_unlock(&cma_heap->stats_lock);
+
+	return page;
+}
+
+static void rk_cma_heap_kick_compact(struct rk_cma_heap *cma_heap)
+{
+	if (READ_ONCE(compact_kb))
+		mod_delayed_work(system_unbound_wq, &cma_heap->compact_work,
+				 msecs_to_jiffies(compact_interval_ms));
+}
+
+static struct cma *rk_cma_heap_select_cma(struct rk_cma_heap *cma_heap,
+					  unsigned long heap_flags)
+{
+	unsigned int ch;
+
+	if (!(heap_flags & RK_DMA_HEAP_FLAG_CHANNEL_LOCAL))
+		return cma_heap->cma;
+
+	ch = (heap_flags & RK_DMA_HEAP_FLAG_CHANNEL_MASK) >>
+	     RK_DMA_HEAP_FLAG_CHANNEL_SHIFT;
+
+	return rk_dma_heap_get_channel_cma(ch);
+}
+
 static struct dma_buf *rk_cma_heap_allocate(struct rk_dma_heap *heap,
 					    unsigned long len,
 					    unsigned long fd_flags,
@@ -438,9 +607,14 @@ static struct dma_buf *rk_cma_heap_allocate(struct rk_dma_heap *heap,
 	unsigned long align = get_order(size);
 	struct page *cma_pages;
 	struct dma_buf *dmabuf;
+	struct cma *cma;
 	pgoff_t pg;
 	int ret = -ENOMEM;
 
+	cma = rk_cma_heap_select_cma(cma_heap, heap_flags);
+	if (!cma)
+		return ERR_PTR(-ENODEV);
+
 	buffer = kzalloc(sizeof(*buffer), GFP_KERNEL);
 	if (!buffer)
 		return ERR_PTR(-ENOMEM);
@@ -448,11 +622,12 @@ static struct dma_buf *rk_cma_heap_allocate(struct rk_dma_heap *heap,
 	INIT_LIST_HEAD(&buffer->attachments);
 	mutex_init(&buffer->lock);
 	buffer->len = size;
+	buffer->cma = cma;
 
 	if (align > CONFIG_DMABUF_HEAPS_ROCKCHIP_CMA_ALIGNMENT)
 		align = CONFIG_DMABUF_HEAPS_ROCKCHIP_CMA_ALIGNMENT;
 
-	cma_pages = cma_alloc(cma_heap->cma, pagecount, align, GFP_KERNEL);
+	cma_pages = rk_cma_heap_alloc_range(cma_heap, cma, pagecount, align);
 	if (!cma_pages)
 		goto free_buffer;
 
@@ -523,7 +698,7 @@ static struct dma_buf *rk_cma_heap_allocate(struct rk_dma_heap *heap,
 free_pages:
 	kfree(buffer->pages);
 free_cma:
-	cma_release(cma_heap->cma, cma_pages, pagecount);
+	cma_release(cma, cma_pages, pagecount);
 free_buffer:
 	kfree(buffer);
 
@@ -543,7 +718,7 @@ static struct page *rk_cma_heap_allocate_pages(struct rk_dma_heap *heap,
 	if (align > CONFIG_DMABUF_HEAPS_ROCKCHIP_CMA_ALIGNMENT)
 		align = CONFIG_DMABUF_HEAPS_ROCKCHIP_CMA_ALIGNMENT;
 
-	page = cma_alloc(cma_heap->cma, pagecount, align, GFP_KERNEL);
+	page = rk_cma_heap_alloc_range(cma_heap, cma_heap->cma, pagecount, align);
 	if (!page)
 		return ERR_PTR(-ENOMEM);
 
@@ -570,6 +745,7 @@ static void rk_cma_heap_free_pages(struct rk_dma_heap *heap,
 	cma_release(cma_heap->cma, page, pagecount);
 
 	rk_dma_heap_total_dec(heap, len);
+	rk_cma_heap_kick_compact(cma_heap);
 }
 
 static const struct rk_dma_heap_ops rk_cma_heap_ops = {
@@ -579,6 +755,8 @@ static const struct rk_dma_heap_ops rk_cma_heap_ops = {
 };
 
 static int cma_procfs_show(struct seq_file *s, void *private);
+static int cma_frag_show(struct seq_file *s, void *private);
+static void rk_cma_heap_compact_work(struct work_struct *work);
 
 static int __rk_add_cma_heap(struct cma *cma, void *data)
 {
@@ -589,6 +767,8 @@ static int __rk_add_cma_heap(struct cma *cma, void *data)
 	if (!cma_heap)
 		return -ENOMEM;
 	cma_heap->cma = cma;
+	spin_lock_init(&cma_heap->stats_lock);
+	INIT_DELAYED_WORK(&cma_heap->compact_work, rk_cma_heap_compact_work);
 
 	exp_info.name = cma_get_name(cma);
 	exp_info.ops = &rk_cma_heap_ops;
@@ -603,9 +783,14 @@ static int __rk_add_cma_heap(struct cma *cma, void *data)
 		return ret;
 	}
 
-	if (cma_heap->heap->procfs)
+	if (cma_heap->heap->procfs) {
 		proc_create_single_data("alloc_bitmap", 0, cma_heap->heap->procfs,
 					cma_procfs_show, cma);
+		proc_create_single_data("frag", 0, cma_heap->heap->procfs,
+					cma_frag_show, cma_heap);
+	}
+
+	rk_cma_heap_kick_compact(cma_heap);
 
 	return 0;
 }
@@ -613,11 +798,27 @@ static int __rk_add_cma_heap(struct cma *cma, void *data)
 static int __init rk_add_default_cma_heap(void)
 {
 	struct cma *cma = rk_dma_heap_get_cma();
+	unsigned int ch;
+	int ret;
 
 	if (WARN_ON(!cma))
 		return -EINVAL;
 
-	return __rk_add_cma_heap(cma, NULL);
+	ret = __rk_add_cma_heap(cma, NULL);
+	if (ret)
+		return ret;
+
+	/* channel local heaps, also reachable through the channel heap_flags */
+	for (ch = 0; ch < RK_DMA_HEAP_CHANNEL_MAX; ch++) {
+		cma = rk_dma_heap_get_channel_cma(ch);
+		if (!cma)
+			continue;
+
+		if (__rk_add_cma_heap(cma, NULL))
+			pr_warn("%s: channel %u heap failed\n", __func__, ch);
+	}
+
+	return 0;
 }
 
 #if defined(CONFIG_VIDEO_ROCKCHIP_THUNDER_BOOT_ISP) && !defined(CONFIG_INITCALL_ASYNC)
@@ -685,3 +886,119 @@ static int cma_procfs_show(struct seq_file *s, void *private)
 
 MODULE_DESCRIPTION("RockChip DMA-BUF CMA Heap");
 MODULE_LICENSE("GPL v2");
+
+/*
+ * Largest free extent of the area in bitmap bits, its first bit in @first,
+ * and the number of free extents in @nr. Called with cma->lock held.
+ */
+static unsigned long cma_largest_free(struct cma *cma, unsigned long *first,
+				      unsigned long *nr)
+{
+	unsigned long maxno = cma_bitmap_maxno(cma);
+	unsigned long start, end, largest = 0;
+
+	*first = 0;
+	*nr = 0;
+	for (start = find_first_zero_bit(cma->bitmap, maxno); start < maxno;
+	     start = find_next_zero_bit(cma->bitmap, maxno, end)) {
+		end = find_next_bit(cma->bitmap, maxno, start);
+		if (end - start > largest) {
+			largest = end - start;
+			*first = start;
+		}
+		(*nr)++;
+	}
+
+	return largest;
+}
+
+static int cma_frag_show(struct seq_file *s, void *private)
+{
+	struct rk_cma_heap *cma_heap = s->private;
+	struct cma *cma = cma_heap->cma;
+	struct rk_cma_heap_stats stats;
+	unsigned long largest, first, nr;
+
+	spin_lock_irq(&cma->lock);
+	largest = cma_largest_free(cma, &first, &nr) << cma->order_per_bit;
+	spin_unlock_irq(&cma->lock);
+
+	spin_lock(&cma_heap->stats_lock);
+	stats = cma_heap->stats;
+	spin_unlock(&cma_heap->stats_lock);
+
+	seq_printf(s, "Largest free: %lu KiB\n", largest << (PAGE_SHIFT - 10));
+	seq_printf(s, "Free extents: %lu\n", nr);
+	seq_printf(s, "Allocations: %llu failed: %llu best fit busy: %llu\n",
+		   stats.alloc_count, stats.alloc_fail, stats.best_fit_miss);
+	seq_printf(s, "Alloc time: avg %llu us max %llu us\n",
+		   stats.alloc_count ?
+		   div_u64(div64_u64(stats.alloc_ns, stats.alloc_count), NSEC_PER_USEC) : 0,
+		   div_u64(stats.alloc_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "Compaction: runs %llu migrated %llu KiB time %llu us\n",
+		   stats.compact_runs, stats.compact_pages << (PAGE_SHIFT - 10),
+		   div_u64(stats.compact_ns, NSEC_PER_USEC));
+
+	return 0;
+}
+
+/*
+ * Take the pageblocks of the largest free extent through
+ * alloc_contig_range() and give them straight back, which migrates out the
+ * movable pages the buddy allocator borrowed from it. The bits are set while
+ * a pageblock is held, cma allocations in the meantime just skip it.
+ */
+static void rk_cma_heap_compact_work(struct work_struct *work)
+{
+	struct rk_cma_heap *cma_heap =
+		container_of(to_delayed_work(work), struct rk_cma_heap, compact_work);
+	unsigned long budget = (unsigned long)READ_ONCE(compact_kb) >> (PAGE_SHIFT - 10);
+	struct cma *cma = cma_heap->cma;
+	unsigned long block = pageblock_nr_pages;
+	unsigned long bits = rk_cma_bitmap_count(cma, block);
+	unsigned long first, nr, len, pfn, end_pfn, bitno, done = 0;
+	ktime_t start = ktime_get();
+
+	if (!budget)
+		return;
+
+	spin_lock_irq(&cma->lock);
+	len = cma_largest_free(cma, &first, &nr);
+	spin_unlock_irq(&cma->lock);
+
+	pfn = ALIGN(cma->base_pfn + (first << cma->order_per_bit), block);
+	end_pfn = cma->base_pfn + ((first + len) << cma->order_per_bit);
+	for (; pfn + block <= end_pfn && done < budget; pfn += block) {
+		bitno = (pfn - cma->base_pfn) >> cma->order_per_bit;
+
+		spin_lock_irq(&cma->lock);
+		if (find_next_bit(cma->bitmap, bitno + bits, bitno) < bitno + bits) {
+			/* allocated meanwhile */
+			spin_unlock_irq(&cma->lock);
+			continue;
+		}
+		bitmap_set(cma->bitmap, bitno, bits);
+		spin_unlock_irq(&cma->lock);
+
+		if (!alloc_contig_range(pfn, pfn + block, MIGRATE_CMA,
+					GFP_KERNEL | __GFP_NOWARN)) {
+			free_contig_range(pfn, block);
+			done += block;
+		}
+
+		spin_lock_irq(&cma->lock);
+		bitmap_clear(cma->bitmap, bitno, bits);
+		spin_unlock_irq(&cma->lock);
+
+		cond_resched();
+	}
+
+	spin_lock(&cma_heap->stats_lock);
+	cma_heap->stats.compact_runs++;
+	cma_heap->stats.compact_pages += done;
+	cma_heap->stats.compact_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock(&cma_heap->stats_lock);
+
+	queue_delayed_work(system_unbound_wq, &cma_heap->compact_work,
+			   msecs_to_jiffies(compact_interval_ms));
+}
@@ -18,6 +18,11 @@ static unsigned long rk_dma_heap_base __initdata;
 
 static struct cma *rk_dma_heap_cma;
 
+static unsigned long rk_dma_heap_ch_size[RK_DMA_HEAP_CHANNEL_MAX] __initdata;
+static unsigned long rk_dma_heap_ch_base[RK_DMA_HEAP_CHANNEL_MAX] __initdata;
+
+static struct cma *rk_dma_heap_ch_cma[RK_DMA_HEAP_CHANNEL_MAX];
+
 static int __init early_dma_heap_cma(char *p)
 {
 	if (!p) {
@@ -35,6 +40,41 @@ static int __init early_dma_heap_cma(char *p)
 }
 early_param("rk_dma_heap_cma", early_dma_heap_cma);
 
+/*
+ * rk_dma_heap_cma_ch=size@base[,size@base...], one area per DDR channel in
+ * channel order. The areas must sit in address ranges the DDR controller
+ * maps to a single channel, an empty entry skips that channel.
+ */
+static int __init early_dma_heap_cma_ch(char *p)
+{
+	unsigned int ch = 0;
+
+	if (!p) {
+		pr_err("Config string not provided\n");
+		return -EINVAL;
+	}
+
+	while (*p && ch < RK_DMA_HEAP_CHANNEL_MAX) {
+		if (*p != ',') {
+			rk_dma_heap_ch_size[ch] = memparse(p, &p);
+			if (*p != '@') {
+				pr_err("rk_dma_heap_cma_ch: channel %u needs a base\n", ch);
+				rk_dma_heap_ch_size[ch] = 0;
+				return -EINVAL;
+			}
+			rk_dma_heap_ch_base[ch] = memparse(p + 1, &p);
+		}
+
+		if (*p != ',')
+			break;
+		p++;
+		ch++;
+	}
+
+	return 0;
+}
+early_param("rk_dma_heap_cma_ch", early_dma_heap_cma_ch);
+
 #ifndef CONFIG_DMA_CMA
 void __weak
 dma_contiguous_early_fixup(phys_addr_t base, unsigned long size)
@@ -42,6 +82,33 @@ dma_contiguous_early_fixup(phys_addr_t base, unsigned long size)
 }
 #endif
 
+static void __init rk_dma_heap_channel_cma_setup(void)
+{
+	char name[RK_DMA_HEAP_NAME_LEN];
+	unsigned int ch;
+	int ret;
+
+	for (ch = 0; ch < RK_DMA_HEAP_CHANNEL_MAX; ch++) {
+		if (!rk_dma_heap_ch_size[ch])
+			continue;
+
+		snprintf(name, sizeof(name), "rk-dma-heap-ch%u", ch);
+		ret = cma_declare_contiguous(rk_dma_heap_ch_base[ch],
+					     PAGE_ALIGN(rk_dma_heap_ch_size[ch]),
+					     0x0, PAGE_SIZE, 0, true, name,
+					     &rk_dma_heap_ch_cma[ch]);
+		if (ret) {
+			pr_err("%s: channel %u area failed %d\n", __func__, ch, ret);
+			continue;
+		}
+
+#if !IS_ENABLED(CONFIG_CMA_INACTIVE)
+		dma_contiguous_early_fixup(cma_get_base(rk_dma_heap_ch_cma[ch]),
+					   cma_get_size(rk_dma_heap_ch_cma[ch]));
+#endif
+	}
+}
+
 int __init rk_dma_heap_cma_setup(void)
 {
 	unsigned long size;
@@ -68,6 +135,8 @@ int __init rk_dma_heap_cma_setup(void)
 	cma_get_size(rk_dma_heap_cma));
 #endif
 
+	rk_dma_heap_channel_cma_setup();
+
 	return 0;
 }
 
@@ -75,3 +144,11 @@ struct cma *rk_dma_heap_get_cma(void)
 {
 	return rk_dma_heap_cma;
 }
+
+struct cma *rk_dma_heap_get_channel_cma(unsigned int ch)
+{
+	if (ch >= RK_DMA_HEAP_CHANNEL_MAX)
+		return NULL;
+
+	return rk_dma_heap_ch_cma[ch];
+}
@@ -252,8 +252,32 @@ static long rk_dma_heap_ioctl_allocate(struct file *file, void *data)
 	return 0;
 }
 
+static long rk_dma_heap_ioctl_create_pool(struct file *file, void *data)
+{
+	struct rk_dma_heap_pool_data *pool_data = data;
+	struct rk_dma_heap *heap = file->private_data;
+
+	if (!heap->ops->create_pool)
+		return -ENOTTY;
+
+	if (pool_data->fd)
+		return -EINVAL;
+
+	if (pool_data->fd_flags & ~O_CLOEXEC)
+		return -EINVAL;
+
+	if (pool_data->flags & ~RK_DMA_HEAP_VALID_POOL_FLAGS)
+		return -EINVAL;
+
+	if (!pool_data->count || !PAGE_ALIGN(pool_data->size))
+		return -EINVAL;
+
+	return heap->ops->create_pool(heap, pool_data);
+}
+
 static unsigned int rk_dma_heap_ioctl_cmds[] = {
 	RK_DMA_HEAP_IOCTL_ALLOC,
+	RK_DMA_HEAP_IOCTL_POOL_CREATE,
 };
 
 static long rk_dma_heap_ioctl(struct file *file, unsigned int ucmd,
@@ -302,6 +326,9 @@ static long rk_dma_heap_ioctl(struct file *file, unsigned int ucmd,
 	case RK_DMA_HEAP_IOCTL_ALLOC:
 		ret = rk_dma_heap_ioctl_allocate(file, kdata);
 		break;
+	case RK_DMA_HEAP_IOCTL_POOL_CREATE:
+		ret = rk_dma_heap_ioctl_create_pool(file, kdata);
+		break;
 	default:
 		ret = -ENOTTY;
 		goto err;
@@ -25,6 +25,9 @@
 #endif
 
 #define RK_DMA_HEAP_NAME_LEN 16
+#define RK_DMA_HEAP_CHANNEL_MAX 4
+
+struct rk_dma_heap_pool_data;
 
 struct rk_vmap_pfn_data {
 	unsigned long	pfn; /* first pfn of contiguous */
@@ -35,6 +38,7 @@ struct rk_vmap_pfn_data {
  * struct rk_dma_heap_ops - ops to operate on a given heap
  * @allocate:		allocate dmabuf and return struct dma_buf ptr
  * @get_pool_size:	if heap maintains memory pools, get pool size in bytes
+ * @create_pool:	create a pool of fixed size buffers, fill in data->fd
  *
  * allocate returns dmabuf on success, ERR_PTR(-errno) on error.
  */
@@ -50,6 +54,8 @@ struct rk_dma_heap_ops {
 				  struct page *pages, size_t len,
 				  const char *name);
 	long (*get_pool_size)(struct rk_dma_heap *heap);
+	int (*create_pool)(struct rk_dma_heap *heap,
+			   struct rk_dma_heap_pool_data *data);
 };
 
 /**
@@ -175,4 +181,11 @@ void rk_dma_heap_total_dec(struct rk_dma_heap *heap, size_t len);
  * rk_dma_heap_get_cma - get cma structure
  */
 struct cma *rk_dma_heap_get_cma(void);
+/**
+ * rk_dma_heap_get_channel_cma - get cma structure local to a DDR channel
+ * @ch:		DDR channel index
+ *
+ * Returns NULL if no area was declared for @ch.
+ */
+struct cma *rk_dma_heap_get_channel_cma(unsigned int ch);
 #endif /* _DMA_HEAPS_H */
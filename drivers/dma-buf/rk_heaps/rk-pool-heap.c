@@ -0,0 +1,685 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * DMABUF pool heap exporter
+ *
+ * Pools of fixed size buffers for video pipelines. The buffers of a pool
+ * are allocated once when the pool is created, a released dmabuf gives its
+ * buffer back to the pool and keeps the device mappings, so taking a buffer
+ * out of the pool again neither touches the page allocator nor the IOMMU.
+ *
+ * Copyright (C) 2023 Rockchip Electronics Co. Ltd.
+ */
+
+#include <linux/anon_inodes.h>
+#include <linux/device.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/highmem.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <uapi/linux/rk-dma-heap.h>
+
+#include "rk-dma-heap.h"
+
+#define RK_POOL_HEAP_MAX_BUFFERS	128
+
+#define LOW_ORDER_GFP (GFP_HIGHUSER | __GFP_ZERO)
+#define HIGH_ORDER_GFP  (((GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN \
+				| __GFP_NORETRY) & ~__GFP_RECLAIM) \
+				| __GFP_COMP)
+static gfp_t order_flags[] = {HIGH_ORDER_GFP, HIGH_ORDER_GFP, LOW_ORDER_GFP};
+static const unsigned int orders[] = {8, 4, 0};
+#define NUM_ORDERS ARRAY_SIZE(orders)
+
+struct rk_pool_heap_pool;
+
+/* a device mapping kept across reuses of the buffer */
+struct rk_pool_heap_map {
+	struct list_head node;
+	struct device *dev;
+	struct sg_table table;
+};
+
+struct rk_pool_heap_buffer {
+	struct rk_pool_heap_pool *pool;
+	struct list_head node;		/* on pool free_list while unused */
+	struct list_head attachments;
+	struct list_head maps;
+	struct mutex lock;
+	struct sg_table sg_table;
+	int vmap_cnt;
+	void *vaddr;
+};
+
+struct rk_pool_heap_attachment {
+	struct device *dev;
+	struct rk_pool_heap_map *map;
+	struct list_head list;
+	bool mapped;
+};
+
+struct rk_pool_heap_pool {
+	struct rk_dma_heap *heap;
+	struct kref refcount;
+	spinlock_t lock;
+	struct list_head free_list;
+	unsigned long size;
+	unsigned int count;
+	bool uncached;
+	struct rk_pool_heap_buffer *buffers[];
+};
+
+static struct rk_dma_heap *pool_heap;
+
+static struct rk_pool_heap_map *
+rk_pool_heap_get_map(struct rk_pool_heap_buffer *buffer, struct device *dev)
+{
+	struct sg_table *table = &buffer->sg_table;
+	struct scatterlist *sg, *new_sg;
+	struct rk_pool_heap_map *map;
+	int i, ret;
+
+	list_for_each_entry(map, &buffer->maps, node) {
+		if (map->dev == dev)
+			return map;
+	}
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return ERR_PTR(-ENOMEM);
+
+	ret = sg_alloc_table(&map->table, table->orig_nents, GFP_KERNEL);
+	if (ret)
+		goto free_map;
+
+	new_sg = map->table.sgl;
+	for_each_sgtable_sg(table, sg, i) {
+		sg_set_page(new_sg, sg_page(sg), sg->length, sg->offset);
+		new_sg = sg_next(new_sg);
+	}
+
+	/* cache maintenance is done per map/unmap, see below */
+	ret = dma_map_sgtable(dev, &map->table, DMA_BIDIRECTIONAL,
+			      DMA_ATTR_SKIP_CPU_SYNC);
+	if (ret)
+		goto free_table;
+
+	map->dev = get_device(dev);
+	list_add(&map->node, &buffer->maps);
+
+	return map;
+
+free_table:
+	sg_free_table(&map->table);
+free_map:
+	kfree(map);
+
+	return ERR_PTR(ret);
+}
+
+static void rk_pool_heap_put_maps(struct rk_pool_heap_buffer *buffer)
+{
+	struct rk_pool_heap_map *map, *tmp;
+
+	list_for_each_entry_safe(map, tmp, &buffer->maps, node) {
+		dma_unmap_sgtable(map->dev, &map->table, DMA_BIDIRECTIONAL,
+				  DMA_ATTR_SKIP_CPU_SYNC);
+		sg_free_table(&map->table);
+		put_device(map->dev);
+		list_del(&map->node);
+		kfree(map);
+	}
+}
+
+static int rk_pool_heap_attach(struct dma_buf *dmabuf,
+			       struct dma_buf_attachment *attachment)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	struct rk_pool_heap_attachment *a;
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if (!a)
+		return -ENOMEM;
+
+	a->dev = attachment->dev;
+	INIT_LIST_HEAD(&a->list);
+	attachment->priv = a;
+
+	mutex_lock(&buffer->lock);
+	list_add(&a->list, &buffer->attachments);
+	mutex_unlock(&buffer->lock);
+
+	return 0;
+}
+
+static void rk_pool_heap_detach(struct dma_buf *dmabuf,
+				struct dma_buf_attachment *attachment)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	struct rk_pool_heap_attachment *a = attachment->priv;
+
+	mutex_lock(&buffer->lock);
+	list_del(&a->list);
+	mutex_unlock(&buffer->lock);
+
+	kfree(a);
+}
+
+static struct sg_table *rk_pool_heap_map_dma_buf(struct dma_buf_attachment *attachment,
+						 enum dma_data_direction direction)
+{
+	struct rk_pool_heap_attachment *a = attachment->priv;
+	struct rk_pool_heap_buffer *buffer = attachment->dmabuf->priv;
+	struct rk_pool_heap_map *map;
+
+	mutex_lock(&buffer->lock);
+	map = rk_pool_heap_get_map(buffer, a->dev);
+	if (!IS_ERR(map)) {
+		a->map = map;
+		a->mapped = true;
+	}
+	mutex_unlock(&buffer->lock);
+	if (IS_ERR(map))
+		return ERR_CAST(map);
+
+	if (!buffer->pool->uncached)
+		dma_sync_sgtable_for_device(a->dev, &map->table, direction);
+
+	return &map->table;
+}
+
+static void rk_pool_heap_unmap_dma_buf(struct dma_buf_attachment *attachment,
+				       struct sg_table *table,
+				       enum dma_data_direction direction)
+{
+	struct rk_pool_heap_attachment *a = attachment->priv;
+	struct rk_pool_heap_buffer *buffer = attachment->dmabuf->priv;
+
+	/* the mapping itself stays until the pool goes away */
+	if (!buffer->pool->uncached)
+		dma_sync_sgtable_for_cpu(a->dev, table, direction);
+
+	mutex_lock(&buffer->lock);
+	a->mapped = false;
+	mutex_unlock(&buffer->lock);
+}
+
+static int rk_pool_heap_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
+						 enum dma_data_direction direction)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	struct rk_pool_heap_attachment *a;
+
+	if (buffer->pool->uncached)
+		return 0;
+
+	mutex_lock(&buffer->lock);
+
+	if (buffer->vmap_cnt)
+		invalidate_kernel_vmap_range(buffer->vaddr, buffer->pool->size);
+
+	list_for_each_entry(a, &buffer->attachments, list) {
+		if (!a->mapped)
+			continue;
+		dma_sync_sgtable_for_cpu(a->dev, &a->map->table, direction);
+	}
+	mutex_unlock(&buffer->lock);
+
+	return 0;
+}
+
+static int rk_pool_heap_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
+					       enum dma_data_direction direction)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	struct rk_pool_heap_attachment *a;
+
+	if (buffer->pool->uncached)
+		return 0;
+
+	mutex_lock(&buffer->lock);
+
+	if (buffer->vmap_cnt)
+		flush_kernel_vmap_range(buffer->vaddr, buffer->pool->size);
+
+	list_for_each_entry(a, &buffer->attachments, list) {
+		if (!a->mapped)
+			continue;
+		dma_sync_sgtable_for_device(a->dev, &a->map->table, direction);
+	}
+	mutex_unlock(&buffer->lock);
+
+	return 0;
+}
+
+static int rk_pool_heap_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	struct sg_table *table = &buffer->sg_table;
+	unsigned long addr = vma->vm_start;
+	struct sg_page_iter piter;
+	int ret;
+
+	if (buffer->pool->uncached)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	for_each_sgtable_page(table, &piter, vma->vm_pgoff) {
+		struct page *page = sg_page_iter_page(&piter);
+
+		ret = remap_pfn_range(vma, addr, page_to_pfn(page), PAGE_SIZE,
+				      vma->vm_page_prot);
+		if (ret)
+			return ret;
+		addr += PAGE_SIZE;
+		if (addr >= vma->vm_end)
+			return 0;
+	}
+
+	return 0;
+}
+
+static void *rk_pool_heap_do_vmap(struct rk_pool_heap_buffer *buffer)
+{
+	struct sg_table *table = &buffer->sg_table;
+	int npages = PAGE_ALIGN(buffer->pool->size) / PAGE_SIZE;
+	struct page **pages = vmalloc(sizeof(struct page *) * npages);
+	struct page **tmp = pages;
+	struct sg_page_iter piter;
+	pgprot_t pgprot = PAGE_KERNEL;
+	void *vaddr;
+
+	if (!pages)
+		return ERR_PTR(-ENOMEM);
+
+	if (buffer->pool->uncached)
+		pgprot = pgprot_writecombine(PAGE_KERNEL);
+
+	for_each_sgtable_page(table, &piter, 0) {
+		WARN_ON(tmp - pages >= npages);
+		*tmp++ = sg_page_iter_page(&piter);
+	}
+
+	vaddr = vmap(pages, npages, VM_MAP, pgprot);
+	vfree(pages);
+
+	if (!vaddr)
+		return ERR_PTR(-ENOMEM);
+
+	return vaddr;
+}
+
+static int rk_pool_heap_vmap(struct dma_buf *dmabuf, struct iosys_map *map)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	void *vaddr;
+	int ret = 0;
+
+	mutex_lock(&buffer->lock);
+	if (buffer->vmap_cnt) {
+		buffer->vmap_cnt++;
+		iosys_map_set_vaddr(map, buffer->vaddr);
+		goto out;
+	}
+
+	vaddr = rk_pool_heap_do_vmap(buffer);
+	if (IS_ERR(vaddr)) {
+		ret = PTR_ERR(vaddr);
+		goto out;
+	}
+
+	buffer->vaddr = vaddr;
+	buffer->vmap_cnt++;
+	iosys_map_set_vaddr(map, buffer->vaddr);
+out:
+	mutex_unlock(&buffer->lock);
+
+	return ret;
+}
+
+static void rk_pool_heap_vunmap(struct dma_buf *dmabuf, struct iosys_map *map)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+
+	mutex_lock(&buffer->lock);
+	if (!--buffer->vmap_cnt) {
+		vunmap(buffer->vaddr);
+		buffer->vaddr = NULL;
+	}
+	mutex_unlock(&buffer->lock);
+	iosys_map_clear(map);
+}
+
+static void rk_pool_heap_free_buffer(struct rk_pool_heap_buffer *buffer)
+{
+	struct sg_table *table = &buffer->sg_table;
+	struct scatterlist *sg;
+	int i;
+
+	rk_pool_heap_put_maps(buffer);
+
+	for_each_sgtable_sg(table, sg, i) {
+		struct page *page = sg_page(sg);
+
+		__free_pages(page, compound_order(page));
+	}
+	sg_free_table(table);
+	kfree(buffer);
+}
+
+static void rk_pool_heap_pool_release(struct kref *ref)
+{
+	struct rk_pool_heap_pool *pool =
+		container_of(ref, struct rk_pool_heap_pool, refcount);
+	unsigned int i;
+
+	for (i = 0; i < pool->count; i++)
+		rk_pool_heap_free_buffer(pool->buffers[i]);
+
+	rk_dma_heap_total_dec(pool->heap, pool->size * pool->count);
+	kfree(pool);
+}
+
+static void rk_pool_heap_dma_buf_release(struct dma_buf *dmabuf)
+{
+	struct rk_pool_heap_buffer *buffer = dmabuf->priv;
+	struct rk_pool_heap_pool *pool = buffer->pool;
+
+	if (buffer->vmap_cnt > 0) {
+		WARN(1, "%s: buffer still mapped in the kernel\n", __func__);
+		vunmap(buffer->vaddr);
+		buffer->vaddr = NULL;
+		buffer->vmap_cnt = 0;
+	}
+
+	spin_lock(&pool->lock);
+	list_add_tail(&buffer->node, &pool->free_list);
+	spin_unlock(&pool->lock);
+
+	kref_put(&pool->refcount, rk_pool_heap_pool_release);
+}
+
+static const struct dma_buf_ops rk_pool_heap_buf_ops = {
+	.attach = rk_pool_heap_attach,
+	.detach = rk_pool_heap_detach,
+	.map_dma_buf = rk_pool_heap_map_dma_buf,
+	.unmap_dma_buf = rk_pool_heap_unmap_dma_buf,
+	.begin_cpu_access = rk_pool_heap_dma_buf_begin_cpu_access,
+	.end_cpu_access = rk_pool_heap_dma_buf_end_cpu_access,
+	.mmap = rk_pool_heap_mmap,
+	.vmap = rk_pool_heap_vmap,
+	.vunmap = rk_pool_heap_vunmap,
+	.release = rk_pool_heap_dma_buf_release,
+};
+
+static struct dma_buf *rk_pool_heap_pool_alloc(struct rk_pool_heap_pool *pool,
+					       unsigned long fd_flags)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+	struct rk_pool_heap_buffer *buffer;
+	struct dma_buf *dmabuf;
+
+	spin_lock(&pool->lock);
+	buffer = list_first_entry_or_null(&pool->free_list,
+					  struct rk_pool_heap_buffer, node);
+	if (buffer)
+		list_del_init(&buffer->node);
+	spin_unlock(&pool->lock);
+
+	if (!buffer)
+		return ERR_PTR(-EAGAIN);
+
+	kref_get(&pool->refcount);
+
+	exp_info.exp_name = rk_dma_heap_get_name(pool->heap);
+	exp_info.ops = &rk_pool_heap_buf_ops;
+	exp_info.size = pool->size;
+	exp_info.flags = fd_flags;
+	exp_info.priv = buffer;
+	exp_info.uncached = pool->uncached;
+	dmabuf = dma_buf_export(&exp_info);
+	if (IS_ERR(dmabuf)) {
+		spin_lock(&pool->lock);
+		list_add(&buffer->node, &pool->free_list);
+		spin_unlock(&pool->lock);
+		kref_put(&pool->refcount, rk_pool_heap_pool_release);
+	}
+
+	return dmabuf;
+}
+
+static long rk_pool_heap_pool_ioctl(struct file *file, unsigned int cmd,
+				    unsigned long arg)
+{
+	struct rk_pool_heap_pool *pool = file->private_data;
+	struct rk_dma_heap_pool_alloc_data data;
+	struct dma_buf *dmabuf;
+	int fd;
+
+	if (cmd != RK_DMA_HEAP_POOL_IOCTL_ALLOC)
+		return -ENOTTY;
+
+	if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+		return -EFAULT;
+
+	if (data.fd || (data.fd_flags & ~RK_DMA_HEAP_VALID_FD_FLAGS))
+		return -EINVAL;
+
+	dmabuf = rk_pool_heap_pool_alloc(pool, data.fd_flags);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	fd = dma_buf_fd(dmabuf, data.fd_flags);
+	if (fd < 0) {
+		dma_buf_put(dmabuf);
+		return fd;
+	}
+
+	data.fd = fd;
+	if (copy_to_user((void __user *)arg, &data, sizeof(data)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int rk_pool_heap_pool_file_release(struct inode *inode, struct file *file)
+{
+	struct rk_pool_heap_pool *pool = file->private_data;
+
+	kref_put(&pool->refcount, rk_pool_heap_pool_release);
+
+	return 0;
+}
+
+static const struct file_operations rk_pool_heap_pool_fops = {
+	.owner		= THIS_MODULE,
+	.release	= rk_pool_heap_pool_file_release,
+	.unlocked_ioctl	= rk_pool_heap_pool_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl	= rk_pool_heap_pool_ioctl,
+#endif
+};
+
+static struct page *alloc_largest_available(unsigned long size,
+					    unsigned int max_order)
+{
+	struct page *page;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (size <  (PAGE_SIZE << orders[i]))
+			continue;
+		if (max_order < orders[i])
+			continue;
+
+		page = alloc_pages(order_flags[i], orders[i]);
+		if (!page)
+			continue;
+		return page;
+	}
+	return NULL;
+}
+
+static struct rk_pool_heap_buffer *
+rk_pool_heap_alloc_buffer(struct rk_pool_heap_pool *pool)
+{
+	struct rk_pool_heap_buffer *buffer;
+	unsigned long size_remaining = pool->size;
+	unsigned int max_order = orders[0];
+	struct page *page, *tmp_page;
+	struct list_head pages;
+	struct scatterlist *sg;
+	int i = 0;
+
+	buffer = kzalloc(sizeof(*buffer), GFP_KERNEL);
+	if (!buffer)
+		return NULL;
+
+	INIT_LIST_HEAD(&buffer->node);
+	INIT_LIST_HEAD(&buffer->attachments);
+	INIT_LIST_HEAD(&buffer->maps);
+	mutex_init(&buffer->lock);
+	buffer->pool = pool;
+
+	INIT_LIST_HEAD(&pages);
+	while (size_remaining > 0) {
+		if (fatal_signal_pending(current))
+			goto free_pages;
+
+		page = alloc_largest_available(size_remaining, max_order);
+		if (!page)
+			goto free_pages;
+
+		list_add_tail(&page->lru, &pages);
+		size_remaining -= page_size(page);
+		max_order = compound_order(page);
+		i++;
+	}
+
+	if (sg_alloc_table(&buffer->sg_table, i, GFP_KERNEL))
+		goto free_pages;
+
+	sg = buffer->sg_table.sgl;
+	list_for_each_entry_safe(page, tmp_page, &pages, lru) {
+		sg_set_page(sg, page, page_size(page), 0);
+		sg = sg_next(sg);
+		list_del(&page->lru);
+	}
+
+	/*
+	 * The pages were zeroed through the cache, flush them once here for
+	 * uncached pools, no cache maintenance is done afterwards.
+	 */
+	if (pool->uncached) {
+		struct device *dev = rk_dma_heap_get_dev(pool->heap);
+
+		dma_map_sgtable(dev, &buffer->sg_table, DMA_BIDIRECTIONAL, 0);
+		dma_unmap_sgtable(dev, &buffer->sg_table, DMA_BIDIRECTIONAL, 0);
+	}
+
+	return buffer;
+
+free_pages:
+	list_for_each_entry_safe(page, tmp_page, &pages, lru)
+		__free_pages(page, compound_order(page));
+	kfree(buffer);
+
+	return NULL;
+}
+
+static int rk_pool_heap_create_pool(struct rk_dma_heap *heap,
+				    struct rk_dma_heap_pool_data *data)
+{
+	struct rk_pool_heap_pool *pool;
+	unsigned int i;
+	int fd;
+
+	if (data->count > RK_POOL_HEAP_MAX_BUFFERS)
+		return -EINVAL;
+
+	pool = kzalloc(struct_size(pool, buffers, data->count), GFP_KERNEL);
+	if (!pool)
+		return -ENOMEM;
+
+	pool->heap = heap;
+	kref_init(&pool->refcount);
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->free_list);
+	pool->size = PAGE_ALIGN(data->size);
+	pool->uncached = data->flags & RK_DMA_HEAP_POOL_UNCACHED;
+
+	for (i = 0; i < data->count; i++) {
+		pool->buffers[i] = rk_pool_heap_alloc_buffer(pool);
+		if (!pool->buffers[i])
+			goto free_buffers;
+		list_add_tail(&pool->buffers[i]->node, &pool->free_list);
+		pool->count++;
+	}
+
+	rk_dma_heap_total_inc(heap, pool->size * pool->count);
+
+	fd = anon_inode_getfd("rk_dma_heap_pool", &rk_pool_heap_pool_fops, pool,
+			      O_RDWR | data->fd_flags);
+	if (fd < 0) {
+		kref_put(&pool->refcount, rk_pool_heap_pool_release);
+		return fd;
+	}
+
+	data->fd = fd;
+
+	return 0;
+
+free_buffers:
+	for (i = 0; i < pool->count; i++)
+		rk_pool_heap_free_buffer(pool->buffers[i]);
+	kfree(pool);
+
+	return -ENOMEM;
+}
+
+static struct dma_buf *rk_pool_heap_allocate(struct rk_dma_heap *heap,
+					     unsigned long len,
+					     unsigned long fd_flags,
+					     unsigned long heap_flags,
+					     const char *name)
+{
+	/* buffers only come out of pools, see RK_DMA_HEAP_IOCTL_POOL_CREATE */
+	return ERR_PTR(-EINVAL);
+}
+
+static const struct rk_dma_heap_ops rk_pool_heap_ops = {
+	.allocate = rk_pool_heap_allocate,
+	.create_pool = rk_pool_heap_create_pool,
+};
+
+static int __init rk_pool_heap_init(void)
+{
+	struct rk_dma_heap_export_info exp_info;
+	int ret;
+
+	exp_info.name = "pool";
+	exp_info.ops = &rk_pool_heap_ops;
+	exp_info.priv = NULL;
+	exp_info.support_cma = false;
+
+	pool_heap = rk_dma_heap_add(&exp_info);
+	if (IS_ERR(pool_heap))
+		return PTR_ERR(pool_heap);
+
+	ret = rk_dma_heap_set_dev(rk_dma_heap_get_dev(pool_heap));
+	if (ret) {
+		rk_dma_heap_put(pool_heap);
+		return ret;
+	}
+
+	return 0;
+}
+module_init(rk_pool_heap_init);
+MODULE_DESCRIPTION("Rockchip DMA-BUF pool heap");
+MODULE_LICENSE("GPL v2");
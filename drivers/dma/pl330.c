@@ -546,6 +546,8 @@ struct dma_pl330_desc {
 
 	/* For cyclic capability */
 	bool cyclic;
+	/* cyclic without DMA_PREP_INTERRUPT, no event per period */
+	bool quiet;
 	size_t num_periods;
 
 	/* interleaved size */
@@ -1469,7 +1471,8 @@ static int _period(struct pl330_dmac *pl330, unsigned int dry_run, u8 buf[],
 		}
 	}
 
-	off += _emit_SEV(dry_run, &buf[off], ev);
+	if (!pxs->desc->quiet)
+		off += _emit_SEV(dry_run, &buf[off], ev);
 
 	return off;
 }
@@ -2804,6 +2807,7 @@ static struct dma_pl330_desc *pl330_get_desc(struct dma_pl330_chan *pch)
 	desc->rqcfg.pcfg = &pch->dmac->pcfg;
 
 	desc->cyclic = false;
+	desc->quiet = false;
 	desc->num_periods = 1;
 
 	desc->sgl.size = 0;
@@ -2923,6 +2927,7 @@ static struct dma_async_tx_descriptor *pl330_prep_dma_cyclic(
 	fill_px(&desc->px, dst, src, period_len);
 
 	desc->cyclic = true;
+	desc->quiet = !(flags & DMA_PREP_INTERRUPT);
 	desc->num_periods = len / period_len;
 
 	return &desc->txd;
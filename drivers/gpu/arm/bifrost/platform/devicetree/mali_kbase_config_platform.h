@@ -33,12 +33,26 @@
  * Attached value: pointer to @ref kbase_platform_funcs_conf
  * Default value: See @ref kbase_platform_funcs_conf
  */
+#if IS_ENABLED(CONFIG_MALI_BIFROST_DEVFREQ)
+#define PLATFORM_FUNCS (&platform_funcs)
+#else
 #define PLATFORM_FUNCS (NULL)
+#endif
 
 #define CLK_RATE_TRACE_OPS (&clk_rate_trace_ops)
 
 extern struct kbase_pm_callback_conf pm_callbacks;
 extern struct kbase_clk_rate_trace_op_conf clk_rate_trace_ops;
+
+#if IS_ENABLED(CONFIG_MALI_BIFROST_DEVFREQ)
+extern struct kbase_platform_funcs_conf platform_funcs;
+
+void kbase_frame_pacing_gpu_active(struct kbase_device *kbdev);
+void kbase_frame_pacing_gpu_idle(struct kbase_device *kbdev);
+#else
+static inline void kbase_frame_pacing_gpu_active(struct kbase_device *kbdev) { }
+static inline void kbase_frame_pacing_gpu_idle(struct kbase_device *kbdev) { }
+#endif
 /**
  * AUTO_SUSPEND_DELAY - Autosuspend delay
  *
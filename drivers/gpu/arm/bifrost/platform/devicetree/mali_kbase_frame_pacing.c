@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ *
+ * Frame paced gpu devfreq floor and ddr bandwidth coupling.
+ *
+ * While the gpu is powered, the busy time of every display frame is
+ * sampled. The lowest frequency at which the heaviest of the last few
+ * frames would still fit in "rockchip,frame-pacing-target" percent of the
+ * frame is set as a devfreq min frequency, so the gpu scales to the frame
+ * deadline instead of to utilization averaged over the polling interval.
+ * The same sample, scaled by "rockchip,bw-per-mhz", is declared to the
+ * dmc, so ddr does not down-scale under a gpu bound frame.
+ */
+
+#include <mali_kbase.h>
+#include <mali_kbase_defs.h>
+#include <backend/gpu/mali_kbase_pm_internal.h>
+#include <linux/pm_qos.h>
+#include <linux/workqueue.h>
+#include <soc/rockchip/rockchip_dmc.h>
+
+#include "mali_kbase_config_platform.h"
+#include "../../../../drm/rockchip/rockchip_drm_drv.h"
+
+#define PACING_HISTORY		4
+#define PACING_DEFAULT_FRAME_US	16667
+
+struct kbase_frame_pacing {
+	struct kbase_device *kbdev;
+	struct delayed_work work;
+	struct kbasep_pm_metrics last;
+	struct dev_pm_qos_request min_req;
+	struct rockchip_bw_request bw_req;
+	u32 target;		/* percent of the frame */
+	u32 bw_per_mhz;		/* MB/s at full load, per gpu MHz */
+	u32 frame_us;
+	unsigned long need_khz[PACING_HISTORY];
+	unsigned int idx;
+	bool active;
+};
+
+static void kbase_frame_pacing_work(struct work_struct *work)
+{
+	struct kbase_frame_pacing *fp = container_of(to_delayed_work(work),
+						     struct kbase_frame_pacing, work);
+	struct kbase_device *kbdev = fp->kbdev;
+	struct kbasep_pm_metrics diff;
+	unsigned long cur_khz, need_khz = 0;
+	u64 busy, total;
+	int i;
+
+	if (!READ_ONCE(fp->active))
+		return;
+
+	kbase_pm_get_dvfs_metrics(kbdev, &fp->last, &diff);
+	busy = diff.time_busy;
+	total = busy + diff.time_idle;
+	cur_khz = kbdev->current_nominal_freq / 1000;
+
+	if (total && cur_khz) {
+		if (fp->target)
+			fp->need_khz[fp->idx++ % PACING_HISTORY] =
+				div64_u64((u64)cur_khz * busy * 100, total * fp->target);
+		if (fp->bw_per_mhz)
+			rockchip_dmcfreq_bw_request_update(&fp->bw_req,
+				div64_u64((u64)fp->bw_per_mhz * (cur_khz / 1000) * busy,
+					  total));
+	}
+
+	if (fp->target) {
+		for (i = 0; i < PACING_HISTORY; i++)
+			need_khz = max(need_khz, fp->need_khz[i]);
+		dev_pm_qos_update_request(&fp->min_req, need_khz);
+	}
+
+	fp->frame_us = rockchip_drm_get_frame_time_us() ? : PACING_DEFAULT_FRAME_US;
+	queue_delayed_work(system_freezable_power_efficient_wq, &fp->work,
+			   usecs_to_jiffies(fp->frame_us));
+}
+
+void kbase_frame_pacing_gpu_active(struct kbase_device *kbdev)
+{
+	struct kbase_frame_pacing *fp = kbdev->platform_context;
+	struct kbasep_pm_metrics diff;
+
+	if (!fp || fp->active)
+		return;
+
+	/* start the first frame from now */
+	kbase_pm_get_dvfs_metrics(kbdev, &fp->last, &diff);
+	memset(fp->need_khz, 0, sizeof(fp->need_khz));
+	WRITE_ONCE(fp->active, true);
+	queue_delayed_work(system_freezable_power_efficient_wq, &fp->work,
+			   usecs_to_jiffies(fp->frame_us));
+}
+
+void kbase_frame_pacing_gpu_idle(struct kbase_device *kbdev)
+{
+	struct kbase_frame_pacing *fp = kbdev->platform_context;
+
+	if (!fp || !fp->active)
+		return;
+
+	WRITE_ONCE(fp->active, false);
+	cancel_delayed_work(&fp->work);
+	if (fp->target)
+		dev_pm_qos_update_request(&fp->min_req, 0);
+	if (fp->bw_per_mhz)
+		rockchip_dmcfreq_bw_request_update(&fp->bw_req, 0);
+}
+
+static int kbase_frame_pacing_init(struct kbase_device *kbdev)
+{
+	struct device_node *np = kbdev->dev->of_node;
+	struct kbase_frame_pacing *fp;
+	int ret;
+
+	fp = kzalloc(sizeof(*fp), GFP_KERNEL);
+	if (!fp)
+		return -ENOMEM;
+
+	of_property_read_u32(np, "rockchip,frame-pacing-target", &fp->target);
+	of_property_read_u32(np, "rockchip,bw-per-mhz", &fp->bw_per_mhz);
+	if (fp->target > 100)
+		fp->target = 100;
+	if (!fp->target && !fp->bw_per_mhz) {
+		kfree(fp);
+		return 0;
+	}
+
+	if (fp->target) {
+		ret = dev_pm_qos_add_request(kbdev->dev, &fp->min_req,
+					     DEV_PM_QOS_MIN_FREQUENCY, 0);
+		if (ret < 0) {
+			dev_err(kbdev->dev, "failed to add pacing qos: %d\n", ret);
+			kfree(fp);
+			return ret;
+		}
+	}
+	if (fp->bw_per_mhz)
+		rockchip_dmcfreq_bw_request_add(&fp->bw_req, kbdev->dev,
+						ROCKCHIP_BW_NORMAL);
+
+	fp->kbdev = kbdev;
+	fp->frame_us = PACING_DEFAULT_FRAME_US;
+	INIT_DELAYED_WORK(&fp->work, kbase_frame_pacing_work);
+	kbdev->platform_context = fp;
+
+	dev_info(kbdev->dev, "frame pacing target %u%%, bw %u MB/s per MHz\n",
+		 fp->target, fp->bw_per_mhz);
+
+	return 0;
+}
+
+static void kbase_frame_pacing_term(struct kbase_device *kbdev)
+{
+	struct kbase_frame_pacing *fp = kbdev->platform_context;
+
+	if (!fp)
+		return;
+
+	WRITE_ONCE(fp->active, false);
+	cancel_delayed_work_sync(&fp->work);
+	if (fp->target)
+		dev_pm_qos_remove_request(&fp->min_req);
+	if (fp->bw_per_mhz)
+		rockchip_dmcfreq_bw_request_remove(&fp->bw_req);
+	kbdev->platform_context = NULL;
+	kfree(fp);
+}
+
+struct kbase_platform_funcs_conf platform_funcs = {
+	.platform_init_func = kbase_frame_pacing_init,
+	.platform_term_func = kbase_frame_pacing_term,
+};
@@ -246,6 +246,8 @@ static int pm_callback_runtime_on(struct kbase_device *kbdev)
 #if !MALI_USE_CSF
 	enable_gpu_power_control(kbdev);
 #endif
+	kbase_frame_pacing_gpu_active(kbdev);
+
 	return 0;
 }
 
@@ -253,6 +255,7 @@ static void pm_callback_runtime_off(struct kbase_device *kbdev)
 {
 	dev_dbg(kbdev->dev, "%s\n", __func__);
 
+	kbase_frame_pacing_gpu_idle(kbdev);
 #if !MALI_USE_CSF
 	disable_gpu_power_control(kbdev);
 #endif
@@ -1305,6 +1305,41 @@ static int dw_dp_atomic_connector_set_property(struct drm_connector *connector,
 }
 
 #if defined(CONFIG_DEBUG_FS) && defined(CONFIG_NO_GKI)
+static void dw_dp_mst_bw_dump(struct seq_file *s, struct dw_dp *dp)
+{
+	struct drm_dp_mst_topology_state *mst_state;
+	struct drm_dp_mst_atomic_payload *payload;
+	struct dw_dp_mst_enc *mst_enc;
+	int i, used = 0;
+
+	drm_modeset_lock(&dp->mst_mgr.base.lock, NULL);
+	mst_state = to_drm_dp_mst_topology_state(dp->mst_mgr.base.state);
+
+	seq_puts(s, "\n*** Stream bandwidth ***\n");
+	seq_printf(s, "pbn per slot:%d slots:%d\n", mst_state->pbn_div,
+		   mst_state->total_avail_slots);
+	seq_puts(s, "stream id | bpp | pbn | slots\n");
+	for (i = 0; i < dp->mst_port_num; i++) {
+		mst_enc = &dp->mst_enc[i];
+		if (!mst_enc->dp || !mst_enc->active || !mst_enc->mst_conn)
+			continue;
+
+		list_for_each_entry(payload, &mst_state->payloads, next) {
+			if (payload->port != mst_enc->mst_conn->port)
+				continue;
+			seq_printf(s, "%-9d   %-3d   %-5d %d\n", mst_enc->stream_id,
+				   mst_enc->video.bpp, payload->pbn, payload->time_slots);
+			used += payload->time_slots;
+		}
+	}
+	/* the pbn one more stream could still get on the link */
+	seq_printf(s, "free slots:%d pbn budget:%d\n",
+		   mst_state->total_avail_slots - used,
+		   (mst_state->total_avail_slots - used) * mst_state->pbn_div);
+
+	drm_modeset_unlock(&dp->mst_mgr.base.lock);
+}
+
 static int dw_dp_mst_info_dump(struct seq_file *s, void *data)
 {
 	struct drm_info_node *node = s->private;
@@ -1338,6 +1373,7 @@ static int dw_dp_mst_info_dump(struct seq_file *s, void *data)
 					   dp->mst_enc[i].fix_port_num);
 			}
 		}
+		dw_dp_mst_bw_dump(s, dp);
 	}
 
 	return 0;
@@ -3848,6 +3884,58 @@ static void dw_dp_mst_encoder_atomic_disable(struct drm_encoder *encoder,
 
 }
 
+/* time slots of the mtp left by all the other streams on the link */
+static int dw_dp_mst_free_slots(struct drm_dp_mst_topology_state *mst_state,
+				struct drm_dp_mst_port *port)
+{
+	struct drm_dp_mst_atomic_payload *payload;
+	int free = mst_state->total_avail_slots;
+
+	list_for_each_entry(payload, &mst_state->payloads, next)
+		if (payload->port != port && !payload->delete)
+			free -= payload->time_slots;
+
+	return free;
+}
+
+/*
+ * Pick the output format of one stream from the slots the other streams
+ * leave, so a mode change on one monitor of the chain makes the stream
+ * fall back to 8 bit ycbcr422 instead of failing the whole commit. The
+ * allocation is redone on every atomic check, a stream goes back to rgb
+ * as soon as there is room again.
+ */
+static const struct dw_dp_output_format *
+dw_dp_mst_select_output_format(struct dw_dp *dp, struct drm_crtc_state *crtc_state,
+			       struct drm_display_info *di,
+			       struct drm_dp_mst_topology_state *mst_state,
+			       struct drm_dp_mst_port *port)
+{
+	static const u32 mst_bus_fmts[] = {
+		MEDIA_BUS_FMT_RGB888_1X24,
+		MEDIA_BUS_FMT_YUYV8_1X16,
+	};
+	const struct dw_dp_output_format *fmt, *best = NULL;
+	int free = dw_dp_mst_free_slots(mst_state, port);
+	int i, pbn;
+
+	for (i = 0; i < ARRAY_SIZE(mst_bus_fmts); i++) {
+		fmt = dw_dp_get_output_format(mst_bus_fmts[i]);
+		if (!(di->color_formats & fmt->color_format))
+			continue;
+
+		best = fmt;
+		if (!mst_state->pbn_div)
+			break;
+		pbn = drm_dp_calc_pbn_mode(crtc_state->adjusted_mode.crtc_clock,
+					   fmt->bpp, false);
+		if (DIV_ROUND_UP(pbn, mst_state->pbn_div) <= free)
+			break;
+	}
+
+	return best ? best : dw_dp_get_output_format(MEDIA_BUS_FMT_RGB888_1X24);
+}
+
 static int dw_dp_mst_encoder_atomic_check(struct drm_encoder *encoder,
 					  struct drm_crtc_state *crtc_state,
 					  struct drm_connector_state *conn_state)
@@ -3857,8 +3945,7 @@ static int dw_dp_mst_encoder_atomic_check(struct drm_encoder *encoder,
 	struct dw_dp_video *video = &mst_enc->video;
 	struct rockchip_crtc_state *s = to_rockchip_crtc_state(crtc_state);
 	struct drm_display_info *di = &conn_state->connector->display_info;
-	const struct dw_dp_output_format *fmt =
-		dw_dp_get_output_format(MEDIA_BUS_FMT_RGB888_1X24);
+	const struct dw_dp_output_format *fmt;
 	struct drm_atomic_state *state = crtc_state->state;
 	struct drm_connector *connector = conn_state->connector;
 	struct dw_dp_mst_conn *mst_conn = container_of(connector,
@@ -3871,6 +3958,12 @@ static int dw_dp_mst_encoder_atomic_check(struct drm_encoder *encoder,
 	if (IS_ERR(mst_state))
 		return PTR_ERR(mst_state);
 
+	if (!mst_state->pbn_div) {
+		mst_state->pbn_div = drm_dp_get_vc_payload_bw(&dp->mst_mgr, dp->link.rate,
+							      dp->link.lanes);
+	}
+	fmt = dw_dp_mst_select_output_format(dp, crtc_state, di, mst_state, mst_conn->port);
+
 	video->video_mapping = fmt->video_mapping;
 	video->color_format = fmt->color_format;
 	video->bus_format = fmt->bus_format;
@@ -3912,10 +4005,6 @@ static int dw_dp_mst_encoder_atomic_check(struct drm_encoder *encoder,
 	s->tv_state = &conn_state->tv;
 	s->color_encoding = DRM_COLOR_YCBCR_BT709;
 
-	if (!mst_state->pbn_div) {
-		mst_state->pbn_div = drm_dp_get_vc_payload_bw(&dp->mst_mgr, dp->link.rate,
-							      dp->link.lanes);
-	}
 	pbn = drm_dp_calc_pbn_mode(crtc_state->adjusted_mode.crtc_clock, video->bpp, false);
 	slot = drm_dp_atomic_find_time_slots(state, &dp->mst_mgr, mst_conn->port, pbn);
 	if (slot < 0) {
@@ -959,6 +959,88 @@ rockchip_hdmi_find_by_id(struct device_driver *drv, unsigned int id)
 	return dev_get_drvdata(dev);
 }
 
+static bool dsc_auto;
+module_param(dsc_auto, bool, 0644);
+MODULE_PARM_DESC(dsc_auto, "enable dsc whenever it allows a lower frl link config");
+
+/* percent of the frl payload rate kept free for blanking and islands */
+#define HDMI_FRL_BW_MARGIN	10
+
+/* frl link configs from the lowest, the hdmi2.1 ladder up to 40G */
+static const struct {
+	u8 lanes;
+	u8 rate_per_lane;
+} hdmi_frl_ladder[] = {
+	{ 3, FRL_3G_PER_LANE },
+	{ 3, FRL_6G_PER_LANE },
+	{ 4, FRL_6G_PER_LANE },
+	{ 4, FRL_8G_PER_LANE },
+	{ 4, FRL_10G_PER_LANE },
+};
+
+static int hdmi_dsc_probe_bpp(struct rockchip_hdmi *hdmi,
+			      struct drm_crtc_state *crtc_state);
+
+/*
+ * Return the lowest frl link config within the lanes and rate limits that
+ * carries kbps with the margin, a lane runs 16b/18b coded, or -1.
+ */
+static int hdmi_frl_min_config(u64 kbps, int max_lanes, int max_rate_per_lane)
+{
+	u64 cap;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hdmi_frl_ladder); i++) {
+		if (hdmi_frl_ladder[i].lanes > max_lanes ||
+		    hdmi_frl_ladder[i].rate_per_lane > max_rate_per_lane)
+			break;
+		cap = (u64)hdmi_frl_ladder[i].lanes * hdmi_frl_ladder[i].rate_per_lane *
+		      1000000 * 16 / 18;
+		if (kbps * (100 + HDMI_FRL_BW_MARGIN) <= cap * 100)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * Use dsc when the compressed stream fits a lower frl config than the
+ * uncompressed one, so the link and the phy run at a lower rate. Only
+ * modes with a valid pps are considered.
+ */
+static bool hdmi_select_dsc_auto(struct rockchip_hdmi *hdmi,
+				 struct drm_crtc_state *crtc_state,
+				 unsigned int tmdsclk)
+{
+	int max_lanes = hdmi->max_lanes, max_rate = hdmi->max_frl_rate_per_lane;
+	int raw_cfg, dsc_cfg, bpp_x16;
+
+	if (!dsc_auto || hdmi_bus_fmt_is_yuv420(hdmi->bus_format) ||
+	    hdmi_bus_fmt_is_yuv422(hdmi->bus_format))
+		return false;
+
+	bpp_x16 = hdmi_dsc_probe_bpp(hdmi, crtc_state);
+	if (!bpp_x16)
+		return false;
+
+	/* three tmds characters of 8 bits per tmds clock */
+	raw_cfg = hdmi_frl_min_config((u64)tmdsclk * 24, max_lanes, max_rate);
+	dsc_cfg = hdmi_frl_min_config((u64)crtc_state->mode.clock * bpp_x16 / 16,
+				      hdmi->dsc_cap.max_lanes,
+				      hdmi->dsc_cap.max_frl_rate_per_lane);
+	if (dsc_cfg < 0 || (raw_cfg >= 0 && dsc_cfg >= raw_cfg))
+		return false;
+
+	hdmi->link_cfg.dsc_mode = true;
+	hdmi->link_cfg.frl_lanes = hdmi_frl_ladder[dsc_cfg].lanes;
+	hdmi->link_cfg.rate_per_lane = hdmi_frl_ladder[dsc_cfg].rate_per_lane;
+	dev_dbg(hdmi->dev, "auto dsc %d.%04d bpp, frl %dx%dG\n",
+		bpp_x16 / 16, (bpp_x16 % 16) * 625, hdmi->link_cfg.frl_lanes,
+		hdmi->link_cfg.rate_per_lane);
+
+	return true;
+}
+
 static void hdmi_select_link_config(struct rockchip_hdmi *hdmi,
 				    struct drm_crtc_state *crtc_state,
 				    unsigned int tmdsclk)
@@ -992,6 +1074,9 @@ static void hdmi_select_link_config(struct rockchip_hdmi *hdmi,
 	if (!hdmi->dsc_cap.v_1p2)
 		return;
 
+	if (hdmi_select_dsc_auto(hdmi, crtc_state, tmdsclk))
+		return;
+
 	max_dsc_lanes = hdmi->dsc_cap.max_lanes;
 	max_dsc_rate_per_lane =
 		hdmi->dsc_cap.max_frl_rate_per_lane;
@@ -1226,10 +1311,10 @@ dw_hdmi_dsc_bpp(struct rockchip_hdmi *hdmi,
 				hdmi_max_chunk_bytes);
 }
 
-static int dw_hdmi_qp_set_link_cfg(struct rockchip_hdmi *hdmi,
-				   u16 pic_width, u16 pic_height,
-				   u16 slice_width, u16 slice_height,
-				   u16 bits_per_pixel, u8 bits_per_component)
+static int hdmi_dsc_find_pps(struct rockchip_hdmi *hdmi,
+			     u16 pic_width, u16 pic_height,
+			     u16 slice_width, u16 slice_height,
+			     u16 bits_per_pixel, u8 bits_per_component)
 {
 	int i;
 
@@ -1241,9 +1326,21 @@ static int dw_hdmi_qp_set_link_cfg(struct rockchip_hdmi *hdmi,
 		    bits_per_component == pps_datas[i].bpc &&
 		    bits_per_pixel == pps_datas[i].bpp &&
 		    hdmi_bus_fmt_is_rgb(hdmi->output_bus_format) == pps_datas[i].convert_rgb)
-			break;
+			return i;
+
+	return -EINVAL;
+}
+
+static int dw_hdmi_qp_set_link_cfg(struct rockchip_hdmi *hdmi,
+				   u16 pic_width, u16 pic_height,
+				   u16 slice_width, u16 slice_height,
+				   u16 bits_per_pixel, u8 bits_per_component)
+{
+	int i;
 
-	if (i == PPS_TABLE_LEN) {
+	i = hdmi_dsc_find_pps(hdmi, pic_width, pic_height, slice_width,
+			      slice_height, bits_per_pixel, bits_per_component);
+	if (i < 0) {
 		dev_err(hdmi->dev, "can't find pps cfg!\n");
 		return -EINVAL;
 	}
@@ -1255,6 +1352,33 @@ static int dw_hdmi_qp_set_link_cfg(struct rockchip_hdmi *hdmi,
 	return 0;
 }
 
+/* the bpp dw_hdmi_qp_dsc_configure() would pick, 0 if there is no pps */
+static int hdmi_dsc_probe_bpp(struct rockchip_hdmi *hdmi,
+			      struct drm_crtc_state *crtc_state)
+{
+	unsigned int depth = hdmi_bus_fmt_color_depth(hdmi->output_bus_format);
+	int slice_height, slice_count, slice_width, bits_per_pixel;
+
+	slice_height = hdmi_dsc_get_slice_height(crtc_state->mode.vdisplay);
+	if (!slice_height)
+		return 0;
+
+	slice_count = hdmi_dsc_slices(hdmi, crtc_state);
+	if (!slice_count)
+		return 0;
+
+	slice_width = DIV_ROUND_UP(crtc_state->mode.hdisplay, slice_count);
+	bits_per_pixel = dw_hdmi_dsc_bpp(hdmi, slice_count, slice_width);
+	if (!bits_per_pixel)
+		return 0;
+
+	if (hdmi_dsc_find_pps(hdmi, crtc_state->mode.hdisplay, crtc_state->mode.vdisplay,
+			      slice_width, slice_height, bits_per_pixel, depth) < 0)
+		return 0;
+
+	return bits_per_pixel;
+}
+
 static void dw_hdmi_qp_dsc_configure(struct rockchip_hdmi *hdmi,
 				     struct rockchip_crtc_state *s,
 				     struct drm_crtc_state *crtc_state)
@@ -124,6 +124,10 @@ struct papyrus_sess {
 	struct mutex power_lock;
 	struct workqueue_struct *tmp_monitor_wq;
 	struct delayed_work tmp_delay_work;
+	/* rails kept up after an update, until power_off_work runs */
+	bool power_held;
+	unsigned long hold_until;
+	struct delayed_work power_off_work;
 };
 
 struct papyrus_hw_state {
@@ -134,6 +138,15 @@ struct papyrus_hw_state {
 };
 static bool papyrus_need_reconfig = true;
 
+/*
+ * Keep the rails up for this long after an update, so back-to-back
+ * partial updates such as pen strokes or typing skip the power down and
+ * up sequences in between. 0 powers down right after every update.
+ */
+static unsigned int power_hold_ms;
+module_param(power_hold_ms, uint, 0644);
+MODULE_PARM_DESC(power_hold_ms, "keep the panel rails up between updates for this long");
+
 static int papyrus_hw_setreg(struct papyrus_sess *sess, uint8_t regaddr, uint8_t val)
 {
 	int stat;
@@ -386,12 +399,9 @@ static int papyrus_hw_read_temperature(struct ebc_pmic *pmic, int *t)
 	return stat;
 }
 
-static void papyrus_hw_power_req(struct ebc_pmic *pmic, bool up)
+/* called with power_lock held */
+static void papyrus_hw_power_switch(struct papyrus_sess *sess, bool up)
 {
-	struct papyrus_sess *sess = (struct papyrus_sess *)pmic->drvpar;
-
-	if (up)
-		mutex_lock(&sess->power_lock);
 	if (papyrus_need_reconfig) {
 		if (up) {
 			papyrus_hw_send_powerup(sess);
@@ -414,9 +424,58 @@ static void papyrus_hw_power_req(struct ebc_pmic *pmic, bool up)
 				gpiod_direction_output(sess->pwr_up_pin, 0);
 		}
 	}
-	if (!up)
-		mutex_unlock(&sess->power_lock);
-	return;
+}
+
+/* drop rails still held from the last update, called with power_lock held */
+static void papyrus_hw_release_hold(struct papyrus_sess *sess)
+{
+	if (!sess->power_held)
+		return;
+
+	sess->power_held = false;
+	papyrus_hw_power_switch(sess, false);
+}
+
+static void papyrus_power_off_work(struct work_struct *work)
+{
+	struct papyrus_sess *sess =
+		container_of(work, struct papyrus_sess, power_off_work.work);
+
+	mutex_lock(&sess->power_lock);
+	/* a newer update pushed the deadline while this was pending */
+	if (sess->power_held && time_before(jiffies, sess->hold_until))
+		mod_delayed_work(system_wq, &sess->power_off_work,
+				 sess->hold_until - jiffies);
+	else
+		papyrus_hw_release_hold(sess);
+	mutex_unlock(&sess->power_lock);
+}
+
+static void papyrus_hw_power_req(struct ebc_pmic *pmic, bool up)
+{
+	struct papyrus_sess *sess = (struct papyrus_sess *)pmic->drvpar;
+	unsigned int hold_ms = READ_ONCE(power_hold_ms);
+
+	if (up) {
+		mutex_lock(&sess->power_lock);
+		/* the rails are still up from the previous update */
+		if (sess->power_held) {
+			sess->power_held = false;
+			return;
+		}
+		papyrus_hw_power_switch(sess, true);
+		return;
+	}
+
+	if (hold_ms && !papyrus_need_reconfig) {
+		sess->power_held = true;
+		sess->hold_until = jiffies + msecs_to_jiffies(hold_ms);
+		mod_delayed_work(system_wq, &sess->power_off_work,
+				 msecs_to_jiffies(hold_ms));
+	} else {
+		papyrus_hw_power_switch(sess, false);
+	}
+	mutex_unlock(&sess->power_lock);
 }
 
 static int papyrus_hw_vcom_get(struct ebc_pmic *pmic)
@@ -427,6 +486,7 @@ static int papyrus_hw_vcom_get(struct ebc_pmic *pmic)
 	int read_vcom_mv = 0;
 
 	mutex_lock(&sess->power_lock);
+	papyrus_hw_release_hold(sess);
 	// VERIFICATION
 	gpiod_direction_output(sess->wake_up_pin, 0);
 	msleep(10);
@@ -452,6 +512,7 @@ static int papyrus_hw_vcom_set(struct ebc_pmic *pmic, int vcom_mv)
 	int stat = 0;
 
 	mutex_lock(&sess->power_lock);
+	papyrus_hw_release_hold(sess);
 	gpiod_direction_output(sess->wake_up_pin, 1);
 	msleep(10);
 	// Set vcom voltage
@@ -482,8 +543,10 @@ static void papyrus_pm_sleep(struct ebc_pmic *pmic)
 	struct papyrus_sess *s = (struct papyrus_sess *)pmic->drvpar;
 
 	cancel_delayed_work_sync(&s->tmp_delay_work);
+	cancel_delayed_work_sync(&s->power_off_work);
 
 	mutex_lock(&s->power_lock);
+	papyrus_hw_release_hold(s);
 	gpiod_direction_output(s->vcom_ctl_pin, 0);
 	gpiod_direction_output(s->wake_up_pin, 0);
 	if (!IS_ERR_OR_NULL(s->pwr_en_pin))
@@ -583,6 +646,7 @@ static int papyrus_probe(struct ebc_pmic *pmic, struct i2c_client *client)
 	sess->tmp_monitor_wq = alloc_ordered_workqueue("%s",
 			WQ_MEM_RECLAIM | WQ_FREEZABLE, "tps-tmp-monitor-wq");
 	INIT_DELAYED_WORK(&sess->tmp_delay_work, papyrus_tmp_work);
+	INIT_DELAYED_WORK(&sess->power_off_work, papyrus_power_off_work);
 	queue_delayed_work(sess->tmp_monitor_wq, &sess->tmp_delay_work,
 			   msecs_to_jiffies(10000));
 
@@ -281,6 +281,16 @@ int rockchip_drm_direct_show_commit(struct drm_device *drm,
 			DRM_DS_ERR("failed to set plane zpos prop, ret:%d\n", ret);
 		plane->state->zpos = zpos_prop->values[1];
 	}
+	if (plane->rotation_property) {
+		u32 rotation = commit_info->rotation ? : DRM_MODE_ROTATE_0;
+
+		rockchip_drm_direct_show_set_property_value(&plane->base,
+							    plane->rotation_property,
+							    rotation);
+		plane->state->rotation = rotation;
+	} else if (commit_info->rotation & ~DRM_MODE_ROTATE_0) {
+		DRM_DS_ERR("plane[%s] has no rotation prop\n", plane->name);
+	}
 	ret = plane->funcs->update_plane(plane, crtc, fb,
 					 commit_info->dst_x, commit_info->dst_y,
 					 commit_info->dst_w, commit_info->dst_h,
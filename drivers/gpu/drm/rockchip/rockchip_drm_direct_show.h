@@ -48,6 +48,7 @@ struct rockchip_drm_direct_show_commit_info {
 	u32 dst_y;
 	u32 dst_w;
 	u32 dst_h;
+	u32 rotation;	/* DRM_MODE_ROTATE_x | DRM_MODE_REFLECT_x, 0 is ROTATE_0 */
 	bool top_zpos;
 };
 
@@ -399,6 +399,92 @@ u32 rockchip_drm_get_scan_line_time_ns(void)
 }
 EXPORT_SYMBOL(rockchip_drm_get_scan_line_time_ns);
 
+/**
+ * rockchip_drm_get_frame_time_us - frame period of the active display
+ *
+ * Lets other masters, such as the gpu, pace their work to the display.
+ *
+ * Returns:
+ * The frame period in microseconds, 0 if no display is active.
+ */
+u32 rockchip_drm_get_frame_time_us(void)
+{
+	struct rockchip_drm_sub_dev *sub_dev = NULL;
+	struct drm_display_mode *mode;
+	struct drm_crtc *crtc;
+	u32 frame_us = 0;
+
+	mutex_lock(&rockchip_drm_sub_dev_lock);
+	list_for_each_entry(sub_dev, &rockchip_drm_sub_dev_list, list) {
+		if (!sub_dev->connector->encoder || !sub_dev->connector->state)
+			continue;
+
+		crtc = sub_dev->connector->state->crtc;
+		if (!crtc || !crtc->state || !crtc->state->active)
+			continue;
+
+		mode = &crtc->state->adjusted_mode;
+		if (mode->crtc_clock)
+			frame_us = div_u64((u64)mode->crtc_htotal * mode->crtc_vtotal * 1000,
+					   mode->crtc_clock);
+		break;
+	}
+	mutex_unlock(&rockchip_drm_sub_dev_lock);
+
+	return frame_us;
+}
+EXPORT_SYMBOL(rockchip_drm_get_frame_time_us);
+
+/**
+ * rockchip_drm_wait_vblank_window - wait the vertical blanking of the display
+ * @mstimeout: millisecond for timeout
+ *
+ * Let the dmc switch ddr rate inside the blanking. Only one active display
+ * can be aligned, two displays scan out independently.
+ *
+ * Returns:
+ * Zero at the start of blanking, -ENODEV if no display is active, other
+ * negative errno if no window can be provided.
+ */
+int rockchip_drm_wait_vblank_window(unsigned int mstimeout)
+{
+	struct rockchip_drm_sub_dev *sub_dev = NULL;
+	struct rockchip_drm_private *priv;
+	struct drm_crtc *crtc = NULL;
+	bool multi_display = false;
+	int pipe;
+
+	mutex_lock(&rockchip_drm_sub_dev_lock);
+	list_for_each_entry(sub_dev, &rockchip_drm_sub_dev_list, list) {
+		struct drm_crtc *cur;
+
+		if (!sub_dev->connector->encoder || !sub_dev->connector->state)
+			continue;
+
+		cur = sub_dev->connector->state->crtc;
+		if (!cur || !cur->state || !cur->state->active)
+			continue;
+
+		if (crtc && crtc != cur)
+			multi_display = true;
+		crtc = cur;
+	}
+	mutex_unlock(&rockchip_drm_sub_dev_lock);
+
+	if (!crtc)
+		return -ENODEV;
+	if (multi_display)
+		return -EBUSY;
+
+	priv = crtc->dev->dev_private;
+	pipe = drm_crtc_index(crtc);
+	if (!priv->crtc_funcs[pipe] || !priv->crtc_funcs[pipe]->wait_vblank_window)
+		return -EOPNOTSUPP;
+
+	return priv->crtc_funcs[pipe]->wait_vblank_window(crtc, mstimeout);
+}
+EXPORT_SYMBOL(rockchip_drm_wait_vblank_window);
+
 void rockchip_drm_te_handle(struct drm_crtc *crtc)
 {
 	struct rockchip_drm_private *priv = crtc->dev->dev_private;
@@ -1551,6 +1637,8 @@ static int rockchip_gem_pool_init(struct drm_device *drm)
 		return -ENOMEM;
 
 	gen_pool_add(private->secure_buffer_pool, start, size, -1);
+	INIT_LIST_HEAD(&private->secure_cache);
+	mutex_init(&private->secure_cache_lock);
 
 	return 0;
 }
@@ -1562,6 +1650,7 @@ static void rockchip_gem_pool_destroy(struct drm_device *drm)
 	if (!private->secure_buffer_pool)
 		return;
 
+	rockchip_gem_secure_cache_drain(drm);
 	gen_pool_destroy(private->secure_buffer_pool);
 }
 
@@ -1797,10 +1886,21 @@ static int rockchip_drm_open(struct drm_device *dev, struct drm_file *file)
 static void rockchip_drm_postclose(struct drm_device *dev,
 				   struct drm_file *file_priv)
 {
+	struct rockchip_drm_private *priv = dev->dev_private;
+	struct drm_rockchip_wb_stream args = {
+		.cmd = ROCKCHIP_WB_STREAM_STOP,
+	};
 	struct drm_crtc *crtc;
+	int pipe;
 
-	list_for_each_entry(crtc, &dev->mode_config.crtc_list, head)
+	list_for_each_entry(crtc, &dev->mode_config.crtc_list, head) {
 		rockchip_drm_crtc_cancel_pending_vblank(crtc, file_priv);
+
+		/* stop the write back stream this file left running */
+		pipe = drm_crtc_index(crtc);
+		if (priv->crtc_funcs[pipe] && priv->crtc_funcs[pipe]->wb_stream)
+			priv->crtc_funcs[pipe]->wb_stream(crtc, file_priv, &args);
+	}
 }
 
 static void rockchip_drm_lastclose(struct drm_device *dev)
@@ -1862,6 +1962,25 @@ static int rockchip_drm_get_vcnt_event_ioctl(struct drm_device *dev, void *data,
 	return 0;
 }
 
+static int rockchip_drm_wb_stream_ioctl(struct drm_device *dev, void *data,
+					struct drm_file *file_priv)
+{
+	struct rockchip_drm_private *priv = dev->dev_private;
+	struct drm_rockchip_wb_stream *args = data;
+	struct drm_crtc *crtc;
+	int pipe;
+
+	crtc = drm_crtc_find(dev, file_priv, args->crtc_id);
+	if (!crtc)
+		return -ENOENT;
+
+	pipe = drm_crtc_index(crtc);
+	if (!priv->crtc_funcs[pipe] || !priv->crtc_funcs[pipe]->wb_stream)
+		return -EOPNOTSUPP;
+
+	return priv->crtc_funcs[pipe]->wb_stream(crtc, file_priv, args);
+}
+
 static const struct drm_ioctl_desc rockchip_ioctls[] = {
 	DRM_IOCTL_DEF_DRV(ROCKCHIP_GEM_CREATE, rockchip_gem_create_ioctl,
 			  DRM_UNLOCKED | DRM_AUTH | DRM_RENDER_ALLOW),
@@ -1872,6 +1991,8 @@ static const struct drm_ioctl_desc rockchip_ioctls[] = {
 			  DRM_UNLOCKED | DRM_AUTH | DRM_RENDER_ALLOW),
 	DRM_IOCTL_DEF_DRV(ROCKCHIP_GET_VCNT_EVENT, rockchip_drm_get_vcnt_event_ioctl,
 			  DRM_UNLOCKED),
+	DRM_IOCTL_DEF_DRV(ROCKCHIP_WB_STREAM, rockchip_drm_wb_stream_ioctl,
+			  DRM_UNLOCKED | DRM_MASTER),
 };
 
 static int rockchip_drm_gem_dmabuf_begin_cpu_access(struct dma_buf *dma_buf,
@@ -1890,6 +2011,28 @@ static int rockchip_drm_gem_dmabuf_end_cpu_access(struct dma_buf *dma_buf,
 	return rockchip_gem_prime_end_cpu_access(obj, dir);
 }
 
+static int __maybe_unused
+rockchip_drm_gem_dmabuf_begin_cpu_access_partial(struct dma_buf *dma_buf,
+						 enum dma_data_direction dir,
+						 unsigned int offset,
+						 unsigned int len)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+
+	return rockchip_gem_prime_begin_cpu_access_partial(obj, dir, offset, len);
+}
+
+static int __maybe_unused
+rockchip_drm_gem_dmabuf_end_cpu_access_partial(struct dma_buf *dma_buf,
+					       enum dma_data_direction dir,
+					       unsigned int offset,
+					       unsigned int len)
+{
+	struct drm_gem_object *obj = dma_buf->priv;
+
+	return rockchip_gem_prime_end_cpu_access_partial(obj, dir, offset, len);
+}
+
 static const struct dma_buf_ops rockchip_drm_gem_prime_dmabuf_ops = {
 	.cache_sgt_mapping = true,
 	.attach = drm_gem_map_attach,
@@ -1902,6 +2045,10 @@ static const struct dma_buf_ops rockchip_drm_gem_prime_dmabuf_ops = {
 	.vunmap = drm_gem_dmabuf_vunmap,
 	.begin_cpu_access = rockchip_drm_gem_dmabuf_begin_cpu_access,
 	.end_cpu_access = rockchip_drm_gem_dmabuf_end_cpu_access,
+#ifdef CONFIG_DMABUF_PARTIAL
+	.begin_cpu_access_partial = rockchip_drm_gem_dmabuf_begin_cpu_access_partial,
+	.end_cpu_access_partial = rockchip_drm_gem_dmabuf_end_cpu_access_partial,
+#endif
 };
 
 static struct drm_gem_object *rockchip_drm_gem_prime_import_dev(struct drm_device *dev,
@@ -1978,6 +2125,7 @@ struct dma_buf *rockchip_drm_gem_prime_export(struct drm_gem_object *obj,
 		.flags = flags,
 		.priv = obj,
 		.resv = obj->resv,
+		.uncached = rockchip_gem_is_uncached(to_rockchip_obj(obj)),
 	};
 
 	return drm_gem_dmabuf_export(dev, &exp_info);
@@ -2296,6 +2444,8 @@ static int __init rockchip_drm_init(void)
 		goto err_unreg_drivers;
 
 	rockchip_gem_get_ddr_info();
+	if (rockchip_gem_page_pool_init())
+		DRM_WARN("failed to register gem page pool shrinker\n");
 
 	return 0;
 
@@ -2311,6 +2461,8 @@ static void __exit rockchip_drm_fini(void)
 
 	platform_unregister_drivers(rockchip_sub_drivers,
 				    num_rockchip_sub_drivers);
+
+	rockchip_gem_page_pool_fini();
 }
 
 #ifdef CONFIG_VIDEO_REVERSE_IMAGE
@@ -17,6 +17,7 @@
 #include <drm/drm_gem.h>
 #include <drm/rockchip_drm.h>
 
+#include <linux/llist.h>
 #include <linux/media-bus-format.h>
 #include <linux/module.h>
 #include <linux/component.h>
@@ -257,6 +258,10 @@ struct post_sharp {
 
 struct rockchip_crtc_state {
 	struct drm_crtc_state base;
+	/**
+	 * @reclaim_node: entry of the deferred free list of the crtc
+	 */
+	struct llist_node reclaim_node;
 	int vp_id;
 	int output_type;
 	int output_mode;
@@ -339,8 +344,16 @@ struct rockchip_crtc_state {
 	int request_refresh_rate;
 	int max_refresh_rate;
 	int min_refresh_rate;
+	int vrr_late_latch;
+	int genlock;
 	int shift_x;
 	int shift_y;
+	/**
+	 * @damage: area of the crtc changed by this commit, merged from the
+	 * FB_DAMAGE_CLIPS of all planes, empty when nothing visible changed.
+	 * Available to the encoders for selective update.
+	 */
+	struct drm_rect damage;
 };
 
 #define to_rockchip_crtc_state(s) \
@@ -479,6 +492,9 @@ struct next_hdr_sink_data {
  * @crtc_send_mcu_cmd: send mcu panel init cmd.
  * @te_handler: soft te hand for cmd mode panel.
  * @wait_vact_end: wait the last active line.
+ * @wait_vblank_window: wait the start of vertical blanking, called by dmc
+ *                      with the dmcfreq write lock held.
+ * @wb_stream: continuous write back capture, see DRM_IOCTL_ROCKCHIP_WB_STREAM.
  */
 struct rockchip_crtc_funcs {
 	int (*loader_protect)(struct drm_crtc *crtc, bool on, void *data);
@@ -502,12 +518,16 @@ struct rockchip_crtc_funcs {
 	void (*crtc_send_mcu_cmd)(struct drm_crtc *crtc, u32 type, u32 value);
 	void (*te_handler)(struct drm_crtc *crtc);
 	int (*wait_vact_end)(struct drm_crtc *crtc, unsigned int mstimeout);
+	int (*wait_vblank_window)(struct drm_crtc *crtc, unsigned int mstimeout);
 	void (*crtc_standby)(struct drm_crtc *crtc, bool standby);
 	void (*crtc_output_post_enable)(struct drm_crtc *crtc, int intf);
 	void (*crtc_output_pre_disable)(struct drm_crtc *crtc, int intf);
 	int (*crtc_set_color_bar)(struct drm_crtc *crtc, enum rockchip_color_bar_mode mode);
 	int (*set_aclk)(struct drm_crtc *crtc, enum rockchip_drm_vop_aclk_mode aclk_mode);
 	int (*get_crc)(struct drm_crtc *crtc);
+	u32 (*get_underflow_count)(struct drm_crtc *crtc);
+	int (*wb_stream)(struct drm_crtc *crtc, struct drm_file *file,
+			 struct drm_rockchip_wb_stream *args);
 };
 
 struct rockchip_dclk_pll {
@@ -529,6 +549,10 @@ struct rockchip_drm_private {
 	struct iommu_domain *domain;
 	struct device *iommu_dev;
 	struct gen_pool *secure_buffer_pool;
+	/* freed secure buffers kept for reuse */
+	struct list_head secure_cache;
+	struct mutex secure_cache_lock;
+	unsigned int secure_cache_count;
 	struct mutex mm_lock;
 	struct drm_mm mm;
 	struct list_head psr_list;
@@ -613,6 +637,8 @@ const char *rockchip_drm_get_color_range_name(enum drm_color_range range);
 #if IS_REACHABLE(CONFIG_DRM_ROCKCHIP)
 int rockchip_drm_get_sub_dev_type(void);
 u32 rockchip_drm_get_scan_line_time_ns(void);
+u32 rockchip_drm_get_frame_time_us(void);
+int rockchip_drm_wait_vblank_window(unsigned int mstimeout);
 #else
 static inline int rockchip_drm_get_sub_dev_type(void)
 {
@@ -623,6 +649,16 @@ static inline u32 rockchip_drm_get_scan_line_time_ns(void)
 {
 	return 0;
 }
+
+static inline u32 rockchip_drm_get_frame_time_us(void)
+{
+	return 0;
+}
+
+static inline int rockchip_drm_wait_vblank_window(unsigned int mstimeout)
+{
+	return -ENODEV;
+}
 #endif
 
 int rockchip_drm_endpoint_is_subdriver(struct device_node *ep);
@@ -0,0 +1,461 @@
+// SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd.
+ *
+ * In kernel compositor on top of direct show: frames from camera/cif/isp
+ * drivers are scaled/rotated/converted by RGA into a small ring of
+ * scanout buffers and committed to a plane, so video can be shown from
+ * boot without any userspace.
+ */
+#include <linux/fdtable.h>
+#include <linux/file.h>
+#include <linux/kthread.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <drm/drm_blend.h>
+#include <drm/drm_fourcc.h>
+
+#include "rockchip_drm_direct_show.h"
+#include "rockchip_drm_ds_compositor.h"
+#include "../../../video/rockchip/rga3/include/rga_drv.h"
+
+static int drm_ds_comp_debug;
+module_param_named(ds_compositor_debug, drm_ds_comp_debug, int, 0644);
+MODULE_PARM_DESC(ds_compositor_debug, "enable direct show compositor debug log");
+
+#define DRM_DS_COMP_DBG(format, ...) do {	\
+	if (drm_ds_comp_debug)	\
+		pr_info("DRM_DS_COMP: %s(%d): " format, __func__, __LINE__, ## __VA_ARGS__);	\
+	} while (0)
+
+#define DRM_DS_COMP_ERR(format, ...) \
+	pr_info("ERR: DRM_DS_COMP: %s(%d): " format, __func__, __LINE__, ## __VA_ARGS__)
+
+#define DS_COMP_BUF_NUM		3
+
+struct rockchip_ds_compositor {
+	struct drm_device *drm;
+	struct drm_crtc *crtc;
+	struct drm_plane *plane;
+	struct rockchip_ds_compositor_config config;
+
+	struct rockchip_drm_direct_show_buffer bufs[DS_COMP_BUF_NUM];
+	int nr_bufs;
+	int buf_idx;
+	bool plane_enabled;
+
+	struct task_struct *thread;
+	struct completion thread_ready;
+	int thread_ret;
+
+	/* protect pending and has_pending */
+	spinlock_t lock;
+	wait_queue_head_t wait;
+	struct rockchip_ds_frame pending;
+	bool has_pending;
+
+	u64 frame_count;
+	u64 drop_count;
+};
+
+static int rockchip_ds_comp_rga_format(u32 drm_format)
+{
+	switch (drm_format) {
+	case DRM_FORMAT_XRGB8888:
+		return RGA_FORMAT_BGRX_8888;
+	case DRM_FORMAT_ARGB8888:
+		return RGA_FORMAT_BGRA_8888;
+	case DRM_FORMAT_XBGR8888:
+		return RGA_FORMAT_RGBX_8888;
+	case DRM_FORMAT_ABGR8888:
+		return RGA_FORMAT_RGBA_8888;
+	case DRM_FORMAT_RGB888:
+		return RGA_FORMAT_BGR_888;
+	case DRM_FORMAT_BGR888:
+		return RGA_FORMAT_RGB_888;
+	case DRM_FORMAT_RGB565:
+		return RGA_FORMAT_RGB_565;
+	case DRM_FORMAT_NV12:
+		return RGA_FORMAT_YCbCr_420_SP;
+	case DRM_FORMAT_NV21:
+		return RGA_FORMAT_YCrCb_420_SP;
+	case DRM_FORMAT_NV16:
+		return RGA_FORMAT_YCbCr_422_SP;
+	case DRM_FORMAT_NV61:
+		return RGA_FORMAT_YCrCb_422_SP;
+	case DRM_FORMAT_YUYV:
+		return RGA_FORMAT_YUYV_422;
+	case DRM_FORMAT_UYVY:
+		return RGA_FORMAT_UYVY_422;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void rockchip_ds_comp_release_frame(struct rockchip_ds_frame *frame)
+{
+	if (frame->release)
+		frame->release(frame, frame->priv);
+	dma_buf_put(frame->dmabuf);
+}
+
+static int rockchip_ds_comp_blit(struct rockchip_ds_compositor *comp,
+				 struct rockchip_ds_frame *frame,
+				 struct rockchip_drm_direct_show_buffer *dst)
+{
+	struct rockchip_ds_compositor_config *config = &comp->config;
+	struct rga_req rga_request;
+	u32 src_w, src_h, dst_w, dst_h;
+	int src_fd, ret;
+
+	memset(&rga_request, 0, sizeof(rga_request));
+
+	/*
+	 * rga_kernel_commit() takes dma-buf fds, install one for the source
+	 * frame in the compositor thread, the same table that holds the fds
+	 * of the output buffers.
+	 */
+	get_dma_buf(frame->dmabuf);
+	src_fd = dma_buf_fd(frame->dmabuf, O_CLOEXEC);
+	if (src_fd < 0) {
+		dma_buf_put(frame->dmabuf);
+		return src_fd;
+	}
+
+	src_w = frame->src_w ? frame->src_w : frame->width;
+	src_h = frame->src_h ? frame->src_h : frame->height;
+	dst_w = config->width;
+	dst_h = config->height;
+
+	rga_request.src.yrgb_addr = src_fd;
+	rga_request.src.format = rockchip_ds_comp_rga_format(frame->pixel_format);
+	rga_request.src.vir_w = frame->stride ? frame->stride : frame->width;
+	rga_request.src.vir_h = frame->height;
+	rga_request.src.act_w = src_w;
+	rga_request.src.act_h = src_h;
+	rga_request.src.x_offset = frame->src_x;
+	rga_request.src.y_offset = frame->src_y;
+
+	rga_request.dst.yrgb_addr = dst->dmabuf_fd;
+	rga_request.dst.format = rockchip_ds_comp_rga_format(config->pixel_format);
+	rga_request.dst.vir_w = dst->pitch[0] * 8 / dst->bpp;
+	rga_request.dst.vir_h = dst_h;
+	rga_request.dst.act_w = dst_w;
+	rga_request.dst.act_h = dst_h;
+
+	switch (config->rotation) {
+	case DRM_MODE_ROTATE_90:
+		rga_request.rotate_mode = 1;
+		rga_request.sina = 65536;
+		rga_request.cosa = 0;
+		rga_request.dst.act_w = dst_h;
+		rga_request.dst.act_h = dst_w;
+		break;
+	case DRM_MODE_ROTATE_180:
+		rga_request.rotate_mode = 1;
+		rga_request.sina = 0;
+		rga_request.cosa = -65536;
+		break;
+	case DRM_MODE_ROTATE_270:
+		rga_request.rotate_mode = 1;
+		rga_request.sina = -65536;
+		rga_request.cosa = 0;
+		rga_request.dst.act_w = dst_h;
+		rga_request.dst.act_h = dst_w;
+		break;
+	case DRM_MODE_ROTATE_0 | DRM_MODE_REFLECT_X:
+		rga_request.rotate_mode = 2;
+		break;
+	case DRM_MODE_ROTATE_0 | DRM_MODE_REFLECT_Y:
+		rga_request.rotate_mode = 3;
+		break;
+	default:
+		break;
+	}
+
+	rga_request.clip.xmin = 0;
+	rga_request.clip.xmax = dst_w - 1;
+	rga_request.clip.ymin = 0;
+	rga_request.clip.ymax = dst_h - 1;
+	rga_request.scale_mode = 1;
+
+	rga_request.mmu_info.mmu_en = 1;
+	rga_request.mmu_info.mmu_flag = ((2 & 0x3) << 4) |
+		 1 | (1 << 31 | 1 << 8 | 1 << 10);
+
+	rga_request.src.rd_mode = RGA_RASTER_MODE;
+	rga_request.dst.rd_mode = RGA_RASTER_MODE;
+
+	ret = rga_kernel_commit(&rga_request);
+	if (ret)
+		DRM_DS_COMP_ERR("rga blit failed: %d\n", ret);
+
+	close_fd(src_fd);
+
+	return ret;
+}
+
+static int rockchip_ds_comp_show(struct rockchip_ds_compositor *comp,
+				 struct rockchip_drm_direct_show_buffer *buf)
+{
+	struct rockchip_ds_compositor_config *config = &comp->config;
+	struct rockchip_drm_direct_show_commit_info commit_info = { 0 };
+	int ret;
+
+	commit_info.crtc = comp->crtc;
+	commit_info.plane = comp->plane;
+	commit_info.buffer = buf;
+	commit_info.src_x = 0;
+	commit_info.src_y = 0;
+	commit_info.src_w = config->width;
+	commit_info.src_h = config->height;
+	commit_info.dst_x = config->dst_x;
+	commit_info.dst_y = config->dst_y;
+	commit_info.dst_w = config->dst_w ? config->dst_w : config->width;
+	commit_info.dst_h = config->dst_h ? config->dst_h : config->height;
+	commit_info.top_zpos = config->top_zpos;
+
+	/* blocks until the plane scans out buf, the old buffer is then free */
+	ret = rockchip_drm_direct_show_commit(comp->drm, &commit_info);
+	if (ret)
+		DRM_DS_COMP_ERR("commit to %s failed: %d\n", comp->plane->name, ret);
+	else
+		comp->plane_enabled = true;
+
+	return ret;
+}
+
+static void rockchip_ds_comp_free_buffers(struct rockchip_ds_compositor *comp)
+{
+	int i;
+
+	for (i = 0; i < comp->nr_bufs; i++) {
+		close_fd(comp->bufs[i].dmabuf_fd);
+		rockchip_drm_direct_show_free_buffer(comp->drm, &comp->bufs[i]);
+	}
+	comp->nr_bufs = 0;
+}
+
+static int rockchip_ds_comp_alloc_buffers(struct rockchip_ds_compositor *comp)
+{
+	struct rockchip_drm_direct_show_buffer *buf;
+	int i, ret;
+
+	for (i = 0; i < DS_COMP_BUF_NUM; i++) {
+		buf = &comp->bufs[i];
+		buf->width = comp->config.width;
+		buf->height = comp->config.height;
+		buf->pixel_format = comp->config.pixel_format;
+		ret = rockchip_drm_direct_show_alloc_buffer(comp->drm, buf);
+		if (ret) {
+			DRM_DS_COMP_ERR("alloc buffer %d failed: %d\n", i, ret);
+			rockchip_ds_comp_free_buffers(comp);
+			return ret;
+		}
+		comp->nr_bufs++;
+	}
+
+	return 0;
+}
+
+static int rockchip_ds_comp_thread(void *data)
+{
+	struct rockchip_ds_compositor *comp = data;
+	struct rockchip_drm_direct_show_buffer *buf;
+	struct rockchip_ds_frame frame;
+	unsigned long flags;
+	int ret;
+
+	/* the dma-buf fds must be valid in the thread that calls rga */
+	comp->thread_ret = rockchip_ds_comp_alloc_buffers(comp);
+	complete(&comp->thread_ready);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(comp->wait,
+					 comp->has_pending || kthread_should_stop());
+
+		spin_lock_irqsave(&comp->lock, flags);
+		if (!comp->has_pending) {
+			spin_unlock_irqrestore(&comp->lock, flags);
+			continue;
+		}
+		frame = comp->pending;
+		comp->has_pending = false;
+		spin_unlock_irqrestore(&comp->lock, flags);
+
+		if (comp->thread_ret) {
+			rockchip_ds_comp_release_frame(&frame);
+			continue;
+		}
+
+		buf = &comp->bufs[comp->buf_idx];
+		ret = rockchip_ds_comp_blit(comp, &frame, buf);
+		rockchip_ds_comp_release_frame(&frame);
+		if (ret)
+			continue;
+
+		if (!rockchip_ds_comp_show(comp, buf)) {
+			comp->buf_idx = (comp->buf_idx + 1) % comp->nr_bufs;
+			comp->frame_count++;
+		}
+		DRM_DS_COMP_DBG("frame %llu shown, %llu dropped\n",
+				comp->frame_count, comp->drop_count);
+	}
+
+	if (comp->plane_enabled)
+		rockchip_drm_direct_show_disable_plane(comp->drm, comp->plane);
+	rockchip_ds_comp_free_buffers(comp);
+
+	return 0;
+}
+
+/**
+ * rockchip_ds_compositor_create - start a compositor on a crtc/plane
+ * @config: output description, copied, the caller may free it afterwards
+ *
+ * Returns the compositor or an ERR_PTR().
+ */
+struct rockchip_ds_compositor *
+rockchip_ds_compositor_create(const struct rockchip_ds_compositor_config *config)
+{
+	struct rockchip_ds_compositor *comp;
+	const struct drm_format_info *info;
+	int ret;
+
+	if (!config || !config->width || !config->height)
+		return ERR_PTR(-EINVAL);
+
+	if (rockchip_ds_comp_rga_format(config->pixel_format) < 0) {
+		DRM_DS_COMP_ERR("unsupported output format %p4cc\n", &config->pixel_format);
+		return ERR_PTR(-EINVAL);
+	}
+
+	/*
+	 * direct show places the chroma plane right after width * height,
+	 * rga expects it after vir_w * vir_h, they only agree without padding.
+	 */
+	info = drm_format_info(config->pixel_format);
+	if (info->is_yuv && !IS_ALIGNED(config->width, 64)) {
+		DRM_DS_COMP_ERR("yuv output width %d must be 64 aligned\n", config->width);
+		return ERR_PTR(-EINVAL);
+	}
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return ERR_PTR(-ENOMEM);
+
+	comp->config = *config;
+	comp->drm = rockchip_drm_get_dev();
+	if (!comp->drm) {
+		ret = -EPROBE_DEFER;
+		goto err_free;
+	}
+
+	comp->crtc = rockchip_drm_direct_show_get_crtc(comp->drm, config->crtc_name);
+	comp->plane = rockchip_drm_direct_show_get_plane(comp->drm, config->plane_name);
+	if (!comp->crtc || !comp->plane) {
+		DRM_DS_COMP_ERR("failed to find crtc %s or plane %s\n",
+				config->crtc_name, config->plane_name);
+		ret = -ENODEV;
+		goto err_free;
+	}
+
+	spin_lock_init(&comp->lock);
+	init_waitqueue_head(&comp->wait);
+	init_completion(&comp->thread_ready);
+
+	comp->thread = kthread_run(rockchip_ds_comp_thread, comp, "ds_comp_%s",
+				   comp->plane->name);
+	if (IS_ERR(comp->thread)) {
+		ret = PTR_ERR(comp->thread);
+		goto err_free;
+	}
+
+	wait_for_completion(&comp->thread_ready);
+	if (comp->thread_ret) {
+		ret = comp->thread_ret;
+		kthread_stop(comp->thread);
+		goto err_free;
+	}
+
+	return comp;
+
+err_free:
+	kfree(comp);
+
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL(rockchip_ds_compositor_create);
+
+/**
+ * rockchip_ds_compositor_queue_frame - hand a frame to the compositor
+ * @comp: compositor
+ * @frame: source frame, copied
+ *
+ * Only the latest frame is kept, a frame still waiting for the compositor
+ * thread is released when a newer one is queued. The compositor takes its
+ * own reference on @frame->dmabuf. May be called from atomic context.
+ */
+int rockchip_ds_compositor_queue_frame(struct rockchip_ds_compositor *comp,
+				       const struct rockchip_ds_frame *frame)
+{
+	struct rockchip_ds_frame old;
+	unsigned long flags;
+	bool drop;
+
+	if (!comp || !frame || !frame->dmabuf)
+		return -EINVAL;
+
+	if (rockchip_ds_comp_rga_format(frame->pixel_format) < 0)
+		return -EINVAL;
+
+	if (frame->src_x + (frame->src_w ? frame->src_w : frame->width) > frame->width ||
+	    frame->src_y + (frame->src_h ? frame->src_h : frame->height) > frame->height)
+		return -EINVAL;
+
+	get_dma_buf(frame->dmabuf);
+
+	spin_lock_irqsave(&comp->lock, flags);
+	drop = comp->has_pending;
+	if (drop) {
+		old = comp->pending;
+		comp->drop_count++;
+	}
+	comp->pending = *frame;
+	comp->has_pending = true;
+	spin_unlock_irqrestore(&comp->lock, flags);
+
+	if (drop)
+		rockchip_ds_comp_release_frame(&old);
+
+	wake_up(&comp->wait);
+
+	return 0;
+}
+EXPORT_SYMBOL(rockchip_ds_compositor_queue_frame);
+
+/**
+ * rockchip_ds_compositor_destroy - stop the compositor and disable its plane
+ * @comp: compositor
+ */
+void rockchip_ds_compositor_destroy(struct rockchip_ds_compositor *comp)
+{
+	unsigned long flags;
+	bool has_pending;
+
+	if (IS_ERR_OR_NULL(comp))
+		return;
+
+	kthread_stop(comp->thread);
+
+	spin_lock_irqsave(&comp->lock, flags);
+	has_pending = comp->has_pending;
+	comp->has_pending = false;
+	spin_unlock_irqrestore(&comp->lock, flags);
+
+	if (has_pending)
+		rockchip_ds_comp_release_frame(&comp->pending);
+
+	kfree(comp);
+}
+EXPORT_SYMBOL(rockchip_ds_compositor_destroy);
@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: (GPL-2.0+ OR MIT) */
+/*
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef ROCKCHIP_DRM_DS_COMPOSITOR_H
+#define ROCKCHIP_DRM_DS_COMPOSITOR_H
+
+#include <linux/dma-buf.h>
+#include <linux/err.h>
+#include <linux/types.h>
+
+struct rockchip_ds_compositor;
+
+struct rockchip_ds_compositor_config {
+	const char *crtc_name;
+	const char *plane_name;
+
+	/* composed output buffer, scanned out by plane */
+	u32 width;
+	u32 height;
+	u32 pixel_format;	/* DRM_FORMAT_* */
+
+	/* output rotation, DRM_MODE_ROTATE_* | DRM_MODE_REFLECT_* */
+	u32 rotation;
+
+	/* plane position on crtc */
+	u32 dst_x;
+	u32 dst_y;
+	u32 dst_w;
+	u32 dst_h;
+	bool top_zpos;
+};
+
+struct rockchip_ds_frame {
+	struct dma_buf *dmabuf;
+	u32 width;		/* pixels */
+	u32 height;
+	u32 stride;		/* pixels, 0 means same as width */
+	u32 pixel_format;	/* DRM_FORMAT_* */
+
+	/* crop of the source frame, all zero means the full frame */
+	u32 src_x;
+	u32 src_y;
+	u32 src_w;
+	u32 src_h;
+
+	/*
+	 * called once the compositor no longer reads from dmabuf, either
+	 * after the blit or when the frame is dropped for a newer one.
+	 */
+	void (*release)(struct rockchip_ds_frame *frame, void *priv);
+	void *priv;
+};
+
+#if IS_ENABLED(CONFIG_ROCKCHIP_DRM_DS_COMPOSITOR)
+struct rockchip_ds_compositor *
+rockchip_ds_compositor_create(const struct rockchip_ds_compositor_config *config);
+int rockchip_ds_compositor_queue_frame(struct rockchip_ds_compositor *comp,
+				       const struct rockchip_ds_frame *frame);
+void rockchip_ds_compositor_destroy(struct rockchip_ds_compositor *comp);
+#else
+static inline struct rockchip_ds_compositor *
+rockchip_ds_compositor_create(const struct rockchip_ds_compositor_config *config)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline int rockchip_ds_compositor_queue_frame(struct rockchip_ds_compositor *comp,
+						     const struct rockchip_ds_frame *frame)
+{
+	return -ENODEV;
+}
+
+static inline void rockchip_ds_compositor_destroy(struct rockchip_ds_compositor *comp)
+{
+}
+#endif
+
+#endif
@@ -366,10 +366,42 @@ static void rockchip_drm_output_poll_changed(struct drm_device *dev)
 		drm_fb_helper_hotplug_event(fb_helper);
 }
 
+/*
+ * The first commit from userspace always carries a new mode blob, which
+ * flags a full modeset even when it holds the mode the logo is shown with.
+ * If the crtc still scans out the logo with an equal mode, keep the
+ * timing untouched so the handover is just a flip of the primary plane.
+ * Any routing change is still caught as connectors_changed by the helper.
+ */
+static void rockchip_drm_logo_seamless_check(struct drm_atomic_state *state)
+{
+	struct drm_crtc_state *old_crtc_state, *new_crtc_state;
+	struct drm_framebuffer *fb;
+	struct drm_crtc *crtc;
+	int i;
+
+	for_each_oldnew_crtc_in_state(state, crtc, old_crtc_state, new_crtc_state, i) {
+		if (!new_crtc_state->mode_changed || !crtc->primary ||
+		    !old_crtc_state->active || !new_crtc_state->active)
+			continue;
+
+		fb = crtc->primary->state->fb;
+		if (!fb || !is_rockchip_logo_fb(fb) ||
+		    !drm_mode_equal(&old_crtc_state->mode, &new_crtc_state->mode))
+			continue;
+
+		new_crtc_state->mode_changed = false;
+		DRM_DEV_DEBUG_KMS(state->dev->dev, "seamless logo handover on crtc-%d\n",
+				  crtc->base.id);
+	}
+}
+
 static int rockchip_atomic_check(struct drm_device *dev, struct drm_atomic_state *state)
 {
 	int ret;
 
+	rockchip_drm_logo_seamless_check(state);
+
 	ret = drm_atomic_helper_check(dev, state);
 	if (ret)
 		return ret;
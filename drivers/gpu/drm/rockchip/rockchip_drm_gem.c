@@ -15,8 +15,11 @@
 #include <drm/drm_vma_manager.h>
 
 #include <linux/genalloc.h>
+#include <linux/highmem.h>
 #include <linux/iommu.h>
 #include <linux/pagemap.h>
+#include <linux/shrinker.h>
+#include <linux/sizes.h>
 #include <linux/vmalloc.h>
 #include <linux/rockchip/rockchip_sip.h>
 
@@ -33,16 +36,184 @@ struct page_info {
 
 #define PG_ROUND       8
 
+/*
+ * Page pool for ROCKCHIP_BO_LARGE_PAGE buffers. Like the rk system heap,
+ * buffers are built from the largest chunks available (2M, 1M, 64K and
+ * then 4K), which keeps them physically contiguous in big pieces and lets
+ * the iommu map them in large blocks. Freed chunks are zeroed and kept
+ * for the next allocation, the shrinker gives them back under pressure.
+ */
+#define HIGH_ORDER_GFP	(((GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN | \
+			   __GFP_NORETRY) & ~__GFP_RECLAIM) | __GFP_COMP)
+#define LOW_ORDER_GFP	(GFP_HIGHUSER | __GFP_ZERO)
+#define POOL_MAX_SIZE	SZ_64M
+
+static const unsigned int pool_orders[] = { 9, 8, 4, 0 };
+#define NUM_POOL_ORDERS	ARRAY_SIZE(pool_orders)
+
+struct rockchip_gem_page_pool {
+	spinlock_t lock;
+	struct list_head items;
+	unsigned int count;
+	unsigned int order;
+	gfp_t gfp_mask;
+};
+
+static struct rockchip_gem_page_pool page_pools[NUM_POOL_ORDERS];
+
+static struct page *rockchip_gem_page_pool_remove(struct rockchip_gem_page_pool *pool)
+{
+	struct page *page;
+
+	spin_lock(&pool->lock);
+	page = list_first_entry_or_null(&pool->items, struct page, lru);
+	if (page) {
+		list_del(&page->lru);
+		pool->count--;
+	}
+	spin_unlock(&pool->lock);
+
+	return page;
+}
+
+static struct page *rockchip_gem_page_pool_alloc(unsigned long size, unsigned int max_order)
+{
+	struct rockchip_gem_page_pool *pool;
+	struct page *page;
+	int i;
+
+	for (i = 0; i < NUM_POOL_ORDERS; i++) {
+		pool = &page_pools[i];
+		if (size < (PAGE_SIZE << pool->order) || max_order < pool->order)
+			continue;
+
+		page = rockchip_gem_page_pool_remove(pool);
+		if (!page)
+			page = alloc_pages(pool->gfp_mask, pool->order);
+		if (page)
+			return page;
+	}
+
+	return NULL;
+}
+
+static void rockchip_gem_page_pool_free(struct page *page)
+{
+	unsigned int order = compound_order(page);
+	struct rockchip_gem_page_pool *pool = NULL;
+	int i;
+
+	for (i = 0; i < NUM_POOL_ORDERS; i++) {
+		if (page_pools[i].order == order) {
+			pool = &page_pools[i];
+			break;
+		}
+	}
+
+	if (!pool || ((pool->count + 1) << (PAGE_SHIFT + order)) > POOL_MAX_SIZE) {
+		__free_pages(page, order);
+		return;
+	}
+
+	/* pages in the pool must not leak the content of the last user */
+	for (i = 0; i < (1 << order); i++)
+		clear_highpage(nth_page(page, i));
+
+	spin_lock(&pool->lock);
+	list_add_tail(&page->lru, &pool->items);
+	pool->count++;
+	spin_unlock(&pool->lock);
+}
+
+static unsigned long rockchip_gem_page_pool_count(struct shrinker *shrinker,
+						  struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int i;
+
+	for (i = 0; i < NUM_POOL_ORDERS; i++)
+		count += (unsigned long)READ_ONCE(page_pools[i].count) << page_pools[i].order;
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+static unsigned long rockchip_gem_page_pool_scan(struct shrinker *shrinker,
+						 struct shrink_control *sc)
+{
+	unsigned long freed = 0;
+	struct page *page;
+	int i;
+
+	/* give back the smaller chunks first, they are the cheapest to get again */
+	for (i = NUM_POOL_ORDERS - 1; i >= 0 && freed < sc->nr_to_scan; i--) {
+		while (freed < sc->nr_to_scan) {
+			page = rockchip_gem_page_pool_remove(&page_pools[i]);
+			if (!page)
+				break;
+			__free_pages(page, page_pools[i].order);
+			freed += 1 << page_pools[i].order;
+		}
+	}
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker rockchip_gem_page_pool_shrinker = {
+	.count_objects = rockchip_gem_page_pool_count,
+	.scan_objects = rockchip_gem_page_pool_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+int rockchip_gem_page_pool_init(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_POOL_ORDERS; i++) {
+		spin_lock_init(&page_pools[i].lock);
+		INIT_LIST_HEAD(&page_pools[i].items);
+		page_pools[i].order = pool_orders[i];
+		page_pools[i].gfp_mask = pool_orders[i] ? HIGH_ORDER_GFP : LOW_ORDER_GFP;
+	}
+
+	return register_shrinker(&rockchip_gem_page_pool_shrinker, "rockchip-gem-pool");
+}
+
+void rockchip_gem_page_pool_fini(void)
+{
+	struct page *page;
+	int i;
+
+	unregister_shrinker(&rockchip_gem_page_pool_shrinker);
+
+	for (i = 0; i < NUM_POOL_ORDERS; i++) {
+		while ((page = rockchip_gem_page_pool_remove(&page_pools[i])))
+			__free_pages(page, page_pools[i].order);
+	}
+}
+
 static int rockchip_gem_iommu_map(struct rockchip_gem_object *rk_obj)
 {
 	struct drm_device *drm = rk_obj->base.dev;
 	struct rockchip_drm_private *private = drm->dev_private;
 	int prot = IOMMU_READ | IOMMU_WRITE;
+	unsigned long align = PAGE_SIZE;
 	ssize_t ret;
 
+	/*
+	 * Align the iova of a pool buffer to its largest chunk, so the
+	 * chunks can be mapped as blocks.
+	 */
+	if (rk_obj->buf_type == ROCKCHIP_GEM_BUF_TYPE_POOL) {
+		struct page *page = list_first_entry_or_null(&rk_obj->pool_chunks,
+							     struct page, lru);
+
+		if (page)
+			align = PAGE_SIZE << compound_order(page);
+	}
+
 	mutex_lock(&private->mm_lock);
 	ret = drm_mm_insert_node_generic(&private->mm, &rk_obj->mm,
-					 rk_obj->base.size, PAGE_SIZE,
+					 rk_obj->base.size, align,
 					 0, 0);
 	mutex_unlock(&private->mm_lock);
 
@@ -254,6 +425,76 @@ static void rockchip_gem_put_pages(struct rockchip_gem_object *rk_obj)
 	drm_gem_put_pages(&rk_obj->base, rk_obj->pages, true, true);
 }
 
+static void rockchip_gem_pool_free_chunks(struct list_head *chunks)
+{
+	struct page *page, *tmp_page;
+
+	list_for_each_entry_safe(page, tmp_page, chunks, lru) {
+		list_del(&page->lru);
+		rockchip_gem_page_pool_free(page);
+	}
+}
+
+static int rockchip_gem_pool_get_pages(struct rockchip_gem_object *rk_obj)
+{
+	struct drm_device *drm = rk_obj->base.dev;
+	unsigned long remain = rk_obj->base.size;
+	unsigned int max_order = pool_orders[0];
+	unsigned int order, n = 0;
+	struct scatterlist *s;
+	struct page *page;
+	int ret, i;
+
+	INIT_LIST_HEAD(&rk_obj->pool_chunks);
+	rk_obj->num_pages = rk_obj->base.size >> PAGE_SHIFT;
+	rk_obj->pages = kvmalloc_array(rk_obj->num_pages, sizeof(*rk_obj->pages), GFP_KERNEL);
+	if (!rk_obj->pages)
+		return -ENOMEM;
+
+	while (remain) {
+		page = rockchip_gem_page_pool_alloc(remain, max_order);
+		if (!page) {
+			ret = -ENOMEM;
+			goto err_free_chunks;
+		}
+
+		order = compound_order(page);
+		list_add_tail(&page->lru, &rk_obj->pool_chunks);
+		for (i = 0; i < (1 << order); i++)
+			rk_obj->pages[n++] = nth_page(page, i);
+		remain -= PAGE_SIZE << order;
+		max_order = order;
+	}
+
+	rk_obj->sgt = drm_prime_pages_to_sg(drm, rk_obj->pages, rk_obj->num_pages);
+	if (IS_ERR(rk_obj->sgt)) {
+		ret = PTR_ERR(rk_obj->sgt);
+		goto err_free_chunks;
+	}
+
+	/* see rockchip_gem_get_pages() */
+	for_each_sgtable_sg(rk_obj->sgt, s, i)
+		sg_dma_address(s) = sg_phys(s);
+
+	dma_sync_sgtable_for_device(drm->dev, rk_obj->sgt, DMA_TO_DEVICE);
+
+	return 0;
+
+err_free_chunks:
+	rockchip_gem_pool_free_chunks(&rk_obj->pool_chunks);
+	kvfree(rk_obj->pages);
+	rk_obj->pages = NULL;
+	return ret;
+}
+
+static void rockchip_gem_pool_put_pages(struct rockchip_gem_object *rk_obj)
+{
+	sg_free_table(rk_obj->sgt);
+	kfree(rk_obj->sgt);
+	rockchip_gem_pool_free_chunks(&rk_obj->pool_chunks);
+	kvfree(rk_obj->pages);
+}
+
 static inline void *drm_calloc_large(size_t nmemb, size_t size);
 static inline void drm_free_large(void *ptr);
 static void rockchip_gem_free_dma(struct rockchip_gem_object *rk_obj);
@@ -346,6 +587,113 @@ static inline void drm_free_large(void *ptr)
 	kvfree(ptr);
 }
 
+/*
+ * Freed secure buffers are kept for reuse, up to secure_cache_num of them.
+ * A decoder reference set is a batch of equal sized buffers, so a seek or
+ * a restart of protected playback is served from here without another
+ * carveout allocation and page table build. Cached buffers are dropped
+ * when the carveout runs out for a new size.
+ */
+static unsigned int secure_cache_num;
+module_param(secure_cache_num, uint, 0644);
+MODULE_PARM_DESC(secure_cache_num, "freed secure buffers kept for reuse");
+
+struct rockchip_gem_secure_buf {
+	struct list_head node;
+	size_t size;
+	dma_addr_t paddr;
+	struct page **pages;
+	struct sg_table *sgt;
+};
+
+static bool rockchip_gem_secure_cache_get(struct rockchip_drm_private *private,
+					  struct rockchip_gem_object *rk_obj)
+{
+	struct rockchip_gem_secure_buf *buf, *found = NULL;
+
+	mutex_lock(&private->secure_cache_lock);
+	list_for_each_entry(buf, &private->secure_cache, node) {
+		if (buf->size == rk_obj->base.size) {
+			list_del(&buf->node);
+			private->secure_cache_count--;
+			found = buf;
+			break;
+		}
+	}
+	mutex_unlock(&private->secure_cache_lock);
+
+	if (!found)
+		return false;
+
+	rk_obj->dma_handle = found->paddr;
+	rk_obj->num_pages = found->size >> PAGE_SHIFT;
+	rk_obj->pages = found->pages;
+	rk_obj->sgt = found->sgt;
+	kfree(found);
+
+	return true;
+}
+
+static bool rockchip_gem_secure_cache_put(struct rockchip_drm_private *private,
+					  struct rockchip_gem_object *rk_obj)
+{
+	struct rockchip_gem_secure_buf *buf;
+	bool cached = false;
+
+	if (!READ_ONCE(secure_cache_num))
+		return false;
+
+	buf = kmalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return false;
+
+	buf->size = rk_obj->base.size;
+	buf->paddr = rk_obj->dma_handle;
+	buf->pages = rk_obj->pages;
+	buf->sgt = rk_obj->sgt;
+
+	mutex_lock(&private->secure_cache_lock);
+	if (private->secure_cache_count < READ_ONCE(secure_cache_num)) {
+		list_add(&buf->node, &private->secure_cache);
+		private->secure_cache_count++;
+		cached = true;
+	}
+	mutex_unlock(&private->secure_cache_lock);
+
+	if (!cached)
+		kfree(buf);
+
+	return cached;
+}
+
+int rockchip_gem_secure_cache_drain(struct drm_device *drm)
+{
+	struct rockchip_drm_private *private = drm->dev_private;
+	struct rockchip_gem_secure_buf *buf, *tmp;
+	LIST_HEAD(list);
+	int count = 0;
+
+	if (!private->secure_buffer_pool)
+		return 0;
+
+	mutex_lock(&private->secure_cache_lock);
+	list_splice_init(&private->secure_cache, &list);
+	private->secure_cache_count = 0;
+	mutex_unlock(&private->secure_cache_lock);
+
+	list_for_each_entry_safe(buf, tmp, &list, node) {
+		drm_free_large(buf->pages);
+		sg_free_table(buf->sgt);
+		kfree(buf->sgt);
+		gen_pool_free(private->secure_buffer_pool, buf->paddr,
+			      buf->size);
+		kfree(buf);
+		count++;
+	}
+
+	return count;
+}
+
 static int rockchip_gem_alloc_secure(struct rockchip_gem_object *rk_obj)
 {
 	struct drm_gem_object *obj = &rk_obj->base;
@@ -360,7 +708,13 @@ static int rockchip_gem_alloc_secure(struct rockchip_gem_object *rk_obj)
 		return -ENOMEM;
 	}
 
+	if (rockchip_gem_secure_cache_get(private, rk_obj))
+		return 0;
+
 	paddr = gen_pool_alloc(private->secure_buffer_pool, rk_obj->base.size);
+	if (!paddr && rockchip_gem_secure_cache_drain(drm))
+		paddr = gen_pool_alloc(private->secure_buffer_pool,
+				       rk_obj->base.size);
 	if (!paddr) {
 		DRM_ERROR("failed to allocate secure buffer\n");
 		return -ENOMEM;
@@ -396,7 +750,8 @@ static int rockchip_gem_alloc_secure(struct rockchip_gem_object *rk_obj)
 err_free_pages:
 	drm_free_large(rk_obj->pages);
 err_buf_free:
-	gen_pool_free(private->secure_buffer_pool, paddr, rk_obj->base.size);
+	gen_pool_free(private->secure_buffer_pool, rk_obj->dma_handle,
+		      rk_obj->base.size);
 
 	return ret;
 }
@@ -407,6 +762,9 @@ static void rockchip_gem_free_secure(struct rockchip_gem_object *rk_obj)
 	struct drm_device *drm = obj->dev;
 	struct rockchip_drm_private *private = drm->dev_private;
 
+	if (rockchip_gem_secure_cache_put(private, rk_obj))
+		return;
+
 	drm_free_large(rk_obj->pages);
 	sg_free_table(rk_obj->sgt);
 	kfree(rk_obj->sgt);
@@ -446,8 +804,15 @@ static int rockchip_gem_alloc_buf(struct rockchip_gem_object *rk_obj,
 		if (ret)
 			return ret;
 	} else {
-		rk_obj->buf_type = ROCKCHIP_GEM_BUF_TYPE_SHMEM;
-		ret = rockchip_gem_get_pages(rk_obj);
+		/* pool pages can't honour the dma32 zone of the shmem mapping */
+		if ((rk_obj->flags & ROCKCHIP_BO_LARGE_PAGE) && private->domain &&
+		    !(rk_obj->flags & ROCKCHIP_BO_DMA32)) {
+			rk_obj->buf_type = ROCKCHIP_GEM_BUF_TYPE_POOL;
+			ret = rockchip_gem_pool_get_pages(rk_obj);
+		} else {
+			rk_obj->buf_type = ROCKCHIP_GEM_BUF_TYPE_SHMEM;
+			ret = rockchip_gem_get_pages(rk_obj);
+		}
 		if (ret < 0)
 			return ret;
 
@@ -482,6 +847,8 @@ static int rockchip_gem_alloc_buf(struct rockchip_gem_object *rk_obj,
 		rockchip_gem_free_secure(rk_obj);
 	else if (rk_obj->buf_type == ROCKCHIP_GEM_BUF_TYPE_CMA)
 		rockchip_gem_free_dma(rk_obj);
+	else if (rk_obj->buf_type == ROCKCHIP_GEM_BUF_TYPE_POOL)
+		rockchip_gem_pool_put_pages(rk_obj);
 	else
 		rockchip_gem_put_pages(rk_obj);
 	return ret;
@@ -510,6 +877,9 @@ static void rockchip_gem_free_buf(struct rockchip_gem_object *rk_obj)
 	if (rk_obj->buf_type == ROCKCHIP_GEM_BUF_TYPE_SHMEM) {
 		vunmap(rk_obj->kvaddr);
 		rockchip_gem_put_pages(rk_obj);
+	} else if (rk_obj->buf_type == ROCKCHIP_GEM_BUF_TYPE_POOL) {
+		vunmap(rk_obj->kvaddr);
+		rockchip_gem_pool_put_pages(rk_obj);
 	} else if (rk_obj->buf_type == ROCKCHIP_GEM_BUF_TYPE_SECURE) {
 		rockchip_gem_free_secure(rk_obj);
 	} else {
@@ -973,13 +1343,21 @@ int rockchip_gem_get_phys_ioctl(struct drm_device *dev, void *data,
 	return ret;
 }
 
+bool rockchip_gem_is_uncached(struct rockchip_gem_object *rk_obj)
+{
+	if (rk_obj->base.import_attach)
+		return dma_buf_is_uncached(rk_obj->base.import_attach->dmabuf);
+
+	return !(rk_obj->flags & ROCKCHIP_BO_CACHABLE);
+}
+
 int rockchip_gem_prime_begin_cpu_access(struct drm_gem_object *obj,
 					enum dma_data_direction dir)
 {
 	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
 	struct drm_device *drm = obj->dev;
 
-	if (!rk_obj->sgt)
+	if (!rk_obj->sgt || rockchip_gem_is_uncached(rk_obj))
 		return 0;
 
 	dma_sync_sg_for_cpu(drm->dev, rk_obj->sgt->sgl,
@@ -993,10 +1371,92 @@ int rockchip_gem_prime_end_cpu_access(struct drm_gem_object *obj,
 	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
 	struct drm_device *drm = obj->dev;
 
-	if (!rk_obj->sgt)
+	if (!rk_obj->sgt || rockchip_gem_is_uncached(rk_obj))
 		return 0;
 
 	dma_sync_sg_for_device(drm->dev, rk_obj->sgt->sgl,
 			       rk_obj->sgt->nents, dir);
 	return 0;
 }
+
+static int rockchip_gem_sgl_sync_range(struct device *dev,
+				       struct sg_table *sgt,
+				       unsigned int offset,
+				       unsigned int length,
+				       enum dma_data_direction dir,
+				       bool for_cpu)
+{
+	struct scatterlist *sg;
+	unsigned int len = 0;
+	dma_addr_t sg_dma_addr;
+	int i;
+
+	for_each_sgtable_sg(sgt, sg, i) {
+		unsigned int sg_offset, sg_left, size = 0;
+
+		sg_dma_addr = sg_phys(sg);
+
+		len += sg->length;
+		if (len <= offset)
+			continue;
+
+		sg_left = len - offset;
+		sg_offset = sg->length - sg_left;
+
+		size = (length < sg_left) ? length : sg_left;
+		if (for_cpu)
+			dma_sync_single_range_for_cpu(dev, sg_dma_addr,
+						      sg_offset, size, dir);
+		else
+			dma_sync_single_range_for_device(dev, sg_dma_addr,
+							 sg_offset, size, dir);
+
+		offset += size;
+		length -= size;
+
+		if (length == 0)
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * rockchip_gem_prime_begin_cpu_access_partial - only sync [offset, offset + len)
+ * of the buffer for cpu, e.g. when cpu draws a small osd tile of a 4K buffer.
+ */
+int rockchip_gem_prime_begin_cpu_access_partial(struct drm_gem_object *obj,
+						enum dma_data_direction dir,
+						unsigned int offset,
+						unsigned int len)
+{
+	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
+	struct drm_device *drm = obj->dev;
+
+	if (!rk_obj->sgt || rockchip_gem_is_uncached(rk_obj))
+		return 0;
+
+	if (!len || offset >= obj->size || len > obj->size - offset)
+		return -EINVAL;
+
+	return rockchip_gem_sgl_sync_range(drm->dev, rk_obj->sgt, offset, len,
+					   dir, true);
+}
+
+int rockchip_gem_prime_end_cpu_access_partial(struct drm_gem_object *obj,
+					      enum dma_data_direction dir,
+					      unsigned int offset,
+					      unsigned int len)
+{
+	struct rockchip_gem_object *rk_obj = to_rockchip_obj(obj);
+	struct drm_device *drm = obj->dev;
+
+	if (!rk_obj->sgt || rockchip_gem_is_uncached(rk_obj))
+		return 0;
+
+	if (!len || offset >= obj->size || len > obj->size - offset)
+		return -EINVAL;
+
+	return rockchip_gem_sgl_sync_range(drm->dev, rk_obj->sgt, offset, len,
+					   dir, false);
+}
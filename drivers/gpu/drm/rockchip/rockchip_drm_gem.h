@@ -15,6 +15,7 @@ enum rockchip_gem_buf_type {
 	ROCKCHIP_GEM_BUF_TYPE_CMA,
 	ROCKCHIP_GEM_BUF_TYPE_SHMEM,
 	ROCKCHIP_GEM_BUF_TYPE_SECURE,
+	ROCKCHIP_GEM_BUF_TYPE_POOL,
 };
 
 struct rockchip_gem_object {
@@ -34,6 +35,9 @@ struct rockchip_gem_object {
 	struct page **pages;
 	struct sg_table *sgt;
 	size_t size;
+
+	/* Chunks of a ROCKCHIP_GEM_BUF_TYPE_POOL buffer */
+	struct list_head pool_chunks;
 };
 
 struct sg_table *rockchip_gem_prime_get_sg_table(struct drm_gem_object *obj);
@@ -73,13 +77,29 @@ int rockchip_gem_map_offset_ioctl(struct drm_device *dev, void *data,
 int rockchip_gem_get_phys_ioctl(struct drm_device *dev, void *data,
 				struct drm_file *file_priv);
 
+/* object is only mapped write-combined, cache maintenance can be skipped */
+bool rockchip_gem_is_uncached(struct rockchip_gem_object *rk_obj);
+
 int rockchip_gem_prime_begin_cpu_access(struct drm_gem_object *obj,
 					enum dma_data_direction dir);
 
 int rockchip_gem_prime_end_cpu_access(struct drm_gem_object *obj,
 				      enum dma_data_direction dir);
 
+int rockchip_gem_prime_begin_cpu_access_partial(struct drm_gem_object *obj,
+						enum dma_data_direction dir,
+						unsigned int offset,
+						unsigned int len);
+
+int rockchip_gem_prime_end_cpu_access_partial(struct drm_gem_object *obj,
+					      enum dma_data_direction dir,
+					      unsigned int offset,
+					      unsigned int len);
+
 void rockchip_gem_get_ddr_info(void);
+int rockchip_gem_page_pool_init(void);
+int rockchip_gem_secure_cache_drain(struct drm_device *drm);
+void rockchip_gem_page_pool_fini(void);
 
 extern const struct drm_gem_object_funcs rockchip_gem_object_funcs;
 
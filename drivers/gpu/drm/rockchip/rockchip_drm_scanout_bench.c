@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd.
+ *
+ * Scanout bandwidth benchmark on top of direct show and the test pattern
+ * engine: run a matrix of window count / format / scaling ratio on a crtc,
+ * pin the dmc at each of its opps and count the underflows, so the display
+ * bandwidth limit of a board can be checked from the kernel log.
+ */
+
+#include <linux/delay.h>
+#include <linux/devfreq.h>
+#include <linux/of.h>
+#include <linux/pm_qos.h>
+#include <linux/slab.h>
+
+#include <soc/rockchip/rockchip_dmc.h>
+
+#include "rockchip_drm_drv.h"
+#include "rockchip_drm_direct_show.h"
+#include "rockchip_drm_display_pattern.h"
+#include "rockchip_drm_scanout_bench.h"
+
+#define BENCH_MAX_WINDOWS	8
+#define BENCH_MAX_OPPS		16
+#define BENCH_MAX_SRC_SIZE	4096
+#define BENCH_SETTLE_MS		200
+
+static unsigned int bench_windows = 4;
+module_param(bench_windows, uint, 0444);
+MODULE_PARM_DESC(bench_windows, "max number of windows the scanout benchmark stacks");
+
+static unsigned int bench_duration_ms = 1000;
+module_param(bench_duration_ms, uint, 0444);
+MODULE_PARM_DESC(bench_duration_ms, "time each benchmark case is watched for underflow at each dmc opp");
+
+static const u32 bench_formats[] = {
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_RGB565,
+	DRM_FORMAT_NV12,
+};
+
+/* src size = dst size * num / den */
+static const struct {
+	u32 num;
+	u32 den;
+} bench_scales[] = {
+	{ 1, 1 },
+	{ 2, 1 },	/* 2x down scale, twice the fetch */
+	{ 1, 2 },	/* 2x up scale */
+};
+
+struct rockchip_scanout_bench {
+	struct drm_device *drm;
+	struct drm_crtc *crtc;
+	const struct rockchip_crtc_funcs *funcs;
+
+	struct devfreq *dmc;
+	struct dev_pm_qos_request min_req;
+	struct dev_pm_qos_request max_req;
+	s32 pinned_khz;
+	unsigned long opps[BENCH_MAX_OPPS];
+	int nr_opps;
+	/* highest pixel rate without underflow, in Mpix/s, at each opp */
+	unsigned long best_rate[BENCH_MAX_OPPS];
+
+	struct drm_plane *planes[BENCH_MAX_WINDOWS];
+	struct rockchip_drm_direct_show_buffer buffers[BENCH_MAX_WINDOWS];
+	int nr_planes;
+};
+
+static bool rockchip_scanout_bench_plane_has_format(struct drm_plane *plane, u32 format)
+{
+	int i;
+
+	for (i = 0; i < plane->format_count; i++)
+		if (plane->format_types[i] == format)
+			return true;
+
+	return false;
+}
+
+static int rockchip_scanout_bench_get_planes(struct rockchip_scanout_bench *bench, u32 format)
+{
+	struct drm_plane *plane;
+	int n = 0;
+
+	drm_for_each_plane(plane, bench->drm) {
+		if (n >= bench_windows || n >= BENCH_MAX_WINDOWS)
+			break;
+		if (plane->type == DRM_PLANE_TYPE_CURSOR)
+			continue;
+		if (!(plane->possible_crtcs & drm_crtc_mask(bench->crtc)))
+			continue;
+		/* don't steal a plane that is scanning out on another crtc */
+		if (plane->state && plane->state->crtc && plane->state->crtc != bench->crtc)
+			continue;
+		if (!rockchip_scanout_bench_plane_has_format(plane, format))
+			continue;
+		bench->planes[n++] = plane;
+	}
+
+	return n;
+}
+
+static void rockchip_scanout_bench_dmc_init(struct rockchip_scanout_bench *bench)
+{
+	struct device_node *np;
+	int i;
+
+	np = of_find_node_by_name(NULL, "dmc");
+	if (!np)
+		return;
+	bench->dmc = devfreq_get_devfreq_by_node(np);
+	of_node_put(np);
+	if (IS_ERR_OR_NULL(bench->dmc) || !bench->dmc->freq_table) {
+		bench->dmc = NULL;
+		return;
+	}
+
+	bench->nr_opps = min_t(int, bench->dmc->max_state, BENCH_MAX_OPPS);
+	for (i = 0; i < bench->nr_opps; i++)
+		bench->opps[i] = bench->dmc->freq_table[i];
+
+	if (dev_pm_qos_add_request(bench->dmc->dev.parent, &bench->min_req,
+				   DEV_PM_QOS_MIN_FREQUENCY, 0) < 0 ||
+	    dev_pm_qos_add_request(bench->dmc->dev.parent, &bench->max_req,
+				   DEV_PM_QOS_MAX_FREQUENCY,
+				   PM_QOS_MAX_FREQUENCY_DEFAULT_VALUE) < 0) {
+		if (dev_pm_qos_request_active(&bench->min_req))
+			dev_pm_qos_remove_request(&bench->min_req);
+		bench->dmc = NULL;
+		bench->nr_opps = 0;
+	}
+}
+
+static void rockchip_scanout_bench_dmc_fini(struct rockchip_scanout_bench *bench)
+{
+	if (!bench->dmc)
+		return;
+
+	dev_pm_qos_remove_request(&bench->max_req);
+	dev_pm_qos_remove_request(&bench->min_req);
+}
+
+static void rockchip_scanout_bench_dmc_pin(struct rockchip_scanout_bench *bench, unsigned long rate)
+{
+	s32 khz = DIV_ROUND_UP(rate, 1000);
+
+	/* move the bound on the far side first, so min never exceeds max */
+	if (khz > bench->pinned_khz) {
+		dev_pm_qos_update_request(&bench->max_req, khz);
+		dev_pm_qos_update_request(&bench->min_req, khz);
+	} else {
+		dev_pm_qos_update_request(&bench->min_req, khz);
+		dev_pm_qos_update_request(&bench->max_req, khz);
+	}
+	bench->pinned_khz = khz;
+}
+
+static u32 rockchip_scanout_bench_underflow(struct rockchip_scanout_bench *bench)
+{
+	if (!bench->funcs || !bench->funcs->get_underflow_count)
+		return 0;
+
+	return bench->funcs->get_underflow_count(bench->crtc);
+}
+
+static void rockchip_scanout_bench_disable(struct rockchip_scanout_bench *bench, int nr_windows)
+{
+	int i;
+
+	for (i = 0; i < nr_windows; i++)
+		rockchip_drm_direct_show_disable_plane(bench->drm, bench->planes[i]);
+}
+
+static void rockchip_scanout_bench_run_case(struct rockchip_scanout_bench *bench, u32 format,
+					    int scale, int nr_windows)
+{
+	struct drm_display_mode *mode = &bench->crtc->state->adjusted_mode;
+	struct rockchip_drm_direct_show_commit_info commit_info = { 0 };
+	struct dmcfreq_vop_info bw_info = { 0 };
+	u32 num = bench_scales[scale].num, den = bench_scales[scale].den;
+	u32 dst_w = mode->hdisplay, dst_h = mode->vdisplay;
+	u32 src_w, src_h, uf_start, uf[BENCH_MAX_OPPS] = { 0 };
+	unsigned long pixel_rate;
+	int i, ret = 0, nr_bufs = 0;
+	char result[BENCH_MAX_OPPS * 20] = "";
+	int len = 0;
+
+	/* keep the ratio, shrink the dst when the src would exceed the plane */
+	if (dst_w * num / den > BENCH_MAX_SRC_SIZE)
+		dst_w = BENCH_MAX_SRC_SIZE * den / num;
+	if (dst_h * num / den > BENCH_MAX_SRC_SIZE)
+		dst_h = BENCH_MAX_SRC_SIZE * den / num;
+	src_w = ALIGN_DOWN(dst_w * num / den, 2);
+	src_h = ALIGN_DOWN(dst_h * num / den, 2);
+
+	for (i = 0; i < nr_windows; i++) {
+		struct rockchip_drm_direct_show_buffer *buffer = &bench->buffers[i];
+
+		memset(buffer, 0, sizeof(*buffer));
+		buffer->width = src_w;
+		buffer->height = src_h;
+		buffer->pixel_format = format;
+		ret = rockchip_drm_direct_show_alloc_buffer(bench->drm, buffer);
+		if (ret)
+			goto out;
+		nr_bufs++;
+		rockchip_drm_fill_color_bar(format, buffer->vir_addr, buffer->width,
+					    buffer->height, buffer->pitch[0]);
+	}
+
+	/* all windows full screen on top of each other: worst case fetch */
+	commit_info.crtc = bench->crtc;
+	commit_info.src_w = src_w;
+	commit_info.src_h = src_h;
+	commit_info.dst_w = dst_w;
+	commit_info.dst_h = dst_h;
+	for (i = 0; i < nr_windows; i++) {
+		commit_info.plane = bench->planes[i];
+		commit_info.buffer = &bench->buffers[i];
+		ret = rockchip_drm_direct_show_commit(bench->drm, &commit_info);
+		if (ret)
+			goto out;
+	}
+
+	if (bench->funcs && bench->funcs->bandwidth) {
+		drm_modeset_lock_all(bench->drm);
+		bench->funcs->bandwidth(bench->crtc, bench->crtc->state, &bw_info);
+		drm_modeset_unlock_all(bench->drm);
+	}
+
+	pixel_rate = (unsigned long)src_w * src_h * drm_mode_vrefresh(mode) * nr_windows / 1000000;
+
+	if (!bench->nr_opps) {
+		msleep(BENCH_SETTLE_MS);
+		uf_start = rockchip_scanout_bench_underflow(bench);
+		msleep(bench_duration_ms);
+		uf[0] = rockchip_scanout_bench_underflow(bench) - uf_start;
+		len += scnprintf(result + len, sizeof(result) - len, " %u", uf[0]);
+	}
+
+	for (i = 0; i < bench->nr_opps; i++) {
+		rockchip_scanout_bench_dmc_pin(bench, bench->opps[i]);
+		msleep(BENCH_SETTLE_MS);
+		uf_start = rockchip_scanout_bench_underflow(bench);
+		msleep(bench_duration_ms);
+		uf[i] = rockchip_scanout_bench_underflow(bench) - uf_start;
+		if (!uf[i] && pixel_rate > bench->best_rate[i])
+			bench->best_rate[i] = pixel_rate;
+		len += scnprintf(result + len, sizeof(result) - len, " %luMHz:%u",
+				 bench->opps[i] / 1000000, uf[i]);
+	}
+
+	DRM_INFO("bench %p4cc %u:%u x%d %ux%u->%ux%u: %lu Mpix/s line bw %u MB frame bw %u MB, underflow%s\n",
+		 &format, num, den, nr_windows, src_w, src_h, dst_w, dst_h,
+		 pixel_rate, bw_info.line_bw_mbyte, bw_info.frame_bw_mbyte, result);
+
+out:
+	if (ret)
+		DRM_INFO("bench %p4cc %u:%u x%d %ux%u->%ux%u: unsupported, ret %d\n",
+			 &format, num, den, nr_windows, src_w, src_h, dst_w, dst_h, ret);
+	rockchip_scanout_bench_disable(bench, nr_windows);
+	for (i = 0; i < nr_bufs; i++)
+		rockchip_drm_direct_show_free_buffer(bench->drm, &bench->buffers[i]);
+}
+
+/*
+ * Run the benchmark matrix on @crtc, which must already be enabled with the
+ * mode to check. Only linear buffers are used, direct show does not
+ * allocate afbc framebuffers.
+ */
+int rockchip_drm_scanout_bench_run(struct drm_device *drm, struct drm_crtc *crtc)
+{
+	struct rockchip_drm_private *priv = drm->dev_private;
+	struct rockchip_scanout_bench *bench;
+	int f, s, n, i;
+
+	if (!crtc || !crtc->state || !crtc->state->active) {
+		DRM_ERROR("scanout bench needs an active crtc\n");
+		return -EINVAL;
+	}
+
+	bench = kzalloc(sizeof(*bench), GFP_KERNEL);
+	if (!bench)
+		return -ENOMEM;
+
+	bench->drm = drm;
+	bench->crtc = crtc;
+	bench->funcs = priv->crtc_funcs[drm_crtc_index(crtc)];
+	if (!bench->funcs || !bench->funcs->get_underflow_count)
+		DRM_WARN("%s can't report underflow, only bandwidth is reported\n", crtc->name);
+
+	rockchip_scanout_bench_dmc_init(bench);
+
+	DRM_INFO("scanout bench on %s %dx%d@%d, %d dmc opps\n", crtc->name,
+		 crtc->state->adjusted_mode.hdisplay, crtc->state->adjusted_mode.vdisplay,
+		 drm_mode_vrefresh(&crtc->state->adjusted_mode), bench->nr_opps);
+
+	for (f = 0; f < ARRAY_SIZE(bench_formats); f++) {
+		bench->nr_planes = rockchip_scanout_bench_get_planes(bench, bench_formats[f]);
+		for (s = 0; s < ARRAY_SIZE(bench_scales); s++)
+			for (n = 1; n <= bench->nr_planes; n++)
+				rockchip_scanout_bench_run_case(bench, bench_formats[f], s, n);
+	}
+
+	for (i = 0; i < bench->nr_opps; i++)
+		DRM_INFO("bench dmc %lu MHz: max sustainable pixel rate %lu Mpix/s\n",
+			 bench->opps[i] / 1000000, bench->best_rate[i]);
+
+	rockchip_scanout_bench_dmc_fini(bench);
+	kfree(bench);
+
+	return 0;
+}
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: (GPL-2.0+ OR MIT) */
+/*
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef __ROCKCHIP_DRM_SCANOUT_BENCH_H__
+#define __ROCKCHIP_DRM_SCANOUT_BENCH_H__
+
+#include <drm/drm_crtc.h>
+#include <drm/drm_device.h>
+
+int rockchip_drm_scanout_bench_run(struct drm_device *drm, struct drm_crtc *crtc);
+
+#endif
@@ -15,6 +15,7 @@
 #include "rockchip_drm_drv.h"
 #include "rockchip_drm_direct_show.h"
 #include "rockchip_drm_display_pattern.h"
+#include "rockchip_drm_scanout_bench.h"
 
 #include "kernel_logo_img.h"
 
@@ -36,6 +37,10 @@ struct rockchip_drm_self_test {
 
 static struct rockchip_drm_self_test rockchip_drm_st;
 
+static bool bench;
+module_param(bench, bool, 0444);
+MODULE_PARM_DESC(bench, "run the scanout bandwidth benchmark instead of the test pattern");
+
 static void __maybe_unused
 rockchip_drm_draw_white(struct rockchip_drm_direct_show_buffer *buffer)
 {
@@ -117,7 +122,7 @@ static void rockchip_drm_self_test_commit(struct work_struct *work)
 {
 	struct rockchip_drm_self_test *self_test =
 			container_of(work, struct rockchip_drm_self_test, commit_work);
-	struct rockchip_drm_direct_show_commit_info commit_info;
+	struct rockchip_drm_direct_show_commit_info commit_info = { 0 };
 	int ret = 0;
 
 	if (!self_test->dev)
@@ -132,6 +137,19 @@ static void rockchip_drm_self_test_commit(struct work_struct *work)
 		return;
 	}
 
+	if (bench) {
+		self_test->crtc = rockchip_drm_direct_show_get_crtc(self_test->dev, NULL);
+		if (!self_test->crtc) {
+			/* wait for the connector to come up */
+			msleep(100);
+			queue_work(self_test->workqueue, &self_test->commit_work);
+			return;
+		}
+		rockchip_drm_scanout_bench_run(self_test->dev, self_test->crtc);
+
+		return;
+	}
+
 	/* alloc buffer */
 	if (!self_test->drm_buffer[0]) {
 		ret = rockchip_drm_self_test_alloc_buffer(self_test);
@@ -9,6 +9,7 @@
 #include <drm/drm_blend.h>
 #include <drm/drm_crtc.h>
 #include <drm/drm_crtc_helper.h>
+#include <drm/drm_damage_helper.h>
 #include <drm/drm_debugfs.h>
 #include <drm/drm_flip_work.h>
 #include <drm/drm_fourcc.h>
@@ -26,6 +27,7 @@
 #include <linux/fixp-arith.h>
 #include <linux/iopoll.h>
 #include <linux/kernel.h>
+#include <linux/llist.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/clk.h>
@@ -41,16 +43,21 @@
 #include <linux/reset.h>
 #include <linux/mfd/syscon.h>
 #include <linux/delay.h>
+#include <linux/dma-fence.h>
+#include <linux/file.h>
 #include <linux/swab.h>
 #include <linux/sort.h>
+#include <linux/sync_file.h>
 #include <linux/rockchip/cpu.h>
 #include <linux/workqueue.h>
 #include <linux/types.h>
+#include <soc/rockchip/pm_domains.h>
 #include <soc/rockchip/rockchip_csu.h>
 #include <soc/rockchip/rockchip_dmc.h>
 #include <soc/rockchip/rockchip_opp_select.h>
 #include <soc/rockchip/rockchip_system_monitor.h>
 #include <soc/rockchip/rockchip-system-status.h>
+#include <soc/rockchip/rockchip_media_trace.h>
 #include <uapi/linux/videodev2.h>
 
 #include <../drivers/devfreq/governor.h>
@@ -162,6 +169,30 @@
  * another one will run in next frame.
  */
 #define VOP2_WB_JOB_MAX      2
+
+/* lines the late latch vtotal is kept ahead of the current scan line */
+#define VOP2_VRR_LATE_LATCH_MARGIN	4
+
+/*
+ * noc priority the vop masters get after an underflow, the hold time
+ * doubles when the underflow comes back right after the priority is
+ * dropped again.
+ */
+#define VOP2_QOS_BOOST_PRIORITY		0x303
+#define VOP2_QOS_HOLD_MIN_MS		500
+#define VOP2_QOS_HOLD_MAX_MS		8000
+
+/* post processing blocks to be reprogrammed in this flush */
+#define VOP2_POST_CSC_DIRTY		BIT(0)
+#define VOP2_POST_ACM_DIRTY		BIT(1)
+#define VOP2_POST_SHARP_DIRTY		BIT(2)
+
+/*
+ * a vp joining a running genlock group sleeps until these many lines
+ * before the frame end of the group, and spins from there.
+ */
+#define VOP2_GENLOCK_SPIN_LINES		4
+#define VOP2_GENLOCK_SPIN_TIMEOUT_US	(50 * 1000)
 #define VOP2_SYS_AXI_BUS_NUM 2
 
 #define VOP2_MAX_VP_OUTPUT_WIDTH	4096
@@ -385,6 +416,7 @@ struct vop2_plane_state {
 	struct vop_dump_list *planlist;
 
 	struct drm_property_blob *dci_data;
+	struct llist_node reclaim_node;
 };
 
 struct vop2_win {
@@ -506,6 +538,13 @@ struct vop2_win {
 	 * @dci_lut_gem_obj: gem obj to store dci lut
 	 */
 	struct rockchip_gem_object *dci_lut_gem_obj;
+	/**
+	 * @fbc_commits: commits scanned out from afbc/rfbc buffers,
+	 * @tiled_commits and @linear_commits likewise, see fbc_status.
+	 */
+	u32 fbc_commits;
+	u32 tiled_commits;
+	u32 linear_commits;
 };
 
 struct vop2_cluster {
@@ -535,6 +574,72 @@ struct vop2_wb_job {
 	uint32_t fs_vsync_cnt;
 };
 
+enum vop2_wb_format {
+	VOP2_WB_ARGB8888,
+	VOP2_WB_BGR888,
+	VOP2_WB_RGB565,
+	VOP2_WB_YUV420SP = 4,
+	VOP2_WB_INVALID = -1,
+};
+
+enum vop2_wb_slot_state {
+	VOP2_WB_SLOT_IDLE,
+	VOP2_WB_SLOT_QUEUED,
+	VOP2_WB_SLOT_PENDING,
+	VOP2_WB_SLOT_ACTIVE,
+	VOP2_WB_SLOT_DONE,
+};
+
+struct vop2_wb_slot {
+	struct drm_framebuffer *fb;
+	dma_addr_t yrgb_addr;
+	dma_addr_t uv_addr;
+	/**
+	 * @fence: signaled at the frame start after the slot has been
+	 * written, created when the slot address is programmed.
+	 */
+	struct dma_fence *fence;
+	enum vop2_wb_slot_state state;
+	/**
+	 * @acquired: handed out to userspace, must not be written again
+	 * until it is released.
+	 */
+	bool acquired;
+	uint32_t frame;
+};
+
+/*
+ * Continuous write back into a ring of userspace framebuffers, the slot
+ * address is switched at every frame start of the source vp in isr, so
+ * no atomic commit is needed per captured frame.
+ */
+struct vop2_wb_stream {
+	bool enabled;
+	bool hw_enabled;
+	struct drm_file *file;
+	uint8_t vp_id;
+	uint8_t count;
+	struct vop2_wb_slot slots[ROCKCHIP_WB_STREAM_MAX_BUFS];
+	enum vop2_wb_format format;
+	uint16_t scale_x_factor;
+	uint8_t scale_x_en;
+	uint8_t scale_y_en;
+	uint8_t r2y;
+	uint32_t fifo_throd;
+	uint32_t act_width;
+	uint32_t vir_stride;
+	u64 fence_context;
+	uint32_t seqno;
+	uint32_t frame;
+	uint32_t dropped;
+	wait_queue_head_t wait;
+	/**
+	 * @lock: serialize stream start and stop, the slots are protected
+	 * by wb->job_lock.
+	 */
+	struct mutex lock;
+};
+
 struct vop2_wb {
 	uint8_t vp_id;
 	struct drm_writeback_connector conn;
@@ -549,6 +654,7 @@ struct vop2_wb {
 	 */
 	spinlock_t job_lock;
 
+	struct vop2_wb_stream stream;
 };
 
 struct vop2_dsc {
@@ -562,14 +668,6 @@ struct vop2_dsc {
 	struct vop2_power_domain *pd;
 };
 
-enum vop2_wb_format {
-	VOP2_WB_ARGB8888,
-	VOP2_WB_BGR888,
-	VOP2_WB_RGB565,
-	VOP2_WB_YUV420SP = 4,
-	VOP2_WB_INVALID = -1,
-};
-
 struct vop2_wb_connector_state {
 	struct drm_connector_state base;
 	dma_addr_t yrgb_addr;
@@ -581,6 +679,13 @@ struct vop2_wb_connector_state {
 	uint8_t vp_id;
 };
 
+struct vop2_post_csc_cache {
+	struct post_csc_convert_mode convert_mode;
+	bool r2y_en;
+	bool csc_en;
+	int csc_mode;
+};
+
 struct vop2_video_port {
 	struct rockchip_crtc rockchip_crtc;
 	struct rockchip_mcu_timing mcu_timing;
@@ -590,9 +695,24 @@ struct vop2_video_port {
 	struct clk *dclk_parent;
 	uint8_t id;
 	bool layer_sel_update;
+	/**
+	 * @addr_only_flip: only the fb address of the planes changed in
+	 * current commit, set at atomic_begin and used by plane update.
+	 */
+	bool addr_only_flip;
+	/**
+	 * @hold_frame_dirty: a commit is waiting to be sent to the panel in
+	 * hold mode, the te handler only starts a new frame when it's set.
+	 */
+	bool hold_frame_dirty;
 	bool xmirror_en;
 	bool need_reset_p2i_flag;
 	atomic_t post_buf_empty_flag;
+	/**
+	 * @post_buf_empty_count: number of POST_BUF_EMPTY (underflow) irqs
+	 * seen since probe, read by the scanout benchmark.
+	 */
+	atomic_t post_buf_empty_count;
 	const struct vop2_video_port_regs *regs;
 
 	struct completion dsp_hold_completion;
@@ -604,6 +724,22 @@ struct vop2_video_port {
 	struct drm_flip_work fb_unref_work;
 	unsigned long pending;
 
+	/**
+	 * @reclaim_work: free the old plane and crtc states of finished
+	 * commits out of the commit tail
+	 */
+	struct work_struct reclaim_work;
+	struct llist_head plane_reclaim_list;
+	struct llist_head crtc_reclaim_list;
+
+	/**
+	 * @zpos_pool: overlay zpos sort buffers preallocated at crtc init,
+	 * so the commit path does no allocations
+	 */
+	struct vop2_zpos *zpos_pool;
+	struct vop2_zpos *zpos_splice_pool;
+	struct vop2_zpos *zpos_splice_hdr_pool;
+
 	struct pixel_shift_data pixel_shift;
 
 	/**
@@ -725,9 +861,15 @@ struct vop2_video_port {
 	u32 cubic_lut_len;
 
 	/**
-	 * @cubic_lut_gem_obj: gem obj to store cubic lut
+	 * @cubic_lut_gem_obj: gem obj to store cubic lut, it holds two
+	 * copies of the lut: one is loaded by the lut dma at the next frame
+	 * start while the other one is written by cpu for a new commit.
 	 */
 	struct rockchip_gem_object *cubic_lut_gem_obj;
+	/**
+	 * @cubic_lut_buf_idx: copy of @cubic_lut_gem_obj used by last commit
+	 */
+	u8 cubic_lut_buf_idx;
 
 	/**
 	 * @hdr_lut_gem_obj: gem obj to store hdr lut
@@ -779,6 +921,18 @@ struct vop2_video_port {
 	 */
 	struct drm_property *min_refresh_rate_prop;
 
+	/**
+	 * @vrr_late_latch_prop: stretch the front porch until the next flip
+	 * instead of running at a fixed request refresh rate
+	 */
+	struct drm_property *vrr_late_latch_prop;
+
+	/**
+	 * @genlock_prop: start the scanout of this video port aligned with
+	 * the other genlocked video ports and latch their commits together
+	 */
+	struct drm_property *genlock_prop;
+
 	/**
 	 * @hdr_ext_data_prop: hdr extend data interaction with userspace
 	 */
@@ -821,10 +975,61 @@ struct vop2_video_port {
 	 */
 	bool refresh_rate_change;
 
+	/**
+	 * @vrr_late_latch: the front porch is stretched to @vrr_max_vtotal at
+	 * every frame start and cut back to the current line when a commit is
+	 * flushed, so the new frame starts right after the flip.
+	 */
+	bool vrr_late_latch;
+	/**
+	 * @genlock: the video port was started as a member of the genlock
+	 * group of its vop.
+	 */
+	bool genlock;
+	/**
+	 * @genlock_start_pending: the timing is configured but the video
+	 * port is held in standby until the genlock group releases it.
+	 */
+	bool genlock_start_pending;
+	/**
+	 * @vrr_min_vtotal: vtotal at max refresh rate
+	 */
+	u32 vrr_min_vtotal;
+	/**
+	 * @vrr_max_vtotal: vtotal at min refresh rate
+	 */
+	u32 vrr_max_vtotal;
+	/**
+	 * @vrr_line_ns: time of one line in ns
+	 */
+	u32 vrr_line_ns;
+	/**
+	 * @vrr_frame_start: timestamp of the last frame start interrupt
+	 */
+	ktime_t vrr_frame_start;
+
 	/**
 	 * @acm_state_changed: indicate whether acm state change
 	 */
 	bool acm_state_changed;
+	/**
+	 * @post_dirty: VOP2_POST_*_DIRTY mask of the post processing blocks
+	 * whose input changed in this commit.
+	 */
+	u32 post_dirty;
+	/**
+	 * @post_csc_cache: what the post csc block was last programmed with
+	 */
+	struct vop2_post_csc_cache post_csc_cache;
+	/**
+	 * @acm_update_pending: rk3528 acm is disabled for a parameter update,
+	 * the new parameters are loaded by the next commit.
+	 */
+	bool acm_update_pending;
+	/**
+	 * @acm_update_work: make the next commit when no flip follows
+	 */
+	struct work_struct acm_update_work;
 
 	/**
 	 * @has_extra_layer: like rk3576, the vp1 layer can merge into vp0 layer after overlay
@@ -957,6 +1162,20 @@ struct vop2 {
 	struct work_struct post_buf_empty_work;
 	struct workqueue_struct *workqueue;
 
+	/*
+	 * Underflow driven noc qos controller: raise the priority of the
+	 * vop masters on POST_BUF_EMPTY and drop it after qos_hold_ms
+	 * without another one.
+	 */
+	u32 qos_boost_priority;
+	unsigned int qos_hold_ms;
+	unsigned long qos_relax_time;
+	bool qos_boosted;
+	/* protects the qos controller state */
+	struct mutex qos_lock;
+	struct work_struct qos_boost_work;
+	struct delayed_work qos_relax_work;
+
 	struct vop2_layer layers[ROCKCHIP_MAX_LAYER];
 
 #ifdef CONFIG_PM_DEVFREQ
@@ -1017,6 +1236,9 @@ static const struct drm_bus_format_enum_list drm_bus_format_enum_list[] = {
 
 static DRM_ENUM_NAME_FN(drm_get_bus_format_name, drm_bus_format_enum_list)
 static int vop2_devfreq_set_aclk(struct drm_crtc *crtc, enum rockchip_drm_vop_aclk_mode aclk_mode);
+static int vop2_wb_stream_stop(struct vop2_video_port *vp, struct drm_file *file);
+static int vop2_crtc_wb_stream(struct drm_crtc *crtc, struct drm_file *file,
+			       struct drm_rockchip_wb_stream *args);
 
 static inline struct vop2_video_port *to_vop2_video_port(struct drm_crtc *crtc)
 {
@@ -2447,17 +2669,40 @@ static bool rockchip_vop2_mod_supported(struct drm_plane *plane, u32 format, u64
 	if (modifier == DRM_FORMAT_MOD_LINEAR)
 		return true;
 
-	if (!rockchip_afbc(plane, modifier) &&
-	    !rockchip_rfbc(plane, modifier) &&
-	    !rockchip_tiled(plane, modifier)) {
-		DRM_ERROR("%s unsupported format modifier 0x%llx\n", plane->name, modifier);
+	/*
+	 * Report exactly what the window can scan out for each modifier,
+	 * so userspace doesn't allocate a compressed buffer which is
+	 * rejected later and fall back to linear.
+	 */
+	if (rockchip_afbc(plane, modifier)) {
+		const struct drm_format_info *info = drm_format_info(format);
 
-		return false;
+		if (vop2_convert_afbc_format(format) < 0)
+			return false;
+
+		/* YTR is a rgb to yuv transform, no use for yuv formats */
+		if ((modifier & AFBC_FORMAT_MOD_YTR) && info->is_yuv)
+			return false;
+
+		return true;
+	}
+
+	if (rockchip_rfbc(plane, modifier))
+		return vop2_convert_afbc_format(format) >= 0;
+
+	if (rockchip_tiled(plane, modifier)) {
+		struct vop2_win *win = to_vop2_win(plane);
+
+		if (is_vop3(win->vop2))
+			return vop3_convert_tiled_format(format,
+							 modifier & ROCKCHIP_TILED_BLOCK_SIZE_MASK) >= 0;
+
+		return vop2_convert_tiled_format(format) >= 0;
 	}
 
-	return vop2_convert_afbc_format(format) >= 0 ||
-	       vop2_convert_tiled_format(format) >= 0 ||
-	       vop3_convert_tiled_format(format, 0) >= 0;
+	DRM_ERROR("%s unsupported format modifier 0x%llx\n", plane->name, modifier);
+
+	return false;
 }
 
 static inline bool vop2_multi_area_sub_window(struct vop2_win *win)
@@ -3497,6 +3742,11 @@ static int vop2_wb_encoder_atomic_check(struct drm_encoder *encoder,
 	if (!conn_state->writeback_job || !conn_state->writeback_job->fb)
 		return 0;
 
+	if (READ_ONCE(vp->vop2->wb.stream.enabled)) {
+		DRM_DEBUG_KMS("writeback is busy with stream capture\n");
+		return -EBUSY;
+	}
+
 	fb = conn_state->writeback_job->fb;
 	DRM_DEV_DEBUG(vp->vop2->dev, "%d x % d\n", fb->width, fb->height);
 
@@ -3570,6 +3820,7 @@ static int vop2_wb_connector_init(struct vop2 *vop2, int nr_crtcs)
 	vop2->wb.regs = vop2_data->wb->regs;
 	vop2->wb.conn.encoder.possible_crtcs = (1 << nr_crtcs) - 1;
 	spin_lock_init(&vop2->wb.job_lock);
+	init_waitqueue_head(&vop2->wb.stream.wait);
 	drm_connector_helper_add(&vop2->wb.conn.base, &vop2_wb_connector_helper_funcs);
 
 	ret = drm_writeback_connector_init(vop2->drm_dev, &vop2->wb.conn,
@@ -3893,16 +4144,26 @@ static int vop2_crtc_atomic_cubic_lut_set(struct drm_crtc *crtc,
 	}
 
 	if (!private->cubic_lut[vp->id].enable) {
-		if (!vp->cubic_lut_gem_obj) {
-			size_t size = (vp->cubic_lut_len + 1) / 2 * 16;
+		size_t size = (vp->cubic_lut_len + 1) / 2 * 16;
 
-			vp->cubic_lut_gem_obj = rockchip_gem_create_object(crtc->dev, size, true, 0);
-			if (IS_ERR(vp->cubic_lut_gem_obj))
+		if (!vp->cubic_lut_gem_obj) {
+			vp->cubic_lut_gem_obj = rockchip_gem_create_object(crtc->dev, size * 2,
+									   true, 0);
+			if (IS_ERR(vp->cubic_lut_gem_obj)) {
+				vp->cubic_lut_gem_obj = NULL;
 				return -ENOMEM;
+			}
 		}
 
-		cubic_lut_kvaddr = (u32 *)vp->cubic_lut_gem_obj->kvaddr;
-		cubic_lut_mst = vp->cubic_lut_gem_obj->dma_addr;
+		/*
+		 * Don't touch the copy the lut dma may still load at the next
+		 * frame start, the new lut takes effect at vblank together
+		 * with the rest of this commit.
+		 */
+		vp->cubic_lut_buf_idx ^= 1;
+		cubic_lut_kvaddr = (u32 *)(vp->cubic_lut_gem_obj->kvaddr +
+					   size * vp->cubic_lut_buf_idx);
+		cubic_lut_mst = vp->cubic_lut_gem_obj->dma_addr + size * vp->cubic_lut_buf_idx;
 	} else {
 		cubic_lut_kvaddr = private->cubic_lut[vp->id].offset + private->cubic_lut_kvaddr;
 		cubic_lut_mst = private->cubic_lut[vp->id].offset + private->cubic_lut_dma_addr;
@@ -4851,6 +5112,11 @@ static void vop2_crtc_atomic_disable(struct drm_crtc *crtc,
 		goto out;
 	}
 
+	vop2_wb_stream_stop(vp, NULL);
+	WRITE_ONCE(vp->vrr_late_latch, false);
+	vp->genlock = false;
+	vp->genlock_start_pending = false;
+
 	/*
 	 * Usperspace not commit new frame for long time will triggle driver enter
 	 * psr mode, If userspace directly close display at next time and without
@@ -6171,6 +6437,34 @@ static void vop2_win_atomic_update(struct vop2_win *win, struct drm_rect *src, s
 	spin_unlock(&vop2->reg_lock);
 }
 
+/*
+ * Fast path for a flip on an already configured window, only the
+ * buffer address registers are written.
+ */
+static void vop2_win_atomic_update_addr(struct vop2_win *win, struct drm_plane_state *pstate)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(pstate->crtc);
+	struct vop2_plane_state *vpstate = to_vop2_plane_state(pstate);
+	struct drm_framebuffer *fb = pstate->fb;
+	struct vop2 *vop2 = win->vop2;
+
+	spin_lock(&vop2->reg_lock);
+	rockchip_drm_dbg(vop2->dev, VOP_DEBUG_PLANE,
+			 "vp%d flip %s addr[%pad] fb_size[0x%zx] by %s\n",
+			 vp->id, win->name, &vpstate->yrgb_mst, vpstate->fb_size,
+			 current->comm);
+
+	if (vpstate->afbc_en) {
+		VOP_AFBC_SET(vop2, win, hdr_ptr, vpstate->yrgb_mst);
+		VOP_AFBC_SET(vop2, win, pld_ptr_offset, vpstate->yrgb_mst);
+		VOP_AFBC_SET(vop2, win, pld_ptr_range, vpstate->fb_size);
+	}
+	VOP_WIN_SET(vop2, win, yrgb_mst, vpstate->yrgb_mst);
+	if (fb->format->is_yuv)
+		VOP_WIN_SET(vop2, win, uv_mst, vpstate->uv_mst);
+	spin_unlock(&vop2->reg_lock);
+}
+
 static void vop2_plane_atomic_update(struct drm_plane *plane, struct drm_atomic_state *state)
 {
 	struct drm_plane_state *pstate = plane->state;
@@ -6238,6 +6532,27 @@ static void vop2_plane_atomic_update(struct drm_plane *plane, struct drm_atomic_
 			vp->skip_vsync = false;
 	}
 
+	if (vpstate->afbc_en)
+		win->fbc_commits++;
+	else if (vpstate->tiled_en)
+		win->tiled_commits++;
+	else
+		win->linear_commits++;
+
+	/* the buffer is latched for scanout at the next vsync */
+	if (rk_media_trace_enabled() && fb->obj[0]) {
+		struct drm_gem_object *gem = fb->obj[0];
+		struct dma_buf *dmabuf = gem->import_attach ?
+					 gem->import_attach->dmabuf : gem->dma_buf;
+
+		rk_media_buf_trace(vop2->dev, dmabuf, RK_MEDIA_QUEUE);
+	}
+
+	if (vp->addr_only_flip) {
+		vop2_win_atomic_update_addr(win, pstate);
+		return;
+	}
+
 	if (vcstate->splice_mode) {
 		rockchip_drm_dbg(vop2->dev, VOP_DEBUG_PLANE,
 				 "vp%d update %s[%dx%d@(%d, %d)->%dx%d@(%d, %d)] zpos[%d] fmt[%p4cc%s] addr[%pad] fb_size[0x%zx] by %s\n",
@@ -6292,10 +6607,115 @@ static void vop2_plane_atomic_update(struct drm_plane *plane, struct drm_atomic_
 #endif
 }
 
+/*
+ * Cursor and planes with the ASYNC_COMMIT property set can be moved or
+ * flipped without waiting for vblank, as long as nothing but the position
+ * and the buffer address changes.
+ */
+static int vop2_plane_atomic_async_check(struct drm_plane *plane,
+					 struct drm_atomic_state *state)
+{
+	struct drm_plane_state *new_pstate = drm_atomic_get_new_plane_state(state, plane);
+	struct drm_plane_state *old_pstate = plane->state;
+	struct vop2_plane_state *vpstate = to_vop2_plane_state(new_pstate);
+	struct drm_crtc_state *cstate;
+	struct rockchip_crtc_state *vcstate;
+	struct drm_framebuffer *old_fb, *new_fb;
+
+	if (!new_pstate->crtc || !old_pstate || !old_pstate->visible || !new_pstate->visible)
+		return -EINVAL;
+
+	if (plane != new_pstate->crtc->cursor && !vpstate->async_commit)
+		return -EINVAL;
+
+	cstate = drm_atomic_get_existing_crtc_state(state, new_pstate->crtc);
+	if (!cstate)
+		cstate = new_pstate->crtc->state;
+	vcstate = to_rockchip_crtc_state(cstate);
+	if (!cstate->active || vcstate->splice_mode)
+		return -EINVAL;
+
+	old_fb = old_pstate->fb;
+	new_fb = new_pstate->fb;
+	if (!old_fb || !new_fb || old_fb->format != new_fb->format ||
+	    old_fb->modifier != new_fb->modifier)
+		return -EINVAL;
+
+	if (old_pstate->rotation != new_pstate->rotation ||
+	    old_pstate->alpha != new_pstate->alpha ||
+	    old_pstate->pixel_blend_mode != new_pstate->pixel_blend_mode ||
+	    old_pstate->zpos != new_pstate->zpos ||
+	    old_pstate->color_encoding != new_pstate->color_encoding ||
+	    old_pstate->color_range != new_pstate->color_range)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void vop2_plane_atomic_async_update(struct drm_plane *plane,
+					   struct drm_atomic_state *state)
+{
+	struct drm_plane_state *new_pstate = drm_atomic_get_new_plane_state(state, plane);
+	struct vop2_plane_state *new_vpstate = to_vop2_plane_state(new_pstate);
+	struct vop2_plane_state *vpstate = to_vop2_plane_state(plane->state);
+	struct drm_crtc *crtc = plane->state->crtc;
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2_win *win = to_vop2_win(plane);
+	struct vop2 *vop2 = win->vop2;
+	struct drm_framebuffer *old_fb = plane->state->fb;
+	unsigned long flags;
+
+	plane->state->crtc_x = new_pstate->crtc_x;
+	plane->state->crtc_y = new_pstate->crtc_y;
+	plane->state->crtc_w = new_pstate->crtc_w;
+	plane->state->crtc_h = new_pstate->crtc_h;
+	plane->state->src_x = new_pstate->src_x;
+	plane->state->src_y = new_pstate->src_y;
+	plane->state->src_w = new_pstate->src_w;
+	plane->state->src_h = new_pstate->src_h;
+	plane->state->src = new_pstate->src;
+	plane->state->dst = new_pstate->dst;
+	swap(plane->state->fb, new_pstate->fb);
+
+	vpstate->src = new_vpstate->src;
+	vpstate->dest = new_vpstate->dest;
+	vpstate->yrgb_mst = new_vpstate->yrgb_mst;
+	vpstate->uv_mst = new_vpstate->uv_mst;
+	vpstate->fb_size = new_vpstate->fb_size;
+	vpstate->offset = new_vpstate->offset;
+
+	if (!vop2->is_enabled)
+		return;
+
+	rockchip_drm_dbg(vop2->dev, VOP_DEBUG_PLANE, "vp%d async update %s to (%d, %d)\n",
+			 vp->id, win->name, vpstate->dest.x1, vpstate->dest.y1);
+
+	vop2_plane_atomic_update(plane, state);
+
+	WRITE_ONCE(vp->hold_frame_dirty, true);
+	spin_lock_irqsave(&vop2->irq_lock, flags);
+	vop2_cfg_done(crtc);
+	spin_unlock_irqrestore(&vop2->irq_lock, flags);
+
+	/*
+	 * The old fb may still be scanned out until the next vblank, hold
+	 * it and let the fb unref worker drop it like a normal commit.
+	 */
+	if (old_fb && old_fb != plane->state->fb) {
+		if (!vop2->skip_ref_fb)
+			drm_framebuffer_get(old_fb);
+		WARN_ON(drm_crtc_vblank_get(crtc) != 0);
+		drm_flip_work_queue(&vp->fb_unref_work, old_fb);
+		set_bit(VOP_PENDING_FB_UNREF, &vp->pending);
+	}
+}
+
 static const struct drm_plane_helper_funcs vop2_plane_helper_funcs = {
 	.atomic_check = vop2_plane_atomic_check,
 	.atomic_update = vop2_plane_atomic_update,
 	.atomic_disable = vop2_plane_atomic_disable,
+	.atomic_async_check = vop2_plane_atomic_async_check,
+	.atomic_async_update = vop2_plane_atomic_async_update,
 };
 
 /**
@@ -6465,15 +6885,33 @@ static struct drm_plane_state *vop2_atomic_plane_duplicate_state(struct drm_plan
 	return &vpstate->base;
 }
 
+static void vop2_plane_state_free(struct vop2_plane_state *vpstate)
+{
+	drm_property_blob_put(vpstate->dci_data);
+	__drm_atomic_helper_plane_destroy_state(&vpstate->base);
+
+	kfree(vpstate);
+}
+
 static void vop2_atomic_plane_destroy_state(struct drm_plane *plane,
 					    struct drm_plane_state *state)
 {
 	struct vop2_plane_state *vpstate = to_vop2_plane_state(state);
+	struct vop2_video_port *vp;
 
-	drm_property_blob_put(vpstate->dci_data);
-	__drm_atomic_helper_plane_destroy_state(state);
+	/*
+	 * The states of an atomic commit are freed from the commit tail,
+	 * dropping the last reference of a fb and its buffer there stretches
+	 * the commit time, so leave it to the crtc reclaim work.
+	 */
+	if (state->state && state->crtc) {
+		vp = to_vop2_video_port(state->crtc);
+		llist_add(&vpstate->reclaim_node, &vp->plane_reclaim_list);
+		queue_work(system_unbound_wq, &vp->reclaim_work);
+		return;
+	}
 
-	kfree(vpstate);
+	vop2_plane_state_free(vpstate);
 }
 
 /* copied from drm_atomic.c */
@@ -6856,6 +7294,41 @@ static int vop2_crtc_wait_vact_end(struct drm_crtc *crtc, unsigned int mstimeout
 	return ret;
 }
 
+/*
+ * Return at the vact end line flag, the start of the vertical blanking.
+ * The dmc calls it with the dmcfreq write lock held, so vop2_lock() must
+ * not be taken here. The held dmcfreq lock keeps the vop2 enable/disable
+ * path, which takes it for read, from running during the wait.
+ */
+static int vop2_crtc_wait_vblank_window(struct drm_crtc *crtc, unsigned int mstimeout)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	const struct vop_intr *intr = vop2->data->vp[vp->id].intr;
+	unsigned long jiffies_left;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vop2->irq_lock, flags);
+	/* line flag is in use by wait_vact_end */
+	if (!vop2->is_enabled || VOP_INTR_GET_TYPE(vop2, intr, enable, LINE_FLAG_INTR)) {
+		spin_unlock_irqrestore(&vop2->irq_lock, flags);
+		return -EBUSY;
+	}
+	reinit_completion(&vp->line_flag_completion);
+	VOP_INTR_SET_TYPE(vop2, intr, clear, LINE_FLAG_INTR, 1);
+	VOP_INTR_SET_TYPE(vop2, intr, enable, LINE_FLAG_INTR, 1);
+	spin_unlock_irqrestore(&vop2->irq_lock, flags);
+
+	jiffies_left = wait_for_completion_timeout(&vp->line_flag_completion,
+						   msecs_to_jiffies(mstimeout));
+
+	spin_lock_irqsave(&vop2->irq_lock, flags);
+	VOP_INTR_SET_TYPE(vop2, intr, enable, LINE_FLAG_INTR, 0);
+	spin_unlock_irqrestore(&vop2->irq_lock, flags);
+
+	return jiffies_left ? 0 : -ETIMEDOUT;
+}
+
 static int vop2_crtc_enable_line_flag_event(struct drm_crtc *crtc, uint32_t line)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
@@ -7137,6 +7610,36 @@ static void vop2_dump_connector_on_crtc(struct drm_crtc *crtc, struct seq_file *
 	drm_connector_list_iter_end(&conn_iter);
 }
 
+static void vop2_genlock_dump(struct vop2_video_port *vp, struct seq_file *s)
+{
+	struct vop2 *vop2 = vp->vop2;
+	struct vop2_video_port *ref_vp = NULL;
+	int i, vtotal, skew;
+
+	if (!vp->genlock)
+		return;
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		if (vop2->vps[i].genlock) {
+			ref_vp = &vop2->vps[i];
+			break;
+		}
+	}
+
+	if (ref_vp == vp) {
+		DEBUG_PRINT("\tgenlock: reference\n");
+		return;
+	}
+
+	/* vcnt difference folded to [-vtotal / 2, vtotal / 2) */
+	vtotal = VOP_MODULE_GET(vop2, vp, dsp_vtotal);
+	skew = (int)vop2_read_vcnt(vp) - (int)vop2_read_vcnt(ref_vp);
+	if (vtotal)
+		skew = ((skew % vtotal) + vtotal + vtotal / 2) % vtotal - vtotal / 2;
+	DEBUG_PRINT("\tgenlock: ref vp%d skew %d lines %s\n", ref_vp->id, skew,
+		    abs(skew) <= 1 ? "locked" : "unlocked");
+}
+
 static int vop2_crtc_debugfs_dump(struct drm_crtc *crtc, struct seq_file *s)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
@@ -7173,6 +7676,8 @@ static int vop2_crtc_debugfs_dump(struct drm_crtc *crtc, struct seq_file *s)
 		    mode->crtc_hsync_end, mode->crtc_htotal);
 	DEBUG_PRINT("\tFixed V: %d %d %d %d\n", mode->crtc_vdisplay, mode->crtc_vsync_start,
 		    mode->crtc_vsync_end, mode->crtc_vtotal);
+	DEBUG_PRINT("\tdamage: " DRM_RECT_FMT "\n", DRM_RECT_ARG(&state->damage));
+	vop2_genlock_dump(vp, s);
 
 	drm_atomic_crtc_for_each_plane(plane, crtc) {
 		vop2_plane_info_dump(s, plane);
@@ -7332,10 +7837,124 @@ static int vop2_cubic_lut_show(struct seq_file *s, void *data)
 	return 0;
 }
 
-static void rockchip_drm_vop2_pixel_shift_duplicate_commit(struct drm_device *dev)
+static void vop2_fbc_modifier_dump(struct seq_file *s, u64 modifier)
 {
-	struct drm_atomic_state *state;
-	struct drm_mode_config *mode_config = &dev->mode_config;
+	if (drm_is_afbc(modifier)) {
+		DEBUG_PRINT("AFBC %s%s%s%s",
+			    (modifier & AFBC_FORMAT_MOD_BLOCK_SIZE_MASK) ==
+			    AFBC_FORMAT_MOD_BLOCK_SIZE_32x8 ? "32x8" : "16x16",
+			    modifier & AFBC_FORMAT_MOD_YTR ? " YTR" : "",
+			    modifier & AFBC_FORMAT_MOD_SPARSE ? " SPARSE" : "",
+			    modifier & AFBC_FORMAT_MOD_SPLIT ? " SPLIT" : "");
+		if (modifier & AFBC_FORMAT_MOD_CBR)
+			DEBUG_PRINT(" CBR");
+	} else if (modifier == DRM_FORMAT_MOD_LINEAR) {
+		DEBUG_PRINT("LINEAR");
+	} else {
+		DEBUG_PRINT("%s", modifier_to_string(modifier));
+	}
+}
+
+/*
+ * List the formats each window accepts for every modifier, '+rb'/'+uv'
+ * marks formats scanned with red/blue or u/v swap.
+ */
+static int vop2_fbc_caps_show(struct seq_file *s, void *data)
+{
+	struct drm_info_node *node = s->private;
+	struct vop2 *vop2 = node->info_ent->data;
+	struct drm_plane *plane;
+	struct vop2_win *win;
+	bool fbc, rb_swap, uv_swap;
+	u64 modifier;
+	u32 format;
+	int i, j, k;
+
+	for (i = 0; i < vop2->registered_num_wins; i++) {
+		win = &vop2->win[i];
+		plane = &win->base;
+		if (!plane->dev)
+			continue;
+
+		DEBUG_PRINT("%s:\n", win->name);
+		for (j = 0; j < plane->modifier_count; j++) {
+			modifier = plane->modifiers[j];
+			fbc = drm_is_afbc(modifier) || IS_ROCKCHIP_RFBC_MOD(modifier);
+
+			DEBUG_PRINT("\t");
+			vop2_fbc_modifier_dump(s, modifier);
+			if (drm_is_afbc(modifier))
+				DEBUG_PRINT(" (half-block unless rotate 90/270)");
+			DEBUG_PRINT(":");
+
+			for (k = 0; k < plane->format_count; k++) {
+				format = plane->format_types[k];
+				if (!rockchip_vop2_mod_supported(plane, format, modifier))
+					continue;
+
+				rb_swap = fbc ? vop2_afbc_rb_swap(format) : vop2_win_rb_swap(format);
+				uv_swap = fbc ? vop2_afbc_uv_swap(format) : vop2_win_uv_swap(format);
+				DEBUG_PRINT(" %p4cc%s%s", &format, rb_swap ? "+rb" : "",
+					    uv_swap ? "+uv" : "");
+			}
+			DEBUG_PRINT("\n");
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Show how each active window is scanned in the current commit, and how
+ * many commits it was compressed, tiled or linear.
+ */
+static int vop2_fbc_status_show(struct seq_file *s, void *data)
+{
+	struct drm_info_node *node = s->private;
+	struct vop2 *vop2 = node->info_ent->data;
+	struct vop2_plane_state *vpstate;
+	struct drm_plane_state *pstate;
+	struct drm_framebuffer *fb;
+	struct vop2_win *win;
+	int i;
+
+	drm_modeset_lock_all(vop2->drm_dev);
+	for (i = 0; i < vop2->registered_num_wins; i++) {
+		win = &vop2->win[i];
+		pstate = win->base.state;
+		if (!pstate)
+			continue;
+
+		DEBUG_PRINT("%s: fbc[%u] tiled[%u] linear[%u]", win->name, win->fbc_commits,
+			    win->tiled_commits, win->linear_commits);
+
+		fb = pstate->fb;
+		if (!pstate->crtc || !fb || !pstate->visible) {
+			DEBUG_PRINT(" DISABLED\n");
+			continue;
+		}
+
+		vpstate = to_vop2_plane_state(pstate);
+		DEBUG_PRINT(" vp%d %p4cc %s ", to_vop2_video_port(pstate->crtc)->id,
+			    &fb->format->format,
+			    vpstate->afbc_en ? "COMPRESSED" : vpstate->tiled_en ? "TILED" : "LINEAR");
+		vop2_fbc_modifier_dump(s, fb->modifier);
+		if (vpstate->afbc_en)
+			DEBUG_PRINT(" half_block[%d] rb_swap[%d] uv_swap[%d]",
+				    vpstate->afbc_half_block_en,
+				    vop2_afbc_rb_swap(fb->format->format),
+				    vop2_afbc_uv_swap(fb->format->format));
+		DEBUG_PRINT("\n");
+	}
+	drm_modeset_unlock_all(vop2->drm_dev);
+
+	return 0;
+}
+
+static void rockchip_drm_vop2_pixel_shift_duplicate_commit(struct drm_device *dev)
+{
+	struct drm_atomic_state *state;
+	struct drm_mode_config *mode_config = &dev->mode_config;
 	int ret;
 
 	drm_modeset_lock_all(dev);
@@ -7486,9 +8105,48 @@ static int vop2_crtc_sysfs_fini(struct device *dev, struct drm_crtc *crtc)
 
 #undef DEBUG_PRINT
 
+static int vop2_win_alloc_show(struct seq_file *s, void *data)
+{
+	struct drm_info_node *node = s->private;
+	struct vop2 *vop2 = node->info_ent->data;
+	struct vop2_video_port *vp;
+	struct drm_plane_state *pstate;
+	struct vop2_win *win;
+	int i;
+
+	drm_modeset_lock_all(vop2->drm_dev);
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		vp = &vop2->vps[i];
+		DEBUG_PRINT("vp%d: win_mask[0x%x] enabled_win_mask[0x%x]%s\n", vp->id,
+			    vp->win_mask, vp->enabled_win_mask,
+			    vp->splice_mode_right ? " splice right" : "");
+	}
+
+	for (i = 0; i < vop2->registered_num_wins; i++) {
+		win = &vop2->win[i];
+		if (win->parent || (win->feature & WIN_FEATURE_CLUSTER_SUB))
+			continue;
+
+		pstate = win->base.state;
+		DEBUG_PRINT("%s: possible_vp_mask[0x%x] vp_mask[0x%x]", win->name,
+			    win->possible_vp_mask, win->vp_mask);
+		if (pstate && pstate->crtc)
+			DEBUG_PRINT(" plane on vp%d", to_vop2_video_port(pstate->crtc)->id);
+		if (win->splice_mode_right && win->left_win)
+			DEBUG_PRINT(" splice right of %s", win->left_win->name);
+		DEBUG_PRINT("\n");
+	}
+	drm_modeset_unlock_all(vop2->drm_dev);
+
+	return 0;
+}
+
 static struct drm_info_list vop2_debugfs_files[] = {
 	{ "gamma_lut", vop2_gamma_show, 0, NULL },
 	{ "cubic_lut", vop2_cubic_lut_show, 0, NULL },
+	{ "fbc_caps", vop2_fbc_caps_show, 0, NULL },
+	{ "fbc_status", vop2_fbc_status_show, 0, NULL },
+	{ "win_alloc", vop2_win_alloc_show, 0, NULL },
 };
 
 static int vop2_crtc_debugfs_init(struct drm_minor *minor, struct drm_crtc *crtc)
@@ -7657,48 +8315,34 @@ static u64 vop2_calc_max_bandwidth(struct vop2_bandwidth *bw, int start,
 	return max_bandwidth;
 }
 
-static size_t vop2_crtc_bandwidth(struct drm_crtc *crtc,
-				  struct drm_crtc_state *crtc_state,
-				  struct dmcfreq_vop_info *vop_bw_info)
+/*
+ * Bandwidth of all the planes attached to @crtc_state. The planes not in
+ * @state (or all of them when @state is NULL) are taken from their current
+ * state, so unchanged planes on the vp are counted too.
+ */
+static int vop2_crtc_state_bandwidth(struct drm_crtc *crtc,
+				     struct drm_crtc_state *crtc_state,
+				     struct drm_atomic_state *state,
+				     struct dmcfreq_vop_info *vop_bw_info)
 {
-	struct drm_display_mode *adjusted_mode = &crtc->state->adjusted_mode;
+	struct drm_display_mode *adjusted_mode = &crtc_state->adjusted_mode;
 	uint16_t htotal = adjusted_mode->crtc_htotal;
 	uint16_t vdisplay = adjusted_mode->crtc_vdisplay;
 	int clock = adjusted_mode->crtc_clock;
-	struct drm_atomic_state *state = crtc_state->state;
+	int fps = drm_mode_vrefresh(adjusted_mode);
 	struct vop2_plane_state *vpstate;
 	struct drm_plane_state *pstate;
 	struct vop2_bandwidth *pbandwidth;
 	struct drm_plane *plane;
 	u64 line_bw_mbyte = 0;
-	int8_t cnt = 0, plane_num = 0;
-	int i = 0;
-#if defined(CONFIG_ROCKCHIP_DRM_DEBUG)
-	struct vop_dump_list *pos, *n;
-	struct vop2_video_port *vp = to_vop2_video_port(crtc);
-#endif
+	int8_t cnt = 0, plane_num;
 
-	if (!htotal || !vdisplay)
+	if (!crtc_state->active || !htotal || !vdisplay)
 		return 0;
 
-#if defined(CONFIG_ROCKCHIP_DRM_DEBUG)
-	if (!vp->rockchip_crtc.vop_dump_list_init_flag) {
-		INIT_LIST_HEAD(&vp->rockchip_crtc.vop_dump_list_head);
-		vp->rockchip_crtc.vop_dump_list_init_flag = true;
-	}
-	list_for_each_entry_safe(pos, n, &vp->rockchip_crtc.vop_dump_list_head, entry) {
-		list_del(&pos->entry);
-	}
-	if (vp->rockchip_crtc.vop_dump_status == DUMP_KEEP ||
-	    vp->rockchip_crtc.vop_dump_times > 0) {
-		vp->rockchip_crtc.frame_count++;
-	}
-#endif
-
-	for_each_new_plane_in_state(state, plane, pstate, i) {
-		if (pstate->crtc == crtc)
-			plane_num++;
-	}
+	plane_num = hweight32(crtc_state->plane_mask);
+	if (!plane_num)
+		return 0;
 
 	vop_bw_info->plane_num += plane_num;
 	pbandwidth = kmalloc_array(plane_num, sizeof(*pbandwidth),
@@ -7706,11 +8350,13 @@ static size_t vop2_crtc_bandwidth(struct drm_crtc *crtc,
 	if (!pbandwidth)
 		return -ENOMEM;
 
-	for_each_new_plane_in_state(state, plane, pstate, i) {
+	drm_for_each_plane_mask(plane, crtc->dev, crtc_state->plane_mask) {
 		int act_w, act_h, bpp, afbc_fac;
-		int fps = drm_mode_vrefresh(adjusted_mode);
 
-		if (!pstate || pstate->crtc != crtc || !pstate->fb)
+		pstate = state ? drm_atomic_get_new_plane_state(state, plane) : NULL;
+		if (!pstate)
+			pstate = plane->state;
+		if (!pstate || !pstate->fb || !pstate->visible)
 			continue;
 
 		/* This is an empirical value, if it's afbc format, the frame buffer size div 2 */
@@ -7742,11 +8388,121 @@ static size_t vop2_crtc_bandwidth(struct drm_crtc *crtc,
 	 */
 	line_bw_mbyte *= clock;
 	do_div(line_bw_mbyte, htotal * 1000);
-	vop_bw_info->line_bw_mbyte = line_bw_mbyte;
+	vop_bw_info->line_bw_mbyte += line_bw_mbyte;
 
 	return 0;
 }
 
+static size_t vop2_crtc_bandwidth(struct drm_crtc *crtc,
+				  struct drm_crtc_state *crtc_state,
+				  struct dmcfreq_vop_info *vop_bw_info)
+{
+#if defined(CONFIG_ROCKCHIP_DRM_DEBUG)
+	struct vop_dump_list *pos, *n;
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+
+	if (!vp->rockchip_crtc.vop_dump_list_init_flag) {
+		INIT_LIST_HEAD(&vp->rockchip_crtc.vop_dump_list_head);
+		vp->rockchip_crtc.vop_dump_list_init_flag = true;
+	}
+	list_for_each_entry_safe(pos, n, &vp->rockchip_crtc.vop_dump_list_head, entry) {
+		list_del(&pos->entry);
+	}
+	if (vp->rockchip_crtc.vop_dump_status == DUMP_KEEP ||
+	    vp->rockchip_crtc.vop_dump_times > 0) {
+		vp->rockchip_crtc.frame_count++;
+	}
+#endif
+
+	/*
+	 * Called from commit tail before the planes are committed, raise the
+	 * dmc floor for the whole new configuration of this vp.
+	 */
+	return vop2_crtc_state_bandwidth(crtc, crtc->state, NULL, vop_bw_info);
+}
+
+/*
+ * Tell user space what would make a too heavy commit fit: AFBC halves
+ * the fetch of a linear buffer, and a cluster window fetches a scaled
+ * down afbc buffer without the line skip penalty of esmart.
+ */
+static void vop2_crtc_bandwidth_suggest(struct drm_crtc *crtc,
+					struct drm_crtc_state *crtc_state,
+					struct drm_atomic_state *state)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	struct drm_plane_state *pstate;
+	struct drm_plane *plane;
+
+	drm_for_each_plane_mask(plane, crtc->dev, crtc_state->plane_mask) {
+		struct vop2_win *win = to_vop2_win(plane);
+		struct vop2_plane_state *vpstate;
+
+		pstate = drm_atomic_get_new_plane_state(state, plane);
+		if (!pstate)
+			pstate = plane->state;
+		if (!pstate || !pstate->fb || !pstate->visible)
+			continue;
+
+		vpstate = to_vop2_plane_state(pstate);
+		if (!vpstate->afbc_en && (win->feature & WIN_FEATURE_AFBDC))
+			rockchip_drm_dbg(vop2->dev, VOP_DEBUG_PLANE,
+					 "vp%d %s: linear fb, an afbc fb would save bandwidth\n",
+					 vp->id, win->name);
+		else if (!vop2_cluster_window(win) &&
+			 drm_rect_height(&vpstate->src) >> 16 > drm_rect_height(&vpstate->dest) &&
+			 drm_rect_width(&vpstate->src) >> 16 > 2560)
+			rockchip_drm_dbg(vop2->dev, VOP_DEBUG_PLANE,
+					 "vp%d %s: large scale down, move it to a cluster window with afbc\n",
+					 vp->id, win->name);
+	}
+}
+
+/*
+ * Admission control for a new configuration: the line bandwidth of all
+ * the active vps must fit the vop-bw-dmc table of the dmc, otherwise the
+ * commit is rejected here instead of ending up with underflow.
+ */
+static int vop2_crtc_bandwidth_admission(struct drm_crtc *crtc,
+					 struct drm_crtc_state *crtc_state,
+					 struct drm_atomic_state *state)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	struct dmcfreq_vop_info vop_bw_info = {};
+	int i, ret;
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		struct drm_crtc *loop = &vop2->vps[i].rockchip_crtc.crtc;
+		struct drm_crtc_state *cstate;
+
+		if (!loop->dev)
+			continue;
+
+		/* vp not in this commit keeps its current configuration */
+		cstate = drm_atomic_get_new_crtc_state(state, loop);
+		if (!cstate)
+			cstate = loop->state;
+		if (!cstate)
+			continue;
+
+		ret = vop2_crtc_state_bandwidth(loop, cstate, state, &vop_bw_info);
+		if (ret)
+			return ret;
+	}
+
+	ret = rockchip_dmcfreq_vop_bandwidth_request(&vop_bw_info);
+	if (!ret)
+		return 0;
+
+	DRM_DEV_DEBUG(vop2->dev, "vp%d line bandwidth %u MB/s frame bandwidth %u MB/s over dmc capability\n",
+		      vp->id, vop_bw_info.line_bw_mbyte, vop_bw_info.frame_bw_mbyte);
+	vop2_crtc_bandwidth_suggest(crtc, crtc_state, state);
+
+	return -ENOSPC;
+}
+
 static void vop2_crtc_close(struct drm_crtc *crtc)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
@@ -7773,6 +8529,13 @@ static void vop2_crtc_te_handler(struct drm_crtc *crtc)
 	if (!crtc || !crtc->state->active)
 		return;
 
+	/*
+	 * The command mode panel refreshes itself from its own frame
+	 * buffer, no need to transfer the same frame again.
+	 */
+	if (!xchg(&vp->hold_frame_dirty, false))
+		return;
+
 	VOP_MODULE_SET(vop2, vp, edpi_wms_fs, 1);
 }
 
@@ -7814,6 +8577,13 @@ static int vop2_crtc_set_color_bar(struct drm_crtc *crtc, enum rockchip_color_ba
 	return ret;
 }
 
+static u32 vop2_crtc_get_underflow_count(struct drm_crtc *crtc)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+
+	return atomic_read(&vp->post_buf_empty_count);
+}
+
 static int vop2_crtc_get_crc(struct drm_crtc *crtc)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
@@ -7844,12 +8614,15 @@ static const struct rockchip_crtc_funcs private_crtc_funcs = {
 	.te_handler = vop2_crtc_te_handler,
 	.crtc_send_mcu_cmd = vop3_crtc_send_mcu_cmd,
 	.wait_vact_end = vop2_crtc_wait_vact_end,
+	.wait_vblank_window = vop2_crtc_wait_vblank_window,
 	.crtc_standby = vop2_crtc_standby,
 	.crtc_output_post_enable = vop2_crtc_output_post_enable,
 	.crtc_output_pre_disable = vop2_crtc_output_pre_disable,
 	.crtc_set_color_bar = vop2_crtc_set_color_bar,
 	.set_aclk = vop2_devfreq_set_aclk,
 	.get_crc = vop2_crtc_get_crc,
+	.get_underflow_count = vop2_crtc_get_underflow_count,
+	.wb_stream = vop2_crtc_wb_stream,
 };
 
 static bool vop2_crtc_mode_fixup(struct drm_crtc *crtc,
@@ -9502,8 +10275,15 @@ static void vop2_crtc_atomic_enable(struct drm_crtc *crtc, struct drm_atomic_sta
 	 * so VP scan out with 4K timing at 74.25MHZ dclk, this is
 	 * very slow, than this will trigger vblank timeout.
 	 *
+	 * A genlocked video port stays in standby here, it is released
+	 * together with the other members of its group by the flush of
+	 * this commit, see vop2_genlock_start().
 	 */
-	VOP_MODULE_SET(vop2, vp, standby, 0);
+	vp->genlock = vcstate->genlock;
+	if (vp->genlock)
+		vp->genlock_start_pending = true;
+	else
+		VOP_MODULE_SET(vop2, vp, standby, 0);
 
 	if (vp->mcu_timing.mcu_pix_total) {
 		vop3_set_out_mode(crtc, vcstate->output_mode);
@@ -9521,7 +10301,8 @@ static void vop2_crtc_atomic_enable(struct drm_crtc *crtc, struct drm_atomic_sta
 	if (vp->gamma_lut_active) {
 		vop2_crtc_load_lut(crtc);
 		vop2_cfg_done(crtc);
-		vop2_wait_for_fs_by_done_bit_status(vp);
+		if (!vp->genlock_start_pending)
+			vop2_wait_for_fs_by_done_bit_status(vp);
 	}
 
 	/*
@@ -9626,53 +10407,314 @@ static void vop2_update_post_csc_info(struct vop2_video_port *vp,
 		memset(&vp->csc_info, 0, sizeof(struct post_csc));
 }
 
-static int vop2_crtc_atomic_check(struct drm_crtc *crtc,
-				  struct drm_atomic_state *state)
+static void vop2_rect_union(struct drm_rect *r, const struct drm_rect *clip)
+{
+	if (!drm_rect_visible(clip))
+		return;
+
+	if (!drm_rect_visible(r)) {
+		*r = *clip;
+		return;
+	}
+
+	r->x1 = min(r->x1, clip->x1);
+	r->y1 = min(r->y1, clip->y1);
+	r->x2 = max(r->x2, clip->x2);
+	r->y2 = max(r->y2, clip->y2);
+}
+
+static bool vop2_plane_damage_full(struct drm_plane_state *old_pstate,
+				   struct drm_plane_state *new_pstate)
+{
+	return old_pstate->crtc != new_pstate->crtc ||
+	       old_pstate->visible != new_pstate->visible ||
+	       !drm_rect_equals(&old_pstate->dst, &new_pstate->dst) ||
+	       old_pstate->alpha != new_pstate->alpha ||
+	       old_pstate->pixel_blend_mode != new_pstate->pixel_blend_mode ||
+	       old_pstate->normalized_zpos != new_pstate->normalized_zpos ||
+	       old_pstate->rotation != new_pstate->rotation ||
+	       old_pstate->color_encoding != new_pstate->color_encoding ||
+	       old_pstate->color_range != new_pstate->color_range;
+}
+
+/*
+ * Merge the damage of every plane changed in this commit into one rect in
+ * crtc coordinates. Damage clips are in framebuffer coordinates, so they
+ * are scaled onto the plane destination; for rotated or mirrored planes
+ * the whole destination is taken.
+ */
+static void vop2_crtc_update_damage(struct drm_crtc *crtc, struct drm_crtc_state *crtc_state,
+				    struct drm_atomic_state *state)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
-	struct vop2_video_port *splice_vp;
-	struct vop2 *vop2 = vp->vop2;
-	const struct vop2_data *vop2_data = vop2->data;
-	struct drm_crtc_state *new_crtc_state = drm_atomic_get_new_crtc_state(state, crtc);
-	struct drm_crtc_state *old_crtc_state = drm_atomic_get_old_crtc_state(state, crtc);
-	const struct vop2_video_port_data *vp_data = &vop2_data->vp[vp->id];
-	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(crtc->state);
-	struct rockchip_crtc_state *new_vcstate = to_rockchip_crtc_state(new_crtc_state);
-	struct rockchip_crtc_state *old_vcstate = to_rockchip_crtc_state(old_crtc_state);
-	struct drm_display_mode *adjusted_mode = &crtc->state->adjusted_mode;
+	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(crtc_state);
+	struct drm_plane_state *old_pstate, *new_pstate;
+	struct drm_display_mode *mode = &crtc_state->mode;
+	struct drm_rect *damage = &vcstate->damage;
+	struct drm_rect full, clip;
+	struct drm_plane *plane;
+	int src_w, src_h, dst_w, dst_h;
+	int i;
 
-	if (vop2_has_feature(vop2, VOP_FEATURE_SPLICE)) {
-		if (adjusted_mode->hdisplay > VOP2_MAX_VP_OUTPUT_WIDTH) {
-			vcstate->splice_mode = true;
-			splice_vp = &vop2->vps[vp_data->splice_vp_id];
-			splice_vp->splice_mode_right = true;
-			splice_vp->left_vp = vp;
-		}
+	drm_rect_init(damage, 0, 0, 0, 0);
+	drm_rect_init(&full, 0, 0, mode->hdisplay, mode->vdisplay);
+
+	if (!crtc_state->active)
+		return;
+
+	if (drm_atomic_crtc_needs_modeset(crtc_state) || crtc_state->color_mgmt_changed ||
+	    crtc_state->zpos_changed) {
+		*damage = full;
+		return;
 	}
 
-	if ((vcstate->request_refresh_rate != new_vcstate->request_refresh_rate) ||
-	    new_crtc_state->active_changed || new_crtc_state->mode_changed)
-		vp->refresh_rate_change = true;
-	else
-		vp->refresh_rate_change = false;
+	for_each_oldnew_plane_in_state(state, plane, old_pstate, new_pstate, i) {
+		if (old_pstate->crtc != crtc && new_pstate->crtc != crtc)
+			continue;
 
-	vop2_update_post_csc_info(vp, new_vcstate, old_vcstate);
+		if (vop2_plane_damage_full(old_pstate, new_pstate)) {
+			if (old_pstate->crtc == crtc && old_pstate->visible)
+				vop2_rect_union(damage, &old_pstate->dst);
+			if (new_pstate->crtc == crtc && new_pstate->visible)
+				vop2_rect_union(damage, &new_pstate->dst);
+			continue;
+		}
 
-	if (vop2_update_acm_info(vp, new_vcstate, old_vcstate) ||
-	    new_crtc_state->active_changed)
-		vp->acm_state_changed = true;
-	else
-		vp->acm_state_changed = false;
+		if (!new_pstate->visible ||
+		    !drm_atomic_helper_damage_merged(old_pstate, new_pstate, &clip))
+			continue;
 
-	return 0;
+		if (new_pstate->rotation != DRM_MODE_ROTATE_0) {
+			vop2_rect_union(damage, &new_pstate->dst);
+			continue;
+		}
+
+		src_w = drm_rect_width(&new_pstate->src) >> 16;
+		src_h = drm_rect_height(&new_pstate->src) >> 16;
+		dst_w = drm_rect_width(&new_pstate->dst);
+		dst_h = drm_rect_height(&new_pstate->dst);
+		if (!src_w || !src_h)
+			continue;
+
+		drm_rect_translate(&clip, -(new_pstate->src.x1 >> 16), -(new_pstate->src.y1 >> 16));
+		clip.x1 = new_pstate->dst.x1 + clip.x1 * dst_w / src_w;
+		clip.y1 = new_pstate->dst.y1 + clip.y1 * dst_h / src_h;
+		clip.x2 = new_pstate->dst.x1 + DIV_ROUND_UP(clip.x2 * dst_w, src_w);
+		clip.y2 = new_pstate->dst.y1 + DIV_ROUND_UP(clip.y2 * dst_h, src_h);
+		vop2_rect_union(damage, &clip);
+	}
+
+	drm_rect_intersect(damage, &full);
+
+	rockchip_drm_dbg(vp->vop2->dev, VOP_DEBUG_PLANE, "vp%d damage " DRM_RECT_FMT "\n",
+			 vp->id, DRM_RECT_ARG(damage));
 }
 
-static void vop3_disable_dynamic_hdr(struct vop2_video_port *vp, uint8_t win_phys_id)
+/*
+ * The windows and video ports a crtc state takes from the shared pool: the
+ * windows of its planes, and at splice mode the right half windows and the
+ * splice vp which are driven implicitly without a drm plane/crtc of their own.
+ */
+static u32 vop2_crtc_state_win_demand(struct vop2_video_port *vp,
+				      struct drm_crtc_state *cstate, u8 *vp_demand)
 {
 	struct vop2 *vop2 = vp->vop2;
-	struct vop2_win *win = vop2_find_win_by_phys_id(vop2, win_phys_id);
-	struct drm_plane *plane = &win->base;
-	struct drm_plane_state *pstate = plane->state;
+	const struct vop2_video_port_data *vp_data = &vop2->data->vp[vp->id];
+	struct vop2_win *win, *splice_win;
+	struct drm_plane *plane;
+	bool splice_mode;
+	u32 win_demand = 0;
+
+	*vp_demand = 0;
+	if (!cstate->active)
+		return 0;
+
+	*vp_demand = BIT(vp->id);
+	splice_mode = vop2_has_feature(vop2, VOP_FEATURE_SPLICE) &&
+		      cstate->adjusted_mode.hdisplay > VOP2_MAX_VP_OUTPUT_WIDTH;
+	if (splice_mode)
+		*vp_demand |= BIT(vp_data->splice_vp_id);
+
+	drm_for_each_plane_mask(plane, vop2->drm_dev, cstate->plane_mask) {
+		win = to_vop2_win(plane);
+		win_demand |= BIT(win->phys_id);
+		if (!splice_mode || !(win->feature & WIN_FEATURE_SPLICE_LEFT))
+			continue;
+		splice_win = vop2_find_win_by_phys_id(vop2, win->splice_win_id);
+		if (splice_win)
+			win_demand |= BIT(splice_win->phys_id);
+	}
+
+	return win_demand;
+}
+
+/*
+ * Windows move between video ports at runtime following the planes attached
+ * to each crtc, see vop2_crtc_atomic_begin(). Make sure the demand of all the
+ * vps after this commit can be served at the same time, e.g. an 8K splice
+ * output and a second display can share the windows, but the right half
+ * windows of the splice output can't be used by the second display.
+ */
+static int vop2_crtc_win_allocation_check(struct drm_crtc *crtc,
+					  struct drm_crtc_state *crtc_state,
+					  struct drm_atomic_state *state)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	u32 win_demand, other_win_demand;
+	u8 vp_demand, other_vp_demand;
+	int i;
+
+	win_demand = vop2_crtc_state_win_demand(vp, crtc_state, &vp_demand);
+	if (!vp_demand)
+		return 0;
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		struct vop2_video_port *other = &vop2->vps[i];
+		struct drm_crtc *loop = &other->rockchip_crtc.crtc;
+		struct drm_crtc_state *cstate;
+
+		if (other == vp || !loop->dev)
+			continue;
+
+		/* vp not in this commit keeps its current configuration */
+		cstate = drm_atomic_get_new_crtc_state(state, loop);
+		if (!cstate)
+			cstate = loop->state;
+		if (!cstate)
+			continue;
+
+		other_win_demand = vop2_crtc_state_win_demand(other, cstate, &other_vp_demand);
+		if (vp_demand & other_vp_demand) {
+			DRM_DEV_DEBUG(vop2->dev, "vp%d and vp%d both need vp mask 0x%x\n",
+				      vp->id, other->id, vp_demand & other_vp_demand);
+			return -EBUSY;
+		}
+
+		if (win_demand & other_win_demand) {
+			DRM_DEV_DEBUG(vop2->dev, "vp%d and vp%d both need win mask 0x%x\n",
+				      vp->id, other->id, win_demand & other_win_demand);
+			return -EBUSY;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The genlocked vps of a vop run on the same vsync, so they must share the
+ * frame timing: same htotal, vtotal and pixel clock. The dclks are expected
+ * to come from the same pll, otherwise the vps drift apart again after they
+ * are started together.
+ */
+static int vop2_crtc_genlock_check(struct drm_crtc *crtc,
+				   struct drm_crtc_state *crtc_state,
+				   struct drm_atomic_state *state)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct drm_display_mode *mode = &crtc_state->adjusted_mode;
+	struct vop2 *vop2 = vp->vop2;
+	int i;
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		struct vop2_video_port *other = &vop2->vps[i];
+		struct drm_crtc *loop = &other->rockchip_crtc.crtc;
+		struct drm_display_mode *other_mode;
+		struct drm_crtc_state *cstate;
+
+		if (other == vp || !loop->dev)
+			continue;
+
+		cstate = drm_atomic_get_new_crtc_state(state, loop);
+		if (!cstate)
+			cstate = loop->state;
+		if (!cstate || !cstate->active || !to_rockchip_crtc_state(cstate)->genlock)
+			continue;
+
+		other_mode = &cstate->adjusted_mode;
+		if (mode->crtc_htotal != other_mode->crtc_htotal ||
+		    mode->crtc_vtotal != other_mode->crtc_vtotal ||
+		    mode->crtc_clock != other_mode->crtc_clock) {
+			DRM_DEV_DEBUG(vop2->dev, "vp%d %dx%d@%d can't genlock with vp%d %dx%d@%d\n",
+				      vp->id, mode->crtc_htotal, mode->crtc_vtotal,
+				      mode->crtc_clock, other->id, other_mode->crtc_htotal,
+				      other_mode->crtc_vtotal, other_mode->crtc_clock);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int vop2_crtc_atomic_check(struct drm_crtc *crtc,
+				  struct drm_atomic_state *state)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2_video_port *splice_vp;
+	struct vop2 *vop2 = vp->vop2;
+	const struct vop2_data *vop2_data = vop2->data;
+	struct drm_crtc_state *new_crtc_state = drm_atomic_get_new_crtc_state(state, crtc);
+	struct drm_crtc_state *old_crtc_state = drm_atomic_get_old_crtc_state(state, crtc);
+	const struct vop2_video_port_data *vp_data = &vop2_data->vp[vp->id];
+	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(crtc->state);
+	struct rockchip_crtc_state *new_vcstate = to_rockchip_crtc_state(new_crtc_state);
+	struct rockchip_crtc_state *old_vcstate = to_rockchip_crtc_state(old_crtc_state);
+	struct drm_display_mode *adjusted_mode = &crtc->state->adjusted_mode;
+
+	if (vop2_has_feature(vop2, VOP_FEATURE_SPLICE)) {
+		if (adjusted_mode->hdisplay > VOP2_MAX_VP_OUTPUT_WIDTH) {
+			vcstate->splice_mode = true;
+			splice_vp = &vop2->vps[vp_data->splice_vp_id];
+			splice_vp->splice_mode_right = true;
+			splice_vp->left_vp = vp;
+		}
+	}
+
+	if ((vcstate->request_refresh_rate != new_vcstate->request_refresh_rate) ||
+	    (vcstate->vrr_late_latch != new_vcstate->vrr_late_latch) ||
+	    new_crtc_state->active_changed || new_crtc_state->mode_changed)
+		vp->refresh_rate_change = true;
+	else
+		vp->refresh_rate_change = false;
+
+	vop2_update_post_csc_info(vp, new_vcstate, old_vcstate);
+
+	if (vop2_update_acm_info(vp, new_vcstate, old_vcstate) ||
+	    new_crtc_state->active_changed)
+		vp->acm_state_changed = true;
+	else
+		vp->acm_state_changed = false;
+
+	vop2_crtc_update_damage(crtc, new_crtc_state, state);
+
+	if (new_crtc_state->active &&
+	    (new_crtc_state->planes_changed || drm_atomic_crtc_needs_modeset(new_crtc_state))) {
+		int ret = vop2_crtc_win_allocation_check(crtc, new_crtc_state, state);
+
+		if (ret)
+			return ret;
+	}
+
+	if (new_crtc_state->active && new_vcstate->genlock) {
+		int ret = vop2_crtc_genlock_check(crtc, new_crtc_state, state);
+
+		if (ret)
+			return ret;
+	}
+
+	if (new_crtc_state->active &&
+	    (new_crtc_state->planes_changed || drm_atomic_crtc_needs_modeset(new_crtc_state)))
+		return vop2_crtc_bandwidth_admission(crtc, new_crtc_state, state);
+
+	return 0;
+}
+
+static void vop3_disable_dynamic_hdr(struct vop2_video_port *vp, uint8_t win_phys_id)
+{
+	struct vop2 *vop2 = vp->vop2;
+	struct vop2_win *win = vop2_find_win_by_phys_id(vop2, win_phys_id);
+	struct drm_plane *plane = &win->base;
+	struct drm_plane_state *pstate = plane->state;
 	struct vop2_plane_state *vpstate = to_vop2_plane_state(pstate);
 
 	VOP_MODULE_SET(vop2, vp, hdr10_en, 0);
@@ -10916,14 +11958,8 @@ static void rk3588_vop2_setup_hdr10_splice_layer_mixer(struct drm_crtc *crtc,
 						       struct vop2_zpos *vop2_zpos_splice)
 {
 	int zpos_id, i;
-	struct vop2_zpos *vop2_zpos_splice_hdr;
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
-	struct vop2 *vop2 = vp->vop2;
-
-	vop2_zpos_splice_hdr = kmalloc_array(vop2->data->win_size, sizeof(*vop2_zpos),
-					 GFP_KERNEL);
-	if (!vop2_zpos_splice_hdr)
-		goto out;
+	struct vop2_zpos *vop2_zpos_splice_hdr = vp->zpos_splice_hdr_pool;
 
 	zpos_id = 0;
 	vop2_zpos_splice_hdr[zpos_id].zpos = zpos_id;
@@ -10949,9 +11985,69 @@ static void rk3588_vop2_setup_hdr10_splice_layer_mixer(struct drm_crtc *crtc,
 		vop2_zpos_splice_hdr[zpos_id].plane = vop2_zpos_splice[i].plane;
 	}
 	vop2_setup_layer_mixer_for_vp(vp, vop2_zpos_splice_hdr);
+}
 
-out:
-	kfree(vop2_zpos_splice_hdr);
+/*
+ * Late latch vrr: the vtotal is stretched up to the min refresh rate at
+ * every frame start, and cut back to the current line (but never below the
+ * max refresh rate) when a new commit is flushed. The frame then ends right
+ * after the flip instead of at a fixed cadence. The dsc vtotal can't follow
+ * the per frame change, so it's only supported without dsc.
+ */
+static bool vop2_crtc_setup_vrr_late_latch(struct drm_crtc *crtc)
+{
+	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(crtc->state);
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	struct drm_display_mode *adjust_mode = &crtc->state->adjusted_mode;
+	unsigned int vrefresh = drm_mode_vrefresh(adjust_mode);
+	unsigned long flags;
+
+	if (!vcstate->vrr_late_latch || vcstate->dsc_enable || vcstate->splice_mode ||
+	    vcstate->min_refresh_rate > vcstate->max_refresh_rate || !adjust_mode->crtc_clock) {
+		WRITE_ONCE(vp->vrr_late_latch, false);
+		return false;
+	}
+
+	spin_lock_irqsave(&vop2->irq_lock, flags);
+	vp->vrr_min_vtotal = adjust_mode->vtotal * vrefresh / vcstate->max_refresh_rate;
+	vp->vrr_max_vtotal = adjust_mode->vtotal * vrefresh / vcstate->min_refresh_rate;
+	vp->vrr_line_ns = div_u64((u64)adjust_mode->crtc_htotal * 1000000, adjust_mode->crtc_clock);
+	vp->vrr_frame_start = ktime_get();
+	vp->vrr_late_latch = true;
+	VOP_MODULE_SET(vop2, vp, dsp_vtotal, vp->vrr_max_vtotal);
+	spin_unlock_irqrestore(&vop2->irq_lock, flags);
+
+	rockchip_connector_update_vfp_for_vrr(crtc, adjust_mode,
+					      adjust_mode->vsync_start - adjust_mode->vdisplay +
+					      vp->vrr_max_vtotal - adjust_mode->vtotal);
+
+	return true;
+}
+
+/* called with irq_lock held, right after the cfg_done of a new commit */
+static void vop2_crtc_vrr_late_latch_kick(struct vop2_video_port *vp)
+{
+	struct vop2 *vop2 = vp->vop2;
+	u64 elapsed;
+	u32 line, vtotal;
+
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), vp->vrr_frame_start));
+	line = div_u64(elapsed, vp->vrr_line_ns);
+	vtotal = max_t(u32, line + VOP2_VRR_LATE_LATCH_MARGIN, vp->vrr_min_vtotal);
+	if (vtotal < vp->vrr_max_vtotal)
+		VOP_MODULE_SET(vop2, vp, dsp_vtotal, vtotal);
+}
+
+/* frame start of a late latch frame, stretch the front porch again */
+static void vop2_crtc_vrr_late_latch_restart(struct vop2_video_port *vp)
+{
+	struct vop2 *vop2 = vp->vop2;
+
+	spin_lock(&vop2->irq_lock);
+	vp->vrr_frame_start = ktime_get();
+	VOP_MODULE_SET(vop2, vp, dsp_vtotal, vp->vrr_max_vtotal);
+	spin_unlock(&vop2->irq_lock);
 }
 
 static void vop2_crtc_update_vrr(struct drm_crtc *crtc)
@@ -10970,6 +12066,9 @@ static void vop2_crtc_update_vrr(struct drm_crtc *crtc)
 	if (!vcstate->min_refresh_rate || !vcstate->max_refresh_rate)
 		return;
 
+	if (vop2_crtc_setup_vrr_late_latch(crtc))
+		return;
+
 	if (vcstate->request_refresh_rate < vcstate->min_refresh_rate ||
 	    vcstate->request_refresh_rate > vcstate->max_refresh_rate) {
 		DRM_ERROR("invalid rate:%d\n", vcstate->request_refresh_rate);
@@ -11026,6 +12125,97 @@ static bool post_sharp_enabled(struct drm_crtc *crtc)
 	return true;
 }
 
+/*
+ * A plane update is address only when the new fb has the same layout as
+ * the old one and everything else derived in atomic_check is unchanged.
+ */
+static bool vop2_plane_addr_only_update(struct drm_plane_state *old_pstate,
+					struct drm_plane_state *new_pstate)
+{
+	struct vop2_plane_state *old_vpstate = to_vop2_plane_state(old_pstate);
+	struct vop2_plane_state *vpstate = to_vop2_plane_state(new_pstate);
+	struct drm_framebuffer *old_fb = old_pstate->fb;
+	struct drm_framebuffer *fb = new_pstate->fb;
+
+	if (!old_pstate->visible || !new_pstate->visible || !old_fb || !fb)
+		return false;
+
+	if (old_pstate->crtc != new_pstate->crtc)
+		return false;
+
+	if (old_fb->format != fb->format || old_fb->modifier != fb->modifier ||
+	    memcmp(old_fb->pitches, fb->pitches, sizeof(fb->pitches)))
+		return false;
+
+	if (old_pstate->rotation != new_pstate->rotation ||
+	    old_pstate->alpha != new_pstate->alpha ||
+	    old_pstate->pixel_blend_mode != new_pstate->pixel_blend_mode ||
+	    old_pstate->color_encoding != new_pstate->color_encoding ||
+	    old_pstate->color_range != new_pstate->color_range)
+		return false;
+
+	if (!drm_rect_equals(&old_vpstate->src, &vpstate->src) ||
+	    !drm_rect_equals(&old_vpstate->dest, &vpstate->dest))
+		return false;
+
+	/* dci is configured along with the window, take the full path */
+	if (vpstate->dci_data || old_vpstate->dci_data)
+		return false;
+
+	return old_vpstate->zpos == vpstate->zpos &&
+	       old_vpstate->afbc_en == vpstate->afbc_en &&
+	       old_vpstate->tiled_en == vpstate->tiled_en &&
+	       old_vpstate->hdr_in == vpstate->hdr_in &&
+	       old_vpstate->hdr2sdr_en == vpstate->hdr2sdr_en &&
+	       old_vpstate->eotf == vpstate->eotf &&
+	       old_vpstate->global_alpha == vpstate->global_alpha &&
+	       old_vpstate->blend_mode == vpstate->blend_mode &&
+	       old_vpstate->color_key == vpstate->color_key &&
+	       old_vpstate->xmirror_en == vpstate->xmirror_en &&
+	       old_vpstate->ymirror_en == vpstate->ymirror_en &&
+	       old_vpstate->rotate_90_en == vpstate->rotate_90_en &&
+	       old_vpstate->rotate_270_en == vpstate->rotate_270_en;
+}
+
+/*
+ * Detect a commit which only flips new framebuffers onto the windows
+ * already configured on this vp, the overlay, scale and csc setup of
+ * last commit is still valid and can be skipped.
+ */
+static bool vop2_crtc_addr_only_flip(struct drm_crtc *crtc, struct drm_atomic_state *state)
+{
+	struct drm_crtc_state *old_cstate = drm_atomic_get_old_crtc_state(state, crtc);
+	struct drm_crtc_state *new_cstate = drm_atomic_get_new_crtc_state(state, crtc);
+	struct rockchip_crtc_state *old_vcstate = to_rockchip_crtc_state(old_cstate);
+	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(new_cstate);
+	struct drm_plane_state *old_pstate, *new_pstate;
+	struct drm_plane *plane;
+	int i;
+
+	/* the debug dump collects the plane list in the full update path */
+	if (IS_ENABLED(CONFIG_ROCKCHIP_DRM_DEBUG))
+		return false;
+
+	if (!new_cstate->active || drm_atomic_crtc_needs_modeset(new_cstate) ||
+	    new_cstate->color_mgmt_changed || !new_cstate->planes_changed ||
+	    new_cstate->plane_mask != old_cstate->plane_mask)
+		return false;
+
+	if (vcstate->splice_mode || vcstate->mode_update ||
+	    vcstate->yuv_overlay != old_vcstate->yuv_overlay)
+		return false;
+
+	for_each_oldnew_plane_in_state(state, plane, old_pstate, new_pstate, i) {
+		if (old_pstate->crtc != crtc && new_pstate->crtc != crtc)
+			continue;
+
+		if (!vop2_plane_addr_only_update(old_pstate, new_pstate))
+			return false;
+	}
+
+	return true;
+}
+
 static void vop2_crtc_atomic_begin(struct drm_crtc *crtc, struct drm_atomic_state *state)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
@@ -11048,16 +12238,18 @@ static void vop2_crtc_atomic_begin(struct drm_crtc *crtc, struct drm_atomic_stat
 		vcstate->yuv_overlay = true;
 	else
 		vcstate->yuv_overlay = is_yuv_output(vcstate->bus_format);
-	vop2_zpos = kmalloc_array(vop2->data->win_size, sizeof(*vop2_zpos), GFP_KERNEL);
-	if (!vop2_zpos)
+
+	vp->addr_only_flip = vop2_crtc_addr_only_flip(crtc, state);
+	if (vp->addr_only_flip) {
+		if (vop2->version == VOP_VERSION_RK3588)
+			vop2_crtc_update_vrr(crtc);
 		return;
-	if (vcstate->splice_mode) {
-		vop2_zpos_splice = kmalloc_array(vop2->data->win_size, sizeof(*vop2_zpos),
-						 GFP_KERNEL);
-		if (!vop2_zpos_splice)
-			goto out;
 	}
 
+	vop2_zpos = vp->zpos_pool;
+	if (vcstate->splice_mode)
+		vop2_zpos_splice = vp->zpos_splice_pool;
+
 	if (vop2->version == VOP_VERSION_RK3588)
 		vop2_crtc_update_vrr(crtc);
 
@@ -11219,11 +12411,6 @@ static void vop2_crtc_atomic_begin(struct drm_crtc *crtc, struct drm_atomic_stat
 			vop2_setup_cluster_alpha(vop2, &cluster);
 		}
 	}
-
-	if (vcstate->splice_mode)
-		kfree(vop2_zpos_splice);
-out:
-	kfree(vop2_zpos);
 }
 
 static void vop2_bcsh_reg_update(struct rockchip_crtc_state *vcstate,
@@ -11356,7 +12543,8 @@ static void vop3_post_csc_config(struct drm_crtc *crtc, struct post_acm *acm, st
 	struct drm_plane *plane;
 	struct drm_plane_state *pstate;
 	struct post_csc_coef csc_coef;
-	struct post_csc_convert_mode convert_mode;
+	struct post_csc_convert_mode convert_mode = { 0 };
+	struct vop2_post_csc_cache cache = { 0 };
 	bool acm_enable;
 	bool post_r2y_en = false;
 	bool post_csc_en = false;
@@ -11423,6 +12611,23 @@ static void vop3_post_csc_config(struct drm_crtc *crtc, struct post_acm *acm, st
 			convert_mode.color_encoding = pstate->color_encoding;
 		else
 			convert_mode.color_encoding = vcstate->color_encoding;
+	}
+
+	/*
+	 * The csc registers are latched at vblank with the rest of the vp,
+	 * leave them alone when neither the parameters nor what they are
+	 * derived from have changed since the last commit.
+	 */
+	cache.convert_mode = convert_mode;
+	cache.r2y_en = post_r2y_en;
+	cache.csc_en = post_csc_en;
+	cache.csc_mode = vcstate->post_csc_mode;
+	if (!(vp->post_dirty & VOP2_POST_CSC_DIRTY) &&
+	    !memcmp(&cache, &vp->post_csc_cache, sizeof(cache)))
+		return;
+	vp->post_csc_cache = cache;
+
+	if (post_csc_en) {
 		rockchip_calc_post_csc(csc, &csc_coef, &convert_mode);
 
 		VOP_MODULE_SET(vop2, vp, csc_coe00, csc_coef.csc_coef00);
@@ -11459,20 +12664,38 @@ static void vop3_post_acm_config(struct drm_crtc *crtc, struct post_acm *acm)
 	u32 value;
 	int i;
 
-	writel(0, vop2->acm_regs + RK3528_ACM_CTRL);
-	VOP_MODULE_SET(vop2, vp, acm_bypass_en, 0);
-
-	if (!acm || !acm->acm_enable)
+	if (!acm || !acm->acm_enable) {
+		writel(0, vop2->acm_regs + RK3528_ACM_CTRL);
+		VOP_MODULE_SET(vop2, vp, acm_bypass_en, 0);
+		vp->acm_update_pending = false;
 		return;
+	}
 
 	if (vop2->version == VOP_VERSION_RK3528) {
 		/*
 		 * If acm update parameters, it need disable acm in the first frame,
-		 * then update parameters and enable acm in second frame.
+		 * then update parameters and enable acm in second frame. Don't
+		 * stall this commit a frame for it: disable acm here and load the
+		 * parameters in the next commit, which is the next flip when
+		 * userspace tunes per frame, or made by acm_update_work.
 		 */
-		vop2_cfg_done(crtc);
-		readx_poll_timeout(readl, vop2->acm_regs + RK3528_ACM_CTRL, value, !value,
-				   200, 50000);
+		value = readl(vop2->acm_regs + RK3528_ACM_CTRL);
+		if (!vp->acm_update_pending && (value & RK3528_ACM_ENABLE)) {
+			writel(0, vop2->acm_regs + RK3528_ACM_CTRL);
+			VOP_MODULE_SET(vop2, vp, acm_bypass_en, 0);
+			vp->acm_update_pending = true;
+			queue_work(system_unbound_wq, &vp->acm_update_work);
+			return;
+		}
+
+		/* the disable is latched by a vblank between the two commits */
+		if (value && readx_poll_timeout(readl, vop2->acm_regs + RK3528_ACM_CTRL,
+						value, !value, 200, 50000))
+			DRM_DEV_ERROR(vop2->dev, "vp%d wait acm disable timeout\n", vp->id);
+		vp->acm_update_pending = false;
+	} else {
+		writel(0, vop2->acm_regs + RK3528_ACM_CTRL);
+		VOP_MODULE_SET(vop2, vp, acm_bypass_en, 0);
 	}
 
 	value = RK3528_ACM_ENABLE + ((adjusted_mode->hdisplay & 0xfff) << 8) +
@@ -11524,6 +12747,10 @@ static void vop2_post_sharp_config(struct drm_crtc *crtc)
 	struct post_sharp *post_sharp;
 	int i;
 
+	/* the registers keep the last setting, sharp_en is carried in the state */
+	if (!(vp->post_dirty & VOP2_POST_SHARP_DIRTY))
+		return;
+
 	/* sharp work in yuv color space, if it is rgb overlay sharp shouldn't be enabled */
 	if (!vcstate->yuv_overlay || !post_sharp_enabled(crtc)) {
 		/*
@@ -11544,6 +12771,75 @@ static void vop2_post_sharp_config(struct drm_crtc *crtc)
 	vcstate->sharp_en = true;
 }
 
+static void vop2_crtc_update_post_dirty(struct drm_crtc *crtc,
+					struct drm_crtc_state *old_crtc_state)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(crtc->state);
+	struct rockchip_crtc_state *old_vcstate = to_rockchip_crtc_state(old_crtc_state);
+	u32 dirty = 0;
+
+	if (crtc->state->active_changed || drm_atomic_crtc_needs_modeset(crtc->state)) {
+		vp->post_dirty = VOP2_POST_CSC_DIRTY | VOP2_POST_ACM_DIRTY | VOP2_POST_SHARP_DIRTY;
+		return;
+	}
+
+	/* acm_state_changed is worked out along with acm_info in atomic check */
+	if (vp->acm_state_changed)
+		dirty |= VOP2_POST_ACM_DIRTY | VOP2_POST_CSC_DIRTY;
+
+	if (vop2_blob_changed(vcstate->post_csc_data, old_vcstate->post_csc_data))
+		dirty |= VOP2_POST_CSC_DIRTY;
+
+	if (vop2_blob_changed(vcstate->post_sharp_data, old_vcstate->post_sharp_data) ||
+	    vcstate->yuv_overlay != old_vcstate->yuv_overlay ||
+	    vcstate->left_margin != old_vcstate->left_margin ||
+	    vcstate->right_margin != old_vcstate->right_margin ||
+	    vcstate->top_margin != old_vcstate->top_margin ||
+	    vcstate->bottom_margin != old_vcstate->bottom_margin)
+		dirty |= VOP2_POST_SHARP_DIRTY;
+
+	vp->post_dirty = dirty;
+}
+
+/*
+ * Commit nothing but the crtc, so that the acm parameters held back by
+ * vop3_post_acm_config() are loaded when userspace doesn't flip again.
+ */
+static void vop2_acm_update_work(struct work_struct *work)
+{
+	struct vop2_video_port *vp = container_of(work, struct vop2_video_port, acm_update_work);
+	struct drm_crtc *crtc = &vp->rockchip_crtc.crtc;
+	struct drm_modeset_acquire_ctx ctx;
+	struct drm_atomic_state *state;
+	struct drm_crtc_state *crtc_state;
+	int ret;
+
+	DRM_MODESET_LOCK_ALL_BEGIN(crtc->dev, ctx, 0, ret);
+
+	if (!READ_ONCE(vp->acm_update_pending) || !crtc->state->active)
+		goto out;
+
+	state = drm_atomic_state_alloc(crtc->dev);
+	if (!state) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	state->acquire_ctx = &ctx;
+	crtc_state = drm_atomic_get_crtc_state(state, crtc);
+	if (IS_ERR(crtc_state))
+		ret = PTR_ERR(crtc_state);
+	else
+		ret = drm_atomic_commit(state);
+	drm_atomic_state_put(state);
+out:
+	DRM_MODESET_LOCK_ALL_END(crtc->dev, ctx, ret);
+
+	if (ret)
+		DRM_DEV_ERROR(vp->vop2->dev, "vp%d failed to commit acm update: %d\n", vp->id, ret);
+}
+
 static void vop2_cfg_update(struct drm_crtc *crtc,
 			    struct drm_crtc_state *old_crtc_state)
 {
@@ -11556,6 +12852,8 @@ static void vop2_cfg_update(struct drm_crtc *crtc,
 	uint32_t val;
 	uint32_t r, g, b;
 
+	vop2_crtc_update_post_dirty(crtc, old_crtc_state);
+
 	spin_lock(&vop2->reg_lock);
 
 	vop2_post_color_swap(crtc);
@@ -11601,7 +12899,8 @@ static void vop2_cfg_update(struct drm_crtc *crtc,
 		vop3_post_csc_config(crtc, &vp->acm_info,
 				     vp->csc_info.csc_enable ? &vp->csc_info : NULL);
 
-	if ((vp_data->feature & VOP_FEATURE_POST_ACM) && vp->acm_state_changed)
+	if ((vp_data->feature & VOP_FEATURE_POST_ACM) &&
+	    ((vp->post_dirty & VOP2_POST_ACM_DIRTY) || vp->acm_update_pending))
 		vop3_post_acm_config(crtc, &vp->acm_info);
 
 }
@@ -11672,19 +12971,225 @@ static void vop2_wait_for_scan_timing_from_the_assigned_line(struct vop2_video_p
 			      wait_line, vcnt, ret);
 }
 
+/*
+ * The part of the flush that must be done right after cfg_done, with
+ * vop2->irq_lock held.
+ */
+static void vop2_crtc_flush_latched(struct drm_crtc *crtc)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+
+	vp->addr_only_flip = false;
+
+	if (vp->vrr_late_latch)
+		vop2_crtc_vrr_late_latch_kick(vp);
+
+	if (vp->mcu_timing.mcu_pix_total)
+		VOP_MODULE_SET(vop2, vp, mcu_hold_mode, 0);
+}
+
+static void vop2_crtc_flush_finish(struct drm_crtc *crtc, struct drm_atomic_state *state)
+{
+	struct drm_crtc_state *old_cstate = drm_atomic_get_old_crtc_state(state, crtc);
+	struct drm_atomic_state *old_state = old_cstate->state;
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	struct drm_plane_state *old_pstate;
+	struct drm_plane *plane;
+	unsigned long flags;
+	int i;
+
+	/*
+	 * There is a (rather unlikely) possibility that a vblank interrupt
+	 * fired before we set the cfg_done bit. To avoid spuriously
+	 * signalling flip completion we need to wait for it to finish.
+	 */
+	vop2_wait_for_irq_handler(crtc);
+
+	/**
+	 * move here is to make sure current fs call function is complete,
+	 * so when layer_sel_update is true, we can skip current vblank correctly.
+	 */
+	vp->layer_sel_update = false;
+
+	spin_lock_irqsave(&crtc->dev->event_lock, flags);
+	if (crtc->state->event) {
+		WARN_ON(drm_crtc_vblank_get(crtc) != 0);
+		WARN_ON(vp->event);
+
+		vp->event = crtc->state->event;
+		crtc->state->event = NULL;
+	}
+	spin_unlock_irqrestore(&crtc->dev->event_lock, flags);
+
+	for_each_old_plane_in_state(old_state, plane, old_pstate, i) {
+		if (!old_pstate->fb)
+			continue;
+
+		if (old_pstate->fb == plane->state->fb)
+			continue;
+		if (!vop2->skip_ref_fb)
+			drm_framebuffer_get(old_pstate->fb);
+		WARN_ON(drm_crtc_vblank_get(crtc) != 0);
+		drm_flip_work_queue(&vp->fb_unref_work, old_pstate->fb);
+		set_bit(VOP_PENDING_FB_UNREF, &vp->pending);
+	}
+
+	vp->pixel_shift.crtc_update_count++;
+}
+
+/*
+ * Genlock
+ *
+ * The vps of a vop with the genlock property set are flushed as a group:
+ * the commit of every member is written out first and then latched with a
+ * single cfg_done write, so all of them take the new frame at the same
+ * vsync. A member that is enabled in the commit is kept in standby by
+ * vop2_crtc_atomic_enable() and released here together with the others,
+ * aligned to the frame start of the members that are already running.
+ * Releasing standby starts the scanout at once, so back to back register
+ * writes bring the vps within a few bus cycles of each other, and with
+ * dclks from the same pll they stay there.
+ *
+ * The genlock property only takes effect when the crtc is enabled.
+ */
+static u32 vop2_genlock_commit_mask(struct drm_crtc *crtc, struct drm_atomic_state *state,
+				    struct drm_crtc **last)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct vop2 *vop2 = vp->vop2;
+	u32 mask = 0;
+	int i;
+
+	if (!vp->genlock)
+		return 0;
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		struct vop2_video_port *member = &vop2->vps[i];
+		struct drm_crtc *loop = &member->rockchip_crtc.crtc;
+		struct drm_crtc_state *cstate;
+
+		if (!loop->dev || !member->genlock)
+			continue;
+		cstate = drm_atomic_get_new_crtc_state(state, loop);
+		if (!cstate || !cstate->active)
+			continue;
+
+		mask |= BIT(member->id);
+		*last = loop;
+	}
+
+	return mask;
+}
+
+static struct vop2_video_port *vop2_genlock_ref_vp(struct vop2 *vop2)
+{
+	int i;
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		struct vop2_video_port *vp = &vop2->vps[i];
+
+		if (vp->genlock && !vp->genlock_start_pending &&
+		    !VOP_MODULE_GET(vop2, vp, standby))
+			return vp;
+	}
+
+	return NULL;
+}
+
+static void vop2_genlock_start(struct vop2 *vop2)
+{
+	struct vop2_video_port *ref_vp = vop2_genlock_ref_vp(vop2);
+	unsigned long flags;
+	u32 vcnt, last_vcnt;
+	int i;
+
+	if (ref_vp) {
+		u16 vtotal = VOP_MODULE_GET(vop2, ref_vp, dsp_vtotal);
+
+		/* sleep to the last lines of the frame, then spin to its end */
+		vcnt = vop2_read_vcnt(ref_vp);
+		if (vcnt + VOP2_GENLOCK_SPIN_LINES < vtotal)
+			vop2_sleep_scan_line_time(ref_vp, vtotal - VOP2_GENLOCK_SPIN_LINES - vcnt);
+	}
+
+	local_irq_save(flags);
+	if (ref_vp) {
+		ktime_t timeout = ktime_add_us(ktime_get(), VOP2_GENLOCK_SPIN_TIMEOUT_US);
+
+		/* the line counter wraps at the frame start */
+		last_vcnt = vop2_read_vcnt(ref_vp);
+		while ((vcnt = vop2_read_vcnt(ref_vp)) >= last_vcnt) {
+			last_vcnt = vcnt;
+			if (ktime_after(ktime_get(), timeout)) {
+				DRM_DEV_ERROR(vop2->dev, "genlock: vp%d frame start timeout\n",
+					      ref_vp->id);
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < vop2->data->nr_vps; i++) {
+		struct vop2_video_port *vp = &vop2->vps[i];
+
+		if (vp->genlock_start_pending)
+			VOP_MODULE_SET(vop2, vp, standby, 0);
+	}
+	local_irq_restore(flags);
+
+	for (i = 0; i < vop2->data->nr_vps; i++)
+		vop2->vps[i].genlock_start_pending = false;
+}
+
+static void vop2_genlock_flush(struct vop2 *vop2, struct drm_atomic_state *state, u32 mask)
+{
+	struct drm_crtc *crtc;
+	unsigned long flags;
+	unsigned long bits = mask;
+	u32 val = 0;
+	int id;
+
+	spin_lock_irqsave(&vop2->irq_lock, flags);
+	for_each_set_bit(id, &bits, ROCKCHIP_MAX_CRTC) {
+		struct vop2_video_port *vp = &vop2->vps[id];
+		struct rockchip_crtc_state *vcstate;
+		const struct vop2_video_port_data *vp_data = &vop2->data->vp[id];
+
+		crtc = &vp->rockchip_crtc.crtc;
+		vcstate = to_rockchip_crtc_state(crtc->state);
+		vop2_wb_commit(crtc);
+		val |= BIT(id);
+		if (vcstate->splice_mode)
+			val |= BIT(vp_data->splice_vp_id);
+	}
+
+	val = RK3568_VOP2_GLB_CFG_DONE_EN | val | (val << 16);
+	rockchip_drm_dbg(vop2->dev, VOP_DEBUG_CFG_DONE, "genlock cfg_done: 0x%x\n\n", val);
+	vop2_writel(vop2, 0, val);
+
+	for_each_set_bit(id, &bits, ROCKCHIP_MAX_CRTC)
+		vop2_crtc_flush_latched(&vop2->vps[id].rockchip_crtc.crtc);
+	spin_unlock_irqrestore(&vop2->irq_lock, flags);
+
+	vop2_genlock_start(vop2);
+
+	for_each_set_bit(id, &bits, ROCKCHIP_MAX_CRTC)
+		vop2_crtc_flush_finish(&vop2->vps[id].rockchip_crtc.crtc, state);
+}
+
 static void vop2_crtc_atomic_flush(struct drm_crtc *crtc, struct drm_atomic_state *state)
 {
 	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(crtc->state);
 	struct drm_crtc_state *old_cstate = drm_atomic_get_old_crtc_state(state, crtc);
-	struct drm_atomic_state *old_state = old_cstate->state;
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
 	struct vop2 *vop2 = vp->vop2;
 	const struct vop2_data *vop2_data = vop2->data;
 	const struct vop2_video_port_data *vp_data = &vop2_data->vp[vp->id];
-	struct drm_plane_state *old_pstate;
-	struct drm_plane *plane;
+	struct drm_crtc *genlock_last = NULL;
 	unsigned long flags;
-	int i, ret;
+	u32 genlock_mask;
+	int ret;
 	struct vop2_wb *wb = &vop2->wb;
 	struct drm_writeback_connector *wb_conn = &wb->conn;
 	struct drm_connector_state *conn_state = wb_conn->base.state;
@@ -11737,16 +13242,28 @@ static void vop2_crtc_atomic_flush(struct drm_crtc *crtc, struct drm_atomic_stat
 	}
 
 
+	/*
+	 * color_mgmt_changed is set when any of the color blobs is replaced,
+	 * only upload the luts whose blob really changed.
+	 */
 	if (crtc->state->color_mgmt_changed || crtc->state->active_changed) {
-		if (crtc->state->gamma_lut || vp->gamma_lut) {
+		struct rockchip_crtc_state *old_vcstate = to_rockchip_crtc_state(old_cstate);
+		bool gamma_changed = crtc->state->active_changed ||
+				     crtc->state->gamma_lut != old_cstate->gamma_lut;
+		bool cubic_lut_changed = crtc->state->active_changed ||
+					 vcstate->cubic_lut_data != old_vcstate->cubic_lut_data;
+
+		if ((crtc->state->gamma_lut || vp->gamma_lut) && gamma_changed) {
 			if (crtc->state->gamma_lut)
 				vp->gamma_lut = crtc->state->gamma_lut->data;
 			vop2_crtc_atomic_gamma_set(crtc, crtc->state);
 		}
-		if (vcstate->cubic_lut_data || vp->cubic_lut) {
+		if ((vcstate->cubic_lut_data || vp->cubic_lut) && cubic_lut_changed) {
 			if (vcstate->cubic_lut_data)
 				vp->cubic_lut = vcstate->cubic_lut_data->data;
 			vop2_crtc_atomic_cubic_lut_set(crtc, crtc->state);
+		} else {
+			VOP_MODULE_SET(vop2, vp, cubic_lut_update_en, 0);
 		}
 	} else {
 		VOP_MODULE_SET(vop2, vp, cubic_lut_update_en, 0);
@@ -11760,52 +13277,28 @@ static void vop2_crtc_atomic_flush(struct drm_crtc *crtc, struct drm_atomic_stat
 	else
 		vop2_crtc_disable_line_flag_event(crtc);
 
-	spin_lock_irqsave(&vop2->irq_lock, flags);
-	vop2_wb_commit(crtc);
-	vop2_cfg_done(crtc);
-
-	if (vp->mcu_timing.mcu_pix_total)
-		VOP_MODULE_SET(vop2, vp, mcu_hold_mode, 0);
-
-	spin_unlock_irqrestore(&vop2->irq_lock, flags);
-
 	/*
-	 * There is a (rather unlikely) possibility that a vblank interrupt
-	 * fired before we set the cfg_done bit. To avoid spuriously
-	 * signalling flip completion we need to wait for it to finish.
+	 * A commit with nothing visible changed and nobody waiting for its
+	 * completion is not worth a new transfer to a hold mode panel.
 	 */
-	vop2_wait_for_irq_handler(crtc);
-
-	/**
-	 * move here is to make sure current fs call function is complete,
-	 * so when layer_sel_update is true, we can skip current vblank correctly.
-	 */
-	vp->layer_sel_update = false;
-
-	spin_lock_irqsave(&crtc->dev->event_lock, flags);
-	if (crtc->state->event) {
-		WARN_ON(drm_crtc_vblank_get(crtc) != 0);
-		WARN_ON(vp->event);
-
-		vp->event = crtc->state->event;
-		crtc->state->event = NULL;
+	if (drm_rect_visible(&vcstate->damage) || crtc->state->event)
+		WRITE_ONCE(vp->hold_frame_dirty, true);
+
+	genlock_mask = vop2_genlock_commit_mask(crtc, state, &genlock_last);
+	if (genlock_mask) {
+		/* the last member of the group flushes all of them */
+		if (crtc == genlock_last)
+			vop2_genlock_flush(vop2, state, genlock_mask);
+		return;
 	}
-	spin_unlock_irqrestore(&crtc->dev->event_lock, flags);
-
-	for_each_old_plane_in_state(old_state, plane, old_pstate, i) {
-		if (!old_pstate->fb)
-			continue;
 
-		if (old_pstate->fb == plane->state->fb)
-			continue;
-		if (!vop2->skip_ref_fb)
-			drm_framebuffer_get(old_pstate->fb);
-		WARN_ON(drm_crtc_vblank_get(crtc) != 0);
-		drm_flip_work_queue(&vp->fb_unref_work, old_pstate->fb);
-		set_bit(VOP_PENDING_FB_UNREF, &vp->pending);
-	}
+	spin_lock_irqsave(&vop2->irq_lock, flags);
+	vop2_wb_commit(crtc);
+	vop2_cfg_done(crtc);
+	vop2_crtc_flush_latched(crtc);
+	spin_unlock_irqrestore(&vop2->irq_lock, flags);
 
-	vp->pixel_shift.crtc_update_count++;
+	vop2_crtc_flush_finish(crtc, state);
 }
 
 static const struct drm_crtc_helper_funcs vop2_crtc_helper_funcs = {
@@ -11874,11 +13367,8 @@ static struct drm_crtc_state *vop2_crtc_duplicate_state(struct drm_crtc *crtc)
 	return &vcstate->base;
 }
 
-static void vop2_crtc_destroy_state(struct drm_crtc *crtc,
-				    struct drm_crtc_state *state)
+static void vop2_crtc_state_free(struct rockchip_crtc_state *vcstate)
 {
-	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(state);
-
 	__drm_atomic_helper_crtc_destroy_state(&vcstate->base);
 	drm_property_blob_put(vcstate->hdr_ext_data);
 	drm_property_blob_put(vcstate->acm_lut_data);
@@ -11888,6 +13378,38 @@ static void vop2_crtc_destroy_state(struct drm_crtc *crtc,
 	kfree(vcstate);
 }
 
+static void vop2_crtc_destroy_state(struct drm_crtc *crtc,
+				    struct drm_crtc_state *state)
+{
+	struct rockchip_crtc_state *vcstate = to_rockchip_crtc_state(state);
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+
+	/* see vop2_atomic_plane_destroy_state() */
+	if (state->state) {
+		llist_add(&vcstate->reclaim_node, &vp->crtc_reclaim_list);
+		queue_work(system_unbound_wq, &vp->reclaim_work);
+		return;
+	}
+
+	vop2_crtc_state_free(vcstate);
+}
+
+static void vop2_reclaim_worker(struct work_struct *work)
+{
+	struct vop2_video_port *vp = container_of(work, struct vop2_video_port, reclaim_work);
+	struct rockchip_crtc_state *vcstate, *next_vcstate;
+	struct vop2_plane_state *vpstate, *next_vpstate;
+	struct llist_node *node;
+
+	node = llist_del_all(&vp->plane_reclaim_list);
+	llist_for_each_entry_safe(vpstate, next_vpstate, node, reclaim_node)
+		vop2_plane_state_free(vpstate);
+
+	node = llist_del_all(&vp->crtc_reclaim_list);
+	llist_for_each_entry_safe(vcstate, next_vcstate, node, reclaim_node)
+		vop2_crtc_state_free(vcstate);
+}
+
 static __maybe_unused struct drm_connector *vop2_get_edp_connector(struct vop2 *vop2)
 {
 	struct drm_connector *connector;
@@ -12050,6 +13572,16 @@ static int vop2_crtc_atomic_get_property(struct drm_crtc *crtc,
 		return 0;
 	}
 
+	if (property == vp->vrr_late_latch_prop) {
+		*val = vcstate->vrr_late_latch;
+		return 0;
+	}
+
+	if (property == vp->genlock_prop) {
+		*val = vcstate->genlock;
+		return 0;
+	}
+
 	if (property == vp->hdr_ext_data_prop) {
 		*val = vcstate->hdr_ext_data ? vcstate->hdr_ext_data->base.id : 0;
 		return 0;
@@ -12155,6 +13687,16 @@ static int vop2_crtc_atomic_set_property(struct drm_crtc *crtc,
 		return 0;
 	}
 
+	if (property == vp->vrr_late_latch_prop) {
+		vcstate->vrr_late_latch = val;
+		return 0;
+	}
+
+	if (property == vp->genlock_prop) {
+		vcstate->genlock = val;
+		return 0;
+	}
+
 	if (property == vp->hdr_ext_data_prop) {
 		ret = vop2_atomic_replace_property_blob_from_id(drm_dev,
 								&vcstate->hdr_ext_data,
@@ -12303,6 +13845,141 @@ static void vop2_wb_disable(struct vop2_video_port *vp)
 	vop2_wb_cfg_done(vp);
 }
 
+static const char *vop2_wb_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "rockchip-drm";
+}
+
+static const char *vop2_wb_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "vop2-wb-stream";
+}
+
+static const struct dma_fence_ops vop2_wb_fence_ops = {
+	.get_driver_name = vop2_wb_fence_get_driver_name,
+	.get_timeline_name = vop2_wb_fence_get_timeline_name,
+};
+
+static void vop2_wb_stream_program(struct vop2_video_port *vp, struct vop2_wb_slot *slot)
+{
+	struct vop2 *vop2 = vp->vop2;
+	struct vop2_wb *wb = &vop2->wb;
+	struct vop2_wb_stream *stream = &wb->stream;
+
+	VOP_MODULE_SET(vop2, wb, vp_id, stream->vp_id);
+	VOP_MODULE_SET(vop2, wb, format, stream->format);
+	VOP_MODULE_SET(vop2, wb, yrgb_mst, slot->yrgb_addr);
+	VOP_MODULE_SET(vop2, wb, uv_mst, slot->uv_addr);
+	VOP_MODULE_SET(vop2, wb, fifo_throd, stream->fifo_throd);
+	VOP_MODULE_SET(vop2, wb, scale_x_factor, stream->scale_x_factor);
+	VOP_MODULE_SET(vop2, wb, scale_x_en, stream->scale_x_en);
+	VOP_MODULE_SET(vop2, wb, scale_y_en, stream->scale_y_en);
+	VOP_MODULE_SET(vop2, wb, r2y_en, stream->r2y);
+
+	/*
+	 * Keep the write back running across frames, the destination
+	 * is switched by the next cfg_done, so no oneshot mode here.
+	 */
+	if (is_vop3(vop2) && vop2->version != VOP_VERSION_RK3528 &&
+	    vop2->version != VOP_VERSION_RK3562) {
+		VOP_MODULE_SET(vop2, wb, act_width, stream->act_width);
+		VOP_MODULE_SET(vop2, wb, vir_stride, stream->vir_stride);
+		VOP_MODULE_SET(vop2, wb, vir_stride_en, 1);
+		VOP_MODULE_SET(vop2, wb, post_empty_stop_en, 1);
+		VOP_MODULE_SET(vop2, wb, one_frame_mode, 0);
+	}
+	VOP_MODULE_SET(vop2, wb, enable, 1);
+
+	if (!stream->hw_enabled) {
+		vop2_wb_irqs_enable(vop2);
+		VOP_CTRL_SET(vop2, wb_dma_finish_and_en, 1);
+		stream->hw_enabled = true;
+	}
+
+	vop2_wb_cfg_done(vp);
+}
+
+static struct vop2_wb_slot *vop2_wb_stream_next_slot(struct vop2_wb_stream *stream)
+{
+	struct vop2_wb_slot *slot, *oldest = NULL;
+	int i;
+
+	for (i = 0; i < stream->count; i++) {
+		slot = &stream->slots[i];
+		if (slot->state == VOP2_WB_SLOT_QUEUED)
+			return slot;
+		if (slot->state == VOP2_WB_SLOT_DONE && !slot->acquired &&
+		    (!oldest || (s32)(slot->frame - oldest->frame) < 0))
+			oldest = slot;
+	}
+
+	/* all slots are in use, overwrite the oldest frame nobody picked up */
+	if (oldest)
+		stream->dropped++;
+
+	return oldest;
+}
+
+/*
+ * Called at the frame start of the stream vp: the slot written in the
+ * last frame is complete, the slot programmed in the last frame is now
+ * being written, and the next free slot is programmed for the coming frame.
+ */
+static void vop2_wb_stream_handler(struct vop2_video_port *vp)
+{
+	struct vop2 *vop2 = vp->vop2;
+	struct vop2_wb *wb = &vop2->wb;
+	struct vop2_wb_stream *stream = &wb->stream;
+	struct vop2_wb_slot *slot, *next;
+	struct dma_fence *fence = NULL;
+	unsigned long flags;
+	bool wake = false;
+	int i;
+
+	spin_lock_irqsave(&wb->job_lock, flags);
+	if (!stream->enabled || stream->vp_id != vp->id)
+		goto out;
+
+	for (i = 0; i < stream->count; i++) {
+		slot = &stream->slots[i];
+		if (slot->state == VOP2_WB_SLOT_ACTIVE) {
+			slot->state = VOP2_WB_SLOT_DONE;
+			dma_fence_signal_locked(slot->fence);
+		} else if (slot->state == VOP2_WB_SLOT_PENDING) {
+			slot->state = VOP2_WB_SLOT_ACTIVE;
+		}
+	}
+
+	next = vop2_wb_stream_next_slot(stream);
+	if (next)
+		fence = kzalloc(sizeof(*fence), GFP_ATOMIC);
+	if (!fence) {
+		if (stream->hw_enabled) {
+			vop2_wb_disable(vp);
+			stream->hw_enabled = false;
+		}
+		stream->dropped++;
+		goto out;
+	}
+
+	dma_fence_init(fence, &vop2_wb_fence_ops, &wb->job_lock,
+		       stream->fence_context, ++stream->seqno);
+	dma_fence_put(next->fence);
+	next->fence = fence;
+	next->frame = ++stream->frame;
+	next->state = VOP2_WB_SLOT_PENDING;
+	vop2_wb_stream_program(vp, next);
+	wake = true;
+
+	rockchip_drm_dbg(vop2->dev, VOP_DEBUG_WB, "wb stream frame %u to slot %ld\n",
+			 next->frame, (long)(next - stream->slots));
+out:
+	spin_unlock_irqrestore(&wb->job_lock, flags);
+
+	if (wake)
+		wake_up_interruptible(&stream->wait);
+}
+
 static void vop2_wb_handler(struct vop2_video_port *vp)
 {
 	struct vop2 *vop2 = vp->vop2;
@@ -12314,6 +13991,11 @@ static void vop2_wb_handler(struct vop2_video_port *vp)
 	uint8_t i;
 	bool wb_oneframe_mode = VOP_MODULE_GET(vop2, wb, one_frame_mode);
 
+	if (READ_ONCE(wb->stream.enabled)) {
+		vop2_wb_stream_handler(vp);
+		return;
+	}
+
 	wb_en = VOP_MODULE_GET(vop2, wb, enable);
 	wb_vp_id = VOP_MODULE_GET(vop2, wb, vp_id);
 	if (wb_vp_id != vp->id)
@@ -12341,6 +14023,344 @@ static void vop2_wb_handler(struct vop2_video_port *vp)
 	spin_unlock_irqrestore(&wb->job_lock, flags);
 }
 
+static int vop2_wb_stream_start(struct vop2_video_port *vp, struct drm_file *file,
+				struct drm_rockchip_wb_stream *args)
+{
+	struct drm_crtc *crtc = &vp->rockchip_crtc.crtc;
+	struct vop2 *vop2 = vp->vop2;
+	struct vop2_wb *wb = &vop2->wb;
+	struct vop2_wb_stream *stream = &wb->stream;
+	struct drm_framebuffer *fbs[ROCKCHIP_WB_STREAM_MAX_BUFS] = {};
+	struct rockchip_crtc_state *vcstate;
+	struct drm_display_mode *mode;
+	struct drm_framebuffer *fb;
+	enum vop2_wb_format format;
+	unsigned long flags;
+	int i, ret = 0;
+
+	if (!args->count || args->count > ROCKCHIP_WB_STREAM_MAX_BUFS)
+		return -EINVAL;
+
+	for (i = 0; i < args->count; i++) {
+		fbs[i] = drm_framebuffer_lookup(crtc->dev, file, args->fb_ids[i]);
+		if (!fbs[i]) {
+			ret = -ENOENT;
+			goto err_put_fb;
+		}
+		if (i && (fbs[i]->width != fbs[0]->width ||
+			  fbs[i]->height != fbs[0]->height ||
+			  fbs[i]->format != fbs[0]->format ||
+			  fbs[i]->pitches[0] != fbs[0]->pitches[0])) {
+			DRM_DEBUG_KMS("wb stream framebuffers must share size and format\n");
+			ret = -EINVAL;
+			goto err_put_fb;
+		}
+	}
+
+	fb = fbs[0];
+	format = vop2_convert_wb_format(fb->format->format);
+	if (format < 0) {
+		DRM_DEBUG_KMS("Invalid pixel format %p4cc\n", &fb->format->format);
+		ret = -EINVAL;
+		goto err_put_fb;
+	}
+
+	drm_modeset_lock(&crtc->mutex, NULL);
+	if (!crtc->state->active) {
+		ret = -EINVAL;
+		goto err_unlock;
+	}
+
+	mode = &crtc->state->mode;
+	vcstate = to_rockchip_crtc_state(crtc->state);
+	if (!fb->format->is_yuv && is_yuv_output(vcstate->bus_format)) {
+		DRM_ERROR("YUV2RGB is not supported by writeback\n");
+		ret = -EINVAL;
+		goto err_unlock;
+	}
+
+	if ((fb->width > mode->hdisplay) ||
+	    ((fb->height < mode->vdisplay) && (fb->height != (mode->vdisplay >> 1)))) {
+		DRM_DEBUG_KMS("Invalid framebuffer size %ux%u, Only support x scale down and 1/2 y scale down\n",
+			      fb->width, fb->height);
+		ret = -EINVAL;
+		goto err_unlock;
+	}
+
+	ret = drm_crtc_vblank_get(crtc);
+	if (ret)
+		goto err_unlock;
+
+	spin_lock_irqsave(&wb->job_lock, flags);
+	for (i = 0; i < VOP2_WB_JOB_MAX; i++) {
+		if (wb->jobs[i].pending)
+			ret = -EBUSY;
+	}
+	if (stream->enabled || ret) {
+		spin_unlock_irqrestore(&wb->job_lock, flags);
+		drm_crtc_vblank_put(crtc);
+		ret = -EBUSY;
+		goto err_unlock;
+	}
+
+	stream->vp_id = vp->id;
+	stream->file = file;
+	stream->format = format;
+	stream->scale_x_factor = vop2_scale_factor(SCALE_DOWN, VOP2_SCALE_DOWN_BIL,
+						   mode->hdisplay, fb->width);
+	stream->scale_x_en = (fb->width < mode->hdisplay) ? 1 : 0;
+	stream->scale_y_en = (fb->height < mode->vdisplay) ? 1 : 0;
+	stream->r2y = !vcstate->yuv_overlay && fb->format->is_yuv;
+	stream->fifo_throd = min_t(u32, fb->pitches[0] >> 4, vop2->data->wb->fifo_depth);
+	stream->act_width = fb->width - 1;
+	stream->vir_stride = fb->pitches[0] >> 2;
+	stream->fence_context = dma_fence_context_alloc(1);
+	stream->seqno = 0;
+	stream->frame = 0;
+	stream->dropped = 0;
+	stream->count = args->count;
+	for (i = 0; i < args->count; i++) {
+		struct vop2_wb_slot *slot = &stream->slots[i];
+
+		slot->fb = fbs[i];
+		slot->yrgb_addr = to_rockchip_obj(fbs[i]->obj[0])->dma_addr + fbs[i]->offsets[0];
+		if (fb->format->is_yuv)
+			slot->uv_addr = to_rockchip_obj(fbs[i]->obj[1])->dma_addr +
+					fbs[i]->offsets[1];
+		slot->fence = NULL;
+		slot->acquired = false;
+		slot->state = VOP2_WB_SLOT_QUEUED;
+	}
+	/* the first slot is programmed by the isr at the next frame start */
+	stream->enabled = true;
+	spin_unlock_irqrestore(&wb->job_lock, flags);
+	drm_modeset_unlock(&crtc->mutex);
+
+	DRM_DEV_INFO(vop2->dev, "vp%d start wb stream %ux%u %p4cc x %u\n",
+		     vp->id, fb->width, fb->height, &fb->format->format, args->count);
+
+	return 0;
+
+err_unlock:
+	drm_modeset_unlock(&crtc->mutex);
+err_put_fb:
+	for (i = 0; i < args->count; i++) {
+		if (fbs[i])
+			drm_framebuffer_put(fbs[i]);
+	}
+
+	return ret;
+}
+
+/*
+ * Stop the stream owned by @file, or whatever stream runs on @vp if @file
+ * is NULL, e.g. when the crtc is going to be disabled.
+ */
+static int vop2_wb_stream_stop(struct vop2_video_port *vp, struct drm_file *file)
+{
+	struct drm_crtc *crtc = &vp->rockchip_crtc.crtc;
+	struct vop2 *vop2 = vp->vop2;
+	struct vop2_wb *wb = &vop2->wb;
+	struct vop2_wb_stream *stream = &wb->stream;
+	struct vop2_wb_slot slots[ROCKCHIP_WB_STREAM_MAX_BUFS];
+	struct vop2_wb_slot *slot;
+	unsigned long flags;
+	int i, count;
+
+	spin_lock_irqsave(&wb->job_lock, flags);
+	if (!stream->enabled || stream->vp_id != vp->id ||
+	    (file && stream->file != file)) {
+		spin_unlock_irqrestore(&wb->job_lock, flags);
+		return -EINVAL;
+	}
+
+	stream->enabled = false;
+	stream->file = NULL;
+	if (stream->hw_enabled) {
+		vop2_wb_disable(vp);
+		stream->hw_enabled = false;
+	}
+
+	count = stream->count;
+	for (i = 0; i < count; i++) {
+		slot = &stream->slots[i];
+		if (slot->fence && !dma_fence_is_signaled_locked(slot->fence)) {
+			dma_fence_set_error(slot->fence, -ECANCELED);
+			dma_fence_signal_locked(slot->fence);
+		}
+		slots[i] = *slot;
+		memset(slot, 0, sizeof(*slot));
+	}
+	stream->count = 0;
+	spin_unlock_irqrestore(&wb->job_lock, flags);
+
+	wake_up_interruptible_all(&stream->wait);
+
+	/* the frame in flight is still written to memory until next frame start */
+	drm_crtc_wait_one_vblank(crtc);
+	for (i = 0; i < count; i++) {
+		dma_fence_put(slots[i].fence);
+		drm_framebuffer_put(slots[i].fb);
+	}
+	drm_crtc_vblank_put(crtc);
+
+	DRM_DEV_INFO(vop2->dev, "vp%d stop wb stream, %u frames %u dropped\n",
+		     vp->id, stream->frame, stream->dropped);
+
+	return 0;
+}
+
+/* oldest programmed slot not handed out yet, with wb->job_lock held */
+static struct vop2_wb_slot *vop2_wb_stream_oldest_slot(struct vop2_wb_stream *stream)
+{
+	struct vop2_wb_slot *slot, *oldest = NULL;
+	int i;
+
+	for (i = 0; i < stream->count; i++) {
+		slot = &stream->slots[i];
+		if (slot->acquired || slot->state < VOP2_WB_SLOT_PENDING)
+			continue;
+		if (!oldest || (s32)(slot->frame - oldest->frame) < 0)
+			oldest = slot;
+	}
+
+	return oldest;
+}
+
+static bool vop2_wb_stream_ready(struct vop2_wb *wb, struct drm_file *file)
+{
+	struct vop2_wb_stream *stream = &wb->stream;
+	unsigned long flags;
+	bool ready;
+
+	spin_lock_irqsave(&wb->job_lock, flags);
+	ready = !stream->enabled || stream->file != file ||
+		vop2_wb_stream_oldest_slot(stream);
+	spin_unlock_irqrestore(&wb->job_lock, flags);
+
+	return ready;
+}
+
+static int vop2_wb_stream_acquire(struct vop2_video_port *vp, struct drm_file *file,
+				  struct drm_rockchip_wb_stream *args)
+{
+	struct vop2_wb *wb = &vp->vop2->wb;
+	struct vop2_wb_stream *stream = &wb->stream;
+	struct sync_file *sync_file;
+	struct vop2_wb_slot *slot;
+	struct dma_fence *fence;
+	unsigned long flags;
+	long timeout;
+	int fd;
+
+	timeout = wait_event_interruptible_timeout(stream->wait,
+						   vop2_wb_stream_ready(wb, file),
+						   msecs_to_jiffies(args->timeout_ms));
+	if (timeout < 0)
+		return timeout;
+	if (!timeout)
+		return args->timeout_ms ? -ETIMEDOUT : -EAGAIN;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0)
+		return fd;
+
+	spin_lock_irqsave(&wb->job_lock, flags);
+	if (!stream->enabled || stream->file != file || stream->vp_id != vp->id) {
+		spin_unlock_irqrestore(&wb->job_lock, flags);
+		put_unused_fd(fd);
+		return -EINVAL;
+	}
+
+	slot = vop2_wb_stream_oldest_slot(stream);
+	if (!slot) {
+		spin_unlock_irqrestore(&wb->job_lock, flags);
+		put_unused_fd(fd);
+		return -EAGAIN;
+	}
+
+	slot->acquired = true;
+	fence = dma_fence_get(slot->fence);
+	args->index = slot - stream->slots;
+	args->frame = slot->frame;
+	args->dropped = stream->dropped;
+	spin_unlock_irqrestore(&wb->job_lock, flags);
+
+	sync_file = sync_file_create(fence);
+	dma_fence_put(fence);
+	if (!sync_file) {
+		spin_lock_irqsave(&wb->job_lock, flags);
+		slot->acquired = false;
+		spin_unlock_irqrestore(&wb->job_lock, flags);
+		put_unused_fd(fd);
+		return -ENOMEM;
+	}
+
+	fd_install(fd, sync_file->file);
+	args->fence_fd = fd;
+
+	return 0;
+}
+
+static int vop2_wb_stream_release(struct vop2_video_port *vp, struct drm_file *file,
+				  struct drm_rockchip_wb_stream *args)
+{
+	struct vop2_wb *wb = &vp->vop2->wb;
+	struct vop2_wb_stream *stream = &wb->stream;
+	struct vop2_wb_slot *slot;
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&wb->job_lock, flags);
+	if (!stream->enabled || stream->file != file || stream->vp_id != vp->id ||
+	    args->index >= stream->count) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	slot = &stream->slots[args->index];
+	if (!slot->acquired) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* the consumer must wait the fence before giving the buffer back */
+	if (slot->state != VOP2_WB_SLOT_DONE) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	slot->acquired = false;
+	slot->state = VOP2_WB_SLOT_QUEUED;
+	args->dropped = stream->dropped;
+out:
+	spin_unlock_irqrestore(&wb->job_lock, flags);
+
+	return ret;
+}
+
+static int vop2_crtc_wb_stream(struct drm_crtc *crtc, struct drm_file *file,
+			       struct drm_rockchip_wb_stream *args)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+
+	if (!vp->vop2->wb.regs)
+		return -ENODEV;
+
+	switch (args->cmd) {
+	case ROCKCHIP_WB_STREAM_START:
+		return vop2_wb_stream_start(vp, file, args);
+	case ROCKCHIP_WB_STREAM_STOP:
+		return vop2_wb_stream_stop(vp, file);
+	case ROCKCHIP_WB_STREAM_ACQUIRE:
+		return vop2_wb_stream_acquire(vp, file, args);
+	case ROCKCHIP_WB_STREAM_RELEASE:
+		return vop2_wb_stream_release(vp, file, args);
+	default:
+		return -EINVAL;
+	}
+}
+
 static void vop2_dsc_isr(struct vop2 *vop2)
 {
 	const struct vop2_data *vop2_data = vop2->data;
@@ -12378,6 +14398,75 @@ static void vop2_dsc_isr(struct vop2 *vop2)
 	}
 }
 
+static void vop2_qos_boost_work(struct work_struct *work)
+{
+	struct vop2 *vop2 = container_of(work, struct vop2, qos_boost_work);
+
+	mutex_lock(&vop2->qos_lock);
+	if (!vop2->qos_boosted) {
+		if (rockchip_raise_qos_priority(vop2->dev, vop2->qos_boost_priority)) {
+			mutex_unlock(&vop2->qos_lock);
+			return;
+		}
+		vop2->qos_boosted = true;
+
+		/* back off when the last relax was too early */
+		if (vop2->qos_relax_time &&
+		    time_before(jiffies, vop2->qos_relax_time + msecs_to_jiffies(vop2->qos_hold_ms)))
+			vop2->qos_hold_ms = min(vop2->qos_hold_ms * 2, VOP2_QOS_HOLD_MAX_MS);
+		else
+			vop2->qos_hold_ms = VOP2_QOS_HOLD_MIN_MS;
+		DRM_DEV_DEBUG_DRIVER(vop2->dev, "raise qos priority to 0x%x for %u ms\n",
+				     vop2->qos_boost_priority, vop2->qos_hold_ms);
+	}
+	/* every new underflow restarts the hold time */
+	mod_delayed_work(system_wq, &vop2->qos_relax_work, msecs_to_jiffies(vop2->qos_hold_ms));
+	mutex_unlock(&vop2->qos_lock);
+}
+
+static void vop2_qos_relax_work(struct work_struct *work)
+{
+	struct vop2 *vop2 = container_of(to_delayed_work(work), struct vop2, qos_relax_work);
+
+	mutex_lock(&vop2->qos_lock);
+	if (vop2->qos_boosted) {
+		rockchip_reset_qos_priority(vop2->dev);
+		vop2->qos_boosted = false;
+		vop2->qos_relax_time = jiffies;
+		DRM_DEV_DEBUG_DRIVER(vop2->dev, "restore qos priority\n");
+	}
+	mutex_unlock(&vop2->qos_lock);
+}
+
+static void vop2_qos_underflow(struct vop2 *vop2)
+{
+	if (vop2->qos_boost_priority)
+		queue_work(system_highpri_wq, &vop2->qos_boost_work);
+	rockchip_monitor_deadline_miss();
+}
+
+static void vop2_qos_init(struct vop2 *vop2)
+{
+	mutex_init(&vop2->qos_lock);
+	INIT_WORK(&vop2->qos_boost_work, vop2_qos_boost_work);
+	INIT_DELAYED_WORK(&vop2->qos_relax_work, vop2_qos_relax_work);
+	vop2->qos_hold_ms = VOP2_QOS_HOLD_MIN_MS;
+	vop2->qos_boost_priority = VOP2_QOS_BOOST_PRIORITY;
+	/* 0 turns the controller off */
+	of_property_read_u32(vop2->dev->of_node, "rockchip,qos-boost-priority",
+			     &vop2->qos_boost_priority);
+}
+
+static void vop2_qos_fini(struct vop2 *vop2)
+{
+	vop2->qos_boost_priority = 0;
+	cancel_work_sync(&vop2->qos_boost_work);
+	cancel_delayed_work_sync(&vop2->qos_relax_work);
+	if (vop2->qos_boosted)
+		rockchip_reset_qos_priority(vop2->dev);
+	vop2->qos_boosted = false;
+}
+
 static irqreturn_t vop2_isr(int irq, void *data)
 {
 	struct vop2 *vop2 = data;
@@ -12397,9 +14486,11 @@ static irqreturn_t vop2_isr(int irq, void *data)
 #define ERROR_HANDLER(x) \
 	do { \
 		if (active_irqs & x##_INTR) {\
-			if (x##_INTR == POST_BUF_EMPTY_INTR) \
+			if (x##_INTR == POST_BUF_EMPTY_INTR) { \
+				atomic_inc(&vp->post_buf_empty_count); \
+				vop2_qos_underflow(vop2); \
 				DRM_DEV_ERROR_RATELIMITED(vop2->dev, #x " irq err at vp%d\n", vp->id); \
-			else \
+			} else \
 				DRM_DEV_ERROR_RATELIMITED(vop2->dev, #x " irq err\n"); \
 			active_irqs &= ~x##_INTR; \
 			ret = IRQ_HANDLED; \
@@ -12465,6 +14556,8 @@ static irqreturn_t vop2_isr(int irq, void *data)
 		if (active_irqs & FS_FIELD_INTR) {
 			rockchip_drm_dbg(vop2->dev, VOP_DEBUG_VSYNC, "vsync_vp%d\n", vp->id);
 			vop2_wb_handler(vp);
+			if (READ_ONCE(vp->vrr_late_latch))
+				vop2_crtc_vrr_late_latch_restart(vp);
 			if (likely(!vp->skip_vsync) || (vp->layer_sel_update == false)) {
 				drm_crtc_handle_vblank(crtc);
 				vop2_handle_vblank(vop2, crtc);
@@ -12630,6 +14723,8 @@ static irqreturn_t vop3_vp_isr(int irq, void *data)
 	}
 
 	if (active_irqs & POST_BUF_EMPTY_INTR) {
+		atomic_inc(&vp->post_buf_empty_count);
+		vop2_qos_underflow(vop2);
 		DRM_DEV_ERROR_RATELIMITED(vop2->dev, "POST_BUF_EMPTY_INTR irq err at vp%d\n", vp->id);
 		active_irqs &= ~POST_BUF_EMPTY_INTR;
 		ret = IRQ_HANDLED;
@@ -12825,6 +14920,7 @@ static int vop2_plane_init(struct vop2 *vop2, struct vop2_win *win, unsigned lon
 	drm_plane_create_alpha_property(&win->base);
 	drm_plane_create_blend_mode_property(&win->base, blend_caps);
 	drm_plane_create_zpos_property(&win->base, win->win_id, 0, vop2->registered_num_wins - 1);
+	drm_plane_enable_fb_damage_clips(&win->base);
 	vop2_plane_create_name_property(vop2, win);
 	vop2_plane_create_feature_property(vop2, win);
 	if (win->feature & WIN_FEATURE_DCI)
@@ -13094,6 +15190,34 @@ static int vop2_crtc_create_vrr_property(struct vop2 *vop2, struct drm_crtc *crt
 	vp->min_refresh_rate_prop = prop;
 	drm_object_attach_property(&crtc->base, vp->min_refresh_rate_prop, 0);
 
+	prop = drm_property_create_range(vop2->drm_dev, 0, "vrr late latch", 0, 1);
+	if (!prop) {
+		DRM_DEV_ERROR(vop2->dev, "create vrr prop for vp%d failed\n", vp->id);
+		return -ENOMEM;
+	}
+	vp->vrr_late_latch_prop = prop;
+	drm_object_attach_property(&crtc->base, vp->vrr_late_latch_prop, 0);
+
+	return 0;
+}
+
+static int vop2_crtc_create_genlock_property(struct vop2 *vop2, struct drm_crtc *crtc)
+{
+	struct vop2_video_port *vp = to_vop2_video_port(crtc);
+	struct drm_property *prop;
+
+	/* the vps are latched together by one write of the cfg_done mask */
+	if (vop2->version == VOP_VERSION_RK3568 || vop2->data->nr_vps < 2)
+		return 0;
+
+	prop = drm_property_create_range(vop2->drm_dev, 0, "genlock", 0, 1);
+	if (!prop) {
+		DRM_DEV_ERROR(vop2->dev, "create genlock prop for vp%d failed\n", vp->id);
+		return -ENOMEM;
+	}
+	vp->genlock_prop = prop;
+	drm_object_attach_property(&crtc->base, vp->genlock_prop, 0);
+
 	return 0;
 }
 
@@ -13393,6 +15517,20 @@ static int vop2_create_crtc(struct vop2 *vop2, uint8_t enabled_vp_mask)
 		drm_crtc_helper_add(crtc, &vop2_crtc_helper_funcs);
 
 		drm_flip_work_init(&vp->fb_unref_work, "fb_unref", vop2_fb_unref_worker);
+		INIT_WORK(&vp->reclaim_work, vop2_reclaim_worker);
+		INIT_WORK(&vp->acm_update_work, vop2_acm_update_work);
+		init_llist_head(&vp->plane_reclaim_list);
+		init_llist_head(&vp->crtc_reclaim_list);
+
+		vp->zpos_pool = devm_kcalloc(dev, vop2_data->win_size,
+					     sizeof(*vp->zpos_pool), GFP_KERNEL);
+		vp->zpos_splice_pool = devm_kcalloc(dev, vop2_data->win_size,
+						    sizeof(*vp->zpos_splice_pool), GFP_KERNEL);
+		vp->zpos_splice_hdr_pool = devm_kcalloc(dev, vop2_data->win_size,
+							sizeof(*vp->zpos_splice_hdr_pool),
+							GFP_KERNEL);
+		if (!vp->zpos_pool || !vp->zpos_splice_pool || !vp->zpos_splice_hdr_pool)
+			return -ENOMEM;
 
 		init_completion(&vp->dsp_hold_completion);
 		init_completion(&vp->line_flag_completion);
@@ -13417,6 +15555,7 @@ static int vop2_create_crtc(struct vop2 *vop2, uint8_t enabled_vp_mask)
 			vop2_crtc_create_plane_mask_property(vop2, crtc, plane_mask);
 		vop2_crtc_create_feature_property(vop2, crtc);
 		vop2_crtc_create_vrr_property(vop2, crtc);
+		vop2_crtc_create_genlock_property(vop2, crtc);
 
 		ret = drm_self_refresh_helper_init(crtc);
 		if (ret)
@@ -13511,6 +15650,7 @@ static void vop2_destroy_crtc(struct drm_crtc *crtc)
 {
 	struct vop2_video_port *vp = to_vop2_video_port(crtc);
 
+	cancel_work_sync(&vp->acm_update_work);
 	drm_self_refresh_helper_cleanup(crtc);
 	if (vp->hdr_lut_gem_obj)
 		rockchip_gem_free_object(&vp->hdr_lut_gem_obj->base);
@@ -13522,6 +15662,7 @@ static void vop2_destroy_crtc(struct drm_crtc *crtc)
 	 * references the CRTC.
 	 */
 	drm_crtc_cleanup(crtc);
+	flush_work(&vp->reclaim_work);
 	drm_flip_work_cleanup(&vp->fb_unref_work);
 }
 
@@ -14394,6 +16535,7 @@ static int vop2_bind(struct device *dev, struct device *master, void *data)
 	spin_lock_init(&vop2->reg_lock);
 	spin_lock_init(&vop2->irq_lock);
 	mutex_init(&vop2->vop2_lock);
+	vop2_qos_init(vop2);
 
 	if (vop2->version == VOP_VERSION_RK3528) {
 		atomic_set(&vop2->vps[1].post_buf_empty_flag, 0);
@@ -14460,6 +16602,7 @@ static void vop2_unbind(struct device *dev, struct device *master, void *data)
 	struct drm_plane *plane, *tmpp;
 
 	rockchip_vop2_devfreq_uninit(vop2);
+	vop2_qos_fini(vop2);
 	pm_runtime_disable(dev);
 
 	list_for_each_entry_safe(plane, tmpp, plane_list, head)
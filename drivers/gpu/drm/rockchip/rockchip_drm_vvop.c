@@ -30,6 +30,10 @@
 
 static struct platform_device *vvop_pdev;
 
+static unsigned int crtc_num = VVOP_MAX_CRTC;
+module_param(crtc_num, uint, 0444);
+MODULE_PARM_DESC(crtc_num, "number of virtual crtcs to create");
+
 struct vvop_crtc {
 	struct drm_crtc crtc;
 	struct drm_plane plane;
@@ -53,8 +57,21 @@ struct vvop {
 	uint32_t crtc_mask;
 };
 
+/*
+ * The committed buffer is never scanned out, it goes to an encoder as it
+ * is, so accept the input formats the video encoders take.
+ */
 static const u32 vvop_formats[] = {
 	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ARGB8888,
+	DRM_FORMAT_XBGR8888,
+	DRM_FORMAT_ABGR8888,
+	DRM_FORMAT_RGB888,
+	DRM_FORMAT_BGR888,
+	DRM_FORMAT_RGB565,
+	DRM_FORMAT_NV12,
+	DRM_FORMAT_NV16,
+	DRM_FORMAT_NV24,
 };
 
 #define drm_crtc_to_vvop_crtc(crtc) \
@@ -135,6 +152,32 @@ static void vvop_disable_vblank(struct drm_crtc *crtc)
 	hrtimer_try_to_cancel(&vcrtc->vblank_hrtimer);
 }
 
+/*
+ * Report the hrtimer expiry as the vblank time instead of the time the
+ * handler got to run, so the timestamps an encoder takes as pts are on
+ * the exact frame grid.
+ */
+static bool vvop_get_vblank_timestamp(struct drm_crtc *crtc, int *max_error,
+				      ktime_t *vblank_time, bool in_vblank_irq)
+{
+	struct vvop_crtc *vcrtc = drm_crtc_to_vvop_crtc(crtc);
+	struct drm_vblank_crtc *vblank = &crtc->dev->vblank[drm_crtc_index(crtc)];
+
+	if (!READ_ONCE(vblank->enabled)) {
+		*vblank_time = ktime_get();
+		return true;
+	}
+
+	*vblank_time = READ_ONCE(vcrtc->vblank_hrtimer.node.expires);
+	if (WARN_ON(*vblank_time == vblank->time))
+		return true;
+
+	/* the timer is forwarded one frame before the vblank is handled */
+	*vblank_time -= vcrtc->period_ns;
+
+	return true;
+}
+
 static void vvop_connector_destroy(struct drm_connector *connector)
 {
 	drm_connector_unregister(connector);
@@ -396,6 +439,7 @@ static const struct drm_crtc_funcs vvop_crtc_funcs = {
 	.atomic_destroy_state	= drm_atomic_helper_crtc_destroy_state,
 	.enable_vblank		= vvop_enable_vblank,
 	.disable_vblank		= vvop_disable_vblank,
+	.get_vblank_timestamp	= vvop_get_vblank_timestamp,
 };
 
 static void vvop_crtc_atomic_enable(struct drm_crtc *crtc,
@@ -570,10 +614,11 @@ static int vvop_create_crtc(struct vvop *vvop, int index)
 
 static int vvop_create_crtcs(struct vvop *vvop)
 {
+	unsigned int num = min_t(unsigned int, crtc_num, VVOP_MAX_CRTC);
 	int ret;
 	int i;
 
-	for (i = 0; i < VVOP_MAX_CRTC; i++) {
+	for (i = 0; i < num; i++) {
 		ret = vvop_create_crtc(vvop, i);
 		if (ret) {
 			DRM_WARN("Failed to create virtual crtc, index = %d\n", i);
@@ -581,7 +626,7 @@ static int vvop_create_crtcs(struct vvop *vvop)
 		}
 	}
 
-	DRM_INFO("Create %d(total: %d) virtual crtcs\n", i, VVOP_MAX_CRTC);
+	DRM_INFO("Create %d(total: %d) virtual crtcs\n", i, num);
 
 	return 0;
 }
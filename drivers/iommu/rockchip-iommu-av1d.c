@@ -48,6 +48,8 @@ struct av1d_iommu {
 	/* for av1 iommu */
 	u64 *pta; /* page directory table */
 	dma_addr_t pta_dma;
+	/* tables changed since the last tlb flush */
+	bool tlb_dirty;
 };
 
 #define RK_IOMMU_AV1	0xa
@@ -204,6 +206,7 @@ static int av1d_iommu_enable(struct av1d_iommu *av1d_iommu)
 		}
 	}
 	clk_bulk_disable(av1d_iommu->num_clocks, av1d_iommu->clocks);
+	WRITE_ONCE(av1d_iommu->tlb_dirty, true);
 	return ret;
 }
 
@@ -266,6 +269,15 @@ static void av1_iommu_flush_tlb_all(struct iommu_domain *domain, struct device *
 	if (WARN_ON(!av1d_iommu))
 		return;
 
+	/*
+	 * The decoder flushes before every frame, but the tables only change
+	 * when a new buffer is mapped or an old one unmapped. Those changes
+	 * are batched into the next flush and frames that reuse cached
+	 * mappings skip it.
+	 */
+	if (!READ_ONCE(av1d_iommu->tlb_dirty))
+		return;
+
 	spin_lock_irqsave(&av1d_iommu->iommus_lock, flags);
 	ret = pm_runtime_get_if_in_use(av1d_iommu->dev);
 	if (WARN_ON_ONCE(ret < 0)) {
@@ -273,6 +285,9 @@ static void av1_iommu_flush_tlb_all(struct iommu_domain *domain, struct device *
 		return;
 	}
 	if (ret) {
+		/* a change made while flushing marks it dirty again */
+		WRITE_ONCE(av1d_iommu->tlb_dirty, false);
+		smp_mb();
 		WARN_ON(clk_bulk_enable(av1d_iommu->num_clocks, av1d_iommu->clocks));
 		for (i = 0; i < av1d_iommu->num_mmu; i++) {
 			writel(AV1_MMU_BIT_FLUSH,
@@ -459,6 +474,8 @@ static size_t av1_iommu_unmap_iova(struct av1d_iommu *av1d_iommu,
 	}
 
 	av1_table_flush(pte_dma, pte_count);
+	if (pte_count)
+		WRITE_ONCE(av1d_iommu->tlb_dirty, true);
 
 	return pte_count * SPAGE_SIZE;
 }
@@ -485,6 +502,7 @@ static int av1_iommu_map_iova(struct av1d_iommu *av1_iommu, u32 *pte_addr,
 	}
 
 	av1_table_flush(pte_dma, pte_total);
+	WRITE_ONCE(av1_iommu->tlb_dirty, true);
 
 	return 0;
 unwind:
@@ -8,6 +8,7 @@
 
 #include <linux/clk.h>
 #include <linux/compiler.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
@@ -19,15 +20,21 @@
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/init.h>
 #include <linux/of.h>
 #include <linux/of_platform.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <soc/rockchip/rockchip_iommu.h>
 
+#define CREATE_TRACE_POINTS
+#include "rockchip_iommu_trace.h"
+
 /** MMU register offsets */
 #define RK_MMU_DTE_ADDR		0x00	/* Directory table address */
 #define RK_MMU_STATUS		0x04
@@ -75,6 +82,12 @@
 #define SPAGE_ORDER 12
 #define SPAGE_SIZE (1 << SPAGE_ORDER)
 
+/* iova covered by one page table */
+#define RK_IOMMU_PT_SIZE (NUM_PT_ENTRIES * SPAGE_SIZE)
+
+/* zap the entire iotlb rather than this many bytes line by line */
+#define RK_IOMMU_ZAP_LINES_MAX SZ_1M
+
 #define DISABLE_FETCH_DTE_TIME_LIMIT BIT(31)
 
 #define CMD_RETRY_COUNT 10
@@ -85,6 +98,22 @@
   */
 #define RK_IOMMU_PGSIZE_BITMAP 0x007ff000
 
+/* updated under dt_lock */
+struct rk_iommu_domain_stats {
+	u64 map_count;
+	u64 map_bytes;
+	u64 unmap_count;
+	u64 unmap_bytes;
+	u32 pt_count; /* page tables allocated, freed with the domain */
+};
+
+struct rk_iommu_stats {
+	u64 zap_count; /* ZAP_ONE_LINE writes and ZAP_CACHE commands */
+	u64 zap_ns;
+	u64 fault_count;
+	u64 bus_error_count;
+};
+
 struct rk_iommu_domain {
 	struct list_head iommus;
 	u32 *dt; /* page directory table */
@@ -94,6 +123,7 @@ struct rk_iommu_domain {
 	bool shootdown_entire;
 	struct third_iommu_ops_wrap *opt_ops;
 	struct device *iommu_dev;
+	struct rk_iommu_domain_stats stats;
 
 	struct iommu_domain domain;
 };
@@ -125,6 +155,9 @@ struct rk_iommu {
 	struct third_iommu_ops_wrap *opt_ops;
 	bool iommu_enabled;
 	bool need_res_map;
+	u32 share_id; /* iommus with the same id share one group and domain */
+	struct list_head share_node; /* entry in rk_iommu_share_list */
+	struct rk_iommu_stats stats;
 };
 
 struct rk_iommudata {
@@ -138,6 +171,9 @@ static const struct rk_iommu_ops *rk_ops;
 static struct rk_iommu *rk_iommu_from_dev(struct device *dev);
 static char reserve_range[PAGE_SIZE] __aligned(PAGE_SIZE);
 static phys_addr_t res_page;
+static LIST_HEAD(rk_iommu_share_list);
+static DEFINE_MUTEX(rk_iommu_share_lock);
+static struct dentry *rk_iommu_debugfs_root;
 
 static inline void rk_table_flush(struct rk_iommu_domain *dom, dma_addr_t dma,
 				  unsigned int count)
@@ -386,16 +422,27 @@ static void rk_iommu_zap_lines(struct rk_iommu *iommu, dma_addr_t iova_start,
 {
 	int i;
 	dma_addr_t iova_end = iova_start + size;
-	/*
-	 * TODO(djkurtz): Figure out when it is more efficient to shootdown the
-	 * entire iotlb rather than iterate over individual iovas.
-	 */
+	bool full = size > RK_IOMMU_ZAP_LINES_MAX;
+	u64 start = ktime_get_ns(), ns;
+
 	for (i = 0; i < iommu->num_mmu; i++) {
 		dma_addr_t iova;
 
+		/* one command is cheaper than a register write per page */
+		if (full) {
+			rk_iommu_base_command(iommu->bases[i], RK_MMU_CMD_ZAP_CACHE);
+			iommu->stats.zap_count++;
+			continue;
+		}
+
 		for (iova = iova_start; iova < iova_end; iova += SPAGE_SIZE)
 			rk_iommu_write(iommu->bases[i], RK_MMU_ZAP_ONE_LINE, iova);
+		iommu->stats.zap_count += size / SPAGE_SIZE;
 	}
+
+	ns = ktime_get_ns() - start;
+	iommu->stats.zap_ns += ns;
+	trace_rk_iommu_zap(iommu->dev, iova_start, size, full, ns);
 }
 
 static bool rk_iommu_is_stall_active(struct rk_iommu *iommu)
@@ -683,11 +730,13 @@ static int rk_pagefault_done(struct rk_iommu *iommu)
 
 		ret = IRQ_HANDLED;
 		iova = rk_iommu_read(iommu->bases[i], RK_MMU_PAGE_FAULT_ADDR);
+		status = rk_iommu_read(iommu->bases[i], RK_MMU_STATUS);
+		trace_rk_iommu_fault(iommu->dev, iova, int_status, status);
 
 		if (int_status & RK_MMU_IRQ_PAGE_FAULT) {
 			int flags;
 
-			status = rk_iommu_read(iommu->bases[i], RK_MMU_STATUS);
+			iommu->stats.fault_count++;
 			flags = (status & RK_MMU_STATUS_PAGE_FAULT_IS_WRITE) ?
 					IOMMU_FAULT_WRITE : IOMMU_FAULT_READ;
 
@@ -722,8 +771,10 @@ static int rk_pagefault_done(struct rk_iommu *iommu)
 				rk_iommu_base_command(iommu->bases[i], RK_MMU_CMD_PAGE_FAULT_DONE);
 		}
 
-		if (int_status & RK_MMU_IRQ_BUS_ERROR)
+		if (int_status & RK_MMU_IRQ_BUS_ERROR) {
+			iommu->stats.bus_error_count++;
 			dev_err(iommu->dev, "BUS_ERROR occurred at %pad\n", &iova);
+		}
 
 		if (int_status & ~RK_MMU_IRQ_MASK)
 			dev_err(iommu->dev, "unexpected int_status: %#08x\n",
@@ -882,6 +933,7 @@ static u32 *rk_dte_get_page_table(struct rk_iommu_domain *rk_domain,
 
 	dte = rk_ops->mk_dtentries(pt_dma);
 	*dte_addr = dte;
+	rk_domain->stats.pt_count++;
 
 	rk_table_flush(rk_domain,
 		       rk_domain->dt_dma + dte_index * sizeof(u32), 1);
@@ -961,14 +1013,6 @@ static int rk_iommu_map_iova(struct rk_iommu_domain *rk_domain, u32 *pte_addr,
 
 	rk_table_flush(rk_domain, pte_dma, pte_total);
 
-	/*
-	 * Zap the first and last iova to evict from iotlb any previously
-	 * mapped cachelines holding stale values for its dte and pte.
-	 * We only zap the first and last iova, since only they could have
-	 * dte or pte shared with an existing mapping.
-	 */
-	rk_iommu_zap_iova_first_last(rk_domain, iova, size);
-
 	return 0;
 unwind:
 	/* Unmap the range of iovas that we just mapped */
@@ -983,91 +1027,173 @@ static int rk_iommu_map_iova(struct rk_iommu_domain *rk_domain, u32 *pte_addr,
 	return -EADDRINUSE;
 }
 
-static int rk_iommu_map(struct iommu_domain *domain, unsigned long _iova,
-			phys_addr_t paddr, size_t size, int prot, gfp_t gfp)
+static int rk_iommu_map_pages(struct iommu_domain *domain, unsigned long _iova,
+			      phys_addr_t paddr, size_t pgsize, size_t pgcount,
+			      int prot, gfp_t gfp, size_t *mapped)
 {
 	struct rk_iommu_domain *rk_domain = to_rk_domain(domain);
 	unsigned long flags;
 	dma_addr_t pte_dma, iova = (dma_addr_t)_iova;
+	size_t size = pgsize * pgcount, done = 0, len;
 	u32 *page_table, *pte_addr;
 	u32 dte, pte_index;
-	int ret;
+	int ret = 0;
 
-	if (rk_domain->opt_ops && rk_domain->opt_ops->map)
-		return rk_domain->opt_ops->map(domain, _iova, paddr, size, prot,
-					       gfp, rk_domain->iommu_dev);
+	/*
+	 * PCIe BARs mapped for peer-to-peer (IOMMU_MMIO) commonly live in the
+	 * 64-bit windows above 4 GiB; don't let the PTE format truncate them
+	 * into some unrelated DDR page.
+	 */
+	if (!(prot & IOMMU_PRIV) && paddr + size - 1 > rk_ops->dma_bit_mask) {
+		pr_err("phys %pa+%#zx beyond the iommu address range\n", &paddr, size);
+		*mapped = 0;
+		return -ERANGE;
+	}
+
+	if (rk_domain->opt_ops && rk_domain->opt_ops->map) {
+		for (; done < size; done += pgsize) {
+			ret = rk_domain->opt_ops->map(domain, _iova + done,
+						      paddr + done, pgsize, prot,
+						      gfp, rk_domain->iommu_dev);
+			if (ret)
+				break;
+		}
+		*mapped = done;
+		return ret;
+	}
 
 	spin_lock_irqsave(&rk_domain->dt_lock, flags);
 
 	/*
-	 * pgsize_bitmap specifies iova sizes that fit in one page table
-	 * (1024 4-KiB pages = 4 MiB).
-	 * So, size will always be 4096 <= size <= 4194304.
-	 * Since iommu_map() guarantees that both iova and size will be
-	 * aligned, we will always only be mapping from a single dte here.
+	 * The range may span several page tables, each one covers 4 MiB of
+	 * iova. Fill them one after another under a single lock and zap the
+	 * iotlb once for the whole range.
 	 */
-	page_table = rk_dte_get_page_table(rk_domain, iova);
-	if (IS_ERR(page_table)) {
-		spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
-		return PTR_ERR(page_table);
-	}
+	while (done < size) {
+		dma_addr_t cur = iova + done;
 
-	dte = rk_domain->dt[rk_iova_dte_index(iova)];
-	pte_index = rk_iova_pte_index(iova);
-	pte_addr = &page_table[pte_index];
-	pte_dma = rk_ops->pt_address(dte) + pte_index * sizeof(u32);
-	ret = rk_iommu_map_iova(rk_domain, pte_addr, pte_dma, iova,
-				paddr, size, prot);
+		len = min_t(size_t, size - done,
+			    RK_IOMMU_PT_SIZE - (cur & (RK_IOMMU_PT_SIZE - 1)));
+
+		page_table = rk_dte_get_page_table(rk_domain, cur);
+		if (IS_ERR(page_table)) {
+			ret = PTR_ERR(page_table);
+			break;
+		}
+
+		dte = rk_domain->dt[rk_iova_dte_index(cur)];
+		pte_index = rk_iova_pte_index(cur);
+		pte_addr = &page_table[pte_index];
+		pte_dma = rk_ops->pt_address(dte) + pte_index * sizeof(u32);
+		ret = rk_iommu_map_iova(rk_domain, pte_addr, pte_dma, cur,
+					paddr + done, len, prot);
+		if (ret)
+			break;
+
+		done += len;
+	}
 
+	rk_domain->stats.map_count++;
+	rk_domain->stats.map_bytes += done;
 	spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
 
+	/* iotlb is zapped by rk_iommu_iotlb_sync_map() once per iommu_map() */
+	*mapped = done;
+
 	return ret;
 }
 
-static size_t rk_iommu_unmap(struct iommu_domain *domain, unsigned long _iova,
-			     size_t size, struct iommu_iotlb_gather *gather)
+static size_t rk_iommu_unmap_pages(struct iommu_domain *domain, unsigned long _iova,
+				   size_t pgsize, size_t pgcount,
+				   struct iommu_iotlb_gather *gather)
 {
 	struct rk_iommu_domain *rk_domain = to_rk_domain(domain);
 	unsigned long flags;
 	dma_addr_t pte_dma, iova = (dma_addr_t)_iova;
+	size_t size = pgsize * pgcount, done = 0, len, unmap_size;
 	phys_addr_t pt_phys;
 	u32 dte;
 	u32 *pte_addr;
-	size_t unmap_size;
-	struct rk_iommu *iommu = rk_iommu_get(rk_domain);
+	struct rk_iommu *iommu;
 
-	if (rk_domain->opt_ops && rk_domain->opt_ops->unmap)
-		return rk_domain->opt_ops->unmap(domain, _iova, size, gather,
-						 rk_domain->iommu_dev);
+	if (rk_domain->opt_ops && rk_domain->opt_ops->unmap) {
+		for (; done < size; done += unmap_size) {
+			unmap_size = rk_domain->opt_ops->unmap(domain, _iova + done,
+							       pgsize, gather,
+							       rk_domain->iommu_dev);
+			if (!unmap_size)
+				break;
+		}
+		return done;
+	}
+
+	iommu = rk_iommu_get(rk_domain);
 
 	spin_lock_irqsave(&rk_domain->dt_lock, flags);
 
+	while (done < size) {
+		dma_addr_t cur = iova + done;
+
+		len = min_t(size_t, size - done,
+			    RK_IOMMU_PT_SIZE - (cur & (RK_IOMMU_PT_SIZE - 1)));
+
+		dte = rk_domain->dt[rk_iova_dte_index(cur)];
+		/* Stop at the first unmapped page table */
+		if (!rk_dte_is_pt_valid(dte))
+			break;
+
+		pt_phys = rk_ops->pt_address(dte);
+		pte_addr = (u32 *)phys_to_virt(pt_phys) + rk_iova_pte_index(cur);
+		pte_dma = pt_phys + rk_iova_pte_index(cur) * sizeof(u32);
+		unmap_size = rk_iommu_unmap_iova(rk_domain, pte_addr, pte_dma,
+						 len, iommu);
+		done += unmap_size;
+		if (unmap_size < len)
+			break;
+	}
+
+	rk_domain->stats.unmap_count++;
+	rk_domain->stats.unmap_bytes += done;
+	spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
+
 	/*
-	 * pgsize_bitmap specifies iova sizes that fit in one page table
-	 * (1024 4-KiB pages = 4 MiB).
-	 * So, size will always be 4096 <= size <= 4194304.
-	 * Since iommu_unmap() guarantees that both iova and size will be
-	 * aligned, we will always only be unmapping from a single dte here.
+	 * Shootdown of the unmapped range is deferred to rk_iommu_iotlb_sync(),
+	 * all ranges of one iommu_unmap() are zapped together.
 	 */
-	dte = rk_domain->dt[rk_iova_dte_index(iova)];
-	/* Just return 0 if iova is unmapped */
-	if (!rk_dte_is_pt_valid(dte)) {
-		spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
-		return 0;
-	}
+	if (done)
+		iommu_iotlb_gather_add_range(gather, iova, done);
 
-	pt_phys = rk_ops->pt_address(dte);
-	pte_addr = (u32 *)phys_to_virt(pt_phys) + rk_iova_pte_index(iova);
-	pte_dma = pt_phys + rk_iova_pte_index(iova) * sizeof(u32);
-	unmap_size = rk_iommu_unmap_iova(rk_domain, pte_addr, pte_dma, size,
-					 iommu);
+	return done;
+}
 
-	spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
+static void rk_iommu_iotlb_sync_map(struct iommu_domain *domain,
+				    unsigned long iova, size_t size)
+{
+	struct rk_iommu_domain *rk_domain = to_rk_domain(domain);
+
+	if (rk_domain->opt_ops)
+		return;
+
+	/*
+	 * Zap the first and last iova to evict from iotlb any previously
+	 * mapped cachelines holding stale values for its dte and pte.
+	 * We only zap the first and last iova, since only they could have
+	 * dte or pte shared with an existing mapping.
+	 */
+	rk_iommu_zap_iova_first_last(rk_domain, iova, size);
+}
 
-	/* Shootdown iotlb entries for iova range that was just unmapped */
-	rk_iommu_zap_iova(rk_domain, iova, unmap_size);
+static void rk_iommu_iotlb_sync(struct iommu_domain *domain,
+				struct iommu_iotlb_gather *gather)
+{
+	struct rk_iommu_domain *rk_domain = to_rk_domain(domain);
+
+	if (rk_domain->opt_ops || !gather->end)
+		return;
 
-	return unmap_size;
+	/* ranges above RK_IOMMU_ZAP_LINES_MAX zap the entire iotlb */
+	rk_iommu_zap_iova(rk_domain, gather->start,
+			  gather->end - gather->start + 1);
 }
 
 static void rk_iommu_flush_tlb_all(struct iommu_domain *domain)
@@ -1541,14 +1667,96 @@ static const struct iommu_ops rk_iommu_ops = {
 	.default_domain_ops = &(const struct iommu_domain_ops) {
 		.attach_dev	= rk_iommu_attach_device,
 		.detach_dev	= rk_iommu_detach_device,
-		.map		= rk_iommu_map,
-		.unmap		= rk_iommu_unmap,
+		.map_pages	= rk_iommu_map_pages,
+		.unmap_pages	= rk_iommu_unmap_pages,
+		.iotlb_sync_map	= rk_iommu_iotlb_sync_map,
+		.iotlb_sync	= rk_iommu_iotlb_sync,
 		.flush_iotlb_all= rk_iommu_flush_tlb_all,
 		.iova_to_phys	= rk_iommu_iova_to_phys,
 		.free		= rk_iommu_domain_free,
 	}
 };
 
+/*
+ * Masters of one pipeline can put "rockchip,iommu-share-id = <n>" on their
+ * iommus. All iommus with the same id end up in one iommu group, so the
+ * DMA API gives them one default domain: a single set of page tables is
+ * written for each mapping and every iommu of the group points its DTE
+ * address at it. The domain keeps the list of attached iommus, zaps go to
+ * all of them while stall/paging stay per iommu. Only masters that use
+ * the default domain may share, iommu_attach_device() needs a singleton
+ * group.
+ */
+static struct iommu_group *rk_iommu_share_group(struct rk_iommu *iommu)
+{
+	struct iommu_group *group = NULL;
+	struct rk_iommu *other;
+
+	if (!iommu->opt_ops)
+		device_property_read_u32(iommu->dev, "rockchip,iommu-share-id",
+					 &iommu->share_id);
+	if (!iommu->share_id)
+		return iommu_group_alloc();
+
+	mutex_lock(&rk_iommu_share_lock);
+	list_for_each_entry(other, &rk_iommu_share_list, share_node) {
+		if (other->share_id == iommu->share_id) {
+			group = iommu_group_ref_get(other->group);
+			break;
+		}
+	}
+	mutex_unlock(&rk_iommu_share_lock);
+
+	if (group) {
+		dev_info(iommu->dev, "share iommu group %d with %s\n",
+			 iommu->share_id, dev_name(other->dev));
+		return group;
+	}
+
+	return iommu_group_alloc();
+}
+
+static int rk_iommu_stats_show(struct seq_file *s, void *v)
+{
+	struct rk_iommu *iommu = s->private;
+	struct rk_iommu_domain_stats dstats = { 0 };
+	struct rk_iommu_domain *rk_domain;
+	struct iommu_domain *domain;
+	unsigned long flags;
+
+	/* the shown domain may be shared with other iommus */
+	domain = iommu->domain;
+	if (domain) {
+		rk_domain = to_rk_domain(domain);
+		spin_lock_irqsave(&rk_domain->dt_lock, flags);
+		dstats = rk_domain->stats;
+		spin_unlock_irqrestore(&rk_domain->dt_lock, flags);
+	}
+
+	seq_printf(s, "map: %llu calls %llu pages\n", dstats.map_count,
+		   dstats.map_bytes / SPAGE_SIZE);
+	seq_printf(s, "unmap: %llu calls %llu pages\n", dstats.unmap_count,
+		   dstats.unmap_bytes / SPAGE_SIZE);
+	seq_printf(s, "page table: %u tables %u KiB\n", dstats.pt_count,
+		   (dstats.pt_count + 1) * SPAGE_SIZE / SZ_1K);
+	seq_printf(s, "zap: %llu cmds %llu us\n", iommu->stats.zap_count,
+		   div_u64(iommu->stats.zap_ns, NSEC_PER_USEC));
+	seq_printf(s, "fault: %llu page %llu bus\n", iommu->stats.fault_count,
+		   iommu->stats.bus_error_count);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rk_iommu_stats);
+
+static void rk_iommu_debugfs_init(struct rk_iommu *iommu)
+{
+	if (!rk_iommu_debugfs_root)
+		rk_iommu_debugfs_root = debugfs_create_dir("rk_iommu", NULL);
+
+	debugfs_create_file(dev_name(iommu->dev), 0444, rk_iommu_debugfs_root,
+			    iommu, &rk_iommu_stats_fops);
+}
+
 static int rk_iommu_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -1641,7 +1849,7 @@ static int rk_iommu_probe(struct platform_device *pdev)
 		return err;
 
 alloc_group:
-	iommu->group = iommu_group_alloc();
+	iommu->group = rk_iommu_share_group(iommu);
 	if (IS_ERR(iommu->group)) {
 		err = PTR_ERR(iommu->group);
 		goto err_unprepare_clocks;
@@ -1701,6 +1909,14 @@ static int rk_iommu_probe(struct platform_device *pdev)
 
 	dma_set_mask_and_coherent(dev, rk_ops->dma_bit_mask);
 
+	if (iommu->share_id) {
+		mutex_lock(&rk_iommu_share_lock);
+		list_add_tail(&iommu->share_node, &rk_iommu_share_list);
+		mutex_unlock(&rk_iommu_share_lock);
+	}
+
+	rk_iommu_debugfs_init(iommu);
+
 	return 0;
 err_pm_disable:
 	pm_runtime_disable(dev);
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd
+ *
+ * Tracepoints for rockchip iommu iotlb zaps and faults
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rk_iommu
+
+#if !defined(__ROCKCHIP_IOMMU_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __ROCKCHIP_IOMMU_TRACE_H__
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+/* iotlb zapped line by line for [iova, iova + size), or entirely if full */
+TRACE_EVENT(rk_iommu_zap,
+	TP_PROTO(struct device *dev, dma_addr_t iova, size_t size, bool full,
+		 u64 ns),
+	TP_ARGS(dev, iova, size, full, ns),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u64, iova)
+		__field(size_t, size)
+		__field(bool, full)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__entry->iova = iova;
+		__entry->size = size;
+		__entry->full = full;
+		__entry->ns = ns;
+	),
+
+	TP_printk("%s iova=0x%llx size=%zu full=%d ns=%llu",
+		  __get_str(dev), __entry->iova, __entry->size,
+		  __entry->full, __entry->ns)
+);
+
+/* page fault or bus error, also when the master handles the irq */
+TRACE_EVENT(rk_iommu_fault,
+	TP_PROTO(struct device *dev, dma_addr_t iova, u32 int_status, u32 status),
+	TP_ARGS(dev, iova, int_status, status),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u64, iova)
+		__field(u32, int_status)
+		__field(u32, status)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__entry->iova = iova;
+		__entry->int_status = int_status;
+		__entry->status = status;
+	),
+
+	TP_printk("%s iova=0x%llx int_status=%#x status=%#x",
+		  __get_str(dev), __entry->iova, __entry->int_status,
+		  __entry->status)
+);
+
+#endif /* __ROCKCHIP_IOMMU_TRACE_H__ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rockchip_iommu_trace
+
+#include <trace/define_trace.h>
@@ -19,6 +19,7 @@
 #include <media/videobuf2-dma-sg.h>
 #include <soc/rockchip/rockchip-system-status.h>
 #include <soc/rockchip/rockchip_iommu.h>
+#include <soc/rockchip/rockchip_media_trace.h>
 #include <linux/rk-isp32-config.h>
 #include <linux/dma-fence.h>
 #include <linux/sync_file.h>
@@ -1621,7 +1622,7 @@ static int rkcif_assign_new_buffer_oneframe(struct rkcif_stream *stream,
 			rkcif_write_register(dev, CIF_REG_DVP_FRM0_ADDR_UV,
 					     stream->curr_buf->buff_addr[RKCIF_PLANE_CBCR]);
 		} else {
-			if (dummy_buf->vaddr) {
+			if (dummy_buf->mem_priv) {
 				rkcif_write_register(dev, CIF_REG_DVP_FRM0_ADDR_Y,
 						     dummy_buf->dma_addr);
 				rkcif_write_register(dev, CIF_REG_DVP_FRM0_ADDR_UV,
@@ -1643,7 +1644,7 @@ static int rkcif_assign_new_buffer_oneframe(struct rkcif_stream *stream,
 			rkcif_write_register(dev, CIF_REG_DVP_FRM1_ADDR_UV,
 					     stream->next_buf->buff_addr[RKCIF_PLANE_CBCR]);
 		} else {
-			if (dummy_buf->vaddr) {
+			if (dummy_buf->mem_priv) {
 				rkcif_write_register(dev, CIF_REG_DVP_FRM1_ADDR_Y,
 						     dummy_buf->dma_addr);
 				rkcif_write_register(dev, CIF_REG_DVP_FRM1_ADDR_UV,
@@ -1664,9 +1665,9 @@ static int rkcif_assign_new_buffer_oneframe(struct rkcif_stream *stream,
 				buffer = stream->next_buf;
 			}
 		} else {
-			if (dummy_buf->vaddr && stream->frame_phase == CIF_CSI_FRAME0_READY)
+			if (dummy_buf->mem_priv && stream->frame_phase == CIF_CSI_FRAME0_READY)
 				stream->curr_buf = NULL;
-			if (dummy_buf->vaddr && stream->frame_phase == CIF_CSI_FRAME1_READY)
+			if (dummy_buf->mem_priv && stream->frame_phase == CIF_CSI_FRAME1_READY)
 				stream->next_buf = NULL;
 			buffer = NULL;
 		}
@@ -1684,7 +1685,7 @@ static int rkcif_assign_new_buffer_oneframe(struct rkcif_stream *stream,
 			rkcif_write_register(dev, frm_addr_uv,
 					     buffer->buff_addr[RKCIF_PLANE_CBCR]);
 		} else {
-			if (dummy_buf->vaddr) {
+			if (dummy_buf->mem_priv) {
 				rkcif_write_register(dev, frm_addr_y,
 					     dummy_buf->dma_addr);
 				rkcif_write_register(dev, frm_addr_uv,
@@ -2263,7 +2264,7 @@ static int rkcif_assign_new_buffer_update_toisp(struct rkcif_stream *stream,
 			goto out_get_buf;
 		if (stream->lack_buf_cnt < 2)
 			stream->lack_buf_cnt++;
-		if (dev->hw_dev->dummy_buf.vaddr) {
+		if (dev->hw_dev->dummy_buf.mem_priv) {
 			if (stream->frame_phase == CIF_CSI_FRAME0_READY) {
 				active_buf = stream->curr_buf_toisp;
 			} else {
@@ -2309,7 +2310,7 @@ static int rkcif_assign_new_buffer_update_toisp(struct rkcif_stream *stream,
 				rkcif_rdbk_frame_end_toisp(stream, active_buf);
 			}
 		} else {
-			if (stream->cifdev->rdbk_debug && dev->hw_dev->dummy_buf.vaddr)
+			if (stream->cifdev->rdbk_debug && dev->hw_dev->dummy_buf.mem_priv)
 				v4l2_info(&stream->cifdev->v4l2_dev,
 					  "stream[%d] loss frame %d\n",
 					  stream->id,
@@ -2335,7 +2336,7 @@ static int rkcif_assign_new_buffer_update_toisp(struct rkcif_stream *stream,
 				  stream->id,
 				  stream->frame_idx - 1,
 				  frm_addr_y, (u32)buffer->dummy.dma_addr);
-	} else if (dev->hw_dev->dummy_buf.vaddr && priv &&
+	} else if (dev->hw_dev->dummy_buf.mem_priv && priv &&
 		   priv->mode.rdbk_mode == RKISP_VICAP_RDBK_AUTO) {
 		buff_addr_y = dev->hw_dev->dummy_buf.dma_addr;
 		if (capture_info->mode == RKMODULE_MULTI_DEV_COMBINE_ONE) {
@@ -2555,7 +2556,7 @@ static void rkcif_assign_new_buffer_init(struct rkcif_stream *stream,
 						     stream->curr_buf->buff_addr[RKCIF_PLANE_CBCR]);
 		}
 	} else {
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			buff_addr_y = dummy_buf->dma_addr;
 			buff_addr_cbcr = dummy_buf->dma_addr;
 			if (channel->capture_info.mode == RKMODULE_MULTI_DEV_COMBINE_ONE) {
@@ -2611,7 +2612,7 @@ static void rkcif_assign_new_buffer_init(struct rkcif_stream *stream,
 			}
 		}
 
-		if (!stream->next_buf && dummy_buf->vaddr) {
+		if (!stream->next_buf && dummy_buf->mem_priv) {
 			buff_addr_y = dummy_buf->dma_addr;
 			buff_addr_cbcr = dummy_buf->dma_addr;
 			if (channel->capture_info.mode == RKMODULE_MULTI_DEV_COMBINE_ONE) {
@@ -2765,7 +2766,7 @@ static int rkcif_assign_new_buffer_update(struct rkcif_stream *stream,
 			stream->next_buf = NULL;
 	} else if (!list_empty(&buf_stream->buf_head)) {
 
-		if (!dummy_buf->vaddr &&
+		if (!dummy_buf->mem_priv &&
 		    stream->curr_buf == stream->next_buf &&
 		    rkcif_get_interlace_mode(stream) != RKCIF_INTERLACE_SOFT)
 			ret = -EINVAL;
@@ -2807,7 +2808,7 @@ static int rkcif_assign_new_buffer_update(struct rkcif_stream *stream,
 		}
 	} else {
 		buffer = NULL;
-		if (!(stream->cur_stream_mode & RKCIF_STREAM_MODE_TOISP) && dummy_buf->vaddr) {
+		if (!(stream->cur_stream_mode & RKCIF_STREAM_MODE_TOISP) && dummy_buf->mem_priv) {
 			if (stream->frame_phase == CIF_CSI_FRAME0_READY) {
 				stream->curr_buf  = NULL;
 			} else if (stream->frame_phase == CIF_CSI_FRAME1_READY) {
@@ -2946,7 +2947,7 @@ static int rkcif_get_new_buffer_wake_up_mode(struct rkcif_stream *stream)
 
 	spin_lock_irqsave(&stream->vbq_lock, flags);
 	if (!list_empty(&stream->buf_head)) {
-		if (!dummy_buf->vaddr &&
+		if (!dummy_buf->mem_priv &&
 		    stream->curr_buf == stream->next_buf)
 			ret = -EINVAL;
 		if (stream->line_int_cnt % 2) {
@@ -2965,7 +2966,7 @@ static int rkcif_get_new_buffer_wake_up_mode(struct rkcif_stream *stream)
 			stream->lack_buf_cnt--;
 	} else {
 		stream->is_buf_active = false;
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			if (stream->line_int_cnt % 2)
 				stream->curr_buf = NULL;
 			else
@@ -3048,7 +3049,7 @@ static int rkcif_update_new_buffer_wake_up_mode(struct rkcif_stream *stream)
 				rkcif_write_register(dev, frm_addr_uv, buff_addr_cbcr);
 		}
 	} else {
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			buff_addr_y = dummy_buf->dma_addr;
 			buff_addr_cbcr = dummy_buf->dma_addr;
 			if (capture_info->mode == RKMODULE_MULTI_DEV_COMBINE_ONE) {
@@ -3174,7 +3175,7 @@ static void rkcif_assign_dummy_buffer(struct rkcif_stream *stream)
 	/* for BT.656/BT.1120 multi channels function,
 	 * yuv addr of unused channel must be set
 	 */
-	if (mbus_cfg->type == V4L2_MBUS_BT656 && dummy_buf->vaddr) {
+	if (mbus_cfg->type == V4L2_MBUS_BT656 && dummy_buf->mem_priv) {
 		rkcif_write_register(dev,
 				     get_dvp_reg_index_of_frm0_y_addr(stream->id),
 				     dummy_buf->dma_addr);
@@ -3247,7 +3248,7 @@ static void rkcif_assign_new_buffer_init_rockit(struct rkcif_stream *stream,
 			rkcif_write_register(dev, frm0_addr_uv,
 					     stream->curr_buf_rockit->buff_addr[RKCIF_PLANE_CBCR]);
 	} else {
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			rkcif_write_register(dev, frm0_addr_y, dummy_buf->dma_addr);
 			if (stream->cif_fmt_out->fmt_type != CIF_FMT_TYPE_RAW)
 				rkcif_write_register(dev, frm0_addr_uv, dummy_buf->dma_addr);
@@ -3283,7 +3284,7 @@ static void rkcif_assign_new_buffer_init_rockit(struct rkcif_stream *stream,
 				rkcif_write_register(dev, frm1_addr_uv,
 						     stream->next_buf_rockit->buff_addr[RKCIF_PLANE_CBCR]);
 		} else {
-			if (dummy_buf->vaddr) {
+			if (dummy_buf->mem_priv) {
 				rkcif_write_register(dev, frm1_addr_y, dummy_buf->dma_addr);
 				if (stream->cif_fmt_out->fmt_type != CIF_FMT_TYPE_RAW)
 					rkcif_write_register(dev, frm1_addr_uv, dummy_buf->dma_addr);
@@ -3366,7 +3367,7 @@ static int rkcif_assign_new_buffer_update_rockit(struct rkcif_stream *stream,
 	spin_lock_irqsave(&stream->vbq_lock, flags);
 	if (!list_empty(&stream->rockit_buf_head)) {
 
-		if (!dummy_buf->vaddr &&
+		if (!dummy_buf->mem_priv &&
 		    stream->curr_buf_rockit == stream->next_buf_rockit &&
 		    (rkcif_get_interlace_mode(stream) != RKCIF_INTERLACE_SOFT ||
 		     rkcif_get_interlace_mode(stream) == RKCIF_INTERLACE_SOFT_AUTO))
@@ -3404,7 +3405,7 @@ static int rkcif_assign_new_buffer_update_rockit(struct rkcif_stream *stream,
 		}
 	} else {
 		buffer = NULL;
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			if (stream->frame_phase == CIF_CSI_FRAME0_READY) {
 				stream->curr_buf_rockit  = NULL;
 			} else if (stream->frame_phase == CIF_CSI_FRAME1_READY) {
@@ -3451,7 +3452,7 @@ static int rkcif_assign_new_buffer_update_rockit(struct rkcif_stream *stream,
 						     buffer->buff_addr[RKCIF_PLANE_CBCR]);
 		}
 	} else {
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			rkcif_write_register(dev, frm_addr_y, dummy_buf->dma_addr);
 			if (stream->cif_fmt_out->fmt_type != CIF_FMT_TYPE_RAW)
 				rkcif_write_register(dev, frm_addr_uv, dummy_buf->dma_addr);
@@ -3721,7 +3722,7 @@ static void rkcif_write_buffer(struct rkcif_stream *stream, struct rkcif_buffer
 			rkcif_write_register(dev, frm_addr_uv,
 				buffer->buff_addr[RKCIF_PLANE_CBCR] +
 				even_offset * (channel->virtual_width / 2));
-	} else if (dummy_buf->vaddr) {
+	} else if (dummy_buf->mem_priv) {
 		rkcif_write_register(dev, frm_addr_y, dummy_buf->dma_addr);
 		if (stream->cif_fmt_out->fmt_type != CIF_FMT_TYPE_RAW)
 			rkcif_write_register(dev, frm_addr_uv, dummy_buf->dma_addr);
@@ -3753,7 +3754,7 @@ static void rkcif_buf_init_interlace(struct rkcif_stream *stream, int channel_id
 		rkcif_write_buffer(stream, stream->curr_buf, CIF_CSI_FRAME0_READY, buf_offset);
 		rkcif_write_buffer(stream, stream->curr_buf, CIF_CSI_FRAME1_READY, buf_offset);
 	} else {
-		if (dummy_buf->vaddr) {
+		if (dummy_buf->mem_priv) {
 			rkcif_write_buffer(stream, NULL, CIF_CSI_FRAME0_READY, 0);
 			rkcif_write_buffer(stream, NULL, CIF_CSI_FRAME1_READY, 0);
 		} else {
@@ -4617,6 +4618,7 @@ static int rkcif_csi_stream_start(struct rkcif_stream *stream, unsigned int mode
 one_to_multi_skip:
 	if (stream->state != RKCIF_STATE_STREAMING) {
 		stream->line_int_cnt = 0;
+		stream->is_line_event_en = false;
 		if (stream->is_line_wake_up)
 			stream->is_can_stop = false;
 		else
@@ -5596,9 +5598,18 @@ static int rkcif_create_dummy_buf(struct rkcif_stream *stream)
 
 	dummy_buf->size = max_size;
 
-	dummy_buf->is_need_vaddr = true;
-	dummy_buf->is_need_dbuf = true;
-	ret = rkcif_alloc_buffer(dev, dummy_buf);
+	/*
+	 * The dummy only swallows frames nobody will read, with the iommu
+	 * a single page mapped over the whole frame size is enough and the
+	 * hw instance shared by all cif devices costs no frame sized memory.
+	 */
+	if (hw->iommu_en) {
+		ret = rkcif_alloc_page_dummy_buf(dev, dummy_buf);
+	} else {
+		dummy_buf->is_need_vaddr = true;
+		dummy_buf->is_need_dbuf = true;
+		ret = rkcif_alloc_buffer(dev, dummy_buf);
+	}
 	if (ret) {
 		v4l2_err(&dev->v4l2_dev,
 			 "Failed to allocate the memory for dummy buffer, size %d\n", max_size);
@@ -5616,7 +5627,9 @@ static void rkcif_destroy_dummy_buf(struct rkcif_stream *stream)
 	struct rkcif_device *dev = stream->cifdev;
 	struct rkcif_dummy_buffer *dummy_buf = &dev->hw_dev->dummy_buf;
 
-	if (dummy_buf->vaddr)
+	if (dev->hw_dev->iommu_en)
+		rkcif_free_page_dummy_buf(dev, dummy_buf);
+	else
 		rkcif_free_buffer(dev, dummy_buf);
 	dummy_buf->dma_addr = 0;
 	dummy_buf->vaddr = NULL;
@@ -5844,13 +5857,128 @@ static void rkcif_clean_state_one_to_multi_mode(struct rkcif_device *dev)
 	}
 }
 
+static void rkcif_monitor_reset_event(struct rkcif_device *dev);
+
+static void rkcif_start_group_work(struct work_struct *work)
+{
+	struct rkcif_stream *stream = container_of(work, struct rkcif_stream,
+						   start_work);
+	struct rkcif_device *dev = stream->cifdev;
+	int ret;
+
+	mutex_lock(&dev->stream_lock);
+	ret = dev->pipe.set_stream(&dev->pipe, true);
+	if (ret < 0) {
+		v4l2_err(&dev->v4l2_dev, "stream[%d] group start failed %d\n",
+			 stream->id, ret);
+		stream->start_state = RKCIF_START_FAILED;
+	} else {
+		stream->start_state = RKCIF_START_DONE;
+		rkcif_monitor_reset_event(dev);
+	}
+	mutex_unlock(&dev->stream_lock);
+}
+
+static int rkcif_set_start_group(struct rkcif_stream *stream,
+				 struct rkcif_start_group *cfg)
+{
+	struct rkcif_hw *hw = stream->cifdev->hw_dev;
+	int ret = 0;
+
+	if (cfg->group >= RKCIF_MAX_GROUP ||
+	    (cfg->group >= 0 &&
+	     (!cfg->stream_num || cfg->stream_num > RKCIF_START_GROUP_MAX)))
+		return -EINVAL;
+
+	mutex_lock(&hw->dev_lock);
+	if (stream->cur_stream_mode != RKCIF_STREAM_MODE_NONE) {
+		ret = -EBUSY;
+	} else if (cfg->group < 0) {
+		stream->start_group = -1;
+	} else {
+		stream->start_group = cfg->group;
+		hw->start_group[cfg->group].stream_num = cfg->stream_num;
+	}
+	mutex_unlock(&hw->dev_lock);
+
+	return ret;
+}
+
+/*
+ * Hold the sensor and phy bring-up of a grouped stream until the last
+ * member streams on, then run all of them at once, one worker each.
+ */
+static bool rkcif_start_group_defer(struct rkcif_stream *stream)
+{
+	struct rkcif_device *dev = stream->cifdev;
+	struct rkcif_hw *hw = dev->hw_dev;
+	struct rkcif_start_group_config *group;
+	int i;
+
+	if (stream->start_group < 0 || dev->is_camera_over_bridge)
+		return false;
+
+	mutex_lock(&hw->dev_lock);
+	group = &hw->start_group[stream->start_group];
+	stream->start_state = RKCIF_START_PENDING;
+	group->stream[group->pending_cnt++] = stream;
+	v4l2_dbg(1, rkcif_debug, &dev->v4l2_dev,
+		 "stream[%d] wait in start group %d, %d/%d\n", stream->id,
+		 stream->start_group, group->pending_cnt, group->stream_num);
+	if (group->pending_cnt >= group->stream_num) {
+		for (i = 0; i < group->pending_cnt; i++) {
+			group->stream[i]->start_state = RKCIF_START_QUEUED;
+			queue_work(system_unbound_wq, &group->stream[i]->start_work);
+		}
+		group->pending_cnt = 0;
+	}
+	mutex_unlock(&hw->dev_lock);
+
+	return true;
+}
+
+/* returns false if the deferred start never brought the pipeline up */
+static bool rkcif_start_group_leave(struct rkcif_stream *stream)
+{
+	struct rkcif_hw *hw = stream->cifdev->hw_dev;
+	struct rkcif_start_group_config *group;
+	bool is_started = true;
+	int i;
+
+	if (stream->start_state == RKCIF_START_IDLE)
+		return true;
+
+	mutex_lock(&hw->dev_lock);
+	if (stream->start_state == RKCIF_START_PENDING) {
+		group = &hw->start_group[stream->start_group];
+		for (i = 0; i < group->pending_cnt; i++) {
+			if (group->stream[i] != stream)
+				continue;
+			group->stream[i] = group->stream[--group->pending_cnt];
+			break;
+		}
+		stream->start_state = RKCIF_START_IDLE;
+		is_started = false;
+	}
+	mutex_unlock(&hw->dev_lock);
+
+	if (is_started) {
+		flush_work(&stream->start_work);
+		is_started = stream->start_state == RKCIF_START_DONE;
+		stream->start_state = RKCIF_START_IDLE;
+	}
+
+	return is_started;
+}
+
 void rkcif_do_stop_stream(struct rkcif_stream *stream,
 			  enum rkcif_stream_mode mode)
 {
 	struct rkcif_vdev_node *node = &stream->vnode;
 	struct rkcif_device *dev = stream->cifdev;
 	struct v4l2_device *v4l2_dev = &dev->v4l2_dev;
-	struct rkcif_buffer *buf = NULL;
+	struct rkcif_buffer *buf = NULL, *tmp;
+	struct llist_node *done;
 	int ret;
 	struct rkcif_hw *hw_dev = dev->hw_dev;
 	struct rkmodule_capture_info *capture_info = &dev->channels[0].capture_info;
@@ -5862,6 +5990,10 @@ void rkcif_do_stop_stream(struct rkcif_stream *stream,
 	u64 cur_time = 0;
 	u64 fs_time = 0;
 	int on = 0;
+	bool is_pipe_on = true;
+
+	if (mode == stream->cur_stream_mode)
+		is_pipe_on = rkcif_start_group_leave(stream);
 
 	mutex_lock(&dev->stream_lock);
 
@@ -5918,10 +6050,12 @@ void rkcif_do_stop_stream(struct rkcif_stream *stream,
 				v4l2_err(v4l2_dev, "camera over bridge stream-off failed error:%d\n",
 					 ret);
 		}
-		ret = dev->pipe.set_stream(&dev->pipe, false);
-		if (ret < 0)
-			v4l2_err(v4l2_dev, "pipeline stream-off failed error:%d\n",
-				 ret);
+		if (is_pipe_on) {
+			ret = dev->pipe.set_stream(&dev->pipe, false);
+			if (ret < 0)
+				v4l2_err(v4l2_dev, "pipeline stream-off failed error:%d\n",
+					 ret);
+		}
 
 		dev->is_start_hdr = false;
 		stream->is_dvp_yuv_addr_init = false;
@@ -5985,14 +6119,9 @@ void rkcif_do_stop_stream(struct rkcif_stream *stream,
 			}
 		}
 		INIT_LIST_HEAD(&stream->buf_head);
-		while (!list_empty(&stream->vb_done_list)) {
-			buf = list_first_entry(&stream->vb_done_list,
-					       struct rkcif_buffer, queue);
-			if (buf) {
-				list_del(&buf->queue);
-				vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
-			}
-		}
+		done = llist_del_all(&stream->vb_done_list);
+		llist_for_each_entry_safe(buf, tmp, done, done_node)
+			vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
 		stream->total_buf_num = 0;
 		atomic_set(&stream->buf_cnt, 0);
 		stream->lack_buf_cnt = 0;
@@ -6041,12 +6170,12 @@ void rkcif_do_stop_stream(struct rkcif_stream *stream,
 		}
 		if (atomic_read(&dev->pipe.stream_cnt) == 0)
 			atomic_set(&stream->sub_stream_buf_cnt, 0);
-		if (can_reset && hw_dev->dummy_buf.vaddr)
+		if (can_reset && hw_dev->dummy_buf.mem_priv)
 			rkcif_destroy_dummy_buf(stream);
 	}
 	if (mode == RKCIF_STREAM_MODE_CAPTURE) {
 		tasklet_disable(&stream->vb_done_tasklet);
-		INIT_LIST_HEAD(&stream->vb_done_list);
+		init_llist_head(&stream->vb_done_list);
 	}
 
 	if (mode == stream->cur_stream_mode)
@@ -7261,8 +7390,6 @@ static void rkcif_attach_sync_mode(struct rkcif_device *cifdev)
 	mutex_unlock(&hw->dev_lock);
 }
 
-static void rkcif_monitor_reset_event(struct rkcif_device *dev);
-
 int rkcif_do_start_stream(struct rkcif_stream *stream, enum rkcif_stream_mode mode)
 {
 	struct rkcif_vdev_node *node = &stream->vnode;
@@ -7278,6 +7405,7 @@ int rkcif_do_start_stream(struct rkcif_stream *stream, enum rkcif_stream_mode mo
 	int i = 0;
 	u32 skip_frame = 0;
 	int on = 1;
+	bool is_deferred = false;
 
 	v4l2_info(&dev->v4l2_dev, "stream[%d] start streaming\n", stream->id);
 
@@ -7377,7 +7505,7 @@ int rkcif_do_start_stream(struct rkcif_stream *stream, enum rkcif_stream_mode mo
 
 	if (((dev->active_sensor && dev->active_sensor->mbus.type == V4L2_MBUS_BT656) ||
 	     dev->is_use_dummybuf) &&
-	    (!dev->hw_dev->dummy_buf.vaddr) &&
+	    (!dev->hw_dev->dummy_buf.mem_priv) &&
 	    mode == RKCIF_STREAM_MODE_CAPTURE) {
 		ret = rkcif_create_dummy_buf(stream);
 		if (ret < 0) {
@@ -7452,9 +7580,13 @@ int rkcif_do_start_stream(struct rkcif_stream *stream, enum rkcif_stream_mode mo
 
 		if (sensor_info->mbus.type != V4L2_MBUS_PARALLEL &&
 		    rkmodule_stream_seq != RKMODULE_START_STREAM_FRONT) {
-			ret = dev->pipe.set_stream(&dev->pipe, true);
-			if (ret < 0)
-				goto stop_stream;
+			if (mode == RKCIF_STREAM_MODE_CAPTURE)
+				is_deferred = rkcif_start_group_defer(stream);
+			if (!is_deferred) {
+				ret = dev->pipe.set_stream(&dev->pipe, true);
+				if (ret < 0)
+					goto stop_stream;
+			}
 		}
 		if (dev->is_camera_over_bridge) {
 			ret = v4l2_subdev_call(dev->sditf[stream->id]->sensor_sd,
@@ -7487,7 +7619,8 @@ int rkcif_do_start_stream(struct rkcif_stream *stream, enum rkcif_stream_mode mo
 	}
 	dev->reset_work_cancel = false;
 	stream->cur_stream_mode |= mode;
-	rkcif_monitor_reset_event(dev);
+	if (!is_deferred)
+		rkcif_monitor_reset_event(dev);
 	goto out;
 
 stop_stream:
@@ -7761,6 +7894,8 @@ void rkcif_stream_init(struct rkcif_device *dev, u32 id)
 	spin_lock_init(&stream->fps_lock);
 	stream->state = RKCIF_STATE_READY;
 	init_waitqueue_head(&stream->wq_stopped);
+	INIT_WORK(&stream->start_work, rkcif_start_group_work);
+	stream->start_group = -1;
 
 	/* Set default format */
 	pixm.pixelformat = V4L2_PIX_FMT_NV12;
@@ -8578,9 +8713,16 @@ static long rkcif_ioctl_default(struct file *file, void *fh,
 		fps = *(struct rkcif_fps *)arg;
 		rkcif_set_fps(stream, &fps);
 		break;
+	case RKCIF_CMD_SET_LINE_WATERMARK:
+		if (*(unsigned int *)arg > 0x3fff)
+			return -EINVAL;
+		stream->line_watermark = *(unsigned int *)arg;
+		break;
 	case RKCIF_CMD_SET_RESET:
 		reset_src = *(int *)arg;
 		return rkcif_do_reset_work(dev, reset_src);
+	case RKCIF_CMD_SET_START_GROUP:
+		return rkcif_set_start_group(stream, (struct rkcif_start_group *)arg);
 	case RKCIF_CMD_SET_QUICK_STREAM:
 		stream_param = (struct rkcif_quick_stream_param *)arg;
 		if (!dev->sditf[0])
@@ -8758,6 +8900,14 @@ static int rkcif_dqbuf(struct file *file, void *priv, struct v4l2_buffer *p)
 	return ret;
 }
 
+static int rkcif_subscribe_event(struct v4l2_fh *fh,
+				 const struct v4l2_event_subscription *sub)
+{
+	if (sub->type == V4L2_EVENT_LINE_WATERMARK)
+		return v4l2_event_subscribe(fh, sub, RKCIF_V4L2_EVENT_ELEMS, NULL);
+	return -EINVAL;
+}
+
 static const struct v4l2_ioctl_ops rkcif_v4l2_ioctl_ops = {
 	.vidioc_reqbufs = vb2_ioctl_reqbufs,
 	.vidioc_querybuf = vb2_ioctl_querybuf,
@@ -8779,6 +8929,8 @@ static const struct v4l2_ioctl_ops rkcif_v4l2_ioctl_ops = {
 	.vidioc_enum_frameintervals = rkcif_enum_frameintervals,
 	.vidioc_enum_framesizes = rkcif_enum_framesizes,
 	.vidioc_default = rkcif_ioctl_default,
+	.vidioc_subscribe_event = rkcif_subscribe_event,
+	.vidioc_unsubscribe_event = v4l2_event_unsubscribe,
 };
 
 void rkcif_vb_done_oneframe(struct rkcif_stream *stream,
@@ -8793,6 +8945,15 @@ void rkcif_vb_done_oneframe(struct rkcif_stream *stream,
 				      stream->pixm.plane_fmt[i].sizeimage);
 	}
 
+	if (rk_media_trace_enabled() &&
+	    vb_done->vb2_buf.memory == VB2_MEMORY_DMABUF) {
+		struct dma_buf *dbuf = vb_done->vb2_buf.planes[0].dbuf;
+
+		/* the capture sequence is the frame id of the whole pipeline */
+		rk_media_buf_set_frame(dbuf, vb_done->sequence + 1);
+		rk_media_buf_trace(stream->cifdev->dev, dbuf, RK_MEDIA_DONE);
+	}
+
 	vb2_buffer_done(&vb_done->vb2_buf, VB2_BUF_STATE_DONE);
 	v4l2_dbg(2, rkcif_debug, &stream->cifdev->v4l2_dev,
 		 "stream[%d] vb done, index: %d, sequence %d\n", stream->id,
@@ -8813,18 +8974,12 @@ static void rkcif_vb_done_one_to_multi(struct rkcif_device *dev,
 static void rkcif_tasklet_handle(unsigned long data)
 {
 	struct rkcif_stream *stream = (struct rkcif_stream *)data;
-	struct rkcif_buffer *buf = NULL;
-	unsigned long flags = 0;
-	LIST_HEAD(local_list);
+	struct rkcif_buffer *buf = NULL, *tmp;
+	struct llist_node *done;
 
-	spin_lock_irqsave(&stream->vbq_lock, flags);
-	list_replace_init(&stream->vb_done_list, &local_list);
-	spin_unlock_irqrestore(&stream->vbq_lock, flags);
-
-	while (!list_empty(&local_list)) {
-		buf = list_first_entry(&local_list,
-				       struct rkcif_buffer, queue);
-		list_del(&buf->queue);
+	done = llist_del_all(&stream->vb_done_list);
+	done = llist_reverse_order(done);
+	llist_for_each_entry_safe(buf, tmp, done, done_node) {
 		atomic_dec(&stream->cifdev->stream[buf->id].sub_stream_buf_cnt);
 		if (stream->cifdev->channels[0].capture_info.mode == RKMODULE_ONE_CH_TO_MULTI_ISP)
 			rkcif_vb_done_one_to_multi(stream->cifdev, buf);
@@ -8833,16 +8988,18 @@ static void rkcif_tasklet_handle(unsigned long data)
 	}
 }
 
+/*
+ * Called from the frame end path of every virtual channel, the done
+ * list is lockless so that servicing all channels in one irq pass
+ * does not take vbq_lock a second time per channel, and the tasklet
+ * is only kicked by the first buffer queued since the last drain.
+ */
 void rkcif_vb_done_tasklet(struct rkcif_stream *stream, struct rkcif_buffer *buf)
 {
-	unsigned long flags = 0;
-
 	if (!stream || !buf)
 		return;
-	spin_lock_irqsave(&stream->vbq_lock, flags);
-	list_add_tail(&buf->queue, &stream->vb_done_list);
-	spin_unlock_irqrestore(&stream->vbq_lock, flags);
-	tasklet_schedule(&stream->vb_done_tasklet);
+	if (llist_add(&buf->done_node, &stream->vb_done_list))
+		tasklet_schedule(&stream->vb_done_tasklet);
 }
 
 static void rkcif_unregister_stream_vdev(struct rkcif_stream *stream)
@@ -8961,7 +9118,7 @@ static int rkcif_register_stream_vdev(struct rkcif_stream *stream,
 	if (ret < 0)
 		goto unreg;
 
-	INIT_LIST_HEAD(&stream->vb_done_list);
+	init_llist_head(&stream->vb_done_list);
 	tasklet_init(&stream->vb_done_tasklet,
 		     rkcif_tasklet_handle,
 		     (unsigned long)stream);
@@ -10221,7 +10378,7 @@ static void rkcif_line_wake_up_interlace(struct rkcif_stream *stream,
 
 	if (fe_interlaced_phase == CIF_CSI_FRAME1_READY &&
 	    stream->last_fe_interlaced_phase == CIF_CSI_FRAME0_READY) {
-		if (dummy_buf->vaddr ||  stream->next_buf) {
+		if (dummy_buf->mem_priv ||  stream->next_buf) {
 			active_buf = stream->curr_buf;
 			if (active_buf) {
 				active_buf->vb.vb2_buf.timestamp = stream->readout.fs_timestamp;
@@ -10497,7 +10654,7 @@ static void rkcif_update_stream_interlace(struct rkcif_device *cif_dev,
 	if (!stream->is_line_wake_up) {
 		if (fe_interlaced_phase == CIF_CSI_FRAME1_READY &&
 		    stream->last_fe_interlaced_phase == CIF_CSI_FRAME0_READY) {
-			if (dummy_buf->vaddr ||  stream->next_buf) {
+			if (dummy_buf->mem_priv ||  stream->next_buf) {
 				active_buf = stream->curr_buf;
 				if (active_buf) {
 					active_buf->vb.vb2_buf.timestamp = stream->readout.fs_timestamp;
@@ -11305,6 +11462,55 @@ static void rkcif_modify_line_int(struct rkcif_stream *stream, bool en)
 	}
 }
 
+/*
+ * Line watermark of a stream without line wake up: arm the line interrupt
+ * of the next frame at the watermark. It only queues the line event, the
+ * buffer is still done at frame end.
+ */
+static void rkcif_arm_line_event(struct rkcif_stream *stream)
+{
+	struct rkcif_device *cif_dev = stream->cifdev;
+	u32 reg, shift, val, line_intr_en;
+
+	if (!stream->line_watermark || stream->is_line_wake_up ||
+	    cif_dev->wait_line || stream->is_line_event_en ||
+	    stream->id > RKCIF_STREAM_MIPI_ID3)
+		return;
+
+	if (stream->id < RKCIF_STREAM_MIPI_ID2)
+		reg = CIF_REG_MIPI_LVDS_LINE_INT_NUM_ID0_1;
+	else
+		reg = CIF_REG_MIPI_LVDS_LINE_INT_NUM_ID2_3;
+	shift = (stream->id & 0x1) ? 16 : 0;
+	val = rkcif_read_register(cif_dev, reg);
+	val &= ~(0x3fff << shift);
+	val |= stream->line_watermark << shift;
+	rkcif_write_register(cif_dev, reg, val);
+	/* for line wake up to write its own line once turned on */
+	cif_dev->wait_line_bak = 0;
+
+	if (cif_dev->chip_id >= CHIP_RK3588_CIF)
+		line_intr_en = CSI_LINE_INTEN_RK3588(stream->id);
+	else
+		line_intr_en = CSI_LINE_INTEN(stream->id);
+	rkcif_write_register_or(cif_dev, CIF_REG_MIPI_LVDS_INTEN, line_intr_en);
+	stream->is_line_event_en = true;
+}
+
+static void rkcif_send_line_event(struct rkcif_stream *stream)
+{
+	struct rkcif_device *cif_dev = stream->cifdev;
+	struct v4l2_event event = {
+		.type = V4L2_EVENT_LINE_WATERMARK,
+	};
+	struct rkcif_line_event *data = (struct rkcif_line_event *)event.u.data;
+
+	data->sequence = stream->frame_idx - 1;
+	data->line = stream->is_line_inten ? cif_dev->wait_line : stream->line_watermark;
+	data->timestamp = rkcif_time_get_ns(cif_dev);
+	v4l2_event_queue(&stream->vnode.vdev, &event);
+}
+
 static void rkcif_detect_wake_up_mode_change(struct rkcif_stream *stream)
 {
 	struct rkcif_device *cif_dev = stream->cifdev;
@@ -12704,7 +12910,7 @@ static void rkcif_check_mipi_interlaced_frame_id(struct rkcif_stream *stream)
 				if (buffer) {
 					rkcif_write_buffer(stream, buffer, CIF_CSI_FRAME0_READY, buf_offset);
 					rkcif_write_buffer(stream, buffer, CIF_CSI_FRAME1_READY, buf_offset);
-				} else if (dummy_buf->vaddr) {
+				} else if (dummy_buf->mem_priv) {
 					stream->interlaced_bad_frame = true;
 					rkcif_write_buffer(stream, NULL, CIF_CSI_FRAME0_READY, buf_offset);
 					rkcif_write_buffer(stream, NULL, CIF_CSI_FRAME1_READY, buf_offset);
@@ -12736,7 +12942,7 @@ static void rkcif_check_mipi_interlaced_frame_id(struct rkcif_stream *stream)
 					buffer = stream->curr_buf;
 					rkcif_write_buffer(stream, buffer, CIF_CSI_FRAME0_READY, buf_offset);
 					rkcif_write_buffer(stream, buffer, CIF_CSI_FRAME1_READY, buf_offset);
-				} else if (dummy_buf->vaddr) {
+				} else if (dummy_buf->mem_priv) {
 					rkcif_write_buffer(stream, NULL, CIF_CSI_FRAME0_READY, buf_offset);
 					rkcif_write_buffer(stream, NULL, CIF_CSI_FRAME1_READY, buf_offset);
 					stream->interlaced_bad_frame = true;
@@ -13018,6 +13224,7 @@ void rkcif_irq_pingpong_v1(struct rkcif_device *cif_dev)
 				rkcif_scale_start(stream->scale_vdev);
 			}
 			rkcif_detect_wake_up_mode_change(stream);
+			rkcif_arm_line_event(stream);
 			if (cif_dev->chip_id < CHIP_RK3588_CIF &&
 			    mipi_id == RKCIF_STREAM_MIPI_ID0) {
 				if ((intstat & (CSI_FRAME1_START_ID0 | CSI_FRAME0_START_ID0)) == 0 &&
@@ -13072,6 +13279,8 @@ void rkcif_irq_pingpong_v1(struct rkcif_device *cif_dev)
 			}
 			if (intstat & CSI_LINE_INTSTAT_V1(i)) {
 				stream = &cif_dev->stream[i];
+				if (stream->is_line_inten || stream->is_line_event_en)
+					rkcif_send_line_event(stream);
 				if (stream->is_line_inten) {
 					stream->line_int_cnt++;
 					if (cif_dev->rdbk_debug > 1 &&
@@ -13088,6 +13297,9 @@ void rkcif_irq_pingpong_v1(struct rkcif_device *cif_dev)
 						rkcif_line_wake_up(stream, stream->id);
 					rkcif_modify_line_int(stream, false);
 					stream->is_line_inten = false;
+				} else if (stream->is_line_event_en) {
+					rkcif_modify_line_int(stream, false);
+					stream->is_line_event_en = false;
 				}
 				v4l2_dbg(3, rkcif_debug, &cif_dev->v4l2_dev,
 					 "%s: id0 cur line:%d\n", __func__, lastline & 0x3fff);
@@ -13305,6 +13517,7 @@ void rkcif_irq_pingpong(struct rkcif_device *cif_dev)
 			else
 				rkcif_update_stream(cif_dev, stream, mipi_id);
 			rkcif_detect_wake_up_mode_change(stream);
+			rkcif_arm_line_event(stream);
 			rkcif_monitor_reset_event(cif_dev);
 			if (mipi_id == RKCIF_STREAM_MIPI_ID0) {
 				if ((intstat & (CSI_FRAME1_START_ID0 | CSI_FRAME0_START_ID0)) == 0 &&
@@ -13340,6 +13553,8 @@ void rkcif_irq_pingpong(struct rkcif_device *cif_dev)
 			}
 			if (intstat & CSI_LINE_INTSTAT(i)) {
 				stream = &cif_dev->stream[i];
+				if (stream->is_line_inten || stream->is_line_event_en)
+					rkcif_send_line_event(stream);
 				if (stream->is_line_inten) {
 					stream->line_int_cnt++;
 					if (rkcif_get_interlace_mode(stream) == RKCIF_INTERLACE_SOFT_AUTO)
@@ -13348,6 +13563,9 @@ void rkcif_irq_pingpong(struct rkcif_device *cif_dev)
 						rkcif_line_wake_up(stream, stream->id);
 					rkcif_modify_line_int(stream, false);
 					stream->is_line_inten = false;
+				} else if (stream->is_line_event_en) {
+					rkcif_modify_line_int(stream, false);
+					stream->is_line_event_en = false;
 				}
 				v4l2_dbg(3, rkcif_debug, &cif_dev->v4l2_dev,
 					 "%s: id0 cur line:%d\n", __func__, lastline & 0x3fff);
@@ -3,6 +3,7 @@
 
 #include <linux/kfifo.h>
 #include <media/v4l2-common.h>
+#include <media/v4l2-event.h>
 #include <media/v4l2-ioctl.h>
 #include <media/videobuf2-core.h>
 #include <media/videobuf2-vmalloc.h>
@@ -21,6 +22,9 @@
 #define SW_Y_STAT_RD_ID(a)		(((a) & 0x3) << 4)
 #define SW_Y_STAT_RD_BLOCK(a)		(((a) & 0x3) << 6)
 
+#define RKCIF_LUMA_MD_THR_DEF		16
+#define RKCIF_LUMA_MD_THR_MAX		0xfff
+
 static int rkcif_luma_enum_fmt_meta_cap(struct file *file, void *priv,
 					struct v4l2_fmtdesc *f)
 {
@@ -66,6 +70,19 @@ static int rkcif_luma_querycap(struct file *file,
 	return 0;
 }
 
+static int rkcif_luma_subscribe_event(struct v4l2_fh *fh,
+				      const struct v4l2_event_subscription *sub)
+{
+	switch (sub->type) {
+	case V4L2_EVENT_MOTION_DET:
+		return v4l2_event_subscribe(fh, sub, RKCIF_LUMA_REQ_BUFS_MAX, NULL);
+	case V4L2_EVENT_CTRL:
+		return v4l2_ctrl_subscribe_event(fh, sub);
+	default:
+		return -EINVAL;
+	}
+}
+
 /* ISP video device IOCTLs */
 static const struct v4l2_ioctl_ops rkcif_luma_ioctl = {
 	.vidioc_reqbufs = vb2_ioctl_reqbufs,
@@ -81,7 +98,9 @@ static const struct v4l2_ioctl_ops rkcif_luma_ioctl = {
 	.vidioc_g_fmt_meta_cap = rkcif_luma_g_fmt_meta_cap,
 	.vidioc_s_fmt_meta_cap = rkcif_luma_g_fmt_meta_cap,
 	.vidioc_try_fmt_meta_cap = rkcif_luma_g_fmt_meta_cap,
-	.vidioc_querycap = rkcif_luma_querycap
+	.vidioc_querycap = rkcif_luma_querycap,
+	.vidioc_subscribe_event = rkcif_luma_subscribe_event,
+	.vidioc_unsubscribe_event = v4l2_event_unsubscribe,
 };
 
 static int rkcif_luma_fh_open(struct file *filp)
@@ -239,8 +258,10 @@ rkcif_stats_send_luma(struct rkcif_luma_vdev *vdev,
 	spin_unlock(&vdev->rd_lock);
 
 	if (!cur_buf) {
-		v4l2_warn(vdev->vnode.vdev.v4l2_dev,
-			  "no luma buffer available\n");
+		/* motion detection alone runs without any buffer queued */
+		if (!READ_ONCE(vdev->md_enable))
+			v4l2_warn(vdev->vnode.vdev.v4l2_dev,
+				  "no luma buffer available\n");
 		return;
 	}
 
@@ -269,6 +290,46 @@ rkcif_stats_send_luma(struct rkcif_luma_vdev *vdev,
 	vb2_buffer_done(&cur_buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
 }
 
+/*
+ * Compare the block means of the first exposure with the previous frame.
+ * Blocks whose mean moved by more than the threshold are set in the
+ * region mask of a motion event, so a battery camera can keep the isp and
+ * npu off until something changes in front of the sensor.
+ */
+static void rkcif_luma_motion_detect(struct rkcif_luma_vdev *vdev,
+				     struct rkcif_luma_readout_work *work)
+{
+	const u32 *mean = work->luma[0].exp_mean;
+	u32 thr = READ_ONCE(vdev->md_thr);
+	struct v4l2_event ev;
+	u32 mask = 0;
+	int i;
+
+	if (!READ_ONCE(vdev->md_enable)) {
+		vdev->md_prev_valid = false;
+		return;
+	}
+
+	if (vdev->md_prev_valid) {
+		for (i = 0; i < ISP2X_MIPI_LUMA_MEAN_MAX; i++) {
+			if (abs((int)mean[i] - (int)vdev->md_prev[i]) > thr)
+				mask |= BIT(i);
+		}
+	}
+	memcpy(vdev->md_prev, mean, sizeof(vdev->md_prev));
+	vdev->md_prev_valid = true;
+
+	if (!mask)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = V4L2_EVENT_MOTION_DET;
+	ev.u.motion_det.flags = V4L2_EVENT_MD_FL_HAVE_FRAME_SEQ;
+	ev.u.motion_det.frame_sequence = work->frame_id;
+	ev.u.motion_det.region_mask = mask;
+	v4l2_event_queue(&vdev->vnode.vdev, &ev);
+}
+
 static void rkcif_luma_readout_task(unsigned long data)
 {
 	unsigned int out = 0;
@@ -282,8 +343,10 @@ static void rkcif_luma_readout_task(unsigned long data)
 		if (!out)
 			break;
 
-		if (work.readout == RKCIF_READOUT_LUMA)
+		if (work.readout == RKCIF_READOUT_LUMA) {
+			rkcif_luma_motion_detect(vdev, &work);
 			rkcif_stats_send_luma(vdev, &work);
+		}
 	}
 }
 
@@ -423,6 +486,7 @@ void rkcif_start_luma(struct rkcif_luma_vdev *luma_vdev, const struct cif_input_
 
 	rkcif_write_register(luma_vdev->cifdev, CIF_REG_Y_STAT_CONTROL,
 			     SW_Y_STAT_BAYER_TYPE(bayer) | SW_Y_STAT_EN);
+	luma_vdev->md_prev_valid = false;
 	luma_vdev->enable = true;
 }
 
@@ -432,6 +496,56 @@ void rkcif_stop_luma(struct rkcif_luma_vdev *luma_vdev)
 	luma_vdev->enable = false;
 }
 
+static int rkcif_luma_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct rkcif_luma_vdev *luma_vdev =
+		container_of(ctrl->handler, struct rkcif_luma_vdev, ctrl_handler);
+
+	switch (ctrl->id) {
+	case V4L2_CID_DETECT_MD_MODE:
+		WRITE_ONCE(luma_vdev->md_enable,
+			   ctrl->val == V4L2_DETECT_MD_MODE_GLOBAL);
+		break;
+	case V4L2_CID_DETECT_MD_GLOBAL_THRESHOLD:
+		WRITE_ONCE(luma_vdev->md_thr, ctrl->val);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct v4l2_ctrl_ops rkcif_luma_ctrl_ops = {
+	.s_ctrl = rkcif_luma_s_ctrl,
+};
+
+static int rkcif_luma_init_ctrls(struct rkcif_luma_vdev *luma_vdev)
+{
+	struct v4l2_ctrl_handler *handler = &luma_vdev->ctrl_handler;
+
+	v4l2_ctrl_handler_init(handler, 2);
+	v4l2_ctrl_new_std_menu(handler, &rkcif_luma_ctrl_ops,
+			       V4L2_CID_DETECT_MD_MODE,
+			       V4L2_DETECT_MD_MODE_GLOBAL,
+			       ~(BIT(V4L2_DETECT_MD_MODE_DISABLED) |
+				 BIT(V4L2_DETECT_MD_MODE_GLOBAL)),
+			       V4L2_DETECT_MD_MODE_DISABLED);
+	v4l2_ctrl_new_std(handler, &rkcif_luma_ctrl_ops,
+			  V4L2_CID_DETECT_MD_GLOBAL_THRESHOLD,
+			  1, RKCIF_LUMA_MD_THR_MAX, 1, RKCIF_LUMA_MD_THR_DEF);
+	if (handler->error) {
+		int ret = handler->error;
+
+		v4l2_ctrl_handler_free(handler);
+		return ret;
+	}
+	luma_vdev->md_thr = RKCIF_LUMA_MD_THR_DEF;
+	luma_vdev->vnode.vdev.ctrl_handler = handler;
+
+	return 0;
+}
+
 static void rkcif_init_luma_vdev(struct rkcif_luma_vdev *luma_vdev)
 {
 	luma_vdev->vdev_fmt.fmt.meta.dataformat =
@@ -469,10 +583,14 @@ int rkcif_register_luma_vdev(struct rkcif_luma_vdev *luma_vdev,
 	rkcif_init_luma_vdev(luma_vdev);
 	video_set_drvdata(vdev, luma_vdev);
 
+	ret = rkcif_luma_init_ctrls(luma_vdev);
+	if (ret < 0)
+		goto err_release_queue;
+
 	node->pad.flags = MEDIA_PAD_FL_SINK;
 	ret = media_entity_pads_init(&vdev->entity, 0, &node->pad);
 	if (ret < 0)
-		goto err_release_queue;
+		goto err_free_ctrls;
 
 	ret = video_register_device(vdev, VFL_TYPE_VIDEO, -1);
 	if (ret < 0) {
@@ -502,6 +620,8 @@ int rkcif_register_luma_vdev(struct rkcif_luma_vdev *luma_vdev,
 	video_unregister_device(vdev);
 err_cleanup_media_entity:
 	media_entity_cleanup(&vdev->entity);
+err_free_ctrls:
+	v4l2_ctrl_handler_free(&luma_vdev->ctrl_handler);
 err_release_queue:
 	vb2_queue_release(vdev->queue);
 	return ret;
@@ -516,5 +636,6 @@ void rkcif_unregister_luma_vdev(struct rkcif_luma_vdev *luma_vdev)
 	tasklet_kill(&luma_vdev->rd_tasklet);
 	video_unregister_device(vdev);
 	media_entity_cleanup(&vdev->entity);
+	v4l2_ctrl_handler_free(&luma_vdev->ctrl_handler);
 	vb2_queue_release(vdev->queue);
 }
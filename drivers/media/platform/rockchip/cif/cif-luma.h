@@ -7,6 +7,7 @@
 #include <linux/rk-isp1-config.h>
 #include <linux/interrupt.h>
 #include <linux/kfifo.h>
+#include <media/v4l2-ctrls.h>
 #include "dev.h"
 
 #define RKCIF_LUMA_READOUT_WORK_SIZE	\
@@ -66,6 +67,13 @@ struct rkcif_luma_vdev {
 
 	bool ystat_rdflg[ISP2X_MIPI_RAW_MAX];
 	struct rkcif_luma_readout_work work;
+
+	/* motion detection on the luma block means, see V4L2_EVENT_MOTION_DET */
+	struct v4l2_ctrl_handler ctrl_handler;
+	bool md_enable;
+	u32 md_thr;
+	bool md_prev_valid;
+	u32 md_prev[ISP2X_MIPI_LUMA_MEAN_MAX];
 };
 
 void rkcif_start_luma(struct rkcif_luma_vdev *luma_vdev, const struct cif_input_fmt *cif_fmt_in);
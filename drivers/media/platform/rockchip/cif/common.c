@@ -98,7 +98,7 @@ void rkcif_free_buffer(struct rkcif_device *dev,
 	}
 }
 
-static int rkcif_alloc_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf)
+int rkcif_alloc_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf)
 {
 	struct rkcif_hw *hw = dev->hw_dev;
 	u32 i, n_pages = PAGE_ALIGN(buf->size) >> PAGE_SHIFT;
@@ -142,7 +142,7 @@ static int rkcif_alloc_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dum
 	return ret;
 }
 
-static void rkcif_free_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf)
+void rkcif_free_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf)
 {
 	struct sg_table *sg = buf->mem_priv;
 
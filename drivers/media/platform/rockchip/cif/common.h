@@ -20,6 +20,9 @@ int rkcif_alloc_buffer(struct rkcif_device *dev,
 void rkcif_free_buffer(struct rkcif_device *dev,
 			struct rkcif_dummy_buffer *buf);
 
+int rkcif_alloc_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf);
+void rkcif_free_page_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf);
+
 int rkcif_alloc_common_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf);
 void rkcif_free_common_dummy_buf(struct rkcif_device *dev, struct rkcif_dummy_buffer *buf);
 
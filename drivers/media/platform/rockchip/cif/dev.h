@@ -8,6 +8,7 @@
 #ifndef _RKCIF_DEV_H
 #define _RKCIF_DEV_H
 
+#include <linux/llist.h>
 #include <linux/mutex.h>
 #include <media/media-device.h>
 #include <media/media-entity.h>
@@ -129,6 +130,14 @@ enum rkcif_state {
 	RKCIF_STATE_RESET_IN_STREAMING,
 };
 
+enum rkcif_start_state {
+	RKCIF_START_IDLE,
+	RKCIF_START_PENDING,
+	RKCIF_START_QUEUED,
+	RKCIF_START_DONE,
+	RKCIF_START_FAILED,
+};
+
 enum rkcif_lvds_pad {
 	RKCIF_LVDS_PAD_SINK = 0x0,
 	RKCIF_LVDS_PAD_SRC_ID0,
@@ -191,6 +200,7 @@ struct rkcif_pipeline {
 struct rkcif_buffer {
 	struct vb2_v4l2_buffer vb;
 	struct list_head queue;
+	struct llist_node done_node;
 	union {
 		u32 buff_addr[VIDEO_MAX_PLANES];
 		void *vaddr[VIDEO_MAX_PLANES];
@@ -527,6 +537,7 @@ struct rkcif_stream {
 	enum rkcif_state		state;
 	wait_queue_head_t		wq_stopped;
 	unsigned int			frame_idx;
+	unsigned int			line_watermark;
 	int				frame_phase;
 	int				frame_phase_cache;
 	int				last_fs_interlaced_phase;
@@ -577,7 +588,7 @@ struct rkcif_stream {
 	unsigned int			buf_wake_up_cnt;
 	struct rkcif_skip_info		skip_info;
 	struct tasklet_struct		vb_done_tasklet;
-	struct list_head		vb_done_list;
+	struct llist_head		vb_done_list;
 	int				last_rx_buf_idx;
 	int				last_frame_idx;
 	int				new_fource_idx;
@@ -592,6 +603,9 @@ struct rkcif_stream {
 	atomic_t			sub_stream_buf_cnt;
 	struct rkcif_fence_context	fence_ctx;
 	struct rkcif_fence		*rkcif_fence;
+	struct work_struct		start_work;
+	enum rkcif_start_state		start_state;
+	int				start_group;
 	struct list_head		qbuf_fence_list_head;
 	struct list_head		done_fence_list_head;
 	spinlock_t			fence_lock;
@@ -603,6 +617,7 @@ struct rkcif_stream {
 	bool				is_fs_fe_not_paired;
 	bool				is_line_wake_up;
 	bool				is_line_inten;
+	bool				is_line_event_en;
 	bool				is_can_stop;
 	bool				is_buf_active;
 	bool				is_high_align;
@@ -26,6 +26,7 @@
 #define RKCIF_MAX_RESET		15
 
 #define RKCIF_MAX_GROUP		4
+#define RKCIF_START_GROUP_MAX	(RKCIF_DEV_MAX * RKCIF_MAX_STREAM_MIPI)
 
 #define write_cif_reg(base, addr, val) \
 	writel(val, (addr) + (base))
@@ -73,6 +74,13 @@ struct rkcif_multi_sync_config {
 	bool is_attach;
 };
 
+/* streams of a start group waiting for the last member to stream on */
+struct rkcif_start_group_config {
+	struct rkcif_stream *stream[RKCIF_START_GROUP_MAX];
+	int stream_num;
+	int pending_cnt;
+};
+
 struct rkcif_dummy_buffer {
 	struct vb2_buffer vb;
 	struct vb2_queue vb2_queue;
@@ -144,6 +152,7 @@ struct rkcif_hw {
 	const struct rkcif_hw_match_data *match_data;
 	struct mutex			dev_lock;
 	struct rkcif_multi_sync_config	sync_config[RKCIF_MAX_GROUP];
+	struct rkcif_start_group_config	start_group[RKCIF_MAX_GROUP];
 	spinlock_t			group_lock;
 	struct notifier_block		reset_notifier; /* reset for mipi csi crc err */
 	struct rkcif_dummy_buffer	dummy_buf;
@@ -33,6 +33,7 @@
 #include <linux/sync_file.h>
 #include <linux/v4l2-dv-timings.h>
 #include <linux/workqueue.h>
+#include <drm/drm_fourcc.h>
 #include <media/cec.h>
 #include <media/cec-notifier.h>
 #include <media/v4l2-common.h>
@@ -48,6 +49,7 @@
 #include <soc/rockchip/rockchip-system-status.h>
 #include <sound/hdmi-codec.h>
 #include <linux/rk_hdmirx_class.h>
+#include "../../../../gpu/drm/rockchip/rockchip_drm_ds_compositor.h"
 #include "rk_hdmirx.h"
 #include "rk_hdmirx_cec.h"
 #include "rk_hdmirx_hdcp.h"
@@ -60,6 +62,30 @@ static bool low_latency;
 module_param(low_latency, bool, 0644);
 MODULE_PARM_DESC(low_latency, "low_latency en(0-1)");
 
+static unsigned int slice_num;
+module_param(slice_num, uint, 0644);
+MODULE_PARM_DESC(slice_num, "slices per frame in low_latency mode (0-8)");
+
+static bool fast_switch;
+module_param(fast_switch, bool, 0644);
+MODULE_PARM_DESC(fast_switch, "keep streaming on resolution change if buffers fit (0-1)");
+
+static char *tunnel_plane;
+module_param(tunnel_plane, charp, 0644);
+MODULE_PARM_DESC(tunnel_plane, "show frames on this plane without userspace, e.g. Esmart1-win0");
+
+static char *tunnel_crtc;
+module_param(tunnel_crtc, charp, 0644);
+MODULE_PARM_DESC(tunnel_crtc, "crtc of tunnel_plane, default the first active one");
+
+static unsigned int tunnel_width = 1920;
+module_param(tunnel_width, uint, 0644);
+MODULE_PARM_DESC(tunnel_width, "tunnel output width, 64 aligned");
+
+static unsigned int tunnel_height = 1080;
+module_param(tunnel_height, uint, 0644);
+MODULE_PARM_DESC(tunnel_height, "tunnel output height");
+
 #define	RK_HDMIRX_DRVNAME		"rk_hdmirx"
 #define EDID_NUM_BLOCKS_MAX		2
 #define EDID_BLOCK_SIZE			128
@@ -74,6 +100,7 @@ MODULE_PARM_DESC(low_latency, "low_latency en(0-1)");
 #define INIT_FIFO_STATE			64
 #define RK_IRQ_HDMIRX_HDMI		210
 #define FILTER_FRAME_CNT		6
+#define HDMIRX_SLICE_MAX		8
 #define CPU_LIMIT_FREQ_KHZ		1200000
 #define WAIT_PHY_REG_TIME		50
 #define WAIT_TIMER_LOCK_TIME		50
@@ -203,6 +230,10 @@ struct hdmirx_stream {
 	u32 frame_idx;
 	u32 line_flag_int_cnt;
 	u32 irq_stat;
+	u32 delay_line;
+	u32 slice_idx;
+	u32 slice_cnt;
+	struct rockchip_ds_compositor *tunnel;
 };
 
 struct hdmirx_fence {
@@ -273,6 +304,7 @@ struct rk_hdmirx_dev {
 	bool cec_enable;
 	bool hpd_on;
 	bool force_off;
+	bool res_in_place;
 	u8 hdcp_enable;
 	u32 num_clks;
 	u32 edid_blocks_written;
@@ -574,6 +606,10 @@ static int hdmirx_subscribe_event(struct v4l2_fh *fh,
 	case RK_HDMIRX_V4L2_EVENT_SIGNAL_LOST:
 	case RK_HDMIRX_V4L2_EVENT_AUDIOINFO:
 		return v4l2_event_subscribe(fh, sub, 0, NULL);
+	case RK_HDMIRX_V4L2_EVENT_FMT_CHANGE:
+		return v4l2_event_subscribe(fh, sub, 0, NULL);
+	case RK_HDMIRX_V4L2_EVENT_SLICE:
+		return v4l2_event_subscribe(fh, sub, HDMIRX_SLICE_MAX, NULL);
 
 	default:
 		return v4l2_ctrl_subscribe_event(fh, sub);
@@ -1633,6 +1669,32 @@ static void hdmirx_controller_init(struct rk_hdmirx_dev *hdmirx_dev)
 			   CED_CHLOCKMAXER_QST(0x10));
 }
 
+/*
+ * With fast_switch the stream keeps running over a mode change as long as
+ * every buffer of the queue can hold a frame of the new format, userspace
+ * then gets RK_HDMIRX_V4L2_EVENT_FMT_CHANGE instead of a source change.
+ */
+static bool hdmirx_bufs_fit(struct hdmirx_stream *stream)
+{
+	struct vb2_queue *q = &stream->buf_queue;
+	struct v4l2_pix_format_mplane pixm = { 0 };
+	unsigned int i;
+
+	if (!vb2_is_streaming(q) || !q->num_buffers)
+		return false;
+
+	pixm.pixelformat = stream->hdmirx_dev->cur_fmt_fourcc;
+	hdmirx_set_fmt(stream, &pixm, true);
+	if (pixm.num_planes != 1)
+		return false;
+
+	for (i = 0; i < q->num_buffers; i++)
+		if (vb2_plane_size(q->bufs[i], 0) < pixm.plane_fmt[0].sizeimage)
+			return false;
+
+	return true;
+}
+
 static void hdmirx_format_change(struct rk_hdmirx_dev *hdmirx_dev)
 {
 	struct v4l2_dv_timings timings;
@@ -1659,6 +1721,11 @@ static void hdmirx_format_change(struct rk_hdmirx_dev *hdmirx_dev)
 	}
 
 	hdmirx_dev->get_timing = true;
+	hdmirx_dev->res_in_place = fast_switch && hdmirx_bufs_fit(stream);
+	if (hdmirx_dev->res_in_place) {
+		v4l2_dbg(1, debug, v4l2_dev, "%s: change res in place\n", __func__);
+		return;
+	}
 	v4l2_dbg(1, debug, v4l2_dev, "%s: queue res_chg_event\n", __func__);
 	v4l2_event_queue(&stream->vdev, &ev_src_chg);
 }
@@ -2137,6 +2204,16 @@ static int hdmirx_queue_setup(struct vb2_queue *queue,
 		v4l2_err(v4l2_dev, "%s: out_fmt null pointer err!\n", __func__);
 		return -EINVAL;
 	}
+	/* VIDIOC_CREATE_BUFS may ask for larger buffers to survive mode changes */
+	if (*num_planes) {
+		if (*num_planes != out_fmt->mplanes)
+			return -EINVAL;
+		for (i = 0; i < out_fmt->mplanes; i++)
+			if (sizes[i] < pixm->plane_fmt[i].sizeimage)
+				return -EINVAL;
+		return 0;
+	}
+
 	*num_planes = out_fmt->mplanes;
 	height = pixm->height;
 
@@ -2187,6 +2264,36 @@ static void hdmirx_qbuf_alloc_fence(struct rk_hdmirx_dev *hdmirx_dev)
 	}
 }
 
+static void hdmirx_buf_set_addr(struct hdmirx_stream *stream,
+				struct hdmirx_buffer *hdmirx_buf)
+{
+	struct vb2_buffer *vb = &hdmirx_buf->vb.vb2_buf;
+	struct v4l2_pix_format_mplane *pixm = &stream->pixm;
+	const struct hdmirx_output_fmt *out_fmt = stream->out_fmt;
+	int i;
+
+	memset(hdmirx_buf->buff_addr, 0, sizeof(hdmirx_buf->buff_addr));
+	/*
+	 * If mplanes > 1, every c-plane has its own m-plane,
+	 * otherwise, multiple c-planes are in the same m-plane
+	 */
+	for (i = 0; i < out_fmt->mplanes; i++)
+		hdmirx_buf->buff_addr[i] = vb2_dma_contig_plane_dma_addr(vb, i);
+
+	if (out_fmt->mplanes == 1) {
+		if (out_fmt->cplanes == 1) {
+			hdmirx_buf->buff_addr[HDMIRX_PLANE_CBCR] =
+				hdmirx_buf->buff_addr[HDMIRX_PLANE_Y];
+		} else {
+			for (i = 0; i < out_fmt->cplanes - 1; i++)
+				hdmirx_buf->buff_addr[i + 1] =
+					hdmirx_buf->buff_addr[i] +
+					pixm->plane_fmt[i].bytesperline *
+					pixm->height;
+		}
+	}
+}
+
 /*
  * The vb2_buffer are stored in hdmirx_buffer, in order to unify
  * mplane buffer and none-mplane buffer.
@@ -2197,10 +2304,7 @@ static void hdmirx_buf_queue(struct vb2_buffer *vb)
 	struct hdmirx_buffer *hdmirx_buf;
 	struct vb2_queue *queue;
 	struct hdmirx_stream *stream;
-	struct v4l2_pix_format_mplane *pixm;
-	const struct hdmirx_output_fmt *out_fmt;
 	unsigned long lock_flags = 0;
-	int i;
 	struct rk_hdmirx_dev *hdmirx_dev;
 	struct v4l2_device *v4l2_dev;
 
@@ -2213,32 +2317,11 @@ static void hdmirx_buf_queue(struct vb2_buffer *vb)
 	hdmirx_buf = to_hdmirx_buffer(vbuf);
 	queue = vb->vb2_queue;
 	stream = vb2_get_drv_priv(queue);
-	pixm = &stream->pixm;
-	out_fmt = stream->out_fmt;
 
 	hdmirx_dev = stream->hdmirx_dev;
 	v4l2_dev = &hdmirx_dev->v4l2_dev;
 
-	memset(hdmirx_buf->buff_addr, 0, sizeof(hdmirx_buf->buff_addr));
-	/*
-	 * If mplanes > 1, every c-plane has its own m-plane,
-	 * otherwise, multiple c-planes are in the same m-plane
-	 */
-	for (i = 0; i < out_fmt->mplanes; i++)
-		hdmirx_buf->buff_addr[i] = vb2_dma_contig_plane_dma_addr(vb, i);
-
-	if (out_fmt->mplanes == 1) {
-		if (out_fmt->cplanes == 1) {
-			hdmirx_buf->buff_addr[HDMIRX_PLANE_CBCR] =
-				hdmirx_buf->buff_addr[HDMIRX_PLANE_Y];
-		} else {
-			for (i = 0; i < out_fmt->cplanes - 1; i++)
-				hdmirx_buf->buff_addr[i + 1] =
-					hdmirx_buf->buff_addr[i] +
-					pixm->plane_fmt[i].bytesperline *
-					pixm->height;
-		}
-	}
+	hdmirx_buf_set_addr(stream, hdmirx_buf);
 
 	v4l2_dbg(4, debug, v4l2_dev, "qbuf fd:%d\n", vb->planes[0].m.fd);
 
@@ -2297,6 +2380,105 @@ static void hdmirx_free_fence(struct rk_hdmirx_dev *hdmirx_dev)
 	}
 }
 
+static u32 hdmirx_tunnel_drm_format(u32 fourcc)
+{
+	switch (fourcc) {
+	case V4L2_PIX_FMT_BGR24:
+		return DRM_FORMAT_RGB888;
+	case V4L2_PIX_FMT_NV16:
+		return DRM_FORMAT_NV16;
+	case V4L2_PIX_FMT_NV12:
+		return DRM_FORMAT_NV12;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Called by the compositor once it no longer reads the frame, the buffer
+ * goes straight back to the capture list and is never seen by userspace.
+ */
+static void hdmirx_tunnel_release(struct rockchip_ds_frame *frame, void *priv)
+{
+	struct hdmirx_buffer *buf = priv;
+	struct hdmirx_stream *stream = vb2_get_drv_priv(buf->vb.vb2_buf.vb2_queue);
+	unsigned long lock_flags = 0;
+
+	spin_lock_irqsave(&stream->vbq_lock, lock_flags);
+	/* the format may have changed in place while the frame was shown */
+	hdmirx_buf_set_addr(stream, buf);
+	list_add_tail(&buf->queue, &stream->buf_head);
+	spin_unlock_irqrestore(&stream->vbq_lock, lock_flags);
+}
+
+static int hdmirx_tunnel_queue(struct hdmirx_stream *stream,
+			       struct vb2_v4l2_buffer *vb_done)
+{
+	struct rockchip_ds_frame frame = { 0 };
+
+	frame.dmabuf = vb_done->vb2_buf.planes[0].dbuf;
+	frame.width = stream->pixm.width;
+	frame.height = stream->pixm.height;
+	frame.stride = stream->pixm.plane_fmt[0].bytesperline * 8 /
+		       stream->out_fmt->bpp[0];
+	frame.pixel_format = hdmirx_tunnel_drm_format(stream->pixm.pixelformat);
+	frame.release = hdmirx_tunnel_release;
+	frame.priv = to_hdmirx_buffer(vb_done);
+
+	return rockchip_ds_compositor_queue_frame(stream->tunnel, &frame);
+}
+
+static void hdmirx_tunnel_start(struct hdmirx_stream *stream)
+{
+	struct rk_hdmirx_dev *hdmirx_dev = stream->hdmirx_dev;
+	struct v4l2_device *v4l2_dev = &hdmirx_dev->v4l2_dev;
+	struct rockchip_ds_compositor_config config = { 0 };
+	struct rockchip_ds_compositor *comp;
+
+	if (!tunnel_plane || !tunnel_plane[0])
+		return;
+
+	/* low latency hands out the frame before it is written completely */
+	if (low_latency || stream->buf_queue.memory != VB2_MEMORY_DMABUF ||
+	    !hdmirx_tunnel_drm_format(stream->pixm.pixelformat)) {
+		v4l2_err(v4l2_dev, "%s: tunnel needs dmabuf and nv12/nv16/bgr24 w/o low_latency\n",
+			 __func__);
+		return;
+	}
+
+	config.crtc_name = tunnel_crtc && tunnel_crtc[0] ? tunnel_crtc : NULL;
+	config.plane_name = tunnel_plane;
+	config.width = tunnel_width;
+	config.height = tunnel_height;
+	config.pixel_format = DRM_FORMAT_NV12;
+	config.top_zpos = true;
+
+	comp = rockchip_ds_compositor_create(&config);
+	if (IS_ERR(comp)) {
+		v4l2_err(v4l2_dev, "%s: failed to tunnel to %s: %ld\n",
+			 __func__, tunnel_plane, PTR_ERR(comp));
+		return;
+	}
+
+	stream->tunnel = comp;
+	v4l2_info(v4l2_dev, "%s: tunnel to %s %dx%d\n", __func__,
+		  tunnel_plane, tunnel_width, tunnel_height);
+}
+
+static void hdmirx_tunnel_stop(struct hdmirx_stream *stream)
+{
+	struct rk_hdmirx_dev *hdmirx_dev = stream->hdmirx_dev;
+
+	if (!stream->tunnel)
+		return;
+
+	/* the dma irq is off, make sure no handler still queues frames */
+	synchronize_irq(hdmirx_dev->dma_irq);
+	/* frames held by the compositor are released back to buf_head */
+	rockchip_ds_compositor_destroy(stream->tunnel);
+	stream->tunnel = NULL;
+}
+
 static void return_all_buffers(struct hdmirx_stream *stream,
 			       enum vb2_buffer_state state)
 {
@@ -2355,6 +2537,7 @@ static void hdmirx_stop_streaming(struct vb2_queue *queue)
 			   FIFO_OVERFLOW_INT_EN |
 			   FIFO_UNDERFLOW_INT_EN |
 			   HDMIRX_AXI_ERROR_INT_EN, 0);
+	hdmirx_tunnel_stop(stream);
 	return_all_buffers(stream, VB2_BUF_STATE_ERROR);
 	sip_hdmirx_config(HDMIRX_INFO_NOTIFY, 0, DMA_CONFIG6, 0);
 	sip_hdmirx_config(HDMIRX_AUTO_TOUCH_EN, 0, 0, 0);
@@ -2362,58 +2545,20 @@ static void hdmirx_stop_streaming(struct vb2_queue *queue)
 	v4l2_info(v4l2_dev, "stream stopping finished\n");
 }
 
-static int hdmirx_start_streaming(struct vb2_queue *queue, unsigned int count)
+/* Start the dma into curr_buf with the current timings. */
+static void hdmirx_start_dma(struct hdmirx_stream *stream)
 {
-	struct hdmirx_stream *stream = vb2_get_drv_priv(queue);
 	struct rk_hdmirx_dev *hdmirx_dev = stream->hdmirx_dev;
 	struct v4l2_device *v4l2_dev = &hdmirx_dev->v4l2_dev;
-	unsigned long lock_flags = 0;
 	struct v4l2_dv_timings timings = hdmirx_dev->timings;
 	struct v4l2_bt_timings *bt = &timings.bt;
 	int line_flag;
 	int delay_line;
-	uint32_t touch_flag;
-
-	if (!hdmirx_dev->get_timing) {
-		v4l2_err(v4l2_dev, "Err, timing is invalid\n");
-		return 0;
-	}
-
-	if (signal_not_lock(hdmirx_dev)) {
-		v4l2_err(v4l2_dev, "%s: signal is not locked, retry!\n", __func__);
-		process_signal_change(hdmirx_dev);
-		return 0;
-	}
-
-	mutex_lock(&hdmirx_dev->stream_lock);
-	touch_flag = (hdmirx_dev->phy_cpuid << 1) | 0x1;
-	sip_hdmirx_config(HDMIRX_AUTO_TOUCH_EN, 0, touch_flag, 100);
-	stream->frame_idx = 0;
-	stream->line_flag_int_cnt = 0;
-	stream->curr_buf = NULL;
-	stream->next_buf = NULL;
-	stream->irq_stat = 0;
-	stream->stopping = false;
-
-	spin_lock_irqsave(&stream->vbq_lock, lock_flags);
-	if (!stream->curr_buf) {
-		if (!list_empty(&stream->buf_head)) {
-			stream->curr_buf = list_first_entry(&stream->buf_head,
-					struct hdmirx_buffer, queue);
-			list_del(&stream->curr_buf->queue);
-		} else {
-			stream->curr_buf = NULL;
-		}
-	}
-	spin_unlock_irqrestore(&stream->vbq_lock, lock_flags);
-
-	if (!stream->curr_buf) {
-		mutex_unlock(&hdmirx_dev->stream_lock);
-		return -ENOMEM;
-	}
 
+	stream->slice_idx = 0;
+	stream->slice_cnt = 0;
 	v4l2_dbg(2, debug, v4l2_dev,
-			"%s: start_stream cur_buf y_addr:%#x, uv_addr:%#x\n",
+			"%s: cur_buf y_addr:%#x, uv_addr:%#x\n",
 			__func__, stream->curr_buf->buff_addr[HDMIRX_PLANE_Y],
 			stream->curr_buf->buff_addr[HDMIRX_PLANE_CBCR]);
 	hdmirx_writel(hdmirx_dev, DMA_CONFIG2,
@@ -2432,7 +2577,13 @@ static int hdmirx_start_streaming(struct vb2_queue *queue, unsigned int count)
 		else
 			delay_line = line_flag * 2 / 3;
 
-		v4l2_info(v4l2_dev, "%s: delay_line:%d\n", __func__, delay_line);
+		/* slices follow the frame start line flag of low latency */
+		if (low_latency && bt->interlaced != V4L2_DV_INTERLACED &&
+		    slice_num > 1)
+			stream->slice_cnt = min_t(u32, slice_num, HDMIRX_SLICE_MAX);
+		stream->delay_line = delay_line;
+		v4l2_info(v4l2_dev, "%s: delay_line:%d slice:%d\n", __func__,
+			  delay_line, stream->slice_cnt);
 		hdmirx_update_bits(hdmirx_dev, DMA_CONFIG7,
 				LINE_FLAG_NUM_MASK,
 				LINE_FLAG_NUM(delay_line));
@@ -2460,6 +2611,128 @@ static int hdmirx_start_streaming(struct vb2_queue *queue, unsigned int count)
 			HDMIRX_AXI_ERROR_INT_EN);
 	hdmirx_update_bits(hdmirx_dev, DMA_CONFIG6, HDMIRX_DMA_EN, HDMIRX_DMA_EN);
 	v4l2_dbg(1, debug, v4l2_dev, "%s: enable dma", __func__);
+}
+
+/*
+ * Called once the new timings are locked after hdmirx_format_change() found
+ * that the buffers fit, the buffers are laid out again for the new format
+ * and the dma restarts without going through userspace.
+ */
+static void hdmirx_restart_stream(struct rk_hdmirx_dev *hdmirx_dev)
+{
+	struct hdmirx_stream *stream = &hdmirx_dev->stream;
+	struct v4l2_device *v4l2_dev = &hdmirx_dev->v4l2_dev;
+	struct v4l2_pix_format_mplane pixm = { 0 };
+	struct hdmirx_buffer *buf;
+	unsigned long lock_flags = 0;
+	struct v4l2_event ev = {
+		.type = RK_HDMIRX_V4L2_EVENT_FMT_CHANGE,
+	};
+	struct rk_hdmirx_fmt_change *fmt_chg = (struct rk_hdmirx_fmt_change *)ev.u.data;
+	const struct v4l2_event ev_src_chg = {
+		.type = V4L2_EVENT_SOURCE_CHANGE,
+		.u.src_change.changes = V4L2_EVENT_SRC_CH_RESOLUTION,
+	};
+
+	if (!hdmirx_dev->res_in_place)
+		return;
+	hdmirx_dev->res_in_place = false;
+
+	mutex_lock(&hdmirx_dev->stream_lock);
+	if (!vb2_is_streaming(&stream->buf_queue) || stream->stopping)
+		goto out;
+
+	pixm.pixelformat = hdmirx_dev->cur_fmt_fourcc;
+	hdmirx_set_fmt(stream, &pixm, false);
+
+	spin_lock_irqsave(&stream->vbq_lock, lock_flags);
+	if (stream->next_buf && stream->next_buf != stream->curr_buf)
+		list_add(&stream->next_buf->queue, &stream->buf_head);
+	if (stream->curr_buf)
+		list_add(&stream->curr_buf->queue, &stream->buf_head);
+	stream->curr_buf = NULL;
+	stream->next_buf = NULL;
+	list_for_each_entry(buf, &stream->buf_head, queue)
+		hdmirx_buf_set_addr(stream, buf);
+	if (!list_empty(&stream->buf_head)) {
+		stream->curr_buf = list_first_entry(&stream->buf_head,
+				struct hdmirx_buffer, queue);
+		list_del(&stream->curr_buf->queue);
+	}
+	spin_unlock_irqrestore(&stream->vbq_lock, lock_flags);
+
+	if (!stream->curr_buf) {
+		v4l2_err(v4l2_dev, "%s: no buffer, queue res_chg_event\n", __func__);
+		v4l2_event_queue(&stream->vdev, &ev_src_chg);
+		goto out;
+	}
+
+	stream->line_flag_int_cnt = 0;
+	stream->irq_stat = 0;
+	hdmirx_start_dma(stream);
+
+	fmt_chg->sequence = stream->frame_idx;
+	fmt_chg->width = stream->pixm.width;
+	fmt_chg->height = stream->pixm.height;
+	fmt_chg->pixelformat = stream->pixm.pixelformat;
+	fmt_chg->bytesperline = stream->pixm.plane_fmt[0].bytesperline;
+	fmt_chg->sizeimage = stream->pixm.plane_fmt[0].sizeimage;
+	v4l2_event_queue(&stream->vdev, &ev);
+	v4l2_info(v4l2_dev, "%s: %dx%d %p4cc from frame %d\n", __func__,
+		  fmt_chg->width, fmt_chg->height, &stream->pixm.pixelformat,
+		  fmt_chg->sequence);
+out:
+	mutex_unlock(&hdmirx_dev->stream_lock);
+}
+
+static int hdmirx_start_streaming(struct vb2_queue *queue, unsigned int count)
+{
+	struct hdmirx_stream *stream = vb2_get_drv_priv(queue);
+	struct rk_hdmirx_dev *hdmirx_dev = stream->hdmirx_dev;
+	struct v4l2_device *v4l2_dev = &hdmirx_dev->v4l2_dev;
+	unsigned long lock_flags = 0;
+	uint32_t touch_flag;
+
+	if (!hdmirx_dev->get_timing) {
+		v4l2_err(v4l2_dev, "Err, timing is invalid\n");
+		return 0;
+	}
+
+	if (signal_not_lock(hdmirx_dev)) {
+		v4l2_err(v4l2_dev, "%s: signal is not locked, retry!\n", __func__);
+		process_signal_change(hdmirx_dev);
+		return 0;
+	}
+
+	mutex_lock(&hdmirx_dev->stream_lock);
+	touch_flag = (hdmirx_dev->phy_cpuid << 1) | 0x1;
+	sip_hdmirx_config(HDMIRX_AUTO_TOUCH_EN, 0, touch_flag, 100);
+	stream->frame_idx = 0;
+	stream->line_flag_int_cnt = 0;
+	stream->curr_buf = NULL;
+	stream->next_buf = NULL;
+	stream->irq_stat = 0;
+	stream->stopping = false;
+
+	spin_lock_irqsave(&stream->vbq_lock, lock_flags);
+	if (!stream->curr_buf) {
+		if (!list_empty(&stream->buf_head)) {
+			stream->curr_buf = list_first_entry(&stream->buf_head,
+					struct hdmirx_buffer, queue);
+			list_del(&stream->curr_buf->queue);
+		} else {
+			stream->curr_buf = NULL;
+		}
+	}
+	spin_unlock_irqrestore(&stream->vbq_lock, lock_flags);
+
+	if (!stream->curr_buf) {
+		mutex_unlock(&hdmirx_dev->stream_lock);
+		return -ENOMEM;
+	}
+
+	hdmirx_tunnel_start(stream);
+	hdmirx_start_dma(stream);
 	mutex_unlock(&hdmirx_dev->stream_lock);
 
 	return 0;
@@ -3021,10 +3294,56 @@ static void hdmirx_vb_done(struct hdmirx_stream *stream,
 	}
 
 	vb_done->vb2_buf.timestamp = ktime_get_ns();
+	if (stream->tunnel && !hdmirx_tunnel_queue(stream, vb_done)) {
+		v4l2_dbg(4, debug, v4l2_dev, "tunnel fd:%d", vb_done->vb2_buf.planes[0].m.fd);
+		return;
+	}
 	vb2_buffer_done(&vb_done->vb2_buf, VB2_BUF_STATE_DONE);
 	v4l2_dbg(4, debug, v4l2_dev, "vb_done fd:%d", vb_done->vb2_buf.planes[0].m.fd);
 }
 
+static void hdmirx_set_slice_line(struct hdmirx_stream *stream)
+{
+	struct rk_hdmirx_dev *hdmirx_dev = stream->hdmirx_dev;
+	u32 line;
+
+	if (stream->slice_idx)
+		line = hdmirx_dev->timings.bt.height * stream->slice_idx /
+		       stream->slice_cnt;
+	else
+		line = stream->delay_line;
+
+	hdmirx_update_bits(hdmirx_dev, DMA_CONFIG7, LINE_FLAG_NUM_MASK,
+			   LINE_FLAG_NUM(line));
+}
+
+/*
+ * In low latency mode the line flag is moved through the frame after the
+ * buffer is handed out, each hit tells userspace how far the frame is
+ * written so an encoder can start on the first slices. The line flag goes
+ * back to delay_line for the next frame start after the last slice.
+ */
+static void hdmirx_slice_int_handler(struct hdmirx_stream *stream)
+{
+	struct rk_hdmirx_dev *hdmirx_dev = stream->hdmirx_dev;
+	struct v4l2_device *v4l2_dev = &hdmirx_dev->v4l2_dev;
+	struct v4l2_event ev = {
+		.type = RK_HDMIRX_V4L2_EVENT_SLICE,
+	};
+	struct rk_hdmirx_slice *slice = (struct rk_hdmirx_slice *)ev.u.data;
+
+	slice->sequence = stream->frame_idx - 1;
+	slice->lines = hdmirx_dev->timings.bt.height * stream->slice_idx /
+		       stream->slice_cnt;
+	v4l2_event_queue(&stream->vdev, &ev);
+	v4l2_dbg(4, debug, v4l2_dev, "%s: seq:%d lines:%d\n", __func__,
+		 slice->sequence, slice->lines);
+
+	if (++stream->slice_idx >= stream->slice_cnt)
+		stream->slice_idx = 0;
+	hdmirx_set_slice_line(stream);
+}
+
 static void dma_idle_int_handler(struct rk_hdmirx_dev *hdmirx_dev, bool *handled)
 {
 	unsigned long lock_flags = 0;
@@ -3051,6 +3370,12 @@ static void dma_idle_int_handler(struct rk_hdmirx_dev *hdmirx_dev, bool *handled
 			hdmirx_dev->hdmirx_fence = NULL;
 		}
 		spin_unlock_irqrestore(&hdmirx_dev->fence_lock, lock_flags);
+
+		/* frame ended with slices pending, restart at the frame start */
+		if (stream->slice_idx) {
+			stream->slice_idx = 0;
+			hdmirx_set_slice_line(stream);
+		}
 		goto DMA_IDLE_OUT;
 	}
 
@@ -3135,6 +3460,11 @@ static void line_flag_int_handler(struct rk_hdmirx_dev *hdmirx_dev, bool *handle
 	u32 dma_cfg6;
 	struct vb2_v4l2_buffer *vb_done = NULL;
 
+	if (stream->slice_idx) {
+		hdmirx_slice_int_handler(stream);
+		goto LINE_FLAG_OUT;
+	}
+
 	stream->line_flag_int_cnt++;
 	if (!(stream->irq_stat) && !(stream->irq_stat & HDMIRX_DMA_IDLE_INT))
 		v4l2_dbg(1, debug, v4l2_dev,
@@ -3194,6 +3524,11 @@ static void line_flag_int_handler(struct rk_hdmirx_dev *hdmirx_dev, bool *handle
 					stream->frame_idx++;
 					if (stream->frame_idx == 30)
 						v4l2_info(v4l2_dev, "rcv frames\n");
+
+					if (stream->slice_cnt) {
+						stream->slice_idx = 1;
+						hdmirx_set_slice_line(stream);
+					}
 				}
 
 				stream->curr_buf = stream->next_buf;
@@ -3379,6 +3714,7 @@ static void hdmirx_plugin(struct rk_hdmirx_dev *hdmirx_dev)
 	}
 	hdmirx_dma_config(hdmirx_dev);
 	hdmirx_interrupts_setup(hdmirx_dev, true);
+	hdmirx_restart_stream(hdmirx_dev);
 	extcon_set_state_sync(hdmirx_dev->extcon, EXTCON_JACK_VIDEO_IN, true);
 	hdmirx_audio_handle_plugged_change(hdmirx_dev, 1);
 }
@@ -3810,6 +4146,7 @@ static void hdmirx_delayed_work_res_change(struct work_struct *work)
 		} else {
 			hdmirx_dma_config(hdmirx_dev);
 			hdmirx_interrupts_setup(hdmirx_dev, true);
+			hdmirx_restart_stream(hdmirx_dev);
 			hdmirx_audio_handle_plugged_change(hdmirx_dev, 1);
 		}
 	}
@@ -9,6 +9,7 @@
 #include <media/v4l2-ioctl.h>
 #include <media/v4l2-subdev.h>
 #include <media/videobuf2-dma-contig.h>
+#include <soc/rockchip/rockchip_media_trace.h>
 #include "dev.h"
 #include "regs.h"
 #include "rkisp_tb_helper.h"
@@ -51,6 +52,9 @@ static int rkisp_create_hdr_buf(struct rkisp_device *dev)
 
 	stream = &dev->cap_dev.stream[RKISP_STREAM_DMATX0];
 	size = stream->out_fmt.plane_fmt[0].sizeimage;
+	/* fbc compression has no upper bound, keep the raw size plus the head */
+	if (dev->hdr.rawfbc)
+		size += ALIGN(size / RKISP_RAWFBC_HEAD_DIV, PAGE_SIZE);
 	max_dma = hdr_dma_frame(dev);
 	/* hdr read back mode using base and shd address
 	 * this support multi-buffer
@@ -169,20 +173,26 @@ int hdr_update_dmatx_buf(struct rkisp_device *dev)
 	buf = hdr_dqbuf(&dev->hdr.q_rx[index]);
 	if (buf) {
 		mi_raw0_rd_set_addr(base, buf->dma_addr);
+		hdr_rawfbc_set_addr(dev, MI_RAW0_RD_BASE, buf->dma_addr);
 		dev->hdr.rx_cur_buf[index] = buf;
 	} else {
 		mi_raw0_rd_set_addr(base,
 			readl(base + MI_RAW0_WR_BASE_SHD));
+		hdr_rawfbc_set_addr(dev, MI_RAW0_RD_BASE,
+				    readl(base + MI_RAW0FBC_WR_BASE_SHD));
 	}
 
 	index = dev->hdr.index[HDR_DMA1];
 	buf = hdr_dqbuf(&dev->hdr.q_rx[index]);
 	if (buf) {
 		mi_raw1_rd_set_addr(base, buf->dma_addr);
+		hdr_rawfbc_set_addr(dev, MI_RAW1_RD_BASE, buf->dma_addr);
 		dev->hdr.rx_cur_buf[index] = buf;
 	} else {
 		mi_raw1_rd_set_addr(base,
 			readl(base + MI_RAW1_WR_BASE_SHD));
+		hdr_rawfbc_set_addr(dev, MI_RAW1_RD_BASE,
+				    readl(base + MI_RAW1FBC_WR_BASE_SHD));
 	}
 
 	index = dev->hdr.index[HDR_DMA2];
@@ -209,6 +219,35 @@ int hdr_update_dmatx_buf(struct rkisp_device *dev)
 	return 0;
 }
 
+/*
+ * The raw fbc compresses the internal hdr buffers of raw0 and raw1 on the
+ * way out to ddr and decompresses them on read back, raw2 has no fbc. Each
+ * fbc base follows the plain base of its channel, so every address update
+ * of an internal buffer goes through here too.
+ */
+void hdr_rawfbc_set_addr(struct rkisp_device *dev, u32 reg, u32 addr)
+{
+	switch (reg) {
+	case MI_RAW0_WR_BASE:
+		reg = MI_RAW0FBC_WR_BASE;
+		break;
+	case MI_RAW1_WR_BASE:
+		reg = MI_RAW1FBC_WR_BASE;
+		break;
+	case MI_RAW0_RD_BASE:
+		reg = MI_RAW0FBC_RD_BASE;
+		break;
+	case MI_RAW1_RD_BASE:
+		reg = MI_RAW1FBC_RD_BASE;
+		break;
+	default:
+		return;
+	}
+
+	if (dev->hdr.rawfbc)
+		writel(addr, dev->base_addr + reg);
+}
+
 int hdr_config_dmatx(struct rkisp_device *dev)
 {
 	struct rkisp_stream *stream;
@@ -223,6 +262,11 @@ int hdr_config_dmatx(struct rkisp_device *dev)
 	    (dev->isp_ver != ISP_V20 && dev->isp_ver != ISP_V21))
 		return 0;
 
+	/* only the internal buffers, user buffers of dmatx stay plain raw */
+	dev->hdr.rawfbc = rkisp_rawfbc && dev->hdr.op_mode != HDR_NORMAL &&
+			  !dev->dmarx_dev.trigger;
+	writel(dev->hdr.rawfbc ? SW_RAWFBC_EN : 0, dev->base_addr + CSI2RX_RAWFBC_CTRL);
+
 	rkisp_create_hdr_buf(dev);
 	memset(&pixm, 0, sizeof(pixm));
 	if (dev->hdr.op_mode == HDR_FRAMEX2_DDR ||
@@ -313,6 +357,10 @@ void hdr_stop_dmatx(struct rkisp_device *dev)
 		stream = &dev->cap_dev.stream[RKISP_STREAM_DMATX2];
 		stream->ops->stop_mi(stream);
 	}
+	if (dev->hdr.rawfbc) {
+		writel(0, dev->base_addr + CSI2RX_RAWFBC_CTRL);
+		dev->hdr.rawfbc = false;
+	}
 }
 
 struct rkisp_dummy_buffer *hdr_dqbuf(struct list_head *q)
@@ -1643,6 +1691,13 @@ static void rkisp_buf_done_task(unsigned long arg)
 			v4l2_dbg(0, rkisp_debug, &stream->ispdev->v4l2_dev,
 				 "seq:%d data no update:%llx %llx\n",
 				 buf->vb.sequence, *data, *(data + 1));
+		if (rk_media_trace_enabled() &&
+		    buf->vb.vb2_buf.memory == VB2_MEMORY_DMABUF) {
+			struct dma_buf *dbuf = buf->vb.vb2_buf.planes[0].dbuf;
+
+			rk_media_buf_set_frame(dbuf, buf->vb.sequence + 1);
+			rk_media_buf_trace(stream->ispdev->dev, dbuf, RK_MEDIA_DONE);
+		}
 		vb2_buffer_done(&buf->vb.vb2_buf,
 				stream->streaming ? VB2_BUF_STATE_DONE : VB2_BUF_STATE_ERROR);
 	}
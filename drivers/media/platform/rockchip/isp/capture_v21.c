@@ -1001,8 +1001,11 @@ static void update_dmatx_v2(struct rkisp_stream *stream)
 			buf = &dev->hw_dev->dummy_buf;
 			stream->dbg.frameloss++;
 		}
-		if (buf)
+		if (buf) {
 			mi_set_y_addr(stream, buf->dma_addr);
+			hdr_rawfbc_set_addr(dev, stream->config->mi.y_base_ad_init,
+					    buf->dma_addr);
+		}
 	}
 	v4l2_dbg(2, rkisp_debug, &dev->v4l2_dev,
 		 "%s stream:%d Y:0x%x SHD:0x%x\n",
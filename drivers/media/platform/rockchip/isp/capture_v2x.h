@@ -6,8 +6,12 @@
 
 struct rkisp_stream;
 
+/* fbc header in front of the payload, one part of the raw frame size */
+#define RKISP_RAWFBC_HEAD_DIV	16
+
 struct rkisp_dummy_buffer *hdr_dqbuf(struct list_head *q);
 void hdr_qbuf(struct list_head *q, struct rkisp_dummy_buffer *buf);
+void hdr_rawfbc_set_addr(struct rkisp_device *dev, u32 reg, u32 addr);
 int hdr_config_dmatx(struct rkisp_device *dev);
 int hdr_update_dmatx_buf(struct rkisp_device *dev);
 void hdr_stop_dmatx(struct rkisp_device *dev);
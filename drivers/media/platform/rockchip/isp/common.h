@@ -142,6 +142,9 @@ extern int rkisp_debug;
 extern bool rkisp_monitor;
 extern bool rkisp_irq_dbg;
 extern bool rkisp_buf_dbg;
+extern bool rkisp_reg_shadow;
+extern bool rkisp_rdbk_sched;
+extern bool rkisp_rawfbc;
 extern u64 rkisp_debug_reg;
 extern struct platform_driver rkisp_plat_drv;
 
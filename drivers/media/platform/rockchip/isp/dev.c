@@ -71,6 +71,18 @@ bool rkisp_buf_dbg;
 module_param_named(buf_dbg, rkisp_buf_dbg, bool, 0644);
 MODULE_PARM_DESC(buf_dbg, "rkisp check output buf");
 
+bool rkisp_reg_shadow;
+module_param_named(reg_shadow, rkisp_reg_shadow, bool, 0644);
+MODULE_PARM_DESC(reg_shadow, "rkisp write params registers in one burst per frame");
+
+bool rkisp_rdbk_sched;
+module_param_named(rdbk_sched, rkisp_rdbk_sched, bool, 0644);
+MODULE_PARM_DESC(rdbk_sched, "rkisp multi dev read back by earliest frame deadline");
+
+bool rkisp_rawfbc;
+module_param_named(rawfbc, rkisp_rawfbc, bool, 0644);
+MODULE_PARM_DESC(rawfbc, "rkisp compress internal hdr raw buffers");
+
 static bool rkisp_rdbk_auto;
 module_param_named(rdbk_auto, rkisp_rdbk_auto, bool, 0644);
 MODULE_PARM_DESC(irq_dbg, "rkisp and vicap auto readback mode");
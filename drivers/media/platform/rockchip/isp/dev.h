@@ -187,6 +187,8 @@ struct rkisp_hdr {
 	u8 esp_mode;
 	u8 src_bit;
 	u8 index[HDR_DMA_MAX];
+	/* internal raw0/raw1 buffers are compressed by the raw fbc */
+	bool rawfbc;
 	atomic_t refcnt;
 	struct v4l2_subdev *sensor;
 	struct list_head q_tx[HDR_DMA_MAX];
@@ -195,6 +197,48 @@ struct rkisp_hdr {
 	struct rkisp_dummy_buffer dummy_buf[HDR_DMA_MAX][HDR_MAX_DUMMY_BUF];
 };
 
+/* struct rkisp_rdbk_stats - read back of a virtual isp on a shared hw
+ * @last_sof: sof timestamp of the last queued frame
+ * @last_id: frame id of the last queued frame
+ * @interval: running average of the sensor frame interval, ns
+ * @frames: frames read back
+ * @drops: frames dropped as the read back fifo was full
+ * @misses: frames read back after their deadline
+ * @lat_last: sof to read back start of the last frame, us
+ * @lat_max: worst sof to read back start, us
+ * @lat_sum: sum of sof to read back start, us
+ */
+struct rkisp_rdbk_stats {
+	u64 last_sof;
+	u32 last_id;
+	u64 interval;
+	u64 frames;
+	u64 drops;
+	u64 misses;
+	u32 lat_last;
+	u32 lat_max;
+	u64 lat_sum;
+};
+
+/* struct rkisp_aiisp_stats - isp read back waiting for aiisp bands
+ * @rd_wait_ts: isp read reached the band being written, 0 if not waiting
+ * @cur_stall: wait of the frame in progress, ns
+ * @frames: frames read through aiisp
+ * @bands: bands waited for
+ * @stall_last: wait of the last frame, us
+ * @stall_max: worst wait of a frame, us
+ * @stall_sum: sum of the wait of all frames, us
+ */
+struct rkisp_aiisp_stats {
+	u64 rd_wait_ts;
+	u64 cur_stall;
+	u64 frames;
+	u64 bands;
+	u32 stall_last;
+	u32 stall_max;
+	u64 stall_sum;
+};
+
 /*
  * struct rkisp_device - ISP platform device
  * @base_addr: base register address
@@ -281,6 +325,7 @@ struct rkisp_device {
 	int rdbk_cnt_x3;
 	u32 rd_mode;
 	int sw_rd_cnt;
+	struct rkisp_rdbk_stats rdbk_stats;
 
 	struct rkisp_rx_buf_pool pv_pool[RKISP_RX_BUF_POOL_MAX];
 
@@ -289,6 +334,7 @@ struct rkisp_device {
 	spinlock_t aiisp_lock;
 	struct rkisp_cmsk_cfg cmsk_cfg;
 	struct rkisp_aiisp_cfg aiisp_cfg;
+	struct rkisp_aiisp_stats aiisp_stats;
 
 	bool is_cmsk_upd;
 	bool is_hw_link;
@@ -311,6 +357,11 @@ struct rkisp_device {
 	u8 rawaf_irq_cnt;
 	u8 unite_index;
 	u8 unite_div;
+	/* read back time of each unite segment, us */
+	u8 unite_pass_index;
+	u64 unite_pass_start;
+	u32 unite_pass_time[ISP_UNITE_MAX];
+	u32 unite_pass_max[ISP_UNITE_MAX];
 };
 
 static inline void
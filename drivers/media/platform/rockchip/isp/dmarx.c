@@ -470,6 +470,7 @@ static void update_rawrd(struct rkisp_stream *stream)
 			val = readl(base + rawwr_addr);
 		}
 		mi_set_y_addr(stream, val);
+		hdr_rawfbc_set_addr(dev, stream->config->mi.y_base_ad_init, val);
 	}
 }
 
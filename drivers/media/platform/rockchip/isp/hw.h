@@ -74,6 +74,10 @@ struct rkisp_hw_dev {
 	struct mutex dev_lock;
 	spinlock_t rdbk_lock;
 	atomic_t refcnt;
+	/* read back busy time, for multi dev utilization */
+	u64 rdbk_start_ns;
+	u64 rdbk_busy_ns;
+	u64 rdbk_since_ns;
 
 	struct rkisp_sram sram;
 
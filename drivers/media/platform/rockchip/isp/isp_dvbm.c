@@ -17,19 +17,23 @@ int rkisp_dvbm_get(struct rkisp_device *dev)
 	int ret = -EINVAL;
 
 	g_dvbm = NULL;
-	if (dev->isp_ver != ISP_V32)
-		goto end;
-
 	if (!np_dvbm || !of_device_is_available(np_dvbm)) {
 		dev_warn(dev->dev, "failed to get dvbm node\n");
 	} else {
 		struct platform_device *p_dvbm = of_find_device_by_node(np_dvbm);
 
 		g_dvbm = rk_dvbm_get_port(p_dvbm, DVBM_ISP_PORT);
-		of_node_put(np_dvbm);
+		if (IS_ERR(g_dvbm)) {
+			ret = PTR_ERR(g_dvbm);
+			g_dvbm = NULL;
+		} else {
+			ret = 0;
+		}
+		if (p_dvbm)
+			put_device(&p_dvbm->dev);
 	}
+	of_node_put(np_dvbm);
 
-end:
 	return ret;
 }
 
@@ -67,13 +71,17 @@ void rkisp_dvbm_deinit(void)
 		rk_dvbm_unlink(g_dvbm);
 }
 
+/*
+ * Report the isp output progress of the wrap buffer to dvbm, the encoder
+ * port follows the line count of the frame.
+ */
+
 int rkisp_dvbm_event(struct rkisp_device *dev, u32 event)
 {
 	enum dvbm_cmd cmd;
 	u32 seq;
 
-	if (!g_dvbm || dev->isp_ver != ISP_V32 ||
-	    !dev->cap_dev.wrap_line)
+	if (!g_dvbm || !dev->cap_dev.wrap_line)
 		return -EINVAL;
 
 	rkisp_dmarx_get_frame(dev, &seq, NULL, NULL, true);
@@ -82,6 +90,12 @@ int rkisp_dvbm_event(struct rkisp_device *dev, u32 event)
 	case CIF_ISP_V_START:
 		cmd = DVBM_ISP_FRM_START;
 		break;
+	case ISP3X_OUT_FRM_QUARTER:
+		cmd = DVBM_ISP_FRM_QUARTER;
+		break;
+	case ISP3X_OUT_FRM_HALF:
+		cmd = DVBM_ISP_FRM_HALF;
+		break;
 	case CIF_MI_MP_FRAME:
 		cmd = DVBM_ISP_FRM_END;
 		break;
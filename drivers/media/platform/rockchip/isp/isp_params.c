@@ -6,6 +6,8 @@
 #include <media/videobuf2-core.h>
 #include <media/videobuf2-vmalloc.h>	/* for ISP params */
 #include <media/v4l2-event.h>
+#include <linux/dma-buf.h>
+#include <linux/jhash.h>
 #include <linux/rk-preisp.h>
 #include "dev.h"
 #include "isp_params.h"
@@ -93,6 +95,89 @@ static int rkisp_params_unsubs_evt(struct v4l2_fh *fh,
 	return v4l2_event_unsubscribe(fh, sub);
 }
 
+static int rkisp_params_set_snapshot(struct rkisp_isp_params_vdev *params_vdev,
+				     struct rkisp_params_snapshot *cfg)
+{
+	struct rkisp_device *dev = params_vdev->dev;
+	u32 size = params_vdev->vdev_fmt.fmt.meta.buffersize;
+	struct dma_buf *dbuf;
+	struct iosys_map map;
+	void *snapshot = NULL, *old;
+	int ret;
+
+	if (cfg->size) {
+		if (cfg->size != size) {
+			v4l2_err(&dev->v4l2_dev, "snapshot size:%d no equal to params:%d\n",
+				 cfg->size, size);
+			return -EINVAL;
+		}
+		dbuf = dma_buf_get(cfg->buf_fd);
+		if (IS_ERR(dbuf))
+			return PTR_ERR(dbuf);
+		if (dbuf->size < size) {
+			ret = -EINVAL;
+			goto put;
+		}
+		snapshot = kvmalloc(size, GFP_KERNEL);
+		if (!snapshot) {
+			ret = -ENOMEM;
+			goto put;
+		}
+		ret = dma_buf_begin_cpu_access(dbuf, DMA_FROM_DEVICE);
+		if (ret)
+			goto free;
+		ret = dma_buf_vmap(dbuf, &map);
+		if (!ret) {
+			memcpy(snapshot, map.vaddr, size);
+			dma_buf_vunmap(dbuf, &map);
+		}
+		dma_buf_end_cpu_access(dbuf, DMA_FROM_DEVICE);
+		if (ret)
+			goto free;
+		dma_buf_put(dbuf);
+	}
+
+	mutex_lock(&params_vdev->snapshot_lock);
+	old = params_vdev->snapshot;
+	params_vdev->snapshot = snapshot;
+	mutex_unlock(&params_vdev->snapshot_lock);
+	kvfree(old);
+	return 0;
+free:
+	kvfree(snapshot);
+put:
+	dma_buf_put(dbuf);
+	return ret;
+}
+
+/*
+ * Take the snapshot as the first params if 3a hasn't queued any, so the
+ * first frame is already exposed and white balanced as the last stream.
+ * The 3a first buffer later is handled as a normal params buffer.
+ */
+bool rkisp_params_load_snapshot(struct rkisp_isp_params_vdev *params_vdev)
+{
+	struct rkisp_device *dev = params_vdev->dev;
+	unsigned long flags;
+	bool ret = false;
+
+	mutex_lock(&params_vdev->snapshot_lock);
+	if (!params_vdev->snapshot || params_vdev->is_first_cfg || dev->is_pre_on)
+		goto unlock;
+	params_vdev->ops->save_first_param(params_vdev, params_vdev->snapshot);
+	params_vdev->is_first_cfg = true;
+	spin_lock_irqsave(&params_vdev->config_lock, flags);
+	if (!params_vdev->streamon)
+		params_vdev->first_cfg_params = true;
+	params_vdev->first_params = false;
+	spin_unlock_irqrestore(&params_vdev->config_lock, flags);
+	dev_info(dev->dev, "first params from snapshot\n");
+	ret = true;
+unlock:
+	mutex_unlock(&params_vdev->snapshot_lock);
+	return ret;
+}
+
 static long rkisp_params_ioctl_default(struct file *file, void *fh,
 				       bool valid_prio, unsigned int cmd, void *arg)
 {
@@ -103,6 +188,9 @@ static long rkisp_params_ioctl_default(struct file *file, void *fh,
 	case RKISP_CMD_SET_EXPANDER:
 		rkisp_expander_config(params->dev, arg, true);
 		break;
+	case RKISP_CMD_SET_PARAMS_SNAPSHOT:
+		ret = rkisp_params_set_snapshot(params, arg);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -407,6 +495,8 @@ void rkisp_params_cfg(struct rkisp_isp_params_vdev *params_vdev, u32 frame_id)
 void rkisp_params_cfgsram(struct rkisp_isp_params_vdev *params_vdev,
 			  bool is_check, bool is_reset)
 {
+	if (is_reset)
+		rkisp_params_delta_invalidate(params_vdev);
 	if (is_check) {
 		if (params_vdev->dev->procfs.mode & RKISP_PROCFS_FIL_SW)
 			return;
@@ -438,6 +528,7 @@ void rkisp_params_first_cfg(struct rkisp_isp_params_vdev *params_vdev,
 	params_vdev->quantization = quantization;
 	params_vdev->raw_type = in_fmt->bayer_pat;
 	params_vdev->in_mbus_code = in_fmt->mbus_code;
+	memset(&params_vdev->delta, 0, sizeof(params_vdev->delta));
 	params_vdev->ops->first_cfg(params_vdev);
 	/* update selfpath range if it output rgb format */
 	if (params_vdev->quantization != quantization) {
@@ -457,6 +548,7 @@ void rkisp_params_first_cfg(struct rkisp_isp_params_vdev *params_vdev,
 /* Not called when the camera active, thus not isr protection. */
 void rkisp_params_disable_isp(struct rkisp_isp_params_vdev *params_vdev)
 {
+	rkisp_params_delta_invalidate(params_vdev);
 	if (params_vdev->ops->disable_isp)
 		params_vdev->ops->disable_isp(params_vdev);
 }
@@ -494,6 +586,129 @@ void rkisp_params_stream_stop(struct rkisp_isp_params_vdev *params_vdev)
 	if (params_vdev->ops->fop_release)
 		params_vdev->ops->fop_release(params_vdev);
 	params_vdev->first_cfg_params = false;
+	rkisp_params_delta_invalidate(params_vdev);
+}
+
+/*
+ * Userspace sets the module_cfg_update bit of a module whenever it
+ * resends the config, mostly with the content of the last frame. Drop
+ * the modules in @blocks whose config hashes the same as the one last
+ * programmed for segment @id, so their registers and sram tables aren't
+ * written again. Modules not in @blocks are always programmed, as their
+ * programming depends on more than their own config.
+ */
+u64 rkisp_params_delta_filter(struct rkisp_isp_params_vdev *params_vdev,
+			      const struct rkisp_params_delta_block *blocks, int num,
+			      const void *params, u64 module_cfg_update, u32 id)
+{
+	struct rkisp_params_delta *delta = &params_vdev->delta;
+	u64 skipped = 0, hash;
+	const void *cfg;
+	int i, bit;
+
+	if (id >= RKISP_PARAMS_DELTA_ID_MAX)
+		return module_cfg_update;
+
+	if (params_vdev->dev->procfs.mode & RKISP_PROCFS_NO_DELTA) {
+		delta->valid[id] = 0;
+		return module_cfg_update;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!(module_cfg_update & blocks[i].module))
+			continue;
+
+		bit = __ffs64(blocks[i].module);
+		cfg = params + blocks[i].offset;
+		hash = (u64)jhash(cfg, blocks[i].size, 0) << 32 |
+		       jhash(cfg, blocks[i].size, blocks[i].size);
+		if ((delta->valid[id] & blocks[i].module) && delta->hash[id][bit] == hash) {
+			skipped |= blocks[i].module;
+			delta->skipped_bytes += blocks[i].size;
+			continue;
+		}
+		delta->hash[id][bit] = hash;
+		delta->valid[id] |= blocks[i].module;
+		delta->programmed++;
+	}
+
+	delta->skipped += hweight64(skipped);
+
+	return module_cfg_update & ~skipped;
+}
+
+/* the isp lost or will lose the programmed configs, program all again */
+void rkisp_params_delta_invalidate(struct rkisp_isp_params_vdev *params_vdev)
+{
+	memset(params_vdev->delta.valid, 0, sizeof(params_vdev->delta.valid));
+}
+
+/*
+ * With a single isp the params writes of a frame go to the hardware one
+ * by one while the modules are configured, with set/clear bits reading
+ * the register back each time. In shadow mode the writes of the frame
+ * only update the register cache, the same as for multi-device mode,
+ * and rkisp_params_shadow_flush() writes each dirty register once, in
+ * address order, before the config lock is dropped. Direct writes for
+ * the sram tables still go to the hardware at once.
+ */
+void rkisp_params_shadow_begin(struct rkisp_isp_params_vdev *params_vdev)
+{
+	if (!rkisp_reg_shadow || !params_vdev->dev->hw_dev->is_single)
+		return;
+	params_vdev->shadow.active = true;
+}
+
+void rkisp_params_shadow_write(struct rkisp_isp_params_vdev *params_vdev,
+			       u32 reg, u32 val, u32 id)
+{
+	struct rkisp_device *dev = params_vdev->dev;
+	struct rkisp_hw_dev *hw = dev->hw_dev;
+	u32 *mem, *flag, offset = id * RKISP_ISP_SW_MAX_SIZE;
+
+	if (!hw->unite)
+		offset = 0;
+	mem = dev->sw_base_addr + reg + offset;
+	flag = dev->sw_base_addr + reg + RKISP_ISP_SW_REG_SIZE + offset;
+	*mem = val;
+	*flag = SW_REG_CACHE_SYNC;
+	/* same segments as rkisp_idx_write() reaches the hardware for */
+	if (id == ISP_UNITE_LEFT)
+		set_bit(reg / 4, params_vdev->shadow.dirty[0]);
+	else if (hw->unite == ISP_UNITE_TWO && id == ISP_UNITE_RIGHT)
+		set_bit(reg / 4, params_vdev->shadow.dirty[1]);
+}
+
+void rkisp_params_shadow_flush(struct rkisp_isp_params_vdev *params_vdev)
+{
+	struct rkisp_params_shadow *shadow = &params_vdev->shadow;
+	struct rkisp_device *dev = params_vdev->dev;
+	struct rkisp_hw_dev *hw = dev->hw_dev;
+	void __iomem *base_addr;
+	u32 i, bit, reg, offset, cnt = 0;
+
+	if (!shadow->active)
+		return;
+	shadow->active = false;
+
+	for (i = 0; i < ARRAY_SIZE(shadow->dirty); i++) {
+		base_addr = i ? hw->base_next_addr : hw->base_addr;
+		offset = hw->unite ? i * RKISP_ISP_SW_MAX_SIZE : 0;
+		for_each_set_bit(bit, shadow->dirty[i], RKISP_PARAMS_SHADOW_REGS) {
+			reg = bit * 4;
+			writel_relaxed(*(u32 *)(dev->sw_base_addr + reg + offset),
+				       base_addr + reg);
+			cnt++;
+		}
+		bitmap_zero(shadow->dirty[i], RKISP_PARAMS_SHADOW_REGS);
+	}
+	if (!cnt)
+		return;
+	/* order the burst before the following cfg_upd or stream writes */
+	wmb();
+	shadow->last = cnt;
+	shadow->max = max(shadow->max, cnt);
+	shadow->flushes++;
 }
 
 bool rkisp_params_check_bigmode(struct rkisp_isp_params_vdev *params_vdev)
@@ -535,6 +750,7 @@ int rkisp_register_params_vdev(struct rkisp_isp_params_vdev *params_vdev,
 	params_vdev->dev = dev;
 	params_vdev->is_subs_evt = false;
 	spin_lock_init(&params_vdev->config_lock);
+	mutex_init(&params_vdev->snapshot_lock);
 
 	strlcpy(vdev->name, PARAMS_NAME, sizeof(vdev->name));
 
@@ -595,4 +811,7 @@ void rkisp_unregister_params_vdev(struct rkisp_isp_params_vdev *params_vdev)
 	media_entity_cleanup(&vdev->entity);
 	vb2_queue_release(vdev->queue);
 	rkisp_uninit_params_vdev(params_vdev);
+	kvfree(params_vdev->snapshot);
+	params_vdev->snapshot = NULL;
+	mutex_destroy(&params_vdev->snapshot_lock);
 }
@@ -11,6 +11,7 @@
 #include <linux/rk-isp39-config.h>
 #include <linux/rk-preisp.h>
 #include "common.h"
+#include "isp_ispp.h"
 
 #define ISP_PACK_4BYTE(a, b, c, d)	\
 	(((a) & 0xFF) << 0 | ((b) & 0xFF) << 8 | \
@@ -25,6 +26,67 @@ enum rkisp_params_type {
 	RKISP_PARAMS_SHD,
 };
 
+/* unite segments tracked by the delta apply */
+#define RKISP_PARAMS_DELTA_ID_MAX	4
+
+/*
+ * struct rkisp_params_delta_block - module config checked by the delta apply
+ *
+ * @module: the module bit in module_cfg_update
+ * @offset: offset of the module config in the version params struct
+ * @size: size of the module config
+ */
+struct rkisp_params_delta_block {
+	u64 module;
+	u32 offset;
+	u32 size;
+};
+
+#define RKISP_PARAMS_DELTA_BLOCK(_module, _type, _member) {	\
+	.module = _module,					\
+	.offset = offsetof(_type, _member),			\
+	.size = sizeof_field(_type, _member),			\
+}
+
+/*
+ * struct rkisp_params_delta - content hash of the module configs last
+ * programmed, see rkisp_params_delta_filter()
+ *
+ * @valid: modules with a valid hash, per unite segment
+ * @hash: hash of each module config, indexed by its module bit
+ * @programmed: module configs written to the isp
+ * @skipped: module configs dropped as unchanged
+ * @skipped_bytes: size of the module configs dropped
+ */
+struct rkisp_params_delta {
+	u64 valid[RKISP_PARAMS_DELTA_ID_MAX];
+	u64 hash[RKISP_PARAMS_DELTA_ID_MAX][64];
+	u64 programmed;
+	u64 skipped;
+	u64 skipped_bytes;
+};
+
+/* one dirty bit per 32bit register of a segment's register cache */
+#define RKISP_PARAMS_SHADOW_REGS	(RKISP_ISP_SW_REG_SIZE / 4)
+
+/*
+ * struct rkisp_params_shadow - params writes of a frame held in the
+ * register cache, see rkisp_params_shadow_begin()
+ *
+ * @dirty: registers written since the last flush, left and right segment
+ * @active: params config in progress, writes go to the cache only
+ * @last: registers written out by the last flush
+ * @max: most registers written out by one flush
+ * @flushes: flushes which wrote out any register
+ */
+struct rkisp_params_shadow {
+	unsigned long dirty[2][BITS_TO_LONGS(RKISP_PARAMS_SHADOW_REGS)];
+	bool active;
+	u32 last;
+	u32 max;
+	u64 flushes;
+};
+
 struct rkisp_isp_params_vdev;
 struct rkisp_isp_params_ops {
 	void (*save_first_param)(struct rkisp_isp_params_vdev *params_vdev, void *param);
@@ -92,6 +154,13 @@ struct rkisp_isp_params_vdev {
 
 	bool is_subs_evt;
 	bool is_first_cfg;
+
+	struct rkisp_params_delta delta;
+	struct rkisp_params_shadow shadow;
+
+	/* lock for snapshot */
+	struct mutex snapshot_lock;
+	void *snapshot;
 };
 
 static inline void
@@ -133,6 +202,7 @@ void rkisp_params_first_cfg(struct rkisp_isp_params_vdev *params_vdev,
 			    struct ispsd_in_fmt *in_fmt,
 			    enum v4l2_quantization quantization);
 void rkisp_params_disable_isp(struct rkisp_isp_params_vdev *params_vdev);
+bool rkisp_params_load_snapshot(struct rkisp_isp_params_vdev *params_vdev);
 
 int rkisp_register_params_vdev(struct rkisp_isp_params_vdev *params_vdev,
 			       struct v4l2_device *v4l2_dev,
@@ -153,4 +223,12 @@ bool rkisp_params_check_bigmode(struct rkisp_isp_params_vdev *params_vdev);
 int rkisp_params_info2ddr_cfg(struct rkisp_isp_params_vdev *params_vdev, void *arg);
 void rkisp_params_get_bay3d_buffd(struct rkisp_isp_params_vdev *params_vdev,
 				  struct rkisp_bay3dbuf_info *bay3dbuf);
+u64 rkisp_params_delta_filter(struct rkisp_isp_params_vdev *params_vdev,
+			      const struct rkisp_params_delta_block *blocks, int num,
+			      const void *params, u64 module_cfg_update, u32 id);
+void rkisp_params_delta_invalidate(struct rkisp_isp_params_vdev *params_vdev);
+void rkisp_params_shadow_begin(struct rkisp_isp_params_vdev *params_vdev);
+void rkisp_params_shadow_write(struct rkisp_isp_params_vdev *params_vdev,
+			       u32 reg, u32 val, u32 id);
+void rkisp_params_shadow_flush(struct rkisp_isp_params_vdev *params_vdev);
 #endif /* _RKISP_ISP_PARAM_H */
@@ -4045,6 +4045,39 @@ struct rkisp_isp_params_ops_v32 isp_params_ops_v32 = {
 	.vsm_enable = isp_vsm_enable,
 };
 
+#define ISP32_DELTA(_module, _member) \
+	RKISP_PARAMS_DELTA_BLOCK(ISP32_MODULE_##_module, struct isp32_isp_params_cfg, _member)
+
+/* same as isp3x, vsm and the gated rawae0/rawae3 are always programmed */
+static const struct rkisp_params_delta_block isp32_delta_other[] = {
+	ISP32_DELTA(LSC, others.lsc_cfg),
+	ISP32_DELTA(DPCC, others.dpcc_cfg),
+	ISP32_DELTA(BLS, others.bls_cfg),
+	ISP32_DELTA(SDG, others.sdg_cfg),
+	ISP32_DELTA(AWB_GAIN, others.awb_gain_cfg),
+	ISP32_DELTA(DEBAYER, others.debayer_cfg),
+	ISP32_DELTA(CCM, others.ccm_cfg),
+	ISP32_DELTA(GOC, others.gammaout_cfg),
+	ISP32_DELTA(CSM, others.csm_cfg),
+	ISP32_DELTA(GIC, others.gic_cfg),
+	ISP32_DELTA(3DLUT, others.isp3dlut_cfg),
+	ISP32_DELTA(YNR, others.ynr_cfg),
+	ISP32_DELTA(CNR, others.cnr_cfg),
+	ISP32_DELTA(SHARP, others.sharp_cfg),
+	ISP32_DELTA(BAYNR, others.baynr_cfg),
+	ISP32_DELTA(GAIN, others.gain_cfg),
+};
+
+static const struct rkisp_params_delta_block isp32_delta_meas[] = {
+	ISP32_DELTA(RAWAE1, meas.rawae1),
+	ISP32_DELTA(RAWAE2, meas.rawae2),
+	ISP32_DELTA(RAWHIST0, meas.rawhist0),
+	ISP32_DELTA(RAWHIST1, meas.rawhist1),
+	ISP32_DELTA(RAWHIST2, meas.rawhist2),
+	ISP32_DELTA(RAWHIST3, meas.rawhist3),
+	ISP32_DELTA(RAWAWB, meas.rawawb),
+};
+
 static __maybe_unused
 void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 			    const struct isp32_isp_params_cfg *new_params,
@@ -4067,6 +4100,10 @@ void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 		return;
 	}
 
+	module_cfg_update = rkisp_params_delta_filter(params_vdev, isp32_delta_other,
+						      ARRAY_SIZE(isp32_delta_other),
+						      new_params, module_cfg_update, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -4289,6 +4326,10 @@ void __isp_isr_meas_config(struct rkisp_isp_params_vdev *params_vdev,
 	if (type == RKISP_PARAMS_SHD)
 		return;
 
+	module_cfg_update = rkisp_params_delta_filter(params_vdev, isp32_delta_meas,
+						      ARRAY_SIZE(isp32_delta_meas),
+						      new_params, module_cfg_update, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -34,7 +34,10 @@ static inline void
 isp3_param_write(struct rkisp_isp_params_vdev *params_vdev,
 		 u32 value, u32 addr, u32 id)
 {
-	rkisp_idx_write(params_vdev->dev, addr, value, id, false);
+	if (params_vdev->shadow.active)
+		rkisp_params_shadow_write(params_vdev, addr, value, id);
+	else
+		rkisp_idx_write(params_vdev->dev, addr, value, id, false);
 }
 
 static inline u32
@@ -46,6 +49,8 @@ isp3_param_read_direct(struct rkisp_isp_params_vdev *params_vdev, u32 addr)
 static inline u32
 isp3_param_read(struct rkisp_isp_params_vdev *params_vdev, u32 addr, u32 id)
 {
+	if (params_vdev->shadow.active)
+		return rkisp_idx_read_reg_cache(params_vdev->dev, addr, id);
 	return rkisp_idx_read(params_vdev->dev, addr, id, false);
 }
 
@@ -59,14 +64,22 @@ static inline void
 isp3_param_set_bits(struct rkisp_isp_params_vdev *params_vdev,
 		    u32 reg, u32 bit_mask, u32 id)
 {
-	rkisp_idx_set_bits(params_vdev->dev, reg, 0, bit_mask, id, false);
+	if (params_vdev->shadow.active)
+		isp3_param_write(params_vdev, isp3_param_read(params_vdev, reg, id) | bit_mask,
+				 reg, id);
+	else
+		rkisp_idx_set_bits(params_vdev->dev, reg, 0, bit_mask, id, false);
 }
 
 static inline void
 isp3_param_clear_bits(struct rkisp_isp_params_vdev *params_vdev,
 		      u32 reg, u32 bit_mask, u32 id)
 {
-	rkisp_idx_clear_bits(params_vdev->dev, reg, bit_mask, id, false);
+	if (params_vdev->shadow.active)
+		isp3_param_write(params_vdev, isp3_param_read(params_vdev, reg, id) & ~bit_mask,
+				 reg, id);
+	else
+		rkisp_idx_clear_bits(params_vdev->dev, reg, bit_mask, id, false);
 }
 
 static void
@@ -3855,6 +3868,37 @@ struct rkisp_isp_params_ops_v39 isp_params_ops_v39 = {
 	.rgbir_enable = isp_rgbir_enable,
 };
 
+#define ISP39_DELTA(_module, _member) \
+	RKISP_PARAMS_DELTA_BLOCK(ISP39_MODULE_##_module, struct isp39_isp_params_cfg, _member)
+
+/* ldcv, yuvme and rgbir are left out as well, see isp3x */
+static const struct rkisp_params_delta_block isp39_delta_other[] = {
+	ISP39_DELTA(LSC, others.lsc_cfg),
+	ISP39_DELTA(DPCC, others.dpcc_cfg),
+	ISP39_DELTA(BLS, others.bls_cfg),
+	ISP39_DELTA(SDG, others.sdg_cfg),
+	ISP39_DELTA(AWB_GAIN, others.awb_gain_cfg),
+	ISP39_DELTA(DEBAYER, others.debayer_cfg),
+	ISP39_DELTA(CCM, others.ccm_cfg),
+	ISP39_DELTA(GOC, others.gammaout_cfg),
+	ISP39_DELTA(CSM, others.csm_cfg),
+	ISP39_DELTA(GIC, others.gic_cfg),
+	ISP39_DELTA(3DLUT, others.isp3dlut_cfg),
+	ISP39_DELTA(YNR, others.ynr_cfg),
+	ISP39_DELTA(CNR, others.cnr_cfg),
+	ISP39_DELTA(SHARP, others.sharp_cfg),
+	ISP39_DELTA(GAIN, others.gain_cfg),
+};
+
+static const struct rkisp_params_delta_block isp39_delta_meas[] = {
+	ISP39_DELTA(RAWAF, meas.rawaf),
+	ISP39_DELTA(RAWAE0, meas.rawae0),
+	ISP39_DELTA(RAWAE3, meas.rawae3),
+	ISP39_DELTA(RAWHIST0, meas.rawhist0),
+	ISP39_DELTA(RAWHIST3, meas.rawhist3),
+	ISP39_DELTA(RAWAWB, meas.rawawb),
+};
+
 static __maybe_unused
 void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 			    const struct isp39_isp_params_cfg *new_params,
@@ -3872,6 +3916,10 @@ void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 		return;
 	}
 
+	module_cfg_update = rkisp_params_delta_filter(params_vdev, isp39_delta_other,
+						      ARRAY_SIZE(isp39_delta_other),
+						      new_params, module_cfg_update, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -4081,6 +4129,10 @@ void __isp_isr_meas_config(struct rkisp_isp_params_vdev *params_vdev,
 	if (type == RKISP_PARAMS_SHD)
 		return;
 
+	module_cfg_update = rkisp_params_delta_filter(params_vdev, isp39_delta_meas,
+						      ARRAY_SIZE(isp39_delta_meas),
+						      new_params, module_cfg_update, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -5009,6 +5061,7 @@ rkisp_params_cfg_v39(struct rkisp_isp_params_vdev *params_vdev,
 	if (!params_vdev->streamon)
 		goto unlock;
 
+	rkisp_params_shadow_begin(params_vdev);
 	/* get buffer by frame_id */
 	while (!list_empty(&params_vdev->params) && !cur_buf) {
 		cur_buf = list_first_entry(&params_vdev->params,
@@ -5069,6 +5122,7 @@ rkisp_params_cfg_v39(struct rkisp_isp_params_vdev *params_vdev,
 
 unlock:
 	params_vdev->cur_buf = cur_buf;
+	rkisp_params_shadow_flush(params_vdev);
 	spin_unlock(&params_vdev->config_lock);
 }
 
@@ -35,7 +35,10 @@ static inline void
 isp3_param_write(struct rkisp_isp_params_vdev *params_vdev,
 		 u32 value, u32 addr, u32 id)
 {
-	rkisp_idx_write(params_vdev->dev, addr, value, id, false);
+	if (params_vdev->shadow.active)
+		rkisp_params_shadow_write(params_vdev, addr, value, id);
+	else
+		rkisp_idx_write(params_vdev->dev, addr, value, id, false);
 }
 
 static inline u32
@@ -49,6 +52,8 @@ static inline u32
 isp3_param_read(struct rkisp_isp_params_vdev *params_vdev,
 		u32 addr, u32 id)
 {
+	if (params_vdev->shadow.active)
+		return rkisp_idx_read_reg_cache(params_vdev->dev, addr, id);
 	return rkisp_idx_read(params_vdev->dev, addr, id, false);
 }
 
@@ -63,14 +68,22 @@ static inline void
 isp3_param_set_bits(struct rkisp_isp_params_vdev *params_vdev,
 		    u32 reg, u32 bit_mask, u32 id)
 {
-	rkisp_idx_set_bits(params_vdev->dev, reg, 0, bit_mask, id, false);
+	if (params_vdev->shadow.active)
+		isp3_param_write(params_vdev, isp3_param_read(params_vdev, reg, id) | bit_mask,
+				 reg, id);
+	else
+		rkisp_idx_set_bits(params_vdev->dev, reg, 0, bit_mask, id, false);
 }
 
 static inline void
 isp3_param_clear_bits(struct rkisp_isp_params_vdev *params_vdev,
 		      u32 reg, u32 bit_mask, u32 id)
 {
-	rkisp_idx_clear_bits(params_vdev->dev, reg, bit_mask, id, false);
+	if (params_vdev->shadow.active)
+		isp3_param_write(params_vdev, isp3_param_read(params_vdev, reg, id) & ~bit_mask,
+				 reg, id);
+	else
+		rkisp_idx_clear_bits(params_vdev->dev, reg, bit_mask, id, false);
 }
 
 static void
@@ -3783,6 +3796,45 @@ struct rkisp_isp_params_ops_v3x isp_params_ops_v3x = {
 	.cgc_config = isp_cgc_config,
 };
 
+#define ISP3X_DELTA(_module, _member) \
+	RKISP_PARAMS_DELTA_BLOCK(ISP3X_MODULE_##_module, struct isp3x_isp_params_cfg, _member)
+
+/*
+ * module configs whose programming only depends on their own content, they
+ * are skipped when unchanged. Left out: hdrmge and drc are also set on the
+ * shadow path, cgc/cproc/ie share the quantization, dhaz/ldch/bay3d/cac
+ * work with internal buffers and rawaf switches rawae3 with afaemode.
+ */
+static const struct rkisp_params_delta_block isp3x_delta_other[] = {
+	ISP3X_DELTA(LSC, others.lsc_cfg),
+	ISP3X_DELTA(DPCC, others.dpcc_cfg),
+	ISP3X_DELTA(BLS, others.bls_cfg),
+	ISP3X_DELTA(SDG, others.sdg_cfg),
+	ISP3X_DELTA(AWB_GAIN, others.awb_gain_cfg),
+	ISP3X_DELTA(DEBAYER, others.debayer_cfg),
+	ISP3X_DELTA(CCM, others.ccm_cfg),
+	ISP3X_DELTA(GOC, others.gammaout_cfg),
+	ISP3X_DELTA(CSM, others.csm_cfg),
+	ISP3X_DELTA(GIC, others.gic_cfg),
+	ISP3X_DELTA(3DLUT, others.isp3dlut_cfg),
+	ISP3X_DELTA(YNR, others.ynr_cfg),
+	ISP3X_DELTA(CNR, others.cnr_cfg),
+	ISP3X_DELTA(SHARP, others.sharp_cfg),
+	ISP3X_DELTA(BAYNR, others.baynr_cfg),
+	ISP3X_DELTA(GAIN, others.gain_cfg),
+};
+
+static const struct rkisp_params_delta_block isp3x_delta_meas[] = {
+	ISP3X_DELTA(RAWAE0, meas.rawae0),
+	ISP3X_DELTA(RAWAE1, meas.rawae1),
+	ISP3X_DELTA(RAWAE2, meas.rawae2),
+	ISP3X_DELTA(RAWHIST0, meas.rawhist0),
+	ISP3X_DELTA(RAWHIST1, meas.rawhist1),
+	ISP3X_DELTA(RAWHIST2, meas.rawhist2),
+	ISP3X_DELTA(RAWHIST3, meas.rawhist3),
+	ISP3X_DELTA(RAWAWB, meas.rawawb),
+};
+
 static __maybe_unused
 void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 			    const struct isp3x_isp_params_cfg *new_params,
@@ -3801,6 +3853,10 @@ void __isp_isr_other_config(struct rkisp_isp_params_vdev *params_vdev,
 		return;
 	}
 
+	module_cfg_update = rkisp_params_delta_filter(params_vdev, isp3x_delta_other,
+						      ARRAY_SIZE(isp3x_delta_other),
+						      new_params, module_cfg_update, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -4007,6 +4063,10 @@ void __isp_isr_meas_config(struct rkisp_isp_params_vdev *params_vdev,
 	if (type == RKISP_PARAMS_SHD)
 		return;
 
+	module_cfg_update = rkisp_params_delta_filter(params_vdev, isp3x_delta_meas,
+						      ARRAY_SIZE(isp3x_delta_meas),
+						      new_params, module_cfg_update, id);
+
 	v4l2_dbg(4, rkisp_debug, &params_vdev->dev->v4l2_dev,
 		 "%s id:%d seq:%d module_cfg_update:0x%llx\n",
 		 __func__, id, new_params->frame_id, module_cfg_update);
@@ -4701,6 +4761,7 @@ rkisp_params_cfg_v3x(struct rkisp_isp_params_vdev *params_vdev,
 	if (!params_vdev->streamon)
 		goto unlock;
 
+	rkisp_params_shadow_begin(params_vdev);
 	/* get buffer by frame_id */
 	while (!list_empty(&params_vdev->params) && !cur_buf) {
 		cur_buf = list_first_entry(&params_vdev->params,
@@ -4771,6 +4832,7 @@ rkisp_params_cfg_v3x(struct rkisp_isp_params_vdev *params_vdev,
 
 unlock:
 	params_vdev->cur_buf = cur_buf;
+	rkisp_params_shadow_flush(params_vdev);
 	spin_unlock(&params_vdev->config_lock);
 }
 
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 /* Copyright (c) 2019 Fuzhou Rockchip Electronics Co., Ltd. */
 
+#include <linux/eventfd.h>
 #include <linux/kfifo.h>
 #include <media/v4l2-common.h>
 #include <media/v4l2-ioctl.h>
@@ -182,6 +183,21 @@ static void rkisp_stats_vb2_buf_queue(struct vb2_buffer *vb)
 	spin_unlock_irqrestore(&stats_dev->rd_lock, flags);
 }
 
+static void rkisp_stats_ring_free(struct rkisp_isp_stats_vdev *stats_vdev)
+{
+	struct rkisp_stats_ring *ring = &stats_vdev->ring;
+
+	if (ring->efd) {
+		eventfd_ctx_put(ring->efd);
+		ring->efd = NULL;
+	}
+	if (ring->head) {
+		ring->head = NULL;
+		ring->slot = NULL;
+		rkisp_free_buffer(stats_vdev->dev, &ring->buf);
+	}
+}
+
 static void rkisp_stats_vb2_stop_streaming(struct vb2_queue *vq)
 {
 	struct rkisp_isp_stats_vdev *stats_vdev = vq->drv_priv;
@@ -222,6 +238,8 @@ static void rkisp_stats_vb2_stop_streaming(struct vb2_queue *vq)
 
 	stats_vdev->ae_meas_done_next = false;
 	stats_vdev->af_meas_done_next = false;
+	/* the ring is for one stream, user mapping keeps the memory alive */
+	rkisp_stats_ring_free(stats_vdev);
 }
 
 static int
@@ -438,6 +456,116 @@ int rkisp_register_stats_vdev(struct rkisp_isp_stats_vdev *stats_vdev,
 	return ret;
 }
 
+/*
+ * Set the ring before the stats stream on. While the ring is set, the
+ * stats are written to its slots in turn and userspace picks the newest
+ * one by rkisp_stats_ring_head, the stats video buffers are not used.
+ */
+int rkisp_stats_ring_cfg(struct rkisp_isp_stats_vdev *stats_vdev,
+			 struct rkisp_stats_ring_cfg *cfg)
+{
+	struct rkisp_stats_ring *ring = &stats_vdev->ring;
+	struct rkisp_device *dev = stats_vdev->dev;
+	struct eventfd_ctx *efd = NULL;
+	struct rkisp_stats_ring_head *head;
+	int ret;
+
+	if (stats_vdev->streamon)
+		return -EBUSY;
+
+	rkisp_stats_ring_free(stats_vdev);
+	cfg->buf_fd = -1;
+	cfg->buf_size = 0;
+	if (!cfg->slot_num)
+		return 0;
+	if (cfg->slot_num < 2 || cfg->slot_num > RKISP_STATS_RING_SLOT_MAX)
+		return -EINVAL;
+
+	if (cfg->event_fd >= 0) {
+		efd = eventfd_ctx_fdget(cfg->event_fd);
+		if (IS_ERR(efd))
+			return PTR_ERR(efd);
+	}
+
+	ring->slot_num = cfg->slot_num;
+	ring->slot_size = ALIGN(sizeof(struct rkisp_stats_ring_slot) +
+				stats_vdev->vdev_fmt.fmt.meta.buffersize, 64);
+	ring->data_offset = ALIGN(sizeof(*head), 64);
+	ring->latest = 0;
+	ring->count = 0;
+
+	memset(&ring->buf, 0, sizeof(ring->buf));
+	ring->buf.size = ring->data_offset + ring->slot_size * ring->slot_num;
+	ring->buf.is_need_vaddr = true;
+	ring->buf.is_need_dbuf = true;
+	ring->buf.is_need_dmafd = true;
+	ret = rkisp_alloc_buffer(dev, &ring->buf);
+	if (ret) {
+		if (efd)
+			eventfd_ctx_put(efd);
+		return ret;
+	}
+
+	head = ring->buf.vaddr;
+	memset(head, 0, ring->buf.size);
+	head->slot_num = ring->slot_num;
+	head->slot_size = ring->slot_size;
+	head->data_offset = ring->data_offset;
+	ring->head = head;
+	ring->efd = efd;
+
+	cfg->buf_fd = ring->buf.dma_fd;
+	cfg->buf_size = ring->buf.size;
+	return 0;
+}
+
+/* stats buffer of the next slot, NULL without ring */
+void *rkisp_stats_ring_get(struct rkisp_isp_stats_vdev *stats_vdev)
+{
+	struct rkisp_stats_ring *ring = &stats_vdev->ring;
+	struct rkisp_stats_ring_slot *slot;
+	u32 idx;
+
+	if (!ring->head)
+		return NULL;
+
+	idx = ring->count ? (ring->latest + 1) % ring->slot_num : 0;
+	slot = (void *)ring->head + ring->data_offset + idx * ring->slot_size;
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+	smp_wmb();
+	memset(slot + 1, 0, ring->slot_size - sizeof(*slot));
+	ring->slot = slot;
+	return slot + 1;
+}
+
+/* publish the slot taken by rkisp_stats_ring_get() as the newest stats */
+void rkisp_stats_ring_put(struct rkisp_isp_stats_vdev *stats_vdev,
+			  u32 frame_id, u64 timestamp, u32 size)
+{
+	struct rkisp_stats_ring *ring = &stats_vdev->ring;
+	struct rkisp_stats_ring_slot *slot = ring->slot;
+
+	if (!slot)
+		return;
+
+	slot->frame_id = frame_id;
+	slot->timestamp = timestamp;
+	slot->size = size;
+	smp_wmb();
+	WRITE_ONCE(slot->seq, slot->seq + 1);
+
+	ring->latest = ((void *)slot - (void *)ring->head - ring->data_offset) /
+		       ring->slot_size;
+	ring->count++;
+	WRITE_ONCE(ring->head->latest, ring->latest);
+	smp_wmb();
+	WRITE_ONCE(ring->head->count, ring->count);
+	ring->slot = NULL;
+
+	if (ring->efd)
+		eventfd_signal(ring->efd, 1);
+}
+
 void rkisp_unregister_stats_vdev(struct rkisp_isp_stats_vdev *stats_vdev)
 {
 	struct rkisp_vdev_node *node = &stats_vdev->vnode;
@@ -445,6 +573,7 @@ void rkisp_unregister_stats_vdev(struct rkisp_isp_stats_vdev *stats_vdev)
 
 	kfifo_free(&stats_vdev->rd_kfifo);
 	tasklet_kill(&stats_vdev->rd_tasklet);
+	rkisp_stats_ring_free(stats_vdev);
 	video_unregister_device(vdev);
 	media_entity_cleanup(&vdev->entity);
 	vb2_queue_release(vdev->queue);
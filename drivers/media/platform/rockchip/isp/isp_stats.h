@@ -5,6 +5,7 @@
 #define _RKISP_ISP_STATS_H
 
 #include <linux/rk-isp1-config.h>
+#include <linux/rk-isp2-config.h>
 #include <linux/interrupt.h>
 #include <linux/kfifo.h>
 #include "common.h"
@@ -14,6 +15,30 @@
 	(8 * sizeof(struct rkisp_isp_readout_work))
 
 struct rkisp_isp_stats_vdev;
+struct eventfd_ctx;
+
+/*
+ * struct rkisp_stats_ring - stats ring mapped by userspace
+ *
+ * @buf: ring memory, struct rkisp_stats_ring_head then the slots
+ * @efd: eventfd signaled for each stats written
+ * @head: ring head in @buf
+ * @slot: slot in write, taken by rkisp_stats_ring_get()
+ *
+ * The layout and write position are kept here as well, the copy in @head
+ * is for userspace only that can write the mapped memory.
+ */
+struct rkisp_stats_ring {
+	struct rkisp_dummy_buffer buf;
+	struct eventfd_ctx *efd;
+	struct rkisp_stats_ring_head *head;
+	struct rkisp_stats_ring_slot *slot;
+	u32 slot_num;
+	u32 slot_size;
+	u32 data_offset;
+	u32 latest;
+	u64 count;
+};
 
 enum rkisp_isp_readout_cmd {
 	RKISP_ISP_READOUT_MEAS,
@@ -77,6 +102,8 @@ struct rkisp_isp_stats_vdev {
 
 	bool af_meas_done_next;
 	bool ae_meas_done_next;
+
+	struct rkisp_stats_ring ring;
 };
 
 void rkisp_stats_rdbk_enable(struct rkisp_isp_stats_vdev *stats_vdev, bool en);
@@ -93,4 +120,10 @@ int rkisp_register_stats_vdev(struct rkisp_isp_stats_vdev *stats_vdev,
 
 void rkisp_unregister_stats_vdev(struct rkisp_isp_stats_vdev *stats_vdev);
 
+int rkisp_stats_ring_cfg(struct rkisp_isp_stats_vdev *stats_vdev,
+			 struct rkisp_stats_ring_cfg *cfg);
+void *rkisp_stats_ring_get(struct rkisp_isp_stats_vdev *stats_vdev);
+void rkisp_stats_ring_put(struct rkisp_isp_stats_vdev *stats_vdev,
+			  u32 frame_id, u64 timestamp, u32 size);
+
 #endif /* _RKISP_ISP_STATS_H */
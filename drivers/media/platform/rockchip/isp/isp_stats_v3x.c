@@ -968,9 +968,11 @@ rkisp_stats_send_meas_v3x(struct rkisp_isp_stats_vdev *stats_vdev,
 	u32 size = sizeof(struct rkisp3x_isp_stat_buffer);
 
 	cur_frame_id = meas_work->frame_id;
+	/* ring set by user, stats write to it instead of video buffer */
+	cur_stat_buf = rkisp_stats_ring_get(stats_vdev);
 	spin_lock(&stats_vdev->rd_lock);
 	/* get one empty buffer */
-	if (!cur_buf) {
+	if (!cur_buf && !cur_stat_buf) {
 		if (!list_empty(&stats_vdev->stat)) {
 			cur_buf = list_first_entry(&stats_vdev->stat,
 						   struct rkisp_buffer, queue);
@@ -979,9 +981,10 @@ rkisp_stats_send_meas_v3x(struct rkisp_isp_stats_vdev *stats_vdev,
 	}
 	spin_unlock(&stats_vdev->rd_lock);
 
-	if (cur_buf) {
+	if (cur_buf)
 		cur_stat_buf =
 			(struct rkisp3x_isp_stat_buffer *)(cur_buf->vaddr[0]);
+	if (cur_stat_buf) {
 		cur_stat_buf->frame_id = cur_frame_id;
 		cur_stat_buf->params_id = params_vdev->cur_frame_id;
 	}
@@ -1033,7 +1036,7 @@ rkisp_stats_send_meas_v3x(struct rkisp_isp_stats_vdev *stats_vdev,
 
 	if (stats_vdev->dev->hw_dev->unite) {
 		size *= 2;
-		if (cur_buf) {
+		if (cur_stat_buf) {
 			cur_stat_buf++;
 			cur_stat_buf->frame_id = cur_frame_id;
 		}
@@ -1072,6 +1075,9 @@ rkisp_stats_send_meas_v3x(struct rkisp_isp_stats_vdev *stats_vdev,
 		cur_buf->vb.vb2_buf.timestamp = meas_work->timestamp;
 		vb2_buffer_done(&cur_buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
 		cur_buf = NULL;
+	} else {
+		rkisp_stats_ring_put(stats_vdev, cur_frame_id,
+				     meas_work->timestamp, size);
 	}
 
 	stats_vdev->cur_buf = cur_buf;
@@ -1031,6 +1031,51 @@ static int isp_show(struct seq_file *p, void *v)
 		seq_printf(p, "\t   hw link:%d idle:%d vir(mode:%d index:%d)\n",
 			   dev->hw_dev->dev_link_num, dev->hw_dev->is_idle,
 			   dev->multi_mode, dev->multi_index);
+		{
+			/* estimated from the raw frame size, the mi has no byte counters */
+			u64 frm = stream->out_fmt.plane_fmt[0].sizeimage;
+			u64 cnt = dev->rdbk_cnt_x1 + dev->rdbk_cnt_x2 * 2ULL +
+				  dev->rdbk_cnt_x3 * 3ULL;
+			u32 fps = sdev->dbg.interval ?
+				  div_u64(NSEC_PER_SEC, sdev->dbg.interval) : 0;
+			u32 bw = div_u64(frm * (dev->rd_mode - 3) * fps, 1000000);
+
+			seq_printf(p, "\t   raw bw(wr:%uMB/s rd:%uMB/s read:%lluMB) fbc:%s\n",
+				   (dev->isp_inp & INP_CIF) ? 0 : bw, bw,
+				   div_u64(frm * cnt, 1000000),
+				   dev->hdr.rawfbc ? "on" : "off");
+		}
+		if (!dev->hw_dev->is_single) {
+			struct rkisp_rdbk_stats *stats = &dev->rdbk_stats;
+			struct rkisp_hw_dev *hw = dev->hw_dev;
+			u64 total = hw->rdbk_since_ns ? ktime_get_ns() - hw->rdbk_since_ns : 0;
+			u32 util = total ? div64_u64(hw->rdbk_busy_ns * 100, total) : 0;
+
+			seq_printf(p, "\t   sched:%s fps:%llu frames:%llu drops:%llu misses:%llu"
+				   " latency(last:%uus max:%uus avg:%lluus) hw util:%u%%\n",
+				   rkisp_rdbk_sched ? "deadline" : "fifo",
+				   stats->interval ? div64_u64(NSEC_PER_SEC, stats->interval) : 0,
+				   stats->frames, stats->drops, stats->misses,
+				   stats->lat_last, stats->lat_max,
+				   stats->frames ? div64_u64(stats->lat_sum, stats->frames) : 0,
+				   util);
+		}
+		if (dev->unite_div > ISP_UNITE_DIV1) {
+			u32 *t = dev->unite_pass_time, *m = dev->unite_pass_max;
+
+			/* both halves run at once on two isp, one pass per frame */
+			if (dev->hw_dev->unite == ISP_UNITE_TWO)
+				seq_printf(p, "\t   unite div:%d parallel pass:%uus(max:%uus)\n",
+					   dev->unite_div, t[ISP_UNITE_LEFT], m[ISP_UNITE_LEFT]);
+			else
+				seq_printf(p, "\t   unite div:%d pass(us) L:%u(max:%u) R:%u(max:%u)"
+					   " LB:%u(max:%u) RB:%u(max:%u)\n",
+					   dev->unite_div,
+					   t[ISP_UNITE_LEFT], m[ISP_UNITE_LEFT],
+					   t[ISP_UNITE_RIGHT], m[ISP_UNITE_RIGHT],
+					   t[ISP_UNITE_LEFT_B], m[ISP_UNITE_LEFT_B],
+					   t[ISP_UNITE_RIGHT_B], m[ISP_UNITE_RIGHT_B]);
+		}
 	} else {
 		seq_printf(p, "%-10s frame:%d state:%s time:%dms v-blank:%dus\n",
 			   "Isp online",
@@ -1039,6 +1084,17 @@ static int isp_show(struct seq_file *p, void *v)
 			   sdev->dbg.interval / 1000 / 1000,
 			   sdev->dbg.delay / 1000);
 	}
+	if (dev->is_aiisp_en) {
+		struct rkisp_aiisp_stats *stats = &dev->aiisp_stats;
+
+		seq_printf(p, "%-10s wr_line:%d rd_line:%d rd_mode:%d frames:%llu bands:%llu"
+			   " stall(last:%uus max:%uus avg:%lluus)\n",
+			   "Aiisp",
+			   dev->aiisp_cfg.wr_linecnt, dev->aiisp_cfg.rd_linecnt,
+			   dev->aiisp_cfg.rd_mode, stats->frames, stats->bands,
+			   stats->stall_last, stats->stall_max,
+			   stats->frames ? div64_u64(stats->stall_sum, stats->frames) : 0);
+	}
 	if (dev->br_dev.en)
 		seq_printf(p, "%-10s rkispp%d Format:%s%s Size:%dx%d (frame:%d rate:%dms frameloss:%d)\n",
 			   "Output",
@@ -1105,6 +1161,21 @@ static int isp_show(struct seq_file *p, void *v)
 		break;
 	}
 
+	if (dev->isp_ver >= ISP_V30) {
+		struct rkisp_params_delta *delta = &dev->params_vdev.delta;
+		struct rkisp_params_shadow *shadow = &dev->params_vdev.shadow;
+
+		seq_printf(p, "%-10s delta:%s programmed:%llu skipped:%llu(%lluKB)\n",
+			   "Params",
+			   (dev->procfs.mode & RKISP_PROCFS_NO_DELTA) ? "OFF" : "ON",
+			   delta->programmed, delta->skipped,
+			   delta->skipped_bytes / 1024);
+		seq_printf(p, "%-10s shadow:%s flushes:%llu regs(last:%u max:%u)\n",
+			   "Params",
+			   rkisp_reg_shadow ? "ON" : "OFF",
+			   shadow->flushes, shadow->last, shadow->max);
+	}
+
 	seq_printf(p, "%-10s %s Cnt:%d\n\n",
 		   "Monitor",
 		   dev->hw_dev->monitor.is_en ? "ON" : "OFF",
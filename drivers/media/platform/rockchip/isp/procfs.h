@@ -7,6 +7,8 @@
 enum {
 	RKISP_PROCFS_DUMP_REG = BIT(0),
 	RKISP_PROCFS_DUMP_MEM = BIT(1),
+	/* program all module configs, even unchanged */
+	RKISP_PROCFS_NO_DELTA = BIT(2),
 
 	RKISP_PROCFS_FIL_AIQ = BIT(8),
 	RKISP_PROCFS_FIL_SW = BIT(9),
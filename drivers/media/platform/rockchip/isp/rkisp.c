@@ -894,6 +894,8 @@ void rkisp_trigger_read_back(struct rkisp_device *dev, u8 dma2frm, u32 mode, boo
 	v4l2_dbg(2, rkisp_debug, &dev->v4l2_dev,
 		 "readback frame:%d time:%d 0x%x try:%d\n",
 		 cur_frame_id, dma2frm + 1, val, is_try);
+	dev->unite_pass_index = dev->unite_index;
+	dev->unite_pass_start = ktime_get_ns();
 	if (!hw->is_shutdown)
 		rkisp_unite_write(dev, CSI2RX_CTRL0, val, true);
 }
@@ -934,6 +936,41 @@ static void rkisp_fast_switch_rx_buf(struct rkisp_device *dev, bool is_current)
 	}
 }
 
+/*
+ * Deadline of the oldest queued frame of a virtual isp: its sof plus one
+ * frame interval of its sensor, when the next frame replaces it. Reading
+ * back the earliest deadline first gives each sensor of the shared hw a
+ * share following its own frame rate, not the fifo depth.
+ */
+static u64 rkisp_rdbk_deadline(struct rkisp_device *dev)
+{
+	struct isp2x_csi_trigger t;
+	unsigned long lock_flags = 0;
+	u64 deadline = U64_MAX;
+
+	spin_lock_irqsave(&dev->rdbk_lock, lock_flags);
+	if (kfifo_out_peek(&dev->rdbk_kfifo, &t, sizeof(t)) == sizeof(t))
+		deadline = t.sof_timestamp + dev->rdbk_stats.interval;
+	spin_unlock_irqrestore(&dev->rdbk_lock, lock_flags);
+	return deadline;
+}
+
+static void rkisp_rdbk_stats_update(struct rkisp_device *dev,
+				    struct isp2x_csi_trigger *t, u64 now)
+{
+	struct rkisp_rdbk_stats *stats = &dev->rdbk_stats;
+	u32 lat = 0;
+
+	if (t->sof_timestamp && now > t->sof_timestamp)
+		lat = div_u64(now - t->sof_timestamp, 1000);
+	if (stats->interval && now > t->sof_timestamp + stats->interval)
+		stats->misses++;
+	stats->frames++;
+	stats->lat_last = lat;
+	stats->lat_max = max(stats->lat_max, lat);
+	stats->lat_sum += lat;
+}
+
 static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 {
 	struct rkisp_hw_dev *hw = dev->hw_dev;
@@ -942,6 +979,7 @@ static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 	unsigned long lock_flags = 0;
 	int i, times = -1, max = 0, id = 0;
 	int len[DEV_MAX] = { 0 };
+	u64 deadline, min_deadline = U64_MAX;
 	u32 mode = 0;
 	bool is_try = false;
 
@@ -964,6 +1002,10 @@ static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 		}
 		hw->is_idle = true;
 		hw->pre_dev_id = dev->dev_id;
+		if (hw->rdbk_start_ns) {
+			hw->rdbk_busy_ns += ktime_get_ns() - hw->rdbk_start_ns;
+			hw->rdbk_start_ns = 0;
+		}
 	}
 	if (hw->is_shutdown)
 		hw->is_idle = false;
@@ -985,7 +1027,18 @@ static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 		    (isp && (!(isp->isp_state & ISP_START) || isp->is_suspend)))
 			continue;
 		rkisp_rdbk_trigger_event(isp, T_CMD_LEN, &len[i]);
-		if (max < len[i]) {
+		if (!len[i])
+			continue;
+		if (rkisp_rdbk_sched) {
+			/* same deadline: the deeper fifo first */
+			deadline = rkisp_rdbk_deadline(isp);
+			if (deadline < min_deadline ||
+			    (deadline == min_deadline && max < len[i])) {
+				min_deadline = deadline;
+				max = len[i];
+				id = i;
+			}
+		} else if (max < len[i]) {
 			max = len[i];
 			id = i;
 		}
@@ -1000,6 +1053,10 @@ static void rkisp_rdbk_trigger_handle(struct rkisp_device *dev, u32 cmd)
 		v4l2_dbg(2, rkisp_debug, &isp->v4l2_dev,
 			 "trigger fifo len:%d\n", max);
 		rkisp_rdbk_trigger_event(isp, T_CMD_DEQUEUE, &t);
+		hw->rdbk_start_ns = ktime_get_ns();
+		if (!hw->rdbk_since_ns)
+			hw->rdbk_since_ns = hw->rdbk_start_ns;
+		rkisp_rdbk_stats_update(isp, &t, hw->rdbk_start_ns);
 		isp->dmarx_dev.pre_frame = isp->dmarx_dev.cur_frame;
 		if (t.frame_id > isp->dmarx_dev.pre_frame.id &&
 		    t.frame_id - isp->dmarx_dev.pre_frame.id > 1)
@@ -1064,7 +1121,9 @@ int rkisp_rdbk_trigger_event(struct rkisp_device *dev, u32 cmd, void *arg)
 {
 	struct kfifo *fifo = &dev->rdbk_kfifo;
 	struct isp2x_csi_trigger *trigger = NULL;
+	struct rkisp_rdbk_stats *stats = &dev->rdbk_stats;
 	unsigned long lock_flags = 0;
+	u64 interval;
 	int val, ret = 0;
 
 	spin_lock_irqsave(&dev->rdbk_lock, lock_flags);
@@ -1073,10 +1132,21 @@ int rkisp_rdbk_trigger_event(struct rkisp_device *dev, u32 cmd, void *arg)
 		trigger = arg;
 		if (!trigger)
 			break;
-		if (!kfifo_is_full(fifo))
+		if (stats->last_sof && trigger->sof_timestamp > stats->last_sof &&
+		    trigger->frame_id > stats->last_id) {
+			interval = div_u64(trigger->sof_timestamp - stats->last_sof,
+					   trigger->frame_id - stats->last_id);
+			stats->interval = stats->interval ?
+				(stats->interval * 7 + interval) / 8 : interval;
+		}
+		stats->last_sof = trigger->sof_timestamp;
+		stats->last_id = trigger->frame_id;
+		if (!kfifo_is_full(fifo)) {
 			kfifo_in(fifo, trigger, sizeof(*trigger));
-		else
+		} else {
+			stats->drops++;
 			v4l2_err(&dev->v4l2_dev, "rdbk fifo is full\n");
+		}
 		break;
 	case T_CMD_DEQUEUE:
 		if (!kfifo_is_empty(fifo))
@@ -1131,6 +1201,15 @@ void rkisp_check_idle(struct rkisp_device *dev, u32 irq)
 	}
 	spin_unlock_irqrestore(&dev->hw_dev->rdbk_lock, lock_flags);
 
+	if (dev->unite_pass_start && dev->unite_pass_index < ISP_UNITE_MAX) {
+		val = div_u64(ktime_get_ns() - dev->unite_pass_start, 1000);
+		dev->unite_pass_time[dev->unite_pass_index] = val;
+		if (val > dev->unite_pass_max[dev->unite_pass_index])
+			dev->unite_pass_max[dev->unite_pass_index] = val;
+		dev->unite_pass_start = 0;
+		val = 0;
+	}
+
 	if (dev->sw_rd_cnt)
 		goto end;
 
@@ -1974,15 +2053,18 @@ static void rkisp_start_3a_run(struct rkisp_device *dev)
 	struct v4l2_event ev = {
 		.type = CIFISP_V4L2_EVENT_STREAM_START,
 	};
+	bool is_snapshot;
 	int ret = 1000;
 
-	if (!rkisp_is_need_3a(dev) || dev->isp_ver == ISP_V20 ||
-	    !params_vdev->is_subs_evt)
+	if (!rkisp_is_need_3a(dev) || dev->isp_ver == ISP_V20)
+		return;
+	is_snapshot = rkisp_params_load_snapshot(params_vdev);
+	if (!params_vdev->is_subs_evt)
 		return;
 
 	v4l2_event_queue(vdev, &ev);
-	/* thunderboot no need to wait aiq first param */
-	if (dev->is_pre_on)
+	/* thunderboot or snapshot no need to wait aiq first param */
+	if (dev->is_pre_on || is_snapshot)
 		return;
 	/* rk3326/px30 require first params queued before
 	 * rkisp_params_configure_isp() called
@@ -2981,6 +3063,9 @@ static int rkisp_isp_sd_s_stream(struct v4l2_subdev *sd, int on)
 	hw_dev->is_runing = true;
 	rkisp_start_3a_run(isp_dev);
 	memset(&isp_dev->isp_sdev.dbg, 0, sizeof(isp_dev->isp_sdev.dbg));
+	memset(&isp_dev->rdbk_stats, 0, sizeof(isp_dev->rdbk_stats));
+	memset(isp_dev->unite_pass_max, 0, sizeof(isp_dev->unite_pass_max));
+	memset(&isp_dev->aiisp_stats, 0, sizeof(isp_dev->aiisp_stats));
 	if (atomic_inc_return(&hw_dev->refcnt) > hw_dev->dev_link_num) {
 		dev_err(isp_dev->dev, "%s fail: input link before hw start\n", __func__);
 		atomic_dec(&hw_dev->refcnt);
@@ -3608,10 +3693,28 @@ static void rkisp_queue_event_aiisp(struct rkisp_device *dev, u32 irq)
 
 	val = rkisp_read(dev, ISP39_AIISP_LINE_CNT, false);
 	if (irq & ISP3X_OUT_FRM_QUARTER) {
+		struct rkisp_aiisp_stats *stats = &dev->aiisp_stats;
+		unsigned long lock_flags = 0;
+
 		rd_line = ISP39_AIISP_RD_LINECNT(val);
 		ev.id = RKISP_AIISP_RD_LINECNT_ID;
 		ev_info->height = !rd_line ? h : rd_line;
 
+		spin_lock_irqsave(&dev->aiisp_lock, lock_flags);
+		if (!rd_line) {
+			/* whole frame read */
+			stats->stall_last = div_u64(stats->cur_stall, 1000);
+			stats->stall_max = max(stats->stall_max, stats->stall_last);
+			stats->stall_sum += stats->stall_last;
+			stats->frames++;
+			stats->cur_stall = 0;
+			stats->rd_wait_ts = 0;
+		} else if (dev->aiisp_cfg.rd_mode) {
+			/* read stop at the band, until next slice start */
+			stats->rd_wait_ts = rkisp_time_get_ns(dev);
+		}
+		spin_unlock_irqrestore(&dev->aiisp_lock, lock_flags);
+
 		if (dev->aiisp_cfg.rd_mode) {
 			rd_line += dev->aiisp_cfg.rd_linecnt;
 			if (rd_line > h)
@@ -3705,6 +3808,8 @@ static int rkisp_get_aiisp_linecnt(struct rkisp_device *dev,
 
 static void rkisp_aiisp_rd_start(struct rkisp_device *dev)
 {
+	struct rkisp_aiisp_stats *stats = &dev->aiisp_stats;
+	unsigned long lock_flags = 0;
 	u32 val;
 
 	if (!dev->is_aiisp_en)
@@ -3717,6 +3822,13 @@ static void rkisp_aiisp_rd_start(struct rkisp_device *dev)
 	} else {
 		val = ISP39_SLICE_EN | ISP39_SLICE_ST;
 		rkisp_write(dev, ISP39_SLICE_ST_CTRL, val, true);
+		spin_lock_irqsave(&dev->aiisp_lock, lock_flags);
+		if (stats->rd_wait_ts) {
+			stats->cur_stall += rkisp_time_get_ns(dev) - stats->rd_wait_ts;
+			stats->rd_wait_ts = 0;
+			stats->bands++;
+		}
+		spin_unlock_irqrestore(&dev->aiisp_lock, lock_flags);
 	}
 	v4l2_dbg(2, rkisp_debug, &dev->v4l2_dev,
 		 "%s 0x%x:0x%x\n", __func__, ISP39_AIISP_LINE_CNT, val);
@@ -3837,6 +3949,9 @@ static long rkisp_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
 	case RKISP_CMD_INFO2DDR:
 		ret = rkisp_params_info2ddr_cfg(&isp_dev->params_vdev, arg);
 		break;
+	case RKISP_CMD_SET_STATS_RING:
+		ret = rkisp_stats_ring_cfg(&isp_dev->stats_vdev, arg);
+		break;
 	case RKISP_CMD_MESHBUF_FREE:
 		rkisp_params_meshbuf_free(&isp_dev->params_vdev, *(u64 *)arg);
 		break;
@@ -3948,6 +4063,11 @@ static long rkisp_compat_ioctl32(struct v4l2_subdev *sd,
 		cp_f_us = true;
 		cp_t_us = true;
 		break;
+	case RKISP_CMD_SET_STATS_RING:
+		size = sizeof(struct rkisp_stats_ring_cfg);
+		cp_f_us = true;
+		cp_t_us = true;
+		break;
 	case RKISP_CMD_MESHBUF_FREE:
 		size = sizeof(u64);
 		cp_f_us = true;
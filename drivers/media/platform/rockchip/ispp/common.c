@@ -45,9 +45,16 @@ void rkispp_clear_bits(struct rkispp_device *dev, u32 reg, u32 mask)
 	rkispp_write(dev, reg, tmp & ~mask);
 }
 
+/*
+ * Load the cached config of dev into the hw for multi dev. With batch,
+ * the registers already written are tagged SW_REG_CACHE_SYNC and only
+ * rewritten once another dev or a reset has been on the hw in between,
+ * so frames of the same dev back to back just load what changed.
+ */
 void rkispp_update_regs(struct rkispp_device *dev, u32 start, u32 end)
 {
 	void __iomem *base = dev->hw_dev->base_addr;
+	bool is_full = !rkispp_batch || dev->hw_dev->is_reg_full;
 	u32 i;
 
 	if (end > RKISP_ISPP_SW_REG_SIZE - 4) {
@@ -58,8 +65,12 @@ void rkispp_update_regs(struct rkispp_device *dev, u32 start, u32 end)
 		u32 *val = dev->sw_base_addr + i;
 		u32 *flag = dev->sw_base_addr + i + RKISP_ISPP_SW_REG_SIZE;
 
-		if (*flag == SW_REG_CACHE)
+		if (*flag == SW_REG_CACHE ||
+		    (*flag == SW_REG_CACHE_SYNC && is_full)) {
 			writel(*val, base + i);
+			if (rkispp_batch)
+				*flag = SW_REG_CACHE_SYNC;
+		}
 	}
 }
 
@@ -374,12 +385,24 @@ static void rkispp_queue_dmabuf(struct rkispp_hw_dev *hw, struct rkisp_ispp_buf
 		/* ispp idle or handle same device */
 		buf = dbufs;
 	} else if (hw->is_idle && !list_empty(list)) {
+		if (dbufs)
+			list_add_tail(&dbufs->list, list);
 		/* ispp idle and handle first buf in list */
 		buf = list_first_entry(list,
 			struct rkisp_ispp_buf, list);
+		/* or keep on the same dev to skip its config reload */
+		if (rkispp_batch && hw->batch_cnt < rkispp_batch &&
+		    buf->index != hw->cur_dev_id) {
+			struct rkisp_ispp_buf *tmp;
+
+			list_for_each_entry(tmp, list, list) {
+				if (tmp->index == hw->cur_dev_id) {
+					buf = tmp;
+					break;
+				}
+			}
+		}
 		list_del(&buf->list);
-		if (dbufs)
-			list_add_tail(&dbufs->list, list);
 	} else if (dbufs) {
 		/* new buf into queue wait for handle */
 		list_add_tail(&dbufs->list, list);
@@ -387,6 +410,13 @@ static void rkispp_queue_dmabuf(struct rkispp_hw_dev *hw, struct rkisp_ispp_buf
 
 	if (buf) {
 		hw->is_idle = false;
+		if (buf->index != hw->cur_dev_id) {
+			hw->is_reg_loaded = false;
+			hw->batch_cnt = 0;
+		}
+		hw->is_reg_full = !hw->is_reg_loaded;
+		hw->is_reg_loaded = true;
+		hw->batch_cnt++;
 		hw->cur_dev_id = buf->index;
 		ispp = hw->ispp[buf->index];
 		vdev = &ispp->stream_vdev;
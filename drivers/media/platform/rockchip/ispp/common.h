@@ -117,6 +117,7 @@ extern bool rkispp_monitor;
 extern bool rkispp_reg_withstream;
 extern char rkispp_reg_withstream_video_name[RKISPP_VIDEO_NAME_LEN];
 extern unsigned int rkispp_debug_reg;
+extern unsigned int rkispp_batch;
 extern struct platform_driver rkispp_plat_drv;
 extern char rkispp_dump_path[128];
 
@@ -56,6 +56,8 @@ void rkispp_soft_reset(struct rkispp_hw_dev *hw)
 		rockchip_iommu_disable(hw->dev);
 		rockchip_iommu_enable(hw->dev);
 	}
+	hw->is_reg_full = true;
+	hw->is_reg_loaded = false;
 	if (hw->ispp_ver == ISPP_V10) {
 		writel(SW_SCL_BYPASS, hw->base_addr + RKISPP_SCL0_CTRL);
 		writel(SW_SCL_BYPASS, hw->base_addr + RKISPP_SCL1_CTRL);
@@ -42,6 +42,8 @@ struct rkispp_hw_dev {
 	int clks_num;
 	int dev_num;
 	int cur_dev_id;
+	/* frames of cur_dev_id handled back to back */
+	u32 batch_cnt;
 	unsigned long core_clk_min;
 	unsigned long core_clk_max;
 	enum rkispp_ver	ispp_ver;
@@ -61,6 +63,10 @@ struct rkispp_hw_dev {
 	bool is_dma_sg_ops;
 	bool is_shutdown;
 	bool is_first;
+	/* hw regs no longer hold the config of cur_dev_id */
+	bool is_reg_full;
+	/* config of cur_dev_id loaded since the last reset */
+	bool is_reg_loaded;
 };
 
 void rkispp_soft_reset(struct rkispp_hw_dev *hw_dev);
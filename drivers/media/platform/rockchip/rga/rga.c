@@ -24,6 +24,7 @@
 #include <media/v4l2-mem2mem.h>
 #include <media/videobuf2-dma-sg.h>
 #include <media/videobuf2-v4l2.h>
+#include <soc/rockchip/rockchip_media_trace.h>
 
 #include "rga-hw.h"
 #include "rga.h"
@@ -31,6 +32,14 @@
 static int debug;
 module_param(debug, int, 0644);
 
+static struct dma_buf *rga_vb_dmabuf(struct vb2_v4l2_buffer *vb)
+{
+	if (vb->vb2_buf.memory != VB2_MEMORY_DMABUF)
+		return NULL;
+
+	return vb->vb2_buf.planes[0].dbuf;
+}
+
 static void device_run(void *prv)
 {
 	struct rga_ctx *ctx = prv;
@@ -48,6 +57,13 @@ static void device_run(void *prv)
 	rga_buf_map(&src->vb2_buf);
 	rga_buf_map(&dst->vb2_buf);
 
+	if (rk_media_trace_enabled()) {
+		/* the output carries the frame of its input */
+		rk_media_buf_copy_frame(rga_vb_dmabuf(dst), rga_vb_dmabuf(src));
+		rk_media_buf_trace(rga->dev, rga_vb_dmabuf(src), RK_MEDIA_START);
+		rk_media_buf_trace(rga->dev, rga_vb_dmabuf(dst), RK_MEDIA_START);
+	}
+
 	rga_hw_start(rga);
 
 	spin_unlock_irqrestore(&rga->ctrl_lock, flags);
@@ -81,6 +97,8 @@ static irqreturn_t rga_isr(int irq, void *prv)
 		dst->flags &= ~V4L2_BUF_FLAG_TSTAMP_SRC_MASK;
 		dst->flags |= src->flags & V4L2_BUF_FLAG_TSTAMP_SRC_MASK;
 
+		rk_media_buf_trace(rga->dev, rga_vb_dmabuf(dst), RK_MEDIA_DONE);
+
 		v4l2_m2m_buf_done(src, VB2_BUF_STATE_DONE);
 		v4l2_m2m_buf_done(dst, VB2_BUF_STATE_DONE);
 		v4l2_m2m_job_finish(rga->m2m_dev, ctx->fh.m2m_ctx);
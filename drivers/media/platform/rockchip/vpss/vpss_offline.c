@@ -3,6 +3,9 @@
 
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/dma-fence.h>
+#include <linux/file.h>
+#include <linux/sync_file.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-fh.h>
 #include <media/v4l2-ioctl.h>
@@ -33,6 +36,13 @@ struct rkvpss_offline_buf {
 	bool alloc;
 };
 
+struct rkvpss_offline_job {
+	struct work_struct work;
+	struct rkvpss_frame_cfg cfg;
+	struct file *file;
+	struct dma_fence *fence;
+};
+
 static void init_vb2(struct rkvpss_offline_dev *ofl,
 		     struct rkvpss_offline_buf *buf)
 {
@@ -1949,6 +1959,44 @@ static int rkvpss_check_params(struct file *file, struct rkvpss_frame_cfg *cfg,
 	return ret;
 }
 
+static int rkvpss_ofl_set_skip(struct file *file, struct rkvpss_output_skip *skip)
+{
+	struct rkvpss_offline_dev *ofl = video_drvdata(file);
+
+	if (skip->dev_id < 0 || skip->dev_id >= DEV_NUM_MAX) {
+		v4l2_err(&ofl->v4l2_dev, "dev_id:%d is out of range. range[0, %d]\n",
+			 skip->dev_id, DEV_NUM_MAX);
+		return -EINVAL;
+	}
+	memcpy(ofl->output_skip[skip->dev_id], skip->skip, RKVPSS_OUTPUT_MAX);
+	return 0;
+}
+
+/* disable the channels skip this frame, false if no channel left to run */
+static bool output_skip(struct rkvpss_offline_dev *ofl, struct rkvpss_frame_cfg *cfg)
+{
+	u8 *skip;
+	int i;
+	bool is_run = false;
+
+	if (cfg->dev_id < 0)
+		return true;
+	skip = ofl->output_skip[cfg->dev_id];
+	for (i = 0; i < RKVPSS_OUTPUT_MAX; i++) {
+		if (!cfg->output[i].enable)
+			continue;
+		if (skip[i] && (u32)cfg->sequence % (skip[i] + 1)) {
+			cfg->output[i].enable = 0;
+			v4l2_dbg(3, rkvpss_debug, &ofl->v4l2_dev,
+				 "dev_id:%d seq:%d ch%d skip\n",
+				 cfg->dev_id, cfg->sequence, i);
+			continue;
+		}
+		is_run = true;
+	}
+	return is_run;
+}
+
 static int rkvpss_prepare_run(struct file *file, struct rkvpss_frame_cfg *cfg)
 {
 	struct rkvpss_offline_dev *ofl = video_drvdata(file);
@@ -1959,6 +2007,10 @@ static int rkvpss_prepare_run(struct file *file, struct rkvpss_frame_cfg *cfg)
 	if (ret < 0)
 		goto end;
 
+	/* all channels skip, no input fetch for this frame */
+	if (!output_skip(ofl, cfg))
+		goto end;
+
 	if (!unite) {
 		ret = rkvpss_ofl_run(file, cfg, false, false);
 		if (ret < 0)
@@ -1981,6 +2033,107 @@ static int rkvpss_prepare_run(struct file *file, struct rkvpss_frame_cfg *cfg)
 	return ret;
 }
 
+static const char *rkvpss_ofl_fence_get_name(struct dma_fence *fence)
+{
+	return "rkvpss-offline";
+}
+
+static const struct dma_fence_ops rkvpss_ofl_fence_ops = {
+	.get_driver_name = rkvpss_ofl_fence_get_name,
+	.get_timeline_name = rkvpss_ofl_fence_get_name,
+};
+
+static void rkvpss_ofl_job_work(struct work_struct *work)
+{
+	struct rkvpss_offline_job *job =
+		container_of(work, struct rkvpss_offline_job, work);
+	struct rkvpss_offline_dev *ofl = video_drvdata(job->file);
+	int ret;
+
+	/* serialize with the ioctl of all files, as the sync frame handle */
+	mutex_lock(&ofl->apilock);
+	ret = rkvpss_prepare_run(job->file, &job->cfg);
+	mutex_unlock(&ofl->apilock);
+
+	v4l2_dbg(2, rkvpss_debug, &ofl->v4l2_dev,
+		 "%s dev_id:%d seq:%d ret:%d\n",
+		 __func__, job->cfg.dev_id, job->cfg.sequence, ret);
+	if (ret < 0)
+		dma_fence_set_error(job->fence, ret);
+	dma_fence_signal(job->fence);
+	dma_fence_put(job->fence);
+	atomic_dec(&ofl->job_cnt);
+	fput(job->file);
+	kfree(job);
+}
+
+/*
+ * Copy the frame cfg into a job for the ordered job_wq and return at once,
+ * so one thread can keep several frames queued. The job holds a reference
+ * of the file, buffers added by it stay valid until the job is done.
+ */
+static int rkvpss_ofl_queue_job(struct file *file, struct rkvpss_frame_async *async)
+{
+	struct rkvpss_offline_dev *ofl = video_drvdata(file);
+	struct rkvpss_offline_job *job;
+	struct sync_file *sync_file;
+	unsigned long flags;
+	bool unite;
+	int ret, fd;
+
+	async->out_fence_fd = -1;
+	ret = rkvpss_check_params(file, &async->cfg, &unite);
+	if (ret < 0)
+		return ret;
+
+	if (atomic_inc_return(&ofl->job_cnt) > RKVPSS_OFL_JOB_MAX) {
+		ret = -EBUSY;
+		goto err;
+	}
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	job->fence = kzalloc(sizeof(*job->fence), GFP_KERNEL);
+	if (!job->fence) {
+		ret = -ENOMEM;
+		goto free_job;
+	}
+	spin_lock_irqsave(&ofl->fence_lock, flags);
+	dma_fence_init(job->fence, &rkvpss_ofl_fence_ops, &ofl->fence_lock,
+		       ofl->fence_context, ++ofl->fence_seqno);
+	spin_unlock_irqrestore(&ofl->fence_lock, flags);
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto put_fence;
+	}
+	sync_file = sync_file_create(job->fence);
+	if (!sync_file) {
+		put_unused_fd(fd);
+		ret = -ENOMEM;
+		goto put_fence;
+	}
+	fd_install(fd, sync_file->file);
+	async->out_fence_fd = fd;
+
+	job->cfg = async->cfg;
+	job->file = get_file(file);
+	INIT_WORK(&job->work, rkvpss_ofl_job_work);
+	queue_work(ofl->job_wq, &job->work);
+	return 0;
+put_fence:
+	dma_fence_put(job->fence);
+free_job:
+	kfree(job);
+err:
+	atomic_dec(&ofl->job_cnt);
+	return ret;
+}
+
 static long rkvpss_ofl_ioctl(struct file *file, void *fh,
 			     bool valid_prio, unsigned int cmd, void *arg)
 {
@@ -2009,6 +2162,12 @@ static long rkvpss_ofl_ioctl(struct file *file, void *fh,
 	case RKVPSS_CMD_CHECKPARAMS:
 		ret = rkvpss_check_params(file, arg, &unite);
 		break;
+	case RKVPSS_CMD_FRAME_HANDLE_ASYNC:
+		ret = rkvpss_ofl_queue_job(file, arg);
+		break;
+	case RKVPSS_CMD_SET_OUTPUT_SKIP:
+		ret = rkvpss_ofl_set_skip(file, arg);
+		break;
 	default:
 		ret = -EFAULT;
 	}
@@ -2099,6 +2258,15 @@ int rkvpss_register_offline(struct rkvpss_hw_dev *hw)
 	if (ret)
 		return ret;
 
+	ofl->job_wq = alloc_ordered_workqueue("rkvpss_ofl", WQ_HIGHPRI);
+	if (!ofl->job_wq) {
+		ret = -ENOMEM;
+		goto unreg_v4l2_dev;
+	}
+	spin_lock_init(&ofl->fence_lock);
+	ofl->fence_context = dma_fence_context_alloc(1);
+	atomic_set(&ofl->job_cnt, 0);
+
 	mutex_init(&ofl->apilock);
 	ofl->vfd = offline_videodev;
 	ofl->mode_sel_en = true;
@@ -2119,12 +2287,15 @@ int rkvpss_register_offline(struct rkvpss_hw_dev *hw)
 	return 0;
 unreg_v4l2:
 	mutex_destroy(&ofl->apilock);
+	destroy_workqueue(ofl->job_wq);
+unreg_v4l2_dev:
 	v4l2_device_unregister(v4l2_dev);
 	return ret;
 }
 
 void rkvpss_unregister_offline(struct rkvpss_hw_dev *hw)
 {
+	destroy_workqueue(hw->ofl_dev.job_wq);
 	mutex_destroy(&hw->ofl_dev.apilock);
 	video_unregister_device(&hw->ofl_dev.vfd);
 	v4l2_device_unregister(&hw->ofl_dev.v4l2_dev);
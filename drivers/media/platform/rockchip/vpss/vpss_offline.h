@@ -6,6 +6,7 @@
 #define DEV_NUM_MAX 256
 #define UNITE_ENLARGE 16
 #define UNITE_LEFT_ENLARGE 16
+#define RKVPSS_OFL_JOB_MAX 16
 
 #include "hw.h"
 
@@ -73,8 +74,17 @@ struct rkvpss_offline_dev {
 	struct mutex ofl_lock;
 	struct rkvpss_dev_rate dev_rate[DEV_NUM_MAX];
 	struct rkvpss_unite_scl_params unite_params[RKVPSS_OUTPUT_MAX];
+	u8 output_skip[DEV_NUM_MAX][RKVPSS_OUTPUT_MAX];
 	u32 unite_right_enlarge;
 	bool mode_sel_en;
+
+	/* async frame handle */
+	struct workqueue_struct *job_wq;
+	/* lock for job fence */
+	spinlock_t fence_lock;
+	u64 fence_context;
+	u64 fence_seqno;
+	atomic_t job_cnt;
 };
 
 int rkvpss_register_offline(struct rkvpss_hw_dev *hw);
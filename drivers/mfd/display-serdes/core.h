@@ -379,6 +379,13 @@ struct serdes {
 	bool route_enable;
 	bool use_delay_work;
 
+	/* init on the per-bus workqueue, see serdes-async-init */
+	struct workqueue_struct *async_wq;
+	struct work_struct async_init_work;
+	bool early_seq;
+	/* init sequence in auto-increment bursts */
+	bool burst_write;
+
 	struct kthread_worker *kworker;
 	struct kthread_delayed_work reg_check_work;
 	bool use_reg_check_work;
@@ -11,46 +11,160 @@
 
 static struct serdes *g_serdes_ser_split[MAX_NUM_SERDES_SPLIT];
 
-int serdes_i2c_set_sequence(struct serdes *serdes)
+/*
+ * With serdes-async-init, links on different i2c buses are brought up in
+ * parallel, while chips sharing a bus (a ser and the des behind it) keep
+ * their probe order on one ordered workqueue per bus.
+ */
+#define MAX_NUM_SERDES_BUS	8
+
+static DEFINE_MUTEX(serdes_bus_lock);
+static struct {
+	int nr;
+	struct workqueue_struct *wq;
+} serdes_bus[MAX_NUM_SERDES_BUS];
+
+/* a reg of 0xffff in the init sequence is a delay of def us */
+#define SERDES_SEQ_DELAY_REG	0xffff
+#define SERDES_SEQ_BURST_MAX	32
+
+/* Runs of consecutive registers go out as one auto-increment burst */
+static int serdes_seq_run_len(struct serdes *serdes,
+			      const struct serdes_init_seq *seq, int i)
+{
+	const struct reg_sequence *rs = seq->reg_sequence;
+	int n = 1;
+
+	if (!serdes->burst_write)
+		return 1;
+
+	while (i + n < seq->reg_seq_cnt && n < SERDES_SEQ_BURST_MAX &&
+	       rs[i + n].reg != SERDES_SEQ_DELAY_REG &&
+	       rs[i + n].reg == rs[i].reg + n)
+		n++;
+
+	return n;
+}
+
+static int serdes_seq_xfer(struct serdes *serdes, unsigned int reg,
+			   unsigned int *val, int n, bool write)
+{
+	int val_bytes = regmap_get_val_bytes(serdes->regmap);
+	u8 buf[SERDES_SEQ_BURST_MAX * 2];
+	u16 *buf16 = (u16 *)buf;
+	int i, ret;
+
+	if (n == 1 || val_bytes < 1 || val_bytes > 2) {
+		for (i = 0; i < n; i++) {
+			ret = write ? serdes_reg_write(serdes, reg + i, val[i]) :
+				      serdes_reg_read(serdes, reg + i, &val[i]);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+
+	if (write) {
+		for (i = 0; i < n; i++) {
+			if (val_bytes == 1)
+				buf[i] = val[i];
+			else
+				buf16[i] = val[i];
+		}
+		ret = regmap_bulk_write(serdes->regmap, reg, buf, n);
+		SERDES_DBG_I2C("%s %s Write Reg%04x x%d ret=%d\n", __func__,
+			       dev_name(serdes->dev), reg, n, ret);
+		return ret;
+	}
+
+	ret = regmap_bulk_read(serdes->regmap, reg, buf, n);
+	if (ret)
+		return ret;
+	for (i = 0; i < n; i++)
+		val[i] = val_bytes == 1 ? buf[i] : buf16[i];
+
+	return 0;
+}
+
+/* True if the chip still holds every value of the sequence, e.g. after resume */
+static bool serdes_i2c_seq_applied(struct serdes *serdes,
+				   const struct serdes_init_seq *seq)
+{
+	const struct reg_sequence *rs = seq->reg_sequence;
+	unsigned int val[SERDES_SEQ_BURST_MAX];
+	int i, j, n;
+
+	for (i = 0; i < seq->reg_seq_cnt; i += n) {
+		n = 1;
+		if (rs[i].reg == SERDES_SEQ_DELAY_REG)
+			continue;
+
+		n = serdes_seq_run_len(serdes, seq, i);
+		if (serdes_seq_xfer(serdes, rs[i].reg, val, n, false))
+			return false;
+		for (j = 0; j < n; j++)
+			if (val[j] != rs[i + j].def)
+				return false;
+	}
+
+	return true;
+}
+
+static int serdes_i2c_write_seq(struct serdes *serdes,
+				const struct serdes_init_seq *seq,
+				bool skip_applied)
 {
+	const struct reg_sequence *rs = seq->reg_sequence;
 	struct device *dev = serdes->dev;
-	int i, num = 0, ret = 0;
-	unsigned int def = 0;
+	unsigned int val[SERDES_SEQ_BURST_MAX];
+	int i, j, n, num = 0, ret = 0, rd;
+
+	if (skip_applied && serdes_i2c_seq_applied(serdes, seq)) {
+		SERDES_DBG_MFD("%s: %s sequence already applied\n", __func__,
+			       dev_name(dev));
+		return 0;
+	}
 
-	for (i = 0; i < serdes->serdes_init_seq->reg_seq_cnt; i++) {
-		if (serdes->serdes_init_seq->reg_sequence[i].reg == 0xffff) {
-			SERDES_DBG_MFD("%s: delay 0x%04x us\n", __func__,
-				       serdes->serdes_init_seq->reg_sequence[i].def);
-			udelay(serdes->serdes_init_seq->reg_sequence[i].def);
+	for (i = 0; i < seq->reg_seq_cnt; i += n) {
+		n = 1;
+		if (rs[i].reg == SERDES_SEQ_DELAY_REG) {
+			SERDES_DBG_MFD("%s: delay 0x%04x us\n", __func__, rs[i].def);
+			fsleep(rs[i].def);
 			continue;
 		}
 
-		ret = serdes_reg_write(serdes,
-				       serdes->serdes_init_seq->reg_sequence[i].reg,
-				       serdes->serdes_init_seq->reg_sequence[i].def);
+		n = serdes_seq_run_len(serdes, seq, i);
+		for (j = 0; j < n; j++)
+			val[j] = rs[i + j].def;
 
+		ret = serdes_seq_xfer(serdes, rs[i].reg, val, n, true);
 		if (ret < 0) {
 			SERDES_DBG_MFD("%s failed to write reg %04x, ret %d, again now\n",
-				       dev_name(serdes->dev),
-				       serdes->serdes_init_seq->reg_sequence[i].reg, ret);
-			ret = serdes_reg_write(serdes,
-					       serdes->serdes_init_seq->reg_sequence[i].reg,
-					       serdes->serdes_init_seq->reg_sequence[i].def);
+				       dev_name(dev), rs[i].reg, ret);
+			ret = serdes_seq_xfer(serdes, rs[i].reg, val, n, true);
 		}
-		serdes_reg_read(serdes, serdes->serdes_init_seq->reg_sequence[i].reg, &def);
-		if ((def != serdes->serdes_init_seq->reg_sequence[i].def) || (ret < 0)) {
-			/* if read value != write value then write again */
+
+		/* if read value != write value then write again */
+		rd = serdes_seq_xfer(serdes, rs[i].reg, val, n, false);
+		for (j = 0; j < n; j++) {
+			if (!rd && val[j] == rs[i + j].def && ret >= 0)
+				continue;
 			if (num++ < 1)
 				dev_err(dev, "read %04x %04x != %04x\n",
-					serdes->serdes_init_seq->reg_sequence[i].reg,
-					def, serdes->serdes_init_seq->reg_sequence[i].def);
-			serdes_reg_write(serdes,
-					 serdes->serdes_init_seq->reg_sequence[i].reg,
-					 serdes->serdes_init_seq->reg_sequence[i].def);
+					rs[i + j].reg, val[j], rs[i + j].def);
+			serdes_reg_write(serdes, rs[i + j].reg, rs[i + j].def);
 		}
 	}
 
-	dev_info(dev, "serdes %s sequence_init\n", serdes->chip_data->name);
+	return ret;
+}
+
+int serdes_i2c_set_sequence(struct serdes *serdes)
+{
+	int ret;
+
+	ret = serdes_i2c_write_seq(serdes, serdes->serdes_init_seq, false);
+	dev_info(serdes->dev, "serdes %s sequence_init\n", serdes->chip_data->name);
 
 	return ret;
 }
@@ -94,43 +208,7 @@ static int serdes_set_i2c_address(struct serdes *serdes, u32 reg_hw, u32 reg_use
 
 static int serdes_i2c_set_sequence_backup(struct serdes *serdes)
 {
-	struct device *dev = serdes->dev;
-	int i, num = 0, ret = 0;
-	unsigned int def = 0;
-
-	for (i = 0; i < serdes->serdes_backup_seq->reg_seq_cnt; i++) {
-		if (serdes->serdes_backup_seq->reg_sequence[i].reg == 0xffff) {
-			SERDES_DBG_MFD("%s: delay 0x%04x us\n", __func__,
-				       serdes->serdes_backup_seq->reg_sequence[i].def);
-			udelay(serdes->serdes_backup_seq->reg_sequence[i].def);
-			continue;
-		}
-
-		ret = serdes_reg_write(serdes,
-				       serdes->serdes_backup_seq->reg_sequence[i].reg,
-				       serdes->serdes_backup_seq->reg_sequence[i].def);
-		if (ret < 0) {
-			SERDES_DBG_MFD("%s failed to write reg %04x, ret %d, again now\n",
-				       dev_name(serdes->dev),
-				       serdes->serdes_backup_seq->reg_sequence[i].reg, ret);
-			ret = serdes_reg_write(serdes,
-					       serdes->serdes_backup_seq->reg_sequence[i].reg,
-					       serdes->serdes_backup_seq->reg_sequence[i].def);
-		}
-		serdes_reg_read(serdes, serdes->serdes_backup_seq->reg_sequence[i].reg, &def);
-		if ((def != serdes->serdes_backup_seq->reg_sequence[i].def) || (ret < 0)) {
-			/* if read value != write value then write again */
-			if (num++ < 1)
-				dev_err(dev, "%s read %04x %04x != %04x\n", __func__,
-					serdes->serdes_backup_seq->reg_sequence[i].reg,
-					def, serdes->serdes_backup_seq->reg_sequence[i].def);
-			serdes_reg_write(serdes,
-					 serdes->serdes_backup_seq->reg_sequence[i].reg,
-					 serdes->serdes_backup_seq->reg_sequence[i].def);
-		}
-	}
-
-	return ret;
+	return serdes_i2c_write_seq(serdes, serdes->serdes_backup_seq, false);
 }
 
 static int serdes_i2c_backup_register(struct serdes *serdes)
@@ -219,6 +297,45 @@ static void serdes_reg_check_work_free(struct serdes *serdes)
 	kthread_destroy_worker(serdes->kworker);
 }
 
+static struct workqueue_struct *serdes_bus_get_wq(struct i2c_adapter *adap)
+{
+	struct workqueue_struct *wq = NULL;
+	int i;
+
+	mutex_lock(&serdes_bus_lock);
+	for (i = 0; i < MAX_NUM_SERDES_BUS; i++) {
+		if (serdes_bus[i].wq && serdes_bus[i].nr == adap->nr) {
+			wq = serdes_bus[i].wq;
+			break;
+		}
+		if (!serdes_bus[i].wq) {
+			wq = alloc_ordered_workqueue("serdes-i2c-%d", 0, adap->nr);
+			if (wq) {
+				serdes_bus[i].nr = adap->nr;
+				serdes_bus[i].wq = wq;
+			}
+			break;
+		}
+	}
+	mutex_unlock(&serdes_bus_lock);
+
+	return wq;
+}
+
+static void serdes_async_init_work(struct work_struct *work)
+{
+	struct serdes *serdes = container_of(work, struct serdes, async_init_work);
+
+	if (serdes->early_seq) {
+		if (serdes->chip_data->chip_init)
+			serdes->chip_data->chip_init(serdes);
+		serdes_i2c_set_sequence(serdes);
+	}
+
+	serdes_device_init(serdes);
+	SERDES_DBG_MFD("%s: %s init done\n", __func__, dev_name(serdes->dev));
+}
+
 static void serdes_mfd_work(struct work_struct *work)
 {
 	struct serdes *serdes = container_of(work, struct serdes, mfd_delay_work.work);
@@ -303,6 +420,10 @@ static int serdes_get_init_seq(struct serdes *serdes)
 	/* init ser register(not des register) more early if uboot logo disabled */
 	serdes->route_enable = of_property_read_bool(dev->of_node, "route-enable");
 	if ((!serdes->route_enable) && (serdes->chip_data->serdes_type == TYPE_SER)) {
+		if (serdes->async_wq) {
+			serdes->early_seq = true;
+			return 0;
+		}
 		if (serdes->chip_data->chip_init)
 			serdes->chip_data->chip_init(serdes);
 		ret = serdes_i2c_set_sequence(serdes);
@@ -372,6 +493,13 @@ static int serdes_i2c_probe(struct i2c_client *client,
 		return dev_err_probe(dev, ret,
 				     "failed to register serdes extcon device\n");
 
+	serdes->burst_write = of_property_read_bool(dev->of_node, "serdes-burst-write");
+	if (of_property_read_bool(dev->of_node, "serdes-async-init")) {
+		serdes->async_wq = serdes_bus_get_wq(client->adapter);
+		if (serdes->async_wq)
+			INIT_WORK(&serdes->async_init_work, serdes_async_init_work);
+	}
+
 	ret = serdes_get_init_seq(serdes);
 	if (ret)
 		dev_err(dev, "failed to write serdes register with i2c\n");
@@ -413,7 +541,10 @@ static int serdes_i2c_probe(struct i2c_client *client,
 	}
 
 	serdes->use_delay_work = of_property_read_bool(dev->of_node, "use-delay-work");
-	if (serdes->use_delay_work) {
+	if (serdes->async_wq) {
+		queue_work(serdes->async_wq, &serdes->async_init_work);
+		SERDES_DBG_MFD("%s: async init on %s\n", __func__, client->adapter->name);
+	} else if (serdes->use_delay_work) {
 		serdes->mfd_wq = alloc_ordered_workqueue("%s",
 							 WQ_MEM_RECLAIM | WQ_FREEZABLE,
 							 "serdes-mfd-wq");
@@ -455,6 +586,9 @@ static void serdes_i2c_remove(struct i2c_client *client)
 	if (serdes->use_reg_check_work)
 		serdes_reg_check_work_free(serdes);
 
+	if (serdes->async_wq)
+		cancel_work_sync(&serdes->async_init_work);
+
 	if (serdes->use_delay_work) {
 		cancel_delayed_work_sync(&serdes->mfd_delay_work);
 		destroy_workqueue(serdes->mfd_wq);
@@ -471,7 +605,7 @@ static void serdes_i2c_complete(struct device *dev)
 	struct serdes *serdes = dev_get_drvdata(dev);
 
 	if (serdes->chip_data->serdes_type == TYPE_SER)
-		serdes_i2c_set_sequence(serdes);
+		serdes_i2c_write_seq(serdes, serdes->serdes_init_seq, true);
 
 	SERDES_DBG_MFD("%s: name=%s\n", __func__, dev_name(serdes->dev));
 }
@@ -491,7 +625,7 @@ static int serdes_i2c_resume(struct device *dev)
 	struct serdes *serdes = dev_get_drvdata(dev);
 
 	if (serdes->chip_data->serdes_type == TYPE_OTHER)
-		serdes_i2c_set_sequence(serdes);
+		serdes_i2c_write_seq(serdes, serdes->serdes_init_seq, true);
 
 	serdes_device_resume(serdes);
 	SERDES_DBG_MFD("%s: name=%s\n", __func__, dev_name(serdes->dev));
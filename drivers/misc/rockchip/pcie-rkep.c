@@ -40,7 +40,7 @@
 
 static DEFINE_MUTEX(rkep_mutex);
 #define BAR_0_SZ			SZ_4M
-#define RKEP_NUM_IRQ_VECTORS		4
+#define RKEP_NUM_IRQ_VECTORS		32
 
 #define PCIe_CLIENT_MSI_IRQ_OBJ		0	/* rockchip ep object special irq */
 
@@ -123,12 +123,16 @@ struct pcie_rkep {
 	DECLARE_BITMAP(virtual_id_bitmap, RKEP_EP_VIRTUAL_ID_MAX);
 	DECLARE_BITMAP(virtual_id_irq_bitmap, RKEP_EP_VIRTUAL_ID_MAX);
 	wait_queue_head_t wq_head;
+	DECLARE_BITMAP(queue_bitmap, PCIE_EP_QUEUE_MAX);
+	DECLARE_BITMAP(queue_irq_bitmap, PCIE_EP_QUEUE_MAX);
+	u8 queue_vector[PCIE_EP_QUEUE_MAX];
 };
 
 struct pcie_file {
 	struct mutex file_lock_mutex;
 	struct pcie_rkep *pcie_rkep;
 	DECLARE_BITMAP(child_vid_bitmap, RKEP_EP_VIRTUAL_ID_MAX); /* The virtual IDs applied for each task */
+	DECLARE_BITMAP(child_queue_bitmap, PCIE_EP_QUEUE_MAX); /* The queues owned by each task */
 };
 
 static int rkep_ep_dma_xfer(struct pcie_rkep *pcie_rkep, struct pcie_ep_dma_block_req *dma)
@@ -143,6 +147,86 @@ static int rkep_ep_dma_xfer(struct pcie_rkep *pcie_rkep, struct pcie_ep_dma_bloc
 	return ret;
 }
 
+/*
+ * The ep publishes a linked-list area at the tail of BAR0 once its kernel
+ * driver is up, pick it up on first use rather than at probe time.
+ */
+static int rkep_ep_dma_ll_setup(struct pcie_rkep *pcie_rkep)
+{
+	struct dma_trx_obj *obj = pcie_rkep->dma_obj;
+	u32 off, size;
+
+	if (obj->ll_base)
+		return 0;
+
+	if (pcie_rkep->obj_info->magic != PCIE_EP_OBJ_INFO_MAGIC ||
+	    pcie_rkep->obj_info->version < 2)
+		return -EOPNOTSUPP;
+
+	off = pcie_rkep->obj_info->dma_ll_off;
+	size = pcie_rkep->obj_info->dma_ll_size;
+	if (!size || (u64)off + size > pci_resource_len(pcie_rkep->pdev, 0))
+		return -EOPNOTSUPP;
+
+	obj->ll_phys = pcie_rkep->obj_info->dma_ll_base;
+	obj->ll_size = size;
+	obj->ll_base = pcie_rkep->bar0 + off;
+
+	return 0;
+}
+
+static int rkep_ep_dma_xfer_list(struct pcie_rkep *pcie_rkep, void __user *uarg)
+{
+	struct pcie_ep_dma_list_req req;
+	struct pcie_ep_dma_block *blocks;
+	int ret;
+
+	if (!pcie_rkep->dma_obj)
+		return -EOPNOTSUPP;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.nr_blocks || req.nr_blocks > PCIE_EP_DMA_LIST_MAX)
+		return -EINVAL;
+
+	ret = rkep_ep_dma_ll_setup(pcie_rkep);
+	if (ret)
+		return ret;
+
+	blocks = memdup_user(u64_to_user_ptr(req.blocks),
+			     array_size(req.nr_blocks, sizeof(*blocks)));
+	if (IS_ERR(blocks))
+		return PTR_ERR(blocks);
+
+	ret = pcie_dw_wired_dma_list(pcie_rkep->dma_obj, req.chn, req.wr,
+				     blocks, req.nr_blocks);
+	kfree(blocks);
+
+	return ret;
+}
+
+static int rkep_ep_dma_xfer_dmabuf(struct pcie_rkep *pcie_rkep, void __user *uarg)
+{
+	struct pcie_ep_dma_dmabuf_req req;
+	int ret;
+
+	if (!pcie_rkep->dma_obj)
+		return -EOPNOTSUPP;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	ret = rkep_ep_dma_ll_setup(pcie_rkep);
+	if (ret)
+		return ret;
+
+	/* The host side of the transfer is the dma-buf, mapped for this device */
+	return pcie_dw_dma_dmabuf(pcie_rkep->dma_obj, &pcie_rkep->pdev->dev,
+				  req.chn, req.wr, true, req.fd, req.offset,
+				  req.size, req.bus_paddr);
+}
+
 static int rkep_ep_request_virtual_id(struct pcie_file *pcie_file)
 {
 	struct pcie_rkep *pcie_rkep = pcie_file->pcie_rkep;
@@ -274,6 +358,142 @@ static int rkep_ep_poll_irq_user(struct pcie_file *pcie_file, struct pcie_ep_obj
 	return 0;
 }
 
+static void __iomem *rkep_ep_queue_ring(struct pcie_rkep *pcie_rkep, u32 qid)
+{
+	return pcie_rkep->bar0 + pcie_rkep->obj_info->queue_off +
+	       qid * pcie_rkep->obj_info->queue_stride;
+}
+
+static int rkep_ep_queue_request(struct pcie_file *pcie_file)
+{
+	struct pcie_rkep *pcie_rkep = pcie_file->pcie_rkep;
+	void __iomem *ring;
+	u32 num;
+	int qid;
+
+	if (pcie_rkep->obj_info->version < 3 || !pcie_rkep->obj_info->queue_num)
+		return -EOPNOTSUPP;
+
+	num = min_t(u32, pcie_rkep->obj_info->queue_num, PCIE_EP_QUEUE_MAX);
+
+	mutex_lock(&pcie_rkep->dev_lock_mutex);
+	qid = find_first_zero_bit(pcie_rkep->queue_bitmap, num);
+	if (qid >= num) {
+		mutex_unlock(&pcie_rkep->dev_lock_mutex);
+		return -EBUSY;
+	}
+	set_bit(qid, pcie_rkep->queue_bitmap);
+	mutex_unlock(&pcie_rkep->dev_lock_mutex);
+
+	/* Vector 0 belongs to the obj irq, spread the queues over the rest */
+	if (pcie_rkep->irq_valid > 1)
+		pcie_rkep->queue_vector[qid] = 1 + qid % (pcie_rkep->irq_valid - 1);
+	else
+		pcie_rkep->queue_vector[qid] = 0;
+	clear_bit(qid, pcie_rkep->queue_irq_bitmap);
+
+	ring = rkep_ep_queue_ring(pcie_rkep, qid);
+	memset_io(ring, 0, offsetof(struct pcie_ep_queue_ring, sq));
+	writel(pcie_rkep->queue_vector[qid], ring + offsetof(struct pcie_ep_queue_ring, msi_vector));
+	writel(PCIE_EP_QUEUE_STATE_READY, ring + offsetof(struct pcie_ep_queue_ring, state));
+
+	mutex_lock(&pcie_file->file_lock_mutex);
+	set_bit(qid, pcie_file->child_queue_bitmap);
+	mutex_unlock(&pcie_file->file_lock_mutex);
+
+	dev_dbg(&pcie_rkep->pdev->dev, "request queue %d, vector %d\n", qid,
+		pcie_rkep->queue_vector[qid]);
+
+	return qid;
+}
+
+static void rkep_ep_queue_free(struct pcie_rkep *pcie_rkep, u32 qid)
+{
+	writel(PCIE_EP_QUEUE_STATE_FREE,
+	       rkep_ep_queue_ring(pcie_rkep, qid) + offsetof(struct pcie_ep_queue_ring, state));
+
+	mutex_lock(&pcie_rkep->dev_lock_mutex);
+	clear_bit(qid, pcie_rkep->queue_bitmap);
+	mutex_unlock(&pcie_rkep->dev_lock_mutex);
+
+	dev_dbg(&pcie_rkep->pdev->dev, "release queue %d\n", qid);
+}
+
+static int rkep_ep_queue_release(struct pcie_file *pcie_file, u32 qid)
+{
+	if (qid >= PCIE_EP_QUEUE_MAX)
+		return -EINVAL;
+
+	mutex_lock(&pcie_file->file_lock_mutex);
+	if (!test_and_clear_bit(qid, pcie_file->child_queue_bitmap)) {
+		mutex_unlock(&pcie_file->file_lock_mutex);
+		return -EINVAL;
+	}
+	mutex_unlock(&pcie_file->file_lock_mutex);
+
+	rkep_ep_queue_free(pcie_file->pcie_rkep, qid);
+
+	return 0;
+}
+
+/*
+ * Unlike rkep_ep_raise_elbi_irq() there is neither dev_lock_mutex nor a
+ * wait for the previous interrupt to be cleared: the ELBI write mask only
+ * touches this queue's bit, and a doorbell which coalesces with one still
+ * pending loses nothing since the ep works from the ring indices.
+ */
+static int rkep_ep_queue_doorbell(struct pcie_file *pcie_file, u32 qid)
+{
+	struct pcie_rkep *pcie_rkep = pcie_file->pcie_rkep;
+	u32 num = PCIE_EP_QUEUE_ELBI_BASE + qid;
+
+	if (qid >= PCIE_EP_QUEUE_MAX || !test_bit(qid, pcie_file->child_queue_bitmap))
+		return -EINVAL;
+
+	return pci_write_config_dword(pcie_rkep->pdev, PCIE_CFG_ELBI_APP_OFFSET + 4 * (num / 16),
+				      BIT(num % 16 + 16) | BIT(num % 16));
+}
+
+static int rkep_ep_queue_wait(struct pcie_file *pcie_file, struct pcie_ep_queue_wait *wait)
+{
+	struct pcie_rkep *pcie_rkep = pcie_file->pcie_rkep;
+	u32 qid = wait->qid;
+	long ret;
+
+	if (qid >= PCIE_EP_QUEUE_MAX || !test_bit(qid, pcie_file->child_queue_bitmap))
+		return -EINVAL;
+
+	if (wait->timeout_ms)
+		ret = wait_event_interruptible_timeout(pcie_rkep->wq_head,
+						       test_bit(qid, pcie_rkep->queue_irq_bitmap),
+						       msecs_to_jiffies(wait->timeout_ms));
+	else
+		ret = wait_event_interruptible(pcie_rkep->wq_head,
+					       test_bit(qid, pcie_rkep->queue_irq_bitmap));
+	if (ret < 0)
+		return ret;
+
+	wait->pending = test_and_clear_bit(qid, pcie_rkep->queue_irq_bitmap);
+
+	return 0;
+}
+
+static void pcie_rkep_queue_handler(struct pcie_rkep *pcie_rkep, u16 vector)
+{
+	bool wake = false;
+	int qid;
+
+	for_each_set_bit(qid, pcie_rkep->queue_bitmap, PCIE_EP_QUEUE_MAX) {
+		if (pcie_rkep->queue_vector[qid] == vector) {
+			set_bit(qid, pcie_rkep->queue_irq_bitmap);
+			wake = true;
+		}
+	}
+
+	if (wake)
+		wake_up_interruptible(&pcie_rkep->wq_head);
+}
+
 static int pcie_rkep_open(struct inode *inode, struct file *file)
 {
 	struct miscdevice *miscdev = file->private_data;
@@ -315,6 +535,10 @@ static int pcie_rkep_release(struct inode *inode, struct file *file)
 
 		dev_dbg(&pcie_rkep->pdev->dev, "release virtual id %d\n", index);
 	}
+	mutex_unlock(&pcie_file->file_lock_mutex);
+
+	for_each_set_bit(index, pcie_file->child_queue_bitmap, PCIE_EP_QUEUE_MAX)
+		rkep_ep_queue_free(pcie_rkep, index);
 
 	devm_kfree(&pcie_rkep->pdev->dev, pcie_file);
 
@@ -571,6 +795,7 @@ static long pcie_rkep_ioctl(struct file *file, unsigned int cmd, unsigned long a
 	struct pcie_ep_dma_block_req dma;
 	void __user *uarg = (void __user *)args;
 	struct pcie_ep_obj_poll_virtual_id_cfg poll_cfg;
+	struct pcie_ep_queue_wait wait;
 	int mmap_res;
 	int ret;
 	int index;
@@ -621,6 +846,20 @@ static long pcie_rkep_ioctl(struct file *file, unsigned int cmd, unsigned long a
 			return -EFAULT;
 		}
 		break;
+	case PCIE_EP_DMA_XFER_LIST:
+		ret = rkep_ep_dma_xfer_list(pcie_rkep, uarg);
+		if (ret) {
+			dev_err(&pcie_rkep->pdev->dev, "failed to transfer dma list, ret=%d\n", ret);
+			return ret;
+		}
+		break;
+	case PCIE_EP_DMA_XFER_DMABUF:
+		ret = rkep_ep_dma_xfer_dmabuf(pcie_rkep, uarg);
+		if (ret) {
+			dev_err(&pcie_rkep->pdev->dev, "failed to transfer dma-buf, ret=%d\n", ret);
+			return ret;
+		}
+		break;
 	case PCIE_EP_REQUEST_VIRTUAL_ID:
 		index = rkep_ep_request_virtual_id(pcie_file);
 		if (index < 0) {
@@ -675,6 +914,36 @@ static long pcie_rkep_ioctl(struct file *file, unsigned int cmd, unsigned long a
 		if (copy_to_user(argp, &poll_cfg, sizeof(poll_cfg)))
 			return -EFAULT;
 		break;
+	case PCIE_EP_QUEUE_REQUEST:
+		index = rkep_ep_queue_request(pcie_file);
+		if (index < 0)
+			return index;
+		if (copy_to_user(argp, &index, sizeof(index)))
+			return -EFAULT;
+		break;
+	case PCIE_EP_QUEUE_RELEASE:
+		if (copy_from_user(&index, uarg, sizeof(index)))
+			return -EFAULT;
+		ret = rkep_ep_queue_release(pcie_file, index);
+		if (ret)
+			return ret;
+		break;
+	case PCIE_EP_QUEUE_DOORBELL:
+		if (copy_from_user(&index, uarg, sizeof(index)))
+			return -EFAULT;
+		ret = rkep_ep_queue_doorbell(pcie_file, index);
+		if (ret)
+			return ret;
+		break;
+	case PCIE_EP_QUEUE_WAIT:
+		if (copy_from_user(&wait, uarg, sizeof(wait)))
+			return -EFAULT;
+		ret = rkep_ep_queue_wait(pcie_file, &wait);
+		if (ret)
+			return ret;
+		if (copy_to_user(argp, &wait, sizeof(wait)))
+			return -EFAULT;
+		break;
 	case PCIE_EP_RAISE_ELBI:
 		ret = copy_from_user(&index, uarg, sizeof(index));
 		if (ret) {
@@ -1061,6 +1330,8 @@ static irqreturn_t pcie_rkep_pcie_interrupt(int irq, void *context)
 	if (irq == pci_irq_vector(pcie_rkep->pdev, PCIe_CLIENT_MSI_IRQ_OBJ))
 		pcie_rkep_obj_handler(pcie_rkep, pdev);
 
+	pcie_rkep_queue_handler(pcie_rkep, ctx->msg_id);
+
 	return IRQ_HANDLED;
 }
 
@@ -40,6 +40,12 @@ struct dw_mci_rockchip_priv_data {
 	int			usrid;
 	int			last_degree;
 	u32			f_min;
+	/* sample phase found by the last tuning, reused after system resume */
+	int			tuned_phase;
+	unsigned char		tuned_timing;
+	unsigned int		tuned_clock;
+	bool			tuned_valid;
+	bool			resumed;
 };
 
 /*
@@ -273,6 +279,53 @@ static void dw_mci_rk3288_set_ios(struct dw_mci *host, struct mmc_ios *ios)
 #define TUNING_ITERATION_TO_PHASE(i, num_phases) \
 		(DIV_ROUND_UP((i) * 360, num_phases))
 
+static void dw_mci_rk3288_set_sample_phase(struct dw_mci *host, int degree)
+{
+	struct dw_mci_rockchip_priv_data *priv = host->priv;
+
+	if (priv->usrid == USRID_INTER_PHASE)
+		rockchip_mmc_set_phase(host, true, degree);
+	else
+		clk_set_phase(priv->sample_clk, degree);
+}
+
+static void dw_mci_rk3288_save_tuning(struct dw_mci_slot *slot, int degree)
+{
+	struct dw_mci_rockchip_priv_data *priv = slot->host->priv;
+
+	priv->tuned_phase = degree;
+	priv->tuned_timing = slot->mmc->ios.timing;
+	priv->tuned_clock = slot->mmc->ios.clock;
+	priv->tuned_valid = true;
+}
+
+/*
+ * The card is re-initialised on system resume and asks for tuning again at
+ * the same timing and clock. Try the phase that worked before suspend with
+ * a single tuning block first, and only sweep when it no longer passes.
+ */
+static bool dw_mci_rk3288_reuse_tuning(struct dw_mci_slot *slot, u32 opcode)
+{
+	struct dw_mci *host = slot->host;
+	struct dw_mci_rockchip_priv_data *priv = host->priv;
+	struct mmc_host *mmc = slot->mmc;
+
+	if (!priv->resumed)
+		return false;
+	priv->resumed = false;
+
+	if (!priv->tuned_valid || priv->tuned_timing != mmc->ios.timing ||
+	    priv->tuned_clock != mmc->ios.clock)
+		return false;
+
+	dw_mci_rk3288_set_sample_phase(host, priv->tuned_phase);
+	if (mmc_send_tuning(mmc, opcode, NULL))
+		return false;
+
+	dev_dbg(host->dev, "Reused tuned phase %d\n", priv->tuned_phase);
+	return true;
+}
+
 static int dw_mci_v2_execute_tuning(struct dw_mci_slot *slot, u32 opcode)
 {
 	struct dw_mci *host = slot->host;
@@ -345,9 +398,14 @@ static int dw_mci_rk3288_execute_tuning(struct dw_mci_slot *slot, u32 opcode)
 		return -EIO;
 	}
 
+	if (dw_mci_rk3288_reuse_tuning(slot, opcode))
+		return 0;
+
 	if (priv->use_v2_tuning) {
-		if (!dw_mci_v2_execute_tuning(slot, opcode))
+		if (!dw_mci_v2_execute_tuning(slot, opcode)) {
+			dw_mci_rk3288_save_tuning(slot, priv->last_degree);
 			return 0;
+		}
 		/* Otherwise we continue using fine tuning */
 	}
 
@@ -418,6 +476,7 @@ static int dw_mci_rk3288_execute_tuning(struct dw_mci_slot *slot, u32 opcode)
 			clk_set_phase(priv->sample_clk, priv->default_sample_phase);
 		dev_info(host->dev, "All phases work, using default phase %d.",
 			 priv->default_sample_phase);
+		dw_mci_rk3288_save_tuning(slot, priv->default_sample_phase);
 		goto free;
 	}
 
@@ -475,10 +534,8 @@ static int dw_mci_rk3288_execute_tuning(struct dw_mci_slot *slot, u32 opcode)
 	dev_info(host->dev, "Successfully tuned phase to %d\n",
 		 real_middle_phase);
 
-	if (priv->usrid == USRID_INTER_PHASE)
-		rockchip_mmc_set_phase(host, true, real_middle_phase);
-	else
-		clk_set_phase(priv->sample_clk, real_middle_phase);
+	dw_mci_rk3288_set_sample_phase(host, real_middle_phase);
+	dw_mci_rk3288_save_tuning(slot, real_middle_phase);
 
 free:
 	kfree(ranges);
@@ -659,9 +716,20 @@ static int dw_mci_rockchip_remove(struct platform_device *pdev)
 	return 0;
 }
 
+static int __maybe_unused dw_mci_rockchip_resume(struct device *dev)
+{
+	struct dw_mci *host = dev_get_drvdata(dev);
+	struct dw_mci_rockchip_priv_data *priv = host->priv;
+
+	if (priv)
+		priv->resumed = true;
+
+	return pm_runtime_force_resume(dev);
+}
+
 static const struct dev_pm_ops dw_mci_rockchip_dev_pm_ops = {
 	SET_SYSTEM_SLEEP_PM_OPS(pm_runtime_force_suspend,
-				pm_runtime_force_resume)
+				dw_mci_rockchip_resume)
 	SET_RUNTIME_PM_OPS(dw_mci_runtime_suspend,
 			   dw_mci_runtime_resume,
 			   NULL)
@@ -31,6 +31,7 @@
 #include "rk_sdmmc_ops.h"
 
 #define BLKSZ		512
+#define RK_EMMC_BUSY_TIMEOUT_MS	(10 * 1000)
 
 enum emmc_area_type {
 	MMC_DATA_AREA_MAIN,
@@ -92,42 +93,14 @@ static void rk_emmc_prepare_mrq(struct mmc_request *mrq, struct scatterlist *sg,
 	mmc_set_data_timeout(mrq->data, this_card);
 }
 
-static int rk_emmc_busy(struct mmc_command *cmd)
-{
-	return !(cmd->resp[0] & R1_READY_FOR_DATA) ||
-		(R1_CURRENT_STATE(cmd->resp[0]) == 7);
-}
-
 /*
- * Wait for the card to finish the busy state
+ * Wait for the card to finish the busy state. Poll CMD13 with the core's
+ * backoff, which sleeps between polls instead of spinning on the bus.
  */
 static int rk_emmc_wait_busy(void)
 {
-	int ret, busy;
-	struct mmc_command cmd = {0};
-
-	busy = 0;
-	do {
-		memset(&cmd, 0, sizeof(struct mmc_command));
-
-		cmd.opcode = MMC_SEND_STATUS;
-		cmd.arg = this_card->rca << 16;
-		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-
-		ret = mmc_wait_for_cmd(this_card->host, &cmd, 0);
-		if (ret)
-			break;
-
-		if (!busy && rk_emmc_busy(&cmd)) {
-			busy = 1;
-			if (this_card->host->caps & MMC_CAP_WAIT_WHILE_BUSY)
-				pr_info("%s: Warning: Host did not "
-					"wait for busy state to end.\n",
-					mmc_hostname(this_card->host));
-		}
-	} while (rk_emmc_busy(&cmd));
-
-	return ret;
+	return mmc_poll_for_busy(this_card, RK_EMMC_BUSY_TIMEOUT_MS, false,
+				 MMC_BUSY_IO);
 }
 
 /*
@@ -82,6 +82,8 @@
 #define NFC_MAX_NSELS			(8) /* Some Socs only have 1 or 2 CSs. */
 #define NFC_SYS_DATA_SIZE		(4) /* 4 bytes sys data in oob pre 1024 data.*/
 #define RK_DEFAULT_CLOCK_RATE		(150 * 1000 * 1000) /* 150 Mhz */
+#define NFC_CMD_READCACHESEQ		0x31
+#define NFC_CMD_READCACHEEND		0x3f
 #define ACCTIMING(csrw, rwpw, rwcs)	((csrw) << 12 | (rwpw) << 5 | (rwcs))
 
 enum nfc_type {
@@ -157,6 +159,7 @@ struct rk_nfc_nand_chip {
 	u16 metadata_size;
 	u32 boot_ecc;
 	u32 timing;
+	bool cache_read;
 
 	u8 nsels;
 	u8 sels[];
@@ -186,6 +189,15 @@ struct rk_nfc {
 	u32 oob_buf_size;
 
 	unsigned long assigned_cs;
+
+	/*
+	 * Sequential cache read in progress: cache_page of cache_chip/cache_cs
+	 * is being loaded into the data register while the previous page is
+	 * transferred out of the cache register.
+	 */
+	struct nand_chip *cache_chip;
+	int cache_cs;
+	int cache_page;
 };
 
 static inline struct rk_nfc_nand_chip *rk_nfc_to_rknand(struct nand_chip *chip)
@@ -312,6 +324,24 @@ static inline int rk_nfc_wait_ioready(struct rk_nfc *nfc)
 	return rc;
 }
 
+/*
+ * End a sequential cache read. The page being loaded is moved to the cache
+ * register and dropped; the target is ready for any command afterwards.
+ */
+static void rk_nfc_cache_read_stop(struct rk_nfc *nfc)
+{
+	struct nand_chip *chip = nfc->cache_chip;
+
+	if (!chip)
+		return;
+
+	nfc->cache_chip = NULL;
+	rk_nfc_select_chip(chip, nfc->cache_cs);
+	writeb(NFC_CMD_READCACHEEND, nfc->regs + nfc->band_offset + BANK_CMD);
+	if (rk_nfc_wait_ioready(nfc) < 0)
+		dev_err(nfc->dev, "cache read end timeout\n");
+}
+
 static void rk_nfc_read_buf(struct rk_nfc *nfc, u8 *buf, int len)
 {
 	int i;
@@ -405,8 +435,12 @@ static int rk_nfc_exec_op(struct nand_chip *chip,
 			  const struct nand_operation *op,
 			  bool check_only)
 {
-	if (!check_only)
+	struct rk_nfc *nfc = nand_get_controller_data(chip);
+
+	if (!check_only) {
+		rk_nfc_cache_read_stop(nfc);
 		rk_nfc_select_chip(chip, op->cs);
+	}
 
 	return nand_op_parser_exec_op(chip, &rk_nfc_op_parser, op,
 				      check_only);
@@ -752,6 +786,47 @@ static int rk_nfc_read_page_raw(struct nand_chip *chip, u8 *buf, int oob_on,
 	return 0;
 }
 
+/*
+ * Bring @page into the cache register. With cache read enabled, sequential
+ * pages of a block are read with READ CACHE SEQUENTIAL so the array loads
+ * the next page (tR) while this one is transferred by DMA, and the block's
+ * last page ends the sequence with READ CACHE END.
+ */
+static int rk_nfc_read_page_start(struct nand_chip *chip, int page)
+{
+	struct rk_nfc *nfc = nand_get_controller_data(chip);
+	struct rk_nfc_nand_chip *rknand = rk_nfc_to_rknand(chip);
+	struct mtd_info *mtd = nand_to_mtd(chip);
+	int pages_per_blk = mtd->erasesize / mtd->writesize;
+	bool last = (page + 1) % pages_per_blk == 0;
+	u8 cmd;
+
+	if (nfc->cache_chip == chip && nfc->cache_cs == chip->cur_cs &&
+	    nfc->cache_page == page) {
+		cmd = last ? NFC_CMD_READCACHEEND : NFC_CMD_READCACHESEQ;
+	} else {
+		nand_read_page_op(chip, page, 0, NULL, 0);
+		if (!rknand->cache_read || last)
+			return 0;
+		cmd = NFC_CMD_READCACHESEQ;
+	}
+
+	nfc->cache_chip = NULL;
+	writeb(cmd, nfc->regs + nfc->band_offset + BANK_CMD);
+	if (rk_nfc_wait_ioready(nfc) < 0) {
+		dev_err(nfc->dev, "cache read page %x timeout\n", page);
+		return -ETIMEDOUT;
+	}
+
+	if (cmd == NFC_CMD_READCACHESEQ) {
+		nfc->cache_chip = chip;
+		nfc->cache_cs = chip->cur_cs;
+		nfc->cache_page = page + 1;
+	}
+
+	return 0;
+}
+
 static int rk_nfc_read_page_hwecc(struct nand_chip *chip, u8 *buf, int oob_on,
 				  int page)
 {
@@ -768,7 +843,9 @@ static int rk_nfc_read_page_hwecc(struct nand_chip *chip, u8 *buf, int oob_on,
 	u8 *oob;
 	u32 tmp;
 
-	nand_read_page_op(chip, page, 0, NULL, 0);
+	ret = rk_nfc_read_page_start(chip, page);
+	if (ret)
+		return ret;
 
 	dma_data = dma_map_single(nfc->dev, nfc->page_buf,
 				  mtd->writesize,
@@ -1183,6 +1260,8 @@ static int rk_nfc_nand_chip_init(struct device *dev, struct rk_nfc *nfc,
 		rknand->boot_ecc = ret ? chip->ecc.strength : tmp;
 	}
 
+	rknand->cache_read = of_property_read_bool(np, "rockchip,cache-read");
+
 	ret = mtd_device_register(mtd, NULL, 0);
 	if (ret) {
 		dev_err(dev, "MTD parse partition error\n");
@@ -1448,6 +1527,7 @@ static int __maybe_unused rk_nfc_suspend(struct device *dev)
 {
 	struct rk_nfc *nfc = dev_get_drvdata(dev);
 
+	rk_nfc_cache_read_stop(nfc);
 	rk_nfc_disable_clks(nfc);
 
 	return 0;
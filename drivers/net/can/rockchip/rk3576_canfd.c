@@ -26,6 +26,8 @@
 #include <linux/can/error.h>
 #include <linux/reset.h>
 #include <linux/pm_runtime.h>
+#include <linux/rtnetlink.h>
+#include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
 
@@ -326,6 +328,7 @@ enum rk3576_canfd_reg {
 #define EXT_MEM_SIZE		0x2000 /* 8KByte */
 
 #define CANFD_FILTER_MASK	0x1fffffff
+#define CANFD_FILTER_NUM	5
 
 #define CANFD_FIFO_CNT_MASK	0xff
 
@@ -368,6 +371,18 @@ struct rk3576_canfd {
 	u32 *rxbuf;
 	dma_addr_t rx_dma_src_addr;
 	dma_addr_t rx_dma_dst_addr;
+	/* hardware acceptance filter, accept all while rx_filter_cnt is 0 */
+	struct can_filter rx_filter[CANFD_FILTER_NUM];
+	int rx_filter_cnt;
+	bool rx_filter_merged;
+};
+
+static const enum rk3576_canfd_reg rk3576_canfd_atf[CANFD_FILTER_NUM] = {
+	CANFD_ATF0, CANFD_ATF1, CANFD_ATF2, CANFD_ATF3, CANFD_ATF4,
+};
+
+static const enum rk3576_canfd_reg rk3576_canfd_atfm[CANFD_FILTER_NUM] = {
+	CANFD_ATFM0, CANFD_ATFM1, CANFD_ATFM2, CANFD_ATFM3, CANFD_ATFM4,
 };
 
 static inline u32 rk3576_canfd_read(const struct rk3576_canfd *priv,
@@ -576,6 +591,42 @@ static int rk3576_canfd_atf_config(const struct net_device *ndev, int mode)
 	return 0;
 }
 
+/* Widen @f so it also accepts everything @add accepts. Used when more
+ * filters are configured than there are banks: the hardware then lets a
+ * superset through and the socket CAN_RAW_FILTERs drop the rest.
+ */
+static void rk3576_canfd_filter_merge(struct can_filter *f,
+				      const struct can_filter *add)
+{
+	f->can_mask &= add->can_mask & ~(f->can_id ^ add->can_id);
+	f->can_id &= f->can_mask;
+}
+
+static void rk3576_canfd_set_filter(const struct net_device *ndev)
+{
+	struct rk3576_canfd *rcan = netdev_priv(ndev);
+	u32 dis = 0;
+	int i;
+
+	if (!rcan->rx_filter_cnt) {
+		rk3576_canfd_atf_config(ndev, CANFD_ATF_MASK_MODE);
+		return;
+	}
+
+	/* mask mode, a set ATFM bit is don't care */
+	for (i = 0; i < CANFD_FILTER_NUM; i++) {
+		if (i >= rcan->rx_filter_cnt) {
+			dis |= ATF_DIS(i);
+			continue;
+		}
+		rk3576_canfd_write(rcan, rk3576_canfd_atf[i],
+				   rcan->rx_filter[i].can_id);
+		rk3576_canfd_write(rcan, rk3576_canfd_atfm[i],
+				   ~rcan->rx_filter[i].can_mask & CANFD_FILTER_MASK);
+	}
+	rk3576_canfd_write(rcan, CANFD_ATF_CTL, dis);
+}
+
 static int rk3576_canfd_start(struct net_device *ndev)
 {
 	struct rk3576_canfd *rcan = netdev_priv(ndev);
@@ -585,7 +636,7 @@ static int rk3576_canfd_start(struct net_device *ndev)
 	set_reset_mode(ndev);
 
 	rk3576_canfd_write(rcan, CANFD_INT_MASK, INT_ENABLE);
-	rk3576_canfd_atf_config(ndev, CANFD_ATF_MASK_MODE);
+	rk3576_canfd_set_filter(ndev);
 
 	/* set mode */
 	val = rk3576_canfd_read(rcan, CANFD_MODE);
@@ -1056,6 +1107,91 @@ static const struct net_device_ops rk3576_canfd_netdev_ops = {
 	.ndo_change_mtu = can_change_mtu,
 };
 
+/* rx_filter: "<id>:<mask>" hex pairs in CAN_RAW_FILTER semantics, e.g. the
+ * union of the filters of the sockets bound to this interface. Entries
+ * beyond the hardware banks are merged into the last one, the socket
+ * filters keep doing the exact match. Empty clears back to accept all.
+ * Takes effect on the next ifup.
+ */
+static ssize_t rx_filter_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct rk3576_canfd *rcan = netdev_priv(to_net_dev(dev));
+	int i, len = 0;
+
+	if (!rcan->rx_filter_cnt)
+		return sysfs_emit(buf, "all\n");
+
+	for (i = 0; i < rcan->rx_filter_cnt; i++)
+		len += sysfs_emit_at(buf, len, "%08x:%08x%s\n",
+				     rcan->rx_filter[i].can_id,
+				     rcan->rx_filter[i].can_mask,
+				     rcan->rx_filter_merged &&
+				     i == rcan->rx_filter_cnt - 1 ? " merged" : "");
+
+	return len;
+}
+
+static ssize_t rx_filter_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct net_device *ndev = to_net_dev(dev);
+	struct rk3576_canfd *rcan = netdev_priv(ndev);
+	struct can_filter filter[CANFD_FILTER_NUM], add;
+	bool merged = false;
+	char *str, *p, *tok;
+	ssize_t ret = count;
+	int cnt = 0;
+
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+
+	p = str;
+	while ((tok = strsep(&p, " ,\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (sscanf(tok, "%x:%x", &add.can_id, &add.can_mask) != 2) {
+			ret = -EINVAL;
+			goto out;
+		}
+		add.can_mask &= CAN_EFF_MASK;
+		add.can_id &= add.can_mask;
+		if (cnt < CANFD_FILTER_NUM) {
+			filter[cnt++] = add;
+		} else {
+			rk3576_canfd_filter_merge(&filter[cnt - 1], &add);
+			merged = true;
+		}
+	}
+
+	rtnl_lock();
+	if (ndev->flags & IFF_UP) {
+		ret = -EBUSY;
+	} else {
+		memcpy(rcan->rx_filter, filter, sizeof(filter[0]) * cnt);
+		rcan->rx_filter_cnt = cnt;
+		rcan->rx_filter_merged = merged;
+	}
+	rtnl_unlock();
+out:
+	kfree(str);
+
+	return ret;
+}
+
+static DEVICE_ATTR_RW(rx_filter);
+
+static struct attribute *rk3576_canfd_attrs[] = {
+	&dev_attr_rx_filter.attr,
+	NULL,
+};
+
+static const struct attribute_group rk3576_canfd_attr_group = {
+	.attrs = rk3576_canfd_attrs,
+};
+
 /**
  * rk3576_canfd_suspend - Suspend method for the driver
  * @dev:	Address of the device structure
@@ -1273,6 +1409,7 @@ static int rk3576_canfd_probe(struct platform_device *pdev)
 		rk3576_canfd_dma_init(rcan);
 
 	ndev->netdev_ops = &rk3576_canfd_netdev_ops;
+	ndev->sysfs_groups[0] = &rk3576_canfd_attr_group;
 	ndev->irq = irq;
 	ndev->flags |= IFF_ECHO;
 
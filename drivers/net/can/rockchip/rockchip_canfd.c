@@ -9,6 +9,8 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/clk.h>
 #include <linux/errno.h>
+#include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
@@ -26,6 +28,8 @@
 #include <linux/can/error.h>
 #include <linux/reset.h>
 #include <linux/pm_runtime.h>
+#include <linux/rtnetlink.h>
+#include <linux/slab.h>
 #include <linux/rockchip/cpu.h>
 
 /* registers definition */
@@ -213,11 +217,15 @@ enum {
 #define CAN_RXFRD_OFFSET(n)	(CAN_RXFRD + CAN_RF_SIZE * (n))
 
 #define CAN_RX_FILTER_MASK	0x1fffffff
+#define CAN_RX_FILTER_NUM	5
 #define NOACK_ERR_FLAG		0xc200800
 #define CAN_BUSOFF_FLAG		0x20
 
 #define DRV_NAME	"rockchip_canfd"
 
+#define ROCKCHIP_CANFD_RX_INT		(RX_FINISH_INT | RX_FIFO_FULL_INT)
+#define ROCKCHIP_CANFD_MAX_COALESCE_US	10000
+
 /* rockchip_canfd private data structure */
 
 struct rockchip_canfd {
@@ -236,6 +244,23 @@ struct rockchip_canfd {
 	u32 tx_invalid[4];
 	struct delayed_work tx_err_work;
 	u32 delay_time_ms;
+	/* RX is drained from NAPI instead of the interrupt handler */
+	bool rx_napi;
+	bool rx_irq_pending;
+	struct hrtimer rx_irq_timer;
+	u32 rx_coalesce_usecs_irq;
+	/* hardware acceptance filter, accept all while rx_filter_cnt is 0 */
+	struct can_filter rx_filter[CAN_RX_FILTER_NUM];
+	int rx_filter_cnt;
+	bool rx_filter_merged;
+};
+
+static const enum rockchip_canfd_reg rockchip_canfd_idcode[CAN_RX_FILTER_NUM] = {
+	CAN_IDCODE0, CAN_IDCODE1, CAN_IDCODE2, CAN_IDCODE3, CAN_IDCODE4,
+};
+
+static const enum rockchip_canfd_reg rockchip_canfd_idmask[CAN_RX_FILTER_NUM] = {
+	CAN_IDMASK0, CAN_IDMASK1, CAN_IDMASK2, CAN_IDMASK3, CAN_IDMASK4,
 };
 
 static inline u32 rockchip_canfd_read(const struct rockchip_canfd *priv,
@@ -398,6 +423,42 @@ static int rockchip_canfd_get_berr_counter(const struct net_device *ndev,
 	return 0;
 }
 
+/* Widen @f so it also accepts everything @add accepts. Used when more
+ * filters are configured than there are banks: the hardware then lets a
+ * superset through and the socket CAN_RAW_FILTERs drop the rest.
+ */
+static void rockchip_canfd_filter_merge(struct can_filter *f,
+					const struct can_filter *add)
+{
+	f->can_mask &= add->can_mask & ~(f->can_id ^ add->can_id);
+	f->can_id &= f->can_mask;
+}
+
+static void rockchip_canfd_set_filter(struct rockchip_canfd *rcan)
+{
+	struct can_filter all = { .can_id = 0, .can_mask = 0 };
+	const struct can_filter *f;
+	int i;
+
+	if (rcan->rx_filter_cnt)
+		all = rcan->rx_filter[0];
+	for (i = 1; i < rcan->rx_filter_cnt; i++)
+		rockchip_canfd_filter_merge(&all, &rcan->rx_filter[i]);
+
+	/* a set IDMASK bit is don't care */
+	rockchip_canfd_write(rcan, CAN_IDCODE, all.can_id);
+	rockchip_canfd_write(rcan, CAN_IDMASK, ~all.can_mask & CAN_RX_FILTER_MASK);
+
+	/* unused banks repeat the last entry, so they widen nothing */
+	for (i = 0; i < CAN_RX_FILTER_NUM; i++) {
+		f = rcan->rx_filter_cnt ?
+		    &rcan->rx_filter[min(i, rcan->rx_filter_cnt - 1)] : &all;
+		rockchip_canfd_write(rcan, rockchip_canfd_idcode[i], f->can_id);
+		rockchip_canfd_write(rcan, rockchip_canfd_idmask[i],
+				     ~f->can_mask & CAN_RX_FILTER_MASK);
+	}
+}
+
 static int rockchip_canfd_start(struct net_device *ndev)
 {
 	struct rockchip_canfd *rcan = netdev_priv(ndev);
@@ -408,19 +469,7 @@ static int rockchip_canfd_start(struct net_device *ndev)
 
 	rockchip_canfd_write(rcan, CAN_INT_MASK, 0);
 
-	/* RECEIVING FILTER, accept all */
-	rockchip_canfd_write(rcan, CAN_IDCODE, 0);
-	rockchip_canfd_write(rcan, CAN_IDMASK, CAN_RX_FILTER_MASK);
-	rockchip_canfd_write(rcan, CAN_IDCODE0, 0);
-	rockchip_canfd_write(rcan, CAN_IDMASK0, CAN_RX_FILTER_MASK);
-	rockchip_canfd_write(rcan, CAN_IDCODE1, 0);
-	rockchip_canfd_write(rcan, CAN_IDMASK1, CAN_RX_FILTER_MASK);
-	rockchip_canfd_write(rcan, CAN_IDCODE2, 0);
-	rockchip_canfd_write(rcan, CAN_IDMASK2, CAN_RX_FILTER_MASK);
-	rockchip_canfd_write(rcan, CAN_IDCODE3, 0);
-	rockchip_canfd_write(rcan, CAN_IDMASK3, CAN_RX_FILTER_MASK);
-	rockchip_canfd_write(rcan, CAN_IDCODE4, 0);
-	rockchip_canfd_write(rcan, CAN_IDMASK4, CAN_RX_FILTER_MASK);
+	rockchip_canfd_set_filter(rcan);
 
 	/* set mode */
 	val = rockchip_canfd_read(rcan, CAN_MODE);
@@ -692,7 +741,10 @@ static int rockchip_canfd_rx(struct net_device *ndev)
 
 	stats->rx_packets++;
 	stats->rx_bytes += cf->len;
-	netif_rx(skb);
+	if (rcan->rx_napi)
+		netif_receive_skb(skb);
+	else
+		netif_rx(skb);
 
 	return 1;
 }
@@ -712,12 +764,22 @@ static int rockchip_canfd_get_rx_fifo_cnt(struct net_device *ndev)
 	return quota;
 }
 
+static inline int rockchip_canfd_rx_fifo_cnt(struct rockchip_canfd *rcan)
+{
+	return (rockchip_canfd_read(rcan, CAN_RXFC) & rcan->rx_fifo_mask) >>
+	       rcan->rx_fifo_shift;
+}
+
 /* rockchip_canfd_rx_poll - Poll routine for rx packets (NAPI)
  * @napi:	napi structure pointer
  * @quota:	Max number of rx packets to be processed.
  *
- * This is the poll routine for rx part.
- * It will process the packets maximux quota value.
+ * This is the poll routine for rx part. It drains the RX FIFO until it is
+ * empty or @quota frames were delivered. With rx_coalesce_usecs_irq set,
+ * the per-frame RX interrupt stays masked after a busy poll and the FIFO
+ * is polled again from rx_irq_timer; only the FIFO full interrupt is left
+ * as a watermark. The RX interrupt is unmasked again once a poll finds the
+ * FIFO empty.
  *
  * Return: number of packets received
  */
@@ -726,21 +788,46 @@ static int rockchip_canfd_rx_poll(struct napi_struct *napi, int quota)
 	struct net_device *ndev = napi->dev;
 	struct rockchip_canfd *rcan = netdev_priv(ndev);
 	int work_done = 0;
+	int cnt;
 
-	quota = rockchip_canfd_get_rx_fifo_cnt(ndev);
-	if (quota) {
-		while (work_done < quota)
+	/* the count lags behind the interrupt on some revisions */
+	if (rcan->rx_irq_pending) {
+		rcan->rx_irq_pending = false;
+		cnt = rockchip_canfd_get_rx_fifo_cnt(ndev);
+	} else {
+		cnt = rockchip_canfd_rx_fifo_cnt(rcan);
+	}
+
+	while (cnt && work_done < quota) {
+		while (cnt-- && work_done < quota)
 			work_done += rockchip_canfd_rx(ndev);
+		cnt = rockchip_canfd_rx_fifo_cnt(rcan);
 	}
 
-	if (work_done < 6) {
-		napi_complete_done(napi, work_done);
-		rockchip_canfd_write(rcan, CAN_INT_MASK, 0);
+	if (work_done < quota && napi_complete_done(napi, work_done)) {
+		if (rcan->rx_coalesce_usecs_irq && work_done) {
+			rockchip_canfd_write(rcan, CAN_INT_MASK, RX_FINISH_INT);
+			hrtimer_start(&rcan->rx_irq_timer,
+				      us_to_ktime(rcan->rx_coalesce_usecs_irq),
+				      HRTIMER_MODE_REL);
+		} else {
+			rockchip_canfd_write(rcan, CAN_INT_MASK, 0);
+		}
 	}
 
 	return work_done;
 }
 
+static enum hrtimer_restart rockchip_canfd_rx_irq_timer(struct hrtimer *t)
+{
+	struct rockchip_canfd *rcan = container_of(t, struct rockchip_canfd,
+						   rx_irq_timer);
+
+	napi_schedule(&rcan->napi);
+
+	return HRTIMER_NORESTART;
+}
+
 static int rockchip_canfd_err(struct net_device *ndev, u32 isr)
 {
 	struct rockchip_canfd *rcan = netdev_priv(ndev);
@@ -842,20 +929,15 @@ static irqreturn_t rockchip_canfd_interrupt(int irq, void *dev_id)
 		netif_wake_queue(ndev);
 	}
 
-	if (isr & RX_FINISH_INT) {
-		if (rcan->mode == ROCKCHIP_RK3568_CAN_MODE_V2) {
-			rockchip_canfd_write(rcan, CAN_INT_MASK, 0x1);
-			napi_schedule(&rcan->napi);
-		} else {
-			work_done = 0;
-			quota = (rockchip_canfd_read(rcan, CAN_RXFC) &
-				 rcan->rx_fifo_mask) >>
-				rcan->rx_fifo_shift;
-			if (quota) {
-				while (work_done < quota)
-					work_done += rockchip_canfd_rx(ndev);
-			}
-		}
+	if (rcan->rx_napi && (isr & ROCKCHIP_CANFD_RX_INT)) {
+		rockchip_canfd_write(rcan, CAN_INT_MASK, ROCKCHIP_CANFD_RX_INT);
+		rcan->rx_irq_pending = true;
+		napi_schedule(&rcan->napi);
+	} else if (isr & RX_FINISH_INT) {
+		work_done = 0;
+		quota = rockchip_canfd_rx_fifo_cnt(rcan);
+		while (work_done < quota)
+			work_done += rockchip_canfd_rx(ndev);
 	}
 
 	if (isr & err_int) {
@@ -891,7 +973,7 @@ static int rockchip_canfd_open(struct net_device *ndev)
 		goto exit_can_start;
 	}
 
-	if (rcan->mode == ROCKCHIP_RK3568_CAN_MODE_V2)
+	if (rcan->rx_napi)
 		napi_enable(&rcan->napi);
 	netif_start_queue(ndev);
 
@@ -910,8 +992,10 @@ static int rockchip_canfd_close(struct net_device *ndev)
 	struct rockchip_canfd *rcan = netdev_priv(ndev);
 
 	netif_stop_queue(ndev);
-	if (rcan->mode == ROCKCHIP_RK3568_CAN_MODE_V2)
+	if (rcan->rx_napi) {
 		napi_disable(&rcan->napi);
+		hrtimer_cancel(&rcan->rx_irq_timer);
+	}
 	rockchip_canfd_stop(ndev);
 	close_candev(ndev);
 	pm_runtime_put(rcan->dev);
@@ -928,6 +1012,132 @@ static const struct net_device_ops rockchip_canfd_netdev_ops = {
 	.ndo_change_mtu = can_change_mtu,
 };
 
+static int rockchip_canfd_get_coalesce(struct net_device *ndev,
+				       struct ethtool_coalesce *ec,
+				       struct kernel_ethtool_coalesce *kec,
+				       struct netlink_ext_ack *ext_ack)
+{
+	struct rockchip_canfd *rcan = netdev_priv(ndev);
+
+	ec->rx_coalesce_usecs_irq = rcan->rx_coalesce_usecs_irq;
+
+	return 0;
+}
+
+static int rockchip_canfd_set_coalesce(struct net_device *ndev,
+				       struct ethtool_coalesce *ec,
+				       struct kernel_ethtool_coalesce *kec,
+				       struct netlink_ext_ack *ext_ack)
+{
+	struct rockchip_canfd *rcan = netdev_priv(ndev);
+
+	if (!rcan->rx_napi) {
+		NL_SET_ERR_MSG(ext_ack, "RX is not polled in this mode");
+		return -EOPNOTSUPP;
+	}
+
+	if (ec->rx_coalesce_usecs_irq > ROCKCHIP_CANFD_MAX_COALESCE_US) {
+		NL_SET_ERR_MSG_MOD(ext_ack, "rx-usecs-irq is limited to 10000");
+		return -EINVAL;
+	}
+
+	WRITE_ONCE(rcan->rx_coalesce_usecs_irq, ec->rx_coalesce_usecs_irq);
+
+	return 0;
+}
+
+static const struct ethtool_ops rockchip_canfd_ethtool_ops = {
+	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS_IRQ,
+	.get_coalesce = rockchip_canfd_get_coalesce,
+	.set_coalesce = rockchip_canfd_set_coalesce,
+	.get_ts_info = ethtool_op_get_ts_info,
+};
+
+/* rx_filter: "<id>:<mask>" hex pairs in CAN_RAW_FILTER semantics, e.g. the
+ * union of the filters of the sockets bound to this interface. Entries
+ * beyond the hardware banks are merged into the last one, the socket
+ * filters keep doing the exact match. Empty clears back to accept all.
+ * Takes effect on the next ifup.
+ */
+static ssize_t rx_filter_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct rockchip_canfd *rcan = netdev_priv(to_net_dev(dev));
+	int i, len = 0;
+
+	if (!rcan->rx_filter_cnt)
+		return sysfs_emit(buf, "all\n");
+
+	for (i = 0; i < rcan->rx_filter_cnt; i++)
+		len += sysfs_emit_at(buf, len, "%08x:%08x%s\n",
+				     rcan->rx_filter[i].can_id,
+				     rcan->rx_filter[i].can_mask,
+				     rcan->rx_filter_merged &&
+				     i == rcan->rx_filter_cnt - 1 ? " merged" : "");
+
+	return len;
+}
+
+static ssize_t rx_filter_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct net_device *ndev = to_net_dev(dev);
+	struct rockchip_canfd *rcan = netdev_priv(ndev);
+	struct can_filter filter[CAN_RX_FILTER_NUM], add;
+	bool merged = false;
+	char *str, *p, *tok;
+	ssize_t ret = count;
+	int cnt = 0;
+
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+
+	p = str;
+	while ((tok = strsep(&p, " ,\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (sscanf(tok, "%x:%x", &add.can_id, &add.can_mask) != 2) {
+			ret = -EINVAL;
+			goto out;
+		}
+		add.can_mask &= CAN_EFF_MASK;
+		add.can_id &= add.can_mask;
+		if (cnt < CAN_RX_FILTER_NUM) {
+			filter[cnt++] = add;
+		} else {
+			rockchip_canfd_filter_merge(&filter[cnt - 1], &add);
+			merged = true;
+		}
+	}
+
+	rtnl_lock();
+	if (ndev->flags & IFF_UP) {
+		ret = -EBUSY;
+	} else {
+		memcpy(rcan->rx_filter, filter, sizeof(filter[0]) * cnt);
+		rcan->rx_filter_cnt = cnt;
+		rcan->rx_filter_merged = merged;
+	}
+	rtnl_unlock();
+out:
+	kfree(str);
+
+	return ret;
+}
+
+static DEVICE_ATTR_RW(rx_filter);
+
+static struct attribute *rockchip_canfd_attrs[] = {
+	&dev_attr_rx_filter.attr,
+	NULL,
+};
+
+static const struct attribute_group rockchip_canfd_attr_group = {
+	.attrs = rockchip_canfd_attrs,
+};
+
 /**
  * rockchip_canfd_suspend - Suspend method for the driver
  * @dev:	Address of the device structure
@@ -1137,12 +1347,25 @@ static int rockchip_canfd_probe(struct platform_device *pdev)
 					   rcan->tx_invalid, 4))
 		rcan->txtorx = 1;
 
-	if (rcan->mode == ROCKCHIP_RK3568_CAN_MODE_V2) {
+	if (rcan->mode == ROCKCHIP_RK3568_CAN_MODE_V2)
 		rcan->txtorx = 0;
+
+	/*
+	 * The TX-to-RX workaround pulls the echoed frame out of the RX FIFO
+	 * from the TX interrupt, so the FIFO can only be handed over to NAPI
+	 * when it is not in use.
+	 */
+	if (!rcan->txtorx) {
+		rcan->rx_napi = true;
 		netif_napi_add(ndev, &rcan->napi, rockchip_canfd_rx_poll);
+		hrtimer_init(&rcan->rx_irq_timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL);
+		rcan->rx_irq_timer.function = rockchip_canfd_rx_irq_timer;
 	}
 
 	ndev->netdev_ops = &rockchip_canfd_netdev_ops;
+	ndev->ethtool_ops = &rockchip_canfd_ethtool_ops;
+	ndev->sysfs_groups[0] = &rockchip_canfd_attr_group;
 	ndev->irq = irq;
 	ndev->flags |= IFF_ECHO;
 	rcan->can.restart_ms = 1;
@@ -1187,7 +1410,7 @@ static int rockchip_canfd_remove(struct platform_device *pdev)
 
 	unregister_netdev(ndev);
 	pm_runtime_disable(&pdev->dev);
-	if (rcan->mode == ROCKCHIP_RK3568_CAN_MODE_V2)
+	if (rcan->rx_napi)
 		netif_napi_del(&rcan->napi);
 	free_candev(ndev);
 
@@ -13,6 +13,7 @@
 #include <linux/slab.h>
 #include <linux/prefetch.h>
 #include <linux/regmap.h>
+#include <linux/sort.h>
 #include <linux/phy.h>
 #include <linux/udp.h>
 #include <linux/skbuff.h>
@@ -87,6 +88,47 @@ struct dwmac_rk_lb_priv {
 	int final_tx;
 	int final_rx;
 	int max_delay;
+
+	struct dwmac_rk_bench *bench;
+};
+
+struct dwmac_rk_bench_result {
+	char ifname[IFNAMSIZ];
+	int type;
+	int speed;
+	int ret;
+	unsigned int size;
+	unsigned int depth;
+	unsigned int duration;
+	bool stalled;
+
+	u64 tx_pkts;
+	u64 rx_pkts;
+	u64 rx_bytes;
+	u64 errors;
+	u64 elapsed_ns;
+	/* round trip, ns */
+	u32 lat_min;
+	u32 lat_p50;
+	u32 lat_p90;
+	u32 lat_p99;
+	u32 lat_p999;
+	u32 lat_max;
+};
+
+struct dwmac_rk_bench {
+	struct dwmac_rk_bench_result res;
+
+	struct dma_desc *dma_tx;
+	dma_addr_t dma_tx_phy;
+	struct dma_desc *dma_rx;
+	dma_addr_t dma_rx_phy;
+	void *rx_buf;
+	dma_addr_t rx_buf_phy;
+
+	u64 *tx_stamp;
+	u32 *lat;
+	u64 nr_lat;
 };
 
 #define DMA_CONTROL_OSP		BIT(4)
@@ -110,6 +152,15 @@ struct dwmac_rk_lb_priv {
 #define DWMAC_RK_TEST_PKT_MAGIC 0xdeadcafecafedeadULL
 #define DWMAC_RK_TEST_PKT_MAX_SIZE 1500
 
+#define DWMAC_RK_BENCH_MIN_SIZE (DWMAC_RK_TEST_PKT_SIZE + sizeof(struct udphdr))
+#define DWMAC_RK_BENCH_MAX_DEPTH 256
+#define DWMAC_RK_BENCH_MAX_MS 10000
+#define DWMAC_RK_BENCH_SAMPLES 65536
+#define DWMAC_RK_BENCH_STALL_NS (20 * NSEC_PER_MSEC)
+
+static DEFINE_MUTEX(dwmac_rk_bench_lock);
+static struct dwmac_rk_bench_result dwmac_rk_bench_last;
+
 static __maybe_unused struct dwmac_rk_packet_attrs dwmac_rk_udp_attr = {
 	.dst = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff},
 	.tcp = 0,
@@ -975,6 +1026,281 @@ static int dwmac_rk_loopback_delayline_scan(struct stmmac_priv *priv,
 		return dwmac_rk_delayline_scan_cross(priv, lb_priv);
 }
 
+static int dwmac_rk_bench_alloc(struct stmmac_priv *priv,
+				struct dwmac_rk_lb_priv *lb_priv)
+{
+	struct dwmac_rk_bench *bench = lb_priv->bench;
+	size_t ring = bench->res.depth * sizeof(struct dma_desc);
+
+	bench->dma_tx = dma_alloc_coherent(priv->device, ring,
+					   &bench->dma_tx_phy, GFP_KERNEL);
+	bench->dma_rx = dma_alloc_coherent(priv->device, ring,
+					   &bench->dma_rx_phy, GFP_KERNEL);
+	bench->rx_buf = dma_alloc_coherent(priv->device,
+					   bench->res.depth * lb_priv->dma_buf_sz,
+					   &bench->rx_buf_phy, GFP_KERNEL);
+	bench->tx_stamp = kcalloc(bench->res.depth, sizeof(u64), GFP_KERNEL);
+	bench->lat = kvcalloc(DWMAC_RK_BENCH_SAMPLES, sizeof(u32), GFP_KERNEL);
+
+	if (!bench->dma_tx || !bench->dma_rx || !bench->rx_buf ||
+	    !bench->tx_stamp || !bench->lat)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void dwmac_rk_bench_free(struct stmmac_priv *priv,
+				struct dwmac_rk_lb_priv *lb_priv)
+{
+	struct dwmac_rk_bench *bench = lb_priv->bench;
+	size_t ring = bench->res.depth * sizeof(struct dma_desc);
+
+	if (bench->dma_tx)
+		dma_free_coherent(priv->device, ring, bench->dma_tx,
+				  bench->dma_tx_phy);
+	if (bench->dma_rx)
+		dma_free_coherent(priv->device, ring, bench->dma_rx,
+				  bench->dma_rx_phy);
+	if (bench->rx_buf)
+		dma_free_coherent(priv->device,
+				  bench->res.depth * lb_priv->dma_buf_sz,
+				  bench->rx_buf, bench->rx_buf_phy);
+	kfree(bench->tx_stamp);
+	kvfree(bench->lat);
+}
+
+static inline void dwmac_rk_bench_rx_refill(struct stmmac_priv *priv,
+					    struct dwmac_rk_lb_priv *lb_priv,
+					    u32 entry)
+{
+	struct dwmac_rk_bench *bench = lb_priv->bench;
+	struct dma_desc *p = &bench->dma_rx[entry];
+
+	stmmac_set_desc_addr(priv, p, bench->rx_buf_phy +
+			     entry * lb_priv->dma_buf_sz);
+	stmmac_set_desc_sec_addr(priv, p, 0, false);
+	dma_wmb();
+	stmmac_set_rx_owner(priv, p, true);
+}
+
+static int dwmac_rk_bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void dwmac_rk_bench_latency(struct dwmac_rk_bench *bench)
+{
+	struct dwmac_rk_bench_result *res = &bench->res;
+	u32 n = min_t(u64, bench->nr_lat, DWMAC_RK_BENCH_SAMPLES);
+
+	if (!n)
+		return;
+
+	sort(bench->lat, n, sizeof(u32), dwmac_rk_bench_cmp_u32, NULL);
+
+	res->lat_min = bench->lat[0];
+	res->lat_p50 = bench->lat[(n - 1) * 500 / 1000];
+	res->lat_p90 = bench->lat[(n - 1) * 900 / 1000];
+	res->lat_p99 = bench->lat[(n - 1) * 990 / 1000];
+	res->lat_p999 = bench->lat[(n - 1) * 999 / 1000];
+	res->lat_max = bench->lat[n - 1];
+}
+
+/*
+ * Throughput benchmark: unlike __dwmac_rk_loopback_run(), which sends one
+ * frame through a single descriptor, this keeps up to depth - 1 copies of
+ * the test frame in flight on real rings for the requested duration. All
+ * TX descriptors point to the same mapped frame. The CPU polls the OWN bits
+ * on the rings, and the round-trip time of each frame is measured from the
+ * TX tail pointer write until its RX descriptor is seen completed. The
+ * latency percentiles come from the last DWMAC_RK_BENCH_SAMPLES frames.
+ */
+static int dwmac_rk_loopback_bench(struct stmmac_priv *priv,
+				   struct dwmac_rk_lb_priv *lb_priv)
+{
+	struct dwmac_rk_bench *bench = lb_priv->bench;
+	struct dwmac_rk_bench_result *res = &bench->res;
+	struct dwmac_rk_packet_attrs attr = dwmac_rk_udp_attr;
+	u32 desc_size = sizeof(struct dma_desc);
+	u64 tx_seq = 0, clean_seq = 0, rx_seq = 0;
+	u32 depth = res->depth;
+	int coe = priv->hw->rx_csum;
+	u64 start, end, now, last;
+	struct sk_buff *skb;
+	unsigned int len;
+	dma_addr_t des;
+	int ret;
+	u32 i;
+
+	if (!priv->plat->has_gmac4)
+		return -EOPNOTSUPP;
+
+	ret = dwmac_rk_bench_alloc(priv, lb_priv);
+	if (ret)
+		goto free;
+
+	attr.size = res->size - DWMAC_RK_TEST_PKT_SIZE - sizeof(struct udphdr);
+	lb_priv->packet = &attr;
+	lb_priv->id++;
+	lb_priv->tx = 0;
+	lb_priv->rx = 0;
+
+	skb = dwmac_rk_get_skb(priv, lb_priv);
+	if (!skb) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	len = skb_headlen(skb);
+	des = dma_map_single(priv->device, skb->data, len, DMA_TO_DEVICE);
+	if (dma_mapping_error(priv->device, des)) {
+		ret = -EFAULT;
+		goto free_skb;
+	}
+
+	for (i = 0; i < depth; i++) {
+		dwmac_rk_bench_rx_refill(priv, lb_priv, i);
+		stmmac_init_tx_desc(priv, &bench->dma_tx[i], priv->mode,
+				    i == depth - 1);
+	}
+	wmb();
+
+	stmmac_init_rx_chan(priv, priv->ioaddr, priv->plat->dma_cfg,
+			    bench->dma_rx_phy, 0);
+	stmmac_set_rx_ring_len(priv, priv->ioaddr, depth - 1, 0);
+	stmmac_set_rx_tail_ptr(priv, priv->ioaddr,
+			       bench->dma_rx_phy + depth * desc_size, 0);
+
+	stmmac_init_tx_chan(priv, priv->ioaddr, priv->plat->dma_cfg,
+			    bench->dma_tx_phy, 0);
+	stmmac_set_tx_ring_len(priv, priv->ioaddr, depth - 1, 0);
+	stmmac_set_tx_tail_ptr(priv, priv->ioaddr, bench->dma_tx_phy, 0);
+
+	stmmac_mac_set(priv, priv->ioaddr, true);
+	stmmac_start_rx(priv, priv->ioaddr, 0);
+	stmmac_start_tx(priv, priv->ioaddr, 0);
+
+	start = ktime_get_ns();
+	end = start + (u64)res->duration * NSEC_PER_MSEC;
+	last = start;
+
+	for (;;) {
+		u64 seq;
+
+		now = ktime_get_ns();
+
+		/* Like stmmac_tx_avail(), never let the ring fill up */
+		seq = tx_seq;
+		while (now < end && tx_seq - rx_seq < depth - 1 &&
+		       tx_seq - clean_seq < depth - 1) {
+			struct dma_desc *p = &bench->dma_tx[tx_seq % depth];
+
+			stmmac_set_desc_addr(priv, p, des);
+			stmmac_prepare_tx_desc(priv, p, 1, len, 1, priv->mode,
+					       1, 1, len);
+			bench->tx_stamp[tx_seq % depth] = now;
+			tx_seq++;
+		}
+		if (tx_seq != seq) {
+			wmb();
+			stmmac_enable_dma_transmission(priv, priv->ioaddr);
+			stmmac_set_tx_tail_ptr(priv, priv->ioaddr,
+					       bench->dma_tx_phy +
+					       (tx_seq % depth) * desc_size, 0);
+		}
+
+		while (clean_seq < tx_seq) {
+			struct dma_desc *p = &bench->dma_tx[clean_seq % depth];
+			int status;
+
+			status = priv->hw->desc->tx_status(&priv->dev->stats,
+							   &priv->xstats, p,
+							   priv->ioaddr);
+			if (status & tx_dma_own)
+				break;
+			if (unlikely(status & tx_err))
+				res->errors++;
+
+			stmmac_release_tx_desc(priv, p, priv->mode);
+			clean_seq++;
+			last = now;
+		}
+
+		now = ktime_get_ns();
+		seq = rx_seq;
+		while (rx_seq < tx_seq) {
+			u32 entry = rx_seq % depth;
+			struct dma_desc *p = &bench->dma_rx[entry];
+			int status;
+
+			status = priv->hw->desc->rx_status(&priv->dev->stats,
+							   &priv->xstats, p);
+			if (status & dma_own)
+				break;
+
+			if (unlikely(status & discard_frame) ||
+			    stmmac_get_rx_frame_len(priv, p, coe) !=
+			    len + ETH_FCS_LEN) {
+				res->errors++;
+			} else {
+				res->rx_pkts++;
+				res->rx_bytes += len + ETH_FCS_LEN;
+			}
+
+			bench->lat[bench->nr_lat++ % DWMAC_RK_BENCH_SAMPLES] =
+				min_t(u64, now - bench->tx_stamp[entry], U32_MAX);
+
+			dwmac_rk_bench_rx_refill(priv, lb_priv, entry);
+			rx_seq++;
+		}
+		if (rx_seq != seq) {
+			wmb();
+			stmmac_set_rx_tail_ptr(priv, priv->ioaddr,
+					       bench->dma_rx_phy +
+					       (rx_seq % depth) * desc_size, 0);
+			last = now;
+		}
+
+		if (now >= end && rx_seq == tx_seq && clean_seq == tx_seq)
+			break;
+
+		/* a frame lost in the loop would otherwise stall us forever */
+		if (now - last > DWMAC_RK_BENCH_STALL_NS) {
+			res->stalled = true;
+			break;
+		}
+
+		cond_resched();
+	}
+
+	res->tx_pkts = tx_seq;
+	res->elapsed_ns = last - start;
+
+	stmmac_stop_rx(priv, priv->ioaddr, 0);
+	stmmac_stop_tx(priv, priv->ioaddr, 0);
+	stmmac_mac_set(priv, priv->ioaddr, false);
+	/* wait for state machine is disabled */
+	usleep_range(100, 150);
+
+	dwmac_rk_bench_latency(bench);
+
+	if (!res->rx_pkts)
+		ret = -EIO;
+	else if (res->stalled)
+		ret = -ETIMEDOUT;
+
+	dma_unmap_single(priv->device, des, len, DMA_TO_DEVICE);
+free_skb:
+	dev_kfree_skb(skb);
+free:
+	dwmac_rk_bench_free(priv, lb_priv);
+	lb_priv->packet = NULL;
+
+	return ret;
+}
+
 static void dwmac_rk_dma_free_rx_skbufs(struct stmmac_priv *priv,
 					struct dwmac_rk_lb_priv *lb_priv)
 {
@@ -1383,6 +1709,8 @@ static int dwmac_rk_loopback_run(struct stmmac_priv *priv,
 			goto out;
 		}
 		ret = dwmac_rk_loopback_delayline_scan(priv, lb_priv);
+	} else if (lb_priv->bench) {
+		ret = dwmac_rk_loopback_bench(priv, lb_priv);
 	} else {
 		lb_priv->id++;
 		lb_priv->tx = 0;
@@ -1563,6 +1891,128 @@ static ssize_t phy_lb_scan_store(struct device *dev,
 }
 static DEVICE_ATTR_WO(phy_lb_scan);
 
+static ssize_t lb_bench_show(struct device *dev,
+			     struct device_attribute *attr,
+			     char *buf)
+{
+	struct dwmac_rk_bench_result *res = &dwmac_rk_bench_last;
+	u64 pps, l2_mbps, wire_mbps;
+	ssize_t len;
+
+	mutex_lock(&dwmac_rk_bench_lock);
+
+	if (!res->size || !res->elapsed_ns) {
+		len = sysfs_emit(buf, "no result\n");
+		goto out;
+	}
+
+	pps = div64_u64(res->rx_pkts * NSEC_PER_SEC, res->elapsed_ns);
+	l2_mbps = div64_u64(res->rx_bytes * 8 * 1000, res->elapsed_ns);
+	/* preamble, SFD and inter-frame gap */
+	wire_mbps = div64_u64((res->rx_bytes + res->rx_pkts * 20) * 8 * 1000,
+			      res->elapsed_ns);
+
+	len = sysfs_emit(buf,
+			 "%s: %s loopback %dMbps, %u bytes, depth %u, %u ms: %s\n"
+			 "tx %llu rx %llu errors %llu\n"
+			 "%llu pps, %llu Mbps (L2), %llu Mbps (wire)\n"
+			 "rtt ns: min %u p50 %u p90 %u p99 %u p99.9 %u max %u\n",
+			 res->ifname,
+			 res->type == LOOPBACK_TYPE_GMAC ? "MAC" : "PHY",
+			 res->speed, res->size, res->depth, res->duration,
+			 res->ret ? (res->stalled ? "STALLED" : "FAIL") : "PASS",
+			 res->tx_pkts, res->rx_pkts, res->errors,
+			 pps, l2_mbps, wire_mbps,
+			 res->lat_min, res->lat_p50, res->lat_p90,
+			 res->lat_p99, res->lat_p999, res->lat_max);
+out:
+	mutex_unlock(&dwmac_rk_bench_lock);
+
+	return len;
+}
+
+static ssize_t lb_bench_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct net_device *ndev = dev_get_drvdata(dev);
+	struct stmmac_priv *priv = netdev_priv(ndev);
+	unsigned int size = DWMAC_RK_TEST_PKT_MAX_SIZE - 1;
+	unsigned int depth = 64, duration = 1000;
+	struct dwmac_rk_lb_priv *lb_priv;
+	struct dwmac_rk_bench *bench;
+	int speed, type;
+	char mode[4];
+
+	if (sscanf(buf, "%3s %d %u %u %u", mode, &speed, &size, &depth,
+		   &duration) < 2)
+		goto usage;
+
+	if (!strcmp(mode, "mac"))
+		type = LOOPBACK_TYPE_GMAC;
+	else if (!strcmp(mode, "phy"))
+		type = LOOPBACK_TYPE_PHY;
+	else
+		goto usage;
+
+	if (speed != LOOPBACK_SPEED10 && speed != LOOPBACK_SPEED100 &&
+	    speed != LOOPBACK_SPEED1000)
+		goto usage;
+
+	if (size < DWMAC_RK_BENCH_MIN_SIZE ||
+	    size >= DWMAC_RK_TEST_PKT_MAX_SIZE ||
+	    depth < 2 || depth > DWMAC_RK_BENCH_MAX_DEPTH ||
+	    !duration || duration > DWMAC_RK_BENCH_MAX_MS)
+		goto usage;
+
+	if (!priv->plat->has_gmac4)
+		return -EOPNOTSUPP;
+
+	lb_priv = kzalloc(sizeof(*lb_priv), GFP_KERNEL);
+	if (!lb_priv)
+		return -ENOMEM;
+
+	bench = kzalloc(sizeof(*bench), GFP_KERNEL);
+	if (!bench) {
+		kfree(lb_priv);
+		return -ENOMEM;
+	}
+
+	strscpy(bench->res.ifname, netdev_name(ndev), IFNAMSIZ);
+	bench->res.type = type;
+	bench->res.speed = speed;
+	bench->res.size = size;
+	bench->res.depth = depth;
+	bench->res.duration = duration;
+
+	lb_priv->sysfs = 1;
+	lb_priv->type = type;
+	lb_priv->speed = speed;
+	lb_priv->scan = 0;
+	lb_priv->bench = bench;
+
+	bench->res.ret = dwmac_rk_loopback_run(priv, lb_priv);
+	pr_info("%s loopback benchmark: %s\n", mode,
+		bench->res.ret ? "FAIL" : "PASS");
+
+	mutex_lock(&dwmac_rk_bench_lock);
+	dwmac_rk_bench_last = bench->res;
+	mutex_unlock(&dwmac_rk_bench_lock);
+
+	kfree(bench);
+	kfree(lb_priv);
+
+	return count;
+usage:
+	pr_err("usage: <mac|phy> <speed> [frame size] [depth] [duration ms]\n");
+	pr_err("frame size <%zu, %d>, depth <2, %d>, duration <1, %d>\n",
+	       DWMAC_RK_BENCH_MIN_SIZE, DWMAC_RK_TEST_PKT_MAX_SIZE - 1,
+	       DWMAC_RK_BENCH_MAX_DEPTH, DWMAC_RK_BENCH_MAX_MS);
+
+	return -EINVAL;
+}
+static DEVICE_ATTR_RW(lb_bench);
+
 int dwmac_rk_create_loopback_sysfs(struct device *device)
 {
 	int ret;
@@ -1583,8 +2033,15 @@ int dwmac_rk_create_loopback_sysfs(struct device *device)
 	if (ret)
 		goto remove_phy_lb;
 
+	ret = device_create_file(device, &dev_attr_lb_bench);
+	if (ret)
+		goto remove_phy_lb_scan;
+
 	return 0;
 
+remove_phy_lb_scan:
+	device_remove_file(device, &dev_attr_phy_lb_scan);
+
 remove_rgmii_delayline:
 	device_remove_file(device, &dev_attr_rgmii_delayline);
 
@@ -1603,6 +2060,7 @@ int dwmac_rk_remove_loopback_sysfs(struct device *device)
 	device_remove_file(device, &dev_attr_mac_lb);
 	device_remove_file(device, &dev_attr_phy_lb);
 	device_remove_file(device, &dev_attr_phy_lb_scan);
+	device_remove_file(device, &dev_attr_lb_bench);
 
 	return 0;
 }
@@ -3005,6 +3005,53 @@ static void rk_get_eth_addr(void *priv, unsigned char *addr)
 	dev_err(dev, "%s: mac address: %pM\n", __func__, addr);
 }
 
+/*
+ * Some integrations also route the per-channel sbd_perch_{rx,tx}_intr_o
+ * lines to the GIC. If the DT names one for every queue in use ("rx0".."rxN"
+ * and "tx0".."txN" in interrupt-names), run the DMA in per-channel interrupt
+ * mode, so that each queue has its own handler and CPU instead of all of
+ * them going through macirq.
+ */
+static int rk_gmac_get_chan_irqs(struct platform_device *pdev,
+				 struct plat_stmmacenet_data *plat_dat,
+				 struct stmmac_resources *res)
+{
+	int rx_irq[MTL_MAX_RX_QUEUES] = { 0 };
+	int tx_irq[MTL_MAX_TX_QUEUES] = { 0 };
+	char name[8];
+	u32 i;
+
+	if (!plat_dat->has_gmac4)
+		return 0;
+
+	for (i = 0; i < plat_dat->rx_queues_to_use; i++) {
+		snprintf(name, sizeof(name), "rx%u", i);
+		rx_irq[i] = platform_get_irq_byname_optional(pdev, name);
+		if (rx_irq[i] == -EPROBE_DEFER)
+			return rx_irq[i];
+		if (rx_irq[i] < 0)
+			return 0;
+	}
+
+	for (i = 0; i < plat_dat->tx_queues_to_use; i++) {
+		snprintf(name, sizeof(name), "tx%u", i);
+		tx_irq[i] = platform_get_irq_byname_optional(pdev, name);
+		if (tx_irq[i] == -EPROBE_DEFER)
+			return tx_irq[i];
+		if (tx_irq[i] < 0)
+			return 0;
+	}
+
+	memcpy(res->rx_irq, rx_irq, sizeof(rx_irq));
+	memcpy(res->tx_irq, tx_irq, sizeof(tx_irq));
+	plat_dat->multi_msi_en = 1;
+
+	dev_info(&pdev->dev, "per-channel interrupts for %u RX / %u TX queues\n",
+		 plat_dat->rx_queues_to_use, plat_dat->tx_queues_to_use);
+
+	return 0;
+}
+
 static int rk_gmac_probe(struct platform_device *pdev)
 {
 	struct plat_stmmacenet_data *plat_dat;
@@ -3032,7 +3079,37 @@ static int rk_gmac_probe(struct platform_device *pdev)
 	if (!plat_dat->has_gmac4)
 		plat_dat->has_gmac = true;
 
-	plat_dat->sph_disable = true;
+	ret = rk_gmac_get_chan_irqs(pdev, plat_dat, &stmmac_res);
+	if (ret)
+		goto err_remove_config_dt;
+
+	/*
+	 * Split header stays off unless the board opts in: it lets jumbo
+	 * payloads go to the stack as page_pool frags with only the header
+	 * synced, but has not been qualified on every Rockchip GMAC.
+	 */
+	plat_dat->sph_disable = !of_property_read_bool(pdev->dev.of_node,
+						       "rockchip,split-header");
+
+	/*
+	 * Small packets at line rate on RK3568/RK3588 raise an RX interrupt
+	 * every few microseconds with the static RIWT; let net_dim adapt the
+	 * per-queue coalesce values to the load instead.
+	 */
+	plat_dat->dim_en = true;
+
+	/*
+	 * Only the PCI glues turn RSS on. With several RX queues from
+	 * snps,mtl-rx-config let the core hash flows over them (it still
+	 * checks dma_cap.rssen), so each AF_XDP socket gets its share.
+	 */
+	if (plat_dat->rx_queues_to_use > 1)
+		plat_dat->rss_en = 1;
+
+	/* an XSK pool needs both the RX and the TX queue of its index */
+	if (plat_dat->tx_queues_to_use < plat_dat->rx_queues_to_use)
+		dev_info(&pdev->dev, "AF_XDP zero-copy limited to the first %u queues\n",
+			 plat_dat->tx_queues_to_use);
 
 	plat_dat->fix_mac_speed = rk_fix_speed;
 	plat_dat->get_eth_addr = rk_get_eth_addr;
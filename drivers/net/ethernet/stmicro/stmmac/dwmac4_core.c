@@ -1126,6 +1126,22 @@ static int dwmac4_config_l4_filter(struct mac_device_info *hw, u32 filter_no,
 	return 0;
 }
 
+static int dwmac4_config_l3l4_dma(struct mac_device_info *hw, u32 filter_no,
+				  bool en, u32 chan)
+{
+	void __iomem *ioaddr = hw->pcsr;
+	u32 value;
+
+	value = readl(ioaddr + GMAC_L3L4_CTRL(filter_no));
+	value &= ~(GMAC_L3L4_DMCHEN0 | GMAC_L3L4_DMCHN0);
+	if (en)
+		value |= GMAC_L3L4_DMCHEN0 |
+			 ((chan << GMAC_L3L4_DMCHN0_SHIFT) & GMAC_L3L4_DMCHN0);
+	writel(value, ioaddr + GMAC_L3L4_CTRL(filter_no));
+
+	return 0;
+}
+
 #ifdef CONFIG_STMMAC_FULL
 const struct stmmac_ops dwmac4_ops = {
 	.core_init = dwmac4_core_init,
@@ -1210,6 +1226,7 @@ const struct stmmac_ops dwmac410_ops = {
 	.set_arp_offload = dwmac4_set_arp_offload,
 	.config_l3_filter = dwmac4_config_l3_filter,
 	.config_l4_filter = dwmac4_config_l4_filter,
+	.config_l3l4_dma = dwmac4_config_l3l4_dma,
 #ifdef CONFIG_STMMAC_FULL
 	.est_configure = dwmac5_est_configure,
 	.est_irq_status = dwmac5_est_irq_status,
@@ -1265,6 +1282,7 @@ const struct stmmac_ops dwmac510_ops = {
 	.set_arp_offload = dwmac4_set_arp_offload,
 	.config_l3_filter = dwmac4_config_l3_filter,
 	.config_l4_filter = dwmac4_config_l4_filter,
+	.config_l3l4_dma = dwmac4_config_l3l4_dma,
 	.est_configure = dwmac5_est_configure,
 	.est_irq_status = dwmac5_est_irq_status,
 	.fpe_configure = dwmac5_fpe_configure,
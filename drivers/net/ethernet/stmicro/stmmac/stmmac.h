@@ -12,6 +12,7 @@
 #define STMMAC_RESOURCE_NAME   "stmmaceth"
 
 #include <linux/clk.h>
+#include <linux/dim.h>
 #include <linux/hrtimer.h>
 #include <linux/if_vlan.h>
 #include <linux/stmmac.h>
@@ -101,6 +102,7 @@ struct stmmac_rx_queue {
 	struct stmmac_rx_buffer *buf_pool;
 	struct stmmac_priv *priv_data;
 	struct dma_extended_desc *dma_erx;
+	unsigned int napi_skb_frag_size;
 	struct dma_desc *dma_rx ____cacheline_aligned_in_smp;
 	unsigned int cur_rx;
 	unsigned int dirty_rx;
@@ -123,6 +125,13 @@ struct stmmac_channel {
 	struct stmmac_priv *priv_data;
 	spinlock_t lock;
 	u32 index;
+	/* Adaptive interrupt moderation */
+	struct dim rx_dim;
+	struct dim tx_dim;
+	u16 rx_dim_events;
+	u16 tx_dim_events;
+	u64 rx_dim_bytes;
+	u64 tx_dim_bytes;
 };
 
 struct stmmac_tc_entry {
@@ -163,6 +172,7 @@ struct stmmac_rss {
 };
 
 #define STMMAC_FLOW_ACTION_DROP		BIT(0)
+#define STMMAC_FLOW_ACTION_QUEUE	BIT(1)
 struct stmmac_flow_entry {
 	unsigned long cookie;
 	unsigned long action;
@@ -170,6 +180,11 @@ struct stmmac_flow_entry {
 	int in_use;
 	int idx;
 	int is_l4;
+	/* rx queue of STMMAC_FLOW_ACTION_QUEUE */
+	u32 queue;
+	/* set by an ethtool ntuple rule, the rule is kept for readback */
+	bool is_ntuple;
+	struct ethtool_rx_flow_spec fs;
 };
 
 /* Rx Frame Steering */
@@ -216,6 +231,8 @@ struct stmmac_priv {
 	unsigned int rx_copybreak;
 	u32 rx_riwt[MTL_MAX_TX_QUEUES];
 	int hwts_rx_en;
+	DECLARE_BITMAP(rx_dim_en, MTL_MAX_RX_QUEUES);
+	DECLARE_BITMAP(tx_dim_en, MTL_MAX_TX_QUEUES);
 
 	void __iomem *ioaddr;
 	struct net_device *dev;
@@ -347,6 +364,8 @@ static inline void stmmac_set_ethtool_ops(struct net_device *netdev)
 #endif
 
 int stmmac_init_tstamp_counter(struct stmmac_priv *priv, u32 systime_flags);
+int stmmac_flow_entry_del(struct stmmac_priv *priv,
+			  struct stmmac_flow_entry *entry);
 void stmmac_ptp_register(struct stmmac_priv *priv);
 void stmmac_ptp_unregister(struct stmmac_priv *priv);
 int stmmac_xdp_open(struct net_device *dev);
@@ -362,6 +381,8 @@ bool stmmac_eee_init(struct stmmac_priv *priv);
 int stmmac_reinit_queues(struct net_device *dev, u32 rx_cnt, u32 tx_cnt);
 int stmmac_reinit_ringparam(struct net_device *dev, u32 rx_size, u32 tx_size);
 int stmmac_bus_clks_config(struct stmmac_priv *priv, bool enabled);
+u32 stmmac_usec2riwt(u32 usec, struct stmmac_priv *priv);
+u32 stmmac_riwt2usec(u32 riwt, struct stmmac_priv *priv);
 void stmmac_fpe_handshake(struct stmmac_priv *priv, bool enable);
 
 static inline bool stmmac_xdp_is_enabled(struct stmmac_priv *priv)
@@ -385,6 +406,8 @@ int stmmac_xsk_wakeup(struct net_device *dev, u32 queue, u32 flags);
 struct timespec64 stmmac_calc_tas_basetime(ktime_t old_base_time,
 					   ktime_t current_time,
 					   u64 cycle_time);
+bool stmmac_est_stop(struct stmmac_priv *priv);
+int stmmac_est_rebase(struct stmmac_priv *priv);
 
 #if IS_ENABLED(CONFIG_STMMAC_SELFTESTS)
 void stmmac_selftest_run(struct net_device *dev,
@@ -830,32 +830,6 @@ static int stmmac_ethtool_op_set_eee(struct net_device *dev,
 	return 0;
 }
 
-static u32 stmmac_usec2riwt(u32 usec, struct stmmac_priv *priv)
-{
-	unsigned long clk = clk_get_rate(priv->plat->stmmac_clk);
-
-	if (!clk) {
-		clk = priv->plat->clk_ref_rate;
-		if (!clk)
-			return 0;
-	}
-
-	return (usec * (clk / 1000000)) / 256;
-}
-
-static u32 stmmac_riwt2usec(u32 riwt, struct stmmac_priv *priv)
-{
-	unsigned long clk = clk_get_rate(priv->plat->stmmac_clk);
-
-	if (!clk) {
-		clk = priv->plat->clk_ref_rate;
-		if (!clk)
-			return 0;
-	}
-
-	return (riwt * 256) / (clk / 1000000);
-}
-
 static int __stmmac_get_coalesce(struct net_device *dev,
 				 struct ethtool_coalesce *ec,
 				 int queue)
@@ -875,6 +849,7 @@ static int __stmmac_get_coalesce(struct net_device *dev,
 		return -EINVAL;
 
 	if (queue < tx_cnt) {
+		ec->use_adaptive_tx_coalesce = test_bit(queue, priv->tx_dim_en);
 		ec->tx_coalesce_usecs = priv->tx_coal_timer[queue];
 		ec->tx_max_coalesced_frames = priv->tx_coal_frames[queue];
 	} else {
@@ -883,6 +858,7 @@ static int __stmmac_get_coalesce(struct net_device *dev,
 	}
 
 	if (priv->use_riwt && queue < rx_cnt) {
+		ec->use_adaptive_rx_coalesce = test_bit(queue, priv->rx_dim_en);
 		ec->rx_max_coalesced_frames = priv->rx_coal_frames[queue];
 		ec->rx_coalesce_usecs = stmmac_riwt2usec(priv->rx_riwt[queue],
 							 priv);
@@ -908,6 +884,19 @@ static int stmmac_get_per_queue_coalesce(struct net_device *dev, u32 queue,
 	return __stmmac_get_coalesce(dev, ec, queue);
 }
 
+static void stmmac_set_adaptive_coal(unsigned long *dim_en, struct dim *dim,
+				     int queue, bool enable)
+{
+	if (enable) {
+		set_bit(queue, dim_en);
+		return;
+	}
+
+	/* A pending update must not override the values set below */
+	if (test_and_clear_bit(queue, dim_en))
+		cancel_work_sync(&dim->work);
+}
+
 static int __stmmac_set_coalesce(struct net_device *dev,
 				 struct ethtool_coalesce *ec,
 				 int queue)
@@ -928,6 +917,33 @@ static int __stmmac_set_coalesce(struct net_device *dev,
 	else if (queue >= max_cnt)
 		return -EINVAL;
 
+	if (ec->use_adaptive_rx_coalesce && !priv->use_riwt)
+		return -EOPNOTSUPP;
+
+	if (all_queues) {
+		int i;
+
+		for (i = 0; i < rx_cnt; i++)
+			stmmac_set_adaptive_coal(priv->rx_dim_en,
+						 &priv->channel[i].rx_dim, i,
+						 ec->use_adaptive_rx_coalesce);
+		for (i = 0; i < tx_cnt; i++)
+			stmmac_set_adaptive_coal(priv->tx_dim_en,
+						 &priv->channel[i].tx_dim, i,
+						 ec->use_adaptive_tx_coalesce);
+	} else {
+		if (queue < rx_cnt)
+			stmmac_set_adaptive_coal(priv->rx_dim_en,
+						 &priv->channel[queue].rx_dim,
+						 queue,
+						 ec->use_adaptive_rx_coalesce);
+		if (queue < tx_cnt)
+			stmmac_set_adaptive_coal(priv->tx_dim_en,
+						 &priv->channel[queue].tx_dim,
+						 queue,
+						 ec->use_adaptive_tx_coalesce);
+	}
+
 	if (priv->use_riwt && (ec->rx_coalesce_usecs > 0)) {
 		rx_riwt = stmmac_usec2riwt(ec->rx_coalesce_usecs, priv);
 
@@ -994,15 +1010,184 @@ static int stmmac_set_per_queue_coalesce(struct net_device *dev, u32 queue,
 	return __stmmac_set_coalesce(dev, ec, queue);
 }
 
+/* ntuple rules share the L3/L4 filters of the tc flower offload. TCP and
+ * UDP rules match one full source or destination port, plus optional full
+ * IPv4 addresses, IP rules only the addresses. Matching frames are steered
+ * to the DMA channel of the rule's rx queue, or dropped.
+ */
+static int stmmac_ntuple_config(struct stmmac_priv *priv,
+				struct stmmac_flow_entry *entry,
+				struct ethtool_rx_flow_spec *fs)
+{
+	struct ethtool_tcpip4_spec *l4 = NULL, *l4_mask = NULL;
+	struct ethtool_usrip4_spec *ip = NULL, *ip_mask = NULL;
+	__be32 src, dst, src_mask, dst_mask;
+	bool inv = false, udp = false;
+	u32 queue = 0;
+	int ret;
+
+	switch (fs->flow_type) {
+	case UDP_V4_FLOW:
+		udp = true;
+		fallthrough;
+	case TCP_V4_FLOW:
+		l4 = &fs->h_u.tcp_ip4_spec;
+		l4_mask = &fs->m_u.tcp_ip4_spec;
+		if (l4_mask->tos || !!l4_mask->psrc == !!l4_mask->pdst)
+			return -EOPNOTSUPP;
+		if ((l4_mask->psrc && l4_mask->psrc != htons(0xffff)) ||
+		    (l4_mask->pdst && l4_mask->pdst != htons(0xffff)))
+			return -EOPNOTSUPP;
+		src = l4->ip4src;
+		dst = l4->ip4dst;
+		src_mask = l4_mask->ip4src;
+		dst_mask = l4_mask->ip4dst;
+		break;
+	case IP_USER_FLOW:
+		ip = &fs->h_u.usr_ip4_spec;
+		ip_mask = &fs->m_u.usr_ip4_spec;
+		if (ip_mask->l4_4_bytes || ip_mask->tos || ip_mask->proto ||
+		    (!ip_mask->ip4src && !ip_mask->ip4dst))
+			return -EOPNOTSUPP;
+		src = ip->ip4src;
+		dst = ip->ip4dst;
+		src_mask = ip_mask->ip4src;
+		dst_mask = ip_mask->ip4dst;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	if ((src_mask && src_mask != htonl(~0)) ||
+	    (dst_mask && dst_mask != htonl(~0)))
+		return -EOPNOTSUPP;
+
+	if (fs->ring_cookie == RX_CLS_FLOW_DISC) {
+		inv = true;
+	} else {
+		if (ethtool_get_flow_spec_ring_vf(fs->ring_cookie))
+			return -EOPNOTSUPP;
+		queue = ethtool_get_flow_spec_ring(fs->ring_cookie);
+		if (queue >= priv->plat->rx_queues_to_use)
+			return -EINVAL;
+	}
+
+	if (src_mask) {
+		ret = stmmac_config_l3_filter(priv, priv->hw, entry->idx, true,
+					      false, true, inv, ntohl(src));
+		if (ret)
+			return ret;
+	}
+	if (dst_mask) {
+		ret = stmmac_config_l3_filter(priv, priv->hw, entry->idx, true,
+					      false, false, inv, ntohl(dst));
+		if (ret)
+			return ret;
+	}
+	if (l4) {
+		entry->is_l4 = true;
+		ret = stmmac_config_l4_filter(priv, priv->hw, entry->idx, true,
+					      udp, !!l4_mask->psrc, inv,
+					      l4_mask->psrc ? ntohs(l4->psrc) :
+							      ntohs(l4->pdst));
+		if (ret)
+			return ret;
+	}
+
+	if (inv) {
+		entry->action = STMMAC_FLOW_ACTION_DROP;
+		return 0;
+	}
+
+	entry->action = STMMAC_FLOW_ACTION_QUEUE;
+	entry->queue = queue;
+
+	return stmmac_config_l3l4_dma(priv, priv->hw, entry->idx, true,
+				      priv->plat->rx_queues_cfg[queue].chan);
+}
+
+static int stmmac_add_ntuple(struct stmmac_priv *priv,
+			     struct ethtool_rx_flow_spec *fs)
+{
+	struct stmmac_flow_entry *entry;
+	int ret;
+
+	if (fs->location >= priv->flow_entries_max)
+		return -EINVAL;
+
+	entry = &priv->flow_entries[fs->location];
+	if (entry->in_use && !entry->is_ntuple)
+		return -EBUSY;
+	if (entry->in_use)
+		stmmac_flow_entry_del(priv, entry);
+
+	ret = stmmac_ntuple_config(priv, entry, fs);
+	if (ret) {
+		stmmac_flow_entry_del(priv, entry);
+		return ret;
+	}
+
+	entry->in_use = true;
+	entry->is_ntuple = true;
+	entry->fs = *fs;
+
+	return 0;
+}
+
+static int stmmac_del_ntuple(struct stmmac_priv *priv, u32 location)
+{
+	struct stmmac_flow_entry *entry;
+
+	if (location >= priv->flow_entries_max)
+		return -EINVAL;
+
+	entry = &priv->flow_entries[location];
+	if (!entry->in_use || !entry->is_ntuple)
+		return -ENOENT;
+
+	return stmmac_flow_entry_del(priv, entry);
+}
+
 static int stmmac_get_rxnfc(struct net_device *dev,
 			    struct ethtool_rxnfc *rxnfc, u32 *rule_locs)
 {
 	struct stmmac_priv *priv = netdev_priv(dev);
+	struct stmmac_flow_entry *entry;
+	u32 i, cnt = 0;
 
 	switch (rxnfc->cmd) {
 	case ETHTOOL_GRXRINGS:
 		rxnfc->data = priv->plat->rx_queues_to_use;
 		break;
+	case ETHTOOL_GRXCLSRLCNT:
+		if (!priv->flow_entries_max)
+			return -EOPNOTSUPP;
+		for (i = 0; i < priv->flow_entries_max; i++)
+			cnt += priv->flow_entries[i].is_ntuple;
+		rxnfc->rule_cnt = cnt;
+		rxnfc->data = priv->flow_entries_max;
+		break;
+	case ETHTOOL_GRXCLSRULE:
+		if (rxnfc->fs.location >= priv->flow_entries_max)
+			return -EINVAL;
+		entry = &priv->flow_entries[rxnfc->fs.location];
+		if (!entry->is_ntuple)
+			return -ENOENT;
+		rxnfc->fs = entry->fs;
+		break;
+	case ETHTOOL_GRXCLSRLALL:
+		if (!priv->flow_entries_max)
+			return -EOPNOTSUPP;
+		for (i = 0; i < priv->flow_entries_max; i++) {
+			if (!priv->flow_entries[i].is_ntuple)
+				continue;
+			if (cnt == rxnfc->rule_cnt)
+				return -EMSGSIZE;
+			rule_locs[cnt++] = i;
+		}
+		rxnfc->rule_cnt = cnt;
+		rxnfc->data = priv->flow_entries_max;
+		break;
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -1010,6 +1195,23 @@ static int stmmac_get_rxnfc(struct net_device *dev,
 	return 0;
 }
 
+static int stmmac_set_rxnfc(struct net_device *dev, struct ethtool_rxnfc *rxnfc)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+
+	if (!priv->flow_entries_max)
+		return -EOPNOTSUPP;
+
+	switch (rxnfc->cmd) {
+	case ETHTOOL_SRXCLSRLINS:
+		return stmmac_add_ntuple(priv, &rxnfc->fs);
+	case ETHTOOL_SRXCLSRLDEL:
+		return stmmac_del_ntuple(priv, rxnfc->fs.location);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static u32 stmmac_get_rxfh_key_size(struct net_device *dev)
 {
 	struct stmmac_priv *priv = netdev_priv(dev);
@@ -1162,7 +1364,8 @@ static int stmmac_set_tunable(struct net_device *dev,
 
 static const struct ethtool_ops stmmac_ethtool_ops = {
 	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
-				     ETHTOOL_COALESCE_MAX_FRAMES,
+				     ETHTOOL_COALESCE_MAX_FRAMES |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE,
 	.begin = stmmac_check_if_running,
 	.get_drvinfo = stmmac_ethtool_getdrvinfo,
 	.get_msglevel = stmmac_ethtool_getmsglevel,
@@ -1184,6 +1387,7 @@ static const struct ethtool_ops stmmac_ethtool_ops = {
 	.set_eee = stmmac_ethtool_op_set_eee,
 	.get_sset_count	= stmmac_get_sset_count,
 	.get_rxnfc = stmmac_get_rxnfc,
+	.set_rxnfc = stmmac_set_rxnfc,
 	.get_rxfh_key_size = stmmac_get_rxfh_key_size,
 	.get_rxfh_indir_size = stmmac_get_rxfh_indir_size,
 	.get_rxfh = stmmac_get_rxfh,
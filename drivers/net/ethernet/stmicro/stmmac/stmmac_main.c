@@ -2027,8 +2027,10 @@ static int __alloc_dma_rx_desc_resources(struct stmmac_priv *priv,
 	rx_q->priv_data = priv;
 
 	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
-	pp_params.pool_size = dma_conf->dma_rx_size;
+	/* With split header every descriptor holds a second, payload page */
+	pp_params.pool_size = dma_conf->dma_rx_size * (priv->sph ? 2 : 1);
 	num_pages = DIV_ROUND_UP(dma_conf->dma_buf_sz, PAGE_SIZE);
+	rx_q->napi_skb_frag_size = num_pages * PAGE_SIZE;
 	pp_params.order = ilog2(num_pages);
 	pp_params.nid = dev_to_node(priv->device);
 	pp_params.dev = priv->device;
@@ -2664,6 +2666,7 @@ static int stmmac_tx_clean(struct stmmac_priv *priv, int budget, u32 queue)
 
 	netdev_tx_completed_queue(netdev_get_tx_queue(priv->dev, queue),
 				  pkts_compl, bytes_compl);
+	priv->channel[queue].tx_dim_bytes += bytes_compl;
 
 	if (unlikely(netif_tx_queue_stopped(netdev_get_tx_queue(priv->dev,
 								queue))) &&
@@ -3028,6 +3031,122 @@ static enum hrtimer_restart stmmac_tx_timer(struct hrtimer *t)
 	return HRTIMER_NORESTART;
 }
 
+u32 stmmac_usec2riwt(u32 usec, struct stmmac_priv *priv)
+{
+	unsigned long clk = clk_get_rate(priv->plat->stmmac_clk);
+
+	if (!clk) {
+		clk = priv->plat->clk_ref_rate;
+		if (!clk)
+			return 0;
+	}
+
+	return (usec * (clk / 1000000)) / 256;
+}
+
+u32 stmmac_riwt2usec(u32 riwt, struct stmmac_priv *priv)
+{
+	unsigned long clk = clk_get_rate(priv->plat->stmmac_clk);
+
+	if (!clk) {
+		clk = priv->plat->clk_ref_rate;
+		if (!clk)
+			return 0;
+	}
+
+	return (riwt * 256) / (clk / 1000000);
+}
+
+
+static void stmmac_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct stmmac_channel *ch =
+		container_of(dim, struct stmmac_channel, rx_dim);
+	struct stmmac_priv *priv = ch->priv_data;
+	struct dim_cq_moder moder;
+	u32 queue = ch->index;
+	u32 riwt;
+
+	moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+
+	riwt = stmmac_usec2riwt(moder.usec, priv);
+	riwt = clamp_t(u32, riwt, MIN_DMA_RIWT, MAX_DMA_RIWT);
+
+	priv->rx_riwt[queue] = riwt;
+	priv->rx_coal_frames[queue] = min_t(u32, moder.pkts,
+					    priv->dma_conf.dma_rx_size / 4);
+	stmmac_rx_watchdog(priv, priv->ioaddr, riwt, queue);
+
+	dim->state = DIM_START_MEASURE;
+}
+
+static void stmmac_tx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct stmmac_channel *ch =
+		container_of(dim, struct stmmac_channel, tx_dim);
+	struct stmmac_priv *priv = ch->priv_data;
+	struct dim_cq_moder moder;
+	u32 queue = ch->index;
+
+	moder = net_dim_get_tx_moderation(dim->mode, dim->profile_ix);
+
+	priv->tx_coal_timer[queue] = clamp_t(u32, moder.usec, 1,
+					     STMMAC_MAX_COAL_TX_TICK);
+	priv->tx_coal_frames[queue] = clamp_t(u32, moder.pkts, 1,
+					      STMMAC_TX_MAX_FRAMES);
+
+	dim->state = DIM_START_MEASURE;
+}
+
+/**
+ * stmmac_rx_dim_update - feed the RX moderation state machine
+ * @priv: driver private structure
+ * @ch: channel whose NAPI poll just completed
+ * Description: called once per completed RX poll, i.e. once per RX
+ * interrupt. net_dim() looks at the packet and byte rate since the last
+ * sample and schedules stmmac_rx_dim_work() to move the RIWT and frame
+ * threshold of the queue up or down the profile table.
+ */
+static void stmmac_rx_dim_update(struct stmmac_priv *priv,
+				 struct stmmac_channel *ch)
+{
+	struct dim_sample sample = {};
+
+	if (!test_bit(ch->index, priv->rx_dim_en))
+		return;
+
+	dim_update_sample(ch->rx_dim_events++,
+			  priv->xstats.rxq_stats[ch->index].rx_pkt_n,
+			  ch->rx_dim_bytes, &sample);
+	net_dim(&ch->rx_dim, sample);
+}
+
+static void stmmac_tx_dim_update(struct stmmac_priv *priv,
+				 struct stmmac_channel *ch)
+{
+	struct dim_sample sample = {};
+
+	if (!test_bit(ch->index, priv->tx_dim_en))
+		return;
+
+	dim_update_sample(ch->tx_dim_events++,
+			  priv->xstats.txq_stats[ch->index].tx_pkt_n,
+			  ch->tx_dim_bytes, &sample);
+	net_dim(&ch->tx_dim, sample);
+}
+
+static void stmmac_dim_cancel(struct stmmac_priv *priv)
+{
+	u32 chan;
+
+	for (chan = 0; chan < priv->plat->rx_queues_to_use; chan++)
+		cancel_work_sync(&priv->channel[chan].rx_dim.work);
+	for (chan = 0; chan < priv->plat->tx_queues_to_use; chan++)
+		cancel_work_sync(&priv->channel[chan].tx_dim.work);
+}
+
 /**
  * stmmac_init_coalesce - init mitigation options.
  * @priv: driver private structure
@@ -3378,6 +3497,10 @@ static int stmmac_hw_setup(struct net_device *dev, bool ptp_register)
 	else if (ptp_register)
 		stmmac_ptp_register(priv);
 
+	/* The MAC reset dropped the gate control list and the PTP time */
+	if (!ret && priv->plat->est && priv->plat->est->enable)
+		stmmac_est_rebase(priv);
+
 	priv->eee_tw_timer = STMMAC_DEFAULT_TWT_LS;
 
 	/* Convert the timer from msec to usec */
@@ -3509,11 +3632,16 @@ static void stmmac_free_irq(struct net_device *dev,
 	}
 }
 
+/* RX and TX vector i share a CPU so the channel's NAPI instances stay local */
+static unsigned int stmmac_queue_cpu(struct stmmac_priv *priv, int queue)
+{
+	return cpumask_local_spread(queue, dev_to_node(priv->device));
+}
+
 static int stmmac_request_irq_multi_msi(struct net_device *dev)
 {
 	struct stmmac_priv *priv = netdev_priv(dev);
 	enum request_irq_err irq_err;
-	cpumask_t cpu_mask;
 	int irq_idx = 0;
 	char *int_name;
 	int ret;
@@ -3625,9 +3753,8 @@ static int stmmac_request_irq_multi_msi(struct net_device *dev)
 			irq_idx = i;
 			goto irq_error;
 		}
-		cpumask_clear(&cpu_mask);
-		cpumask_set_cpu(i % num_online_cpus(), &cpu_mask);
-		irq_set_affinity_hint(priv->rx_irq[i], &cpu_mask);
+		irq_set_affinity_hint(priv->rx_irq[i],
+				      cpumask_of(stmmac_queue_cpu(priv, i)));
 	}
 
 	/* Request Tx MSI irq */
@@ -3650,9 +3777,8 @@ static int stmmac_request_irq_multi_msi(struct net_device *dev)
 			irq_idx = i;
 			goto irq_error;
 		}
-		cpumask_clear(&cpu_mask);
-		cpumask_set_cpu(i % num_online_cpus(), &cpu_mask);
-		irq_set_affinity_hint(priv->tx_irq[i], &cpu_mask);
+		irq_set_affinity_hint(priv->tx_irq[i],
+				      cpumask_of(stmmac_queue_cpu(priv, i)));
 	}
 
 	return 0;
@@ -3945,6 +4071,7 @@ static int stmmac_release(struct net_device *dev)
 		priv->plat->integrated_phy_power(priv->plat->bsp_priv, false);
 
 	stmmac_disable_all_queues(priv);
+	stmmac_dim_cancel(priv);
 
 	for (chan = 0; chan < priv->plat->tx_queues_to_use; chan++)
 		hrtimer_cancel(&priv->dma_conf.tx_queue[chan].txtimer);
@@ -5197,6 +5324,18 @@ static int stmmac_rx_zc(struct stmmac_priv *priv, int limit, u32 queue)
 	return failure ? limit : (int)count;
 }
 
+/* The first buffer can become the skb head if skb_shared_info still fits
+ * behind the frame, which is always true for a split-header buffer and for
+ * MTU-sized frames. Jumbo frames filling the whole buffer are copied.
+ */
+static bool stmmac_rx_can_build_skb(struct stmmac_rx_queue *rx_q,
+				    struct xdp_buff *xdp)
+{
+	return xdp->data_end - xdp->data_hard_start +
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) <=
+	       rx_q->napi_skb_frag_size;
+}
+
 /**
  * stmmac_rx - manage the receive process
  * @priv: driver private structure
@@ -5387,20 +5526,39 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 			/* XDP program may expand or reduce tail */
 			buf1_len = xdp.data_end - xdp.data;
 
-			skb = napi_alloc_skb(&ch->rx_napi, buf1_len);
-			if (!skb) {
-				priv->dev->stats.rx_dropped++;
-				count++;
-				goto drain_data;
-			}
+			if (stmmac_rx_can_build_skb(rx_q, &xdp)) {
+				skb = napi_build_skb(xdp.data_hard_start,
+						     rx_q->napi_skb_frag_size);
+				if (!skb) {
+					page_pool_recycle_direct(rx_q->page_pool,
+								 buf->page);
+					buf->page = NULL;
+					priv->dev->stats.rx_dropped++;
+					count++;
+					goto drain_data;
+				}
 
-			/* XDP program may adjust header */
-			skb_copy_to_linear_data(skb, xdp.data, buf1_len);
-			skb_put(skb, buf1_len);
+				/* XDP program may adjust header */
+				skb_reserve(skb, xdp.data - xdp.data_hard_start);
+				skb_put(skb, buf1_len);
+				skb_mark_for_recycle(skb);
+				buf->page = NULL;
+			} else {
+				skb = napi_alloc_skb(&ch->rx_napi, buf1_len);
+				if (!skb) {
+					priv->dev->stats.rx_dropped++;
+					count++;
+					goto drain_data;
+				}
 
-			/* Data payload copied into SKB, page ready for recycle */
-			page_pool_recycle_direct(rx_q->page_pool, buf->page);
-			buf->page = NULL;
+				/* XDP program may adjust header */
+				skb_copy_to_linear_data(skb, xdp.data, buf1_len);
+				skb_put(skb, buf1_len);
+
+				/* Data payload copied into SKB, page ready for recycle */
+				page_pool_recycle_direct(rx_q->page_pool, buf->page);
+				buf->page = NULL;
+			}
 		} else if (buf1_len) {
 			dma_sync_single_for_cpu(priv->device, buf->addr,
 						buf1_len, dma_dir);
@@ -5408,8 +5566,8 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					buf->page, buf->page_offset, buf1_len,
 					priv->dma_conf.dma_buf_sz);
 
-			/* Data payload appended into SKB */
-			page_pool_release_page(rx_q->page_pool, buf->page);
+			/* Data payload appended into SKB, recycled on free */
+			skb_mark_for_recycle(skb);
 			buf->page = NULL;
 		}
 
@@ -5420,8 +5578,8 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 					buf->sec_page, 0, buf2_len,
 					priv->dma_conf.dma_buf_sz);
 
-			/* Data payload appended into SKB */
-			page_pool_release_page(rx_q->page_pool, buf->sec_page);
+			/* Data payload appended into SKB, recycled on free */
+			skb_mark_for_recycle(skb);
 			buf->sec_page = NULL;
 		}
 
@@ -5451,6 +5609,7 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit, u32 queue)
 
 		priv->dev->stats.rx_packets++;
 		priv->dev->stats.rx_bytes += len;
+		ch->rx_dim_bytes += len;
 		count++;
 	}
 
@@ -5485,6 +5644,8 @@ static int stmmac_napi_poll_rx(struct napi_struct *napi, int budget)
 	if (work_done < budget && napi_complete_done(napi, work_done)) {
 		unsigned long flags;
 
+		stmmac_rx_dim_update(priv, ch);
+
 		spin_lock_irqsave(&ch->lock, flags);
 		stmmac_enable_dma_irq(priv, priv->ioaddr, chan, 1, 0);
 		spin_unlock_irqrestore(&ch->lock, flags);
@@ -5509,6 +5670,8 @@ static int stmmac_napi_poll_tx(struct napi_struct *napi, int budget)
 	if (work_done < budget && napi_complete_done(napi, work_done)) {
 		unsigned long flags;
 
+		stmmac_tx_dim_update(priv, ch);
+
 		spin_lock_irqsave(&ch->lock, flags);
 		stmmac_enable_dma_irq(priv, priv->ioaddr, chan, 0, 1);
 		spin_unlock_irqrestore(&ch->lock, flags);
@@ -5998,6 +6161,29 @@ static int stmmac_ioctl(struct net_device *dev, struct ifreq *rq, int cmd)
 	return ret;
 }
 
+/* Release an L3/L4 flow entry of the tc flower or ethtool ntuple offload */
+int stmmac_flow_entry_del(struct stmmac_priv *priv,
+			  struct stmmac_flow_entry *entry)
+{
+	int ret;
+
+	/* clearing the filter control also clears the dma channel routing */
+	if (entry->is_l4) {
+		ret = stmmac_config_l4_filter(priv, priv->hw, entry->idx, false,
+					      false, false, false, 0);
+	} else {
+		ret = stmmac_config_l3_filter(priv, priv->hw, entry->idx, false,
+					      false, false, false, 0);
+	}
+
+	entry->in_use = false;
+	entry->cookie = 0;
+	entry->is_l4 = false;
+	entry->is_ntuple = false;
+	entry->action = 0;
+	return ret;
+}
+
 static int stmmac_setup_tc_block_cb(enum tc_setup_type type, void *type_data,
 				    void *cb_priv)
 {
@@ -6615,6 +6801,7 @@ void stmmac_xdp_release(struct net_device *dev)
 
 	/* Disable NAPI process */
 	stmmac_disable_all_queues(priv);
+	stmmac_dim_cancel(priv);
 
 	for (chan = 0; chan < priv->plat->tx_queues_to_use; chan++)
 		hrtimer_cancel(&priv->dma_conf.tx_queue[chan].txtimer);
@@ -6937,6 +7124,13 @@ static int stmmac_hw_init(struct stmmac_priv *priv)
 			 "Enable RX Mitigation via HW Watchdog Timer\n");
 	}
 
+	/* Let net_dim pick the coalesce values; ethtool can turn it off */
+	if (priv->plat->dim_en) {
+		if (priv->use_riwt)
+			bitmap_fill(priv->rx_dim_en, MTL_MAX_RX_QUEUES);
+		bitmap_fill(priv->tx_dim_en, MTL_MAX_TX_QUEUES);
+	}
+
 	return 0;
 }
 
@@ -6960,6 +7154,10 @@ static void stmmac_napi_add(struct net_device *dev)
 		ch->priv_data = priv;
 		ch->index = queue;
 		spin_lock_init(&ch->lock);
+		INIT_WORK(&ch->rx_dim.work, stmmac_rx_dim_work);
+		ch->rx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+		INIT_WORK(&ch->tx_dim.work, stmmac_tx_dim_work);
+		ch->tx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
 
 		if (queue < priv->plat->rx_queues_to_use) {
 			netif_napi_add_weight(dev, &ch->rx_napi,
@@ -7590,6 +7788,7 @@ int stmmac_suspend(struct device *dev)
 	netif_device_detach(ndev);
 
 	stmmac_disable_all_queues(priv);
+	stmmac_dim_cancel(priv);
 
 	for (chan = 0; chan < priv->plat->tx_queues_to_use; chan++)
 		hrtimer_cancel(&priv->dma_conf.tx_queue[chan].txtimer);
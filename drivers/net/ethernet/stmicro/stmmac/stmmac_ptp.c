@@ -46,6 +46,65 @@ static int stmmac_adjust_freq(struct ptp_clock_info *ptp, s32 ppb)
 	return 0;
 }
 
+/**
+ * stmmac_est_stop - disable EST ahead of a step of the PTP time
+ * @priv: driver private structure
+ * Description: returns true if EST was running and stmmac_est_rebase()
+ * has to be called once the new time is set.
+ */
+bool stmmac_est_stop(struct stmmac_priv *priv)
+{
+	if (!priv->plat->est || !priv->plat->est->enable)
+		return false;
+
+	mutex_lock(&priv->plat->est->lock);
+	priv->plat->est->enable = false;
+	stmmac_est_configure(priv, priv->ioaddr, priv->plat->est,
+			     priv->plat->clk_ptp_rate);
+	mutex_unlock(&priv->plat->est->lock);
+
+	return true;
+}
+
+/**
+ * stmmac_est_rebase - restart EST on the current PTP time
+ * @priv: driver private structure
+ * Description: the gate control list runs off the PTP clock, so the
+ * programmed base time is stale after the clock was stepped or the MAC
+ * was reset. Derive the next cycle start from the base time requested by
+ * taprio and reprogram EST.
+ */
+int stmmac_est_rebase(struct stmmac_priv *priv)
+{
+	struct timespec64 current_time, time;
+	ktime_t current_time_ns, basetime;
+	u64 cycle_time;
+	int ret;
+
+	mutex_lock(&priv->plat->est->lock);
+	priv->ptp_clock_ops.gettime64(&priv->ptp_clock_ops, &current_time);
+	current_time_ns = timespec64_to_ktime(current_time);
+	time.tv_nsec = priv->plat->est->btr_reserve[0];
+	time.tv_sec = priv->plat->est->btr_reserve[1];
+	basetime = timespec64_to_ktime(time);
+	cycle_time = (u64)priv->plat->est->ctr[1] * NSEC_PER_SEC +
+		     priv->plat->est->ctr[0];
+	time = stmmac_calc_tas_basetime(basetime,
+					current_time_ns,
+					cycle_time);
+
+	priv->plat->est->btr[0] = (u32)time.tv_nsec;
+	priv->plat->est->btr[1] = (u32)time.tv_sec;
+	priv->plat->est->enable = true;
+	ret = stmmac_est_configure(priv, priv->ioaddr, priv->plat->est,
+				   priv->plat->clk_ptp_rate);
+	mutex_unlock(&priv->plat->est->lock);
+	if (ret)
+		netdev_err(priv->dev, "failed to configure EST\n");
+
+	return ret;
+}
+
 /**
  * stmmac_adjust_time
  *
@@ -62,8 +121,7 @@ static int stmmac_adjust_time(struct ptp_clock_info *ptp, s64 delta)
 	u32 sec, nsec;
 	u32 quotient, reminder;
 	int neg_adj = 0;
-	bool xmac, est_rst = false;
-	int ret;
+	bool xmac, est_rst;
 
 	xmac = priv->plat->has_gmac4 || priv->plat->has_xgmac;
 
@@ -77,46 +135,15 @@ static int stmmac_adjust_time(struct ptp_clock_info *ptp, s64 delta)
 	nsec = reminder;
 
 	/* If EST is enabled, disabled it before adjust ptp time. */
-	if (priv->plat->est && priv->plat->est->enable) {
-		est_rst = true;
-		mutex_lock(&priv->plat->est->lock);
-		priv->plat->est->enable = false;
-		stmmac_est_configure(priv, priv->ioaddr, priv->plat->est,
-				     priv->plat->clk_ptp_rate);
-		mutex_unlock(&priv->plat->est->lock);
-	}
+	est_rst = stmmac_est_stop(priv);
 
 	write_lock_irqsave(&priv->ptp_lock, flags);
 	stmmac_adjust_systime(priv, priv->ptpaddr, sec, nsec, neg_adj, xmac);
 	write_unlock_irqrestore(&priv->ptp_lock, flags);
 
 	/* Caculate new basetime and re-configured EST after PTP time adjust. */
-	if (est_rst) {
-		struct timespec64 current_time, time;
-		ktime_t current_time_ns, basetime;
-		u64 cycle_time;
-
-		mutex_lock(&priv->plat->est->lock);
-		priv->ptp_clock_ops.gettime64(&priv->ptp_clock_ops, &current_time);
-		current_time_ns = timespec64_to_ktime(current_time);
-		time.tv_nsec = priv->plat->est->btr_reserve[0];
-		time.tv_sec = priv->plat->est->btr_reserve[1];
-		basetime = timespec64_to_ktime(time);
-		cycle_time = (u64)priv->plat->est->ctr[1] * NSEC_PER_SEC +
-			     priv->plat->est->ctr[0];
-		time = stmmac_calc_tas_basetime(basetime,
-						current_time_ns,
-						cycle_time);
-
-		priv->plat->est->btr[0] = (u32)time.tv_nsec;
-		priv->plat->est->btr[1] = (u32)time.tv_sec;
-		priv->plat->est->enable = true;
-		ret = stmmac_est_configure(priv, priv->ioaddr, priv->plat->est,
-					   priv->plat->clk_ptp_rate);
-		mutex_unlock(&priv->plat->est->lock);
-		if (ret)
-			netdev_err(priv->dev, "failed to configure EST\n");
-	}
+	if (est_rst)
+		stmmac_est_rebase(priv);
 
 	return 0;
 }
@@ -161,11 +188,18 @@ static int stmmac_set_time(struct ptp_clock_info *ptp,
 	struct stmmac_priv *priv =
 	    container_of(ptp, struct stmmac_priv, ptp_clock_ops);
 	unsigned long flags;
+	bool est_rst;
+
+	/* Same as stmmac_adjust_time(): a step moves the gate schedule */
+	est_rst = stmmac_est_stop(priv);
 
 	write_lock_irqsave(&priv->ptp_lock, flags);
 	stmmac_init_systime(priv, priv->ptpaddr, ts->tv_sec, ts->tv_nsec);
 	write_unlock_irqrestore(&priv->ptp_lock, flags);
 
+	if (est_rst)
+		stmmac_est_rebase(priv);
+
 	return 0;
 }
 
@@ -444,6 +444,14 @@ static int tc_parse_flow_actions(struct stmmac_priv *priv,
 		case FLOW_ACTION_DROP:
 			entry->action |= STMMAC_FLOW_ACTION_DROP;
 			return 0;
+		case FLOW_ACTION_RX_QUEUE_MAPPING:
+			if (act->rx_queue >= priv->plat->rx_queues_to_use) {
+				NL_SET_ERR_MSG_MOD(extack, "Invalid rx queue");
+				return -EINVAL;
+			}
+			entry->action |= STMMAC_FLOW_ACTION_QUEUE;
+			entry->queue = act->rx_queue;
+			return 0;
 		default:
 			break;
 		}
@@ -611,6 +619,15 @@ static int tc_add_flow(struct stmmac_priv *priv,
 	if (!entry->in_use)
 		return -EINVAL;
 
+	if (entry->action & STMMAC_FLOW_ACTION_QUEUE) {
+		ret = stmmac_config_l3l4_dma(priv, priv->hw, entry->idx, true,
+					     priv->plat->rx_queues_cfg[entry->queue].chan);
+		if (ret) {
+			stmmac_flow_entry_del(priv, entry);
+			return ret;
+		}
+	}
+
 	entry->cookie = cls->cookie;
 	return 0;
 }
@@ -619,23 +636,11 @@ static int tc_del_flow(struct stmmac_priv *priv,
 		       struct flow_cls_offload *cls)
 {
 	struct stmmac_flow_entry *entry = tc_find_flow(priv, cls, false);
-	int ret;
 
-	if (!entry || !entry->in_use)
+	if (!entry || !entry->in_use || entry->is_ntuple)
 		return -ENOENT;
 
-	if (entry->is_l4) {
-		ret = stmmac_config_l4_filter(priv, priv->hw, entry->idx, false,
-					      false, false, false, 0);
-	} else {
-		ret = stmmac_config_l3_filter(priv, priv->hw, entry->idx, false,
-					      false, false, false, 0);
-	}
-
-	entry->in_use = false;
-	entry->cookie = 0;
-	entry->is_l4 = false;
-	return ret;
+	return stmmac_flow_entry_del(priv, entry);
 }
 
 static struct stmmac_rfs_entry *tc_find_rfs(struct stmmac_priv *priv,
@@ -929,6 +934,12 @@ static int tc_setup_taprio(struct stmmac_priv *priv,
 	if (!priv->dma_cap.estsel)
 		return -EOPNOTSUPP;
 
+	/* The schedule is programmed against the PTP time */
+	if (!priv->ptp_clock_ops.gettime64) {
+		netdev_err(priv->dev, "EST needs the PTP clock\n");
+		return -EOPNOTSUPP;
+	}
+
 	switch (wid) {
 	case 0x1:
 		wid = 16;
@@ -4661,7 +4661,7 @@ int dhd_os_send_alert_message(dhd_pub_t *dhdp);
 
 #ifdef RX_PKT_POOL
 #define MAX_RX_PKT_POOL	(1024)
-void dhd_rx_pktpool_create(struct dhd_info *dhd, uint16 len);
+void dhd_rx_pktpool_create(struct dhd_info *dhd, uint16 len, uint16 ring_sz);
 void * BCMFASTPATH(dhd_rxpool_pktget)(osl_t *osh, struct dhd_info *dhd, uint16 len);
 #endif /* RX_PKT_POOL */
 
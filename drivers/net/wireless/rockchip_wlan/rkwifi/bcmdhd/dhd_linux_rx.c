@@ -1654,10 +1654,13 @@ dhd_rx_pktpool_thread(void *data)
 }
 
 void
-dhd_rx_pktpool_create(dhd_info_t *dhd, uint16 rxbuf_sz)
+dhd_rx_pktpool_create(dhd_info_t *dhd, uint16 rxbuf_sz, uint16 ring_sz)
 {
 	pkt_pool_t *rx_pool = &dhd->rx_pkt_pool;
 	rx_pool->rxbuf_sz = rxbuf_sz;
+	/* Keep one full refill of the rxbuf post ring ready in the pool */
+	if (ring_sz > rx_pool->max_size)
+		rx_pool->max_size = MIN(ring_sz, MAX_RX_PKT_POOL * 8);
 	binary_sema_up(&dhd->rx_pktpool_thread);
 }
 
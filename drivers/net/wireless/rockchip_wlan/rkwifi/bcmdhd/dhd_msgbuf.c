@@ -5152,7 +5152,7 @@ int dhd_sync_with_dongle(dhd_pub_t *dhd)
 
 #ifdef RX_PKT_POOL
 	/* Rx pkt pool creation after rxbuf size is shared by dongle */
-	dhd_rx_pktpool_create(dhd->info, prot->rxbufpost_alloc_sz);
+	dhd_rx_pktpool_create(dhd->info, prot->rxbufpost_alloc_sz, prot->max_rxbufpost);
 #endif /* RX_PKT_POOL */
 
 	/* Post buffers for packet reception */
@@ -5482,6 +5482,13 @@ BCMFASTPATH(dhd_prot_rxbuf_post)(dhd_pub_t *dhd, uint16 count, bool use_rsv_pkti
 		*/
 		((p = dhd_rx_emerge_dequeue(dhd)) == NULL) &&
 #endif /* DHD_LB_RXP */
+#if defined(RX_PKT_POOL)
+		/* Then take a buffer the pool thread pre-allocated, so the rx
+		 * completion path does not pay for the skb allocation.
+		 */
+		((p = PKTGET_RX_POOL(dhd->osh, dhd->info,
+			prot->rxbufpost_alloc_sz, FALSE)) == NULL) &&
+#endif /* RX_PKT_POOL */
 			((p = PKTGET(dhd->osh, prot->rxbufpost_alloc_sz, FALSE)) == NULL)) {
 			dhd->rx_pktgetfail++;
 			DHD_ERROR_RLMT(("%s:%d: PKTGET for rxbuf failed, rx_pktget_fail :%lu\n",
@@ -3,7 +3,9 @@
  * Copyright (c) 2022 Rockchip Electronics Co., Ltd.
  */
 
+#include <linux/debugfs.h>
 #include <linux/init.h>
+#include <linux/kernel_stat.h>
 #include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
@@ -13,7 +15,12 @@
 #include <linux/sched.h>
 #include <linux/kthread.h>
 #include <linux/delay.h>
+#include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include <uapi/linux/rk-pcie-ep.h>
 
 #include "pcie-dw-dmatest.h"
 #include "../rockchip-pcie-dma.h"
@@ -53,7 +60,6 @@ MODULE_PARM_DESC(is_wired, "Transfer is triggered by wired DMA(default false)");
 #define PCIE_DW_MISC_DMATEST_DEV_MAX	1
 
 #define PCIE_DMA_CHANEL_MAX_NUM		2
-#define PCIE_DMA_LL_MAX_NUM		1024 /* Unrestricted, tentative value */
 
 struct pcie_dw_dmatest_dev {
 	struct dma_trx_obj *obj;
@@ -195,6 +201,112 @@ int rk_pcie_local_dma_tobus_block(struct dma_trx_obj *obj, u32 chn,
 	return ret;
 }
 
+static void rk_pcie_dma_write_lli(void __iomem *lli, u32 control, u32 size,
+				  u64 sar, u64 dar)
+{
+	SET_LL_32(lli + offsetof(struct rk_edma_lli, control), control);
+	SET_LL_32(lli + offsetof(struct rk_edma_lli, transfer_size), size);
+	SET_LL_64(lli + offsetof(struct rk_edma_lli, sar), sar);
+	SET_LL_64(lli + offsetof(struct rk_edma_lli, dar), dar);
+}
+
+/*
+ * Run @nr blocks as one linked-list chain on @chn, the engine only raises
+ * its done interrupt after the last element. @wired swaps the point of
+ * view as the block helpers do: the caller is the remote side driving
+ * the engine, so its "local" memory is the engine's bus side.
+ */
+static int rk_pcie_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr, bool wired,
+			    const struct pcie_ep_dma_block *blocks, u32 nr)
+{
+	struct pcie_dw_dmatest_dev *dmatest_dev = (struct pcie_dw_dmatest_dev *)obj->priv;
+	enum dma_dir dir = (wr ^ wired) ? DMA_TO_BUS : DMA_FROM_BUS;
+	struct completion *done;
+	struct dma_table *table;
+	struct mutex *lock;
+	void __iomem *ll;
+	phys_addr_t ll_phys;
+	u64 local, bus;
+	size_t off, total = 0;
+	long timeout;
+	u32 i;
+	int ret;
+
+	BUILD_BUG_ON(PCIE_DMA_LL_MAX_NUM * sizeof(struct rk_edma_lli) +
+		     sizeof(struct rk_edma_llp) > PCIE_DMA_LL_SLOT_SIZE);
+
+	if (chn >= PCIE_DMA_CHANEL_MAX_NUM || !nr || nr > PCIE_DMA_LL_MAX_NUM)
+		return -EINVAL;
+
+	off = ((dir == DMA_TO_BUS ? PCIE_DMA_CHANEL_MAX_NUM : 0) + chn) *
+	      PCIE_DMA_LL_SLOT_SIZE;
+	if (!obj->ll_base || off + PCIE_DMA_LL_SLOT_SIZE > obj->ll_size)
+		return -EOPNOTSUPP;
+
+	ll = obj->ll_base + off;
+	ll_phys = obj->ll_phys + off;
+
+	if (dir == DMA_FROM_BUS) {
+		lock = &dmatest_dev->rd_lock[chn];
+		table = &dmatest_dev->rd_tbl_buf[chn];
+		done = &dmatest_dev->rd_done[chn];
+	} else {
+		lock = &dmatest_dev->wr_lock[chn];
+		table = &dmatest_dev->wr_tbl_buf[chn];
+		done = &dmatest_dev->wr_done[chn];
+	}
+
+	mutex_lock(lock);
+
+	for (i = 0; i < nr; i++) {
+		local = wired ? blocks[i].bus_paddr : blocks[i].local_paddr;
+		bus = wired ? blocks[i].local_paddr : blocks[i].bus_paddr;
+		rk_pcie_dma_write_lli(ll + i * sizeof(struct rk_edma_lli),
+				      PCIE_DWC_DMA_CB | (i == nr - 1 ? PCIE_DWC_DMA_LIE : 0),
+				      blocks[i].size,
+				      dir == DMA_TO_BUS ? local : bus,
+				      dir == DMA_TO_BUS ? bus : local);
+		total += blocks[i].size;
+	}
+	/* The link element's cycle bit mismatches, which ends the chain */
+	ll += nr * sizeof(struct rk_edma_lli);
+	SET_LL_32(ll + offsetof(struct rk_edma_llp, control),
+		  PCIE_DWC_DMA_LLP | PCIE_DWC_DMA_TCB);
+	SET_LL_64(ll + offsetof(struct rk_edma_llp, llp), ll_phys);
+
+	memset(table, 0, sizeof(struct dma_table));
+	if (dmatest_dev->irq_en)
+		reinit_completion(done);
+
+	table->buf_size = total;
+	table->chn = chn;
+	table->dir = dir;
+	table->dma_mode = RK_PCIE_DMA_LL;
+	table->phys_descs = ll_phys;
+
+	obj->config_dma_func(table);
+	obj->start_dma_func(obj, table);
+
+	if (dmatest_dev->irq_en) {
+		/* 100MB/s for redundant calculate, as the polling path does */
+		timeout = max_t(long, HZ, usecs_to_jiffies(total / 100));
+		ret = wait_for_completion_interruptible_timeout(done, timeout);
+		if (ret < 0) {
+			dev_err(obj->dev, "%s interrupted\n", __func__);
+		} else if (ret == 0) {
+			dev_err(obj->dev, "%s timed out\n", __func__);
+			ret = -ETIMEDOUT;
+		} else {
+			ret = 0;
+		}
+	} else {
+		ret = rk_pcie_dma_wait_for_finished(obj, table);
+	}
+	mutex_unlock(lock);
+
+	return ret;
+}
+
 static int rk_pcie_dma_interrupt_handler_call_back(struct dma_trx_obj *obj, u32 chn, enum dma_dir dir)
 {
 	struct pcie_dw_dmatest_dev *dmatest_dev = (struct pcie_dw_dmatest_dev *)obj->priv;
@@ -210,6 +322,300 @@ static int rk_pcie_dma_interrupt_handler_call_back(struct dma_trx_obj *obj, u32
 	return 0;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Benchmark, driven through debugfs pcie_dw_dmatest/bench:
+ *
+ *   echo "<rd|wr|rw> <chn_mask> <min_size> <max_size> <loops>" > bench
+ *   cat bench
+ *
+ * Sizes double from min_size to max_size. The channels in chn_mask run
+ * concurrently, channel 1 offset by max_size like chn_en=3. Buffers are
+ * the bus_addr/local_addr parameters and their content is not checked.
+ */
+#define PCIE_DW_BENCH_HIST_NUM		16
+#define PCIE_DW_BENCH_RESULT_SIZE	(4 * PAGE_SIZE)
+
+struct pcie_dw_bench_chn {
+	struct pcie_dw_dmatest_dev *dmatest_dev;
+	struct completion done;
+	u32 chn;
+	u64 bus_paddr;
+	u64 local_paddr;
+	u32 size;
+	u32 loops;
+	bool rd;
+	bool wr;
+	int ret;
+	u32 nr;
+	u64 min_ns;
+	u64 max_ns;
+	u64 total_ns;
+	u32 hist[PCIE_DW_BENCH_HIST_NUM];	/* Bucket n: below 2^n us */
+};
+
+static struct dentry *s_dmatest_root;
+static DEFINE_MUTEX(s_bench_lock);
+static char *s_bench_result;
+static size_t s_bench_len;
+
+static int pcie_dw_bench_xfer(struct pcie_dw_bench_chn *bc, bool rd)
+{
+	struct dma_trx_obj *obj = bc->dmatest_dev->obj;
+	ktime_t start = ktime_get();
+	u64 ns;
+	int ret;
+
+	if (rd)
+		ret = is_wired ?
+		      pcie_dw_wired_dma_frombus_block(obj, bc->chn, bc->local_paddr, bc->bus_paddr, bc->size) :
+		      rk_pcie_local_dma_frombus_block(obj, bc->chn, bc->local_paddr, bc->bus_paddr, bc->size);
+	else
+		ret = is_wired ?
+		      pcie_dw_wired_dma_tobus_block(obj, bc->chn, bc->bus_paddr, bc->local_paddr, bc->size) :
+		      rk_pcie_local_dma_tobus_block(obj, bc->chn, bc->bus_paddr, bc->local_paddr, bc->size);
+	/* With irq_en the block helpers return the remaining jiffies */
+	if (ret < 0)
+		return ret;
+	if (!ret && bc->dmatest_dev->irq_en)
+		return -ETIMEDOUT;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bc->min_ns = min(bc->min_ns, ns);
+	bc->max_ns = max(bc->max_ns, ns);
+	bc->total_ns += ns;
+	bc->hist[min_t(u32, fls64(div_u64(ns, NSEC_PER_USEC)), PCIE_DW_BENCH_HIST_NUM - 1)]++;
+	bc->nr++;
+
+	return 0;
+}
+
+static int pcie_dw_bench_thread(void *p)
+{
+	struct pcie_dw_bench_chn *bc = p;
+	u32 i;
+
+	for (i = 0; i < bc->loops && !bc->ret; i++) {
+		if (bc->rd)
+			bc->ret = pcie_dw_bench_xfer(bc, true);
+		if (bc->wr && !bc->ret)
+			bc->ret = pcie_dw_bench_xfer(bc, false);
+	}
+	complete(&bc->done);
+
+	return 0;
+}
+
+/* Busy time over all online cpus, idle is derived from wall time */
+static u64 pcie_dw_bench_cpu_busy(void)
+{
+	struct kernel_cpustat kcs;
+	u64 busy = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		kcpustat_cpu_fetch(&kcs, cpu);
+		busy += kcs.cpustat[CPUTIME_USER] + kcs.cpustat[CPUTIME_NICE] +
+			kcs.cpustat[CPUTIME_SYSTEM] + kcs.cpustat[CPUTIME_IRQ] +
+			kcs.cpustat[CPUTIME_SOFTIRQ];
+	}
+
+	return busy;
+}
+
+static u32 pcie_dw_bench_percentile(u32 *hist, u32 nr, u32 pct)
+{
+	u32 i, sum = 0;
+
+	for (i = 0; i < PCIE_DW_BENCH_HIST_NUM; i++) {
+		sum += hist[i];
+		if ((u64)sum * 100 >= (u64)nr * pct)
+			break;
+	}
+
+	return 1U << min_t(u32, i, PCIE_DW_BENCH_HIST_NUM - 1);
+}
+
+#define bench_printf(fmt, ...)							\
+	(s_bench_len += scnprintf(s_bench_result + s_bench_len,			\
+				  PCIE_DW_BENCH_RESULT_SIZE - s_bench_len,	\
+				  fmt, ##__VA_ARGS__))
+
+static int pcie_dw_bench_one(struct pcie_dw_dmatest_dev *dmatest_dev, bool rd, bool wr,
+			     u32 chn_mask, u32 size, u32 max_size, u32 loops)
+{
+	struct pcie_dw_bench_chn bc[PCIE_DMA_CHANEL_MAX_NUM] = { };
+	u32 hist[PCIE_DW_BENCH_HIST_NUM] = { };
+	u64 wall_ns, busy_ns, bytes = 0, total_ns = 0, min_ns = U64_MAX, max_ns = 0;
+	struct task_struct *tsk;
+	ktime_t start;
+	u32 i, j, nr = 0;
+	int ret = 0;
+
+	busy_ns = pcie_dw_bench_cpu_busy();
+	start = ktime_get();
+	for (i = 0; i < PCIE_DMA_CHANEL_MAX_NUM; i++) {
+		if (!(chn_mask & BIT(i)))
+			continue;
+
+		bc[i].dmatest_dev = dmatest_dev;
+		bc[i].chn = i;
+		bc[i].bus_paddr = bus_addr + i * max_size;
+		bc[i].local_paddr = local_addr + i * max_size;
+		bc[i].size = size;
+		bc[i].loops = loops;
+		bc[i].rd = rd;
+		bc[i].wr = wr;
+		bc[i].min_ns = U64_MAX;
+		init_completion(&bc[i].done);
+
+		tsk = kthread_run(pcie_dw_bench_thread, &bc[i], "dma_bench_ch%u", i);
+		if (IS_ERR(tsk)) {
+			bc[i].ret = PTR_ERR(tsk);
+			complete(&bc[i].done);
+		}
+	}
+
+	for (i = 0; i < PCIE_DMA_CHANEL_MAX_NUM; i++) {
+		if (!(chn_mask & BIT(i)))
+			continue;
+
+		wait_for_completion(&bc[i].done);
+		if (bc[i].ret)
+			ret = bc[i].ret;
+		bytes += (u64)bc[i].nr * size;
+		nr += bc[i].nr;
+		total_ns += bc[i].total_ns;
+		min_ns = min(min_ns, bc[i].min_ns);
+		max_ns = max(max_ns, bc[i].max_ns);
+		for (j = 0; j < PCIE_DW_BENCH_HIST_NUM; j++)
+			hist[j] += bc[i].hist[j];
+	}
+	wall_ns = max_t(u64, ktime_to_ns(ktime_sub(ktime_get(), start)), 1);
+	busy_ns = pcie_dw_bench_cpu_busy() - busy_ns;
+
+	if (!nr) {
+		bench_printf("%-3s %#-4x %-8u failed %d\n", rd ? (wr ? "rw" : "rd") : "wr",
+			     chn_mask, size, ret);
+		return ret;
+	}
+
+	bench_printf("%-3s %#-4x %-8u %-8llu %-7llu %-7llu %-7u %-7u %-7llu %llu%%%s\n",
+		     rd ? (wr ? "rw" : "rd") : "wr", chn_mask, size,
+		     div64_u64(bytes * NSEC_PER_USEC, wall_ns),
+		     div_u64(min_ns, NSEC_PER_USEC),
+		     div_u64(div_u64(total_ns, nr), NSEC_PER_USEC),
+		     pcie_dw_bench_percentile(hist, nr, 50),
+		     pcie_dw_bench_percentile(hist, nr, 99),
+		     div_u64(max_ns, NSEC_PER_USEC),
+		     div64_u64(busy_ns * 100, wall_ns * num_online_cpus()),
+		     ret ? " (aborted)" : "");
+	bench_printf("    hist(us):");
+	for (j = 0; j < PCIE_DW_BENCH_HIST_NUM; j++)
+		if (hist[j])
+			bench_printf(" <%u:%u", 1U << j, hist[j]);
+	bench_printf("\n");
+
+	return ret;
+}
+
+static int pcie_dw_bench_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&s_bench_lock);
+	if (s_bench_result && s_bench_len)
+		seq_write(s, s_bench_result, s_bench_len);
+	else
+		seq_puts(s, "echo \"<rd|wr|rw> <chn_mask> <min_size> <max_size> <loops>\" to run\n");
+	mutex_unlock(&s_bench_lock);
+
+	return 0;
+}
+
+static int pcie_dw_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pcie_dw_bench_show, inode->i_private);
+}
+
+static ssize_t pcie_dw_bench_write(struct file *file, const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	u32 chn_mask, min_size, max_size, loops, size;
+	char buf[64], dir[4];
+	bool rd, wr;
+
+	if (!s_dmatest_dev)
+		return -ENODEV;
+
+	if (copy_from_user(buf, ubuf, min_t(size_t, sizeof(buf) - 1, count)))
+		return -EFAULT;
+	buf[min_t(size_t, sizeof(buf) - 1, count)] = '\0';
+
+	if (sscanf(buf, "%3s %u %u %u %u", dir, &chn_mask, &min_size, &max_size, &loops) != 5)
+		return -EINVAL;
+
+	rd = !strcmp(dir, "rd") || !strcmp(dir, "rw");
+	wr = !strcmp(dir, "wr") || !strcmp(dir, "rw");
+	chn_mask &= GENMASK(PCIE_DMA_CHANEL_MAX_NUM - 1, 0);
+	if ((!rd && !wr) || !chn_mask || !loops || !min_size || min_size > max_size)
+		return -EINVAL;
+
+	mutex_lock(&s_bench_lock);
+	if (!s_bench_result) {
+		s_bench_result = kmalloc(PCIE_DW_BENCH_RESULT_SIZE, GFP_KERNEL);
+		if (!s_bench_result) {
+			mutex_unlock(&s_bench_lock);
+			return -ENOMEM;
+		}
+	}
+
+	s_bench_len = 0;
+	bench_printf("%s, %s, irq %s, %u loops\n", dev_name(s_dmatest_dev->obj->dev),
+		     is_wired ? "wired" : "local", s_dmatest_dev->irq_en ? "on" : "off", loops);
+	bench_printf("dir chn  size     MB/s     min(us) avg(us) p50(us) p99(us) max(us) cpu\n");
+	for (size = min_size; size <= max_size; size <<= 1) {
+		if (pcie_dw_bench_one(s_dmatest_dev, rd, wr, chn_mask, size, max_size, loops))
+			break;
+		if (size > U32_MAX >> 1)
+			break;
+	}
+	mutex_unlock(&s_bench_lock);
+
+	return count;
+}
+
+static const struct file_operations pcie_dw_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = pcie_dw_bench_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+	.write = pcie_dw_bench_write,
+};
+
+static void pcie_dw_dmatest_debugfs_init(void)
+{
+	if (s_dmatest_root)
+		return;
+
+	s_dmatest_root = debugfs_create_dir("pcie_dw_dmatest", NULL);
+	debugfs_create_file("bench", 0644, s_dmatest_root, NULL, &pcie_dw_bench_fops);
+}
+
+static void pcie_dw_dmatest_debugfs_exit(void)
+{
+	debugfs_remove_recursive(s_dmatest_root);
+	s_dmatest_root = NULL;
+	mutex_lock(&s_bench_lock);
+	kfree(s_bench_result);
+	s_bench_result = NULL;
+	s_bench_len = 0;
+	mutex_unlock(&s_bench_lock);
+}
+#else
+static inline void pcie_dw_dmatest_debugfs_init(void) { }
+static inline void pcie_dw_dmatest_debugfs_exit(void) { }
+#endif
+
 struct dma_trx_obj *pcie_dw_dmatest_register(struct device *dev, bool irq_en)
 {
 	struct dma_trx_obj *obj;
@@ -240,12 +646,14 @@ struct dma_trx_obj *pcie_dw_dmatest_register(struct device *dev, bool irq_en)
 	/* Enable IRQ transfer as default */
 	dmatest_dev->irq_en = irq_en;
 	s_dmatest_dev = dmatest_dev;
+	pcie_dw_dmatest_debugfs_init();
 
 	return obj;
 }
 
 void pcie_dw_dmatest_unregister(struct dma_trx_obj *obj)
 {
+	pcie_dw_dmatest_debugfs_exit();
 	s_dmatest_dev = NULL;
 }
 
@@ -261,6 +669,115 @@ int pcie_dw_wired_dma_tobus_block(struct dma_trx_obj *obj, u32 chn,
 	return rk_pcie_local_dma_frombus_block(obj, chn, bus_paddr, local_paddr, size);
 }
 
+int pcie_dw_local_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr,
+			   const struct pcie_ep_dma_block *blocks, u32 nr)
+{
+	return rk_pcie_dma_list(obj, chn, wr, false, blocks, nr);
+}
+
+int pcie_dw_wired_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr,
+			   const struct pcie_ep_dma_block *blocks, u32 nr)
+{
+	return rk_pcie_dma_list(obj, chn, wr, true, blocks, nr);
+}
+
+/**
+ * pcie_dw_dma_dmabuf - move part of a dma-buf without a bounce buffer
+ * @obj: dma object
+ * @dev: device the buffer is mapped for, i.e. the one whose address space
+ *	 the "local" side of the transfer lives in
+ * @chn: dma channel
+ * @wr: true to copy from the dma-buf to @bus_paddr, false for the reverse
+ * @wired: @obj is driven from the remote side, see rk_pcie_dma_list()
+ * @fd: dma-buf file descriptor
+ * @offset: start offset inside the dma-buf
+ * @size: bytes to move
+ * @bus_paddr: start address on the other side, advanced linearly
+ *
+ * The buffer's own scatter list becomes the linked-list chain, split into
+ * PCIE_DMA_LL_MAX_NUM element runs where needed.
+ */
+int pcie_dw_dma_dmabuf(struct dma_trx_obj *obj, struct device *dev, u32 chn,
+		       bool wr, bool wired, int fd, u64 offset, u64 size,
+		       u64 bus_paddr)
+{
+	enum dma_data_direction dir = wr ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+	struct dma_buf_attachment *attach;
+	struct pcie_ep_dma_block *blocks;
+	struct dma_buf *dmabuf;
+	struct scatterlist *sg;
+	struct sg_table *sgt;
+	u64 skip = offset;
+	u32 nr = 0;
+	int i, ret = 0;
+
+	if (!size)
+		return -EINVAL;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	if (offset > dmabuf->size || size > dmabuf->size - offset) {
+		ret = -EINVAL;
+		goto put;
+	}
+
+	blocks = kcalloc(PCIE_DMA_LL_MAX_NUM, sizeof(*blocks), GFP_KERNEL);
+	if (!blocks) {
+		ret = -ENOMEM;
+		goto put;
+	}
+
+	attach = dma_buf_attach(dmabuf, dev);
+	if (IS_ERR(attach)) {
+		ret = PTR_ERR(attach);
+		goto free;
+	}
+
+	sgt = dma_buf_map_attachment(attach, dir);
+	if (IS_ERR(sgt)) {
+		ret = PTR_ERR(sgt);
+		goto detach;
+	}
+
+	for_each_sgtable_dma_sg(sgt, sg, i) {
+		u64 addr = sg_dma_address(sg);
+		u64 len = sg_dma_len(sg);
+
+		if (skip >= len) {
+			skip -= len;
+			continue;
+		}
+		addr += skip;
+		len = min(len - skip, size);
+		skip = 0;
+
+		blocks[nr].local_paddr = addr;
+		blocks[nr].bus_paddr = bus_paddr;
+		blocks[nr].size = len;
+		bus_paddr += len;
+		size -= len;
+
+		if (++nr == PCIE_DMA_LL_MAX_NUM || !size) {
+			ret = rk_pcie_dma_list(obj, chn, wr, wired, blocks, nr);
+			nr = 0;
+			if (ret || !size)
+				break;
+		}
+	}
+
+	dma_buf_unmap_attachment(attach, sgt, dir);
+detach:
+	dma_buf_detach(dmabuf, attach);
+free:
+	kfree(blocks);
+put:
+	dma_buf_put(dmabuf);
+
+	return ret;
+}
+
 static int dma_test(struct pcie_dw_dmatest_dev *dmatest_dev, u32 chn,
 		    u64 bus_paddr, u64 local_paddr, u32 size, u32 loop, u8 rd_en, u8 wr_en)
 {
@@ -375,4 +892,5 @@ module_param_cb(dmatest, &pcie_dw_dmatest_ops, &pcie_dw_dmatest, 0644);
 MODULE_PARM_DESC(dmatest, "test rockchip pcie dma module");
 
 MODULE_AUTHOR("Jon Lin");
+MODULE_IMPORT_NS(DMA_BUF);
 MODULE_LICENSE("GPL");
@@ -7,12 +7,16 @@
 
 struct dma_trx_obj;
 struct device;
+struct pcie_ep_dma_block;
 
 #if IS_ENABLED(CONFIG_PCIE_DW_DMATEST)
 struct dma_trx_obj *pcie_dw_dmatest_register(struct device *dev, bool irq_en);
 void pcie_dw_dmatest_unregister(struct dma_trx_obj *obj);
 int pcie_dw_wired_dma_frombus_block(struct dma_trx_obj *obj, u32 chn, u64 local_paddr, u64 bus_paddr, u32 size);
 int pcie_dw_wired_dma_tobus_block(struct dma_trx_obj *obj, u32 chn, u64 bus_paddr, u64 local_paddr, u32 size);
+int pcie_dw_local_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr, const struct pcie_ep_dma_block *blocks, u32 nr);
+int pcie_dw_wired_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr, const struct pcie_ep_dma_block *blocks, u32 nr);
+int pcie_dw_dma_dmabuf(struct dma_trx_obj *obj, struct device *dev, u32 chn, bool wr, bool wired, int fd, u64 offset, u64 size, u64 bus_paddr);
 #else
 static inline struct dma_trx_obj *pcie_dw_dmatest_register(struct device *dev, bool irq_en)
 {
@@ -30,6 +34,21 @@ static inline int pcie_dw_wired_dma_tobus_block(struct dma_trx_obj *obj, u32 chn
 {
 	return -1;
 }
+
+static inline int pcie_dw_local_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr, const struct pcie_ep_dma_block *blocks, u32 nr)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int pcie_dw_wired_dma_list(struct dma_trx_obj *obj, u32 chn, bool wr, const struct pcie_ep_dma_block *blocks, u32 nr)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int pcie_dw_dma_dmabuf(struct dma_trx_obj *obj, struct device *dev, u32 chn, bool wr, bool wired, int fd, u64 offset, u64 size, u64 bus_paddr)
+{
+	return -EOPNOTSUPP;
+}
 #endif
 
 #endif
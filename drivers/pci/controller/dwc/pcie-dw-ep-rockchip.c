@@ -19,6 +19,7 @@
 #include <linux/platform_device.h>
 #include <linux/regmap.h>
 #include <linux/reset.h>
+#include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <uapi/linux/rk-pcie-ep.h>
 
@@ -46,6 +47,8 @@
 #define PCIE_DMA_WR_SAR_PTR_HI		0x210
 #define PCIE_DMA_WR_DAR_PTR_LO		0x214
 #define PCIE_DMA_WR_DAR_PTR_HI		0x218
+#define PCIE_DMA_WR_LL_PTR_LO		0x21c
+#define PCIE_DMA_WR_LL_PTR_HI		0x220
 #define PCIE_DMA_WR_WEILO		0x18
 #define PCIE_DMA_WR_WEIHI		0x1c
 #define PCIE_DMA_WR_DOORBELL		0x10
@@ -61,6 +64,8 @@
 #define PCIE_DMA_RD_SAR_PTR_HI		0x310
 #define PCIE_DMA_RD_DAR_PTR_LO		0x314
 #define PCIE_DMA_RD_DAR_PTR_HI		0x318
+#define PCIE_DMA_RD_LL_PTR_LO		0x31c
+#define PCIE_DMA_RD_LL_PTR_HI		0x320
 #define PCIE_DMA_RD_WEILO		0x38
 #define PCIE_DMA_RD_WEIHI		0x3c
 #define PCIE_DMA_RD_DOORBELL		0x30
@@ -109,7 +114,10 @@
 
 #define PCIE_DBI_SIZE			0x400000
 
-#define PCIE_EP_OBJ_INFO_DRV_VERSION	0x00000001
+#define PCIE_EP_OBJ_INFO_DRV_VERSION	0x00000003
+
+#define PCIE_EP_QUEUE_STRIDE		SZ_8K
+#define PCIE_EP_QUEUE_AREA_SIZE		(PCIE_EP_QUEUE_MAX * PCIE_EP_QUEUE_STRIDE)
 
 #define PCIE_BAR_MAX_NUM		6
 #define PCIE_HOTRESET_TMOUT_US		10000
@@ -141,6 +149,8 @@ struct rockchip_pcie {
 	struct mutex			file_mutex;
 	DECLARE_BITMAP(virtual_id_irq_bitmap, RKEP_EP_VIRTUAL_ID_MAX);
 	wait_queue_head_t wq_head;
+	void				*queues;
+	unsigned long			queue_pending;
 };
 
 struct rockchip_pcie_misc_dev {
@@ -468,18 +478,16 @@ static int rockchip_pcie_ep_set_bar(struct rockchip_pcie *rockchip, enum pci_bar
 	return 0;
 }
 
-static void rockchip_pcie_elbi_clear(struct rockchip_pcie *rockchip)
+/* Ack only the ELBI interrupts that were seen, one bit per interrupt number */
+static void rockchip_pcie_elbi_ack(struct rockchip_pcie *rockchip, u32 bits)
 {
 	int i;
-	u32 elbi_reg;
-	struct dw_pcie *pci = &rockchip->pci;
 	u32 val;
 
 	for (i = 0; i < PCIE_ELBI_REG_NUM; i++) {
-		elbi_reg = PCIE_ELBI_LOCAL_BASE + i * 4;
-		val = dw_pcie_readl_dbi(pci, elbi_reg);
-		val <<= 16;
-		dw_pcie_writel_dbi(pci, elbi_reg, val);
+		val = (bits >> (16 * i)) & 0xffff;
+		if (val)
+			dw_pcie_writel_dbi(&rockchip->pci, PCIE_ELBI_LOCAL_BASE + i * 4, val << 16);
 	}
 }
 
@@ -535,6 +543,7 @@ static irqreturn_t rockchip_pcie_sys_irq_handler(int irq, void *arg)
 {
 	struct rockchip_pcie *rockchip = arg;
 	struct dw_pcie *pci = &rockchip->pci;
+	unsigned long doorbells;
 	u32 elbi_reg;
 	u32 chn;
 	union int_status wr_status, rd_status;
@@ -542,9 +551,21 @@ static irqreturn_t rockchip_pcie_sys_irq_handler(int irq, void *arg)
 	u32 reg, mask;
 
 	/* ELBI helper, only check the valid bits, and discard the rest interrupts */
-	elbi_reg = dw_pcie_readl_dbi(pci, PCIE_ELBI_LOCAL_BASE + PCIE_ELBI_APP_ELBI_INT_GEN0);
+	elbi_reg = dw_pcie_readl_dbi(pci, PCIE_ELBI_LOCAL_BASE + PCIE_ELBI_APP_ELBI_INT_GEN0) & 0xffff;
+	elbi_reg |= dw_pcie_readl_dbi(pci, PCIE_ELBI_LOCAL_BASE + PCIE_ELBI_APP_ELBI_INT_GEN1) << 16;
+
+	/* Queue doorbells, the rings themselves tell what is to be done */
+	doorbells = (elbi_reg >> PCIE_EP_QUEUE_ELBI_BASE) & GENMASK(PCIE_EP_QUEUE_MAX - 1, 0);
+	if (doorbells && rockchip->queues) {
+		rockchip_pcie_elbi_ack(rockchip, doorbells << PCIE_EP_QUEUE_ELBI_BASE);
+		for_each_set_bit(chn, &doorbells, PCIE_EP_QUEUE_MAX)
+			set_bit(chn, &rockchip->queue_pending);
+		wake_up_interruptible(&rockchip->wq_head);
+	}
+
 	if (elbi_reg & PCIE_ELBI_APP_ELBI_INT_GEN0_IRQ_USER) {
-		rockchip_pcie_elbi_clear(rockchip);
+		/* Don't drop doorbells which rang after the status read */
+		rockchip_pcie_elbi_ack(rockchip, elbi_reg);
 
 		if (rockchip->obj_info->irq_type_ep == OBJ_IRQ_USER) {
 			reg = rockchip->obj_info->irq_user_data_ep;
@@ -840,6 +861,15 @@ static void rockchip_pcie_start_dma_rd(struct dma_trx_obj *obj, struct dma_table
 			   cur->ctx_reg.ctrllo.asdword);
 	dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_RD_CTRL_HI,
 			   cur->ctx_reg.ctrlhi.asdword);
+	if (cur->dma_mode == RK_PCIE_DMA_LL) {
+		dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_RD_LL_PTR_LO,
+				   lower_32_bits(cur->phys_descs));
+		dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_RD_LL_PTR_HI,
+				   upper_32_bits(cur->phys_descs));
+		dw_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_RD_DOORBELL,
+				   cur->start.asdword);
+		return;
+	}
 	dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_RD_XFERSIZE,
 			   cur->ctx_reg.xfersize);
 	dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_RD_SAR_PTR_LO,
@@ -865,6 +895,15 @@ static void rockchip_pcie_start_dma_wr(struct dma_trx_obj *obj, struct dma_table
 			   cur->ctx_reg.ctrllo.asdword);
 	dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_WR_CTRL_HI,
 			   cur->ctx_reg.ctrlhi.asdword);
+	if (cur->dma_mode == RK_PCIE_DMA_LL) {
+		dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_WR_LL_PTR_LO,
+				   lower_32_bits(cur->phys_descs));
+		dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_WR_LL_PTR_HI,
+				   upper_32_bits(cur->phys_descs));
+		dw_pcie_writel_dbi(pci, PCIE_DMA_OFFSET + PCIE_DMA_WR_DOORBELL,
+				   cur->start.asdword);
+		return;
+	}
 	dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_WR_XFERSIZE,
 			   cur->ctx_reg.xfersize);
 	dw_pcie_writel_dbi(pci, ctr_off + PCIE_DMA_WR_SAR_PTR_LO,
@@ -896,6 +935,17 @@ static void rockchip_pcie_start_dma_dwc(struct dma_trx_obj *obj, struct dma_tabl
 
 static void rockchip_pcie_config_dma_dwc(struct dma_table *table)
 {
+	if (table->dma_mode == RK_PCIE_DMA_LL) {
+		table->enb.enb = 0x1;
+		table->ctx_reg.ctrllo.lie = 0x1;
+		table->ctx_reg.ctrllo.rie = 0x0;
+		table->ctx_reg.ctrllo.ccs = 1;
+		table->ctx_reg.ctrllo.llen = 1;
+		table->ctx_reg.ctrlhi.asdword = 0x0;
+		table->start.chnl = table->chn;
+		return;
+	}
+
 	table->enb.enb = 0x1;
 	table->ctx_reg.ctrllo.lie = 0x1;
 	table->ctx_reg.ctrllo.rie = 0x0;
@@ -968,6 +1018,96 @@ static int rockchip_pcie_get_dma_status(struct dma_trx_obj *obj, u8 chn, enum dm
 	return ret;
 }
 
+/*
+ * Reserve the tail of BAR0 for linked-list chains. It is ep memory mapped
+ * uncached here and writable by the rc through BAR0, so both the local
+ * ioctl and pcie-rkep on the rc side can build chains there; obj_info
+ * tells the rc where it is.
+ */
+static void rockchip_pcie_init_dma_ll(struct rockchip_pcie *rockchip)
+{
+	struct dma_trx_obj *obj = rockchip->dma_obj;
+	u32 off;
+
+	if (rockchip->ib_target_size[0] < PCIE_DMA_LL_AREA_SIZE + SZ_1M)
+		return;
+
+	off = rockchip->ib_target_size[0] - PCIE_DMA_LL_AREA_SIZE;
+	obj->ll_base = (void __iomem *)rockchip->ib_target_base[0] + off;
+	obj->ll_phys = rockchip->ib_target_address[0] + off;
+	obj->ll_size = PCIE_DMA_LL_AREA_SIZE;
+
+	rockchip->obj_info->dma_ll_off = off;
+	rockchip->obj_info->dma_ll_size = PCIE_DMA_LL_AREA_SIZE;
+	rockchip->obj_info->dma_ll_base = obj->ll_phys;
+}
+
+/*
+ * Host queue rings sit right below the linked-list area. They are only
+ * published in obj_info, the ep application drives them through BAR0
+ * mmap and the PCIE_EP_QUEUE_WAIT/NOTIFY ioctls.
+ */
+static void rockchip_pcie_init_queues(struct rockchip_pcie *rockchip)
+{
+	u32 off;
+
+	if (rockchip->ib_target_size[0] < PCIE_DMA_LL_AREA_SIZE + PCIE_EP_QUEUE_AREA_SIZE + SZ_1M)
+		return;
+
+	off = rockchip->ib_target_size[0] - PCIE_DMA_LL_AREA_SIZE - PCIE_EP_QUEUE_AREA_SIZE;
+	rockchip->queues = rockchip->ib_target_base[0] + off;
+	memset_io(rockchip->queues, 0, PCIE_EP_QUEUE_AREA_SIZE);
+
+	rockchip->obj_info->queue_off = off;
+	rockchip->obj_info->queue_stride = PCIE_EP_QUEUE_STRIDE;
+	rockchip->obj_info->queue_depth = PCIE_EP_QUEUE_DEPTH;
+	rockchip->obj_info->queue_num = PCIE_EP_QUEUE_MAX;
+}
+
+static int rockchip_pcie_queue_wait(struct rockchip_pcie *rockchip, struct pcie_ep_queue_wait *wait)
+{
+	long ret;
+
+	if (!rockchip->queues)
+		return -EOPNOTSUPP;
+
+	if (wait->timeout_ms)
+		ret = wait_event_interruptible_timeout(rockchip->wq_head,
+						       READ_ONCE(rockchip->queue_pending),
+						       msecs_to_jiffies(wait->timeout_ms));
+	else
+		ret = wait_event_interruptible(rockchip->wq_head,
+					       READ_ONCE(rockchip->queue_pending));
+	if (ret < 0)
+		return ret;
+
+	wait->pending = xchg(&rockchip->queue_pending, 0);
+
+	return 0;
+}
+
+static int rockchip_pcie_queue_notify(struct rockchip_pcie *rockchip, u32 qid)
+{
+	struct pcie_ep_queue_ring *ring;
+	u32 vector;
+
+	if (!rockchip->queues || qid >= PCIE_EP_QUEUE_MAX)
+		return -EINVAL;
+
+	/* The rc picked the vector when it claimed the queue */
+	ring = rockchip->queues + qid * PCIE_EP_QUEUE_STRIDE;
+	if (READ_ONCE(ring->state) != PCIE_EP_QUEUE_STATE_READY)
+		return -ENODEV;
+
+	vector = READ_ONCE(ring->msi_vector);
+	if (vector >= 32)
+		return -EINVAL;
+
+	rockchip_pcie_raise_msi_irq(rockchip, vector);
+
+	return 0;
+}
+
 static int rockchip_pcie_init_dma_trx(struct rockchip_pcie *rockchip)
 {
 	struct dw_pcie *pci = &rockchip->pci;
@@ -980,11 +1120,61 @@ static int rockchip_pcie_init_dma_trx(struct rockchip_pcie *rockchip)
 		rockchip->dma_obj->start_dma_func = rockchip_pcie_start_dma_dwc;
 		rockchip->dma_obj->config_dma_func = rockchip_pcie_config_dma_dwc;
 		rockchip->dma_obj->get_dma_status = rockchip_pcie_get_dma_status;
+		rockchip_pcie_init_dma_ll(rockchip);
 	}
 
 	return 0;
 }
 
+static int rockchip_pcie_dma_xfer_list(struct rockchip_pcie *rockchip, void __user *uarg)
+{
+	struct pcie_ep_dma_list_req req;
+	struct pcie_ep_dma_block *blocks;
+	int ret;
+
+	if (!rockchip->dma_obj)
+		return -EOPNOTSUPP;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.nr_blocks || req.nr_blocks > PCIE_EP_DMA_LIST_MAX)
+		return -EINVAL;
+
+	blocks = memdup_user(u64_to_user_ptr(req.blocks),
+			     array_size(req.nr_blocks, sizeof(*blocks)));
+	if (IS_ERR(blocks))
+		return PTR_ERR(blocks);
+
+	ret = pcie_dw_local_dma_list(rockchip->dma_obj, req.chn, req.wr,
+				     blocks, req.nr_blocks);
+	if (ret)
+		dev_err(rockchip->pci.dev, "failed to transfer dma list, ret=%d\n", ret);
+	kfree(blocks);
+
+	return ret;
+}
+
+static int rockchip_pcie_dma_xfer_dmabuf(struct rockchip_pcie *rockchip, void __user *uarg)
+{
+	struct pcie_ep_dma_dmabuf_req req;
+	int ret;
+
+	if (!rockchip->dma_obj)
+		return -EOPNOTSUPP;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	ret = pcie_dw_dma_dmabuf(rockchip->dma_obj, rockchip->pci.dev, req.chn,
+				 req.wr, false, req.fd, req.offset, req.size,
+				 req.bus_paddr);
+	if (ret)
+		dev_err(rockchip->pci.dev, "failed to transfer dma-buf, ret=%d\n", ret);
+
+	return ret;
+}
+
 static int pcie_ep_open(struct inode *inode, struct file *file)
 {
 	struct miscdevice *miscdev = file->private_data;
@@ -1002,6 +1192,7 @@ static long pcie_ep_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 	struct pcie_ep_dma_cache_cfg cfg;
 	void __user *uarg = (void __user *)arg;
 	struct pcie_ep_obj_poll_virtual_id_cfg poll_cfg;
+	struct pcie_ep_queue_wait wait;
 	enum pcie_ep_mmap_resource mmap_res;
 	int ret, index;
 
@@ -1022,6 +1213,16 @@ static long pcie_ep_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 		}
 		dma_sync_single_for_device(rockchip->pci.dev, cfg.addr, cfg.size, DMA_TO_DEVICE);
 		break;
+	case PCIE_EP_DMA_XFER_LIST:
+		ret = rockchip_pcie_dma_xfer_list(rockchip, uarg);
+		if (ret)
+			return ret;
+		break;
+	case PCIE_EP_DMA_XFER_DMABUF:
+		ret = rockchip_pcie_dma_xfer_dmabuf(rockchip, uarg);
+		if (ret)
+			return ret;
+		break;
 	case PCIE_DMA_IRQ_MASK_ALL:
 		dw_pcie_writel_dbi(&rockchip->pci, PCIE_DMA_OFFSET + PCIE_DMA_WR_INT_MASK,
 				   0xffffffff);
@@ -1073,6 +1274,25 @@ static long pcie_ep_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 		if (copy_to_user(uarg, &poll_cfg, sizeof(poll_cfg)))
 			return -EFAULT;
 		break;
+	case PCIE_EP_QUEUE_WAIT:
+		if (copy_from_user(&wait, uarg, sizeof(wait)))
+			return -EFAULT;
+
+		ret = rockchip_pcie_queue_wait(rockchip, &wait);
+		if (ret)
+			return ret;
+
+		if (copy_to_user(uarg, &wait, sizeof(wait)))
+			return -EFAULT;
+		break;
+	case PCIE_EP_QUEUE_NOTIFY:
+		if (copy_from_user(&index, uarg, sizeof(index)))
+			return -EFAULT;
+
+		ret = rockchip_pcie_queue_notify(rockchip, index);
+		if (ret)
+			return ret;
+		break;
 	default:
 		break;
 	}
@@ -1186,6 +1406,8 @@ static int rockchip_pcie_ep_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	rockchip_pcie_init_queues(rockchip);
+
 	ret = rockchip_pcie_init_host(rockchip);
 	if (ret) {
 		dev_err(dev, "Failed to init host!\n");
@@ -0,0 +1,490 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * dmaengine provider for the DesignWare PCIe embedded DMA on Rockchip SoCs.
+ *
+ * Write channels move local memory to the PCIe bus (DMA_MEM_TO_DEV), read
+ * channels move the PCIe bus to local memory (DMA_DEV_TO_MEM). The bus side
+ * address comes from dma_slave_config and advances with every sg entry.
+ * Transfers are run in linked-list mode, RK_EDMA_LL_ELEMS sg entries per
+ * doorbell, so a whole scatterlist costs one interrupt per chunk instead of
+ * one per buffer.
+ *
+ * Copyright (C) 2026 Rockchip Electronics Co., Ltd.
+ */
+
+#include <linux/bitfield.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include "../../../dma/virt-dma.h"
+#include "../rockchip-pcie-dma.h"
+#include "pcie-dw-rockchip-edma.h"
+
+#define EDMA_CTRL			0x008
+#define EDMA_CTRL_WR_CH_CNT		GENMASK(3, 0)
+#define EDMA_CTRL_RD_CH_CNT		GENMASK(19, 16)
+#define EDMA_WR_ENGINE_EN		0x00c
+#define EDMA_WR_DOORBELL		0x010
+#define EDMA_WR_INT_STATUS		0x04c
+#define EDMA_WR_INT_MASK		0x054
+#define EDMA_WR_INT_CLEAR		0x058
+#define EDMA_WR_LL_ERR_EN		0x090
+#define EDMA_RD_ENGINE_EN		0x02c
+#define EDMA_RD_DOORBELL		0x030
+#define EDMA_RD_INT_STATUS		0x0a0
+#define EDMA_RD_INT_MASK		0x0a8
+#define EDMA_RD_INT_CLEAR		0x0ac
+#define EDMA_RD_LL_ERR_EN		0x0c4
+
+#define EDMA_INT_DONE(ch)		BIT(ch)
+#define EDMA_INT_ABORT(ch)		BIT((ch) + 16)
+#define EDMA_DOORBELL_STOP		BIT(31)
+
+/* Unrolled per-channel context, write channel at +0x000, read at +0x100 */
+#define EDMA_CH_BASE(rd, ch)		(0x200 + (ch) * 0x200 + ((rd) ? 0x100 : 0))
+#define EDMA_CH_CTRL1			0x00
+#define EDMA_CH_LLP_LO			0x1c
+#define EDMA_CH_LLP_HI			0x20
+
+#define RK_EDMA_MAX_CH			8
+#define RK_EDMA_LL_ELEMS		64
+#define RK_EDMA_LL_SIZE			(RK_EDMA_LL_ELEMS * sizeof(struct rk_edma_lli) + \
+					 sizeof(struct rk_edma_llp))
+
+struct rk_edma_burst {
+	u64				sar;
+	u64				dar;
+	u32				sz;
+};
+
+struct rk_edma_desc {
+	struct virt_dma_desc		vd;
+	u32				nr_bursts;
+	u32				next;
+	u32				chunk;
+	size_t				total;
+	size_t				done;
+	struct rk_edma_burst		bursts[];
+};
+
+struct rk_edma_chan {
+	struct virt_dma_chan		vc;
+	struct rk_edma			*edma;
+	void __iomem			*regs;
+	u32				id;
+	bool				rd;
+	struct dma_slave_config		config;
+	struct rk_edma_desc		*desc;
+	struct rk_edma_lli		*ll;
+	dma_addr_t			ll_dma;
+};
+
+struct rk_edma {
+	struct device			*dev;
+	void __iomem			*base;
+	struct dma_device		dd;
+	u32				wr_cnt;
+	u32				rd_cnt;
+	struct rk_edma_chan		*wr;
+	struct rk_edma_chan		*rd;
+};
+
+static inline struct rk_edma_chan *to_rk_edma_chan(struct dma_chan *dchan)
+{
+	return container_of(dchan, struct rk_edma_chan, vc.chan);
+}
+
+static inline struct rk_edma_desc *to_rk_edma_desc(struct virt_dma_desc *vd)
+{
+	return container_of(vd, struct rk_edma_desc, vd);
+}
+
+static inline enum dma_transfer_direction rk_edma_chan_dir(struct rk_edma_chan *chan)
+{
+	return chan->rd ? DMA_DEV_TO_MEM : DMA_MEM_TO_DEV;
+}
+
+static void rk_edma_start_chunk(struct rk_edma_chan *chan)
+{
+	struct rk_edma_desc *desc = chan->desc;
+	struct rk_edma_lli *lli = chan->ll;
+	struct rk_edma_llp *llp;
+	u32 i, n;
+
+	n = min_t(u32, desc->nr_bursts - desc->next, RK_EDMA_LL_ELEMS);
+	for (i = 0; i < n; i++) {
+		const struct rk_edma_burst *burst = &desc->bursts[desc->next + i];
+
+		lli[i].control = PCIE_DWC_DMA_CB;
+		if (i == n - 1)
+			lli[i].control |= PCIE_DWC_DMA_LIE;
+		lli[i].transfer_size = burst->sz;
+		lli[i].sar.reg = burst->sar;
+		lli[i].dar.reg = burst->dar;
+	}
+
+	/*
+	 * The link element carries the opposite cycle bit, so the engine
+	 * stops on it once the last data element has raised its interrupt.
+	 */
+	llp = (struct rk_edma_llp *)&lli[n];
+	llp->control = PCIE_DWC_DMA_LLP | PCIE_DWC_DMA_TCB;
+	llp->llp.reg = chan->ll_dma;
+	desc->chunk = n;
+
+	/* writel() orders the list stores above before the doorbell */
+	writel(PCIE_DWC_DMA_CCS | PCIE_DWC_DMA_LLE, chan->regs + EDMA_CH_CTRL1);
+	writel(lower_32_bits(chan->ll_dma), chan->regs + EDMA_CH_LLP_LO);
+	writel(upper_32_bits(chan->ll_dma), chan->regs + EDMA_CH_LLP_HI);
+	writel(chan->id, chan->edma->base +
+	       (chan->rd ? EDMA_RD_DOORBELL : EDMA_WR_DOORBELL));
+}
+
+/* Called with vc.lock held */
+static void rk_edma_start_next(struct rk_edma_chan *chan)
+{
+	struct virt_dma_desc *vd = vchan_next_desc(&chan->vc);
+
+	if (!vd)
+		return;
+
+	list_del(&vd->node);
+	chan->desc = to_rk_edma_desc(vd);
+	rk_edma_start_chunk(chan);
+}
+
+static void rk_edma_chan_irq(struct rk_edma_chan *chan, bool abort)
+{
+	struct rk_edma_desc *desc;
+
+	spin_lock(&chan->vc.lock);
+	desc = chan->desc;
+	if (!desc)
+		goto out;
+
+	if (abort) {
+		dev_err(chan->edma->dev, "%s channel %u abort\n",
+			chan->rd ? "read" : "write", chan->id);
+		desc->vd.tx_result.result = chan->rd ? DMA_TRANS_READ_FAILED :
+						       DMA_TRANS_WRITE_FAILED;
+		desc->vd.tx_result.residue = desc->total - desc->done;
+		goto complete;
+	}
+
+	for (; desc->chunk; desc->chunk--)
+		desc->done += desc->bursts[desc->next++].sz;
+
+	if (desc->next < desc->nr_bursts) {
+		rk_edma_start_chunk(chan);
+		goto out;
+	}
+
+	desc->vd.tx_result.result = DMA_TRANS_NOERROR;
+	desc->vd.tx_result.residue = 0;
+complete:
+	chan->desc = NULL;
+	vchan_cookie_complete(&desc->vd);
+	rk_edma_start_next(chan);
+out:
+	spin_unlock(&chan->vc.lock);
+}
+
+static bool rk_edma_irq_dir(struct rk_edma *edma, bool rd)
+{
+	struct rk_edma_chan *chans = rd ? edma->rd : edma->wr;
+	u32 cnt = rd ? edma->rd_cnt : edma->wr_cnt;
+	u32 status, i;
+
+	status = readl(edma->base + (rd ? EDMA_RD_INT_STATUS : EDMA_WR_INT_STATUS));
+	if (!status)
+		return false;
+
+	writel(status, edma->base + (rd ? EDMA_RD_INT_CLEAR : EDMA_WR_INT_CLEAR));
+
+	for (i = 0; i < cnt; i++) {
+		if (status & (EDMA_INT_DONE(i) | EDMA_INT_ABORT(i)))
+			rk_edma_chan_irq(&chans[i], status & EDMA_INT_ABORT(i));
+	}
+
+	return true;
+}
+
+/**
+ * rk_pcie_edma_irq - handle done and abort events of all eDMA channels
+ * @edma: provider returned by rk_pcie_edma_probe()
+ *
+ * Called from the controller's shared system interrupt.
+ * Return: true if any channel had a pending event
+ */
+bool rk_pcie_edma_irq(struct rk_edma *edma)
+{
+	bool handled;
+
+	handled = rk_edma_irq_dir(edma, false);
+	handled |= rk_edma_irq_dir(edma, true);
+
+	return handled;
+}
+EXPORT_SYMBOL_GPL(rk_pcie_edma_irq);
+
+static int rk_edma_slave_config(struct dma_chan *dchan,
+				struct dma_slave_config *config)
+{
+	struct rk_edma_chan *chan = to_rk_edma_chan(dchan);
+
+	memcpy(&chan->config, config, sizeof(*config));
+
+	return 0;
+}
+
+static struct dma_async_tx_descriptor *
+rk_edma_prep_slave_sg(struct dma_chan *dchan, struct scatterlist *sgl,
+		      unsigned int sg_len, enum dma_transfer_direction dir,
+		      unsigned long flags, void *context)
+{
+	struct rk_edma_chan *chan = to_rk_edma_chan(dchan);
+	struct rk_edma_desc *desc;
+	struct scatterlist *sg;
+	dma_addr_t bus;
+	unsigned int i;
+
+	if (!sg_len || dir != rk_edma_chan_dir(chan))
+		return NULL;
+
+	desc = kzalloc(struct_size(desc, bursts, sg_len), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	bus = chan->rd ? chan->config.src_addr : chan->config.dst_addr;
+	for_each_sg(sgl, sg, sg_len, i) {
+		struct rk_edma_burst *burst = &desc->bursts[i];
+
+		burst->sz = sg_dma_len(sg);
+		if (chan->rd) {
+			burst->sar = bus;
+			burst->dar = sg_dma_address(sg);
+		} else {
+			burst->sar = sg_dma_address(sg);
+			burst->dar = bus;
+		}
+		bus += burst->sz;
+		desc->total += burst->sz;
+	}
+	desc->nr_bursts = sg_len;
+
+	return vchan_tx_prep(&chan->vc, &desc->vd, flags);
+}
+
+static void rk_edma_issue_pending(struct dma_chan *dchan)
+{
+	struct rk_edma_chan *chan = to_rk_edma_chan(dchan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (vchan_issue_pending(&chan->vc) && !chan->desc)
+		rk_edma_start_next(chan);
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+}
+
+static enum dma_status rk_edma_tx_status(struct dma_chan *dchan,
+					 dma_cookie_t cookie,
+					 struct dma_tx_state *state)
+{
+	struct rk_edma_chan *chan = to_rk_edma_chan(dchan);
+	struct virt_dma_desc *vd;
+	enum dma_status ret;
+	unsigned long flags;
+	size_t residue = 0;
+
+	ret = dma_cookie_status(dchan, cookie, state);
+	if (ret == DMA_COMPLETE || !state)
+		return ret;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (chan->desc && chan->desc->vd.tx.cookie == cookie) {
+		residue = chan->desc->total - chan->desc->done;
+	} else {
+		vd = vchan_find_desc(&chan->vc, cookie);
+		if (vd)
+			residue = to_rk_edma_desc(vd)->total;
+	}
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	dma_set_residue(state, residue);
+
+	return ret;
+}
+
+static int rk_edma_terminate_all(struct dma_chan *dchan)
+{
+	struct rk_edma_chan *chan = to_rk_edma_chan(dchan);
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (chan->desc) {
+		writel(EDMA_DOORBELL_STOP | chan->id, chan->edma->base +
+		       (chan->rd ? EDMA_RD_DOORBELL : EDMA_WR_DOORBELL));
+		vchan_terminate_vdesc(&chan->desc->vd);
+		chan->desc = NULL;
+	}
+	vchan_get_all_descriptors(&chan->vc, &head);
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	vchan_dma_desc_free_list(&chan->vc, &head);
+
+	return 0;
+}
+
+static void rk_edma_synchronize(struct dma_chan *dchan)
+{
+	vchan_synchronize(&to_rk_edma_chan(dchan)->vc);
+}
+
+static void rk_edma_free_chan_resources(struct dma_chan *dchan)
+{
+	rk_edma_terminate_all(dchan);
+	vchan_free_chan_resources(&to_rk_edma_chan(dchan)->vc);
+}
+
+static void rk_edma_device_caps(struct dma_chan *dchan,
+				struct dma_slave_caps *caps)
+{
+	caps->directions = BIT(rk_edma_chan_dir(to_rk_edma_chan(dchan)));
+}
+
+static void rk_edma_desc_free(struct virt_dma_desc *vd)
+{
+	kfree(to_rk_edma_desc(vd));
+}
+
+static void rk_edma_hw_init(struct rk_edma *edma)
+{
+	u32 wr_mask = GENMASK(edma->wr_cnt - 1, 0);
+	u32 rd_mask = GENMASK(edma->rd_cnt - 1, 0);
+
+	writel(1, edma->base + EDMA_WR_ENGINE_EN);
+	writel(1, edma->base + EDMA_RD_ENGINE_EN);
+	writel(wr_mask, edma->base + EDMA_WR_LL_ERR_EN);
+	writel(rd_mask, edma->base + EDMA_RD_LL_ERR_EN);
+	writel(0, edma->base + EDMA_WR_INT_MASK);
+	writel(0, edma->base + EDMA_RD_INT_MASK);
+}
+
+static int rk_edma_chan_init(struct rk_edma *edma, struct rk_edma_chan *chan,
+			     u32 id, bool rd)
+{
+	chan->edma = edma;
+	chan->id = id;
+	chan->rd = rd;
+	chan->regs = edma->base + EDMA_CH_BASE(rd, id);
+	chan->ll = dmam_alloc_coherent(edma->dev, RK_EDMA_LL_SIZE,
+				       &chan->ll_dma, GFP_KERNEL);
+	if (!chan->ll)
+		return -ENOMEM;
+
+	chan->vc.desc_free = rk_edma_desc_free;
+	vchan_init(&chan->vc, &edma->dd);
+
+	return 0;
+}
+
+/**
+ * rk_pcie_edma_probe - register the eDMA channels with dmaengine
+ * @dev: PCIe controller device, also used for the linked-list memory
+ * @base: eDMA register block, i.e. dbi base + PCIE_DMA_OFFSET
+ *
+ * Clients find the channels with dma_request_channel() and a filter on
+ * @dev plus the direction reported by dma_get_slave_caps().
+ * Return: provider handle, NULL if the core has no eDMA, or an ERR_PTR
+ */
+struct rk_edma *rk_pcie_edma_probe(struct device *dev, void __iomem *base)
+{
+	struct rk_edma *edma;
+	struct dma_device *dd;
+	u32 ctrl, i;
+	int ret;
+
+	ctrl = readl(base + EDMA_CTRL);
+	if (!ctrl)
+		return NULL;
+
+	edma = devm_kzalloc(dev, sizeof(*edma), GFP_KERNEL);
+	if (!edma)
+		return ERR_PTR(-ENOMEM);
+
+	edma->dev = dev;
+	edma->base = base;
+	edma->wr_cnt = min_t(u32, FIELD_GET(EDMA_CTRL_WR_CH_CNT, ctrl), RK_EDMA_MAX_CH);
+	edma->rd_cnt = min_t(u32, FIELD_GET(EDMA_CTRL_RD_CH_CNT, ctrl), RK_EDMA_MAX_CH);
+	if (!edma->wr_cnt || !edma->rd_cnt)
+		return NULL;
+
+	edma->wr = devm_kcalloc(dev, edma->wr_cnt, sizeof(*edma->wr), GFP_KERNEL);
+	edma->rd = devm_kcalloc(dev, edma->rd_cnt, sizeof(*edma->rd), GFP_KERNEL);
+	if (!edma->wr || !edma->rd)
+		return ERR_PTR(-ENOMEM);
+
+	dd = &edma->dd;
+	INIT_LIST_HEAD(&dd->channels);
+	for (i = 0; i < edma->wr_cnt; i++) {
+		ret = rk_edma_chan_init(edma, &edma->wr[i], i, false);
+		if (ret)
+			return ERR_PTR(ret);
+	}
+	for (i = 0; i < edma->rd_cnt; i++) {
+		ret = rk_edma_chan_init(edma, &edma->rd[i], i, true);
+		if (ret)
+			return ERR_PTR(ret);
+	}
+
+	dma_cap_set(DMA_SLAVE, dd->cap_mask);
+	dma_cap_set(DMA_PRIVATE, dd->cap_mask);
+	dd->dev = dev;
+	dd->directions = BIT(DMA_MEM_TO_DEV) | BIT(DMA_DEV_TO_MEM);
+	dd->src_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	dd->dst_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_4_BYTES);
+	dd->residue_granularity = DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+	dd->device_caps = rk_edma_device_caps;
+	dd->device_config = rk_edma_slave_config;
+	dd->device_prep_slave_sg = rk_edma_prep_slave_sg;
+	dd->device_issue_pending = rk_edma_issue_pending;
+	dd->device_tx_status = rk_edma_tx_status;
+	dd->device_terminate_all = rk_edma_terminate_all;
+	dd->device_synchronize = rk_edma_synchronize;
+	dd->device_free_chan_resources = rk_edma_free_chan_resources;
+
+	rk_edma_hw_init(edma);
+
+	ret = dma_async_device_register(dd);
+	if (ret)
+		return ERR_PTR(ret);
+
+	dev_info(dev, "eDMA: %u write, %u read channels\n",
+		 edma->wr_cnt, edma->rd_cnt);
+
+	return edma;
+}
+EXPORT_SYMBOL_GPL(rk_pcie_edma_probe);
+
+void rk_pcie_edma_remove(struct rk_edma *edma)
+{
+	if (!IS_ERR_OR_NULL(edma))
+		dma_async_device_unregister(&edma->dd);
+}
+EXPORT_SYMBOL_GPL(rk_pcie_edma_remove);
+
+/* The engine loses its enables across a controller reset */
+void rk_pcie_edma_resume(struct rk_edma *edma)
+{
+	if (!IS_ERR_OR_NULL(edma))
+		rk_edma_hw_init(edma);
+}
+EXPORT_SYMBOL_GPL(rk_pcie_edma_resume);
+
+MODULE_DESCRIPTION("Rockchip DesignWare PCIe eDMA dmaengine provider");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (C) 2026 Rockchip Electronics Co., Ltd.
+ */
+#ifndef __PCIE_DW_ROCKCHIP_EDMA_H
+#define __PCIE_DW_ROCKCHIP_EDMA_H
+
+#include <linux/err.h>
+
+struct device;
+struct rk_edma;
+
+#if IS_ENABLED(CONFIG_PCIE_DW_ROCKCHIP_EDMA)
+struct rk_edma *rk_pcie_edma_probe(struct device *dev, void __iomem *base);
+void rk_pcie_edma_remove(struct rk_edma *edma);
+void rk_pcie_edma_resume(struct rk_edma *edma);
+bool rk_pcie_edma_irq(struct rk_edma *edma);
+#else
+static inline struct rk_edma *rk_pcie_edma_probe(struct device *dev, void __iomem *base)
+{
+	return NULL;
+}
+
+static inline void rk_pcie_edma_remove(struct rk_edma *edma) { }
+
+static inline void rk_pcie_edma_resume(struct rk_edma *edma) { }
+
+static inline bool rk_pcie_edma_irq(struct rk_edma *edma)
+{
+	return false;
+}
+#endif
+
+#endif
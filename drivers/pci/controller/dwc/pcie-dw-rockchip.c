@@ -13,6 +13,8 @@
 #include <linux/gpio.h>
 #include <linux/iopoll.h>
 #include <linux/irqchip/chained_irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/msi.h>
 #include <linux/of_address.h>
 #include <linux/of_device.h>
 #include <linux/of_pci.h>
@@ -26,6 +28,7 @@
 #include "pcie-designware.h"
 #include "../rockchip-pcie-dma.h"
 #include "pcie-dw-dmatest.h"
+#include "pcie-dw-rockchip-edma.h"
 
 #define RK_PCIE_DBG			0
 
@@ -73,6 +76,8 @@
 #define PME_TO_ACK			(BIT(9) | BIT(25))
 #define PCIE_CLIENT_INTR_STATUS_LEGACY	0x08
 #define PCIE_CLIENT_INTR_STATUS_MISC	0x10
+#define PCIE_RDLH_LINK_UP_CHGED		BIT(1)
+#define PCIE_LINK_REQ_RST_NOT_INT	BIT(2)
 #define PCIE_CLIENT_INTR_MASK_LEGACY	0x1c
 #define UNMASK_ALL_LEGACY_INT		0xffff0000
 #define MASK_LEGACY_INT(x)		(0x00110011 << x)
@@ -126,6 +131,7 @@ struct rk_pcie {
 	u32				perst_inactive_ms;
 	struct gpio_desc		*prsnt_gpio;
 	struct dma_trx_obj		*dma_obj;
+	struct rk_edma			*edma;
 	bool				in_suspend;
 	bool				skip_scan_in_resume;
 	bool				is_signal_test;
@@ -136,12 +142,27 @@ struct rk_pcie {
 	raw_spinlock_t			intx_lock;
 	u16				aspm;
 	u32				l1ss_ctl1;
+	u32				aspm_l1ss_en;
+	u32				l12_threshold_us;
+	bool				aspm_policy;
+	bool				l1ss_blocked;
+	struct mutex			aspm_lock;
+	struct delayed_work		aspm_work;
+	u64				aspm_irqs;
+	u64				aspm_rate;
+	u32				aspm_idle;
+	u32				aspm_transitions;
+	unsigned long			aspm_stamp;
+	u64				aspm_allowed_ms;
+	u64				aspm_blocked_ms;
 	struct dentry			*debugfs;
 	u32				msi_vector_num;
 	struct workqueue_struct		*hot_rst_wq;
 	struct work_struct		hot_rst_work;
 	u32				comp_prst[2];
 	u32				intx;
+	struct completion		link_up_done;
+	u16				link_cache;
 };
 
 struct rk_pcie_of_data {
@@ -317,6 +338,23 @@ static void rk_pcie_debug_dump(struct rk_pcie *rk_pcie)
 #endif
 }
 
+/* Current speed and width, or 0 while the link is still (re)training */
+static u16 rk_pcie_link_state(struct rk_pcie *rk_pcie)
+{
+	struct dw_pcie *pci = rk_pcie->pci;
+	u8 cap = dw_pcie_find_capability(pci, PCI_CAP_ID_EXP);
+	u16 lnksta;
+
+	if (!cap)
+		return 0;
+
+	lnksta = dw_pcie_readw_dbi(pci, cap + PCI_EXP_LNKSTA);
+	if (lnksta & PCI_EXP_LNKSTA_LT)
+		return 0;
+
+	return lnksta & (PCI_EXP_LNKSTA_CLS | PCI_EXP_LNKSTA_NLW);
+}
+
 static int rk_pcie_establish_link(struct dw_pcie *pci)
 {
 	int retries, power;
@@ -342,8 +380,9 @@ static int rk_pcie_establish_link(struct dw_pcie *pci)
 		rk_pcie_link_status_clear(rk_pcie);
 		rk_pcie_enable_debug(rk_pcie);
 
-		/* Enable client reset or link down interrupt */
-		rk_pcie_writel_apb(rk_pcie, PCIE_CLIENT_INTR_MASK, 0x40000);
+		/* Enable client reset or link down, and link up interrupt */
+		reinit_completion(&rk_pcie->link_up_done);
+		rk_pcie_writel_apb(rk_pcie, PCIE_CLIENT_INTR_MASK, 0x60000);
 
 		/* Enable LTSSM */
 		rk_pcie_enable_ltssm(rk_pcie);
@@ -382,6 +421,17 @@ static int rk_pcie_establish_link(struct dw_pcie *pci)
 
 		for (retries = 0; retries < 100; retries++) {
 			if (dw_pcie_link_up(pci)) {
+				/*
+				 * Once this link has trained to a speed and width before,
+				 * reaching them again means no Gen switch is pending.
+				 */
+				if (rk_pcie->link_cache &&
+				    rk_pcie_link_state(rk_pcie) == rk_pcie->link_cache) {
+					dev_info(pci->dev, "PCIe Link up, LTSSM is 0x%x\n",
+						rk_pcie_readl_apb(rk_pcie, PCIE_CLIENT_LTSSM_STATUS));
+					return 0;
+				}
+
 				/*
 				 * We may be here in case of L0 in Gen1. But if EP is capable
 				 * of Gen2 or Gen3, Gen switch may happen just in this time, but
@@ -395,6 +445,7 @@ static int rk_pcie_establish_link(struct dw_pcie *pci)
 					dev_info(pci->dev, "PCIe Link up, LTSSM is 0x%x\n",
 						rk_pcie_readl_apb(rk_pcie, PCIE_CLIENT_LTSSM_STATUS));
 					rk_pcie_debug_dump(rk_pcie);
+					rk_pcie->link_cache = rk_pcie_link_state(rk_pcie);
 					return 0;
 				}
 			}
@@ -402,7 +453,13 @@ static int rk_pcie_establish_link(struct dw_pcie *pci)
 			dev_info_ratelimited(pci->dev, "PCIe Linking... LTSSM is 0x%x\n",
 					rk_pcie_readl_apb(rk_pcie, PCIE_CLIENT_LTSSM_STATUS));
 			rk_pcie_debug_dump(rk_pcie);
-			msleep(20);
+			/*
+			 * Woken by the RDLH link up interrupt as soon as training
+			 * completes; the timeout only matters when IRQs are off,
+			 * e.g. in the noirq resume path.
+			 */
+			wait_for_completion_timeout(&rk_pcie->link_up_done,
+						    msecs_to_jiffies(20));
 		}
 
 		/*
@@ -435,10 +492,19 @@ static int rk_pcie_init_dma_trx(struct rk_pcie *rk_pcie)
 	if (!rk_pcie_udma_enabled(rk_pcie))
 		return 0;
 
-	rk_pcie->dma_obj = pcie_dw_dmatest_register(rk_pcie->pci->dev, true);
-	if (IS_ERR(rk_pcie->dma_obj)) {
-		dev_err(rk_pcie->pci->dev, "failed to prepare dmatest\n");
-		return -EINVAL;
+	if (IS_ENABLED(CONFIG_PCIE_DW_ROCKCHIP_EDMA)) {
+		rk_pcie->edma = rk_pcie_edma_probe(rk_pcie->pci->dev,
+						   rk_pcie->dbi_base + PCIE_DMA_OFFSET);
+		if (IS_ERR(rk_pcie->edma)) {
+			dev_err(rk_pcie->pci->dev, "failed to register eDMA\n");
+			return PTR_ERR(rk_pcie->edma);
+		}
+	} else {
+		rk_pcie->dma_obj = pcie_dw_dmatest_register(rk_pcie->pci->dev, true);
+		if (IS_ERR(rk_pcie->dma_obj)) {
+			dev_err(rk_pcie->pci->dev, "failed to prepare dmatest\n");
+			return -EINVAL;
+		}
 	}
 
 	/* Enable client write and read interrupt */
@@ -725,6 +791,11 @@ static irqreturn_t rk_pcie_sys_irq_handler(int irq, void *arg)
 	union int_clear clears;
 	u32 reg;
 
+	if (rk_pcie->edma) {
+		rk_pcie_edma_irq(rk_pcie->edma);
+		goto misc;
+	}
+
 	status.asdword = dw_pcie_readl_dbi(rk_pcie->pci, PCIE_DMA_OFFSET +
 					   PCIE_DMA_WR_INT_STATUS);
 	for (chn = 0; chn < PCIE_DMA_CHANEL_MAX_NUM; chn++) {
@@ -763,10 +834,14 @@ static irqreturn_t rk_pcie_sys_irq_handler(int irq, void *arg)
 		}
 	}
 
+misc:
 	reg = rk_pcie_readl_apb(rk_pcie, PCIE_CLIENT_INTR_STATUS_MISC);
-	if (reg & BIT(2))
+	if (reg & PCIE_LINK_REQ_RST_NOT_INT)
 		queue_work(rk_pcie->hot_rst_wq, &rk_pcie->hot_rst_work);
 
+	if (reg & PCIE_RDLH_LINK_UP_CHGED)
+		complete(&rk_pcie->link_up_done);
+
 	rk_pcie_writel_apb(rk_pcie, PCIE_CLIENT_INTR_STATUS_MISC, reg);
 
 	return IRQ_HANDLED;
@@ -1089,6 +1164,394 @@ static int rockchip_pcie_fifo_show(struct seq_file *s, void *data)
 	return 0;
 }
 
+#ifdef CONFIG_PCIEASPM
+static unsigned int aspm_sample_ms = 50;
+module_param(aspm_sample_ms, uint, 0644);
+MODULE_PARM_DESC(aspm_sample_ms, "ASPM policy sampling period in ms (default 50)");
+
+static unsigned int aspm_busy_irqs = 100;
+module_param(aspm_busy_irqs, uint, 0644);
+MODULE_PARM_DESC(aspm_busy_irqs, "Downstream interrupts per sample that block L1 substates (default 100)");
+
+static unsigned int aspm_idle_samples = 20;
+module_param(aspm_idle_samples, uint, 0644);
+MODULE_PARM_DESC(aspm_idle_samples, "Quiet samples before L1 substates are allowed again (default 20)");
+
+#define PCIE_RASDES_TBA_CTRL		0x10
+#define PCIE_RASDES_TBA_DATA		0x14
+#define PCIE_RASDES_TBA_START		BIT(0)
+#define PCIE_RASDES_TBA_DURATION_10MS	(0x2 << 8)
+#define PCIE_RASDES_TBA_REPORT(x)	((x) << 24)
+
+static const struct {
+	const char *name;
+	u32 sel;
+} rk_pcie_tba_reports[] = {
+	{ "L0",   0x3 },
+	{ "L1",   0x4 },
+	{ "L1.1", 0x5 },
+	{ "L1.2", 0x6 },
+};
+
+static struct pci_dev *rk_pcie_aspm_child(struct rk_pcie *rk_pcie, struct pci_dev **bridge)
+{
+	struct dw_pcie_rp *pp = &rk_pcie->pci->pp;
+	struct pci_bus *child;
+
+	if (!pp->bridge || !pp->bridge->bus)
+		return NULL;
+
+	list_for_each_entry(child, &pp->bridge->bus->children, node) {
+		if (child->parent == pp->bridge->bus && child->self) {
+			*bridge = child->self;
+			return pci_get_slot(child, PCI_DEVFN(0, 0));
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * There is no cheap per-port TLP counter, so the interrupt rate of the
+ * functions behind the root port stands in for traffic: NVMe, WLAN and
+ * NICs all complete work through MSI/MSI-X.
+ */
+static u64 rk_pcie_aspm_irqs(struct pci_bus *bus)
+{
+	struct msi_desc *desc;
+	struct pci_dev *pdev;
+	u64 sum = 0;
+	int cpu, i;
+
+	list_for_each_entry(pdev, &bus->devices, bus_list) {
+		msi_lock_descs(&pdev->dev);
+		msi_for_each_desc(desc, &pdev->dev, MSI_DESC_ASSOCIATED) {
+			for (i = 0; i < desc->nvec_used; i++)
+				for_each_possible_cpu(cpu)
+					sum += kstat_irqs_cpu(desc->irq + i, cpu);
+		}
+		msi_unlock_descs(&pdev->dev);
+	}
+
+	return sum;
+}
+
+static void rk_pcie_encode_l12_threshold(u32 threshold_us, u32 *scale, u32 *value)
+{
+	u64 th = (u64)threshold_us * NSEC_PER_USEC;
+
+	*scale = 0;
+	while (th > 0x3ff && *scale < 5) {
+		th = DIV_ROUND_UP_ULL(th, 32);
+		(*scale)++;
+	}
+	*value = min_t(u64, th, 0x3ff);
+}
+
+static void rk_pcie_l1ss_update(struct pci_dev *pdev, u32 clear, u32 set)
+{
+	u32 val;
+
+	pci_read_config_dword(pdev, pdev->l1ss + PCI_L1SS_CTL1, &val);
+	val &= ~clear;
+	val |= set;
+	pci_write_config_dword(pdev, pdev->l1ss + PCI_L1SS_CTL1, val);
+}
+
+/*
+ * L1 PM substate enables must only change while ASPM L1 is disabled,
+ * upstream component first on enable and downstream first on disable.
+ */
+static void rk_pcie_aspm_set_l1ss(struct rk_pcie *rk_pcie, struct pci_dev *bridge,
+				  struct pci_dev *child, bool allow)
+{
+	u16 plnk, clnk;
+	u32 val, scale, value;
+
+	if (!bridge->l1ss || !child->l1ss)
+		return;
+
+	pcie_capability_read_word(child, PCI_EXP_LNKCTL, &clnk);
+	pcie_capability_read_word(bridge, PCI_EXP_LNKCTL, &plnk);
+	pcie_capability_clear_word(child, PCI_EXP_LNKCTL, PCI_EXP_LNKCTL_ASPM_L1);
+	pcie_capability_clear_word(bridge, PCI_EXP_LNKCTL, PCI_EXP_LNKCTL_ASPM_L1);
+
+	if (allow) {
+		if (rk_pcie->l12_threshold_us) {
+			rk_pcie_encode_l12_threshold(rk_pcie->l12_threshold_us, &scale, &value);
+			val = (scale << 29) | (value << 16);
+			rk_pcie_l1ss_update(bridge, PCI_L1SS_CTL1_LTR_L12_TH_SCALE |
+					    PCI_L1SS_CTL1_LTR_L12_TH_VALUE, val);
+			rk_pcie_l1ss_update(child, PCI_L1SS_CTL1_LTR_L12_TH_SCALE |
+					    PCI_L1SS_CTL1_LTR_L12_TH_VALUE, val);
+		}
+		rk_pcie_l1ss_update(bridge, 0, rk_pcie->aspm_l1ss_en);
+		rk_pcie_l1ss_update(child, 0, rk_pcie->aspm_l1ss_en);
+	} else {
+		pci_read_config_dword(child, child->l1ss + PCI_L1SS_CTL1, &val);
+		rk_pcie->aspm_l1ss_en = val & PCI_L1SS_CTL1_L1SS_MASK;
+		rk_pcie_l1ss_update(child, PCI_L1SS_CTL1_L1SS_MASK, 0);
+		rk_pcie_l1ss_update(bridge, PCI_L1SS_CTL1_L1SS_MASK, 0);
+	}
+
+	pcie_capability_clear_and_set_word(bridge, PCI_EXP_LNKCTL, PCI_EXP_LNKCTL_ASPM_L1,
+					   plnk & PCI_EXP_LNKCTL_ASPM_L1);
+	pcie_capability_clear_and_set_word(child, PCI_EXP_LNKCTL, PCI_EXP_LNKCTL_ASPM_L1,
+					   clnk & PCI_EXP_LNKCTL_ASPM_L1);
+}
+
+static void rk_pcie_aspm_account(struct rk_pcie *rk_pcie)
+{
+	unsigned long now = jiffies;
+
+	if (rk_pcie->l1ss_blocked)
+		rk_pcie->aspm_blocked_ms += jiffies_to_msecs(now - rk_pcie->aspm_stamp);
+	else
+		rk_pcie->aspm_allowed_ms += jiffies_to_msecs(now - rk_pcie->aspm_stamp);
+	rk_pcie->aspm_stamp = now;
+}
+
+static void rk_pcie_aspm_block(struct rk_pcie *rk_pcie, struct pci_dev *bridge,
+			       struct pci_dev *child, bool block)
+{
+	if (rk_pcie->l1ss_blocked == block)
+		return;
+
+	dw_pcie_dbi_ro_wr_en(rk_pcie->pci);
+	rk_pcie_aspm_set_l1ss(rk_pcie, bridge, child, !block);
+	dw_pcie_dbi_ro_wr_dis(rk_pcie->pci);
+	rk_pcie->l1ss_blocked = block;
+	rk_pcie->aspm_transitions++;
+}
+
+static void rk_pcie_aspm_work(struct work_struct *work)
+{
+	struct rk_pcie *rk_pcie = container_of(to_delayed_work(work), struct rk_pcie,
+					       aspm_work);
+	struct pci_dev *bridge, *child;
+	u64 irqs, delta;
+
+	mutex_lock(&rk_pcie->aspm_lock);
+	child = rk_pcie_aspm_child(rk_pcie, &bridge);
+	if (!child) {
+		mutex_unlock(&rk_pcie->aspm_lock);
+		return;
+	}
+
+	irqs = rk_pcie_aspm_irqs(child->bus);
+	delta = irqs - rk_pcie->aspm_irqs;
+	rk_pcie->aspm_irqs = irqs;
+	rk_pcie->aspm_rate = delta;
+	rk_pcie_aspm_account(rk_pcie);
+
+	if (delta >= aspm_busy_irqs) {
+		rk_pcie->aspm_idle = 0;
+		rk_pcie_aspm_block(rk_pcie, bridge, child, true);
+	} else if (rk_pcie->l1ss_blocked && ++rk_pcie->aspm_idle >= aspm_idle_samples) {
+		rk_pcie_aspm_block(rk_pcie, bridge, child, false);
+	}
+
+	pci_dev_put(child);
+	mutex_unlock(&rk_pcie->aspm_lock);
+
+	queue_delayed_work(system_power_efficient_wq, &rk_pcie->aspm_work,
+			   msecs_to_jiffies(max(aspm_sample_ms, 1U)));
+}
+
+static void rk_pcie_aspm_policy_start(struct rk_pcie *rk_pcie)
+{
+	struct pci_dev *bridge, *child;
+
+	if (!rk_pcie->aspm_policy)
+		return;
+
+	mutex_lock(&rk_pcie->aspm_lock);
+	child = rk_pcie_aspm_child(rk_pcie, &bridge);
+	if (child) {
+		rk_pcie->aspm_irqs = rk_pcie_aspm_irqs(child->bus);
+		/* Cycle once so a configured L1.2 threshold takes effect */
+		if (rk_pcie->l12_threshold_us) {
+			rk_pcie_aspm_block(rk_pcie, bridge, child, true);
+			rk_pcie_aspm_block(rk_pcie, bridge, child, false);
+		}
+		pci_dev_put(child);
+	}
+	rk_pcie->aspm_idle = 0;
+	rk_pcie->aspm_stamp = jiffies;
+	mutex_unlock(&rk_pcie->aspm_lock);
+
+	queue_delayed_work(system_power_efficient_wq, &rk_pcie->aspm_work,
+			   msecs_to_jiffies(max(aspm_sample_ms, 1U)));
+}
+
+/* Hand the link back with L1 substates as the ASPM core left them */
+static void rk_pcie_aspm_policy_stop(struct rk_pcie *rk_pcie)
+{
+	struct pci_dev *bridge, *child;
+
+	cancel_delayed_work_sync(&rk_pcie->aspm_work);
+
+	mutex_lock(&rk_pcie->aspm_lock);
+	rk_pcie_aspm_account(rk_pcie);
+	child = rk_pcie_aspm_child(rk_pcie, &bridge);
+	if (child) {
+		rk_pcie_aspm_block(rk_pcie, bridge, child, false);
+		pci_dev_put(child);
+	}
+	mutex_unlock(&rk_pcie->aspm_lock);
+}
+
+static void rk_pcie_aspm_policy_init(struct rk_pcie *rk_pcie)
+{
+	struct device *dev = rk_pcie->pci->dev;
+
+	mutex_init(&rk_pcie->aspm_lock);
+	INIT_DELAYED_WORK(&rk_pcie->aspm_work, rk_pcie_aspm_work);
+
+	/* Only block L1 substates under load on ports that opt in */
+	rk_pcie->aspm_policy = device_property_read_bool(dev, "rockchip,aspm-policy");
+	device_property_read_u32(dev, "rockchip,l1ss-ltr-threshold-us",
+				 &rk_pcie->l12_threshold_us);
+}
+
+static u32 rk_pcie_pwr_on_us(u32 scale, u32 value)
+{
+	static const u32 unit[] = { 2, 10, 100, 0 };
+
+	return unit[scale & 0x3] * value;
+}
+
+static void rk_pcie_aspm_show_latency(struct seq_file *s, const char *tag,
+				      struct pci_dev *pdev)
+{
+	u32 lnkcap, cap, ctl2, l1el;
+
+	pcie_capability_read_dword(pdev, PCI_EXP_LNKCAP, &lnkcap);
+	l1el = (lnkcap & PCI_EXP_LNKCAP_L1EL) >> 15;
+	if (l1el == 7)
+		seq_printf(s, "%s L1 exit latency: >64us\n", tag);
+	else
+		seq_printf(s, "%s L1 exit latency: <%uus\n", tag, 1U << l1el);
+
+	if (!pdev->l1ss)
+		return;
+
+	pci_read_config_dword(pdev, pdev->l1ss + PCI_L1SS_CAP, &cap);
+	pci_read_config_dword(pdev, pdev->l1ss + PCI_L1SS_CTL2, &ctl2);
+	seq_printf(s, "%s T_POWER_ON: cap %uus, programmed %uus, Tcommon_mode %uus\n", tag,
+		   rk_pcie_pwr_on_us((cap & PCI_L1SS_CAP_P_PWR_ON_SCALE) >> 16,
+				     (cap & PCI_L1SS_CAP_P_PWR_ON_VALUE) >> 19),
+		   rk_pcie_pwr_on_us(ctl2 & PCI_L1SS_CTL2_T_PWR_ON_SCALE,
+				     (ctl2 & PCI_L1SS_CTL2_T_PWR_ON_VALUE) >> 3),
+		   (cap & PCI_L1SS_CAP_CM_RESTORE_TIME) >> 8);
+}
+
+/*
+ * Residency comes from the RAS DES time-based analysis counters: one
+ * 10ms window per LTSSM power state, relative to a reference window
+ * counting every core clock cycle.
+ */
+static void rk_pcie_aspm_show_residency(struct seq_file *s, struct rk_pcie *pcie)
+{
+	int cap = dw_pcie_find_ext_capability(pcie->pci, PCI_EXT_CAP_ID_VNDR);
+	u32 ref, val, i;
+
+	if (!cap)
+		return;
+
+	dw_pcie_writel_dbi(pcie->pci, cap + PCIE_RASDES_TBA_CTRL, PCIE_RASDES_TBA_REPORT(0) |
+			   PCIE_RASDES_TBA_DURATION_10MS | PCIE_RASDES_TBA_START);
+	msleep(12);
+	ref = dw_pcie_readl_dbi(pcie->pci, cap + PCIE_RASDES_TBA_DATA);
+	if (!ref)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(rk_pcie_tba_reports); i++) {
+		dw_pcie_writel_dbi(pcie->pci, cap + PCIE_RASDES_TBA_CTRL,
+				   PCIE_RASDES_TBA_REPORT(rk_pcie_tba_reports[i].sel) |
+				   PCIE_RASDES_TBA_DURATION_10MS | PCIE_RASDES_TBA_START);
+		msleep(12);
+		val = dw_pcie_readl_dbi(pcie->pci, cap + PCIE_RASDES_TBA_DATA);
+		seq_printf(s, "%s residency: %llu%% (%u/%u)\n", rk_pcie_tba_reports[i].name,
+			   div_u64((u64)val * 100, ref), val, ref);
+	}
+}
+
+static int rockchip_pcie_aspm_show(struct seq_file *s, void *unused)
+{
+	struct rk_pcie *pcie = s->private;
+	struct pci_dev *bridge, *child;
+
+	mutex_lock(&pcie->aspm_lock);
+	if (pcie->aspm_policy)
+		rk_pcie_aspm_account(pcie);
+	seq_printf(s, "policy: %s\n", pcie->aspm_policy ? "on" : "off");
+	seq_printf(s, "l1ss: %s\n", pcie->l1ss_blocked ? "blocked" : "allowed");
+	seq_printf(s, "irqs/sample: %llu (busy >= %u, %ums)\n",
+		   pcie->aspm_rate, aspm_busy_irqs, aspm_sample_ms);
+	seq_printf(s, "transitions: %u\n", pcie->aspm_transitions);
+	seq_printf(s, "allowed: %llums blocked: %llums\n",
+		   pcie->aspm_allowed_ms, pcie->aspm_blocked_ms);
+	if (pcie->l12_threshold_us)
+		seq_printf(s, "L1.2 LTR threshold: %uus\n", pcie->l12_threshold_us);
+
+	child = rk_pcie_aspm_child(pcie, &bridge);
+	if (child) {
+		rk_pcie_aspm_show_latency(s, "rc", bridge);
+		rk_pcie_aspm_show_latency(s, "ep", child);
+		pci_dev_put(child);
+	}
+	mutex_unlock(&pcie->aspm_lock);
+
+	rk_pcie_aspm_show_residency(s, pcie);
+
+	return 0;
+}
+
+static int rockchip_pcie_aspm_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rockchip_pcie_aspm_show, inode->i_private);
+}
+
+static ssize_t rockchip_pcie_aspm_write(struct file *file, const char __user *ubuf,
+					size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct rk_pcie *pcie = s->private;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+
+	if (enable == pcie->aspm_policy)
+		return count;
+
+	if (enable) {
+		pcie->aspm_policy = true;
+		rk_pcie_aspm_policy_start(pcie);
+	} else {
+		rk_pcie_aspm_policy_stop(pcie);
+		pcie->aspm_policy = false;
+	}
+
+	return count;
+}
+
+static const struct file_operations rockchip_pcie_aspm_ops = {
+	.owner = THIS_MODULE,
+	.open = rockchip_pcie_aspm_open,
+	.read = seq_read,
+	.write = rockchip_pcie_aspm_write,
+	.release = single_release,
+};
+#else
+static inline void rk_pcie_aspm_policy_init(struct rk_pcie *rk_pcie) { }
+static inline void rk_pcie_aspm_policy_start(struct rk_pcie *rk_pcie) { }
+static inline void rk_pcie_aspm_policy_stop(struct rk_pcie *rk_pcie) { }
+#endif
+
 static void rockchip_pcie_debugfs_exit(struct rk_pcie *pcie)
 {
 	debugfs_remove_recursive(pcie->debugfs);
@@ -1111,6 +1574,13 @@ static int rockchip_pcie_debugfs_init(struct rk_pcie *pcie)
 	if (!file)
 		goto remove;
 
+#ifdef CONFIG_PCIEASPM
+	file = debugfs_create_file("aspm_policy", 0644, pcie->debugfs,
+				   pcie, &rockchip_pcie_aspm_ops);
+	if (!file)
+		goto remove;
+#endif
+
 	return 0;
 
 remove:
@@ -1229,6 +1699,16 @@ static int rk_pcie_really_probe(void *p)
 	 */
 	rk_pcie_writel_apb(rk_pcie, PCIE_CLIENT_INTR_MASK, 0xffffffff);
 
+	init_completion(&rk_pcie->link_up_done);
+
+	/*
+	 * Speed and width (PCI_EXP_LNKSTA encoding) this slot trained to on
+	 * a previous boot, as recorded by the bootloader. Lets the first
+	 * training skip the Gen switch settle delay.
+	 */
+	if (!device_property_read_u32(dev, "rockchip,link-cache", &val))
+		rk_pcie->link_cache = val & (PCI_EXP_LNKSTA_CLS | PCI_EXP_LNKSTA_NLW);
+
 	ret = rk_pcie_request_sys_irq(rk_pcie, pdev);
 	if (ret) {
 		dev_err(dev, "pcie irq init failed\n");
@@ -1293,6 +1773,8 @@ static int rk_pcie_really_probe(void *p)
 	if (device_property_read_bool(dev, "rockchip,skip-scan-in-resume"))
 		rk_pcie->skip_scan_in_resume = true;
 
+	rk_pcie_aspm_policy_init(rk_pcie);
+
 	rk_pcie->hot_rst_wq = create_singlethread_workqueue("rk_pcie_hot_rst_wq");
 	if (!rk_pcie->hot_rst_wq) {
 		dev_err(dev, "failed to create hot_rst workqueue\n");
@@ -1327,6 +1809,8 @@ static int rk_pcie_really_probe(void *p)
 	/* Enable async system PM for multiports SoC */
 	device_enable_async_suspend(dev);
 
+	rk_pcie_aspm_policy_start(rk_pcie);
+
 	if (IS_ENABLED(CONFIG_DEBUG_FS)) {
 		ret = rockchip_pcie_debugfs_init(rk_pcie);
 		if (ret < 0)
@@ -1599,6 +2083,11 @@ static int __maybe_unused rockchip_dw_pcie_resume(struct device *dev)
 		goto err;
 	}
 
+	if (rk_pcie->edma) {
+		rk_pcie_writel_apb(rk_pcie, PCIE_CLIENT_INTR_MASK, 0xc000000);
+		rk_pcie_edma_resume(rk_pcie->edma);
+	}
+
 	dw_pcie_dbi_ro_wr_dis(rk_pcie->pci);
 	rk_pcie->in_suspend = false;
 
@@ -1646,6 +2135,9 @@ static int rockchip_dw_pcie_prepare(struct device *dev)
 {
 	struct rk_pcie *rk_pcie = dev_get_drvdata(dev);
 
+	if (rk_pcie->aspm_policy)
+		rk_pcie_aspm_policy_stop(rk_pcie);
+
 	dw_pcie_dbi_ro_wr_en(rk_pcie->pci);
 	rk_pcie_downstream_dev_to_d0(rk_pcie, false);
 	dw_pcie_dbi_ro_wr_dis(rk_pcie->pci);
@@ -1660,6 +2152,8 @@ static void rockchip_dw_pcie_complete(struct device *dev)
 	dw_pcie_dbi_ro_wr_en(rk_pcie->pci);
 	rk_pcie_downstream_dev_to_d0(rk_pcie, true);
 	dw_pcie_dbi_ro_wr_dis(rk_pcie->pci);
+
+	rk_pcie_aspm_policy_start(rk_pcie);
 }
 #endif
 
@@ -1678,6 +2172,7 @@ static struct platform_driver rk_plat_pcie_driver = {
 		.of_match_table = rk_pcie_of_match,
 		.suppress_bind_attrs = true,
 		.pm = &rockchip_dw_pcie_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = rk_pcie_probe,
 };
@@ -6,6 +6,7 @@
 #define __SOC_ROCKCHIP_PCIE_DMA_TRX_H
 
 #include <linux/debugfs.h>
+#include <linux/sizes.h>
 
 #define PCIE_DMA_TABLE_NUM		32
 
@@ -35,6 +36,16 @@
 #define SET_LL_64(ll, value) \
 	writeq(value, ll)
 
+/*
+ * Linked-list area: one slot per channel and direction, read channels
+ * first. PCIE_DMA_LL_SLOT_SIZE holds PCIE_DMA_LL_MAX_NUM data elements
+ * plus the closing link element.
+ */
+#define PCIE_DMA_LL_MAX_NUM			1024
+#define PCIE_DMA_LL_SLOT_SIZE			SZ_32K
+#define PCIE_DMA_LL_SLOT_NUM			4
+#define PCIE_DMA_LL_AREA_SIZE			(PCIE_DMA_LL_SLOT_SIZE * PCIE_DMA_LL_SLOT_NUM)
+
 enum dma_dir {
 	DMA_FROM_BUS,
 	DMA_TO_BUS,
@@ -259,6 +270,9 @@ struct dma_trx_obj {
 	u32				set_chk_sum_pos;
 	u32				version;
 	int				addr_reverse;
+	void __iomem			*ll_base;	/* Linked-list area, NULL if none */
+	phys_addr_t			ll_phys;	/* Same area as seen by the engine */
+	size_t				ll_size;
 };
 
 #if IS_ENABLED(CONFIG_ROCKCHIP_PCIE_DMA_OBJ)
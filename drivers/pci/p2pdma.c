@@ -316,6 +316,16 @@ static const struct pci_p2pdma_whitelist_entry {
 	{PCI_VENDOR_ID_INTEL,	0x2033, 0},
 	{PCI_VENDOR_ID_INTEL,	0x2020, 0},
 	{PCI_VENDOR_ID_INTEL,	0x09a2, 0},
+	/*
+	 * Rockchip DW Root Ports: every controller sits on the same AXI
+	 * interconnect, so TLPs forwarded between two of them, or between
+	 * one and a local master, need no host bridge in between.
+	 */
+	{PCI_VENDOR_ID_ROCKCHIP,	0x3528, 0},
+	{PCI_VENDOR_ID_ROCKCHIP,	0x3562, 0},
+	{PCI_VENDOR_ID_ROCKCHIP,	0x3566, 0},
+	{PCI_VENDOR_ID_ROCKCHIP,	0x3576, 0},
+	{PCI_VENDOR_ID_ROCKCHIP,	0x3588, 0},
 	{}
 };
 
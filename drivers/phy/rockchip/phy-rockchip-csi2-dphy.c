@@ -776,6 +776,20 @@ static long rkcif_csi2_dphy_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void
 		break;
 	case RKMODULE_SET_QUICK_STREAM:
 		for (i = 0; i < dphy->csi_info.csi_num; i++) {
+			if (dphy->csi_info.dphy_vendor[i] == PHY_VENDOR_SAMSUNG) {
+				dphy->samsung_phy = (struct samsung_mipi_dcphy *)dphy->phy_hw[i];
+				if (!dphy->samsung_phy ||
+				    !dphy->samsung_phy->quick_stream_off ||
+				    !dphy->samsung_phy->quick_stream_on) {
+					ret = -EINVAL;
+					break;
+				}
+				on = *(int *)arg;
+				if (on)
+					ret = dphy->samsung_phy->quick_stream_on(dphy, sd);
+				else
+					ret = dphy->samsung_phy->quick_stream_off(dphy, sd);
+			}
 			if (dphy->csi_info.dphy_vendor[i] == PHY_VENDOR_INNO) {
 				dphy->dphy_hw = (struct csi2_dphy_hw *)dphy->phy_hw[i];
 				if (!dphy->dphy_hw ||
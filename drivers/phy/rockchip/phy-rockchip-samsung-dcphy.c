@@ -2243,6 +2243,24 @@ static int samsung_dcphy_rx_lane_enable(struct csi2_dphy *dphy,
 	return 0;
 }
 
+static void samsung_dcphy_rx_lane_disable(struct csi2_dphy *dphy,
+					  struct csi2_sensor *sensor)
+{
+	struct samsung_mipi_dcphy *samsung = dphy->samsung_phy;
+
+	if (sensor->mbus.type == V4L2_MBUS_CSI2_DPHY)
+		regmap_update_bits(samsung->regmap, RX_CLK_LANE_ENABLE, PHY_ENABLE, 0);
+
+	if (sensor->lanes > 0x00)
+		regmap_update_bits(samsung->regmap, RX_DATA_LANE0_ENABLE, PHY_ENABLE, 0);
+	if (sensor->lanes > 0x01)
+		regmap_update_bits(samsung->regmap, RX_DATA_LANE1_ENABLE, PHY_ENABLE, 0);
+	if (sensor->lanes > 0x02)
+		regmap_update_bits(samsung->regmap, RX_DATA_LANE2_ENABLE, PHY_ENABLE, 0);
+	if (sensor->lanes > 0x03)
+		regmap_update_bits(samsung->regmap, RX_DATA_LANE3_ENABLE, PHY_ENABLE, 0);
+}
+
 static int samsung_dcphy_rx_stream_on(struct csi2_dphy *dphy,
 					struct v4l2_subdev *sd)
 {
@@ -2310,17 +2328,7 @@ static int samsung_dcphy_rx_stream_off(struct csi2_dphy *dphy,
 	if (samsung->s_phy_rst)
 		reset_control_assert(samsung->s_phy_rst);
 
-	if (sensor->mbus.type == V4L2_MBUS_CSI2_DPHY)
-		regmap_update_bits(samsung->regmap, RX_CLK_LANE_ENABLE, PHY_ENABLE, 0);
-
-	if (sensor->lanes > 0x00)
-		regmap_update_bits(samsung->regmap, RX_DATA_LANE0_ENABLE, PHY_ENABLE, 0);
-	if (sensor->lanes > 0x01)
-		regmap_update_bits(samsung->regmap, RX_DATA_LANE1_ENABLE, PHY_ENABLE, 0);
-	if (sensor->lanes > 0x02)
-		regmap_update_bits(samsung->regmap, RX_DATA_LANE2_ENABLE, PHY_ENABLE, 0);
-	if (sensor->lanes > 0x03)
-		regmap_update_bits(samsung->regmap, RX_DATA_LANE3_ENABLE, PHY_ENABLE, 0);
+	samsung_dcphy_rx_lane_disable(dphy, sensor);
 
 	if (samsung->s_phy_rst)
 		reset_control_deassert(samsung->s_phy_rst);
@@ -2331,6 +2339,53 @@ static int samsung_dcphy_rx_stream_off(struct csi2_dphy *dphy,
 	return 0;
 }
 
+/*
+ * Quick stream only gates the lanes of a configured PHY: the bias, settle
+ * and deskew setup of the last stream on is kept and no reset is done, so
+ * a sensor that pauses streaming between bursts restarts without paying
+ * the full PHY setup.
+ */
+static int samsung_dcphy_rx_quick_stream_on(struct csi2_dphy *dphy,
+					    struct v4l2_subdev *sd)
+{
+	struct v4l2_subdev *sensor_sd = get_remote_sensor(sd);
+	struct samsung_mipi_dcphy *samsung = dphy->samsung_phy;
+	struct csi2_sensor *sensor;
+	int ret;
+
+	if (!sensor_sd)
+		return -ENODEV;
+	sensor = sd_to_sensor(dphy, sensor_sd);
+	if (!sensor)
+		return -ENODEV;
+
+	mutex_lock(&samsung->mutex);
+	ret = samsung_dcphy_rx_lane_enable(dphy, sensor);
+	mutex_unlock(&samsung->mutex);
+
+	return ret;
+}
+
+static int samsung_dcphy_rx_quick_stream_off(struct csi2_dphy *dphy,
+					     struct v4l2_subdev *sd)
+{
+	struct v4l2_subdev *sensor_sd = get_remote_sensor(sd);
+	struct samsung_mipi_dcphy *samsung = dphy->samsung_phy;
+	struct csi2_sensor *sensor;
+
+	if (!sensor_sd)
+		return -ENODEV;
+	sensor = sd_to_sensor(dphy, sensor_sd);
+	if (!sensor)
+		return -ENODEV;
+
+	mutex_lock(&samsung->mutex);
+	samsung_dcphy_rx_lane_disable(dphy, sensor);
+	mutex_unlock(&samsung->mutex);
+
+	return 0;
+}
+
 static int samsung_mipi_dcphy_init(struct phy *phy)
 {
 	struct samsung_mipi_dcphy *samsung = phy_get_drvdata(phy);
@@ -2456,6 +2511,8 @@ static int samsung_mipi_dcphy_probe(struct platform_device *pdev)
 
 	samsung->stream_on = samsung_dcphy_rx_stream_on;
 	samsung->stream_off = samsung_dcphy_rx_stream_off;
+	samsung->quick_stream_on = samsung_dcphy_rx_quick_stream_on;
+	samsung->quick_stream_off = samsung_dcphy_rx_quick_stream_off;
 	mutex_init(&samsung->mutex);
 	pm_runtime_enable(dev);
 
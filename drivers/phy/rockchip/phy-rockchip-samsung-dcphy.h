@@ -75,6 +75,8 @@ struct samsung_mipi_dcphy {
 
 	int (*stream_on)(struct csi2_dphy *dphy, struct v4l2_subdev *sd);
 	int (*stream_off)(struct csi2_dphy *dphy, struct v4l2_subdev *sd);
+	int (*quick_stream_on)(struct csi2_dphy *dphy, struct v4l2_subdev *sd);
+	int (*quick_stream_off)(struct csi2_dphy *dphy, struct v4l2_subdev *sd);
 };
 
 #endif
@@ -625,6 +625,7 @@
 #define LANE_REG062D			0x18B4
 
 #define HDMI20_MAX_RATE 600000000
+#define HDPTX_PLL_CACHE_NUM	32
 #define DATA_RATE_MASK 0xFFFFFFF
 #define COLOR_DEPTH_MASK BIT(31)
 #define HDMI_MODE_MASK BIT(30)
@@ -727,6 +728,11 @@ struct rockchip_hdptx_phy {
 	bool earc_en;
 	bool initialized;
 	int count;
+
+	/* ropll configs calculated for the rates missing in ropll_tmds_cfg */
+	spinlock_t pll_cache_lock;
+	struct ropll_config pll_cache[HDPTX_PLL_CACHE_NUM];
+	unsigned int pll_cache_next;
 };
 
 static struct lcpll_config lcpll_cfg[] = {
@@ -1141,13 +1147,59 @@ static bool hdptx_phy_clk_pll_calc(unsigned int data_rate,
 	return true;
 }
 
+/*
+ * Look up the ropll config of a tmds bit rate. Rates missing in the table
+ * are calculated once and kept, so round_rate during mode validation fills
+ * the cache and the mode set itself only copies the result.
+ */
+static bool hdptx_ropll_cfg_get(struct rockchip_hdptx_phy *hdptx, u32 bit_rate,
+				struct ropll_config *cfg)
+{
+	unsigned long flags;
+	bool found = false;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ropll_tmds_cfg); i++) {
+		if (bit_rate == ropll_tmds_cfg[i].bit_rate) {
+			*cfg = ropll_tmds_cfg[i];
+			return true;
+		}
+	}
+
+	if (!bit_rate)
+		return false;
+
+	spin_lock_irqsave(&hdptx->pll_cache_lock, flags);
+	for (i = 0; i < HDPTX_PLL_CACHE_NUM; i++) {
+		if (bit_rate == hdptx->pll_cache[i].bit_rate) {
+			*cfg = hdptx->pll_cache[i];
+			found = true;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&hdptx->pll_cache_lock, flags);
+
+	if (found)
+		return true;
+
+	memset(cfg, 0, sizeof(*cfg));
+	if (!hdptx_phy_clk_pll_calc(bit_rate, cfg))
+		return false;
+	cfg->bit_rate = bit_rate;
+
+	spin_lock_irqsave(&hdptx->pll_cache_lock, flags);
+	hdptx->pll_cache[hdptx->pll_cache_next++ % HDPTX_PLL_CACHE_NUM] = *cfg;
+	spin_unlock_irqrestore(&hdptx->pll_cache_lock, flags);
+
+	return true;
+}
+
 static int hdptx_ropll_cmn_config(struct rockchip_hdptx_phy *hdptx, unsigned long bit_rate)
 {
 	int bus_width = phy_get_bus_width(hdptx->phy);
 	u8 color_depth = (bus_width & COLOR_DEPTH_MASK) ? 1 : 0;
-	struct ropll_config *cfg;
-	struct ropll_config rc = {0};
-	u8 i;
+	struct ropll_config rc;
+	struct ropll_config *cfg = &rc;
 
 	dev_info(hdptx->dev, "%s bus_width:%x rate:%lu\n", __func__, bus_width, bit_rate);
 	hdptx->rate = bit_rate * 100;
@@ -1155,19 +1207,9 @@ static int hdptx_ropll_cmn_config(struct rockchip_hdptx_phy *hdptx, unsigned lon
 	if (color_depth)
 		bit_rate = bit_rate * 10 / 8;
 
-	for (i = 0; i < ARRAY_SIZE(ropll_tmds_cfg); i++)
-		if (bit_rate == ropll_tmds_cfg[i].bit_rate)
-			break;
-
-	if (i == ARRAY_SIZE(ropll_tmds_cfg)) {
-		if (hdptx_phy_clk_pll_calc(bit_rate, &rc)) {
-			cfg = &rc;
-		} else {
-			dev_err(hdptx->dev, "%s can't find pll cfg\n", __func__);
-			return -EINVAL;
-		}
-	} else {
-		cfg = &ropll_tmds_cfg[i];
+	if (!hdptx_ropll_cfg_get(hdptx, bit_rate, &rc)) {
+		dev_err(hdptx->dev, "%s can't find pll cfg\n", __func__);
+		return -EINVAL;
 	}
 
 	dev_dbg(hdptx->dev, "mdiv=%u, sdiv=%u\n",
@@ -2107,19 +2149,19 @@ static unsigned long hdptx_phy_clk_recalc_rate(struct clk_hw *hw,
 static long hdptx_phy_clk_round_rate(struct clk_hw *hw, unsigned long rate,
 					 unsigned long *parent_rate)
 {
+	struct rockchip_hdptx_phy *hdptx = to_rockchip_hdptx_phy(hw);
+	struct ropll_config rc;
 	u32 bit_rate = rate / 100;
-	u8 i;
 
 	if (rate > HDMI20_MAX_RATE)
 		return rate;
 
-	for (i = 0; i < ARRAY_SIZE(ropll_tmds_cfg); i++)
-		if (bit_rate == ropll_tmds_cfg[i].bit_rate)
-			break;
-
-	if (i == ARRAY_SIZE(ropll_tmds_cfg) && !hdptx_phy_clk_pll_calc(bit_rate, NULL))
+	if (!hdptx_ropll_cfg_get(hdptx, bit_rate, &rc))
 		return -EINVAL;
 
+	/* the same mode may be set with 10 bit deep color */
+	hdptx_ropll_cfg_get(hdptx, bit_rate * 10 / 8, &rc);
+
 	return rate;
 }
 
@@ -2265,6 +2307,7 @@ static int rockchip_hdptx_phy_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	hdptx->dev = dev;
+	spin_lock_init(&hdptx->pll_cache_lock);
 
 	hdptx->id = of_alias_get_id(dev->of_node, "hdptxhdmi");
 	if (hdptx->id < 0)
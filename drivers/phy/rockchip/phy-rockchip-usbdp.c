@@ -83,6 +83,10 @@
 #define PHY_LANE_MUX_USB			0
 #define PHY_LANE_MUX_DP				1
 
+static bool fast_relane = true;
+module_param(fast_relane, bool, 0644);
+MODULE_PARM_DESC(fast_relane, "only re-lane the running PHY on a DP alt mode change");
+
 enum {
 	DP_BW_RBR,
 	DP_BW_HBR,
@@ -168,6 +172,9 @@ struct rockchip_udphy {
 	bool mode_change;
 	u8 mode;
 	u8 status;
+	/* lane setup the PHY was last brought up with */
+	bool init_flip;
+	u8 init_mode;
 
 	/* utilized for USB */
 	bool hs; /* flag for high-speed */
@@ -834,6 +841,9 @@ static int udphy_init(struct rockchip_udphy *udphy)
 	if (ret)
 		goto assert_phy;
 
+	udphy->init_flip = udphy->flip;
+	udphy->init_mode = udphy->mode;
+
 	return 0;
 
 assert_phy:
@@ -847,6 +857,54 @@ static int udphy_init(struct rockchip_udphy *udphy)
 	return ret;
 }
 
+/*
+ * Move the lanes between USB and DP for a new alt mode with the same
+ * orientation. The init sequence, refclk and PLL lock of the running PHY
+ * are kept: only the lane mux changes, and the USB side is reset or
+ * brought up when it loses or gains its lanes. The DP lanes are enabled
+ * again by the caller.
+ */
+static int udphy_relane(struct rockchip_udphy *udphy)
+{
+	const struct rockchip_udphy_cfg *cfg = udphy->cfgs;
+	int ret;
+
+	if (udphy->flip != udphy->init_flip)
+		return -EINVAL;
+
+	if (!(udphy->mode & UDPHY_MODE_USB) && (udphy->init_mode & UDPHY_MODE_USB)) {
+		/* DP 4xlanes, the USB controller falls back to utmi clock */
+		udphy_u3_port_disable(udphy, true);
+		udphy_reset_assert(udphy, "lane");
+		udphy_reset_assert(udphy, "cmn");
+		udphy_reset_assert(udphy, "init");
+	}
+
+	regmap_update_bits(udphy->pma_regmap, CMN_LANE_MUX_AND_EN_OFFSET,
+			   CMN_DP_LANE_MUX_ALL | CMN_DP_LANE_EN_ALL,
+			   FIELD_PREP(CMN_DP_LANE_MUX_N(3), udphy->lane_mux_sel[3]) |
+			   FIELD_PREP(CMN_DP_LANE_MUX_N(2), udphy->lane_mux_sel[2]) |
+			   FIELD_PREP(CMN_DP_LANE_MUX_N(1), udphy->lane_mux_sel[1]) |
+			   FIELD_PREP(CMN_DP_LANE_MUX_N(0), udphy->lane_mux_sel[0]) |
+			   FIELD_PREP(CMN_DP_LANE_EN_ALL, 0));
+
+	if ((udphy->mode & UDPHY_MODE_USB) && !(udphy->init_mode & UDPHY_MODE_USB)) {
+		grfreg_write(udphy->udphygrf, &cfg->grfcfg.rx_lfps, true);
+		udphy_reset_deassert(udphy, "init");
+		udelay(1);
+		udphy_reset_deassert(udphy, "cmn");
+		udphy_reset_deassert(udphy, "lane");
+
+		ret = udphy_status_check(udphy);
+		if (ret)
+			return ret;
+	}
+
+	udphy->init_mode = udphy->mode;
+
+	return 0;
+}
+
 static int udphy_setup(struct rockchip_udphy *udphy)
 {
 	int ret = 0;
@@ -877,6 +935,8 @@ static int udphy_disable(struct rockchip_udphy *udphy)
 	for (i = 0; i < cfg->num_rsts; i++)
 		reset_control_assert(udphy->rsts[i]);
 
+	udphy->init_mode = UDPHY_MODE_NONE;
+
 	return 0;
 }
 
@@ -1054,23 +1114,29 @@ static int udphy_power_on(struct rockchip_udphy *udphy, u8 mode)
 			return ret;
 	} else if (udphy->mode_change) {
 		udphy->mode_change = false;
-		udphy->status = UDPHY_MODE_NONE;
 
-		/*
-		 * For DP 4xlanes + USB2 only scenario, it needs to
-		 * select utmi clock from the USB2 PHY for the USB
-		 * controller source clock, then it can safely disable
-		 * the USBDP PHY later to reconfigure lanes for DP.
-		 */
-		if (udphy->mode == UDPHY_MODE_DP)
-			udphy_u3_port_disable(udphy, true);
+		if (fast_relane && !udphy_relane(udphy)) {
+			/* USB keeps running if it still owns lanes */
+			udphy->status &= udphy->mode;
+		} else {
+			udphy->status = UDPHY_MODE_NONE;
+
+			/*
+			 * For DP 4xlanes + USB2 only scenario, it needs to
+			 * select utmi clock from the USB2 PHY for the USB
+			 * controller source clock, then it can safely disable
+			 * the USBDP PHY later to reconfigure lanes for DP.
+			 */
+			if (udphy->mode == UDPHY_MODE_DP)
+				udphy_u3_port_disable(udphy, true);
 
-		ret = udphy_disable(udphy);
-		if (ret)
-			return ret;
-		ret = udphy_setup(udphy);
-		if (ret)
-			return ret;
+			ret = udphy_disable(udphy);
+			if (ret)
+				return ret;
+			ret = udphy_setup(udphy);
+			if (ret)
+				return ret;
+		}
 	}
 
 	udphy->status |= mode;
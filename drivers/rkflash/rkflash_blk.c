@@ -32,6 +32,7 @@
 
 #include "rkflash_blk.h"
 #include "rkflash_debug.h"
+#include "rkflash_prefetch.h"
 #include "rk_sftl.h"
 
 void __printf(1, 2) sftl_printk(char *fmt, ...)
@@ -63,6 +64,17 @@ static unsigned long totle_write_count;
 
 static char *mtd_read_temp_buffer;
 #define MTD_RW_SECTORS (512)
+#define RKFLASH_QUEUE_DEPTH (64)
+
+/* Reads dispatched back to back before a pending write gets its turn */
+static unsigned int read_batch = 16;
+module_param(read_batch, uint, 0644);
+MODULE_PARM_DESC(read_batch, "max reads served ahead of a pending write");
+
+/* Quiet time on the queue before the background gc may run */
+static unsigned int gc_idle_ms = 100;
+module_param(gc_idle_ms, uint, 0644);
+MODULE_PARM_DESC(gc_idle_ms, "idle time in ms before ftl gc starts");
 
 #define DISABLE_WRITE _IO('V', 0)
 #define ENABLE_WRITE _IO('V', 1)
@@ -78,6 +90,13 @@ static struct task_struct *nand_gc_thread __read_mostly;
 static int rkflash_dev_initialised;
 static DEFINE_MUTEX(g_flash_ops_mutex);
 
+static struct flash_blk_ops mytr = {
+	.name =  "rkflash",
+	.major = 31,
+	.minorbits = 0,
+	.owner = THIS_MODULE,
+};
+
 static unsigned int rk_partition_init(struct flash_part *part)
 {
 	int i, part_num = 0;
@@ -135,6 +154,7 @@ static int rkflash_blk_proc_show(struct seq_file *m, void *v)
 	seq_printf(m, "Totle Write %ld KB\n", totle_write_data >> 1);
 	seq_printf(m, "totle_write_count %ld\n", totle_write_count);
 	seq_printf(m, "totle_read_count %ld\n", totle_read_count);
+	rkflash_prefetch_show(m);
 	kfree(ftl_buf);
 	return 0;
 }
@@ -167,6 +187,7 @@ static int rkflash_blk_discard(u32 sec, u32 n_sec)
 {
 	int ret;
 
+	rkflash_prefetch_invalidate(sec, n_sec);
 	if (g_boot_ops->discard)
 		ret = g_boot_ops->discard(sec, n_sec);
 	else
@@ -197,7 +218,10 @@ static int rkflash_blk_xfer(struct flash_blk_dev *dev,
 		totle_read_count++;
 		rkflash_print_bio("rkflash r sec= %lx, n_sec= %lx\n",
 				  start, nsector);
-		ret = g_boot_ops->read(start, nsector, buf);
+		if (rkflash_prefetch_read(start, nsector, buf))
+			ret = 0;
+		else
+			ret = g_boot_ops->read(start, nsector, buf);
 		if (ret)
 			ret = -EIO;
 		break;
@@ -207,6 +231,7 @@ static int rkflash_blk_xfer(struct flash_blk_dev *dev,
 		totle_write_count++;
 		rkflash_print_bio("rkflash w sec= %lx, n_sec= %lx\n",
 				  start, nsector);
+		rkflash_prefetch_invalidate(start, nsector);
 		ret = g_boot_ops->write(start, nsector, buf);
 		if (ret)
 			ret = -EIO;
@@ -333,70 +358,184 @@ static blk_status_t do_blktrans_all_request(struct flash_blk_ops *tr,
 	}
 }
 
-static struct request *rkflash_next_request(struct flash_blk_dev *dev)
+static blk_status_t rkflash_do_merged_request(struct flash_blk_dev *dev,
+					      struct list_head *batch,
+					      unsigned long block,
+					      unsigned long nsect,
+					      int op)
 {
-	struct request *rq;
-	struct flash_blk_ops *tr = dev->blk_ops;
+	struct request *req;
+	struct req_iterator rq_iter;
+	struct bio_vec bvec;
+	char *p, *page_buf;
+	int ret;
 
-	rq = list_first_entry_or_null(&tr->rq_list, struct request, queuelist);
-	if (rq) {
-		list_del_init(&rq->queuelist);
-		blk_mq_start_request(rq);
-		return rq;
+	req = list_first_entry(batch, struct request, queuelist);
+	if (block + nsect > get_capacity(req->rq_disk))
+		return BLK_STS_IOERR;
+
+	rkflash_print_bio("%s %s block=%lx nsec=%lx\n", __func__,
+			  op == REQ_OP_READ ? "read" : "write", block, nsect);
+
+	if (op == REQ_OP_WRITE) {
+		p = mtd_read_temp_buffer;
+		list_for_each_entry(req, batch, queuelist) {
+			rq_for_each_segment(bvec, req, rq_iter) {
+				page_buf = kmap_atomic(bvec.bv_page);
+				memcpy(p, page_buf + bvec.bv_offset, bvec.bv_len);
+				p += bvec.bv_len;
+				kunmap_atomic(page_buf);
+			}
+		}
 	}
 
-	return NULL;
+	ret = rkflash_blk_xfer(dev, block, nsect, mtd_read_temp_buffer, op);
+
+	if (!ret && op == REQ_OP_READ) {
+		p = mtd_read_temp_buffer;
+		list_for_each_entry(req, batch, queuelist) {
+			rq_for_each_segment(bvec, req, rq_iter) {
+				page_buf = kmap_atomic(bvec.bv_page);
+				memcpy(page_buf + bvec.bv_offset, p, bvec.bv_len);
+				p += bvec.bv_len;
+				kunmap_atomic(page_buf);
+			}
+		}
+	}
+
+	return ret ? BLK_STS_IOERR : BLK_STS_OK;
 }
 
-static void rkflash_blktrans_work(struct flash_blk_dev *dev)
-	__releases(&dev->blk_ops->queue_lock)
-	__acquires(&dev->blk_ops->queue_lock)
+static bool rkflash_has_request(struct flash_blk_ops *tr)
 {
-	struct flash_blk_ops *tr = dev->blk_ops;
-	struct request *req = NULL;
+	return !list_empty(&tr->rd_list) || !list_empty(&tr->wr_list);
+}
+
+/*
+ * Pick the next request, reads first: rootfs and application reads must not
+ * queue up behind a burst of log writes. After read_batch reads in a row a
+ * waiting write is let through so writers are not starved either.
+ */
+static struct request *rkflash_next_request(struct flash_blk_ops *tr)
+{
+	struct list_head *list;
+
+	if (!list_empty(&tr->rd_list) &&
+	    (tr->read_burst < read_batch || list_empty(&tr->wr_list))) {
+		list = &tr->rd_list;
+		tr->read_burst++;
+	} else if (!list_empty(&tr->wr_list)) {
+		list = &tr->wr_list;
+		tr->read_burst = 0;
+	} else {
+		return NULL;
+	}
 
-	while (1) {
-		blk_status_t res;
+	return list_first_entry(list, struct request, queuelist);
+}
 
-		req = rkflash_next_request(dev);
-		if (!req)
+/*
+ * Pull @first and every request queued directly behind it that continues the
+ * same transfer into @batch, so the ftl sees one large read or write instead
+ * of several small ones. Returns the merged length in sectors.
+ */
+static unsigned long rkflash_collect_batch(struct request *first,
+					   struct list_head *batch)
+{
+	struct request *req = first, *next;
+	struct list_head *head = first->queuelist.prev;
+	unsigned long nsect = blk_rq_sectors(first);
+
+	while (!list_is_last(&req->queuelist, head) &&
+	       (req_op(first) == REQ_OP_READ || req_op(first) == REQ_OP_WRITE)) {
+		next = list_next_entry(req, queuelist);
+		if (req_op(next) != req_op(first) ||
+		    next->rq_disk != first->rq_disk ||
+		    blk_rq_pos(next) != blk_rq_pos(first) + nsect ||
+		    nsect + blk_rq_sectors(next) > MTD_RW_SECTORS)
 			break;
+		nsect += blk_rq_sectors(next);
+		req = next;
+	}
 
-		spin_unlock_irq(&dev->blk_ops->queue_lock);
+	list_cut_position(batch, head, &req->queuelist);
 
+	return nsect;
+}
+
+static void rkflash_blktrans_work(struct flash_blk_ops *tr)
+{
+	struct flash_blk_dev *dev = tr->rq->queuedata;
+	struct request *req, *tmp;
+	unsigned long nsect;
+	LIST_HEAD(batch);
+	blk_status_t res;
+	bool written;
+
+	spin_lock_irq(&tr->queue_lock);
+	while ((req = rkflash_next_request(tr))) {
+		nsect = rkflash_collect_batch(req, &batch);
+		spin_unlock_irq(&tr->queue_lock);
+
+		written = req_op(req) != REQ_OP_READ;
 		mutex_lock(&g_flash_ops_mutex);
-		res = do_blktrans_all_request(tr, dev, req);
+		if (list_is_singular(&batch))
+			res = do_blktrans_all_request(tr, dev, req);
+		else
+			res = rkflash_do_merged_request(dev, &batch, blk_rq_pos(req),
+							nsect, req_op(req));
 		mutex_unlock(&g_flash_ops_mutex);
 
-		if (!blk_update_request(req, res, req->__data_len)) {
-			__blk_mq_end_request(req, res);
-			req = NULL;
+		list_for_each_entry_safe(req, tmp, &batch, queuelist) {
+			list_del_init(&req->queuelist);
+			if (!blk_update_request(req, res, req->__data_len))
+				__blk_mq_end_request(req, res);
+		}
+
+		/* Only writes and discards leave work for the gc */
+		if (written) {
+			nand_gc_do = 1;
+			wake_up(&nand_gc_thread_wait);
 		}
 
-		spin_lock_irq(&dev->blk_ops->queue_lock);
+		spin_lock_irq(&tr->queue_lock);
 	}
+	spin_unlock_irq(&tr->queue_lock);
+}
+
+static int rkflash_io_thread(void *arg)
+{
+	struct flash_blk_ops *tr = arg;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(tr->io_wait,
+					 kthread_should_stop() || rkflash_has_request(tr));
+		rkflash_blktrans_work(tr);
+	}
+
+	return 0;
 }
 
 static blk_status_t rkflash_queue_rq(struct blk_mq_hw_ctx *hctx,
 				     const struct blk_mq_queue_data *bd)
 {
 	struct flash_blk_dev *dev;
+	struct flash_blk_ops *tr;
+	struct request *rq = bd->rq;
 
 	dev = hctx->queue->queuedata;
-	if (!dev) {
-		blk_mq_start_request(bd->rq);
+	blk_mq_start_request(rq);
+	if (!dev)
 		return BLK_STS_IOERR;
-	}
 
-	nand_gc_do = 0;
-	spin_lock_irq(&dev->blk_ops->queue_lock);
-	list_add_tail(&bd->rq->queuelist, &dev->blk_ops->rq_list);
-	rkflash_blktrans_work(dev);
-	spin_unlock_irq(&dev->blk_ops->queue_lock);
+	tr = dev->blk_ops;
+	spin_lock_irq(&tr->queue_lock);
+	list_add_tail(&rq->queuelist,
+		      req_op(rq) == REQ_OP_READ ? &tr->rd_list : &tr->wr_list);
+	tr->last_io = jiffies;
+	spin_unlock_irq(&tr->queue_lock);
 
-	/* wake up gc thread */
-	nand_gc_do = 1;
-	wake_up(&nand_gc_thread_wait);
+	wake_up(&tr->io_wait);
 
 	return BLK_STS_OK;
 }
@@ -410,12 +549,23 @@ static int nand_gc_has_work(void)
 	return nand_gc_do;
 }
 
+/*
+ * A gc step holds the ftl for a while, so don't start one while requests are
+ * waiting or the queue was busy recently.
+ */
+static bool nand_gc_should_yield(void)
+{
+	return rkflash_has_request(&mytr) ||
+	       time_before(jiffies, READ_ONCE(mytr.last_io) +
+				    msecs_to_jiffies(gc_idle_ms));
+}
+
 static int nand_gc_do_work(void)
 {
 	int ret = nand_gc_has_work();
 
 	/* do garbage collect at idle state */
-	if (ret) {
+	if (ret && !nand_gc_should_yield()) {
 		mutex_lock(&g_flash_ops_mutex);
 		ret = g_boot_ops->gc();
 		rkflash_print_bio("%s gc result= %d\n", __func__, ret);
@@ -507,13 +657,6 @@ const struct block_device_operations rkflash_blk_trans_ops = {
 	.ioctl = rkflash_blk_ioctl,
 };
 
-static struct flash_blk_ops mytr = {
-	.name =  "rkflash",
-	.major = 31,
-	.minorbits = 0,
-	.owner = THIS_MODULE,
-};
-
 static int rkflash_blk_add_dev(struct flash_blk_dev *dev,
 			       struct flash_blk_ops *blk_ops,
 			       struct flash_part *part)
@@ -613,14 +756,17 @@ static int rkflash_blk_register(struct flash_blk_ops *blk_ops)
 
 	/* Create the request queue */
 	spin_lock_init(&blk_ops->queue_lock);
-	INIT_LIST_HEAD(&blk_ops->rq_list);
+	INIT_LIST_HEAD(&blk_ops->rd_list);
+	INIT_LIST_HEAD(&blk_ops->wr_list);
+	init_waitqueue_head(&blk_ops->io_wait);
 
 	blk_ops->tag_set = kzalloc(sizeof(*blk_ops->tag_set), GFP_KERNEL);
 	if (!blk_ops->tag_set)
 		goto error1;
 
-	blk_ops->rq = blk_mq_init_sq_queue(blk_ops->tag_set, &rkflash_mq_ops, 1,
-					   BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_BLOCKING);
+	blk_ops->rq = blk_mq_init_sq_queue(blk_ops->tag_set, &rkflash_mq_ops,
+					   RKFLASH_QUEUE_DEPTH,
+					   BLK_MQ_F_SHOULD_MERGE);
 	if (IS_ERR(blk_ops->rq)) {
 		ret = PTR_ERR(blk_ops->rq);
 		blk_ops->rq = NULL;
@@ -629,6 +775,13 @@ static int rkflash_blk_register(struct flash_blk_ops *blk_ops)
 
 	blk_ops->rq->queuedata = dev;
 
+	blk_ops->io_thread = kthread_run(rkflash_io_thread, blk_ops, "rkflash_io");
+	if (IS_ERR(blk_ops->io_thread)) {
+		ret = PTR_ERR(blk_ops->io_thread);
+		blk_ops->io_thread = NULL;
+		goto error3;
+	}
+
 	blk_queue_max_hw_sectors(blk_ops->rq, MTD_RW_SECTORS);
 	blk_queue_max_segments(blk_ops->rq, MTD_RW_SECTORS);
 
@@ -639,6 +792,9 @@ static int rkflash_blk_register(struct flash_blk_ops *blk_ops)
 	if (g_flash_type == FLASH_TYPE_SFC_NAND || g_flash_type == FLASH_TYPE_NANDC_NAND)
 		nand_gc_thread = kthread_run(nand_gc_mythread, (void *)blk_ops, "rkflash_gc");
 
+	/* Before the disks show up, partition scanning is part of the boot reads */
+	rkflash_prefetch_init(g_boot_ops, &g_flash_ops_mutex);
+
 	INIT_LIST_HEAD(&blk_ops->devs);
 	g_max_part_num = rk_partition_init(disk_array);
 	if (g_max_part_num) {
@@ -667,6 +823,9 @@ static int rkflash_blk_register(struct flash_blk_ops *blk_ops)
 
 	return 0;
 
+error3:
+	blk_cleanup_queue(blk_ops->rq);
+	blk_mq_free_tag_set(blk_ops->tag_set);
 error2:
 	kfree(blk_ops->tag_set);
 error1:
@@ -686,7 +845,10 @@ static void rkflash_blk_unregister(struct flash_blk_ops *blk_ops)
 
 		rkflash_blk_remove_dev(dev);
 	}
+	/* cleanup drains the queue, stop the dispatcher only after that */
 	blk_cleanup_queue(blk_ops->rq);
+	kthread_stop(blk_ops->io_thread);
+	rkflash_prefetch_exit();
 	unregister_blkdev(blk_ops->major, blk_ops->name);
 }
 
@@ -838,6 +1000,7 @@ void rkflash_dev_shutdown(void)
 	pr_info("rkflash_shutdown...\n");
 	if (g_flash_type == FLASH_TYPE_SFC_NAND || g_flash_type == FLASH_TYPE_NANDC_NAND)
 		kthread_stop(nand_gc_thread);
+	rkflash_prefetch_exit();
 
 	mutex_lock(&g_flash_ops_mutex);
 	g_boot_ops->deinit();
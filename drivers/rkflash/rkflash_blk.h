@@ -27,9 +27,14 @@ struct flash_blk_ops {
 	struct request_queue *rq;
 	spinlock_t queue_lock; /* queue lock */
 
-	/* block-mq */
-	struct list_head rq_list;
+	/* block-mq, reads and writes are dispatched from separate lists */
+	struct list_head rd_list;
+	struct list_head wr_list;
 	struct blk_mq_tag_set *tag_set;
+	struct task_struct *io_thread;
+	wait_queue_head_t io_wait;
+	unsigned int read_burst;
+	unsigned long last_io;
 
 	struct list_head devs;
 	struct module *owner;
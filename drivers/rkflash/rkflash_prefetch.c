@@ -0,0 +1,415 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/* Copyright (c) 2024 Rockchip Electronics Co. Ltd. */
+
+/*
+ * Boot read prefetch.
+ *
+ * The reads issued in the first boot_trace_ms after probe are recorded,
+ * merged into a plan of large extents ordered by first use, and saved in
+ * vendor storage. On the following boots a worker reads the plan back in
+ * big sequential chunks into a RAM cache, which then serves the random
+ * rootfs reads of early init without going through the ftl. The cache is
+ * invalidated by writes and discards, and dropped boot_cache_ms after probe.
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+#include <linux/xarray.h>
+#include <linux/soc/rockchip/rk_vendor_storage.h>
+
+#include "rkflash_prefetch.h"
+
+static bool boot_prefetch;
+module_param(boot_prefetch, bool, 0444);
+MODULE_PARM_DESC(boot_prefetch, "record and replay the boot read sequence");
+
+static unsigned int boot_trace_ms = 20000;
+module_param(boot_trace_ms, uint, 0444);
+MODULE_PARM_DESC(boot_trace_ms, "time in ms after probe the boot reads are recorded");
+
+static unsigned int boot_cache_ms = 60000;
+module_param(boot_cache_ms, uint, 0444);
+MODULE_PARM_DESC(boot_cache_ms, "time in ms after probe the prefetch cache is dropped");
+
+static unsigned int boot_cache_mb = 32;
+module_param(boot_cache_mb, uint, 0444);
+MODULE_PARM_DESC(boot_cache_mb, "max memory in MB used by the prefetch cache");
+
+#define RKFLASH_PLAN_VENDOR_ID		0x100
+#define RKFLASH_PLAN_MAGIC		0x4e4c5042	/* "BPLN" */
+#define RKFLASH_PLAN_SIZE		4096
+#define RKFLASH_PLAN_MAX_EXT		((RKFLASH_PLAN_SIZE - sizeof(struct rkflash_plan)) / \
+					 sizeof(struct rkflash_plan_ext))
+/* Gap merged into one extent, doubled until the plan fits */
+#define RKFLASH_PLAN_MIN_GAP		64
+#define RKFLASH_TRACE_MAX		8192
+/* A replay hitting less than this (percent) is recorded again */
+#define RKFLASH_PLAN_REFRESH_PCT	80
+#define RKFLASH_PF_CHUNK_SECTORS	256
+#define RKFLASH_PAGE_SECTORS		(PAGE_SIZE >> 9)
+
+struct rkflash_plan_ext {
+	u32 start;
+	u32 nsec;
+};
+
+struct rkflash_plan {
+	u32 magic;
+	u32 capacity;
+	u32 count;
+	u32 reserved;
+	struct rkflash_plan_ext ext[];
+};
+
+struct rkflash_trace_ent {
+	u32 start;
+	u32 end;
+	u32 seq;
+};
+
+static struct {
+	const struct flash_boot_ops *ops;
+	struct mutex *lock;		/* the flash ops lock, guards all below */
+	struct rkflash_plan *plan;	/* plan being replayed */
+	struct rkflash_trace_ent *trace;
+	u32 trace_num;
+	bool tracing;
+	struct xarray cache;		/* page index -> struct page */
+	bool caching;
+	unsigned long cached_pages;
+	unsigned long max_pages;
+	unsigned long hits;
+	unsigned long misses;
+	struct work_struct fill_work;
+	struct delayed_work trace_work;
+	struct delayed_work drop_work;
+} pf;
+
+static void rkflash_prefetch_drop(void)
+{
+	struct page *page;
+	unsigned long idx;
+
+	xa_for_each(&pf.cache, idx, page) {
+		xa_erase(&pf.cache, idx);
+		__free_page(page);
+	}
+	pf.cached_pages = 0;
+	pf.caching = false;
+}
+
+bool rkflash_prefetch_read(u32 sec, u32 n_sec, void *p_data)
+{
+	struct rkflash_trace_ent *last;
+	unsigned long idx, first;
+	struct page *page;
+
+	if (pf.tracing) {
+		last = pf.trace_num ? &pf.trace[pf.trace_num - 1] : NULL;
+		if (last && last->end == sec) {
+			last->end += n_sec;
+		} else if (pf.trace_num < RKFLASH_TRACE_MAX) {
+			pf.trace[pf.trace_num].start = sec;
+			pf.trace[pf.trace_num].end = sec + n_sec;
+			pf.trace_num++;
+		}
+	}
+
+	if (!pf.caching)
+		return false;
+
+	if (!IS_ALIGNED(sec | n_sec, RKFLASH_PAGE_SECTORS))
+		goto miss;
+
+	first = sec / RKFLASH_PAGE_SECTORS;
+	for (idx = first; idx < first + n_sec / RKFLASH_PAGE_SECTORS; idx++)
+		if (!xa_load(&pf.cache, idx))
+			goto miss;
+
+	for (idx = first; idx < first + n_sec / RKFLASH_PAGE_SECTORS; idx++) {
+		page = xa_load(&pf.cache, idx);
+		memcpy(p_data, page_address(page), PAGE_SIZE);
+		p_data += PAGE_SIZE;
+	}
+	pf.hits++;
+
+	return true;
+
+miss:
+	pf.misses++;
+	return false;
+}
+
+void rkflash_prefetch_invalidate(u32 sec, u32 n_sec)
+{
+	struct page *page;
+	unsigned long idx;
+
+	if (!pf.caching || !n_sec)
+		return;
+
+	xa_for_each_range(&pf.cache, idx, page, sec / RKFLASH_PAGE_SECTORS,
+			  ((u64)sec + n_sec - 1) / RKFLASH_PAGE_SECTORS) {
+		xa_erase(&pf.cache, idx);
+		__free_page(page);
+		pf.cached_pages--;
+	}
+}
+
+/* Read one chunk of the plan into the cache, returns false to stop */
+static bool rkflash_prefetch_chunk(u32 sec, u32 n_sec, void *buf)
+{
+	struct page *pages[RKFLASH_PF_CHUNK_SECTORS / RKFLASH_PAGE_SECTORS];
+	u32 i, n = n_sec / RKFLASH_PAGE_SECTORS;
+	bool more = true;
+
+	/* Allocate with the lock dropped, reclaim may write back to us */
+	for (i = 0; i < n; i++) {
+		pages[i] = alloc_page(GFP_KERNEL | __GFP_NOWARN);
+		if (!pages[i])
+			break;
+	}
+	if (i < n) {
+		more = false;
+		goto free;
+	}
+
+	mutex_lock(pf.lock);
+	if (!pf.caching || pf.cached_pages + n > pf.max_pages) {
+		more = false;
+	} else if (!pf.ops->read(sec, n_sec, buf)) {
+		for (i = 0; i < n; i++) {
+			memcpy(page_address(pages[i]), buf + i * PAGE_SIZE, PAGE_SIZE);
+			if (!xa_insert(&pf.cache, sec / RKFLASH_PAGE_SECTORS + i,
+				       pages[i], GFP_NOIO)) {
+				pages[i] = NULL;
+				pf.cached_pages++;
+			}
+		}
+	}
+	mutex_unlock(pf.lock);
+
+	i = n;
+free:
+	while (i--)
+		if (pages[i])
+			__free_page(pages[i]);
+
+	return more;
+}
+
+static void rkflash_prefetch_fill(struct work_struct *work)
+{
+	struct rkflash_plan *plan = pf.plan;
+	u32 i, sec, end, n, capacity = pf.ops->get_capacity();
+	void *buf;
+
+	buf = kmalloc(RKFLASH_PF_CHUNK_SECTORS * 512, GFP_KERNEL | GFP_DMA);
+	if (!buf)
+		return;
+
+	for (i = 0; i < plan->count; i++) {
+		sec = round_down(plan->ext[i].start, RKFLASH_PAGE_SECTORS);
+		end = min_t(u64, round_up((u64)plan->ext[i].start + plan->ext[i].nsec,
+					  RKFLASH_PAGE_SECTORS),
+			    round_down(capacity, RKFLASH_PAGE_SECTORS));
+		for (; sec < end; sec += n) {
+			n = min_t(u32, end - sec, RKFLASH_PF_CHUNK_SECTORS);
+			if (!rkflash_prefetch_chunk(sec, n, buf))
+				goto out;
+			cond_resched();
+		}
+	}
+out:
+	kfree(buf);
+	pr_info("rkflash: boot prefetch cached %lu KB\n",
+		pf.cached_pages * (PAGE_SIZE >> 10));
+}
+
+static int rkflash_trace_cmp_start(const void *a, const void *b)
+{
+	const struct rkflash_trace_ent *x = a, *y = b;
+
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static int rkflash_trace_cmp_seq(const void *a, const void *b)
+{
+	const struct rkflash_trace_ent *x = a, *y = b;
+
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+/*
+ * Merge the recorded reads (sorted by start) that lie within @gap sectors of
+ * each other into @out, keeping the earliest use of each merged extent.
+ */
+static u32 rkflash_plan_merge(const struct rkflash_trace_ent *in, u32 num,
+			      struct rkflash_trace_ent *out, u32 gap)
+{
+	u32 i, n = 0;
+
+	for (i = 0; i < num; i++) {
+		if (n && in[i].start <= out[n - 1].end + gap) {
+			out[n - 1].end = max(out[n - 1].end, in[i].end);
+			out[n - 1].seq = min(out[n - 1].seq, in[i].seq);
+		} else {
+			out[n++] = in[i];
+		}
+	}
+
+	return n;
+}
+
+static void rkflash_prefetch_save(struct work_struct *work)
+{
+	struct rkflash_trace_ent *trace, *merged;
+	struct rkflash_plan *plan;
+	u32 i, num, n, gap = RKFLASH_PLAN_MIN_GAP;
+	unsigned long hits, reads;
+
+	mutex_lock(pf.lock);
+	pf.tracing = false;
+	trace = pf.trace;
+	num = pf.trace_num;
+	pf.trace = NULL;
+	hits = pf.hits;
+	reads = pf.hits + pf.misses;
+	mutex_unlock(pf.lock);
+
+	/* The plan replayed this boot is still good, spare the vendor area */
+	if (pf.plan && reads && hits * 100 >= reads * RKFLASH_PLAN_REFRESH_PCT)
+		goto free;
+
+	if (!num)
+		goto free;
+
+	merged = kvmalloc_array(num, sizeof(*merged), GFP_KERNEL);
+	plan = kzalloc(RKFLASH_PLAN_SIZE, GFP_KERNEL);
+	if (!merged || !plan)
+		goto free_plan;
+
+	for (i = 0; i < num; i++)
+		trace[i].seq = i;
+	sort(trace, num, sizeof(*trace), rkflash_trace_cmp_start, NULL);
+	while ((n = rkflash_plan_merge(trace, num, merged, gap)) > RKFLASH_PLAN_MAX_EXT)
+		gap *= 2;
+	sort(merged, n, sizeof(*merged), rkflash_trace_cmp_seq, NULL);
+
+	plan->magic = RKFLASH_PLAN_MAGIC;
+	plan->capacity = pf.ops->get_capacity();
+	plan->count = n;
+	for (i = 0; i < n; i++) {
+		plan->ext[i].start = merged[i].start;
+		plan->ext[i].nsec = merged[i].end - merged[i].start;
+	}
+
+	if (rk_vendor_write(RKFLASH_PLAN_VENDOR_ID, plan, RKFLASH_PLAN_SIZE) < 0)
+		pr_err("rkflash: save boot prefetch plan failed\n");
+	else
+		pr_info("rkflash: boot prefetch plan saved, %u extents\n", n);
+
+free_plan:
+	kfree(plan);
+	kvfree(merged);
+free:
+	kvfree(trace);
+}
+
+static void rkflash_prefetch_expire(struct work_struct *work)
+{
+	/* Stop the fill at its next chunk before dropping */
+	mutex_lock(pf.lock);
+	pf.caching = false;
+	mutex_unlock(pf.lock);
+	cancel_work_sync(&pf.fill_work);
+
+	mutex_lock(pf.lock);
+	pr_info("rkflash: boot prefetch %lu hits, %lu misses\n", pf.hits, pf.misses);
+	rkflash_prefetch_drop();
+	mutex_unlock(pf.lock);
+}
+
+static struct rkflash_plan *rkflash_prefetch_load(void)
+{
+	struct rkflash_plan *plan;
+	int ret;
+
+	plan = kzalloc(RKFLASH_PLAN_SIZE, GFP_KERNEL);
+	if (!plan)
+		return NULL;
+
+	ret = rk_vendor_read(RKFLASH_PLAN_VENDOR_ID, plan, RKFLASH_PLAN_SIZE);
+	if (ret < (int)sizeof(*plan) || plan->magic != RKFLASH_PLAN_MAGIC ||
+	    plan->capacity != pf.ops->get_capacity() ||
+	    plan->count > RKFLASH_PLAN_MAX_EXT) {
+		kfree(plan);
+		return NULL;
+	}
+
+	return plan;
+}
+
+void rkflash_prefetch_init(const struct flash_boot_ops *ops, struct mutex *lock)
+{
+	if (!boot_prefetch || !is_rk_vendor_ready())
+		return;
+
+	pf.ops = ops;
+	pf.lock = lock;
+	xa_init(&pf.cache);
+	INIT_WORK(&pf.fill_work, rkflash_prefetch_fill);
+	INIT_DELAYED_WORK(&pf.trace_work, rkflash_prefetch_save);
+	INIT_DELAYED_WORK(&pf.drop_work, rkflash_prefetch_expire);
+
+	pf.trace = kvmalloc_array(RKFLASH_TRACE_MAX, sizeof(*pf.trace), GFP_KERNEL);
+	if (pf.trace) {
+		pf.tracing = true;
+		schedule_delayed_work(&pf.trace_work, msecs_to_jiffies(boot_trace_ms));
+	}
+
+	pf.plan = rkflash_prefetch_load();
+	if (pf.plan) {
+		pf.max_pages = (unsigned long)boot_cache_mb << (20 - PAGE_SHIFT);
+		pf.caching = true;
+		queue_work(system_unbound_wq, &pf.fill_work);
+		schedule_delayed_work(&pf.drop_work, msecs_to_jiffies(boot_cache_ms));
+		pr_info("rkflash: boot prefetch replaying %u extents\n", pf.plan->count);
+	}
+}
+
+void rkflash_prefetch_exit(void)
+{
+	if (!pf.ops)
+		return;
+
+	cancel_delayed_work_sync(&pf.trace_work);
+	cancel_delayed_work_sync(&pf.drop_work);
+	cancel_work_sync(&pf.fill_work);
+
+	mutex_lock(pf.lock);
+	rkflash_prefetch_drop();
+	pf.tracing = false;
+	mutex_unlock(pf.lock);
+
+	kvfree(pf.trace);
+	pf.trace = NULL;
+	kfree(pf.plan);
+	pf.plan = NULL;
+	pf.ops = NULL;
+}
+
+void rkflash_prefetch_show(struct seq_file *m)
+{
+	if (!pf.ops)
+		return;
+
+	seq_printf(m, "boot prefetch plan %u extents, cached %lu KB\n",
+		   pf.plan ? pf.plan->count : 0, pf.cached_pages * (PAGE_SIZE >> 10));
+	seq_printf(m, "boot prefetch hits %lu misses %lu\n", pf.hits, pf.misses);
+}
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* Copyright (c) 2024 Rockchip Electronics Co. Ltd. */
+
+#ifndef __RKFLASH_PREFETCH_H
+#define __RKFLASH_PREFETCH_H
+
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include "rkflash_api.h"
+
+void rkflash_prefetch_init(const struct flash_boot_ops *ops, struct mutex *lock);
+void rkflash_prefetch_exit(void);
+void rkflash_prefetch_show(struct seq_file *m);
+
+/* Called with the flash ops lock held, sectors are absolute */
+bool rkflash_prefetch_read(u32 sec, u32 n_sec, void *p_data);
+void rkflash_prefetch_invalidate(u32 sec, u32 n_sec);
+
+#endif
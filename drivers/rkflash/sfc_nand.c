@@ -87,15 +87,15 @@ static struct nand_info spi_nand_tbl[] = {
 	{ 0xC8, 0xF4, 0x00, 4, 0x40, 2, 2048, 0x0C, 20, 0x8, 1, { 0x04, 0x08, 0x14, 0x18 }, &sfc_nand_get_ecc_status0 },
 
 	/* W25N01GV */
-	{ 0xEF, 0xAA, 0x21, 4, 0x40, 1, 1024, 0x4C, 18, 0x1, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status1 },
+	{ 0xEF, 0xAA, 0x21, 4, 0x40, 1, 1024, 0xCC, 18, 0x1, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status1 },
 	/* W25N02KVZEIR */
-	{ 0xEF, 0xAA, 0x22, 4, 0x40, 1, 2048, 0x4C, 19, 0x8, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status0 },
+	{ 0xEF, 0xAA, 0x22, 4, 0x40, 1, 2048, 0xCC, 19, 0x8, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status0 },
 	/* W25N04KVZEIR */
-	{ 0xEF, 0xAA, 0x23, 4, 0x40, 1, 4096, 0x4C, 20, 0x8, 0, { 0x04, 0x14, 0x24, 0x34 }, &sfc_nand_get_ecc_status0 },
+	{ 0xEF, 0xAA, 0x23, 4, 0x40, 1, 4096, 0xCC, 20, 0x8, 0, { 0x04, 0x14, 0x24, 0x34 }, &sfc_nand_get_ecc_status0 },
 	/* W25N01GW */
-	{ 0xEF, 0xBA, 0x21, 4, 0x40, 1, 1024, 0x4C, 18, 0x1, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status1 },
+	{ 0xEF, 0xBA, 0x21, 4, 0x40, 1, 1024, 0xCC, 18, 0x1, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status1 },
 	/* W25N02KW */
-	{ 0xEF, 0xBA, 0x22, 4, 0x40, 1, 2048, 0x4C, 19, 0x8, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status0 },
+	{ 0xEF, 0xBA, 0x22, 4, 0x40, 1, 2048, 0xCC, 19, 0x8, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status0 },
 	/* W25N512GVEIG */
 	{ 0xEF, 0xAA, 0x20, 4, 0x40, 1, 512, 0x4C, 17, 0x1, 0, { 0x04, 0x14, 0x24, 0xFF }, &sfc_nand_get_ecc_status1 },
 	/* W25N01KV */
@@ -959,6 +959,88 @@ u32 sfc_nand_read(u32 row, u32 *p_page_buf, u32 column, u32 len)
 	return ecc_result;
 }
 
+/*
+ * Continuous read (Winbond BUF = 0): after one page read to cache the device
+ * keeps loading the following pages on its own and a single read from cache
+ * streams the main area of all of them, with no command or address phase per
+ * page. The spare area isn't output and the ecc status covers the worst page
+ * of the whole run.
+ */
+static int sfc_nand_set_cont_read(bool enable)
+{
+	int ret;
+	u8 status;
+
+	ret = sfc_nand_read_feature(0xB0, &status);
+	if (ret != SFC_OK)
+		return ret;
+
+	if (enable)
+		status &= ~(1 << 3);
+	else
+		status |= (1 << 3);
+
+	return sfc_nand_write_feature(0xB0, status);
+}
+
+bool sfc_nand_support_cont_read(void)
+{
+	/* a whole run goes out as one transfer, needs the v4 length register */
+	return p_nand_info && p_nand_info->feature & FEA_CONT_READ &&
+	       p_nand_info->plane_per_die == 1 &&
+	       sfc_get_version() >= SFC_VER_4;
+}
+
+/* p_data must be dma capable and hold pages * page data size bytes */
+u32 sfc_nand_read_cont(u32 row, u32 *p_data, u32 pages)
+{
+	int ret;
+	struct rk_sfc_op op;
+	u32 ecc_result;
+	u8 status;
+	u32 data_size = SFC_NAND_SECTOR_SIZE * p_nand_info->sec_per_page;
+
+	if (!sfc_nand_support_cont_read())
+		return SFC_NAND_HW_ERROR;
+
+	if (sfc_nand_set_cont_read(true) != SFC_OK)
+		return SFC_NAND_HW_ERROR;
+
+	op.sfcmd.d32 = 0;
+	op.sfcmd.b.cmd = 0x13;
+	op.sfcmd.b.rw = SFC_WRITE;
+	op.sfcmd.b.addrbits = SFC_ADDR_24BITS;
+
+	op.sfctrl.d32 = 0;
+
+	sfc_request(&op, row, p_data, 0);
+	sfc_nand_wait_busy_sleep(&status, 1000 * 1000, 50);
+
+	/* column address is replaced by dummy bytes in continuous mode */
+	op.sfcmd.d32 = 0;
+	op.sfcmd.b.cmd = sfc_nand_dev.page_read_cmd;
+	op.sfcmd.b.addrbits = SFC_ADDR_24BITS;
+	if (sfc_nand_dev.page_read_cmd != 0x03)
+		op.sfcmd.b.dummybits = 8;
+
+	op.sfctrl.d32 = 0;
+	op.sfctrl.b.datalines = sfc_nand_dev.read_lines;
+	op.sfctrl.b.enbledma = 1;
+
+	ret = sfc_request(&op, 0, p_data, pages * data_size);
+
+	/* CS# high ends the run, the device may still be loading a page */
+	sfc_nand_wait_busy_sleep(&status, 1000 * 1000, 50);
+	ecc_result = p_nand_info->ecc_status();
+	sfc_nand_set_cont_read(false);
+	rkflash_print_dio("%s %x %x %x\n", __func__, row, pages, p_data[0]);
+
+	if (ret != SFC_OK)
+		return SFC_NAND_HW_ERROR;
+
+	return ecc_result;
+}
+
 u32 sfc_nand_read_page_raw(u8 cs, u32 addr, u32 *p_page_buf)
 {
 	u32 page_size = SFC_NAND_SECTOR_FULL_SIZE * p_nand_info->sec_per_page;
@@ -27,6 +27,7 @@
 #define FEA_4BYTE_ADDR          BIT(4)
 #define FEA_4BYTE_ADDR_MODE	BIT(5)
 #define FEA_SOFT_QOP_BIT	BIT(6)
+#define FEA_CONT_READ		BIT(7)
 
 /* Command Set */
 #define CMD_READ_JEDECID        (0x9F)
@@ -129,5 +130,7 @@ void sfc_nand_ftl_ops_init(void);
 struct SFNAND_DEV *sfc_nand_get_private_dev(void);
 struct nand_info *sfc_nand_get_nand_info(void);
 u32 sfc_nand_read(u32 row, u32 *p_page_buf, u32 column, u32 len);
+bool sfc_nand_support_cont_read(void);
+u32 sfc_nand_read_cont(u32 row, u32 *p_data, u32 pages);
 
 #endif
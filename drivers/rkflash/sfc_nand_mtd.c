@@ -6,6 +6,7 @@
 #include <linux/mtd/cfi.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/partitions.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 
@@ -18,6 +19,8 @@
 
 static struct mtd_partition nand_parts[MAX_PART_COUNT];
 
+#define SFC_NAND_CONT_BUF_SIZE	SZ_64K
+
 static inline struct snand_mtd_dev *mtd_to_priv(struct mtd_info *ptr_mtd)
 {
 	return (struct snand_mtd_dev *)((char *)ptr_mtd -
@@ -84,6 +87,7 @@ static int sfc_nand_read_mtd(struct mtd_info *mtd, loff_t from,
 	bool ecc_failed = false;
 	size_t page, off, real_size;
 	int max_bitflips = 0;
+	struct snand_mtd_dev *p_dev = mtd_to_priv(mtd);
 
 	rkflash_print_dio("%s addr= %llx len= %x\n", __func__, from, (u32)remaining);
 	if ((from + remaining) > mtd->size || ops->ooblen) {
@@ -99,6 +103,38 @@ static int sfc_nand_read_mtd(struct mtd_info *mtd, loff_t from,
 		off = from & mtd->writesize_mask;
 		real_size = min_t(u32, remaining, mtd->writesize - off);
 
+		/* stream whole pages up to the end of the block in one go */
+		if (p_dev->cont_buf && !off && remaining >= 2 * mtd->writesize) {
+			size_t pages, blk_left;
+
+			pages = min_t(size_t, remaining >> mtd->writesize_shift,
+				      SFC_NAND_CONT_BUF_SIZE >> mtd->writesize_shift);
+			blk_left = (mtd->erasesize - (from & mtd->erasesize_mask)) >>
+				   mtd->writesize_shift;
+			pages = min(pages, blk_left);
+
+			if (pages > 1)
+				ret = sfc_nand_read_cont(page, (u32 *)p_dev->cont_buf, pages);
+			else
+				ret = SFC_NAND_HW_ERROR;
+
+			/* on failure fall back to page reads so each page gets its own ecc */
+			if (ret == SFC_NAND_ECC_OK || ret == SFC_NAND_ECC_REFRESH) {
+				if (ret == SFC_NAND_ECC_REFRESH) {
+					mtd->ecc_stats.corrected += 1;
+					max_bitflips = 1;
+				}
+				real_size = pages << mtd->writesize_shift;
+				memcpy(data, p_dev->cont_buf, real_size);
+				ret = 0;
+				data += real_size;
+				ops->retlen += real_size;
+				remaining -= real_size;
+				from += real_size;
+				continue;
+			}
+		}
+
 		ret = sfc_nand_read(page, (u32 *)data, off, real_size);
 		if (ret == SFC_NAND_HW_ERROR) {
 			rkflash_print_error("%s addr %llx ret= %d\n",
@@ -382,6 +418,13 @@ int sfc_nand_mtd_init(struct SFNAND_DEV *p_dev, struct mutex *lock)
 		goto error_out;
 	}
 
+	if (sfc_nand_support_cont_read()) {
+		nand->cont_buf = (u8 *)__get_free_pages(GFP_KERNEL | GFP_DMA32,
+							get_order(SFC_NAND_CONT_BUF_SIZE));
+		if (!nand->cont_buf)
+			rkflash_print_info("%s no continuous read buffer\n", __func__);
+	}
+
 	nand->bbt.option |= NANDDEV_BBT_USE_FLASH;
 	ret = snanddev_bbt_init(nand);
 	if (ret) {
@@ -413,6 +456,8 @@ int sfc_nand_mtd_init(struct SFNAND_DEV *p_dev, struct mutex *lock)
 		return 0;
 	}
 
+	if (nand->cont_buf)
+		free_pages((unsigned long)nand->cont_buf, get_order(SFC_NAND_CONT_BUF_SIZE));
 	kfree(nand->dma_buf);
 error_out:
 	kfree(nand);
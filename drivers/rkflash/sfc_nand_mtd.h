@@ -37,6 +37,7 @@ struct snand_mtd_dev {
 	struct mutex	*lock; /* to lock this object */
 	struct mtd_info mtd;
 	u8 *dma_buf;
+	u8 *cont_buf;	/* continuous read bounce, NULL if unsupported */
 	struct snand_bbt bbt;
 };
 
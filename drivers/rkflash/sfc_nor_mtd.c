@@ -6,6 +6,8 @@
 #include <linux/mtd/cfi.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/partitions.h>
+#include <linux/mm.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 
@@ -21,7 +23,17 @@ struct snor_mtd_dev {
 
 static struct mtd_partition nor_parts[MAX_PART_COUNT];
 
-#define SFC_NOR_MTD_DMA_MAX 8192
+#define SFC_NOR_MTD_DMA_MAX SZ_64K
+
+/*
+ * Linear, cache line aligned kernel buffers can take the dma directly, which
+ * saves the bounce copy on large sequential reads (kernel, rootfs images).
+ */
+static bool sfc_mtd_buf_dma_capable(const void *buf, size_t len)
+{
+	return virt_addr_valid(buf) && virt_addr_valid(buf + len - 1) &&
+	       IS_ALIGNED((unsigned long)buf | len, ARCH_DMA_MINALIGN);
+}
 
 static inline struct snor_mtd_dev *mtd_to_priv(struct mtd_info *ptr_mtd)
 {
@@ -131,10 +143,11 @@ static int sfc_write_mtd(struct mtd_info *mtd, loff_t to, size_t len,
 static int sfc_read_mtd(struct mtd_info *mtd, loff_t from, size_t len,
 			size_t *retlen, u_char *buf)
 {
-	u32 addr, size, chunk;
+	u32 addr, size, chunk, max_chunk;
 	u8 *p_buf =  (u8 *)buf;
 	int ret = SFC_OK;
 	struct snor_mtd_dev *p_dev = mtd_to_priv(mtd);
+	bool direct;
 
 	rkflash_print_dio("%s addr= %llx len= %x\n", __func__, from, (u32)len);
 	if ((from + len) > mtd->size)
@@ -145,16 +158,26 @@ static int sfc_read_mtd(struct mtd_info *mtd, loff_t from, size_t len,
 	addr = from;
 	size = len;
 
+	if (sfc_mtd_buf_dma_capable(buf, len)) {
+		max_chunk = p_dev->snor->max_iosize;
+		direct = true;
+	} else {
+		max_chunk = min_t(u32, p_dev->snor->max_iosize, SFC_NOR_MTD_DMA_MAX);
+		direct = false;
+	}
+
 	while (size > 0) {
-		chunk = (size < SFC_NOR_MTD_DMA_MAX) ? size : SFC_NOR_MTD_DMA_MAX;
-		ret = snor_read_data(p_dev->snor, addr, p_dev->dma_buf, chunk);
+		chunk = (size < max_chunk) ? size : max_chunk;
+		ret = snor_read_data(p_dev->snor, addr,
+				     direct ? p_buf : p_dev->dma_buf, chunk);
 		if (ret != SFC_OK) {
 			rkflash_print_error("snor_read_data %x ret=%d\n", addr, ret);
 			*retlen = len - size;
 			mutex_unlock(p_dev->lock);
 			return ret;
 		}
-		memcpy(p_buf, p_dev->dma_buf, chunk);
+		if (!direct)
+			memcpy(p_buf, p_dev->dma_buf, chunk);
 		size -= chunk;
 		addr += chunk;
 		p_buf += chunk;
@@ -100,6 +100,13 @@ struct rockchip_pmu_info {
 
 #define SHAPING_NBPKTMAX0	0x0
 
+/* max domains powered on by one rockchip_pmu_pd_on_batch() call */
+#define MAX_BATCH_DOMAINS	16
+
+static const u32 qos_reg_offsets[MAX_QOS_REGS_NUM] = {
+	QOS_PRIORITY, QOS_MODE, QOS_BANDWIDTH, QOS_SATURATION, QOS_EXTCONTROL,
+};
+
 struct rockchip_pm_domain {
 	struct generic_pm_domain genpd;
 	const struct rockchip_domain_info *info;
@@ -109,6 +116,8 @@ struct rockchip_pm_domain {
 	struct regmap **qos_regmap;
 	struct regmap **shaping_regmap;
 	u32 *qos_save_regs[MAX_QOS_REGS_NUM];
+	u32 *qos_reset_regs[MAX_QOS_REGS_NUM];
+	u32 *qos_prio_save_regs;
 	u32 *shaping_save_regs;
 	bool *qos_is_need_init[MAX_QOS_REGS_NUM];
 	bool *shaping_is_need_init;
@@ -117,7 +126,9 @@ struct rockchip_pm_domain {
 	bool is_always_on;
 	bool is_ignore_pwr;
 	bool is_qos_saved;
+	bool is_qos_reset_valid;
 	bool is_qos_need_init;
+	bool is_qos_prio_raised;
 	bool is_shaping_need_init;
 	struct regulator *supply;
 };
@@ -749,6 +760,32 @@ static int rockchip_pmu_restore_qos(struct rockchip_pm_domain *pd)
 	return rockchip_pmu_restore_shaping(pd);
 }
 
+/*
+ * Restore the qos right after the domain came out of power off: the noc
+ * registers are at their reset values, which are read once at the first
+ * power on, so only the registers saved with another value are written.
+ */
+static int rockchip_pmu_restore_qos_from_reset(struct rockchip_pm_domain *pd)
+{
+	int i, j;
+
+	if (!pd->is_qos_reset_valid) {
+		for (i = 0; i < pd->num_qos; i++)
+			for (j = 0; j < MAX_QOS_REGS_NUM; j++)
+				regmap_read(pd->qos_regmap[i], qos_reg_offsets[j],
+					    &pd->qos_reset_regs[j][i]);
+		pd->is_qos_reset_valid = true;
+	}
+
+	for (i = 0; i < pd->num_qos; i++)
+		for (j = 0; j < MAX_QOS_REGS_NUM; j++)
+			if (pd->qos_save_regs[j][i] != pd->qos_reset_regs[j][i])
+				regmap_write(pd->qos_regmap[i], qos_reg_offsets[j],
+					     pd->qos_save_regs[j][i]);
+
+	return rockchip_pmu_restore_shaping(pd);
+}
+
 static void rockchip_pmu_init_qos(struct rockchip_pm_domain *pd)
 {
 	int i;
@@ -836,6 +873,90 @@ int rockchip_restore_qos(struct device *dev)
 }
 EXPORT_SYMBOL(rockchip_restore_qos);
 
+/*
+ * rockchip_raise_qos_priority - temporarily override the noc priority of
+ * all the masters of the power domain of @dev, e.g. for a display device
+ * close to underflow. The priority found at the first raise is restored
+ * by rockchip_reset_qos_priority().
+ */
+int rockchip_raise_qos_priority(struct device *dev, u32 priority)
+{
+	struct generic_pm_domain *genpd;
+	struct rockchip_pm_domain *pd;
+	int i, ret = 0;
+
+	if (IS_ERR_OR_NULL(dev))
+		return -EINVAL;
+
+	if (IS_ERR_OR_NULL(dev->pm_domain))
+		return -EINVAL;
+
+	genpd = pd_to_genpd(dev->pm_domain);
+	pd = to_rockchip_pd(genpd);
+
+	if (!pd->num_qos)
+		return -ENODEV;
+
+	rockchip_pmu_lock(pd);
+
+	/* the noc registers of a domain that is off can't be accessed */
+	if (!rockchip_pmu_domain_is_on(pd)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	for (i = 0; i < pd->num_qos; i++) {
+		if (!pd->is_qos_prio_raised)
+			regmap_read(pd->qos_regmap[i], QOS_PRIORITY,
+				    &pd->qos_prio_save_regs[i]);
+		regmap_write(pd->qos_regmap[i], QOS_PRIORITY, priority);
+	}
+	pd->is_qos_prio_raised = true;
+
+out:
+	rockchip_pmu_unlock(pd);
+
+	return ret;
+}
+EXPORT_SYMBOL(rockchip_raise_qos_priority);
+
+int rockchip_reset_qos_priority(struct device *dev)
+{
+	struct generic_pm_domain *genpd;
+	struct rockchip_pm_domain *pd;
+	int i;
+
+	if (IS_ERR_OR_NULL(dev))
+		return -EINVAL;
+
+	if (IS_ERR_OR_NULL(dev->pm_domain))
+		return -EINVAL;
+
+	genpd = pd_to_genpd(dev->pm_domain);
+	pd = to_rockchip_pd(genpd);
+
+	rockchip_pmu_lock(pd);
+
+	if (pd->is_qos_prio_raised) {
+		bool on = rockchip_pmu_domain_is_on(pd);
+
+		for (i = 0; i < pd->num_qos; i++) {
+			/* a raised priority saved at power off must not come back */
+			if (pd->is_qos_saved)
+				pd->qos_save_regs[0][i] = pd->qos_prio_save_regs[i];
+			if (on)
+				regmap_write(pd->qos_regmap[i], QOS_PRIORITY,
+					     pd->qos_prio_save_regs[i]);
+		}
+		pd->is_qos_prio_raised = false;
+	}
+
+	rockchip_pmu_unlock(pd);
+
+	return 0;
+}
+EXPORT_SYMBOL(rockchip_reset_qos_priority);
+
 static bool rockchip_pmu_domain_is_mem_on(struct rockchip_pm_domain *pd)
 {
 	struct rockchip_pmu *pmu = pd->pmu;
@@ -1049,7 +1170,7 @@ static int rockchip_pd_power(struct rockchip_pm_domain *pd, bool power_on)
 			if (pd->info->delay_us)
 				udelay(pd->info->delay_us);
 			if (pd->is_qos_saved)
-				rockchip_pmu_restore_qos(pd);
+				rockchip_pmu_restore_qos_from_reset(pd);
 			if (pd->is_qos_need_init || pd->is_shaping_need_init)
 				rockchip_pmu_init_qos(pd);
 		}
@@ -1122,6 +1243,249 @@ int rockchip_pmu_pd_off(struct device *dev)
 }
 EXPORT_SYMBOL(rockchip_pmu_pd_off);
 
+static bool rockchip_pd_parents_are_on(struct rockchip_pm_domain *pd)
+{
+	struct gpd_link *link;
+
+	list_for_each_entry(link, &pd->genpd.child_links, child_node)
+		if (!rockchip_pmu_domain_is_on(to_rockchip_pd(link->parent)))
+			return false;
+
+	return true;
+}
+
+static bool rockchip_pd_batch_is_on(struct rockchip_pm_domain **pds, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (pds[i]->info->pwr_mask && !rockchip_pmu_domain_is_on(pds[i]))
+			return false;
+
+	return true;
+}
+
+static bool rockchip_pd_batch_is_active(struct rockchip_pm_domain **pds,
+					int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (pds[i]->info->req_mask && rockchip_pmu_domain_is_idle(pds[i]))
+			return false;
+
+	return true;
+}
+
+/*
+ * Write the power (@pwr true) or idle request (@pwr false) bits of all
+ * the domains that share a register with a single write.
+ */
+static void rockchip_pd_batch_write(struct rockchip_pm_domain **pds, int num,
+				    bool pwr)
+{
+	struct rockchip_pmu *pmu = pds[0]->pmu;
+	u32 done = 0;
+	int i, j;
+
+	for (i = 0; i < num; i++) {
+		const struct rockchip_domain_info *info = pds[i]->info;
+		u32 offset = pwr ? info->pwr_offset : info->req_offset;
+		bool w_mask = pwr ? info->pwr_w_mask : info->req_w_mask;
+		u32 mask = 0, wmask = 0;
+
+		if (done & BIT(i))
+			continue;
+
+		for (j = i; j < num; j++) {
+			const struct rockchip_domain_info *o = pds[j]->info;
+
+			if ((pwr ? o->pwr_offset : o->req_offset) != offset ||
+			    !(pwr ? o->pwr_w_mask : o->req_w_mask) != !w_mask)
+				continue;
+			mask |= pwr ? o->pwr_mask : o->req_mask;
+			wmask |= pwr ? o->pwr_w_mask : o->req_w_mask;
+			done |= BIT(j);
+		}
+
+		if (!mask)
+			continue;
+		offset += pwr ? pmu->info->pwr_offset : pmu->info->req_offset;
+		if (w_mask)
+			regmap_write(pmu->regmap, offset, wmask);
+		else
+			regmap_update_bits(pmu->regmap, offset, mask, 0);
+	}
+
+	wmb();
+}
+
+/*
+ * Power on domains that are off and whose parents are on, with one write
+ * per pmu register and a single wait for all the acks, instead of one
+ * domain after the other. Called with the pmu lock held.
+ */
+static int rockchip_pd_power_on_batch(struct rockchip_pm_domain **pds, int num)
+{
+	struct rockchip_pmu *pmu = pds[0]->pmu;
+	struct rockchip_pm_domain *fast[MAX_BATCH_DOMAINS];
+	unsigned int ack_mask = 0, val;
+	u32 delay_us = 0;
+	int i, n = 0, on_num, ret = 0;
+	bool done;
+
+	for (on_num = 0; on_num < num; on_num++) {
+		struct rockchip_pm_domain *pd = pds[on_num];
+
+		if (IS_ERR_OR_NULL(pd->supply) &&
+		    PTR_ERR(pd->supply) != -ENODEV)
+			pd->supply = devm_regulator_get_optional(pmu->dev,
+								 pd->genpd.name);
+		if (!IS_ERR(pd->supply)) {
+			ret = regulator_enable(pd->supply);
+			if (ret < 0) {
+				dev_err(pmu->dev, "failed to set vdd supply enable '%s',\n",
+					pd->genpd.name);
+				break;
+			}
+		}
+		ret = clk_bulk_enable(pd->num_clks, pd->clks);
+		if (ret < 0) {
+			dev_err(pmu->dev, "failed to enable clocks\n");
+			if (!IS_ERR(pd->supply))
+				regulator_disable(pd->supply);
+			break;
+		}
+		rockchip_pmu_ungate_clk(pd, true);
+		/* the memory repair sequence is done per domain */
+		if (pd->info->mem_status_mask)
+			ret = rockchip_do_pmu_set_power_domain(pd, true);
+		else
+			fast[n++] = pd;
+	}
+	if (ret)
+		goto out;
+
+	if (n) {
+		rockchip_pd_batch_write(fast, n, true);
+		ret = read_poll_timeout_atomic(rockchip_pd_batch_is_on, done,
+					       done, 0, 10000, false, fast, n);
+		if (ret) {
+			dev_err(pmu->dev, "failed to power on %d domains\n", n);
+			panic("panic_on_set_domain set ...\n");
+		}
+	}
+
+	for (i = 0; i < num; i++) {
+		rockchip_pmu_mem_shut_down(pds[i], false);
+		ack_mask |= pds[i]->info->ack_mask;
+		delay_us = max(delay_us, pds[i]->info->delay_us);
+	}
+
+	/* leave idle mode */
+	rockchip_pd_batch_write(pds, num, false);
+	ret = readx_poll_timeout_atomic(rockchip_pmu_read_ack, pmu, val,
+					!(val & ack_mask), 0, 10000);
+	if (!ret)
+		ret = read_poll_timeout_atomic(rockchip_pd_batch_is_active, done,
+					       done, 0, 10000, false, pds, num);
+	if (ret) {
+		dev_err(pmu->dev, "failed to deidle %d domains, ack=0x%x\n",
+			num, val);
+		panic("panic_on_set_idle set ...\n");
+	}
+
+	if (delay_us)
+		udelay(delay_us);
+
+	for (i = 0; i < num; i++) {
+		if (pds[i]->is_qos_saved)
+			rockchip_pmu_restore_qos_from_reset(pds[i]);
+		if (pds[i]->is_qos_need_init || pds[i]->is_shaping_need_init)
+			rockchip_pmu_init_qos(pds[i]);
+	}
+
+out:
+	for (i = 0; i < on_num; i++) {
+		rockchip_pmu_ungate_clk(pds[i], false);
+		clk_bulk_disable(pds[i]->num_clks, pds[i]->clks);
+		if (ret && !IS_ERR(pds[i]->supply))
+			regulator_disable(pds[i]->supply);
+	}
+
+	return ret;
+}
+
+/*
+ * rockchip_pmu_pd_on_batch - power on the domains of several devices at
+ * once, e.g. all the blocks of a camera pipeline. Like rockchip_pmu_pd_on()
+ * the domains are powered behind genpd. Domains are brought up in waves, a
+ * domain joins a wave once its parents are on, and each wave is powered
+ * and released from idle in parallel.
+ */
+int rockchip_pmu_pd_on_batch(struct device **devs, int num)
+{
+	struct rockchip_pm_domain *pds[MAX_BATCH_DOMAINS];
+	struct rockchip_pm_domain *wave[MAX_BATCH_DOMAINS];
+	int i, j, n = 0, wave_num, ret = 0;
+
+	if (!devs || num <= 0 || num > MAX_BATCH_DOMAINS)
+		return -EINVAL;
+
+	for (i = 0; i < num; i++) {
+		struct rockchip_pm_domain *pd;
+
+		if (IS_ERR_OR_NULL(devs[i]) ||
+		    IS_ERR_OR_NULL(devs[i]->pm_domain))
+			return -EINVAL;
+		pd = to_rockchip_pd(pd_to_genpd(devs[i]->pm_domain));
+		for (j = 0; j < n; j++)
+			if (pds[j] == pd)
+				break;
+		if (j == n)
+			pds[n++] = pd;
+	}
+
+	rockchip_pmu_lock(pds[0]);
+
+	while (n && !ret) {
+		bool waiting = false;
+
+		wave_num = 0;
+		for (i = 0; i < n; i++) {
+			if (rockchip_pmu_domain_is_on(pds[i]))
+				continue;
+			if (rockchip_pd_parents_are_on(pds[i]))
+				wave[wave_num++] = pds[i];
+			else
+				waiting = true;
+		}
+		if (!wave_num) {
+			if (!waiting)
+				break;
+			/* parents outside the batch are off, as pd_on does */
+			for (i = 0; i < n; i++)
+				if (!rockchip_pmu_domain_is_on(pds[i]))
+					wave[wave_num++] = pds[i];
+		}
+
+		ret = rockchip_pd_power_on_batch(wave, wave_num);
+
+		for (i = 0, j = 0; i < n; i++)
+			if (!rockchip_pmu_domain_is_on(pds[i]))
+				pds[j++] = pds[i];
+		/* no progress, e.g. domains without power control */
+		if (j == n)
+			break;
+		n = j;
+	}
+
+	rockchip_pmu_unlock(pds[0]);
+
+	return ret;
+}
+EXPORT_SYMBOL(rockchip_pmu_pd_on_batch);
+
 bool rockchip_pmu_pd_is_on(struct device *dev)
 {
 	struct generic_pm_domain *genpd;
@@ -1401,6 +1765,12 @@ static int rockchip_pm_add_one_domain(struct rockchip_pmu *pmu,
 			error = -ENOMEM;
 			goto err_unprepare_clocks;
 		}
+		pd->qos_prio_save_regs = devm_kcalloc(pmu->dev, pd->num_qos,
+						      sizeof(u32), GFP_KERNEL);
+		if (!pd->qos_prio_save_regs) {
+			error = -ENOMEM;
+			goto err_unprepare_clocks;
+		}
 		pd->qos_is_need_init[0] = kzalloc(sizeof(bool) *
 						  MAX_QOS_REGS_NUM *
 						  pd->num_qos,
@@ -1409,9 +1779,19 @@ static int rockchip_pm_add_one_domain(struct rockchip_pmu *pmu,
 			error = -ENOMEM;
 			goto err_unprepare_clocks;
 		}
+		pd->qos_reset_regs[0] = devm_kmalloc_array(pmu->dev,
+							   MAX_QOS_REGS_NUM * pd->num_qos,
+							   sizeof(u32),
+							   GFP_KERNEL);
+		if (!pd->qos_reset_regs[0]) {
+			error = -ENOMEM;
+			goto err_unprepare_clocks;
+		}
 		for (i = 1; i < MAX_QOS_REGS_NUM; i++) {
 			pd->qos_save_regs[i] = pd->qos_save_regs[i - 1] +
 					       num_qos;
+			pd->qos_reset_regs[i] = pd->qos_reset_regs[i - 1] +
+						pd->num_qos;
 			pd->qos_is_need_init[i] = pd->qos_is_need_init[i - 1] +
 						  num_qos;
 		}
@@ -57,13 +57,38 @@ static u64 cma_procfs_used_get(struct cma *cma)
 	return (u64)used << cma->order_per_bit;
 }
 
+/* largest free extent in pages and number of free extents */
+static unsigned long cma_procfs_largest_free(struct cma *cma, unsigned long *nr)
+{
+	unsigned long maxno = cma_bitmap_maxno(cma);
+	unsigned long start, end, largest = 0;
+	unsigned long flags;
+
+	*nr = 0;
+	spin_lock_irqsave(&cma->lock, flags);
+	for (start = find_first_zero_bit(cma->bitmap, maxno); start < maxno;
+	     start = find_next_zero_bit(cma->bitmap, maxno, end)) {
+		end = find_next_bit(cma->bitmap, maxno, start);
+		largest = max(largest, end - start);
+		(*nr)++;
+	}
+	spin_unlock_irqrestore(&cma->lock, flags);
+
+	return largest << cma->order_per_bit;
+}
+
 static int cma_procfs_show(struct seq_file *s, void *private)
 {
 	struct cma *cma = s->private;
 	u64 used = cma_procfs_used_get(cma);
+	unsigned long largest, nr;
+
+	largest = cma_procfs_largest_free(cma, &nr);
 
 	seq_printf(s, "Total: %lu KiB\n", cma->count << (PAGE_SHIFT - 10));
-	seq_printf(s, " Used: %llu KiB\n\n", used << (PAGE_SHIFT - 10));
+	seq_printf(s, " Used: %llu KiB\n", used << (PAGE_SHIFT - 10));
+	seq_printf(s, "Largest free: %lu KiB in %lu free extents\n\n",
+		   largest << (PAGE_SHIFT - 10), nr);
 
 	cma_procfs_show_bitmap(s, cma);
 
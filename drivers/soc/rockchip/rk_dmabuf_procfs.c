@@ -136,6 +136,43 @@ static int rk_dmabuf_size_show(struct seq_file *s, void *v)
 	return 0;
 }
 
+static int rk_dmabuf_acct_cb(const struct dma_buf_acct_info *info, void *private)
+{
+	struct seq_file *s = private;
+
+	if (info->pid)
+		seq_printf(s, "%-32.32s %8d %8u %12lu %12lu\n", info->name,
+			   info->pid, info->count, K(info->bytes), K(info->peak));
+	else
+		seq_printf(s, "%-32.32s %8s %8u %12lu %12lu\n", info->name,
+			   "-", info->count, K(info->bytes), K(info->peak));
+
+	return 0;
+}
+
+static int rk_dmabuf_acct_show(struct seq_file *s, enum dma_buf_acct_type type)
+{
+	seq_printf(s, "%-32s %8s %8s %12s %12s\n", "NAME", "PID", "COUNT",
+		   "SIZE:KiB", "PEAK:KiB");
+
+	return dma_buf_acct_for_each(type, rk_dmabuf_acct_cb, s);
+}
+
+static int rk_dmabuf_exporter_show(struct seq_file *s, void *v)
+{
+	return rk_dmabuf_acct_show(s, DMA_BUF_ACCT_EXPORTER);
+}
+
+static int rk_dmabuf_process_show(struct seq_file *s, void *v)
+{
+	return rk_dmabuf_acct_show(s, DMA_BUF_ACCT_PROCESS);
+}
+
+static int rk_dmabuf_importer_show(struct seq_file *s, void *v)
+{
+	return rk_dmabuf_acct_show(s, DMA_BUF_ACCT_DEVICE);
+}
+
 static int rk_dmabuf_peak_show(struct seq_file *s, void *v)
 {
 	seq_printf(s, "Peak: %lu MiB\n", K(K(dma_buf_get_peak_size())));
@@ -158,6 +195,7 @@ static ssize_t rk_dmabuf_peak_write(struct file *file,
 		return -EINVAL;
 
 	dma_buf_reset_peak_size();
+	dma_buf_acct_reset_peak();
 
 	return count;
 }
@@ -195,6 +233,9 @@ static int __init rk_dmabuf_init(void)
 	proc_create_single("dev", 0, root, rk_dmabuf_dev_show);
 	proc_create_single("size", 0, root, rk_dmabuf_size_show);
 	proc_create("peak", 0644, root, &rk_dmabuf_peak_ops);
+	proc_create_single("exporter", 0, root, rk_dmabuf_exporter_show);
+	proc_create_single("process", 0, root, rk_dmabuf_process_show);
+	proc_create_single("importer", 0, root, rk_dmabuf_importer_show);
 
 	return 0;
 }
@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Rockchip AMP shared memory ring
+ *
+ * Copyright (c) 2024 Rockchip Electronics Co. Ltd.
+ *
+ * A zero-copy data channel with the core booted by rockchip_amp, for high
+ * rate data such as sensor samples. The rings live in reserved memory that
+ * user space maps, the driver only initializes them and rings the doorbells,
+ * which are software triggered SPIs as with rockchip_rpmsg_softirq. See
+ * include/uapi/linux/rk-amp-ring.h for the layout.
+ */
+
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/irq.h>
+#include <linux/log2.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_reserved_mem.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <uapi/linux/rk-amp-ring.h>
+
+struct rkamp_ring {
+	struct device *dev;
+	struct miscdevice miscdev;
+	char name[16];
+	phys_addr_t base;
+	size_t size;
+	void *vaddr;
+	struct rk_amp_ring_ctrl *tx;
+	struct rk_amp_ring_ctrl *rx;
+	u32 data_size;
+	int irq_tx;
+	int irq_rx;
+	wait_queue_head_t wait;
+	/* doorbells rung, doorbells saved by batching, doorbells received */
+	atomic64_t kicks;
+	atomic64_t kicks_saved;
+	atomic64_t irqs;
+};
+
+static void rkamp_ring_doorbell(struct rkamp_ring *ring)
+{
+	struct irq_chip *chip = irq_get_chip(ring->irq_tx);
+
+	if (chip && chip->irq_retrigger)
+		chip->irq_retrigger(irq_get_irq_data(ring->irq_tx));
+}
+
+static irqreturn_t rkamp_ring_irq(int irq, void *data)
+{
+	struct rkamp_ring *ring = data;
+
+	atomic64_inc(&ring->irqs);
+	wake_up_interruptible(&ring->wait);
+
+	return IRQ_HANDLED;
+}
+
+static void rkamp_ring_kick(struct rkamp_ring *ring)
+{
+	/* order the indexes user space just wrote before the flags */
+	mb();
+	if (READ_ONCE(ring->tx->need_kick) || READ_ONCE(ring->rx->need_room)) {
+		rkamp_ring_doorbell(ring);
+		atomic64_inc(&ring->kicks);
+	} else {
+		atomic64_inc(&ring->kicks_saved);
+	}
+}
+
+static u32 rkamp_ring_events(struct rkamp_ring *ring, u32 events, u32 tx_tail)
+{
+	u32 ready = 0;
+
+	if ((events & RK_AMP_RING_EV_RX) &&
+	    READ_ONCE(ring->rx->head) != READ_ONCE(ring->rx->tail))
+		ready |= RK_AMP_RING_EV_RX;
+	if ((events & RK_AMP_RING_EV_TX) && READ_ONCE(ring->tx->tail) != tx_tail)
+		ready |= RK_AMP_RING_EV_TX;
+
+	return ready;
+}
+
+/* Ask the remote for a doorbell, then look again so none is missed */
+static u32 rkamp_ring_arm(struct rkamp_ring *ring, u32 events, u32 tx_tail)
+{
+	u32 ready = rkamp_ring_events(ring, events, tx_tail);
+
+	if (ready)
+		return ready;
+
+	if (events & RK_AMP_RING_EV_RX)
+		WRITE_ONCE(ring->rx->need_kick, 1);
+	if (events & RK_AMP_RING_EV_TX)
+		WRITE_ONCE(ring->tx->need_room, 1);
+	mb();
+
+	return rkamp_ring_events(ring, events, tx_tail);
+}
+
+static long rkamp_ring_wait(struct rkamp_ring *ring, void __user *argp)
+{
+	struct rk_amp_ring_wait w;
+	u32 ready = 0;
+	long ret;
+
+	if (copy_from_user(&w, argp, sizeof(w)))
+		return -EFAULT;
+	if (!(w.events & (RK_AMP_RING_EV_RX | RK_AMP_RING_EV_TX)))
+		return -EINVAL;
+
+	ret = wait_event_interruptible_timeout(ring->wait,
+					       (ready = rkamp_ring_arm(ring, w.events, w.tx_tail)),
+					       msecs_to_jiffies(w.timeout_ms));
+	if (w.events & RK_AMP_RING_EV_RX)
+		WRITE_ONCE(ring->rx->need_kick, 0);
+	if (w.events & RK_AMP_RING_EV_TX)
+		WRITE_ONCE(ring->tx->need_room, 0);
+	if (ret < 0)
+		return ret;
+	if (!ret)
+		return -ETIMEDOUT;
+
+	w.events = ready;
+	if (copy_to_user(argp, &w, sizeof(w)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long rkamp_ring_ioctl(struct file *file, unsigned int cmd,
+			     unsigned long arg)
+{
+	struct rkamp_ring *ring = container_of(file->private_data,
+					       struct rkamp_ring, miscdev);
+	void __user *argp = (void __user *)arg;
+	struct rk_amp_ring_info info;
+
+	switch (cmd) {
+	case RK_AMP_RING_GET_INFO:
+		info.tx_offset = 0;
+		info.rx_offset = RK_AMP_RING_CTRL_SIZE + ring->data_size;
+		info.data_size = ring->data_size;
+		info.map_size = ring->size;
+		if (copy_to_user(argp, &info, sizeof(info)))
+			return -EFAULT;
+		return 0;
+	case RK_AMP_RING_KICK:
+		rkamp_ring_kick(ring);
+		return 0;
+	case RK_AMP_RING_WAIT:
+		return rkamp_ring_wait(ring, argp);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int rkamp_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct rkamp_ring *ring = container_of(file->private_data,
+					       struct rkamp_ring, miscdev);
+	size_t size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff || size > PAGE_ALIGN(ring->size))
+		return -EINVAL;
+
+	/* same attributes as the kernel mapping of the rings */
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+
+	return remap_pfn_range(vma, vma->vm_start, PHYS_PFN(ring->base), size,
+			       vma->vm_page_prot);
+}
+
+static const struct file_operations rkamp_ring_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = rkamp_ring_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap = rkamp_ring_mmap,
+};
+
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct miscdevice *miscdev = dev_get_drvdata(dev);
+	struct rkamp_ring *ring = container_of(miscdev, struct rkamp_ring, miscdev);
+
+	return sysfs_emit(buf, "kicks %lld saved %lld irqs %lld\n",
+			  atomic64_read(&ring->kicks),
+			  atomic64_read(&ring->kicks_saved),
+			  atomic64_read(&ring->irqs));
+}
+static DEVICE_ATTR_RO(stats);
+
+static struct attribute *rkamp_ring_attrs[] = {
+	&dev_attr_stats.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(rkamp_ring);
+
+static void rkamp_ring_init_ctrl(struct rkamp_ring *ring,
+				 struct rk_amp_ring_ctrl *ctrl)
+{
+	memset(ctrl, 0, sizeof(*ctrl));
+	/* data_size last, the remote waits for it */
+	wmb();
+	WRITE_ONCE(ctrl->data_size, ring->data_size);
+}
+
+static int rockchip_amp_ring_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct device_node *np = dev->of_node;
+	struct device_node *mem_np;
+	struct reserved_mem *rmem;
+	struct rkamp_ring *ring;
+	int id, ret;
+
+	ring = devm_kzalloc(dev, sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+	ring->dev = dev;
+	init_waitqueue_head(&ring->wait);
+
+	mem_np = of_parse_phandle(np, "memory-region", 0);
+	if (!mem_np)
+		return -ENODEV;
+	rmem = of_reserved_mem_lookup(mem_np);
+	of_node_put(mem_np);
+	if (!rmem)
+		return -ENODEV;
+	ring->base = rmem->base;
+	ring->size = rmem->size;
+
+	/* a power of two keeps the offsets right across the u32 wrap */
+	if (ring->size / 2 <= RK_AMP_RING_CTRL_SIZE)
+		return -EINVAL;
+	ring->data_size = rounddown_pow_of_two(ring->size / 2 -
+					       RK_AMP_RING_CTRL_SIZE);
+
+	ring->vaddr = devm_memremap(dev, ring->base, ring->size, MEMREMAP_WC);
+	if (IS_ERR(ring->vaddr))
+		return PTR_ERR(ring->vaddr);
+	ring->tx = ring->vaddr;
+	ring->rx = ring->vaddr + RK_AMP_RING_CTRL_SIZE + ring->data_size;
+
+	ring->irq_tx = platform_get_irq(pdev, 0);
+	if (ring->irq_tx < 0)
+		return ring->irq_tx;
+	ring->irq_rx = platform_get_irq(pdev, 1);
+	if (ring->irq_rx < 0)
+		return ring->irq_rx;
+
+	ret = devm_request_irq(dev, ring->irq_rx, rkamp_ring_irq, 0,
+			       dev_name(dev), ring);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to request rx irq\n");
+
+	rkamp_ring_init_ctrl(ring, ring->tx);
+	rkamp_ring_init_ctrl(ring, ring->rx);
+
+	id = of_alias_get_id(np, "amp-ring");
+	snprintf(ring->name, sizeof(ring->name), "amp-ring%d", id < 0 ? 0 : id);
+	ring->miscdev.minor = MISC_DYNAMIC_MINOR;
+	ring->miscdev.name = ring->name;
+	ring->miscdev.fops = &rkamp_ring_fops;
+	ring->miscdev.groups = rkamp_ring_groups;
+	ring->miscdev.parent = dev;
+	ret = misc_register(&ring->miscdev);
+	if (ret)
+		return ret;
+
+	platform_set_drvdata(pdev, ring);
+	/* tell the remote that the rings are ready */
+	rkamp_ring_doorbell(ring);
+	dev_info(dev, "%s: 2 x %u bytes at %pa\n", ring->name, ring->data_size,
+		 &ring->base);
+
+	return 0;
+}
+
+static int rockchip_amp_ring_remove(struct platform_device *pdev)
+{
+	struct rkamp_ring *ring = platform_get_drvdata(pdev);
+
+	misc_deregister(&ring->miscdev);
+
+	return 0;
+}
+
+static const struct of_device_id rockchip_amp_ring_match[] = {
+	{ .compatible = "rockchip,amp-ring" },
+	{ /* sentinel */ },
+};
+MODULE_DEVICE_TABLE(of, rockchip_amp_ring_match);
+
+static struct platform_driver rockchip_amp_ring_driver = {
+	.probe = rockchip_amp_ring_probe,
+	.remove = rockchip_amp_ring_remove,
+	.driver = {
+		.name  = "rockchip-amp-ring",
+		.of_match_table = rockchip_amp_ring_match,
+	},
+};
+module_platform_driver(rockchip_amp_ring_driver);
+
+MODULE_DESCRIPTION("Rockchip AMP shared memory ring");
+MODULE_LICENSE("GPL");
@@ -5,10 +5,13 @@
  */
 
 #include <linux/arm-smccc.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/rockchip/rockchip_sip.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <soc/rockchip/rockchip_csu.h>
@@ -18,6 +21,10 @@ struct csu_bus {
 	unsigned int cfg_val;
 	unsigned int en_mask;
 	unsigned int disable_count;
+	/* time spent with each divider, and with the scaling disabled */
+	u64 div_time_ns[CSU_MAX_DIV];
+	u64 off_time_ns;
+	ktime_t last_update;
 };
 
 struct csu_clk {
@@ -31,6 +38,7 @@ struct rockchip_csu {
 	struct csu_clk *clk;
 	unsigned int bus_cnt;
 	unsigned int clk_cnt;
+	struct dentry *debugfs;
 };
 
 static struct rockchip_csu *rk_csu;
@@ -51,6 +59,22 @@ static struct csu_bus *rockchip_csu_get_bus(unsigned int bus_id)
 	return NULL;
 }
 
+/* Called with csu_lock held, before the bus config changes */
+static void rockchip_csu_account(struct csu_bus *bus)
+{
+	ktime_t now = ktime_get();
+	u64 delta;
+
+	if (bus->last_update) {
+		delta = ktime_to_ns(ktime_sub(now, bus->last_update));
+		if (bus->disable_count)
+			bus->off_time_ns += delta;
+		else
+			bus->div_time_ns[bus->cfg_val & CSU_DIV_MASK] += delta;
+	}
+	bus->last_update = now;
+}
+
 static int rockchip_csu_sip_config(struct device *dev, u32 bus_id, u32 cfg,
 				   u32 enable_msk)
 {
@@ -112,6 +136,7 @@ static int csu_disable(struct csu_clk *clk, bool disable)
 
 	mutex_lock(&csu_lock);
 
+	rockchip_csu_account(bus);
 	if (disable)
 		bus->disable_count++;
 	else if (bus->disable_count > 0)
@@ -161,11 +186,22 @@ int rockchip_csu_set_div(struct csu_clk *clk, unsigned int div)
 
 	if (div > CSU_MAX_DIV)
 		div = CSU_MAX_DIV;
+	else if (!div)
+		div = 1;
 	cfg_val = (bus->cfg_val & ~CSU_DIV_MASK) | ((div - 1) & CSU_DIV_MASK);
-
-	ret = rockchip_csu_sip_config(rk_csu->dev, bus->id, cfg_val, bus->en_mask);
+	if (cfg_val == bus->cfg_val)
+		goto out;
+
+	rockchip_csu_account(bus);
+	/* keep the enable mask of the users that disabled the scaling */
+	ret = rockchip_csu_sip_config(rk_csu->dev, bus->id, cfg_val,
+				      bus->disable_count ?
+				      bus->en_mask & CSU_EN_MASK : bus->en_mask);
 	if (ret)
 		dev_err(rk_csu->dev, "csu sip config freq error\n");
+	else
+		bus->cfg_val = cfg_val;
+out:
 
 	mutex_unlock(&csu_lock);
 
@@ -272,6 +308,7 @@ static int rockchip_csu_bus_table(struct rockchip_csu *csu)
 		}
 		if (rockchip_csu_sip_config(dev, bus->id, bus->cfg_val, bus->en_mask))
 			dev_err(dev, "csu sip config error\n");
+		bus->last_update = ktime_get();
 	}
 
 	return 0;
@@ -320,11 +357,40 @@ static int rockchip_csu_bus_node(struct rockchip_csu *csu)
 
 		if (rockchip_csu_sip_config(dev, bus->id, bus->cfg_val, bus->en_mask))
 			dev_info(dev, "csu smc config error\n");
+		bus->last_update = ktime_get();
 	}
 
 	return 0;
 }
 
+static int rockchip_csu_stats_show(struct seq_file *m, void *v)
+{
+	struct rockchip_csu *csu = m->private;
+	struct csu_bus *bus;
+	int i, j;
+
+	mutex_lock(&csu_lock);
+	seq_printf(m, "%-4s %-4s %-8s", "bus", "div", "state");
+	for (j = 0; j < CSU_MAX_DIV; j++)
+		seq_printf(m, " %8s%u", "div", j + 1);
+	seq_printf(m, " %9s\n", "off");
+	for (i = 0; i < csu->bus_cnt; i++) {
+		bus = &csu->bus[i];
+		rockchip_csu_account(bus);
+		seq_printf(m, "%-4u %-4u %-8s", bus->id,
+			   (bus->cfg_val & CSU_DIV_MASK) + 1,
+			   bus->disable_count ? "disabled" : "enabled");
+		/* resident time in ms */
+		for (j = 0; j < CSU_MAX_DIV; j++)
+			seq_printf(m, " %9llu", div_u64(bus->div_time_ns[j], NSEC_PER_MSEC));
+		seq_printf(m, " %9llu\n", div_u64(bus->off_time_ns, NSEC_PER_MSEC));
+	}
+	mutex_unlock(&csu_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rockchip_csu_stats);
+
 static const struct of_device_id rockchip_csu_of_match[] = {
 	{ .compatible = "rockchip,rk3562-csu", },
 	{ },
@@ -352,8 +418,11 @@ static int rockchip_csu_probe(struct platform_device *pdev)
 		ret = rockchip_csu_bus_table(csu);
 	else
 		ret = rockchip_csu_bus_node(csu);
-	if (!ret)
+	if (!ret) {
 		rk_csu = csu;
+		csu->debugfs = debugfs_create_file("rockchip_csu", 0444, NULL,
+						   csu, &rockchip_csu_stats_fops);
+	}
 
 	return ret;
 }
@@ -3,7 +3,9 @@
  * Copyright (C) 2020 Rockchip Electronics Co., Ltd
  */
 #include <linux/clk.h>
+#include <linux/completion.h>
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
 #include <linux/initramfs.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
@@ -15,6 +17,10 @@
 #include <linux/platform_device.h>
 #include <linux/reset.h>
 #include <linux/soc/rockchip/rockchip_decompress.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include <soc/rockchip/rockchip_decompress_job.h>
 
 #define DECOM_CTRL		0x0
 #define DECOM_ENR		0x4
@@ -73,6 +79,8 @@
 #define DECOM_ENABLE		0x1
 #define DECOM_DISABLE		0x0
 
+#define DECOM_JOB_TIMEOUT_MS	3000
+
 #define DECOM_INT_MASK \
 	(DSOLIEN | ZDICTEIEN | GCMEIEN | GIDEIEN | \
 	CCCEIEN | BCCEIEN | HCCEIEN | CSEIEN | \
@@ -97,6 +105,38 @@ static DECLARE_WAIT_QUEUE_HEAD(g_decom_wait);
 static bool g_decom_complete;
 static bool g_decom_noblocking;
 static u64 g_decom_data_len;
+/* rk_decom_start() finished, the irq thread has to clean up after it */
+static bool g_decom_legacy_done;
+
+/*
+ * The engine is owned either by rk_decom_start() or by one queued job at a
+ * time. g_decom_lock protects the queue and the ownership, and is taken from
+ * the hard irq handler.
+ */
+static DEFINE_SPINLOCK(g_decom_lock);
+static LIST_HEAD(g_decom_jobs);
+static bool g_decom_busy;
+static struct rk_decom_job *g_decom_cur;
+static struct rk_decom_job *g_decom_done;
+
+static void rk_decom_dispatch(struct work_struct *work);
+static DECLARE_WORK(g_decom_dispatch_work, rk_decom_dispatch);
+static void rk_decom_timeout(struct work_struct *work);
+static DECLARE_DELAYED_WORK(g_decom_timeout_work, rk_decom_timeout);
+
+static void rk_decom_release_engine(void)
+{
+	unsigned long flags;
+	bool pending;
+
+	spin_lock_irqsave(&g_decom_lock, flags);
+	g_decom_busy = false;
+	pending = !list_empty(&g_decom_jobs);
+	spin_unlock_irqrestore(&g_decom_lock, flags);
+
+	if (pending)
+		queue_work(system_unbound_wq, &g_decom_dispatch_work);
+}
 
 void __init wait_initrd_hw_decom_done(void)
 {
@@ -112,8 +152,12 @@ int rk_decom_wait_done(u32 timeout, u64 *decom_len)
 
 	ret = wait_event_timeout(g_decom_wait, g_decom_complete, timeout * HZ);
 	if (!ret) {
-		if (g_decom)
+		if (g_decom) {
+			writel(DECOM_DISABLE, g_decom->regs + DECOM_ENR);
+			writel(0, g_decom->regs + DECOM_IEN);
 			clk_bulk_disable_unprepare(g_decom->num_clocks, g_decom->clocks);
+			rk_decom_release_engine();
+		}
 
 		return -ETIMEDOUT;
 	}
@@ -126,85 +170,342 @@ EXPORT_SYMBOL(rk_decom_wait_done);
 
 static DECLARE_WAIT_QUEUE_HEAD(decom_init_done);
 
-int rk_decom_start(u32 mode, phys_addr_t src, phys_addr_t dst, u32 dst_max_size)
+static int rk_decom_hw_start(struct rk_decom *rk_dec, u32 decom_mode,
+			     phys_addr_t src, phys_addr_t dst, u32 dst_max_size)
 {
-	int ret;
 	u32 irq_status;
 	u32 decom_enr;
-	u32 decom_mode = rk_get_decom_mode(mode);
-
-	wait_event_timeout(decom_init_done, g_decom, HZ);
-	if (!g_decom)
-		return -EINVAL;
-
-	if (g_decom->mem_start)
-		pr_info("%s: mode %u src %pa dst %pa max_size %u\n",
-			__func__, mode, &src, &dst, dst_max_size);
-
-	ret = clk_bulk_prepare_enable(g_decom->num_clocks, g_decom->clocks);
-	if (ret)
-		return ret;
 
-	g_decom_complete   = false;
-	g_decom_data_len   = 0;
-	g_decom_noblocking = rk_get_noblocking_flag(mode);
-
-	decom_enr = readl(g_decom->regs + DECOM_ENR);
+	decom_enr = readl(rk_dec->regs + DECOM_ENR);
 	if (decom_enr & 0x1) {
 		pr_err("decompress busy\n");
-		ret = -EBUSY;
-		goto error;
+		return -EBUSY;
 	}
 
-	if (g_decom->reset) {
-		reset_control_assert(g_decom->reset);
+	if (rk_dec->reset) {
+		reset_control_assert(rk_dec->reset);
 		udelay(10);
-		reset_control_deassert(g_decom->reset);
+		reset_control_deassert(rk_dec->reset);
 	}
 
-	irq_status = readl(g_decom->regs + DECOM_ISR);
+	irq_status = readl(rk_dec->regs + DECOM_ISR);
 	/* clear interrupts */
 	if (irq_status)
-		writel(irq_status, g_decom->regs + DECOM_ISR);
+		writel(irq_status, rk_dec->regs + DECOM_ISR);
 
 	switch (decom_mode) {
 	case LZ4_MOD:
 		writel(LZ4_CONT_CSUM_CHECK_EN |
 		       LZ4_HEAD_CSUM_CHECK_EN |
 		       LZ4_BLOCK_CSUM_CHECK_EN |
-		       LZ4_MOD, g_decom->regs + DECOM_CTRL);
+		       LZ4_MOD, rk_dec->regs + DECOM_CTRL);
 		break;
 	case GZIP_MOD:
 		writel(DECOM_DEFLATE_MODE | DECOM_GZIP_MODE,
-		       g_decom->regs + DECOM_CTRL);
+		       rk_dec->regs + DECOM_CTRL);
 		break;
 	case ZLIB_MOD:
 		writel(DECOM_DEFLATE_MODE | DECOM_ZLIB_MODE,
-		       g_decom->regs + DECOM_CTRL);
+		       rk_dec->regs + DECOM_CTRL);
 		break;
 	default:
 		pr_err("undefined mode : %d\n", decom_mode);
-		ret = -EINVAL;
-		goto error;
+		return -EINVAL;
 	}
 
-	writel(src, g_decom->regs + DECOM_RADDR);
-	writel(dst, g_decom->regs + DECOM_WADDR);
+	writel(src, rk_dec->regs + DECOM_RADDR);
+	writel(dst, rk_dec->regs + DECOM_WADDR);
 
-	writel(dst_max_size, g_decom->regs + DECOM_LMTSL);
-	writel(0x0, g_decom->regs + DECOM_LMTSH);
+	writel(dst_max_size, rk_dec->regs + DECOM_LMTSL);
+	writel(0x0, rk_dec->regs + DECOM_LMTSH);
 
-	writel(DECOM_INT_MASK, g_decom->regs + DECOM_IEN);
-	writel(DECOM_ENABLE, g_decom->regs + DECOM_ENR);
+	writel(DECOM_INT_MASK, rk_dec->regs + DECOM_IEN);
+	writel(DECOM_ENABLE, rk_dec->regs + DECOM_ENR);
+
+	return 0;
+}
+
+int rk_decom_start(u32 mode, phys_addr_t src, phys_addr_t dst, u32 dst_max_size)
+{
+	int ret;
+	u32 decom_mode = rk_get_decom_mode(mode);
+
+	wait_event_timeout(decom_init_done, g_decom, HZ);
+	if (!g_decom)
+		return -EINVAL;
+
+	if (g_decom->mem_start)
+		pr_info("%s: mode %u src %pa dst %pa max_size %u\n",
+			__func__, mode, &src, &dst, dst_max_size);
+
+	spin_lock_irq(&g_decom_lock);
+	if (g_decom_busy) {
+		spin_unlock_irq(&g_decom_lock);
+		pr_err("decompress busy\n");
+		return -EBUSY;
+	}
+	g_decom_busy = true;
+	spin_unlock_irq(&g_decom_lock);
+
+	ret = clk_bulk_prepare_enable(g_decom->num_clocks, g_decom->clocks);
+	if (ret)
+		goto release;
+
+	g_decom_complete   = false;
+	g_decom_data_len   = 0;
+	g_decom_noblocking = rk_get_noblocking_flag(mode);
+
+	ret = rk_decom_hw_start(g_decom, decom_mode, src, dst, dst_max_size);
+	if (ret)
+		goto error;
 
 	return 0;
 error:
 	clk_bulk_disable_unprepare(g_decom->num_clocks, g_decom->clocks);
+release:
+	rk_decom_release_engine();
 
 	return ret;
 }
 EXPORT_SYMBOL(rk_decom_start);
 
+static void rk_decom_job_finish(struct rk_decom_job *job)
+{
+	clk_bulk_disable_unprepare(g_decom->num_clocks, g_decom->clocks);
+	rk_decom_release_engine();
+	job->done(job);
+}
+
+static void rk_decom_dispatch(struct work_struct *work)
+{
+	struct rk_decom *rk_dec = g_decom;
+	struct rk_decom_job *job;
+	int ret;
+
+	for (;;) {
+		spin_lock_irq(&g_decom_lock);
+		if (g_decom_busy || list_empty(&g_decom_jobs)) {
+			spin_unlock_irq(&g_decom_lock);
+			return;
+		}
+		job = list_first_entry(&g_decom_jobs, struct rk_decom_job, node);
+		list_del_init(&job->node);
+		g_decom_busy = true;
+		spin_unlock_irq(&g_decom_lock);
+
+		job->status = 0;
+		job->decom_len = 0;
+
+		ret = clk_bulk_prepare_enable(rk_dec->num_clocks, rk_dec->clocks);
+		if (ret)
+			goto fail;
+
+		job->deadline = jiffies +
+			msecs_to_jiffies(job->timeout_ms ? : DECOM_JOB_TIMEOUT_MS);
+
+		spin_lock_irq(&g_decom_lock);
+		g_decom_cur = job;
+		spin_unlock_irq(&g_decom_lock);
+
+		ret = rk_decom_hw_start(rk_dec, rk_get_decom_mode(job->mode),
+					job->src, job->dst, job->dst_max_size);
+		if (!ret) {
+			mod_delayed_work(system_wq, &g_decom_timeout_work,
+					 job->deadline - jiffies);
+			return;
+		}
+
+		spin_lock_irq(&g_decom_lock);
+		g_decom_cur = NULL;
+		spin_unlock_irq(&g_decom_lock);
+
+		clk_bulk_disable_unprepare(rk_dec->num_clocks, rk_dec->clocks);
+fail:
+		spin_lock_irq(&g_decom_lock);
+		g_decom_busy = false;
+		spin_unlock_irq(&g_decom_lock);
+
+		job->status = ret;
+		job->done(job);
+	}
+}
+
+static void rk_decom_timeout(struct work_struct *work)
+{
+	struct rk_decom_job *job;
+
+	spin_lock_irq(&g_decom_lock);
+	job = g_decom_cur;
+	if (!job) {
+		spin_unlock_irq(&g_decom_lock);
+		return;
+	}
+
+	/* a newer job than the one this timer was armed for */
+	if (time_before(jiffies, job->deadline)) {
+		mod_delayed_work(system_wq, &g_decom_timeout_work,
+				 job->deadline - jiffies);
+		spin_unlock_irq(&g_decom_lock);
+		return;
+	}
+
+	writel(DECOM_DISABLE, g_decom->regs + DECOM_ENR);
+	writel(0, g_decom->regs + DECOM_IEN);
+	g_decom_cur = NULL;
+	spin_unlock_irq(&g_decom_lock);
+
+	dev_warn(g_decom->dev, "decom job timed out\n");
+	job->status = -ETIMEDOUT;
+	rk_decom_job_finish(job);
+}
+
+/**
+ * rk_decom_queue_job - queue an asynchronous decompress job
+ * @job: the job, must stay valid until @job->done is called
+ *
+ * Jobs of any number of callers are run in submission order. Unlike
+ * rk_decom_start() a failing job is not retried, it completes with an
+ * error.
+ */
+int rk_decom_queue_job(struct rk_decom_job *job)
+{
+	unsigned long flags;
+
+	if (!job || !job->done)
+		return -EINVAL;
+
+	if (!g_decom)
+		return -ENODEV;
+
+	spin_lock_irqsave(&g_decom_lock, flags);
+	list_add_tail(&job->node, &g_decom_jobs);
+	spin_unlock_irqrestore(&g_decom_lock, flags);
+
+	queue_work(system_unbound_wq, &g_decom_dispatch_work);
+
+	return 0;
+}
+EXPORT_SYMBOL(rk_decom_queue_job);
+
+struct rk_decom_sync_job {
+	struct rk_decom_job job;
+	struct completion done;
+};
+
+static void rk_decom_sync_done(struct rk_decom_job *job)
+{
+	struct rk_decom_sync_job *sync = container_of(job, struct rk_decom_sync_job, job);
+
+	complete(&sync->done);
+}
+
+/**
+ * rk_decom_buf - decompress between two kernel buffers
+ * @mode:	LZ4_MOD, GZIP_MOD or ZLIB_MOD
+ * @src:	compressed data, may be vmalloc memory
+ * @src_len:	length of @src
+ * @dst:	output, may be vmalloc memory
+ * @dst_len:	size of @dst
+ *
+ * Bounces through DMA buffers the engine can reach and sleeps until the
+ * queued job is done, leaving the CPU to other initcalls and loaders.
+ *
+ * Return: the decompressed length or a negative error, -ENODEV when there
+ * is no engine so that callers can fall back to software.
+ */
+ssize_t rk_decom_buf(u32 mode, const void *src, size_t src_len,
+		     void *dst, size_t dst_len)
+{
+	struct rk_decom_sync_job sync = { };
+	dma_addr_t src_dma, dst_dma;
+	void *src_buf, *dst_buf;
+	struct device *dev;
+	ssize_t ret;
+
+	if (!g_decom)
+		return -ENODEV;
+
+	if (!src_len || !dst_len || dst_len > U32_MAX)
+		return -EINVAL;
+
+	dev = g_decom->dev;
+	src_buf = dma_alloc_noncoherent(dev, src_len, &src_dma, DMA_TO_DEVICE,
+					GFP_KERNEL);
+	if (!src_buf)
+		return -ENOMEM;
+
+	dst_buf = dma_alloc_noncoherent(dev, dst_len, &dst_dma, DMA_FROM_DEVICE,
+					GFP_KERNEL);
+	if (!dst_buf) {
+		ret = -ENOMEM;
+		goto free_src;
+	}
+
+	memcpy(src_buf, src, src_len);
+	dma_sync_single_for_device(dev, src_dma, src_len, DMA_TO_DEVICE);
+
+	sync.job.mode = mode;
+	sync.job.src = src_dma;
+	sync.job.dst = dst_dma;
+	sync.job.dst_max_size = dst_len;
+	sync.job.done = rk_decom_sync_done;
+	init_completion(&sync.done);
+
+	ret = rk_decom_queue_job(&sync.job);
+	if (ret)
+		goto free_dst;
+
+	wait_for_completion(&sync.done);
+	ret = sync.job.status;
+	if (!ret) {
+		ret = min_t(u64, sync.job.decom_len, dst_len);
+		dma_sync_single_for_cpu(dev, dst_dma, ret, DMA_FROM_DEVICE);
+		memcpy(dst, dst_buf, ret);
+	}
+
+free_dst:
+	dma_free_noncoherent(dev, dst_len, dst_buf, dst_dma, DMA_FROM_DEVICE);
+free_src:
+	dma_free_noncoherent(dev, src_len, src_buf, src_dma, DMA_TO_DEVICE);
+
+	return ret;
+}
+EXPORT_SYMBOL(rk_decom_buf);
+
+static bool rk_decom_job_irq(struct rk_decom *rk_dec, u32 irq_status)
+{
+	struct rk_decom_job *job;
+	u32 decom_status;
+
+	spin_lock(&g_decom_lock);
+	job = g_decom_cur;
+	if (!job) {
+		spin_unlock(&g_decom_lock);
+		return false;
+	}
+
+	if (irq_status & DECOM_STOP) {
+		decom_status = readl(rk_dec->regs + DECOM_STAT);
+		if (decom_status & DECOM_COMPLETE) {
+			job->decom_len = readl(rk_dec->regs + DECOM_TSIZEH);
+			job->decom_len = (job->decom_len << 32) |
+					 readl(rk_dec->regs + DECOM_TSIZEL);
+		} else {
+			dev_warn_ratelimited(rk_dec->dev,
+					     "decom job failed, irq_status = 0x%x, decom_status = 0x%x\n",
+					     irq_status, decom_status);
+			writel(DECOM_DISABLE, rk_dec->regs + DECOM_ENR);
+			writel(0, rk_dec->regs + DECOM_IEN);
+			job->status = -EIO;
+		}
+		g_decom_cur = NULL;
+		g_decom_done = job;
+	}
+	spin_unlock(&g_decom_lock);
+
+	return true;
+}
+
 static irqreturn_t rk_decom_irq_handler(int irq, void *priv)
 {
 	struct rk_decom *rk_dec = priv;
@@ -214,10 +515,14 @@ static irqreturn_t rk_decom_irq_handler(int irq, void *priv)
 	irq_status = readl(rk_dec->regs + DECOM_ISR);
 	/* clear interrupts */
 	writel(irq_status, rk_dec->regs + DECOM_ISR);
+	if (rk_decom_job_irq(rk_dec, irq_status))
+		return IRQ_WAKE_THREAD;
+
 	if (irq_status & DECOM_STOP) {
 		decom_status = readl(rk_dec->regs + DECOM_STAT);
 		if (decom_status & DECOM_COMPLETE) {
 			g_decom_complete = true;
+			g_decom_legacy_done = true;
 			g_decom_data_len = readl(rk_dec->regs + DECOM_TSIZEH);
 			g_decom_data_len = (g_decom_data_len << 32) |
 					   readl(rk_dec->regs + DECOM_TSIZEL);
@@ -240,6 +545,7 @@ static irqreturn_t rk_decom_irq_handler(int irq, void *priv)
 				writel(0, g_decom->regs + DECOM_IEN);
 
 				g_decom_complete  = true;
+				g_decom_legacy_done = true;
 				g_decom_data_len = 0;
 				g_decom_noblocking = false;
 				wake_up(&g_decom_wait);
@@ -255,10 +561,24 @@ static irqreturn_t rk_decom_irq_handler(int irq, void *priv)
 static irqreturn_t rk_decom_irq_thread(int irq, void *priv)
 {
 	struct rk_decom *rk_dec = priv;
+	struct rk_decom_job *job;
+
+	spin_lock_irq(&g_decom_lock);
+	job = g_decom_done;
+	g_decom_done = NULL;
+	spin_unlock_irq(&g_decom_lock);
 
-	if (g_decom_complete) {
+	if (job) {
+		cancel_delayed_work(&g_decom_timeout_work);
+		rk_decom_job_finish(job);
+		return IRQ_HANDLED;
+	}
+
+	if (g_decom_legacy_done) {
 		void *start, *end;
 
+		g_decom_legacy_done = false;
+
 		if (rk_dec->mem_start) {
 			/*
 			 * Now it is safe to free reserve memory that
@@ -271,6 +591,7 @@ static irqreturn_t rk_decom_irq_thread(int irq, void *priv)
 		}
 
 		clk_bulk_disable_unprepare(rk_dec->num_clocks, rk_dec->clocks);
+		rk_decom_release_engine();
 	}
 
 	return IRQ_HANDLED;
@@ -328,6 +649,10 @@ static int __init rockchip_decom_probe(struct platform_device *pdev)
 
 	dev_set_drvdata(dev, rk_dec);
 
+	/* the engine only has 32 bit address registers */
+	if (dma_coerce_mask_and_coherent(dev, DMA_BIT_MASK(32)))
+		dev_warn(dev, "failed to set 32 bit dma mask\n");
+
 	rk_dec->reset = devm_reset_control_get_exclusive(dev, "dresetn");
 	if (IS_ERR(rk_dec->reset)) {
 		ret = PTR_ERR(rk_dec->reset);
@@ -11,6 +11,7 @@
  *	Lin Jinhan, troy.lin@rock-chips.com
  */
 
+#include <linux/completion.h>
 #include <linux/dma-buf.h>
 #include <linux/dma-direct.h>
 #include <linux/dma-mapping.h>
@@ -18,17 +19,22 @@
 #include <linux/ioctl.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
-#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/soc/rockchip/rockchip_decompress.h>
 #include <uapi/linux/rk-decom.h>
 
+#include <soc/rockchip/rockchip_decompress_job.h>
+
 #define RK_DECOME_TIMEOUT	3 /* 3 seconds */
 
 struct rk_decom_dev {
 	struct miscdevice miscdev;
 	struct device *dev;
-	struct mutex mutex;
+};
+
+struct rk_decom_user_job {
+	struct rk_decom_job job;
+	struct completion done;
 };
 
 static long rk_decom_misc_ioctl(struct file *fptr, unsigned int cmd, unsigned long arg);
@@ -137,12 +143,20 @@ static int put_dmafd_sgtbl(struct device *dev, int dma_fd, enum dma_data_directi
 	return 0;
 }
 
+static void rk_decom_user_done(struct rk_decom_job *job)
+{
+	struct rk_decom_user_job *ujob = container_of(job, struct rk_decom_user_job, job);
+
+	complete(&ujob->done);
+}
+
 static int rk_decom_for_user(struct device *dev, struct rk_decom_param *param)
 {
 	int ret;
 	struct sg_table *sg_tbl_in = NULL, *sg_tbl_out = NULL;
 	struct dma_buf *dma_buf_in = NULL, *dma_buf_out = NULL;
 	struct dma_buf_attachment *dma_attach_in = NULL, *dma_attach_out = NULL;
+	struct rk_decom_user_job ujob;
 
 	if (param->mode != RK_GZIP_MOD && param->mode != RK_ZLIB_MOD) {
 		dev_err(dev, "unsupported mode %u for decompress.\n", param->mode);
@@ -175,15 +189,24 @@ static int rk_decom_for_user(struct device *dev, struct rk_decom_param *param)
 		goto exit;
 	}
 
-	ret = rk_decom_start(param->mode | DECOM_NOBLOCKING, sg_dma_address(sg_tbl_in->sgl),
-			     sg_dma_address(sg_tbl_out->sgl), param->dst_max_size);
+	ujob.job.mode = param->mode;
+	ujob.job.src = sg_dma_address(sg_tbl_in->sgl);
+	ujob.job.dst = sg_dma_address(sg_tbl_out->sgl);
+	ujob.job.dst_max_size = param->dst_max_size;
+	ujob.job.timeout_ms = RK_DECOME_TIMEOUT * MSEC_PER_SEC;
+	ujob.job.done = rk_decom_user_done;
+	init_completion(&ujob.done);
 
+	ret = rk_decom_queue_job(&ujob.job);
 	if (ret) {
-		dev_err(dev, "rk_decom_start failed[%d].", ret);
+		dev_err(dev, "rk_decom_queue_job failed[%d].", ret);
 		goto exit;
 	}
 
-	ret = rk_decom_wait_done(RK_DECOME_TIMEOUT, &param->decom_data_len);
+	/* the queue times the job out itself, so this always returns */
+	wait_for_completion(&ujob.done);
+	ret = ujob.job.status;
+	param->decom_data_len = ujob.job.decom_len;
 
 exit:
 	if (sg_tbl_in && dma_buf_in && dma_attach_in)
@@ -205,15 +228,14 @@ static long rk_decom_misc_ioctl(struct file *fptr, unsigned int cmd, unsigned lo
 
 	rk_decom = container_of(fptr->private_data, struct rk_decom_dev, miscdev);
 
-	mutex_lock(&rk_decom->mutex);
-
+	/* no lock, concurrent callers are serialized by the job queue */
 	switch (cmd) {
 	case RK_DECOM_USER: {
 		ret = copy_from_user((char *)&param, (char *)arg, sizeof(param));
 		if (unlikely(ret)) {
 			ret = -EFAULT;
 			dev_err(rk_decom->dev, "copy from user fail.\n");
-			goto exit;
+			break;
 		}
 
 		ret = rk_decom_for_user(rk_decom->dev, &param);
@@ -221,7 +243,6 @@ static long rk_decom_misc_ioctl(struct file *fptr, unsigned int cmd, unsigned lo
 		if (copy_to_user((char *)arg, &param, sizeof(param))) {
 			dev_err(rk_decom->dev, " copy to user fail.\n");
 			ret = -EFAULT;
-			goto exit;
 		}
 
 		break;
@@ -232,9 +253,6 @@ static long rk_decom_misc_ioctl(struct file *fptr, unsigned int cmd, unsigned lo
 		break;
 	}
 
-exit:
-	mutex_unlock(&rk_decom->mutex);
-
 	return ret;
 }
 
@@ -261,8 +279,6 @@ static int __init rk_decom_misc_init(void)
 		goto error;
 	}
 
-	mutex_init(&rk_decom->mutex);
-
 	dev_info(rk_decom->dev, "misc device %s register success.\n", RK_DECOM_NAME);
 
 	return 0;
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Rockchip media infrastructure benchmark
+ *
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ *
+ * Reading <debugfs>/rockchip_media_bench/results runs a fixed set of
+ * reference workloads and returns one JSON array, so the numbers can be
+ * archived per board and compared across kernel updates:
+ *   - dma-heap: buffer alloc + free from the rk cma heap
+ *   - iommu: map + unmap of a contiguous chunk in an unmanaged domain
+ *   - crypto: cbc(aes) encryption and sha256 digest through the crypto api,
+ *     so whichever driver wins the priority (rk crypto or ce) is measured
+ * Every case runs for bench_ms and reports the average cost of one op.
+ */
+
+#include <crypto/hash.h>
+#include <crypto/skcipher.h>
+#include <linux/debugfs.h>
+#include <linux/dma-buf.h>
+#include <linux/iommu.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/rk-dma-heap.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+
+#define BENCH_IOVA_BASE		0x10000000
+#define BENCH_MAP_ORDER		8	/* 1MB chunk */
+
+static unsigned int bench_ms = 200;
+module_param(bench_ms, uint, 0644);
+MODULE_PARM_DESC(bench_ms, "time each benchmark case runs for");
+
+static const size_t bench_sizes[] = { SZ_4K, SZ_64K, SZ_1M };
+
+static DEFINE_MUTEX(bench_lock);
+static struct dentry *bench_root;
+
+struct bench_result {
+	const char *bench;
+	const char *alg;
+	const char *driver;
+	size_t size;
+	u64 ops;
+	u64 ns;
+	int err;
+};
+
+static void bench_emit(struct seq_file *m, const struct bench_result *r)
+{
+	u64 ns_per_op = r->ops ? div64_u64(r->ns, r->ops) : 0;
+	/* bytes per us is MB/s */
+	u64 mb_s = r->ns ? div64_u64((u64)r->size * r->ops * 1000, r->ns) : 0;
+
+	seq_printf(m, "%s\n  {\"bench\": \"%s\", \"alg\": \"%s\", \"driver\": \"%s\", ",
+		   m->count > 2 ? "," : "", r->bench, r->alg, r->driver);
+	seq_printf(m, "\"size\": %zu, \"ops\": %llu, \"ns_per_op\": %llu, \"mb_s\": %llu, \"err\": %d}",
+		   r->size, r->ops, ns_per_op, mb_s, r->err);
+}
+
+static bool bench_running(u64 start, struct bench_result *r)
+{
+	r->ns = ktime_get_ns() - start;
+
+	return !r->err && r->ns < (u64)bench_ms * NSEC_PER_MSEC;
+}
+
+static void bench_dma_heap(struct seq_file *m)
+{
+	struct rk_dma_heap *heap = rk_dma_heap_find("rk-dma-heap-cma");
+	struct bench_result r = { .bench = "dma_heap", .alg = "alloc_free",
+				  .driver = "rk-dma-heap-cma" };
+	struct dma_buf *dmabuf;
+	u64 start;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		r.size = bench_sizes[i];
+		r.ops = 0;
+		r.err = heap ? 0 : -ENODEV;
+		start = ktime_get_ns();
+		while (bench_running(start, &r)) {
+			dmabuf = rk_dma_heap_buffer_alloc(heap, r.size, O_RDWR, 0,
+							  "media-bench");
+			if (IS_ERR(dmabuf)) {
+				r.err = PTR_ERR(dmabuf);
+				break;
+			}
+			rk_dma_heap_buffer_free(dmabuf);
+			r.ops++;
+		}
+		bench_emit(m, &r);
+	}
+}
+
+static void bench_iommu(struct seq_file *m)
+{
+	struct bench_result r = { .bench = "iommu", .alg = "map_unmap" };
+	struct iommu_domain *domain;
+	struct page *pages;
+	phys_addr_t phys;
+	u64 start;
+	int i;
+
+	domain = iommu_domain_alloc(&platform_bus_type);
+	pages = alloc_pages(GFP_KERNEL, BENCH_MAP_ORDER);
+	r.driver = domain ? "platform" : "none";
+	phys = pages ? page_to_phys(pages) : 0;
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		r.size = bench_sizes[i];
+		r.ops = 0;
+		r.err = (domain && pages) ? 0 : -ENODEV;
+		start = ktime_get_ns();
+		while (bench_running(start, &r)) {
+			r.err = iommu_map(domain, BENCH_IOVA_BASE, phys, r.size,
+					  IOMMU_READ | IOMMU_WRITE);
+			if (r.err)
+				break;
+			if (iommu_unmap(domain, BENCH_IOVA_BASE, r.size) != r.size) {
+				r.err = -EFAULT;
+				break;
+			}
+			r.ops++;
+		}
+		bench_emit(m, &r);
+	}
+
+	if (pages)
+		__free_pages(pages, BENCH_MAP_ORDER);
+	if (domain)
+		iommu_domain_free(domain);
+}
+
+static void bench_skcipher(struct seq_file *m, void *buf)
+{
+	struct bench_result r = { .bench = "crypto", .alg = "cbc(aes)", .driver = "none" };
+	struct crypto_skcipher *tfm;
+	struct skcipher_request *req = NULL;
+	DECLARE_CRYPTO_WAIT(wait);
+	struct scatterlist sg;
+	u8 key[16] = {}, iv[16] = {};
+	u64 start;
+	int i;
+
+	tfm = crypto_alloc_skcipher(r.alg, 0, 0);
+	if (!IS_ERR(tfm)) {
+		r.driver = crypto_skcipher_driver_name(tfm);
+		req = skcipher_request_alloc(tfm, GFP_KERNEL);
+		crypto_skcipher_setkey(tfm, key, sizeof(key));
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		r.size = bench_sizes[i];
+		r.ops = 0;
+		r.err = IS_ERR(tfm) ? PTR_ERR(tfm) : (req ? 0 : -ENOMEM);
+		sg_init_one(&sg, buf, r.size);
+		start = ktime_get_ns();
+		while (bench_running(start, &r)) {
+			skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+						      crypto_req_done, &wait);
+			skcipher_request_set_crypt(req, &sg, &sg, r.size, iv);
+			r.err = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
+			if (r.err)
+				break;
+			r.ops++;
+		}
+		bench_emit(m, &r);
+	}
+
+	skcipher_request_free(req);
+	if (!IS_ERR(tfm))
+		crypto_free_skcipher(tfm);
+}
+
+static void bench_ahash(struct seq_file *m, void *buf)
+{
+	struct bench_result r = { .bench = "crypto", .alg = "sha256", .driver = "none" };
+	struct crypto_ahash *tfm;
+	struct ahash_request *req = NULL;
+	DECLARE_CRYPTO_WAIT(wait);
+	struct scatterlist sg;
+	u8 digest[32];
+	u64 start;
+	int i;
+
+	tfm = crypto_alloc_ahash(r.alg, 0, 0);
+	if (!IS_ERR(tfm)) {
+		r.driver = crypto_ahash_driver_name(tfm);
+		req = ahash_request_alloc(tfm, GFP_KERNEL);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		r.size = bench_sizes[i];
+		r.ops = 0;
+		r.err = IS_ERR(tfm) ? PTR_ERR(tfm) : (req ? 0 : -ENOMEM);
+		sg_init_one(&sg, buf, r.size);
+		start = ktime_get_ns();
+		while (bench_running(start, &r)) {
+			ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+						   crypto_req_done, &wait);
+			ahash_request_set_crypt(req, &sg, digest, r.size);
+			r.err = crypto_wait_req(crypto_ahash_digest(req), &wait);
+			if (r.err)
+				break;
+			r.ops++;
+		}
+		bench_emit(m, &r);
+	}
+
+	ahash_request_free(req);
+	if (!IS_ERR(tfm))
+		crypto_free_ahash(tfm);
+}
+
+static int bench_results_show(struct seq_file *m, void *v)
+{
+	void *buf;
+
+	buf = kzalloc(SZ_1M, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&bench_lock);
+	seq_puts(m, "[");
+	bench_dma_heap(m);
+	bench_iommu(m);
+	bench_skcipher(m, buf);
+	bench_ahash(m, buf);
+	seq_puts(m, "\n]\n");
+	mutex_unlock(&bench_lock);
+
+	kfree(buf);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bench_results);
+
+static int __init rockchip_media_bench_init(void)
+{
+	bench_root = debugfs_create_dir("rockchip_media_bench", NULL);
+	debugfs_create_file("results", 0400, bench_root, NULL, &bench_results_fops);
+
+	return 0;
+}
+
+static void __exit rockchip_media_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_root);
+}
+
+module_init(rockchip_media_bench_init);
+module_exit(rockchip_media_bench_exit);
+
+MODULE_DESCRIPTION("Rockchip media infrastructure benchmark");
+MODULE_LICENSE("GPL");
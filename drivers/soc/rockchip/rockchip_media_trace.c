@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Rockchip media pipeline frame tracing
+ *
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ *
+ * The frame id of a dma-buf is kept in a small table indexed by the inode
+ * number of the dma-buf file. The inode number is unique while the buffer
+ * lives and is what the trace reports as the buffer, so the same buffer can
+ * be matched between cif, isp, mpp, rga and vop2 events. The table is lossy:
+ * a slot is simply overwritten when two live buffers collide, which only
+ * costs the frame id in the trace of the older one.
+ */
+
+#include <linux/dma-buf.h>
+#include <linux/fs.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <soc/rockchip/rockchip_media_trace.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/rockchip_media.h>
+
+#define RK_MEDIA_TAG_SLOTS	1024
+
+struct rk_media_tag {
+	unsigned long ino;
+	u64 frame;
+};
+
+static struct rk_media_tag tags[RK_MEDIA_TAG_SLOTS];
+static DEFINE_SPINLOCK(tags_lock);
+
+static unsigned long rk_media_buf_ino(struct dma_buf *dmabuf)
+{
+	return (dmabuf && dmabuf->file) ? file_inode(dmabuf->file)->i_ino : 0;
+}
+
+bool rk_media_trace_enabled(void)
+{
+	return trace_rk_media_buf_enabled();
+}
+EXPORT_SYMBOL_GPL(rk_media_trace_enabled);
+
+void rk_media_buf_set_frame(struct dma_buf *dmabuf, u64 frame)
+{
+	unsigned long ino = rk_media_buf_ino(dmabuf);
+	unsigned long flags;
+
+	if (!ino || !trace_rk_media_buf_enabled())
+		return;
+
+	spin_lock_irqsave(&tags_lock, flags);
+	tags[ino % RK_MEDIA_TAG_SLOTS].ino = ino;
+	tags[ino % RK_MEDIA_TAG_SLOTS].frame = frame;
+	spin_unlock_irqrestore(&tags_lock, flags);
+}
+EXPORT_SYMBOL_GPL(rk_media_buf_set_frame);
+
+u64 rk_media_buf_get_frame(struct dma_buf *dmabuf)
+{
+	unsigned long ino = rk_media_buf_ino(dmabuf);
+	unsigned long flags;
+	u64 frame = 0;
+
+	if (!ino)
+		return 0;
+
+	spin_lock_irqsave(&tags_lock, flags);
+	if (tags[ino % RK_MEDIA_TAG_SLOTS].ino == ino)
+		frame = tags[ino % RK_MEDIA_TAG_SLOTS].frame;
+	spin_unlock_irqrestore(&tags_lock, flags);
+
+	return frame;
+}
+EXPORT_SYMBOL_GPL(rk_media_buf_get_frame);
+
+/* for a stage that writes a new buffer from an input frame */
+void rk_media_buf_copy_frame(struct dma_buf *dst, struct dma_buf *src)
+{
+	u64 frame;
+
+	if (!trace_rk_media_buf_enabled())
+		return;
+
+	frame = rk_media_buf_get_frame(src);
+	if (frame)
+		rk_media_buf_set_frame(dst, frame);
+}
+EXPORT_SYMBOL_GPL(rk_media_buf_copy_frame);
+
+void rk_media_buf_trace(struct device *dev, struct dma_buf *dmabuf,
+			enum rk_media_stage stage)
+{
+	if (!trace_rk_media_buf_enabled())
+		return;
+
+	trace_rk_media_buf(dev_name(dev), rk_media_buf_ino(dmabuf),
+			   rk_media_buf_get_frame(dmabuf), stage);
+}
+EXPORT_SYMBOL_GPL(rk_media_buf_trace);
+
+MODULE_DESCRIPTION("Rockchip media pipeline frame tracing");
+MODULE_LICENSE("GPL");
@@ -6,6 +6,7 @@
 //#define DEBUG
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
+#include <linux/crc32.h>
 #include <linux/devfreq.h>
 #include <linux/mfd/syscon.h>
 #include <linux/module.h>
@@ -15,9 +16,11 @@
 #include <linux/rockchip/rockchip_sip.h>
 #include <linux/slab.h>
 #include <linux/soc/rockchip/pvtm.h>
+#include <linux/soc/rockchip/rk_vendor_storage.h>
 #include <linux/thermal.h>
 #include <linux/pm_opp.h>
 #include <linux/version.h>
+#include <asm/system_info.h>
 #include <soc/rockchip/rockchip_opp_select.h>
 
 #include "../../clk/rockchip/clk.h"
@@ -36,6 +39,18 @@
 #define to_thermal_opp_info(nb) container_of(nb, struct thermal_opp_info, \
 					     thermal_nb)
 
+#define PVTPLL_CALIB_VENDOR_ID	0x101
+#define PVTPLL_CALIB_MAGIC	0x4c435650 /* "PVCL" */
+#define PVTPLL_CALIB_MAX_DEVS	8
+#define PVTPLL_CALIB_MAX_OPPS	24
+#define PVTPLL_CALIB_RETRY_MS	2000
+#define PVTPLL_CALIB_RETRIES	30
+
+#define PVTM_CACHE_VENDOR_ID	0x102
+#define PVTM_CACHE_MAGIC	0x43545650 /* "PVTC" */
+#define PVTM_CACHE_MAX_DEVS	8
+#define PVTM_CACHE_TEMP_DELTA	10 /* degrees from the measurement */
+
 struct sel_table {
 	int min;
 	int max;
@@ -47,6 +62,53 @@ struct bin_sel_table {
 	int sel;
 };
 
+/*
+ * Calibrated voltages of one device. opp_crc covers the opp rates, the dts
+ * voltages and the calibration setup, so a changed opp table or another
+ * chip bin calibrates again.
+ */
+struct pvtpll_calib_rec {
+	u32 dev_crc;
+	u32 opp_crc;
+	u32 count;
+	u32 u_volt[PVTPLL_CALIB_MAX_OPPS];
+	u32 u_volt_mem[PVTPLL_CALIB_MAX_OPPS];
+};
+
+struct pvtpll_calib_item {
+	u32 magic;
+	struct pvtpll_calib_rec rec[PVTPLL_CALIB_MAX_DEVS];
+};
+
+static struct pvtpll_calib_item *pvtpll_calib;
+static bool pvtpll_calib_loaded;
+static bool pvtpll_calib_dirty;
+static int pvtpll_calib_retries;
+static DEFINE_MUTEX(pvtpll_calib_mutex);
+
+/*
+ * Temperature compensated pvtm of one device. cfg_crc covers the chip
+ * serial and the pvtm setup in the dts, so another chip or another
+ * measurement setup measures again.
+ */
+struct pvtm_cache_rec {
+	u32 dev_crc;
+	u32 cfg_crc;
+	s32 temp;
+	s32 pvtm;
+};
+
+struct pvtm_cache_item {
+	u32 magic;
+	struct pvtm_cache_rec rec[PVTM_CACHE_MAX_DEVS];
+};
+
+static struct pvtm_cache_item *pvtm_cache;
+static bool pvtm_cache_loaded;
+static bool pvtm_cache_dirty;
+static int pvtm_cache_retries;
+static DEFINE_MUTEX(pvtm_cache_mutex);
+
 struct pvtm_config {
 	unsigned int freq;
 	unsigned int volt;
@@ -760,6 +822,7 @@ static int rockchip_pvtpll_parse_dt(struct rockchip_opp_info *info)
 		goto out;
 
 	ret = of_property_read_u32(np, "rockchip,pvtpll-volt-step", &info->pvtpll_volt_step);
+	info->pvtpll_calib_cache = of_property_read_bool(np, "rockchip,pvtpll-calib-cache");
 out:
 	of_node_put(np);
 
@@ -839,16 +902,219 @@ static int rockchip_pvtpll_set_clk(struct device *dev, struct clk *clk,
 	return ret;
 }
 
+static u32 rockchip_pvtpll_calib_crc(struct rockchip_opp_info *info,
+				     int count)
+{
+	u32 crc, val[3];
+	int i;
+
+	val[0] = info->bin;
+	val[1] = info->pvtpll_min_rate;
+	val[2] = info->pvtpll_volt_step;
+	crc = crc32_le(~0, (u8 *)val, sizeof(val));
+	for (i = 0; i < count; i++) {
+		val[0] = info->opp_table[i].rate / 1000;
+		val[1] = info->opp_table[i].u_volt;
+		val[2] = info->opp_table[i].u_volt_mem;
+		crc = crc32_le(crc, (u8 *)val, sizeof(val));
+	}
+
+	return crc;
+}
+
+static struct pvtpll_calib_rec *
+rockchip_pvtpll_calib_find(struct pvtpll_calib_item *item, u32 dev_crc,
+			   bool alloc)
+{
+	int i;
+
+	for (i = 0; i < PVTPLL_CALIB_MAX_DEVS; i++) {
+		if (item->rec[i].count && item->rec[i].dev_crc == dev_crc)
+			return &item->rec[i];
+	}
+	if (!alloc)
+		return NULL;
+	for (i = 0; i < PVTPLL_CALIB_MAX_DEVS; i++) {
+		if (!item->rec[i].count)
+			return &item->rec[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Read the stored item into pvtpll_calib, keeping the records of devices
+ * calibrated before vendor storage was ready. Called with
+ * pvtpll_calib_mutex held.
+ */
+static int rockchip_pvtpll_calib_get_item(void)
+{
+	struct pvtpll_calib_item *stored;
+	struct pvtpll_calib_rec *rec;
+	int i;
+
+	if (pvtpll_calib_loaded)
+		return 0;
+
+	if (!is_rk_vendor_ready())
+		return -EPROBE_DEFER;
+
+	stored = kzalloc(sizeof(*stored), GFP_KERNEL);
+	if (!stored)
+		return -ENOMEM;
+
+	if (rk_vendor_read(PVTPLL_CALIB_VENDOR_ID, stored,
+			   sizeof(*stored)) != sizeof(*stored) ||
+	    stored->magic != PVTPLL_CALIB_MAGIC) {
+		memset(stored, 0, sizeof(*stored));
+		stored->magic = PVTPLL_CALIB_MAGIC;
+	}
+
+	if (pvtpll_calib) {
+		for (i = 0; i < PVTPLL_CALIB_MAX_DEVS; i++) {
+			if (!pvtpll_calib->rec[i].count)
+				continue;
+			rec = rockchip_pvtpll_calib_find(stored,
+							 pvtpll_calib->rec[i].dev_crc,
+							 true);
+			if (rec)
+				*rec = pvtpll_calib->rec[i];
+		}
+		kfree(pvtpll_calib);
+	}
+	pvtpll_calib = stored;
+	pvtpll_calib_loaded = true;
+
+	return 0;
+}
+
+static void rockchip_pvtpll_calib_write(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pvtpll_calib_work, rockchip_pvtpll_calib_write);
+
+static void rockchip_pvtpll_calib_write(struct work_struct *work)
+{
+	mutex_lock(&pvtpll_calib_mutex);
+	if (!pvtpll_calib_dirty)
+		goto out;
+
+	/* the calibration ran before vendor storage was up, retry later */
+	if (rockchip_pvtpll_calib_get_item()) {
+		if (pvtpll_calib_retries++ < PVTPLL_CALIB_RETRIES)
+			schedule_delayed_work(&pvtpll_calib_work,
+					      msecs_to_jiffies(PVTPLL_CALIB_RETRY_MS));
+		goto out;
+	}
+
+	if (rk_vendor_write(PVTPLL_CALIB_VENDOR_ID, pvtpll_calib,
+			    sizeof(*pvtpll_calib)))
+		pr_err("%s: failed to save pvtpll calibration\n", __func__);
+	pvtpll_calib_dirty = false;
+out:
+	mutex_unlock(&pvtpll_calib_mutex);
+}
+
+static int rockchip_pvtpll_load_calib(struct rockchip_opp_info *info,
+				      int count)
+{
+	struct pvtpll_calib_rec *rec;
+	u32 dev_crc;
+	int i, ret;
+
+	if (count > PVTPLL_CALIB_MAX_OPPS)
+		return -EINVAL;
+
+	dev_crc = crc32_le(~0, dev_name(info->dev), strlen(dev_name(info->dev)));
+
+	mutex_lock(&pvtpll_calib_mutex);
+	ret = rockchip_pvtpll_calib_get_item();
+	if (ret)
+		goto out;
+
+	rec = rockchip_pvtpll_calib_find(pvtpll_calib, dev_crc, false);
+	if (!rec || rec->count != count ||
+	    rec->opp_crc != rockchip_pvtpll_calib_crc(info, count)) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		info->opp_table[i].u_volt = rec->u_volt[i];
+		info->opp_table[i].u_volt_mem = rec->u_volt_mem[i];
+	}
+out:
+	mutex_unlock(&pvtpll_calib_mutex);
+
+	return ret;
+}
+
+/* opp_crc is taken from the dts voltages, before the calibration */
+static void rockchip_pvtpll_save_calib(struct rockchip_opp_info *info,
+				       int count, u32 opp_crc)
+{
+	struct pvtpll_calib_rec *rec;
+	u32 dev_crc;
+	int i;
+
+	if (count > PVTPLL_CALIB_MAX_OPPS)
+		return;
+
+	dev_crc = crc32_le(~0, dev_name(info->dev), strlen(dev_name(info->dev)));
+
+	mutex_lock(&pvtpll_calib_mutex);
+	if (rockchip_pvtpll_calib_get_item() && !pvtpll_calib) {
+		/* merged into the stored item once vendor storage is ready */
+		pvtpll_calib = kzalloc(sizeof(*pvtpll_calib), GFP_KERNEL);
+		if (!pvtpll_calib)
+			goto out;
+		pvtpll_calib->magic = PVTPLL_CALIB_MAGIC;
+	}
+
+	rec = rockchip_pvtpll_calib_find(pvtpll_calib, dev_crc, true);
+	if (!rec)
+		goto out;
+
+	rec->dev_crc = dev_crc;
+	rec->opp_crc = opp_crc;
+	rec->count = count;
+	for (i = 0; i < count; i++) {
+		rec->u_volt[i] = info->opp_table[i].u_volt;
+		rec->u_volt_mem[i] = info->opp_table[i].u_volt_mem;
+	}
+	pvtpll_calib_dirty = true;
+	schedule_delayed_work(&pvtpll_calib_work, 0);
+out:
+	mutex_unlock(&pvtpll_calib_mutex);
+}
+
+static void rockchip_pvtpll_update_opp(struct rockchip_opp_info *info,
+				       struct opp_table *opp_table)
+{
+	struct dev_pm_opp *opp;
+	int i = 0;
+
+	mutex_lock(&opp_table->lock);
+	list_for_each_entry(opp, &opp_table->opp_list, node) {
+		if (!opp->available)
+			continue;
+
+		opp->supplies[0].u_volt = info->opp_table[i].u_volt;
+		if (opp_table->regulator_count > 1)
+			opp->supplies[1].u_volt = info->opp_table[i].u_volt_mem;
+		i++;
+	}
+	mutex_unlock(&opp_table->lock);
+}
+
 static void rockchip_pvtpll_calibrate_opp(struct rockchip_opp_info *info)
 {
 	struct opp_table *opp_table;
-	struct dev_pm_opp *opp;
 	struct regulator *reg = NULL, *reg_mem = NULL;
 	unsigned long old_volt = 0, old_volt_mem = 0;
 	unsigned long volt = 0, volt_mem = 0;
 	unsigned long volt_min, volt_max, volt_mem_min, volt_mem_max;
 	unsigned long rate, pvtpll_rate, old_rate, cur_rate, delta0, delta1;
 	int i = 0, max_count, step, cur_step, ret;
+	u32 opp_crc = 0;
 
 	if (!info || !info->pvtpll_base)
 		return;
@@ -866,6 +1132,17 @@ static void rockchip_pvtpll_calibrate_opp(struct rockchip_opp_info *info)
 	if (!opp_table)
 		return;
 
+	/* skip the voltage sweep if this chip was calibrated before */
+	if (info->pvtpll_calib_cache) {
+		opp_crc = rockchip_pvtpll_calib_crc(info, max_count);
+		if (!rockchip_pvtpll_load_calib(info, max_count)) {
+			rockchip_pvtpll_update_opp(info, opp_table);
+			dev_info(info->dev, "opp calibration restored\n");
+			dev_pm_opp_put_opp_table(opp_table);
+			return;
+		}
+	}
+
 	if (info->clocks) {
 		ret = clk_bulk_prepare_enable(info->nclocks, info->clocks);
 		if (ret) {
@@ -965,18 +1242,9 @@ static void rockchip_pvtpll_calibrate_opp(struct rockchip_opp_info *info)
 		}
 	}
 
-	i = 0;
-	mutex_lock(&opp_table->lock);
-	list_for_each_entry(opp, &opp_table->opp_list, node) {
-		if (!opp->available)
-			continue;
-
-		opp->supplies[0].u_volt = info->opp_table[i].u_volt;
-		if (opp_table->regulator_count > 1)
-			opp->supplies[1].u_volt = info->opp_table[i].u_volt_mem;
-		i++;
-	}
-	mutex_unlock(&opp_table->lock);
+	rockchip_pvtpll_update_opp(info, opp_table);
+	if (info->pvtpll_calib_cache)
+		rockchip_pvtpll_save_calib(info, max_count, opp_crc);
 	dev_info(info->dev, "opp calibration done\n");
 out:
 	if (cur_rate > old_rate)
@@ -1046,6 +1314,202 @@ static void rockchip_pvtpll_add_length(struct rockchip_opp_info *info)
 	of_node_put(np);
 }
 
+static const char * const pvtm_cache_props[] = {
+	"rockchip,pvtm-freq", "rockchip,pvtm-volt", "rockchip,pvtm-ch",
+	"rockchip,pvtm-sample-time", "rockchip,pvtm-number",
+	"rockchip,pvtm-error", "rockchip,pvtm-ref-temp",
+	"rockchip,pvtm-temp-prop", "rockchip,pvtm-offset",
+};
+
+static u32 rockchip_pvtm_cache_crc(struct device_node *np)
+{
+	const void *val;
+	u32 crc, serial[2];
+	int i, len;
+
+	serial[0] = system_serial_low;
+	serial[1] = system_serial_high;
+	crc = crc32_le(~0, (u8 *)serial, sizeof(serial));
+	for (i = 0; i < ARRAY_SIZE(pvtm_cache_props); i++) {
+		val = of_get_property(np, pvtm_cache_props[i], &len);
+		if (val)
+			crc = crc32_le(crc, val, len);
+	}
+
+	return crc;
+}
+
+static int rockchip_pvtm_cache_temp(struct device_node *np, int *temp)
+{
+	struct thermal_zone_device *tz;
+	const char *tz_name;
+
+	if (of_property_read_string(np, "rockchip,pvtm-thermal-zone", &tz_name) &&
+	    of_property_read_string(np, "rockchip,thermal-zone", &tz_name))
+		return -EINVAL;
+	tz = thermal_zone_get_zone_by_name(tz_name);
+	if (IS_ERR(tz))
+		return PTR_ERR(tz);
+
+	return thermal_zone_get_temp(tz, temp);
+}
+
+static struct pvtm_cache_rec *
+rockchip_pvtm_cache_find(struct pvtm_cache_item *item, u32 dev_crc, bool alloc)
+{
+	int i;
+
+	for (i = 0; i < PVTM_CACHE_MAX_DEVS; i++) {
+		if (item->rec[i].pvtm && item->rec[i].dev_crc == dev_crc)
+			return &item->rec[i];
+	}
+	if (!alloc)
+		return NULL;
+	for (i = 0; i < PVTM_CACHE_MAX_DEVS; i++) {
+		if (!item->rec[i].pvtm)
+			return &item->rec[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Read the stored item into pvtm_cache, keeping the records of devices
+ * measured before vendor storage was ready. Called with pvtm_cache_mutex
+ * held.
+ */
+static int rockchip_pvtm_cache_get_item(void)
+{
+	struct pvtm_cache_item *stored;
+	struct pvtm_cache_rec *rec;
+	int i;
+
+	if (pvtm_cache_loaded)
+		return 0;
+
+	if (!is_rk_vendor_ready())
+		return -EPROBE_DEFER;
+
+	stored = kzalloc(sizeof(*stored), GFP_KERNEL);
+	if (!stored)
+		return -ENOMEM;
+
+	if (rk_vendor_read(PVTM_CACHE_VENDOR_ID, stored,
+			   sizeof(*stored)) != sizeof(*stored) ||
+	    stored->magic != PVTM_CACHE_MAGIC) {
+		memset(stored, 0, sizeof(*stored));
+		stored->magic = PVTM_CACHE_MAGIC;
+	}
+
+	if (pvtm_cache) {
+		for (i = 0; i < PVTM_CACHE_MAX_DEVS; i++) {
+			if (!pvtm_cache->rec[i].pvtm)
+				continue;
+			rec = rockchip_pvtm_cache_find(stored,
+						       pvtm_cache->rec[i].dev_crc,
+						       true);
+			if (rec)
+				*rec = pvtm_cache->rec[i];
+		}
+		kfree(pvtm_cache);
+	}
+	pvtm_cache = stored;
+	pvtm_cache_loaded = true;
+
+	return 0;
+}
+
+static void rockchip_pvtm_cache_write(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pvtm_cache_work, rockchip_pvtm_cache_write);
+
+static void rockchip_pvtm_cache_write(struct work_struct *work)
+{
+	mutex_lock(&pvtm_cache_mutex);
+	if (!pvtm_cache_dirty)
+		goto out;
+
+	/* the measurement ran before vendor storage was up, retry later */
+	if (rockchip_pvtm_cache_get_item()) {
+		if (pvtm_cache_retries++ < PVTPLL_CALIB_RETRIES)
+			schedule_delayed_work(&pvtm_cache_work,
+					      msecs_to_jiffies(PVTPLL_CALIB_RETRY_MS));
+		goto out;
+	}
+
+	if (rk_vendor_write(PVTM_CACHE_VENDOR_ID, pvtm_cache, sizeof(*pvtm_cache)))
+		pr_err("%s: failed to save pvtm cache\n", __func__);
+	pvtm_cache_dirty = false;
+out:
+	mutex_unlock(&pvtm_cache_mutex);
+}
+
+/*
+ * Return the pvtm measured on an earlier boot, if it was measured within
+ * PVTM_CACHE_TEMP_DELTA of the current temperature, or 0.
+ */
+static int rockchip_pvtm_cache_load(struct device *dev, struct device_node *np)
+{
+	struct pvtm_cache_rec *rec;
+	int pvtm = 0, temp;
+	u32 dev_crc;
+
+	if (!of_property_read_bool(np, "rockchip,pvtm-cache"))
+		return 0;
+	if (rockchip_pvtm_cache_temp(np, &temp))
+		return 0;
+
+	dev_crc = crc32_le(~0, dev_name(dev), strlen(dev_name(dev)));
+
+	mutex_lock(&pvtm_cache_mutex);
+	if (rockchip_pvtm_cache_get_item())
+		goto out;
+	rec = rockchip_pvtm_cache_find(pvtm_cache, dev_crc, false);
+	if (!rec || rec->cfg_crc != rockchip_pvtm_cache_crc(np) ||
+	    abs(rec->temp - temp) > PVTM_CACHE_TEMP_DELTA * 1000)
+		goto out;
+	pvtm = rec->pvtm;
+	dev_info(dev, "pvtm = %d, from cache (temp=%d)\n", pvtm, rec->temp);
+out:
+	mutex_unlock(&pvtm_cache_mutex);
+
+	return pvtm;
+}
+
+static void rockchip_pvtm_cache_save(struct device *dev, struct device_node *np,
+				     int pvtm)
+{
+	struct pvtm_cache_rec *rec;
+	int temp;
+	u32 dev_crc;
+
+	if (!of_property_read_bool(np, "rockchip,pvtm-cache"))
+		return;
+	if (rockchip_pvtm_cache_temp(np, &temp))
+		return;
+
+	dev_crc = crc32_le(~0, dev_name(dev), strlen(dev_name(dev)));
+
+	mutex_lock(&pvtm_cache_mutex);
+	if (rockchip_pvtm_cache_get_item() && !pvtm_cache) {
+		/* merged into the stored item once vendor storage is ready */
+		pvtm_cache = kzalloc(sizeof(*pvtm_cache), GFP_KERNEL);
+		if (!pvtm_cache)
+			goto out;
+		pvtm_cache->magic = PVTM_CACHE_MAGIC;
+	}
+	rec = rockchip_pvtm_cache_find(pvtm_cache, dev_crc, true);
+	if (!rec)
+		goto out;
+	rec->dev_crc = dev_crc;
+	rec->cfg_crc = rockchip_pvtm_cache_crc(np);
+	rec->temp = temp;
+	rec->pvtm = pvtm;
+	pvtm_cache_dirty = true;
+	schedule_delayed_work(&pvtm_cache_work, 0);
+out:
+	mutex_unlock(&pvtm_cache_mutex);
+}
+
 static int rockchip_get_pvtm_pvtpll(struct device *dev, struct device_node *np,
 				    struct rockchip_opp_info *info,
 				    const char *reg_name)
@@ -1188,12 +1652,18 @@ static void rockchip_of_get_pvtm_sel(struct device *dev, struct device_node *np,
 	int pvtm, ret;
 	u32 hw = 0;
 
+	pvtm = rockchip_pvtm_cache_load(dev, np);
+	if (pvtm > 0)
+		goto sel;
 	if (of_property_read_bool(np, "rockchip,pvtm-pvtpll"))
 		pvtm = rockchip_get_pvtm_pvtpll(dev, np, info, reg_name);
 	else
 		pvtm = rockchip_get_pvtm(dev, np, reg_name);
 	if (pvtm <= 0)
 		return;
+	rockchip_pvtm_cache_save(dev, np, pvtm);
+
+sel:
 
 	if (!volt_sel)
 		goto next;
@@ -14,6 +14,17 @@ static cpumask_var_t cpul_mask, cpub_mask;
 static bool perf_init_done;
 static DEFINE_MUTEX(update_mutex);
 
+/*
+ * Place RT and misfit tasks on the cpu with the most thermal headroom,
+ * i.e. original capacity minus the thermal pressure that the cpufreq
+ * cooling devices of rockchip_thermal apply to its cluster.
+ */
+static bool thermal_aware = true;
+module_param(thermal_aware, bool, 0644);
+
+/* headroom difference worth a migration, to avoid ping-pong */
+#define PERF_HEADROOM_MARGIN	(SCHED_CAPACITY_SCALE >> 4)
+
 #ifdef CONFIG_UCLAMP_TASK
 static inline void set_uclamp_util_min_rt(unsigned int util)
 {
@@ -142,6 +153,31 @@ struct cpumask *rockchip_perf_get_cpub_mask(void)
 }
 
 #ifdef CONFIG_SMP
+static unsigned long perf_cpu_headroom(int cpu)
+{
+	return arch_scale_cpu_capacity(cpu) - arch_scale_thermal_pressure(cpu);
+}
+
+static int perf_select_coolest_cpu(int prev_cpu, struct cpumask *mask)
+{
+	unsigned long headroom, best_headroom = 0;
+	int cpu, best_cpu = nr_cpu_ids;
+
+	for_each_cpu(cpu, mask) {
+		headroom = perf_cpu_headroom(cpu);
+		if (best_cpu >= nr_cpu_ids || headroom > best_headroom) {
+			best_cpu = cpu;
+			best_headroom = headroom;
+		}
+	}
+
+	if (cpumask_test_cpu(prev_cpu, mask) &&
+	    perf_cpu_headroom(prev_cpu) + PERF_HEADROOM_MARGIN >= best_headroom)
+		return prev_cpu;
+
+	return best_cpu;
+}
+
 int rockchip_perf_select_rt_cpu(int prev_cpu, struct cpumask *lowest_mask)
 {
 	struct cpumask target_mask;
@@ -153,13 +189,17 @@ int rockchip_perf_select_rt_cpu(int prev_cpu, struct cpumask *lowest_mask)
 	if (static_branch_unlikely(&sched_asym_cpucapacity)) {
 		if (perf_level == 0)
 			cpumask_and(&target_mask, lowest_mask, cpul_mask);
-		if (perf_level == 2)
+		else if (perf_level == 2)
 			cpumask_and(&target_mask, lowest_mask, cpub_mask);
-
-		if (cpumask_test_cpu(prev_cpu, &target_mask))
+		else
 			return prev_cpu;
 
-		cpu = cpumask_first(&target_mask);
+		if (thermal_aware)
+			cpu = perf_select_coolest_cpu(prev_cpu, &target_mask);
+		else if (cpumask_test_cpu(prev_cpu, &target_mask))
+			return prev_cpu;
+		else
+			cpu = cpumask_first(&target_mask);
 
 		if (cpu < nr_cpu_ids)
 			return cpu;
@@ -168,6 +208,23 @@ int rockchip_perf_select_rt_cpu(int prev_cpu, struct cpumask *lowest_mask)
 	return prev_cpu;
 }
 
+/*
+ * A big cpu is worth leaving if another big cluster has clearly more
+ * headroom, so that sustained RT load follows the cooler cluster.
+ */
+static bool perf_big_cpu_throttled(int cpu)
+{
+	unsigned long headroom = perf_cpu_headroom(cpu) + PERF_HEADROOM_MARGIN;
+	int i;
+
+	for_each_cpu(i, cpub_mask) {
+		if (perf_cpu_headroom(i) > headroom)
+			return true;
+	}
+
+	return false;
+}
+
 bool rockchip_perf_misfit_rt(int cpu)
 {
 	if (!perf_init_done)
@@ -178,6 +235,9 @@ bool rockchip_perf_misfit_rt(int cpu)
 			return true;
 		if ((perf_level == 2) && cpumask_test_cpu(cpu, cpul_mask))
 			return true;
+		if ((perf_level == 2) && thermal_aware &&
+		    perf_big_cpu_throttled(cpu))
+			return true;
 	}
 
 	return false;
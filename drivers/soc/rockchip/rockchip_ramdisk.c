@@ -10,6 +10,8 @@
 #include <linux/blkdev.h>
 #include <linux/dax.h>
 #include <linux/module.h>
+#include <linux/io.h>
+#include <linux/memremap.h>
 #include <linux/of_address.h>
 #include <linux/pagemap.h>
 #include <linux/pfn_t.h>
@@ -25,91 +27,22 @@ struct rd_device {
 	size_t			mem_pages;
 	void			*mem_kaddr;
 	struct dax_device	*dax_dev;
+	/* ZONE_DEVICE pages of a no-map region, allows PMD DAX mappings */
+	struct dev_pagemap	pgmap;
+	u64			pfn_flags;
+	bool			pmd_dax;
 };
 
 static int rd_major;
 
 /*
- * Look up and return a rd's page for a given sector.
+ * The whole region is mapped contiguously at mem_kaddr, so a bvec never
+ * needs more than one memcpy and no lock is needed, bios of different
+ * queues just run in parallel.
  */
-static struct page *rd_lookup_page(struct rd_device *rd, sector_t sector)
+static void *rd_sector_addr(struct rd_device *rd, sector_t sector)
 {
-	pgoff_t idx;
-	struct page *page;
-
-	idx = sector >> PAGE_SECTORS_SHIFT; /* sector to page index */
-	page = phys_to_page(rd->mem_addr + (idx << PAGE_SHIFT));
-	BUG_ON(!page);
-
-	return page;
-}
-
-/*
- * Copy n bytes from src to the rd starting at sector. Does not sleep.
- */
-static void copy_to_rd(struct rd_device *rd, const void *src,
-		       sector_t sector, size_t n)
-{
-	struct page *page;
-	void *dst;
-	unsigned int offset = (sector & (PAGE_SECTORS - 1)) << SECTOR_SHIFT;
-	size_t copy;
-
-	copy = min_t(size_t, n, PAGE_SIZE - offset);
-	page = rd_lookup_page(rd, sector);
-	BUG_ON(!page);
-
-	dst = kmap_atomic(page);
-	memcpy(dst + offset, src, copy);
-	kunmap_atomic(dst);
-
-	if (copy < n) {
-		src += copy;
-		sector += copy >> SECTOR_SHIFT;
-		copy = n - copy;
-		page = rd_lookup_page(rd, sector);
-		BUG_ON(!page);
-
-		dst = kmap_atomic(page);
-		memcpy(dst, src, copy);
-		kunmap_atomic(dst);
-	}
-}
-
-/*
- * Copy n bytes to dst from the rd starting at sector. Does not sleep.
- */
-static void copy_from_rd(void *dst, struct rd_device *rd,
-			 sector_t sector, size_t n)
-{
-	struct page *page;
-	void *src;
-	unsigned int offset = (sector & (PAGE_SECTORS - 1)) << SECTOR_SHIFT;
-	size_t copy;
-
-	copy = min_t(size_t, n, PAGE_SIZE - offset);
-	page = rd_lookup_page(rd, sector);
-	if (page) {
-		src = kmap_atomic(page);
-		memcpy(dst, src + offset, copy);
-		kunmap_atomic(src);
-	} else {
-		memset(dst, 0, copy);
-	}
-
-	if (copy < n) {
-		dst += copy;
-		sector += copy >> SECTOR_SHIFT;
-		copy = n - copy;
-		page = rd_lookup_page(rd, sector);
-		if (page) {
-			src = kmap_atomic(page);
-			memcpy(dst, src, copy);
-			kunmap_atomic(src);
-		} else {
-			memset(dst, 0, copy);
-		}
-	}
+	return rd->mem_kaddr + (sector << SECTOR_SHIFT);
 }
 
 /*
@@ -121,15 +54,18 @@ static int rd_do_bvec(struct rd_device *rd, struct page *page,
 {
 	void *mem;
 
-	mem = kmap_atomic(page);
+	if (unlikely((sector << SECTOR_SHIFT) + len > rd->mem_size))
+		return -EIO;
+
+	mem = kmap_local_page(page);
 	if (!op_is_write(opf)) {
-		copy_from_rd(mem + off, rd, sector, len);
+		memcpy(mem + off, rd_sector_addr(rd, sector), len);
 		flush_dcache_page(page);
 	} else {
 		flush_dcache_page(page);
-		copy_to_rd(rd, mem + off, sector, len);
+		memcpy(rd_sector_addr(rd, sector), mem + off, len);
 	}
-	kunmap_atomic(mem);
+	kunmap_local(mem);
 
 	return 0;
 }
@@ -196,7 +132,7 @@ static long rd_dax_direct_access(struct dax_device *dax_dev, pgoff_t pgoff,
 	if (kaddr)
 		*kaddr = rd->mem_kaddr + offset;
 	if (pfn)
-		*pfn = phys_to_pfn_t(rd->mem_addr + offset, PFN_DEV | PFN_MAP);
+		*pfn = phys_to_pfn_t(rd->mem_addr + offset, rd->pfn_flags);
 
 	return nr_pages > max_nr_pages ? max_nr_pages : nr_pages;
 }
@@ -245,7 +181,6 @@ static int rd_init(struct rd_device *rd, int major, int minor)
 	set_capacity(disk, rd->mem_size >> SECTOR_SHIFT);
 	rd->rd_disk = disk;
 
-	rd->mem_kaddr = phys_to_virt(rd->mem_addr);
 	rd->mem_pages = PHYS_PFN(rd->mem_size);
 	rd->dax_dev = alloc_dax(rd, &rd_dax_ops);
 	if (IS_ERR(rd->dax_dev)) {
@@ -289,12 +224,59 @@ static int rd_init(struct rd_device *rd, int major, int minor)
 	return err;
 }
 
+/*
+ * A no-map region gets ZONE_DEVICE pages, exactly like pmem, which makes the
+ * pfns devmap and lets fs-dax insert PMD mappings for 2M aligned extents, so
+ * a read-only rootfs or model files on it run and mmap in place. A region
+ * that is part of the linear map is used through it as before.
+ */
+static int rd_map_memory(struct rd_device *rd, bool no_map)
+{
+	struct device *dev = rd->dev;
+	void *addr;
+
+	rd->pfn_flags = PFN_DEV | PFN_MAP;
+
+	if (!no_map) {
+		rd->mem_kaddr = phys_to_virt(rd->mem_addr);
+		return 0;
+	}
+
+	if (IS_ENABLED(CONFIG_ZONE_DEVICE) && IS_ENABLED(CONFIG_FS_DAX)) {
+		rd->pgmap.range.start = rd->mem_addr;
+		rd->pgmap.range.end = rd->mem_addr + rd->mem_size - 1;
+		rd->pgmap.nr_range = 1;
+		rd->pgmap.type = MEMORY_DEVICE_FS_DAX;
+		addr = devm_memremap_pages(dev, &rd->pgmap);
+		if (!IS_ERR(addr)) {
+			rd->mem_kaddr = addr;
+			rd->pmd_dax = IS_ALIGNED(rd->mem_addr, PMD_SIZE);
+			if (!rd->pmd_dax)
+				dev_info(dev, "region not PMD aligned, no huge dax mappings\n");
+			return 0;
+		}
+		dev_warn(dev, "memremap_pages failed %ld, no huge dax mappings\n",
+			 PTR_ERR(addr));
+	}
+
+	/* no struct pages behind the region, plain pfn mappings only */
+	addr = devm_memremap(dev, rd->mem_addr, rd->mem_size, MEMREMAP_WB);
+	if (IS_ERR(addr))
+		return PTR_ERR(addr);
+
+	rd->mem_kaddr = addr;
+	rd->pfn_flags = PFN_DEV;
+
+	return 0;
+}
+
 static int rd_probe(struct platform_device *pdev)
 {
 	struct rd_device *rd;
 	struct device *dev = &pdev->dev;
 	struct device_node *node;
 	struct resource reg;
+	bool no_map;
 	int ret;
 
 	rd = devm_kzalloc(dev, sizeof(*rd), GFP_KERNEL);
@@ -309,6 +291,7 @@ static int rd_probe(struct platform_device *pdev)
 	}
 
 	ret = of_address_to_resource(node, 0, &reg);
+	no_map = of_property_read_bool(node, "no-map");
 	of_node_put(node);
 	if (ret) {
 		dev_err(dev, "missing \"reg\" property\n");
@@ -318,9 +301,16 @@ static int rd_probe(struct platform_device *pdev)
 	rd->mem_addr = reg.start;
 	rd->mem_size = resource_size(&reg);
 
+	ret = rd_map_memory(rd, no_map);
+	if (ret) {
+		dev_err(dev, "failed to map memory %d\n", ret);
+		return ret;
+	}
+
 	ret = rd_init(rd, rd_major, 0);
-	dev_info(dev, "0x%zx@%pa -> 0x%px dax:%d ret:%d\n",
-		 rd->mem_size, &rd->mem_addr, rd->mem_kaddr, (bool)rd->dax_dev, ret);
+	dev_info(dev, "0x%zx@%pa -> 0x%px dax:%d pmd:%d ret:%d\n",
+		 rd->mem_size, &rd->mem_addr, rd->mem_kaddr, (bool)rd->dax_dev,
+		 rd->pmd_dax, ret);
 
 	return ret;
 }
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Rockchip runtime pm autosuspend tuning
+ *
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ *
+ * Media blocks such as the codecs power their domain around every job. When
+ * the device goes idle after a job it is suspended at once, which costs a
+ * full power down and power up per frame whenever the next job arrives
+ * sooner than that. Here the power up and power down costs are measured
+ * and, when the usual gap between two jobs is not much longer than those
+ * costs, the device is kept on for about two gaps with autosuspend instead.
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <soc/rockchip/rockchip_rpm_tune.h>
+
+/* keep the device on when the idle gap is below ratio times the wake cost */
+static unsigned int linger_ratio = 4;
+module_param(linger_ratio, uint, 0644);
+MODULE_PARM_DESC(linger_ratio, "Idle gap to wake cost ratio under which the device is kept on");
+
+static unsigned int min_delay_ms = 1;
+module_param(min_delay_ms, uint, 0644);
+MODULE_PARM_DESC(min_delay_ms, "Minimum autosuspend delay when kept on");
+
+/* decayed average, new samples weigh 1/4 */
+static void rpm_tune_avg(u64 *avg, u64 sample)
+{
+	if (!*avg)
+		*avg = sample;
+	else
+		*avg = (*avg * 3 + sample) >> 2;
+}
+
+static void rpm_tune_set_delay(struct rockchip_rpm_tune *tune, int delay_ms)
+{
+	if (tune->delay_ms == delay_ms)
+		return;
+
+	tune->delay_ms = delay_ms;
+	pm_runtime_set_autosuspend_delay(tune->dev, delay_ms);
+}
+
+void rockchip_rpm_tune_init(struct rockchip_rpm_tune *tune, struct device *dev)
+{
+	memset(tune, 0, sizeof(*tune));
+	spin_lock_init(&tune->lock);
+	tune->dev = dev;
+	tune->max_delay_ms = dev->power.autosuspend_delay;
+	tune->delay_ms = tune->max_delay_ms;
+}
+EXPORT_SYMBOL(rockchip_rpm_tune_init);
+
+int rockchip_rpm_tune_get_sync(struct rockchip_rpm_tune *tune)
+{
+	bool suspended = pm_runtime_suspended(tune->dev);
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = pm_runtime_get_sync(tune->dev);
+
+	spin_lock(&tune->lock);
+	if (suspended && ret >= 0) {
+		rpm_tune_avg(&tune->resume_ns, ktime_to_ns(ktime_sub(ktime_get(), start)));
+		tune->resume_cnt++;
+	}
+	if (tune->last_put)
+		rpm_tune_avg(&tune->gap_ns, ktime_to_ns(ktime_sub(start, tune->last_put)));
+	spin_unlock(&tune->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(rockchip_rpm_tune_get_sync);
+
+/*
+ * rockchip_rpm_tune_put - release the device after a job, @busy when more
+ * jobs are already queued. Must be called from process context.
+ */
+void rockchip_rpm_tune_put(struct rockchip_rpm_tune *tune, bool busy)
+{
+	u64 cost, gap;
+	ktime_t start;
+	bool linger;
+
+	spin_lock(&tune->lock);
+	tune->last_put = ktime_get();
+	cost = tune->resume_ns + tune->suspend_ns;
+	gap = tune->gap_ns;
+	linger = !busy && cost && gap && gap < cost * linger_ratio;
+	if (linger)
+		tune->linger_cnt++;
+	spin_unlock(&tune->lock);
+
+	if (busy) {
+		rpm_tune_set_delay(tune, tune->max_delay_ms);
+	} else if (linger) {
+		rpm_tune_set_delay(tune, clamp_t(int, DIV_ROUND_UP_ULL(gap * 2, NSEC_PER_MSEC),
+						 min_delay_ms, tune->max_delay_ms));
+	} else {
+		start = ktime_get();
+		pm_runtime_put_sync_suspend(tune->dev);
+		if (pm_runtime_suspended(tune->dev)) {
+			spin_lock(&tune->lock);
+			rpm_tune_avg(&tune->suspend_ns,
+				     ktime_to_ns(ktime_sub(ktime_get(), start)));
+			tune->suspend_cnt++;
+			spin_unlock(&tune->lock);
+		}
+		return;
+	}
+
+	pm_runtime_mark_last_busy(tune->dev);
+	pm_runtime_put_autosuspend(tune->dev);
+}
+EXPORT_SYMBOL(rockchip_rpm_tune_put);
+
+void rockchip_rpm_tune_show(struct seq_file *m, struct rockchip_rpm_tune *tune)
+{
+	spin_lock(&tune->lock);
+	seq_printf(m, "resume: %llu us (%llu)\n", div_u64(tune->resume_ns, NSEC_PER_USEC),
+		   tune->resume_cnt);
+	seq_printf(m, "suspend: %llu us (%llu)\n", div_u64(tune->suspend_ns, NSEC_PER_USEC),
+		   tune->suspend_cnt);
+	seq_printf(m, "gap: %llu us\n", div_u64(tune->gap_ns, NSEC_PER_USEC));
+	seq_printf(m, "delay: %d ms (max %d)\n", tune->delay_ms, tune->max_delay_ms);
+	seq_printf(m, "linger: %llu\n", tune->linger_cnt);
+	spin_unlock(&tune->lock);
+}
+EXPORT_SYMBOL(rockchip_rpm_tune_show);
+
+MODULE_DESCRIPTION("Rockchip runtime pm autosuspend tuning");
+MODULE_LICENSE("GPL");
@@ -7,6 +7,7 @@
 #include <linux/clk-provider.h>
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
+#include <linux/debugfs.h>
 #include <linux/devfreq.h>
 #include <linux/device.h>
 #include <linux/ebc.h>
@@ -24,6 +25,7 @@
 #include <linux/regulator/driver.h>
 #include <linux/regulator/machine.h>
 #include <linux/reboot.h>
+#include <linux/seq_file.h>
 #include <linux/rockchip/rockchip_sip.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
@@ -42,6 +44,9 @@
 #include "../../regulator/internal.h"
 #include "../../thermal/thermal_core.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/rockchip_system_monitor.h>
+
 #define CPU_REBOOT_FREQ		816000 /* kHz */
 #define VIDEO_1080P_SIZE	(1920 * 1080)
 #define THERMAL_POLLING_DELAY	200 /* milliseconds */
@@ -95,6 +100,28 @@ static LIST_HEAD(video_info_list);
 static LIST_HEAD(monitor_dev_list);
 static struct system_monitor *system_monitor;
 static atomic_t monitor_in_suspend;
+static struct dentry *monitor_debugfs_root;
+
+/*
+ * Deadline boost: every reported deadline miss raises the minimum frequency
+ * of the cpus and of the opted-in devices by boost_step percent of their
+ * maximum frequency, each boost_decay_ms without a miss drops one step.
+ */
+static unsigned int boost_step = 20;
+module_param(boost_step, uint, 0644);
+static unsigned int boost_decay_ms = 100;
+module_param(boost_decay_ms, uint, 0644);
+
+static atomic_t boost_level;
+static unsigned long boost_last_miss;
+static void rockchip_monitor_boost_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(boost_work, rockchip_monitor_boost_work);
+
+static const char * const monitor_cap_names[] = {
+	[MONITOR_CAP_THERMAL] = "thermal",
+	[MONITOR_CAP_WIDE_TEMP] = "wide-temp",
+	[MONITOR_CAP_STATUS] = "status",
+};
 
 static BLOCKING_NOTIFIER_HEAD(system_monitor_notifier_list);
 static BLOCKING_NOTIFIER_HEAD(system_status_notifier_list);
@@ -874,12 +901,108 @@ static int monitor_device_parse_dt(struct device *dev,
 	ret = monitor_device_parse_wide_temp_config(np, info);
 	ret &= monitor_device_parse_status_config(np, info);
 	ret &= monitor_device_parse_early_min_volt(np, info);
+	/* cpus are always boosted, other devices opt in */
+	if (info->devp->type == MONITOR_TYPE_CPU ||
+	    of_property_read_bool(np, "rockchip,deadline-boost"))
+		info->boost_max_freq = ULONG_MAX;
 
 	of_node_put(np);
 
 	return ret;
 }
 
+/*
+ * Account a change of the maximum frequency that @src applies to the
+ * device, @freq in KHz, 0 when @src stops capping.
+ */
+static void rockchip_monitor_record_cap(struct monitor_dev_info *info,
+					enum monitor_cap_source src,
+					unsigned long freq)
+{
+	struct monitor_cap_stat *stat = &info->cap_stat[src];
+	unsigned long flags, old_freq;
+	ktime_t now = ktime_get();
+	u64 capped_ns = 0;
+
+	spin_lock_irqsave(&info->cap_lock, flags);
+	old_freq = stat->freq;
+	if (old_freq == freq) {
+		spin_unlock_irqrestore(&info->cap_lock, flags);
+		return;
+	}
+	if (old_freq) {
+		capped_ns = ktime_to_ns(ktime_sub(now, stat->since));
+		stat->capped_ns += capped_ns;
+	}
+	if (freq)
+		stat->count++;
+	stat->freq = freq;
+	stat->since = now;
+	spin_unlock_irqrestore(&info->cap_lock, flags);
+
+	trace_rockchip_monitor_freq_cap(info->dev, monitor_cap_names[src],
+					old_freq, freq, capped_ns);
+}
+
+static int rockchip_monitor_get_max_freq(struct monitor_dev_info *info,
+					 unsigned long *freq)
+{
+	struct cpufreq_policy *policy;
+	struct devfreq *devfreq;
+
+	if (!info->devp->data)
+		return -ENODEV;
+
+	if (info->devp->type == MONITOR_TYPE_CPU) {
+		policy = (struct cpufreq_policy *)info->devp->data;
+		*freq = freq_qos_read_value(&policy->constraints,
+					    FREQ_QOS_MAX);
+	} else {
+		devfreq = (struct devfreq *)info->devp->data;
+		*freq = dev_pm_qos_read_value(devfreq->dev.parent,
+					      DEV_PM_QOS_MAX_FREQUENCY);
+	}
+
+	return 0;
+}
+
+static int monitor_caps_show(struct seq_file *s, void *data)
+{
+	struct monitor_dev_info *info = s->private;
+	struct monitor_cap_stat *stat;
+	unsigned long flags, qos_max, own_max = ULONG_MAX;
+	ktime_t now = ktime_get();
+	u64 capped_ns;
+	int i;
+
+	seq_puts(s, " source       cap(KHz)    count  capped(ms)\n");
+	spin_lock_irqsave(&info->cap_lock, flags);
+	for (i = 0; i < MONITOR_CAP_SOURCE_MAX; i++) {
+		stat = &info->cap_stat[i];
+		capped_ns = stat->capped_ns;
+		if (stat->freq) {
+			capped_ns += ktime_to_ns(ktime_sub(now, stat->since));
+			own_max = min(own_max, stat->freq);
+		}
+		seq_printf(s, " %-10s %10lu %8u %11llu\n", monitor_cap_names[i],
+			   stat->freq, stat->count,
+			   div_u64(capped_ns, NSEC_PER_MSEC));
+	}
+	spin_unlock_irqrestore(&info->cap_lock, flags);
+
+	/*
+	 * The aggregated constraint also holds the requests of userspace and
+	 * of the thermal cooling devices, name them if they win.
+	 */
+	if (!rockchip_monitor_get_max_freq(info, &qos_max))
+		seq_printf(s, " effective max %lu KHz, capped by %s\n", qos_max,
+			   qos_max < own_max ? "other qos" :
+			   own_max == ULONG_MAX ? "none" : "system monitor");
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(monitor_caps);
+
 int rockchip_monitor_cpu_low_temp_adjust(struct monitor_dev_info *info,
 					 bool is_low)
 {
@@ -895,6 +1018,8 @@ int rockchip_monitor_cpu_low_temp_adjust(struct monitor_dev_info *info,
 	else
 		freq_qos_update_request(&info->max_temp_freq_req,
 					FREQ_QOS_MAX_DEFAULT_VALUE);
+	rockchip_monitor_record_cap(info, MONITOR_CAP_WIDE_TEMP,
+				    is_low ? info->low_limit / 1000 : 0);
 
 	return 0;
 }
@@ -913,6 +1038,8 @@ int rockchip_monitor_cpu_high_temp_adjust(struct monitor_dev_info *info,
 		else
 			freq_qos_update_request(&info->max_temp_freq_req,
 						FREQ_QOS_MAX_DEFAULT_VALUE);
+		rockchip_monitor_record_cap(info, MONITOR_CAP_THERMAL,
+					    info->high_limit / 1000);
 		return 0;
 	}
 
@@ -925,6 +1052,8 @@ int rockchip_monitor_cpu_high_temp_adjust(struct monitor_dev_info *info,
 	else
 		freq_qos_update_request(&info->max_temp_freq_req,
 					FREQ_QOS_MAX_DEFAULT_VALUE);
+	rockchip_monitor_record_cap(info, MONITOR_CAP_THERMAL,
+				    is_high ? info->high_limit / 1000 : 0);
 
 	return 0;
 }
@@ -945,6 +1074,8 @@ int rockchip_monitor_dev_low_temp_adjust(struct monitor_dev_info *info,
 	else
 		dev_pm_qos_update_request(&info->dev_max_freq_req,
 					  PM_QOS_MAX_FREQUENCY_DEFAULT_VALUE);
+	rockchip_monitor_record_cap(info, MONITOR_CAP_WIDE_TEMP,
+				    is_low ? info->low_limit / 1000 : 0);
 
 	return 0;
 }
@@ -963,6 +1094,8 @@ int rockchip_monitor_dev_high_temp_adjust(struct monitor_dev_info *info,
 		else
 			dev_pm_qos_update_request(&info->dev_max_freq_req,
 						  PM_QOS_MAX_FREQUENCY_DEFAULT_VALUE);
+		rockchip_monitor_record_cap(info, MONITOR_CAP_THERMAL,
+					    info->high_limit / 1000);
 		return 0;
 	}
 
@@ -975,6 +1108,8 @@ int rockchip_monitor_dev_high_temp_adjust(struct monitor_dev_info *info,
 	else
 		dev_pm_qos_update_request(&info->dev_max_freq_req,
 					  PM_QOS_MAX_FREQUENCY_DEFAULT_VALUE);
+	rockchip_monitor_record_cap(info, MONITOR_CAP_THERMAL,
+				    is_high ? info->high_limit / 1000 : 0);
 
 	return 0;
 }
@@ -1267,10 +1402,15 @@ rockchip_system_monitor_freq_qos_requset(struct monitor_dev_info *info)
 	if (!info->devp->data)
 		return 0;
 
-	if (info->is_low_temp && info->low_limit)
+	if (info->is_low_temp && info->low_limit) {
 		max_default_value = info->low_limit / 1000;
-	else if (info->is_high_temp && info->high_limit)
+		rockchip_monitor_record_cap(info, MONITOR_CAP_WIDE_TEMP,
+					    max_default_value);
+	} else if (info->is_high_temp && info->high_limit) {
 		max_default_value = info->high_limit / 1000;
+		rockchip_monitor_record_cap(info, MONITOR_CAP_THERMAL,
+					    max_default_value);
+	}
 
 	if (info->devp->type == MONITOR_TYPE_CPU) {
 		policy = (struct cpufreq_policy *)info->devp->data;
@@ -1304,6 +1444,17 @@ rockchip_system_monitor_freq_qos_requset(struct monitor_dev_info *info)
 			freq_qos_remove_request(&info->min_sta_freq_req);
 			return ret;
 		}
+		if (info->boost_max_freq) {
+			info->boost_max_freq = policy->cpuinfo.max_freq;
+			if (freq_qos_add_request(&policy->constraints,
+						 &info->min_boost_freq_req,
+						 FREQ_QOS_MIN,
+						 FREQ_QOS_MIN_DEFAULT_VALUE) < 0) {
+				dev_info(info->dev,
+					 "failed to add boost freq constraint\n");
+				info->boost_max_freq = 0;
+			}
+		}
 	} else if (info->devp->type == MONITOR_TYPE_DEV) {
 		devfreq = (struct devfreq *)info->devp->data;
 		ret = dev_pm_qos_add_request(devfreq->dev.parent,
@@ -1314,6 +1465,22 @@ rockchip_system_monitor_freq_qos_requset(struct monitor_dev_info *info)
 			dev_info(info->dev, "failed to add freq constraint\n");
 			return ret;
 		}
+		if (info->boost_max_freq) {
+			unsigned long rate = ULONG_MAX;
+			struct dev_pm_opp *opp;
+
+			info->boost_max_freq = 0;
+			opp = dev_pm_opp_find_freq_floor(devfreq->dev.parent,
+							 &rate);
+			if (!IS_ERR(opp)) {
+				dev_pm_opp_put(opp);
+				if (dev_pm_qos_add_request(devfreq->dev.parent,
+							   &info->dev_min_boost_req,
+							   DEV_PM_QOS_MIN_FREQUENCY,
+							   PM_QOS_MIN_FREQUENCY_DEFAULT_VALUE) >= 0)
+					info->boost_max_freq = rate / 1000;
+			}
+		}
 	}
 
 	return 0;
@@ -1367,6 +1534,7 @@ rockchip_system_monitor_register(struct device *dev,
 		return ERR_PTR(-ENOMEM);
 	info->dev = dev;
 	info->devp = devp;
+	spin_lock_init(&info->cap_lock);
 
 	if (monitor_device_parse_dt(dev, info)) {
 		rockchip_system_monitor_check_rate_volt(info);
@@ -1383,6 +1551,11 @@ rockchip_system_monitor_register(struct device *dev,
 	list_add(&info->node, &monitor_dev_list);
 	up_write(&mdev_list_sem);
 
+	if (monitor_debugfs_root)
+		info->debugfs = debugfs_create_file(dev_name(dev), 0444,
+						    monitor_debugfs_root, info,
+						    &monitor_caps_fops);
+
 	return info;
 }
 EXPORT_SYMBOL(rockchip_system_monitor_register);
@@ -1392,6 +1565,8 @@ void rockchip_system_monitor_unregister(struct monitor_dev_info *info)
 	if (!info)
 		return;
 
+	debugfs_remove(info->debugfs);
+
 	down_write(&mdev_list_sem);
 	rockchip_system_monitor_early_regulator_uninit(info);
 	list_del(&info->node);
@@ -1404,9 +1579,13 @@ void rockchip_system_monitor_unregister(struct monitor_dev_info *info)
 			freq_qos_remove_request(&info->min_sta_freq_req);
 		if (freq_qos_request_active(&info->max_sta_freq_req))
 			freq_qos_remove_request(&info->max_sta_freq_req);
+		if (freq_qos_request_active(&info->min_boost_freq_req))
+			freq_qos_remove_request(&info->min_boost_freq_req);
 	} else {
 		if (dev_pm_qos_request_active(&info->dev_max_freq_req))
 			dev_pm_qos_remove_request(&info->dev_max_freq_req);
+		if (dev_pm_qos_request_active(&info->dev_min_boost_req))
+			dev_pm_qos_remove_request(&info->dev_min_boost_req);
 	}
 
 	kfree(info->low_temp_adjust_table);
@@ -1415,6 +1594,67 @@ void rockchip_system_monitor_unregister(struct monitor_dev_info *info)
 }
 EXPORT_SYMBOL(rockchip_system_monitor_unregister);
 
+static void rockchip_monitor_apply_boost(struct monitor_dev_info *info,
+					 int level)
+{
+	unsigned long freq = 0;
+
+	if (!info->boost_max_freq)
+		return;
+
+	if (level)
+		freq = min_t(unsigned long, info->boost_max_freq,
+			     info->boost_max_freq / 100 * boost_step * level);
+
+	if (info->devp->type == MONITOR_TYPE_CPU) {
+		if (freq_qos_request_active(&info->min_boost_freq_req))
+			freq_qos_update_request(&info->min_boost_freq_req,
+						freq ? freq : FREQ_QOS_MIN_DEFAULT_VALUE);
+	} else {
+		if (dev_pm_qos_request_active(&info->dev_min_boost_req))
+			dev_pm_qos_update_request(&info->dev_min_boost_req,
+						  freq ? freq : PM_QOS_MIN_FREQUENCY_DEFAULT_VALUE);
+	}
+}
+
+static void rockchip_monitor_boost_work(struct work_struct *work)
+{
+	unsigned long decay = msecs_to_jiffies(boost_decay_ms);
+	struct monitor_dev_info *info;
+	int level = atomic_read(&boost_level);
+
+	/* the deadlines are met again, decay one step */
+	if (level && time_after_eq(jiffies, READ_ONCE(boost_last_miss) + decay)) {
+		level = max(atomic_dec_if_positive(&boost_level), 0);
+		WRITE_ONCE(boost_last_miss, jiffies);
+	}
+
+	down_read(&mdev_list_sem);
+	list_for_each_entry(info, &monitor_dev_list, node)
+		rockchip_monitor_apply_boost(info, level);
+	up_read(&mdev_list_sem);
+
+	if (level)
+		queue_delayed_work(system_highpri_wq, &boost_work, decay);
+}
+
+/**
+ * rockchip_monitor_deadline_miss() - report a missed latency deadline
+ *
+ * For drivers that see their deadline missed, such as the display
+ * controller on underflow. It can be called from interrupt context.
+ */
+void rockchip_monitor_deadline_miss(void)
+{
+	if (!system_monitor || !boost_step)
+		return;
+
+	atomic_add_unless(&boost_level, 1, DIV_ROUND_UP(100, boost_step));
+	WRITE_ONCE(boost_last_miss, jiffies);
+	mod_delayed_work(system_highpri_wq, &boost_work, 0);
+}
+EXPORT_SYMBOL(rockchip_monitor_deadline_miss);
+
 int rockchip_system_monitor_register_notifier(struct notifier_block *nb)
 {
 	return blocking_notifier_chain_register(&system_monitor_notifier_list, nb);
@@ -1610,6 +1850,8 @@ static void rockchip_system_status_cpu_limit_freq(struct monitor_dev_info *info,
 					info->reboot_freq);
 		freq_qos_update_request(&info->min_sta_freq_req,
 					info->reboot_freq);
+		rockchip_monitor_record_cap(info, MONITOR_CAP_STATUS,
+					    info->reboot_freq);
 		return;
 	}
 
@@ -1628,6 +1870,8 @@ static void rockchip_system_status_cpu_limit_freq(struct monitor_dev_info *info,
 	else
 		freq_qos_update_request(&info->max_sta_freq_req,
 					FREQ_QOS_MAX_DEFAULT_VALUE);
+	rockchip_monitor_record_cap(info, MONITOR_CAP_STATUS,
+				    info->status_max_limit);
 }
 
 static void rockchip_system_status_limit_freq(unsigned long status)
@@ -1838,6 +2082,8 @@ static int rockchip_system_monitor_probe(struct platform_device *pdev)
 	cpumask_clear(&system_monitor->status_offline_cpus);
 	cpumask_clear(&system_monitor->offline_cpus);
 
+	monitor_debugfs_root = debugfs_create_dir("system_monitor", NULL);
+
 	rockchip_system_monitor_parse_dt(system_monitor);
 	if (system_monitor->tz) {
 		system_monitor->last_temp = INT_MAX;
@@ -4,6 +4,7 @@
  */
 
 #include <asm/cacheflush.h>
+#include <crypto/sha2.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/dma-mapping.h>
@@ -19,6 +20,8 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/soc/rockchip/rockchip_decompress.h>
+#include <linux/soc/rockchip/rockchip_thunderboot_graph.h>
+#include <linux/workqueue.h>
 
 #define SHA256_PROBE_TIMEOUT		1000
 #define SHA256_COMPARE_TIMEOUT		2000
@@ -146,13 +149,41 @@ struct  crypto_data {
 	struct crypto_lli_desc	*desc;
 	dma_addr_t		desc_dma;
 	int			calc_ret;
-	void			(*done_cb)(void *user_data,
+	/* returns true if it restarted the engine */
+	bool			(*done_cb)(void *user_data,
 					   int hash_ret,
 					   u8 *hash_val);
 	void			*cb_data;
 	u8			*hash;
+	u32			chunk_size;
 };
 
+/*
+ * Chunked verification: the image is cut into chunk_size pieces, the
+ * engine hashes them from the front while the other CPUs hash from the
+ * back, and the expected value is sha256 over the concatenated chunk
+ * digests.
+ */
+#define MERKLE_MAX_WORKERS		8
+
+struct tb_merkle {
+	struct crypto_data	*crypto;
+	dma_addr_t		data;
+	size_t			len;
+	u32			chunk;
+	u32			num;
+	u8			*digests;
+	const u8		*expect;
+	spinlock_t		lock;
+	u32			front;	/* next chunk for the engine */
+	u32			back;	/* one past the next chunk for the CPUs */
+	u32			engine_cur;
+	atomic_t		left;
+	struct work_struct	work[MERKLE_MAX_WORKERS];
+};
+
+static struct tb_merkle *tb_merkle;
+
 enum endian_mode {
 	BIG_ENDIAN = 0,
 	LITTLE_ENDIAN
@@ -194,15 +225,23 @@ static void word2byte(u32 word, u8 *ch, u32 endian)
 	}
 }
 
-static void sha256_done_cb(void *user_data, int hash_ret, u8 *hash_val)
+static void sha256_compare(const void *expect, const u8 *hash_val)
 {
-	CRYPTO_TRACE();
-	if (!memcmp(user_data, hash_val, 32)) {
+	if (!memcmp(expect, hash_val, SHA256_HASH_SIZE)) {
 		compare_done = true;
 		wake_up(&crypto_sha256_compare_done);
+		rk_tb_res_provide(RK_TB_RES(IMAGE));
 	}
 }
 
+static bool sha256_done_cb(void *user_data, int hash_ret, u8 *hash_val)
+{
+	CRYPTO_TRACE();
+	sha256_compare(user_data, hash_val);
+
+	return false;
+}
+
 static inline void clear_hash_out_reg(struct crypto_data *dev)
 {
 	int i;
@@ -257,10 +296,11 @@ static irqreturn_t rk_tb_crypto_irq_handle(int irq, void *dev_id)
 			crypto_info->calc_ret = 0;
 
 		CRYPTO_TRACE("interrupt_status = %08x", interrupt_status);
-		if (crypto_info->done_cb)
-			crypto_info->done_cb(crypto_info->cb_data,
-					     crypto_info->calc_ret,
-					     crypto_info->hash);
+		if (crypto_info->done_cb &&
+		    crypto_info->done_cb(crypto_info->cb_data,
+					 crypto_info->calc_ret,
+					 crypto_info->hash))
+			return IRQ_HANDLED;
 
 		rk_tb_crypto_disable_clk(crypto_info);
 	}
@@ -268,19 +308,10 @@ static irqreturn_t rk_tb_crypto_irq_handle(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
-int rk_tb_sha256(dma_addr_t data, size_t data_len, void *user_data)
+static void rk_tb_crypto_hash_start(struct crypto_data *crypto_info,
+				    dma_addr_t data, size_t data_len)
 {
 	u32 reg_ctrl = 0;
-	struct crypto_data *crypto_info;
-
-	wait_for_completion_interruptible_timeout(&sha256_probe_complete,
-						  SHA256_PROBE_TIMEOUT);
-	crypto_info = g_crypto_info;
-	if (!crypto_info)
-		return -ENODEV;
-
-	if (data % 4)
-		return -EINVAL;
 
 	clear_hash_out_reg(crypto_info);
 
@@ -320,16 +351,147 @@ int rk_tb_sha256(dma_addr_t data, size_t data_len, void *user_data)
 		      CRYPTO_WRITE_MASK_SHIFT) |
 		      CRYPTO_HASH_ENABLE);
 
+	crypto_info->calc_ret = -1;
+
 	CRYPTO_WRITE(crypto_info, CRYPTO_DMA_CTL, 0x00010001); /* start */
+}
 
-	crypto_info->calc_ret = -1;
+static size_t merkle_chunk_len(struct tb_merkle *m, u32 i)
+{
+	return min_t(size_t, m->chunk, m->len - (size_t)i * m->chunk);
+}
+
+static void merkle_chunk_done(struct tb_merkle *m)
+{
+	u8 root[SHA256_HASH_SIZE];
+
+	if (!atomic_dec_and_test(&m->left))
+		return;
+
+	sha256(m->digests, m->num * SHA256_HASH_SIZE, root);
+	sha256_compare(m->expect, root);
+}
+
+/* Called from the engine irq, hands it the next chunk from the front */
+static bool merkle_engine_done(void *user_data, int hash_ret, u8 *hash_val)
+{
+	struct tb_merkle *m = user_data;
+	unsigned long flags;
+	bool more;
+	u32 i;
+
+	if (hash_ret)
+		memset(&m->digests[m->engine_cur * SHA256_HASH_SIZE], 0,
+		       SHA256_HASH_SIZE);
+	else
+		memcpy(&m->digests[m->engine_cur * SHA256_HASH_SIZE], hash_val,
+		       SHA256_HASH_SIZE);
+
+	spin_lock_irqsave(&m->lock, flags);
+	more = m->front < m->back;
+	i = m->front;
+	if (more)
+		m->front++;
+	spin_unlock_irqrestore(&m->lock, flags);
+
+	if (more) {
+		m->engine_cur = i;
+		rk_tb_crypto_hash_start(m->crypto, m->data + (size_t)i * m->chunk,
+					merkle_chunk_len(m, i));
+	}
+
+	merkle_chunk_done(m);
+
+	return more;
+}
+
+static void merkle_cpu_work(struct work_struct *work)
+{
+	struct tb_merkle *m = tb_merkle;
+	u32 i;
+
+	for (;;) {
+		spin_lock_irq(&m->lock);
+		if (m->front >= m->back) {
+			spin_unlock_irq(&m->lock);
+			break;
+		}
+		i = --m->back;
+		spin_unlock_irq(&m->lock);
+
+		sha256(phys_to_virt(m->data + (size_t)i * m->chunk),
+		       merkle_chunk_len(m, i),
+		       &m->digests[i * SHA256_HASH_SIZE]);
+		merkle_chunk_done(m);
+	}
+}
+
+static int rk_tb_sha256_merkle(struct crypto_data *crypto_info, dma_addr_t data,
+			       size_t data_len, void *user_data)
+{
+	struct tb_merkle *m;
+	int i, workers;
+
+	m = devm_kzalloc(crypto_info->dev, sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	m->crypto = crypto_info;
+	m->data = data;
+	m->len = data_len;
+	m->chunk = crypto_info->chunk_size;
+	m->num = DIV_ROUND_UP(data_len, m->chunk);
+	m->expect = user_data;
+	m->digests = devm_kcalloc(crypto_info->dev, m->num, SHA256_HASH_SIZE,
+				  GFP_KERNEL);
+	if (!m->digests)
+		return -ENOMEM;
+
+	spin_lock_init(&m->lock);
+	atomic_set(&m->left, m->num);
+	m->engine_cur = 0;
+	m->front = 1;
+	m->back = m->num;
+	tb_merkle = m;
+
+	crypto_info->done_cb = merkle_engine_done;
+	crypto_info->cb_data = m;
+	rk_tb_crypto_hash_start(crypto_info, data, merkle_chunk_len(m, 0));
+
+	/* the calling thread keeps one CPU, the engine irq is cheap */
+	workers = clamp(num_online_cpus() - 1, 1, MERKLE_MAX_WORKERS);
+	for (i = 0; i < workers; i++) {
+		INIT_WORK(&m->work[i], merkle_cpu_work);
+		queue_work(system_unbound_wq, &m->work[i]);
+	}
+
+	return 0;
+}
+
+int rk_tb_sha256(dma_addr_t data, size_t data_len, void *user_data)
+{
+	struct crypto_data *crypto_info;
+
+	wait_for_completion_interruptible_timeout(&sha256_probe_complete,
+						  SHA256_PROBE_TIMEOUT);
+	crypto_info = g_crypto_info;
+	if (!crypto_info)
+		return -ENODEV;
+
+	if (data % 4)
+		return -EINVAL;
 
-	crypto_info->done_cb = sha256_done_cb;
-	crypto_info->cb_data = user_data;
 	crypto_info->hash = devm_kzalloc(crypto_info->dev, 32, GFP_KERNEL);
 	if (!crypto_info->hash)
 		return -ENOMEM;
 
+	if (crypto_info->chunk_size && data_len > crypto_info->chunk_size)
+		return rk_tb_sha256_merkle(crypto_info, data, data_len, user_data);
+
+	crypto_info->done_cb = sha256_done_cb;
+	crypto_info->cb_data = user_data;
+	rk_tb_crypto_hash_start(crypto_info, data, data_len);
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(rk_tb_sha256);
@@ -397,6 +559,12 @@ static int __init rk_tb_crypto_probe(struct platform_device *pdev)
 		goto exit;
 	}
 
+	/* digest "value" is then sha256 over the per-chunk sha256 */
+	device_property_read_u32(&pdev->dev, "rockchip,merkle-chunk-size",
+				 &crypto_info->chunk_size);
+	if (crypto_info->chunk_size % 4)
+		crypto_info->chunk_size = 0;
+
 	g_crypto_info = crypto_info;
 	platform_set_drvdata(pdev, crypto_info);
 	complete(&sha256_probe_complete);
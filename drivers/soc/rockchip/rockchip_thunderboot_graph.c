@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ *
+ * Early-init graph for thunder boot: drivers register the steps that wait
+ * for a resource the loader or the MCU hands over, and each step runs on
+ * an unbound worker as soon as everything it needs is ready, so unrelated
+ * branches (camera, storage, verified image) proceed on all CPUs at once.
+ */
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+#include <linux/soc/rockchip/rockchip_thunderboot_graph.h>
+#include <linux/spinlock.h>
+
+static const char * const rk_tb_res_names[RK_TB_RES_MAX] = {
+	[RK_TB_RES_MCU] = "mcu",
+	[RK_TB_RES_STORAGE] = "storage",
+	[RK_TB_RES_IMAGE] = "image",
+};
+
+static DEFINE_SPINLOCK(graph_lock);
+static LIST_HEAD(graph_nodes);
+static unsigned long res_ready;
+static ktime_t res_time[RK_TB_RES_MAX];
+
+/* Called with graph_lock held */
+static void rk_tb_graph_kick(void)
+{
+	struct rk_tb_node *node;
+
+	list_for_each_entry(node, &graph_nodes, node) {
+		if (node->queued || (node->needs & ~res_ready))
+			continue;
+
+		node->queued = true;
+		node->t_ready = ktime_get();
+		queue_work(system_unbound_wq, &node->work);
+	}
+}
+
+static void rk_tb_node_work(struct work_struct *work)
+{
+	struct rk_tb_node *node = container_of(work, struct rk_tb_node, work);
+
+	node->t_start = ktime_get();
+	node->ret = node->fn(node->data);
+	node->t_end = ktime_get();
+
+	pr_info("thunderboot: %s: ret %d, wait %lld us, run %lld us, done at %lld us\n",
+		node->name, node->ret,
+		ktime_us_delta(node->t_start, node->t_ready),
+		ktime_us_delta(node->t_end, node->t_start),
+		ktime_to_us(node->t_end));
+
+	if (!node->ret && node->provides)
+		rk_tb_res_provide(node->provides);
+}
+
+/**
+ * rk_tb_res_provide - mark resources as handed over
+ * @res: RK_TB_RES() mask
+ *
+ * Queues every node that was only waiting for @res. Safe in any context.
+ */
+void rk_tb_res_provide(unsigned long res)
+{
+	unsigned long flags, new;
+	ktime_t now = ktime_get();
+	int i;
+
+	spin_lock_irqsave(&graph_lock, flags);
+	new = res & ~res_ready;
+	for_each_set_bit(i, &new, RK_TB_RES_MAX)
+		res_time[i] = now;
+	res_ready |= res;
+	if (new)
+		rk_tb_graph_kick();
+	spin_unlock_irqrestore(&graph_lock, flags);
+}
+EXPORT_SYMBOL(rk_tb_res_provide);
+
+bool rk_tb_res_is_ready(unsigned long res)
+{
+	return (READ_ONCE(res_ready) & res) == res;
+}
+EXPORT_SYMBOL(rk_tb_res_is_ready);
+
+/**
+ * rk_tb_node_register - add a step to the early-init graph
+ * @node: caller owned, must stay valid until it has run
+ *
+ * The step runs right away if its needs are already met.
+ */
+int rk_tb_node_register(struct rk_tb_node *node)
+{
+	unsigned long flags;
+
+	if (!node || !node->fn || !node->name)
+		return -EINVAL;
+
+	INIT_WORK(&node->work, rk_tb_node_work);
+	node->queued = false;
+	node->ret = -EINPROGRESS;
+
+	spin_lock_irqsave(&graph_lock, flags);
+	list_add_tail(&node->node, &graph_nodes);
+	rk_tb_graph_kick();
+	spin_unlock_irqrestore(&graph_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(rk_tb_node_register);
+
+#ifdef CONFIG_DEBUG_FS
+static int rk_tb_graph_show(struct seq_file *s, void *v)
+{
+	struct rk_tb_node *node;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&graph_lock, flags);
+	for (i = 0; i < RK_TB_RES_MAX; i++) {
+		if (res_ready & BIT(i))
+			seq_printf(s, "res %-8s ready at %lld us\n",
+				   rk_tb_res_names[i], ktime_to_us(res_time[i]));
+		else
+			seq_printf(s, "res %-8s pending\n", rk_tb_res_names[i]);
+	}
+
+	list_for_each_entry(node, &graph_nodes, node) {
+		seq_printf(s, "node %-16s needs 0x%lx provides 0x%lx ",
+			   node->name, node->needs, node->provides);
+		if (!node->queued)
+			seq_printf(s, "waiting for 0x%lx\n", node->needs & ~res_ready);
+		else if (node->ret == -EINPROGRESS)
+			seq_puts(s, "running\n");
+		else
+			seq_printf(s, "ret %d ready %lld us wait %lld us run %lld us\n",
+				   node->ret, ktime_to_us(node->t_ready),
+				   ktime_us_delta(node->t_start, node->t_ready),
+				   ktime_us_delta(node->t_end, node->t_start));
+	}
+	spin_unlock_irqrestore(&graph_lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rk_tb_graph);
+
+static int __init rk_tb_graph_debugfs_init(void)
+{
+	debugfs_create_file("rk_tb_graph", 0444, NULL, NULL, &rk_tb_graph_fops);
+
+	return 0;
+}
+late_initcall(rk_tb_graph_debugfs_init);
+#endif
@@ -14,6 +14,7 @@
 #include <linux/platform_device.h>
 #include <linux/soc/rockchip/rockchip_decompress.h>
 #include <linux/soc/rockchip/rockchip_thunderboot_crypto.h>
+#include <linux/soc/rockchip/rockchip_thunderboot_graph.h>
 
 #define SDMMC_RINTSTS		0x044
 #define SDMMC_STATUS		0x048
@@ -117,6 +118,9 @@ static int rk_tb_mmc_thread(void *p)
 	of_node_put(dma);
 	iounmap(regs);
 
+	/* the loader is done with the controller, its driver may take over */
+	rk_tb_res_provide(RK_TB_RES(STORAGE));
+
 	return 0;
 }
 
@@ -11,6 +11,7 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/reset.h>
+#include <linux/soc/rockchip/rockchip_thunderboot_graph.h>
 #include <linux/soc/rockchip/rockchip_thunderboot_service.h>
 #include <soc/rockchip/rockchip-mailbox.h>
 
@@ -109,6 +110,8 @@ static void do_mcu_done(struct rk_tb_serv *serv)
 		}
 		atomic_set(&mcu_done, 1);
 		spin_unlock(&lock);
+
+		rk_tb_res_provide(RK_TB_RES(MCU));
 	}
 }
 
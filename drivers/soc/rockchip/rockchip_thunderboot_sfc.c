@@ -13,6 +13,7 @@
 #include <linux/platform_device.h>
 #include <linux/soc/rockchip/rockchip_decompress.h>
 #include <linux/soc/rockchip/rockchip_thunderboot_crypto.h>
+#include <linux/soc/rockchip/rockchip_thunderboot_graph.h>
 
 #define SFC_ICLR	0x08
 #define SFC_SR		0x24
@@ -93,6 +94,9 @@ static int rk_tb_sfc_thread(void *p)
 	of_node_put(rdd);
 	iounmap(regs);
 
+	/* the loader is done with the controller, its driver may take over */
+	rk_tb_res_provide(RK_TB_RES(STORAGE));
+
 	return 0;
 }
 
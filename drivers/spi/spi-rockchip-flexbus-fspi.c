@@ -12,15 +12,19 @@
 #include <linux/dma-mapping.h>
 #include <linux/iopoll.h>
 #include <linux/interrupt.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
 #include <linux/platform_device.h>
 #include <linux/spi/spi-mem.h>
+#include <linux/uaccess.h>
 
 #include <dt-bindings/mfd/rockchip-flexbus.h>
 #include <linux/mfd/rockchip-flexbus.h>
+#include <uapi/linux/rk-flexbus-fspi.h>
 
 #define FLEXBUS_FSPI_ERR_ISR	(FLEXBUS_DMA_TIMEOUT_ISR | FLEXBUS_DMA_ERR_ISR |	\
 				 FLEXBUS_TX_UDF_ISR | FLEXBUS_TX_OVF_ISR)
@@ -44,6 +48,30 @@
 #define FLEXBUS_MAX_CHIPSELECT_NUM		(1)
 #define FLEXBUS_TX_WIDTH			(4)
 
+#define FLEXBUS_STREAM_ISR			(FLEXBUS_DMA_DST0_ISR | FLEXBUS_DMA_DST1_ISR |	\
+						 FLEXBUS_DMA_SRC0_ISR | FLEXBUS_DMA_SRC1_ISR)
+#define FLEXBUS_STREAM_ERR_ISR			(FLEXBUS_FSPI_ERR_ISR | FLEXBUS_RX_UDF_ISR |	\
+						 FLEXBUS_RX_OVF_ISR)
+#define FLEXBUS_STREAM_BLOCK_ALIGN		(0x40)
+#define FLEXBUS_STREAM_BLOCK_MAX		(0x0fffffc0)
+
+struct rk_flexbus_fspi_stream {
+	struct miscdevice misc;
+	struct mutex lock;		/* serialises the ioctls */
+	spinlock_t slock;		/* head, tail and slot_seq */
+	wait_queue_head_t wq;
+	void *ring;
+	dma_addr_t ring_dma;
+	size_t ring_size;
+	struct flexbus_fspi_stream_cfg cfg;
+	u64 head;
+	u64 tail;
+	u64 slot_seq[2];
+	u32 xruns;
+	bool running;
+	bool opened;
+};
+
 struct rk_flexbus_fspi {
 	struct device *dev;
 	struct rockchip_flexbus *fb;
@@ -60,6 +88,7 @@ struct rk_flexbus_fspi {
 	u32 dll_cells[FLEXBUS_MAX_CHIPSELECT_NUM];
 	struct gpio_desc **cs_gpiods;
 	struct spi_controller *master;
+	struct rk_flexbus_fspi_stream stream;
 };
 
 struct rk_flexbus_fspi_xfer {
@@ -507,6 +536,10 @@ static int rk_flexbus_fspi_exec_mem_op(struct spi_mem *mem, const struct spi_mem
 	int ret;
 	u8 cs = mem->spi->chip_select;
 
+	/* Bus owned by the stream, io_mutex keeps the two apart */
+	if (fspi->stream.running)
+		return -EBUSY;
+
 	if (unlikely(mem->spi->max_speed_hz != fspi->speed[cs]) &&
 	    !has_acpi_companion(fspi->dev)) {
 		ret = rk_flexbus_fspi_clk_set_rate(fspi, mem->spi->max_speed_hz);
@@ -559,6 +592,373 @@ static const struct spi_controller_mem_ops rk_flexbus_fspi_mem_ops = {
 	.supports_op = rk_flexbus_fspi_supports_op,
 };
 
+static void rk_flexbus_fspi_stream_program(struct rk_flexbus_fspi *fspi, int slot, u64 seq)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	dma_addr_t addr;
+	u32 idx, reg;
+
+	div_u64_rem(seq, st->cfg.block_num, &idx);
+	addr = st->ring_dma + (dma_addr_t)idx * st->cfg.block_size;
+
+	if (st->cfg.dir == FLEXBUS_FSPI_STREAM_RX)
+		reg = slot ? FLEXBUS_DMA_DST_ADDR1 : FLEXBUS_DMA_DST_ADDR0;
+	else
+		reg = slot ? FLEXBUS_DMA_SRC_ADDR1 : FLEXBUS_DMA_SRC_ADDR0;
+
+	st->slot_seq[slot] = seq;
+	rockchip_flexbus_writel(fspi->fb, reg, addr >> 2);
+}
+
+/*
+ * A ping-pong slot finished: its block is complete and the slot is re-armed
+ * with the block after the one the other slot is working on, while the
+ * controller keeps clocking out of the other slot.
+ */
+static void rk_flexbus_fspi_stream_isr(struct rk_flexbus_fspi *fspi, u32 isr)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	bool rx = st->cfg.dir == FLEXBUS_FSPI_STREAM_RX;
+	u32 done[2];
+	u64 next;
+	int slot;
+
+	done[0] = rx ? FLEXBUS_DMA_DST0_ISR : FLEXBUS_DMA_SRC0_ISR;
+	done[1] = rx ? FLEXBUS_DMA_DST1_ISR : FLEXBUS_DMA_SRC1_ISR;
+
+	spin_lock(&st->slock);
+	for (slot = 0; slot < 2; slot++) {
+		if (!(isr & done[slot]))
+			continue;
+
+		st->head = st->slot_seq[slot] + 1;
+		next = max(st->slot_seq[0], st->slot_seq[1]) + 1;
+		if (rx && next - st->tail >= st->cfg.block_num) {
+			/* Ring full, drop the oldest block */
+			st->tail = next - st->cfg.block_num + 1;
+			st->xruns++;
+		} else if (!rx && next >= st->tail) {
+			/* Nothing new queued, resend stale data to keep the clock going */
+			st->tail = next + 1;
+			st->xruns++;
+		}
+		rk_flexbus_fspi_stream_program(fspi, slot, next);
+	}
+	spin_unlock(&st->slock);
+
+	wake_up_interruptible(&st->wq);
+}
+
+static void rk_flexbus_fspi_stream_free(struct rk_flexbus_fspi *fspi)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+
+	if (!st->ring)
+		return;
+
+	dma_free_coherent(fspi->fb->dev, st->ring_size, st->ring, st->ring_dma);
+	st->ring = NULL;
+	st->ring_size = 0;
+}
+
+static int rk_flexbus_fspi_stream_setup(struct rk_flexbus_fspi *fspi,
+					struct flexbus_fspi_stream_cfg *cfg)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	size_t size;
+
+	if (st->running)
+		return -EBUSY;
+
+	if ((cfg->dir != FLEXBUS_FSPI_STREAM_RX && cfg->dir != FLEXBUS_FSPI_STREAM_TX) ||
+	    cfg->block_num < 2 || cfg->cmd_len > FLEXBUS_FSPI_STREAM_CMD_MAX ||
+	    !cfg->block_size || cfg->block_size > FLEXBUS_STREAM_BLOCK_MAX ||
+	    !IS_ALIGNED(cfg->block_size, FLEXBUS_STREAM_BLOCK_ALIGN) ||
+	    check_mul_overflow((size_t)cfg->block_size, (size_t)cfg->block_num, &size))
+		return -EINVAL;
+
+	size = PAGE_ALIGN(size);
+	if (size != st->ring_size) {
+		rk_flexbus_fspi_stream_free(fspi);
+		st->ring = dma_alloc_coherent(fspi->fb->dev, size, &st->ring_dma, GFP_KERNEL);
+		if (!st->ring)
+			return -ENOMEM;
+		st->ring_size = size;
+	}
+
+	st->cfg = *cfg;
+	st->head = 0;
+	st->tail = 0;
+	st->xruns = 0;
+
+	return 0;
+}
+
+static int rk_flexbus_fspi_stream_start(struct rk_flexbus_fspi *fspi)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	struct rockchip_flexbus *fb = fspi->fb;
+	u32 cmd[2] = { 0 }, ctrl;
+	int i;
+
+	if (!st->ring)
+		return -EINVAL;
+	if (st->running)
+		return -EBUSY;
+
+	/* Same byte order as the tx_buf based command phase */
+	for (i = 0; i < st->cfg.cmd_len; i++)
+		cmd[i / 4] |= st->cfg.cmd[i] << (24 - (i % 4) * 8);
+
+	mutex_lock(&fspi->master->io_mutex);
+
+	rk_flexbus_fspi_set_cs_gpio(fspi, 0, true);
+	rockchip_flexbus_writel(fb, FLEXBUS_CSN_CFG, 0x10001);
+	rockchip_flexbus_writel(fb, FLEXBUS_ICR, 0xffffffff);
+
+	rockchip_flexbus_writel(fb, FLEXBUS_TX_CMD_LEN, st->cfg.cmd_len * 8);
+	rockchip_flexbus_writel(fb, FLEXBUS_TX_CMD0, cmd[0]);
+	rockchip_flexbus_writel(fb, FLEXBUS_TX_CMD1, cmd[1]);
+
+	spin_lock_irq(&st->slock);
+	rk_flexbus_fspi_stream_program(fspi, 0, st->head);
+	rk_flexbus_fspi_stream_program(fspi, 1, st->head + 1);
+	spin_unlock_irq(&st->slock);
+
+	/* Continue mode ignores TX_NUM/RX_NUM and runs until the channel is disabled */
+	if (st->cfg.dir == FLEXBUS_FSPI_STREAM_RX) {
+		ctrl = FLEXBUS_TX_THEN_RX | FLEXBUS_SCLK_SHARE | FLEXBUS_TX_USE_RX;
+		rockchip_flexbus_writel(fb, FLEXBUS_COM_CTL, ctrl);
+		rockchip_flexbus_writel(fb, FLEXBUS_TX_NUM, st->cfg.cmd_len * 8);
+		ctrl = FLEXBUS_RXD_DY | FLEXBUS_AUTOPAD | FLEXBUS_RX_CTL_MSB |
+		       FLEXBUS_CONTINUE_MODE | FLEXBUS_DFS_4BIT;
+		rockchip_flexbus_writel(fb, FLEXBUS_RX_CTL, ctrl);
+		rockchip_flexbus_writel(fb, FLEXBUS_RX_NUM, 0);
+		rockchip_flexbus_writel(fb, FLEXBUS_DMA_DST_LEN0, st->cfg.block_size);
+		rockchip_flexbus_writel(fb, FLEXBUS_DMA_DST_LEN1, st->cfg.block_size);
+		rockchip_flexbus_writel(fb, FLEXBUS_FREE_SCLK, FLEXBUS_RX_FREE_MODE);
+		rockchip_flexbus_writel(fb, FLEXBUS_IMR, FLEXBUS_DMA_DST0_ISR |
+					FLEXBUS_DMA_DST1_ISR | FLEXBUS_STREAM_ERR_ISR);
+		st->running = true;
+		rockchip_flexbus_writel(fb, FLEXBUS_ENR, FLEXBUS_TX_ENR | FLEXBUS_RX_ENR);
+	} else {
+		rockchip_flexbus_writel(fb, FLEXBUS_COM_CTL, FLEXBUS_TX_ONLY);
+		ctrl = FLEXBUS_TX_CTL_MSB | FLEXBUS_CONTINUE_MODE |
+		       (FLEXBUS_DFS_4BIT << FLEXBUS_DFS_SHIFT);
+		rockchip_flexbus_writel(fb, FLEXBUS_TX_CTL, ctrl);
+		rockchip_flexbus_writel(fb, FLEXBUS_TX_NUM, 0);
+		rockchip_flexbus_writel(fb, FLEXBUS_RX_CTL, 0);
+		rockchip_flexbus_writel(fb, FLEXBUS_RX_NUM, 0);
+		rockchip_flexbus_writel(fb, FLEXBUS_DMA_SRC_LEN0, st->cfg.block_size);
+		rockchip_flexbus_writel(fb, FLEXBUS_DMA_SRC_LEN1, st->cfg.block_size);
+		rockchip_flexbus_writel(fb, FLEXBUS_FREE_SCLK, FLEXBUS_TX_FREE_MODE);
+		rockchip_flexbus_writel(fb, FLEXBUS_IMR, FLEXBUS_DMA_SRC0_ISR |
+					FLEXBUS_DMA_SRC1_ISR | FLEXBUS_STREAM_ERR_ISR);
+		st->running = true;
+		rockchip_flexbus_writel(fb, FLEXBUS_ENR, FLEXBUS_TX_ENR);
+	}
+
+	mutex_unlock(&fspi->master->io_mutex);
+
+	return 0;
+}
+
+static void rk_flexbus_fspi_stream_stop(struct rk_flexbus_fspi *fspi)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	struct rockchip_flexbus *fb = fspi->fb;
+
+	if (!st->running)
+		return;
+
+	mutex_lock(&fspi->master->io_mutex);
+
+	rockchip_flexbus_writel(fb, FLEXBUS_ENR, FLEXBUS_TX_DIS | FLEXBUS_RX_DIS);
+	rockchip_flexbus_writel(fb, FLEXBUS_IMR, 0);
+	rockchip_flexbus_writel(fb, FLEXBUS_ICR, 0xffffffff);
+	/* write-enable bits only, clears both free running clocks */
+	rockchip_flexbus_writel(fb, FLEXBUS_FREE_SCLK, FLEXBUS_TX_DIS | FLEXBUS_RX_DIS);
+	rockchip_flexbus_writel(fb, FLEXBUS_CSN_CFG, 0x10000);
+	rk_flexbus_fspi_set_cs_gpio(fspi, 0, false);
+
+	/* back to the mem_ops defaults */
+	rockchip_flexbus_writel(fb, FLEXBUS_RX_CTL, 0);
+	rk_flexbus_fspi_init(fspi);
+	st->running = false;
+
+	mutex_unlock(&fspi->master->io_mutex);
+
+	wake_up_interruptible(&st->wq);
+}
+
+static bool rk_flexbus_fspi_stream_ready(struct rk_flexbus_fspi_stream *st)
+{
+	bool ready;
+
+	spin_lock_irq(&st->slock);
+	if (st->cfg.dir == FLEXBUS_FSPI_STREAM_RX)
+		ready = st->head != st->tail;
+	else
+		ready = st->tail - st->head < st->cfg.block_num;
+	spin_unlock_irq(&st->slock);
+
+	return ready || !st->running;
+}
+
+static void rk_flexbus_fspi_stream_advance(struct rk_flexbus_fspi_stream *st, u32 n)
+{
+	spin_lock_irq(&st->slock);
+	if (st->cfg.dir == FLEXBUS_FSPI_STREAM_RX)
+		st->tail += min_t(u64, n, st->head - st->tail);
+	else
+		st->tail += min_t(u64, n, st->cfg.block_num - (st->tail - st->head));
+	spin_unlock_irq(&st->slock);
+}
+
+static inline struct rk_flexbus_fspi *rk_flexbus_fspi_from_file(struct file *file)
+{
+	struct miscdevice *misc = file->private_data;
+
+	return container_of(misc, struct rk_flexbus_fspi, stream.misc);
+}
+
+static int rk_flexbus_fspi_stream_open(struct inode *inode, struct file *file)
+{
+	struct rk_flexbus_fspi *fspi = rk_flexbus_fspi_from_file(file);
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	int ret = 0;
+
+	mutex_lock(&st->lock);
+	if (st->opened)
+		ret = -EBUSY;
+	else
+		st->opened = true;
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+static int rk_flexbus_fspi_stream_release(struct inode *inode, struct file *file)
+{
+	struct rk_flexbus_fspi *fspi = rk_flexbus_fspi_from_file(file);
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+
+	mutex_lock(&st->lock);
+	rk_flexbus_fspi_stream_stop(fspi);
+	rk_flexbus_fspi_stream_free(fspi);
+	st->opened = false;
+	mutex_unlock(&st->lock);
+
+	return 0;
+}
+
+static int rk_flexbus_fspi_stream_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct rk_flexbus_fspi *fspi = rk_flexbus_fspi_from_file(file);
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	size_t size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	mutex_lock(&st->lock);
+	if (!st->ring || vma->vm_pgoff || size > st->ring_size)
+		ret = -EINVAL;
+	else
+		ret = dma_mmap_coherent(fspi->fb->dev, vma, st->ring, st->ring_dma, size);
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
+static long rk_flexbus_fspi_stream_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct rk_flexbus_fspi *fspi = rk_flexbus_fspi_from_file(file);
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	void __user *uarg = (void __user *)arg;
+	struct flexbus_fspi_stream_status status;
+	struct flexbus_fspi_stream_cfg cfg;
+	long ret = 0;
+	u32 n;
+
+	switch (cmd) {
+	case FLEXBUS_FSPI_STREAM_SETUP:
+		if (copy_from_user(&cfg, uarg, sizeof(cfg)))
+			return -EFAULT;
+		mutex_lock(&st->lock);
+		ret = rk_flexbus_fspi_stream_setup(fspi, &cfg);
+		mutex_unlock(&st->lock);
+		break;
+	case FLEXBUS_FSPI_STREAM_START:
+		mutex_lock(&st->lock);
+		ret = rk_flexbus_fspi_stream_start(fspi);
+		mutex_unlock(&st->lock);
+		break;
+	case FLEXBUS_FSPI_STREAM_STOP:
+		mutex_lock(&st->lock);
+		rk_flexbus_fspi_stream_stop(fspi);
+		mutex_unlock(&st->lock);
+		break;
+	case FLEXBUS_FSPI_STREAM_WAIT:
+		if (copy_from_user(&status, uarg, sizeof(status)))
+			return -EFAULT;
+		if (!st->ring)
+			return -EINVAL;
+		ret = wait_event_interruptible_timeout(st->wq, rk_flexbus_fspi_stream_ready(st),
+						       msecs_to_jiffies(status.timeout_ms));
+		if (ret < 0)
+			return ret;
+		spin_lock_irq(&st->slock);
+		status.head = st->head;
+		status.tail = st->tail;
+		status.xruns = st->xruns;
+		spin_unlock_irq(&st->slock);
+		if (copy_to_user(uarg, &status, sizeof(status)))
+			return -EFAULT;
+		ret = 0;
+		break;
+	case FLEXBUS_FSPI_STREAM_ADVANCE:
+		if (copy_from_user(&n, uarg, sizeof(n)))
+			return -EFAULT;
+		if (!st->ring)
+			return -EINVAL;
+		rk_flexbus_fspi_stream_advance(st, n);
+		break;
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+
+	return ret;
+}
+
+static const struct file_operations rk_flexbus_fspi_stream_fops = {
+	.owner = THIS_MODULE,
+	.open = rk_flexbus_fspi_stream_open,
+	.release = rk_flexbus_fspi_stream_release,
+	.mmap = rk_flexbus_fspi_stream_mmap,
+	.unlocked_ioctl = rk_flexbus_fspi_stream_ioctl,
+};
+
+static int rk_flexbus_fspi_stream_init(struct rk_flexbus_fspi *fspi)
+{
+	struct rk_flexbus_fspi_stream *st = &fspi->stream;
+	int ret;
+
+	mutex_init(&st->lock);
+	spin_lock_init(&st->slock);
+	init_waitqueue_head(&st->wq);
+
+	st->misc.minor = MISC_DYNAMIC_MINOR;
+	st->misc.name = "flexbus-fspi";
+	st->misc.fops = &rk_flexbus_fspi_stream_fops;
+	st->misc.parent = fspi->dev;
+
+	ret = misc_register(&st->misc);
+	if (ret)
+		st->misc.fops = NULL;
+
+	return ret;
+}
+
 static void rk_flexbus_fspi_irq_handler(struct rockchip_flexbus *rkfb, u32 isr)
 {
 	struct rk_flexbus_fspi *fspi = (struct rk_flexbus_fspi *)rkfb->fb0_data;
@@ -584,6 +984,12 @@ static void rk_flexbus_fspi_irq_handler(struct rockchip_flexbus *rkfb, u32 isr)
 		}
 	}
 
+	if (fspi->stream.running) {
+		if (isr & FLEXBUS_STREAM_ISR)
+			rk_flexbus_fspi_stream_isr(fspi, isr);
+		return;
+	}
+
 	if ((isr & FLEXBUS_TX_DONE_ISR) || (isr & FLEXBUS_RX_DONE_ISR))
 		complete(&fspi->cp);
 }
@@ -702,6 +1108,20 @@ static int rk_flexbus_fspi_probe(struct platform_device *pdev)
 	if (ret)
 		return -ENOMEM;
 
+	ret = rk_flexbus_fspi_stream_init(fspi);
+	if (ret)
+		dev_warn(dev, "streaming mode unavailable, ret=%d\n", ret);
+
+	return 0;
+}
+
+static int rk_flexbus_fspi_remove(struct platform_device *pdev)
+{
+	struct rk_flexbus_fspi *fspi = platform_get_drvdata(pdev);
+
+	if (fspi->stream.misc.fops)
+		misc_deregister(&fspi->stream.misc);
+
 	return 0;
 }
 
@@ -736,6 +1156,7 @@ static struct platform_driver rk_flexbus_fspi_driver = {
 		.pm = &rk_flexbus_fspi_pm_ops,
 	},
 	.probe	= rk_flexbus_fspi_probe,
+	.remove	= rk_flexbus_fspi_remove,
 };
 module_platform_driver(rk_flexbus_fspi_driver);
 
@@ -8,6 +8,7 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
+#include <linux/gpio/consumer.h>
 #include <linux/interrupt.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -18,6 +19,8 @@
 #include <linux/spi/spi.h>
 #include <linux/pm_runtime.h>
 #include <linux/scatterlist.h>
+#include <linux/uaccess.h>
+#include <uapi/linux/rk-spi-stream.h>
 
 #define DRIVER_NAME "rockchip-spi"
 
@@ -173,6 +176,8 @@
 
 #define ROCKCHIP_SPI_REGISTER_SIZE		0x1000
 
+#define ROCKCHIP_SPI_STREAM_BLOCK_ALIGN		64
+
 enum rockchip_spi_xfer_mode {
 	ROCKCHIP_SPI_DMA,
 	ROCKCHIP_SPI_IRQ,
@@ -183,6 +188,24 @@ struct rockchip_spi_quirks {
 	u32 max_baud_div_in_cpha;
 };
 
+struct rockchip_spi_stream {
+	struct mutex lock;		/* serialises the ioctls */
+	spinlock_t slock;		/* head and tail */
+	wait_queue_head_t wq;
+	struct file *owner;
+	struct device *dma_dev;		/* device the ring is allocated for */
+	void *ring;
+	dma_addr_t ring_dma;
+	size_t ring_size;
+	void *dummy;			/* zeros sent on MOSI while receiving */
+	dma_addr_t dummy_dma;
+	struct rkspi_stream_cfg cfg;
+	u64 head;
+	u64 tail;
+	u32 xruns;
+	bool running;
+};
+
 struct rockchip_spi {
 	struct device *dev;
 
@@ -226,6 +249,7 @@ struct rockchip_spi {
 	struct spi_transfer *xfer; /* Store xfer temporarily */
 	phys_addr_t base_addr_phy;
 	struct miscdevice miscdev;
+	struct rockchip_spi_stream stream;
 
 	/* quirks */
 	u32 max_baud_div_in_cpha;
@@ -828,6 +852,10 @@ static int rockchip_spi_transfer_one(
 		return -EINVAL;
 	}
 
+	/* Bus owned by the stream, io_mutex keeps the two apart */
+	if (rs->stream.running)
+		return -EBUSY;
+
 	rs->n_bytes = xfer->bits_per_word <= 8 ? 1 : 2;
 	rs->xfer = xfer;
 	if (rs->poll) {
@@ -919,6 +947,290 @@ static int rockchip_spi_setup(struct spi_device *spi)
 	return 0;
 }
 
+static void rockchip_spi_stream_cb(void *data)
+{
+	struct rockchip_spi *rs = data;
+	struct rockchip_spi_stream *st = &rs->stream;
+	bool rx = st->cfg.dir == RKSPI_STREAM_RX;
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->slock, flags);
+	/* The DMA has moved on to block head */
+	st->head++;
+	if (rx && st->head - st->tail >= st->cfg.block_num) {
+		/* Ring full, drop the oldest block */
+		st->tail = st->head - st->cfg.block_num + 1;
+		st->xruns++;
+	} else if (!rx && st->head >= st->tail) {
+		/* Nothing new queued, stale data goes out to keep the clock going */
+		st->tail = st->head + 1;
+		st->xruns++;
+	}
+	spin_unlock_irqrestore(&st->slock, flags);
+
+	wake_up_interruptible(&st->wq);
+}
+
+static void rockchip_spi_stream_free(struct rockchip_spi *rs)
+{
+	struct rockchip_spi_stream *st = &rs->stream;
+
+	if (st->dummy) {
+		dma_free_coherent(st->dma_dev, st->cfg.block_size, st->dummy, st->dummy_dma);
+		st->dummy = NULL;
+	}
+
+	if (st->ring) {
+		dma_free_coherent(st->dma_dev, st->ring_size, st->ring, st->ring_dma);
+		st->ring = NULL;
+		st->ring_size = 0;
+	}
+}
+
+static int rockchip_spi_stream_setup(struct spi_controller *ctlr,
+				     struct rkspi_stream_cfg *cfg)
+{
+	struct rockchip_spi *rs = spi_controller_get_devdata(ctlr);
+	struct rockchip_spi_stream *st = &rs->stream;
+	size_t size;
+
+	if (st->running)
+		return -EBUSY;
+
+	if (!ctlr->dma_rx || !ctlr->dma_tx || ctlr->slave)
+		return -EOPNOTSUPP;
+
+	if ((cfg->dir != RKSPI_STREAM_RX && cfg->dir != RKSPI_STREAM_TX) ||
+	    cfg->block_num < 2 || !cfg->block_size ||
+	    !IS_ALIGNED(cfg->block_size, ROCKCHIP_SPI_STREAM_BLOCK_ALIGN) ||
+	    (cfg->bits_per_word != 8 && cfg->bits_per_word != 16) ||
+	    cfg->chip_select >= ctlr->num_chipselect ||
+	    cfg->mode & ~(SPI_CPHA | SPI_CPOL) ||
+	    !cfg->speed_hz || cfg->speed_hz > ctlr->max_speed_hz ||
+	    check_mul_overflow((size_t)cfg->block_size, (size_t)cfg->block_num, &size))
+		return -EINVAL;
+
+	/* Receiving also runs the TX channel, over a zeroed block */
+	if (cfg->dir == RKSPI_STREAM_RX &&
+	    ctlr->dma_tx->device->dev != ctlr->dma_rx->device->dev)
+		return -EOPNOTSUPP;
+
+	rockchip_spi_stream_free(rs);
+	st->dma_dev = cfg->dir == RKSPI_STREAM_RX ? ctlr->dma_rx->device->dev :
+			ctlr->dma_tx->device->dev;
+	size = PAGE_ALIGN(size);
+	st->ring = dma_alloc_coherent(st->dma_dev, size, &st->ring_dma, GFP_KERNEL);
+	if (!st->ring)
+		return -ENOMEM;
+	st->ring_size = size;
+	st->cfg = *cfg;
+
+	if (cfg->dir == RKSPI_STREAM_RX) {
+		st->dummy = dma_alloc_coherent(st->dma_dev, cfg->block_size,
+					       &st->dummy_dma, GFP_KERNEL);
+		if (!st->dummy) {
+			rockchip_spi_stream_free(rs);
+			return -ENOMEM;
+		}
+	}
+
+	st->head = 0;
+	st->tail = 0;
+	st->xruns = 0;
+
+	return 0;
+}
+
+static void rockchip_spi_stream_set_cs(struct spi_controller *ctlr, bool enable)
+{
+	struct rockchip_spi *rs = spi_controller_get_devdata(ctlr);
+	u8 cs = rs->stream.cfg.chip_select;
+
+	if (ctlr->cs_gpiods && ctlr->cs_gpiods[cs]) {
+		gpiod_set_value_cansleep(ctlr->cs_gpiods[cs], enable);
+		cs = 0;
+	}
+
+	if (enable)
+		ROCKCHIP_SPI_SET_BITS(rs->regs + ROCKCHIP_SPI_SER, BIT(cs));
+	else
+		ROCKCHIP_SPI_CLR_BITS(rs->regs + ROCKCHIP_SPI_SER, BIT(cs));
+}
+
+static int rockchip_spi_stream_start(struct spi_controller *ctlr)
+{
+	struct rockchip_spi *rs = spi_controller_get_devdata(ctlr);
+	struct rockchip_spi_stream *st = &rs->stream;
+	u8 n_bytes = st->cfg.bits_per_word <= 8 ? 1 : 2;
+	struct dma_async_tx_descriptor *rxdesc = NULL, *txdesc;
+	struct dma_slave_config txconf = {
+		.direction = DMA_MEM_TO_DEV,
+		.dst_addr = rs->dma_addr_tx,
+		.dst_addr_width = n_bytes,
+		.dst_maxburst = rs->fifo_len / 4,
+	};
+	bool rx = st->cfg.dir == RKSPI_STREAM_RX;
+	u32 cr0, dmacr = TF_DMA_EN;
+	size_t ring_len = (size_t)st->cfg.block_size * st->cfg.block_num;
+	int ret = 0;
+
+	if (!st->ring)
+		return -EINVAL;
+	if (st->running)
+		return -EBUSY;
+
+	mutex_lock(&ctlr->io_mutex);
+
+	cr0 = CR0_FRF_SPI << CR0_FRF_OFFSET |
+	      CR0_BHT_8BIT << CR0_BHT_OFFSET |
+	      CR0_SSD_ONE << CR0_SSD_OFFSET |
+	      CR0_EM_BIG << CR0_EM_OFFSET;
+	cr0 |= rs->rsd << CR0_RSD_OFFSET;
+	cr0 |= CR0_CSM_KEEP << CR0_CSM_OFFSET;
+	cr0 |= (st->cfg.mode & 0x3U) << CR0_SCPH_OFFSET;
+	cr0 |= (n_bytes == 1 ? CR0_DFS_8BIT : CR0_DFS_16BIT) << CR0_DFS_OFFSET;
+	/* RO mode stops after CTRLR1 frames, receive in full duplex instead */
+	cr0 |= (rx ? CR0_XFM_TR : CR0_XFM_TO) << CR0_XFM_OFFSET;
+
+	spi_enable_chip(rs, false);
+	writel_relaxed(cr0, rs->regs + ROCKCHIP_SPI_CTRLR0);
+	writel_relaxed(2 * DIV_ROUND_UP(rs->freq, 2 * st->cfg.speed_hz),
+		       rs->regs + ROCKCHIP_SPI_BAUDR);
+	rs->speed_hz = st->cfg.speed_hz;
+	writel_relaxed(rs->fifo_len / 2 - 1, rs->regs + ROCKCHIP_SPI_DMATDLR);
+	writel_relaxed(0, rs->regs + ROCKCHIP_SPI_IMR);
+	writel_relaxed(0xffffffff, rs->regs + ROCKCHIP_SPI_ICR);
+
+	if (rx) {
+		struct dma_slave_config rxconf = {
+			.direction = DMA_DEV_TO_MEM,
+			.src_addr = rs->dma_addr_rx,
+			.src_addr_width = n_bytes,
+			.src_maxburst = rockchip_spi_calc_burst_size(st->cfg.block_size / n_bytes),
+		};
+
+		dmaengine_slave_config(ctlr->dma_rx, &rxconf);
+		writel_relaxed(rxconf.src_maxburst - 1, rs->regs + ROCKCHIP_SPI_DMARDLR);
+		rxdesc = dmaengine_prep_dma_cyclic(ctlr->dma_rx, st->ring_dma, ring_len,
+						   st->cfg.block_size, DMA_DEV_TO_MEM,
+						   DMA_PREP_INTERRUPT);
+		if (!rxdesc) {
+			ret = -EINVAL;
+			goto out;
+		}
+		rxdesc->callback = rockchip_spi_stream_cb;
+		rxdesc->callback_param = rs;
+		dmacr |= RF_DMA_EN;
+	}
+
+	dmaengine_slave_config(ctlr->dma_tx, &txconf);
+	if (rx)
+		txdesc = dmaengine_prep_dma_cyclic(ctlr->dma_tx, st->dummy_dma,
+						   st->cfg.block_size, st->cfg.block_size,
+						   DMA_MEM_TO_DEV, 0);
+	else
+		txdesc = dmaengine_prep_dma_cyclic(ctlr->dma_tx, st->ring_dma, ring_len,
+						   st->cfg.block_size, DMA_MEM_TO_DEV,
+						   DMA_PREP_INTERRUPT);
+	if (!txdesc) {
+		if (rxdesc)
+			dmaengine_desc_free(rxdesc);
+		ret = -EINVAL;
+		goto out;
+	}
+	if (!rx) {
+		txdesc->callback = rockchip_spi_stream_cb;
+		txdesc->callback_param = rs;
+	}
+
+	writel_relaxed(dmacr, rs->regs + ROCKCHIP_SPI_DMACR);
+
+	rockchip_spi_stream_set_cs(ctlr, true);
+	st->running = true;
+
+	/* rx must be started before tx due to spi instinct */
+	if (rxdesc) {
+		dmaengine_submit(rxdesc);
+		dma_async_issue_pending(ctlr->dma_rx);
+	}
+
+	spi_enable_chip(rs, true);
+
+	dmaengine_submit(txdesc);
+	dma_async_issue_pending(ctlr->dma_tx);
+
+out:
+	mutex_unlock(&ctlr->io_mutex);
+
+	return ret;
+}
+
+static void rockchip_spi_stream_stop(struct spi_controller *ctlr)
+{
+	struct rockchip_spi *rs = spi_controller_get_devdata(ctlr);
+	struct rockchip_spi_stream *st = &rs->stream;
+
+	if (!st->running)
+		return;
+
+	mutex_lock(&ctlr->io_mutex);
+
+	dmaengine_terminate_sync(ctlr->dma_tx);
+	if (st->cfg.dir == RKSPI_STREAM_RX)
+		dmaengine_terminate_sync(ctlr->dma_rx);
+	spi_enable_chip(rs, false);
+	writel_relaxed(0, rs->regs + ROCKCHIP_SPI_DMACR);
+	writel_relaxed(0xffffffff, rs->regs + ROCKCHIP_SPI_ICR);
+	rockchip_spi_stream_set_cs(ctlr, false);
+	st->running = false;
+
+	mutex_unlock(&ctlr->io_mutex);
+
+	wake_up_interruptible(&st->wq);
+}
+
+static bool rockchip_spi_stream_ready(struct rockchip_spi_stream *st)
+{
+	bool ready;
+
+	spin_lock_irq(&st->slock);
+	if (st->cfg.dir == RKSPI_STREAM_RX)
+		ready = st->head != st->tail;
+	else
+		ready = st->tail - st->head < st->cfg.block_num;
+	spin_unlock_irq(&st->slock);
+
+	return ready || !st->running;
+}
+
+static void rockchip_spi_stream_advance(struct rockchip_spi_stream *st, u32 n)
+{
+	spin_lock_irq(&st->slock);
+	if (st->cfg.dir == RKSPI_STREAM_RX)
+		st->tail += min_t(u64, n, st->head - st->tail);
+	else
+		st->tail += min_t(u64, n, st->cfg.block_num - (st->tail - st->head));
+	spin_unlock_irq(&st->slock);
+}
+
+static int rockchip_spi_stream_mmap(struct rockchip_spi *rs, struct vm_area_struct *vma)
+{
+	struct rockchip_spi_stream *st = &rs->stream;
+	size_t size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	mutex_lock(&st->lock);
+	if (!st->ring || size > st->ring_size) {
+		ret = -EINVAL;
+	} else {
+		vma->vm_pgoff = 0;
+		ret = dma_mmap_coherent(st->dma_dev, vma, st->ring, st->ring_dma, size);
+	}
+	mutex_unlock(&st->lock);
+
+	return ret;
+}
+
 static int rockchip_spi_misc_open(struct inode *inode, struct file *filp)
 {
 	struct miscdevice *misc = filp->private_data;
@@ -935,6 +1247,15 @@ static int rockchip_spi_misc_release(struct inode *inode, struct file *filp)
 	struct miscdevice *misc = filp->private_data;
 	struct spi_controller *ctlr = dev_get_drvdata(misc->parent);
 	struct rockchip_spi *rs = spi_controller_get_devdata(ctlr);
+	struct rockchip_spi_stream *st = &rs->stream;
+
+	mutex_lock(&st->lock);
+	if (st->owner == filp) {
+		rockchip_spi_stream_stop(ctlr);
+		rockchip_spi_stream_free(rs);
+		st->owner = NULL;
+	}
+	mutex_unlock(&st->lock);
 
 	pm_runtime_put(rs->dev);
 
@@ -949,6 +1270,9 @@ static int rockchip_spi_mmap(struct file *filp, struct vm_area_struct *vma)
 	size_t size = vma->vm_end - vma->vm_start;
 	int err;
 
+	if (vma->vm_pgoff == RKSPI_STREAM_MMAP_OFFSET >> PAGE_SHIFT)
+		return rockchip_spi_stream_mmap(rs, vma);
+
 	if (size > ROCKCHIP_SPI_REGISTER_SIZE) {
 		dev_warn(misc->parent, "mmap size is out of limitation\n");
 		return -EINVAL;
@@ -967,10 +1291,85 @@ static int rockchip_spi_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 }
 
+static long rockchip_spi_misc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct miscdevice *misc = filp->private_data;
+	struct spi_controller *ctlr = dev_get_drvdata(misc->parent);
+	struct rockchip_spi *rs = spi_controller_get_devdata(ctlr);
+	struct rockchip_spi_stream *st = &rs->stream;
+	void __user *uarg = (void __user *)arg;
+	struct rkspi_stream_status status;
+	struct rkspi_stream_cfg cfg;
+	long ret = 0;
+	u32 n;
+
+	switch (cmd) {
+	case RKSPI_STREAM_SETUP:
+		if (copy_from_user(&cfg, uarg, sizeof(cfg)))
+			return -EFAULT;
+		mutex_lock(&st->lock);
+		if (st->owner && st->owner != filp) {
+			ret = -EBUSY;
+		} else {
+			ret = rockchip_spi_stream_setup(ctlr, &cfg);
+			st->owner = ret ? NULL : filp;
+		}
+		mutex_unlock(&st->lock);
+		break;
+	case RKSPI_STREAM_START:
+		mutex_lock(&st->lock);
+		if (st->owner != filp)
+			ret = -EBUSY;
+		else
+			ret = rockchip_spi_stream_start(ctlr);
+		mutex_unlock(&st->lock);
+		break;
+	case RKSPI_STREAM_STOP:
+		mutex_lock(&st->lock);
+		if (st->owner != filp)
+			ret = -EBUSY;
+		else
+			rockchip_spi_stream_stop(ctlr);
+		mutex_unlock(&st->lock);
+		break;
+	case RKSPI_STREAM_WAIT:
+		if (copy_from_user(&status, uarg, sizeof(status)))
+			return -EFAULT;
+		if (st->owner != filp)
+			return -EBUSY;
+		ret = wait_event_interruptible_timeout(st->wq, rockchip_spi_stream_ready(st),
+						       msecs_to_jiffies(status.timeout_ms));
+		if (ret < 0)
+			return ret;
+		spin_lock_irq(&st->slock);
+		status.head = st->head;
+		status.tail = st->tail;
+		status.xruns = st->xruns;
+		spin_unlock_irq(&st->slock);
+		if (copy_to_user(uarg, &status, sizeof(status)))
+			return -EFAULT;
+		ret = 0;
+		break;
+	case RKSPI_STREAM_ADVANCE:
+		if (copy_from_user(&n, uarg, sizeof(n)))
+			return -EFAULT;
+		if (st->owner != filp)
+			return -EBUSY;
+		rockchip_spi_stream_advance(st, n);
+		break;
+	default:
+		ret = -ENOTTY;
+		break;
+	}
+
+	return ret;
+}
+
 static const struct file_operations rockchip_spi_misc_fops = {
 	.open		= rockchip_spi_misc_open,
 	.release	= rockchip_spi_misc_release,
 	.mmap		= rockchip_spi_mmap,
+	.unlocked_ioctl	= rockchip_spi_misc_ioctl,
 };
 
 static int rockchip_spi_probe(struct platform_device *pdev)
@@ -1233,6 +1632,10 @@ static int rockchip_spi_probe(struct platform_device *pdev)
 		rs->miscdev.fops = &rockchip_spi_misc_fops;
 		rs->miscdev.parent = &pdev->dev;
 
+		mutex_init(&rs->stream.lock);
+		spin_lock_init(&rs->stream.slock);
+		init_waitqueue_head(&rs->stream.wq);
+
 		ret = misc_register(&rs->miscdev);
 		if (ret)
 			dev_err(&pdev->dev, "failed to register misc device %s\n", misc_name);
@@ -8,6 +8,8 @@
 
 #define pr_fmt(fmt) "Power allocator: " fmt
 
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/thermal.h>
@@ -23,6 +25,17 @@
 #define int_to_frac(x) ((x) << FRAC_BITS)
 #define frac_to_int(x) ((x) >> FRAC_BITS)
 
+/* upper bound of the forecast lead over the measured temperature */
+#define PREDICT_MAX_LEAD	10000 /* millicelsius */
+
+/*
+ * Control on the temperature forecast predict_ms ahead from the measured
+ * heating rate rather than on the current temperature, so that power is
+ * cut before the trip is overshot. 0 disables the forecast.
+ */
+static unsigned int predict_ms;
+module_param(predict_ms, uint, 0644);
+
 /**
  * mul_frac() - multiply two fixed-point numbers
  * @x:	first multiplicand
@@ -65,6 +78,10 @@ static inline s64 div_frac(s64 x, s64 y)
  *					controlling for.
  * @sustainable_power:	Sustainable power (heat) that this thermal zone can
  *			dissipate
+ * @slope:	smoothed heating rate of the thermal zone in millicelsius per
+ *		second
+ * @prev_temp:	temperature at the previous throttle call
+ * @prev_time:	time of the previous throttle call, 0 until it is known
  */
 struct power_allocator_params {
 	bool allocated_tzp;
@@ -73,6 +90,9 @@ struct power_allocator_params {
 	int trip_switch_on;
 	int trip_max_desired_temperature;
 	u32 sustainable_power;
+	s32 slope;
+	int prev_temp;
+	ktime_t prev_time;
 };
 
 /**
@@ -199,6 +219,7 @@ static u32 get_sustainable_power(struct thermal_zone_device *tz,
 /**
  * pid_controller() - PID controller
  * @tz:	thermal zone we are operating in
+ * @temp:	the (forecast) temperature of the zone in millicelsius
  * @control_temp:	the target temperature in millicelsius
  * @max_allocatable_power:	maximum allocatable power for this thermal zone
  *
@@ -215,7 +236,7 @@ static u32 get_sustainable_power(struct thermal_zone_device *tz,
  * Return: The power budget for the next period.
  */
 static u32 pid_controller(struct thermal_zone_device *tz,
-			  int control_temp,
+			  int temp, int control_temp,
 			  u32 max_allocatable_power)
 {
 	s64 p, i, d, power_range;
@@ -227,7 +248,7 @@ static u32 pid_controller(struct thermal_zone_device *tz,
 
 	sustainable_power = get_sustainable_power(tz, params, control_temp);
 
-	err = control_temp - tz->temperature;
+	err = control_temp - temp;
 	err = int_to_frac(err);
 
 	/* Calculate the proportional term */
@@ -380,7 +401,7 @@ static void divvy_up_power(u32 *req_power, u32 *max_power, int num_actors,
 		}
 }
 
-static int allocate_power(struct thermal_zone_device *tz,
+static int allocate_power(struct thermal_zone_device *tz, int temp,
 			  int control_temp)
 {
 	struct thermal_instance *instance;
@@ -461,7 +482,8 @@ static int allocate_power(struct thermal_zone_device *tz,
 		i++;
 	}
 
-	power_range = pid_controller(tz, control_temp, max_allocatable_power);
+	power_range = pid_controller(tz, temp, control_temp,
+				     max_allocatable_power);
 
 	divvy_up_power(weighted_req_power, max_power, num_actors,
 		       total_weighted_req_power, power_range, granted_power,
@@ -562,6 +584,44 @@ static void reset_pid_controller(struct power_allocator_params *params)
 	params->prev_err = 0;
 }
 
+/**
+ * predict_temperature() - forecast the temperature of a thermal zone
+ * @tz:	thermal zone we are operating in
+ * @params:	governor data holding the heating rate history
+ *
+ * Track the heating rate over the throttle calls and extrapolate it by
+ * predict_ms. Only heating is extrapolated, a cooling zone is controlled on
+ * its measured temperature so that power is not granted ahead of time.
+ *
+ * Return: the forecast temperature in millicelsius.
+ */
+static int predict_temperature(struct thermal_zone_device *tz,
+			       struct power_allocator_params *params)
+{
+	ktime_t now = ktime_get();
+	s64 delta_ms, lead;
+	s32 slope;
+
+	if (params->prev_time) {
+		delta_ms = ktime_ms_delta(now, params->prev_time);
+		if (delta_ms > 0) {
+			slope = div_s64((s64)(tz->temperature -
+					      params->prev_temp) * MSEC_PER_SEC,
+					delta_ms);
+			params->slope = (3 * params->slope + slope) / 4;
+		}
+	}
+	params->prev_time = now;
+	params->prev_temp = tz->temperature;
+
+	if (!predict_ms || params->slope <= 0)
+		return tz->temperature;
+
+	lead = div_s64((s64)params->slope * predict_ms, MSEC_PER_SEC);
+
+	return tz->temperature + min_t(s64, lead, PREDICT_MAX_LEAD);
+}
+
 static void allow_maximum_power(struct thermal_zone_device *tz, bool update)
 {
 	struct thermal_instance *instance;
@@ -698,7 +758,7 @@ static void power_allocator_unbind(struct thermal_zone_device *tz)
 static int power_allocator_throttle(struct thermal_zone_device *tz, int trip)
 {
 	int ret;
-	int switch_on_temp, control_temp;
+	int switch_on_temp, control_temp, temp;
 	struct power_allocator_params *params = tz->governor_data;
 	bool update;
 
@@ -711,9 +771,11 @@ static int power_allocator_throttle(struct thermal_zone_device *tz, int trip)
 	if (trip != params->trip_max_desired_temperature)
 		return 0;
 
+	temp = predict_temperature(tz, params);
+
 	ret = tz->ops->get_trip_temp(tz, params->trip_switch_on,
 				     &switch_on_temp);
-	if (!ret && (tz->temperature < switch_on_temp)) {
+	if (!ret && (temp < switch_on_temp)) {
 		update = (tz->last_temperature >= switch_on_temp);
 		tz->passive = 0;
 		reset_pid_controller(params);
@@ -732,7 +794,7 @@ static int power_allocator_throttle(struct thermal_zone_device *tz, int trip)
 		return ret;
 	}
 
-	return allocate_power(tz, control_temp);
+	return allocate_power(tz, temp, control_temp);
 }
 
 static struct thermal_governor thermal_gov_power_allocator = {
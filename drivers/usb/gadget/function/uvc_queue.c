@@ -231,6 +231,10 @@ int uvcg_queue_init(struct uvc_video_queue *queue, struct device *dev, enum v4l2
 	queue->queue.buf_struct_size = sizeof(struct uvc_buffer);
 	queue->queue.ops = &uvc_queue_qops;
 	queue->queue.lock = lock;
+	/*
+	 * With sg the requests point at the buffer pages, so a dma-buf
+	 * imported from the encoder is sent over bulk or isoc without a copy.
+	 */
 #if defined(CONFIG_ARCH_ROCKCHIP) && defined(CONFIG_NO_GKI)
 	if (cdev->gadget->sg_supported && !opts->uvc_zero_copy) {
 #else
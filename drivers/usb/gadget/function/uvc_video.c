@@ -193,15 +193,107 @@ uvc_video_encode_bulk(struct usb_request *req, struct uvc_video *video,
 		video->payload_size = 0;
 }
 
+/*
+ * Point up to nents scatterlist entries at the next len bytes of the video
+ * buffer, without copying. Returns the number of bytes not covered.
+ */
+static unsigned int
+uvc_video_encode_sg_data(struct uvc_buffer *buf, struct scatterlist *sg,
+		unsigned int nents, unsigned int len, unsigned int *num_sgs)
+{
+	struct scatterlist *iter;
+	unsigned int sg_left, part = 0;
+	unsigned int i;
+
+	for_each_sg(sg, iter, nents, i) {
+		if (!len || !buf->sg || !buf->sg->length)
+			break;
+
+		sg_left = buf->sg->length - buf->offset;
+		part = min_t(unsigned int, len, sg_left);
+
+		sg_set_page(iter, sg_page(buf->sg), part, buf->offset);
+
+		if (part == sg_left) {
+			buf->offset = 0;
+			buf->sg = sg_next(buf->sg);
+		} else {
+			buf->offset += part;
+		}
+		len -= part;
+	}
+
+	*num_sgs = i;
+
+	return len;
+}
+
+static void
+uvc_video_encode_bulk_sg(struct usb_request *req, struct uvc_video *video,
+		struct uvc_buffer *buf)
+{
+	unsigned int pending = buf->bytesused - video->queue.buf_used;
+	struct uvc_request *ureq = req->context;
+	struct scatterlist *sg = ureq->sgt.sgl;
+	unsigned int nents = ureq->sgt.nents;
+	unsigned int len = video->req_size;
+	unsigned int header_len = 0;
+	unsigned int num_sgs = 0;
+	unsigned int i;
+
+	sg_init_table(sg, nents);
+
+	/* Add a header at the beginning of the payload. */
+	if (video->payload_size == 0) {
+		header_len = uvc_video_encode_header(video, buf, ureq->header,
+						     len);
+		sg_set_buf(sg, ureq->header, header_len);
+		sg = sg_next(sg);
+		nents--;
+		num_sgs++;
+		video->payload_size += header_len;
+		len -= header_len;
+	}
+
+	/* The video data is sent straight from the vb2 buffer pages */
+	len = min3(len, video->max_payload_size - video->payload_size, pending);
+	len -= uvc_video_encode_sg_data(buf, sg, nents, len, &i);
+	num_sgs += i;
+
+	req->buf = NULL;
+	req->sg = ureq->sgt.sgl;
+	req->num_sgs = num_sgs;
+	req->length = header_len + len;
+
+	video->payload_size += len;
+	video->queue.buf_used += len;
+	req->zero = video->payload_size == video->max_payload_size;
+
+	if (buf->bytesused == video->queue.buf_used || !buf->sg) {
+		video->queue.buf_used = 0;
+		buf->state = UVC_BUF_STATE_DONE;
+		buf->offset = 0;
+		list_del(&buf->queue);
+		video->fid ^= UVC_STREAM_FID;
+		ureq->last_buf = buf;
+
+		video->payload_size = 0;
+		req->zero = 1;
+	}
+
+	if (video->payload_size == video->max_payload_size ||
+	    video->queue.flags & UVC_QUEUE_DROP_INCOMPLETE)
+		video->payload_size = 0;
+}
+
 static void
 uvc_video_encode_isoc_sg(struct usb_request *req, struct uvc_video *video,
 		struct uvc_buffer *buf)
 {
 	unsigned int pending = buf->bytesused - video->queue.buf_used;
 	struct uvc_request *ureq = req->context;
-	struct scatterlist *sg, *iter;
+	struct scatterlist *sg;
 	unsigned int len = video->req_size;
-	unsigned int sg_left, part = 0;
 	unsigned int i;
 	int header_len;
 
@@ -222,24 +314,7 @@ uvc_video_encode_isoc_sg(struct usb_request *req, struct uvc_video *video,
 
 	/* Init the pending sgs with payload */
 	sg = sg_next(sg);
-
-	for_each_sg(sg, iter, ureq->sgt.nents - 1, i) {
-		if (!len || !buf->sg || !buf->sg->length)
-			break;
-
-		sg_left = buf->sg->length - buf->offset;
-		part = min_t(unsigned int, len, sg_left);
-
-		sg_set_page(iter, sg_page(buf->sg), part, buf->offset);
-
-		if (part == sg_left) {
-			buf->offset = 0;
-			buf->sg = sg_next(buf->sg);
-		} else {
-			buf->offset += part;
-		}
-		len -= part;
-	}
+	len = uvc_video_encode_sg_data(buf, sg, ureq->sgt.nents - 1, len, &i);
 
 	/* Assign the video data with header. */
 	req->buf = NULL;
@@ -596,7 +671,8 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 		return ret;
 
 	if (video->max_payload_size) {
-		video->encode = uvc_video_encode_bulk;
+		video->encode = video->queue.use_sg ?
+			uvc_video_encode_bulk_sg : uvc_video_encode_bulk;
 		video->payload_size = 0;
 	} else
 		video->encode = video->queue.use_sg ?
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2022 Rockchip Electronics Co., Ltd
+ *
+ * Direct video buffer management between isp and video encoder.
+ *
+ * The isp writes the output frame to a wrap-around line buffer instead of a
+ * full frame buffer, the encoder reads the lines from the same buffer on the
+ * fly. So the frame never round-trips through ddr.
+ *
+ * The isp port configures the wrap buffer by DVBM_ISP_SET_CFG and reports its
+ * progress by DVBM_ISP_FRM_START, the quarter/half/three quarters commands and
+ * DVBM_ISP_FRM_END with the frame sequence as argument. The line count of the
+ * current frame is updated on each command.
+ *
+ * The encoder port gets the progress from its callback:
+ *   DVBM_VEPU_NOTIFY_FRM_STR	new frame started, arg is struct dvbm_addr_cfg
+ *   DVBM_VEPU_NOTIFY_FRM_INFO	lines written, arg is struct dvbm_isp_frm_info
+ *   DVBM_VEPU_NOTIFY_FRM_END	frame finished, arg is struct dvbm_isp_frm_info
+ * and may read the same information any time by DVBM_VEPU_GET_ADR and
+ * DVBM_VEPU_GET_FRAME_INFO. The encoder must not read more lines than the
+ * line count, and must keep up within wrap_line lines, otherwise the frame
+ * is marked overflow and the encoder should resync by DVBM_VEPU_SET_RESYNC.
+ *
+ * Callbacks are called from the isp interrupt context with the dvbm lock
+ * held, so they must not call back into dvbm.
+ */
+
+#include <linux/module.h>
+#include <linux/of.h>
+#include <linux/of_platform.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <soc/rockchip/rockchip_dvbm.h>
+
+#define DVBM_DRIVER_NAME	"rk_dvbm"
+
+struct rk_dvbm_port {
+	struct dvbm_port port;
+	struct rk_dvbm_dev *dvbm;
+	struct dvbm_cb cb;
+};
+
+struct rk_dvbm_dev {
+	struct device *dev;
+	/* lock for the frame state and the callbacks */
+	spinlock_t lock;
+	struct rk_dvbm_port isp;
+	struct rk_dvbm_port vepu;
+
+	struct dvbm_isp_cfg_t isp_cfg;
+	struct dvbm_vepu_cfg vepu_cfg;
+	struct dvbm_addr_cfg addr;
+	struct dvbm_isp_frm_info frm_info;
+	/* isp is writing a frame */
+	u32 frm_active;
+	u32 frm_start_cnt;
+	u32 frm_end_cnt;
+	u32 overflow_cnt;
+};
+
+static struct rk_dvbm_port *to_rk_dvbm_port(struct dvbm_port *port)
+{
+	return container_of(port, struct rk_dvbm_port, port);
+}
+
+static void rk_dvbm_notify(struct rk_dvbm_dev *dvbm, enum dvbm_cb_event event,
+			   void *arg)
+{
+	struct dvbm_cb *cb = &dvbm->vepu.cb;
+
+	if (!dvbm->vepu.port.linked || !cb->cb)
+		return;
+
+	cb->cb(cb->ctx, event, arg);
+}
+
+static void rk_dvbm_set_isp_cfg(struct rk_dvbm_dev *dvbm,
+				struct dvbm_isp_cfg_t *cfg)
+{
+	struct dvbm_addr_cfg *addr = &dvbm->addr;
+	struct dvbm_isp_frm_info *info = &dvbm->frm_info;
+
+	dvbm->isp_cfg = *cfg;
+
+	/* buffer offsets in config are relative to the buffer address */
+	addr->ybuf_bot = cfg->dma_addr + cfg->ybuf_bot;
+	addr->ybuf_top = cfg->dma_addr + cfg->ybuf_top;
+	addr->ybuf_sadr = addr->ybuf_bot;
+	addr->cbuf_bot = cfg->dma_addr + cfg->cbuf_bot;
+	addr->cbuf_top = cfg->dma_addr + cfg->cbuf_top;
+	addr->cbuf_sadr = addr->cbuf_bot;
+	addr->line_cnt = 0;
+	addr->overflow = 0;
+
+	memset(info, 0, sizeof(*info));
+	if (cfg->ybuf_lstd) {
+		info->wrap_line = (cfg->ybuf_top - cfg->ybuf_bot) / cfg->ybuf_lstd;
+		info->max_line_cnt = cfg->ybuf_fstd / cfg->ybuf_lstd;
+	}
+	dvbm->frm_active = 0;
+
+	dev_info(dvbm->dev, "isp cfg y [%#x %#x] c [%#x %#x] wrap %d lines %d\n",
+		 addr->ybuf_bot, addr->ybuf_top, addr->cbuf_bot, addr->cbuf_top,
+		 info->wrap_line, info->max_line_cnt);
+}
+
+static void rk_dvbm_isp_frm_start(struct rk_dvbm_dev *dvbm, u32 seq)
+{
+	struct dvbm_addr_cfg *addr = &dvbm->addr;
+	struct dvbm_isp_frm_info *info = &dvbm->frm_info;
+
+	/* previous frame is not finished, encoder lost the lines */
+	if (dvbm->frm_active) {
+		addr->overflow = 1;
+		dvbm->overflow_cnt++;
+		dev_dbg(dvbm->dev, "frame %d start before frame %d end\n",
+			seq, info->frame_cnt);
+	}
+
+	dvbm->frm_active = 1;
+	dvbm->frm_start_cnt++;
+	info->frame_cnt = seq;
+	info->line_cnt = 0;
+	addr->frame_id = seq;
+	addr->line_cnt = 0;
+	/* each frame starts from the buffer bottom */
+	addr->ybuf_sadr = addr->ybuf_bot;
+	addr->cbuf_sadr = addr->cbuf_bot;
+
+	rk_dvbm_notify(dvbm, DVBM_VEPU_NOTIFY_FRM_STR, addr);
+}
+
+static void rk_dvbm_isp_frm_update(struct rk_dvbm_dev *dvbm, u32 seq, u32 quarter)
+{
+	struct dvbm_isp_frm_info *info = &dvbm->frm_info;
+
+	if (!dvbm->frm_active || info->frame_cnt != seq)
+		return;
+
+	info->line_cnt = info->max_line_cnt * quarter / 4;
+	dvbm->addr.line_cnt = info->line_cnt;
+
+	if (quarter < 4) {
+		rk_dvbm_notify(dvbm, DVBM_VEPU_NOTIFY_FRM_INFO, info);
+		return;
+	}
+
+	dvbm->frm_active = 0;
+	dvbm->frm_end_cnt++;
+	rk_dvbm_notify(dvbm, DVBM_VEPU_NOTIFY_FRM_END, info);
+}
+
+struct dvbm_port *rk_dvbm_get_port(struct platform_device *pdev,
+				   enum dvbm_port_dir dir)
+{
+	struct rk_dvbm_dev *dvbm;
+
+	if (!pdev)
+		return ERR_PTR(-ENODEV);
+
+	dvbm = platform_get_drvdata(pdev);
+	if (!dvbm)
+		return ERR_PTR(-EPROBE_DEFER);
+
+	get_device(dvbm->dev);
+
+	return dir == DVBM_ISP_PORT ? &dvbm->isp.port : &dvbm->vepu.port;
+}
+EXPORT_SYMBOL(rk_dvbm_get_port);
+
+int rk_dvbm_put(struct dvbm_port *port)
+{
+	if (IS_ERR_OR_NULL(port))
+		return -EINVAL;
+
+	put_device(to_rk_dvbm_port(port)->dvbm->dev);
+
+	return 0;
+}
+EXPORT_SYMBOL(rk_dvbm_put);
+
+int rk_dvbm_link(struct dvbm_port *port)
+{
+	struct rk_dvbm_dev *dvbm;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(port))
+		return -EINVAL;
+
+	dvbm = to_rk_dvbm_port(port)->dvbm;
+	spin_lock_irqsave(&dvbm->lock, flags);
+	port->linked = 1;
+	if (dvbm->isp.port.linked && dvbm->vepu.port.linked)
+		dev_info(dvbm->dev, "isp and vepu connected\n");
+	spin_unlock_irqrestore(&dvbm->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(rk_dvbm_link);
+
+int rk_dvbm_unlink(struct dvbm_port *port)
+{
+	struct rk_dvbm_dev *dvbm;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(port))
+		return -EINVAL;
+
+	dvbm = to_rk_dvbm_port(port)->dvbm;
+	spin_lock_irqsave(&dvbm->lock, flags);
+	port->linked = 0;
+	if (port->dir == DVBM_ISP_PORT)
+		dvbm->frm_active = 0;
+	spin_unlock_irqrestore(&dvbm->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(rk_dvbm_unlink);
+
+int rk_dvbm_set_cb(struct dvbm_port *port, struct dvbm_cb *cb)
+{
+	struct rk_dvbm_port *p;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(port) || !cb)
+		return -EINVAL;
+
+	p = to_rk_dvbm_port(port);
+	spin_lock_irqsave(&p->dvbm->lock, flags);
+	p->cb = *cb;
+	spin_unlock_irqrestore(&p->dvbm->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(rk_dvbm_set_cb);
+
+int rk_dvbm_ctrl(struct dvbm_port *port, enum dvbm_cmd cmd, void *arg)
+{
+	struct rk_dvbm_dev *dvbm;
+	unsigned long flags;
+	int ret = 0;
+
+	if (IS_ERR_OR_NULL(port))
+		return -EINVAL;
+
+	if ((port->dir == DVBM_ISP_PORT &&
+	     (cmd <= DVBM_ISP_CMD_BASE || cmd >= DVBM_ISP_CMD_BUTT)) ||
+	    (port->dir == DVBM_VEPU_PORT &&
+	     (cmd <= DVBM_VEPU_CMD_BASE || cmd >= DVBM_VEPU_CMD_BUTT)))
+		return -EINVAL;
+
+	if (!arg && cmd != DVBM_VEPU_SET_RESYNC && cmd != DVBM_VEPU_DUMP_REGS)
+		return -EINVAL;
+
+	dvbm = to_rk_dvbm_port(port)->dvbm;
+	spin_lock_irqsave(&dvbm->lock, flags);
+	switch (cmd) {
+	case DVBM_ISP_SET_CFG: {
+		rk_dvbm_set_isp_cfg(dvbm, arg);
+	} break;
+	case DVBM_ISP_FRM_START: {
+		rk_dvbm_isp_frm_start(dvbm, *(u32 *)arg);
+	} break;
+	case DVBM_ISP_FRM_QUARTER: {
+		rk_dvbm_isp_frm_update(dvbm, *(u32 *)arg, 1);
+	} break;
+	case DVBM_ISP_FRM_HALF: {
+		rk_dvbm_isp_frm_update(dvbm, *(u32 *)arg, 2);
+	} break;
+	case DVBM_ISP_FRM_THREE_QUARTERS: {
+		rk_dvbm_isp_frm_update(dvbm, *(u32 *)arg, 3);
+	} break;
+	case DVBM_ISP_FRM_END: {
+		rk_dvbm_isp_frm_update(dvbm, *(u32 *)arg, 4);
+	} break;
+	case DVBM_VEPU_SET_RESYNC: {
+		/* encoder restarts from the next isp frame */
+		dvbm->addr.overflow = 0;
+	} break;
+	case DVBM_VEPU_SET_CFG: {
+		dvbm->vepu_cfg = *(struct dvbm_vepu_cfg *)arg;
+	} break;
+	case DVBM_VEPU_GET_ADR: {
+		*(struct dvbm_addr_cfg *)arg = dvbm->addr;
+	} break;
+	case DVBM_VEPU_GET_FRAME_INFO: {
+		*(struct dvbm_isp_frm_info *)arg = dvbm->frm_info;
+	} break;
+	case DVBM_VEPU_DUMP_REGS: {
+		dev_info(dvbm->dev, "frame %d line %d/%d wrap %d active %d\n",
+			 dvbm->frm_info.frame_cnt, dvbm->frm_info.line_cnt,
+			 dvbm->frm_info.max_line_cnt, dvbm->frm_info.wrap_line,
+			 dvbm->frm_active);
+		dev_info(dvbm->dev, "start %d end %d overflow %d\n",
+			 dvbm->frm_start_cnt, dvbm->frm_end_cnt,
+			 dvbm->overflow_cnt);
+	} break;
+	default: {
+		ret = -EINVAL;
+	} break;
+	}
+	spin_unlock_irqrestore(&dvbm->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(rk_dvbm_ctrl);
+
+static int rk_dvbm_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct rk_dvbm_dev *dvbm;
+
+	dvbm = devm_kzalloc(dev, sizeof(*dvbm), GFP_KERNEL);
+	if (!dvbm)
+		return -ENOMEM;
+
+	dvbm->dev = dev;
+	spin_lock_init(&dvbm->lock);
+	dvbm->isp.dvbm = dvbm;
+	dvbm->isp.port.dir = DVBM_ISP_PORT;
+	dvbm->vepu.dvbm = dvbm;
+	dvbm->vepu.port.dir = DVBM_VEPU_PORT;
+	platform_set_drvdata(pdev, dvbm);
+
+	dev_info(dev, "probe success\n");
+
+	return 0;
+}
+
+static int rk_dvbm_remove(struct platform_device *pdev)
+{
+	platform_set_drvdata(pdev, NULL);
+
+	return 0;
+}
+
+static const struct of_device_id rk_dvbm_dt_match[] = {
+	{ .compatible = "rockchip,rk-dvbm" },
+	{},
+};
+MODULE_DEVICE_TABLE(of, rk_dvbm_dt_match);
+
+static struct platform_driver rk_dvbm_driver = {
+	.probe = rk_dvbm_probe,
+	.remove = rk_dvbm_remove,
+	.driver = {
+		.name = DVBM_DRIVER_NAME,
+		.of_match_table = of_match_ptr(rk_dvbm_dt_match),
+	},
+};
+
+module_platform_driver(rk_dvbm_driver);
+
+MODULE_LICENSE("Dual MIT/GPL");
+MODULE_DESCRIPTION("Rockchip direct video buffer management driver");
@@ -13,6 +13,7 @@
 
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/file.h>
 #include <linux/interrupt.h>
 #include <linux/iopoll.h>
 #include <linux/module.h>
@@ -27,15 +28,21 @@
 #include <linux/mfd/syscon.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/sync_file.h>
 #include <linux/uaccess.h>
 #include <linux/nospec.h>
+#include <linux/vmalloc.h>
 
 #include <soc/rockchip/pm_domains.h>
+#include <soc/rockchip/rockchip_media_trace.h>
 
 #include "mpp_debug.h"
 #include "mpp_common.h"
 #include "mpp_iommu.h"
 
+#define CREATE_TRACE_POINTS
+#include "mpp_trace.h"
+
 /* input parmater structure for version 1 */
 struct mpp_msg_v1 {
 	__u32 cmd;
@@ -100,18 +107,101 @@ mpp_taskqueue_pop_pending(struct mpp_taskqueue *queue,
 	return 0;
 }
 
-static struct mpp_task *
-mpp_taskqueue_get_pending_task(struct mpp_taskqueue *queue)
+static inline ktime_t mpp_task_deadline(struct mpp_task *task)
 {
-	struct mpp_task *task = NULL;
+	return task->deadline ? task->deadline : KTIME_MAX;
+}
+
+/* higher qos class first, then earliest deadline first */
+static bool mpp_task_qos_before(struct mpp_task *a, struct mpp_task *b)
+{
+	if (a->session->qos_class != b->session->qos_class)
+		return a->session->qos_class > b->session->qos_class;
+
+	return ktime_before(mpp_task_deadline(a), mpp_task_deadline(b));
+}
+
+/* tasks in one session must run in order, only the first one can be picked */
+static bool mpp_task_is_session_head(struct mpp_taskqueue *queue,
+				     struct mpp_task *task)
+{
+	struct mpp_task *loop;
+
+	list_for_each_entry(loop, &queue->pending_list, queue_link) {
+		if (loop == task)
+			return true;
+		if (loop->session == task->session)
+			return false;
+	}
+
+	return false;
+}
+
+/*
+ * Only the session head tasks whose in fence has signaled are candidates.
+ * A task blocked on its in fence holds back its own session only.
+ *
+ * On a taskqueue shared by several devices, every device switch costs a grf
+ * write and a reset of the shared block state. So up to grf_batch tasks of
+ * the last run device are served back to back, as long as the best task has
+ * the same qos class and its deadline leaves enough slack.
+ */
+struct mpp_task *mpp_taskqueue_get_pending_task(struct mpp_taskqueue *queue)
+{
+	struct mpp_task *task;
+	struct mpp_task *best = NULL;
+	struct mpp_task *affine = NULL;
+	u32 starve_ms = queue->srv ? queue->srv->qos_starve_ms : 0;
+	u32 batch = queue->srv ? queue->srv->grf_batch : 0;
+	bool starved = false;
 
 	mutex_lock(&queue->pending_lock);
-	task = list_first_entry_or_null(&queue->pending_list,
-					struct mpp_task,
-					queue_link);
+	/* the device asked for this task right after the last one, e.g. a split pair */
+	if (queue->next_task) {
+		list_for_each_entry(task, &queue->pending_list, queue_link) {
+			if (task == queue->next_task) {
+				best = task;
+				break;
+			}
+		}
+		queue->next_task = NULL;
+		if (best)
+			goto out;
+	}
+
+	list_for_each_entry(task, &queue->pending_list, queue_link) {
+		if (!mpp_task_is_session_head(queue, task) ||
+		    !mpp_task_fence_ready(task))
+			continue;
+
+		if (queue->last_mpp && task->session->mpp == queue->last_mpp &&
+		    (!affine || mpp_task_qos_before(task, affine)))
+			affine = task;
+
+		if (!best) {
+			best = task;
+			/* starvation protection, the oldest task is served first */
+			if (starve_ms && best->on_queue &&
+			    ktime_ms_delta(ktime_get(), best->on_queue) >= starve_ms) {
+				starved = true;
+				break;
+			}
+			continue;
+		}
+
+		if (mpp_task_qos_before(task, best))
+			best = task;
+	}
+
+	if (!starved && affine && affine != best && queue->batch_cnt < batch &&
+	    affine->session->qos_class == best->session->qos_class &&
+	    ktime_before(ktime_add_ms(ktime_get(), MPP_GRF_BATCH_SLACK_MS),
+			 mpp_task_deadline(best)))
+		best = affine;
+out:
 	mutex_unlock(&queue->pending_lock);
 
-	return task;
+	return best;
 }
 
 static bool
@@ -136,11 +226,67 @@ int mpp_taskqueue_pending_to_run(struct mpp_taskqueue *queue, struct mpp_task *t
 	list_move_tail(&task->queue_link, &queue->running_list);
 	spin_unlock_irqrestore(&queue->running_lock, flags);
 
+	if (queue->last_mpp != task->session->mpp) {
+		queue->last_mpp = task->session->mpp;
+		queue->batch_cnt = 0;
+		queue->switch_cnt++;
+	}
+	queue->batch_cnt++;
+	queue->run_cnt++;
 	mutex_unlock(&queue->pending_lock);
+	trace_mpp_task_run(task);
 
 	return 0;
 }
 
+/* the core load decays by 1/8 on each finished task */
+#define MPP_CORE_LOAD_SHIFT	(3)
+
+/*
+ * Select the idle core with the lowest recent load. The load is the decayed
+ * hardware time of the tasks finished on the core, so the core busy with
+ * large frames yields the next task to the others.
+ */
+s32 mpp_taskqueue_get_idle_core(struct mpp_taskqueue *queue,
+				unsigned long core_idle)
+{
+	s32 core_id = -1;
+	u32 load = U32_MAX;
+	u32 i;
+
+	for_each_set_bit(i, &core_idle, queue->core_id_max + 1) {
+		struct mpp_dev *mpp = queue->cores[i];
+
+		if (!mpp || mpp->disable)
+			continue;
+
+		if (core_id < 0 || READ_ONCE(mpp->core_load) < load) {
+			core_id = i;
+			load = READ_ONCE(mpp->core_load);
+		}
+	}
+
+	return core_id;
+}
+
+void mpp_core_load_account(struct mpp_dev *mpp, struct mpp_task *task)
+{
+	s64 elapse;
+	u32 load;
+
+	if (!task->hw_start)
+		return;
+
+	elapse = ktime_us_delta(ktime_get(), task->hw_start);
+	task->hw_start = 0;
+	if (elapse < 0)
+		return;
+
+	load = READ_ONCE(mpp->core_load);
+	load = load - (load >> MPP_CORE_LOAD_SHIFT) + (u32)min_t(s64, elapse, U16_MAX);
+	WRITE_ONCE(mpp->core_load, load);
+}
+
 static struct mpp_task *
 mpp_taskqueue_get_running_task(struct mpp_taskqueue *queue)
 {
@@ -179,9 +325,128 @@ mpp_taskqueue_trigger_work(struct mpp_dev *mpp)
 	kthread_queue_work(&mpp->queue->worker, &mpp->work);
 }
 
+/*
+ * The out fence may outlive the session when user space still holds the
+ * sync file, so every fence carries its own lock.
+ */
+struct mpp_fence {
+	struct dma_fence base;
+	spinlock_t lock;
+};
+
+static const char *mpp_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "mpp";
+}
+
+static const char *mpp_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "mpp_session";
+}
+
+static const struct dma_fence_ops mpp_fence_ops = {
+	.get_driver_name = mpp_fence_get_driver_name,
+	.get_timeline_name = mpp_fence_get_timeline_name,
+};
+
+static struct dma_fence *mpp_fence_create(struct mpp_session *session, u32 seqno)
+{
+	struct mpp_fence *fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+
+	if (!fence)
+		return NULL;
+
+	spin_lock_init(&fence->lock);
+	dma_fence_init(&fence->base, &mpp_fence_ops, &fence->lock,
+		       session->fence_context, seqno);
+
+	return &fence->base;
+}
+
+int mpp_task_attach_fence(struct mpp_task *task, struct mpp_task_msgs *msgs)
+{
+	struct mpp_session *session = task->session;
+	struct sync_file *sync_file;
+	struct dma_fence *fence;
+	int fd;
+
+	/* hand the in fence reference over to the task */
+	task->in_fence = msgs->in_fence;
+	msgs->in_fence = NULL;
+
+	if (!msgs->out_fence_req)
+		return 0;
+
+	fence = mpp_fence_create(session, task->seq + 1);
+	if (!fence)
+		return -ENOMEM;
+
+	sync_file = sync_file_create(fence);
+	if (!sync_file)
+		goto err_put_fence;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0)
+		goto err_put_file;
+
+	if (put_user(fd, (s32 __user *)msgs->out_fence_req->data)) {
+		put_unused_fd(fd);
+		goto err_put_file;
+	}
+
+	fd_install(fd, sync_file->file);
+	/* the sync file holds its own reference, keep ours for signalling */
+	task->out_fence = fence;
+	msgs->out_fence_req = NULL;
+
+	mpp_debug(DEBUG_TASK_INFO, "session %d task %d out fence fd %d seqno %llu\n",
+		  session->index, task->task_id, fd, fence->seqno);
+
+	return 0;
+
+err_put_file:
+	fput(sync_file->file);
+err_put_fence:
+	dma_fence_put(fence);
+	mpp_err("session %d task %d failed to create out fence\n",
+		session->index, task->task_id);
+
+	return -EINVAL;
+}
+
+static void mpp_task_in_fence_cb(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+	struct mpp_task *task = container_of(cb, struct mpp_task, in_fence_cb);
+
+	/* may run in irq context, just kick the worker to reschedule */
+	mpp_taskqueue_trigger_work(mpp_get_task_used_device(task, task->session));
+}
+
+/* called from the worker, returns true when the task may be run now */
+bool mpp_task_fence_ready(struct mpp_task *task)
+{
+	int ret;
+
+	if (!task->in_fence || dma_fence_is_signaled(task->in_fence))
+		return true;
+
+	if (task->in_fence_armed)
+		return false;
+
+	ret = dma_fence_add_callback(task->in_fence, &task->in_fence_cb,
+				     mpp_task_in_fence_cb);
+	if (ret == -ENOENT)
+		return true;
+
+	/* fall back to run directly if the callback can not be armed */
+	task->in_fence_armed = !ret;
+
+	return !!ret;
+}
+
 int mpp_power_on(struct mpp_dev *mpp)
 {
-	pm_runtime_get_sync(mpp->dev);
+	rockchip_rpm_tune_get_sync(&mpp->rpm_tune);
 	pm_stay_awake(mpp->dev);
 
 	if (mpp->hw_ops->clk_on)
@@ -196,13 +461,9 @@ int mpp_power_off(struct mpp_dev *mpp)
 		mpp->hw_ops->clk_off(mpp);
 
 	pm_relax(mpp->dev);
-	if (mpp_taskqueue_get_pending_task(mpp->queue) ||
-	    mpp_taskqueue_get_running_task(mpp->queue)) {
-		pm_runtime_mark_last_busy(mpp->dev);
-		pm_runtime_put_autosuspend(mpp->dev);
-	} else {
-		pm_runtime_put_sync_suspend(mpp->dev);
-	}
+	rockchip_rpm_tune_put(&mpp->rpm_tune,
+			      !list_empty(&mpp->queue->pending_list) ||
+			      mpp_taskqueue_get_running_task(mpp->queue));
 
 	return 0;
 }
@@ -211,10 +472,17 @@ static void task_msgs_reset(struct mpp_task_msgs *msgs)
 {
 	list_del_init(&msgs->list);
 
+	msgs->queue = NULL;
+	msgs->task = NULL;
+	msgs->mpp = NULL;
 	msgs->flags = 0;
 	msgs->req_cnt = 0;
 	msgs->set_cnt = 0;
 	msgs->poll_cnt = 0;
+
+	dma_fence_put(msgs->in_fence);
+	msgs->in_fence = NULL;
+	msgs->out_fence_req = NULL;
 }
 
 static void task_msgs_init(struct mpp_task_msgs *msgs, struct mpp_session *session)
@@ -222,10 +490,6 @@ static void task_msgs_init(struct mpp_task_msgs *msgs, struct mpp_session *sessi
 	INIT_LIST_HEAD(&msgs->list);
 
 	msgs->session = session;
-	msgs->queue = NULL;
-	msgs->task = NULL;
-	msgs->mpp = NULL;
-
 	msgs->ext_fd = -1;
 
 	task_msgs_reset(msgs);
@@ -385,6 +649,12 @@ static struct mpp_session *mpp_session_init(void)
 	INIT_LIST_HEAD(&session->list_msgs_idle);
 	spin_lock_init(&session->lock_msgs);
 
+	session->qos_class = MPP_QOS_CLASS_NORMAL;
+	atomic_set(&session->task_seq, 0);
+	spin_lock_init(&session->done_lock);
+	init_waitqueue_head(&session->done_wait);
+	session->fence_context = dma_fence_context_alloc(1);
+
 	mpp_dbg_session("session %p init\n", session);
 	return session;
 }
@@ -430,6 +700,7 @@ void mpp_session_deinit(struct mpp_session *session)
 
 	clear_task_msgs(session);
 
+	vfree(session->done_ring);
 	kfree(session);
 }
 
@@ -603,8 +874,14 @@ static int mpp_process_task_default(struct mpp_session *session,
 	atomic_set(&task->abort_request, 0);
 	task->task_index = atomic_fetch_inc(&mpp->task_index);
 	task->task_id = atomic_fetch_inc(&mpp->queue->task_id);
+	task->seq = atomic_fetch_inc(&session->task_seq);
 	INIT_DELAYED_WORK(&task->timeout_work, mpp_task_timeout_work);
 
+	if (mpp_task_attach_fence(task, msgs)) {
+		mpp->dev_ops->free_task(session, task);
+		return -EINVAL;
+	}
+
 	if (mpp->auto_freq_en && mpp->hw_ops->get_freq)
 		mpp->hw_ops->get_freq(mpp, task);
 
@@ -728,12 +1005,33 @@ int mpp_dev_reset(struct mpp_dev *mpp)
 	return 0;
 }
 
+/* emit the pipeline buffer trace for every dma-buf the task uses */
+static void mpp_task_media_trace(struct mpp_task *task, enum rk_media_stage stage)
+{
+	struct mpp_dev *mpp = task->mpp ? task->mpp : task->session->mpp;
+	struct mpp_mem_region *mem_region;
+
+	if (!rk_media_trace_enabled() || !mpp)
+		return;
+
+	list_for_each_entry(mem_region, &task->mem_region_list, reg_link) {
+		struct mpp_dma_buffer *buffer = mem_region->hdl;
+
+		if (mem_region->is_dup || !buffer)
+			continue;
+		rk_media_buf_trace(mpp->dev, buffer->dmabuf, stage);
+	}
+}
+
 void mpp_task_run_begin(struct mpp_task *task, u32 timing_en, u32 timeout)
 {
 	preempt_disable();
 
 	set_bit(TASK_STATE_START, &task->state);
 
+	task->hw_start = ktime_get();
+	trace_mpp_task_hw_start(task);
+	mpp_task_media_trace(task, RK_MEDIA_START);
 	mpp_time_record(task);
 	schedule_delayed_work(&task->timeout_work, msecs_to_jiffies(timeout));
 
@@ -924,6 +1222,7 @@ static int mpp_wait_result_default(struct mpp_session *session,
 	ret = wait_event_interruptible(task->wait, test_bit(TASK_STATE_DONE, &task->state));
 	if (ret == -ERESTARTSYS)
 		mpp_err("wait task break by signal\n");
+	trace_mpp_task_wake(task);
 
 	if (mpp->dev_ops->result)
 		ret = mpp->dev_ops->result(mpp, task, msgs);
@@ -1039,6 +1338,7 @@ struct mpp_taskqueue *mpp_taskqueue_init(struct device *dev)
 	atomic_set(&queue->detach_count, 0);
 	atomic_set(&queue->task_id, 0);
 	queue->dev_active_flags = 0;
+	queue->stat_start = ktime_get();
 
 	return queue;
 }
@@ -1291,6 +1591,36 @@ static int mpp_process_request(struct mpp_session *session,
 				req->size / sizeof(session->trans_table[0]);
 		}
 	} break;
+	case MPP_CMD_INIT_DONE_RING: {
+		struct mpp_done_ring *ring;
+		u32 count;
+		size_t size;
+
+		if (get_user(count, (u32 __user *)req->data))
+			return -EFAULT;
+
+		if (!count || count > MPP_DONE_RING_MAX_COUNT)
+			return -EINVAL;
+
+		if (session->done_ring)
+			return -EBUSY;
+
+		count = roundup_pow_of_two(count);
+		size = PAGE_ALIGN(struct_size(ring, entries, count));
+		ring = vmalloc_user(size);
+		if (!ring)
+			return -ENOMEM;
+
+		ring->count = count;
+		session->done_ring_size = size;
+		/* publish ring to the task finish path */
+		smp_store_release(&session->done_ring, ring);
+
+		mpp_debug(DEBUG_IOCTL, "session %d done ring count %d size %zu\n",
+			  session->index, count, size);
+		if (put_user(count, (u32 __user *)req->data))
+			return -EFAULT;
+	} break;
 	case MPP_CMD_SET_REG_WRITE:
 	case MPP_CMD_SET_REG_READ:
 	case MPP_CMD_SET_REG_ADDR_OFFSET:
@@ -1298,6 +1628,28 @@ static int mpp_process_request(struct mpp_session *session,
 		msgs->flags |= req->flags;
 		msgs->set_cnt++;
 	} break;
+	case MPP_CMD_SET_IN_FENCE: {
+		struct dma_fence *fence;
+		s32 fd;
+
+		if (get_user(fd, (s32 __user *)req->data))
+			return -EFAULT;
+
+		fence = sync_file_get_fence(fd);
+		if (!fence) {
+			mpp_err("invalid in fence fd %d\n", fd);
+			return -EINVAL;
+		}
+
+		dma_fence_put(msgs->in_fence);
+		msgs->in_fence = fence;
+	} break;
+	case MPP_CMD_SET_OUT_FENCE: {
+		if (!req->data || req->size < sizeof(s32))
+			return -EINVAL;
+
+		msgs->out_fence_req = req;
+	} break;
 	case MPP_CMD_POLL_HW_FINISH: {
 		msgs->flags |= req->flags;
 		msgs->poll_cnt++;
@@ -1317,6 +1669,27 @@ static int mpp_process_request(struct mpp_session *session,
 			msgs->poll_req = NULL;
 		}
 	} break;
+	case MPP_CMD_SET_SESSION_QOS: {
+		struct mpp_session_qos qos;
+
+		if (req->size < sizeof(qos))
+			return -EINVAL;
+
+		if (copy_from_user(&qos, req->data, sizeof(qos))) {
+			mpp_err("copy_from_user failed\n");
+			return -EFAULT;
+		}
+
+		if (qos.qos_class >= MPP_QOS_CLASS_BUTT) {
+			mpp_err("qos class must less than %d\n", MPP_QOS_CLASS_BUTT);
+			return -EINVAL;
+		}
+
+		session->qos_class = qos.qos_class;
+		session->deadline_us = qos.deadline_us;
+		mpp_debug(DEBUG_IOCTL, "session %d qos class %d deadline %d us\n",
+			  session->index, qos.qos_class, qos.deadline_us);
+	} break;
 	case MPP_CMD_RESET_SESSION: {
 		int ret;
 		int val;
@@ -1473,6 +1846,48 @@ static int mpp_collect_msgs(struct list_head *head, struct mpp_session *session,
 	else
 		last = 1;
 
+	/*
+	 * check cmd for task split in current session, the messages before
+	 * split become one task and the following messages start a new task.
+	 * All the tasks will be pushed to taskqueue in one batch.
+	 */
+	if (msg_v1.cmd == MPP_CMD_SET_TASK_SPLIT) {
+		struct mpp_task_msgs *next;
+
+		/* split as the last message just ends current task */
+		if (last) {
+			if (msgs) {
+				if (msgs->req_cnt)
+					task_msgs_add(msgs, head);
+				else
+					put_task_msgs(msgs);
+			}
+
+			return 0;
+		}
+
+		if (msgs && msgs->req_cnt) {
+			next = get_task_msgs(session);
+			if (!next) {
+				pr_err("session %d:%d failed to get task msgs",
+				       session->pid, session->index);
+				return -EINVAL;
+			}
+
+			/* keep session fd reference until the last task in batch done */
+			if (msgs->ext_fd >= 0) {
+				next->ext_fd = msgs->ext_fd;
+				next->f = msgs->f;
+				msgs->ext_fd = -1;
+			}
+
+			task_msgs_add(msgs, head);
+			msgs = next;
+		}
+
+		goto next;
+	}
+
 	/* check cmd for change msgs session */
 	if (msg_v1.cmd == MPP_CMD_SET_SESSION_FD) {
 		struct mpp_bat_msg bat_msg;
@@ -1570,46 +1985,46 @@ static int mpp_collect_msgs(struct list_head *head, struct mpp_session *session,
 
 static void mpp_msgs_trigger(struct list_head *msgs_list)
 {
-	struct mpp_task_msgs *msgs, *n;
-	struct mpp_dev *mpp_prev = NULL;
-	struct mpp_taskqueue *queue_prev = NULL;
+	struct mpp_task_msgs *msgs, *loop;
+	ktime_t now = ktime_get();
 
-	/* push task to queue */
-	list_for_each_entry_safe(msgs, n, msgs_list, list) {
-		struct mpp_dev *mpp;
-		struct mpp_task *task;
-		struct mpp_taskqueue *queue;
+	/*
+	 * push task to queue, all tasks to the same taskqueue are pushed with
+	 * one pending lock round-trip and the queue worker is woken only once.
+	 */
+	list_for_each_entry(msgs, msgs_list, list) {
+		struct mpp_taskqueue *queue = msgs->queue;
 
-		if (!msgs->set_cnt || !msgs->queue)
+		if (!msgs->set_cnt || !queue)
 			continue;
 
-		mpp = msgs->mpp;
-		task = msgs->task;
-		queue = msgs->queue;
+		/* task has been pushed with the previous batch */
+		if (test_bit(TASK_STATE_PENDING, &msgs->task->state))
+			continue;
 
-		if (queue_prev != queue) {
-			if (queue_prev && mpp_prev) {
-				mutex_unlock(&queue_prev->pending_lock);
-				mpp_taskqueue_trigger_work(mpp_prev);
-			}
+		mutex_lock(&queue->pending_lock);
+		loop = msgs;
+		list_for_each_entry_from(loop, msgs_list, list) {
+			struct mpp_task *task = loop->task;
 
-			if (queue)
-				mutex_lock(&queue->pending_lock);
+			if (!loop->set_cnt || loop->queue != queue)
+				continue;
 
-			mpp_prev = mpp;
-			queue_prev = queue;
-		}
+			if (test_bit(TASK_STATE_ABORT, &task->state))
+				pr_info("try to trigger abort task %d\n", task->task_id);
 
-		if (test_bit(TASK_STATE_ABORT, &task->state))
-			pr_info("try to trigger abort task %d\n", task->task_id);
+			task->on_queue = now;
+			if (loop->session->deadline_us)
+				task->deadline = ktime_add_us(now, loop->session->deadline_us);
 
-		set_bit(TASK_STATE_PENDING, &task->state);
-		list_add_tail(&task->queue_link, &queue->pending_list);
-	}
+			set_bit(TASK_STATE_PENDING, &task->state);
+			list_add_tail(&task->queue_link, &queue->pending_list);
+			trace_mpp_task_submit(task);
+			mpp_task_media_trace(task, RK_MEDIA_QUEUE);
+		}
+		mutex_unlock(&queue->pending_lock);
 
-	if (mpp_prev && queue_prev) {
-		mutex_unlock(&queue_prev->pending_lock);
-		mpp_taskqueue_trigger_work(mpp_prev);
+		mpp_taskqueue_trigger_work(msgs->mpp);
 	}
 }
 
@@ -1729,9 +2144,50 @@ static int mpp_dev_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+static __poll_t mpp_dev_poll(struct file *filp, poll_table *wait)
+{
+	struct mpp_session *session = filp->private_data;
+	struct mpp_done_ring *ring;
+	__poll_t mask = 0;
+
+	if (!session)
+		return EPOLLERR;
+
+	poll_wait(filp, &session->done_wait, wait);
+
+	ring = smp_load_acquire(&session->done_ring);
+	if (ring && smp_load_acquire(&ring->head) != READ_ONCE(ring->tail))
+		mask |= EPOLLIN | EPOLLRDNORM;
+
+	return mask;
+}
+
+static int mpp_dev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct mpp_session *session = filp->private_data;
+	struct mpp_done_ring *ring;
+
+	if (!session)
+		return -EINVAL;
+
+	ring = smp_load_acquire(&session->done_ring);
+	if (!ring) {
+		mpp_err("session %d done ring is not initialized\n", session->index);
+		return -ENODEV;
+	}
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start > session->done_ring_size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring, 0);
+}
+
 const struct file_operations rockchip_mpp_fops = {
 	.open		= mpp_dev_open,
 	.release	= mpp_dev_release,
+	.poll		= mpp_dev_poll,
+	.mmap		= mpp_dev_mmap,
 	.unlocked_ioctl = mpp_dev_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl   = mpp_dev_ioctl,
@@ -1952,6 +2408,23 @@ int mpp_task_init(struct mpp_session *session, struct mpp_task *task)
 	return 0;
 }
 
+static void mpp_qos_hist_record(struct mpp_dev *mpp, struct mpp_task *task)
+{
+	u32 qos_class = task->session->qos_class;
+	s64 lat_ms;
+	u32 bin;
+
+	if (!task->on_queue || qos_class >= MPP_QOS_CLASS_BUTT)
+		return;
+
+	lat_ms = ktime_ms_delta(ktime_get(), task->on_queue);
+	bin = lat_ms > 0 ? fls64(lat_ms) : 0;
+	if (bin >= MPP_QOS_HIST_BINS)
+		bin = MPP_QOS_HIST_BINS - 1;
+
+	mpp->qos_hist[qos_class][bin]++;
+}
+
 int mpp_task_finish(struct mpp_session *session,
 		    struct mpp_task *task)
 {
@@ -1960,6 +2433,8 @@ int mpp_task_finish(struct mpp_session *session,
 	if (mpp->dev_ops->finish)
 		mpp->dev_ops->finish(mpp, task);
 
+	mpp_core_load_account(mpp, task);
+	mpp_qos_hist_record(mpp, task);
 	mpp_reset_up_read(mpp->reset_group);
 	if (atomic_read(&mpp->reset_request) > 0)
 		mpp_dev_reset(mpp);
@@ -1967,6 +2442,7 @@ int mpp_task_finish(struct mpp_session *session,
 
 	set_bit(TASK_STATE_FINISH, &task->state);
 	set_bit(TASK_STATE_DONE, &task->state);
+	mpp_session_post_done(session, task);
 
 	if (session->srv->timing_en) {
 		s64 time_diff;
@@ -1987,12 +2463,134 @@ int mpp_task_finish(struct mpp_session *session,
 	return 0;
 }
 
+static void mpp_session_post_entry(struct mpp_session *session,
+				   struct mpp_done_entry *done)
+{
+	struct mpp_done_ring *ring = smp_load_acquire(&session->done_ring);
+	unsigned long flags;
+	u32 head, tail;
+
+	if (!ring)
+		return;
+
+	/* multi-core may finish the tasks of one session in parallel */
+	spin_lock_irqsave(&session->done_lock, flags);
+	head = ring->head;
+	tail = READ_ONCE(ring->tail);
+	if (head - tail >= ring->count) {
+		ring->drop++;
+		spin_unlock_irqrestore(&session->done_lock, flags);
+		mpp_debug(DEBUG_TASK_INFO, "session %d done ring full, drop task %d\n",
+			  session->index, done->task_id);
+		goto done;
+	}
+
+	ring->entries[head & (ring->count - 1)] = *done;
+	/* make entry visible before head update */
+	smp_store_release(&ring->head, head + 1);
+	spin_unlock_irqrestore(&session->done_lock, flags);
+
+done:
+	wake_up_interruptible(&session->done_wait);
+}
+
+void mpp_session_post_done(struct mpp_session *session,
+			   struct mpp_task *task)
+{
+	struct mpp_done_entry done = {
+		.seq = task->seq,
+		.task_id = task->task_id,
+		.hw_cycles = task->hw_cycles,
+		.irq_status = task->irq_status,
+	};
+
+	/* all the task done paths come here, trace it first */
+	trace_mpp_task_finish(task);
+	mpp_task_media_trace(task, RK_MEDIA_DONE);
+
+	if (task->out_fence) {
+		if (test_bit(TASK_STATE_TIMEOUT, &task->state))
+			dma_fence_set_error(task->out_fence, -ETIMEDOUT);
+		dma_fence_signal(task->out_fence);
+		dma_fence_put(task->out_fence);
+		task->out_fence = NULL;
+	}
+
+	mpp_session_post_entry(session, &done);
+}
+
+void mpp_session_post_slice(struct mpp_session *session, struct mpp_task *task,
+			    u32 slice_idx, u32 length, bool last)
+{
+	struct mpp_done_entry done = {
+		.seq = task->seq,
+		.task_id = task->task_id,
+		.flags = MPP_DONE_FLAG_SLICE,
+		.slice_idx = slice_idx,
+		.length = length,
+	};
+
+	if (last)
+		done.flags |= MPP_DONE_FLAG_LAST_SLICE;
+
+	mpp_session_post_entry(session, &done);
+}
+
+/*
+ * Claim on-chip sram for the rcb buffers of one task from the sram pool
+ * shared with the other ips. The device has [start, start + size) mapped
+ * at its rcb iova. The buffers are placed in order, and when the pool is
+ * short the tail ones are left in their ddr buffers one by one, so a small
+ * stream only takes what it needs and a large one gets all that is free.
+ * Returns the number of leading buffers placed in grant.
+ */
+u32 mpp_rcb_sram_claim(struct gen_pool *pool, phys_addr_t start, u32 size,
+		       const struct rcb_info_elem *elem, u32 cnt,
+		       struct mpp_rcb_grant *grant)
+{
+	struct genpool_data_align align = { .align = PAGE_SIZE };
+	unsigned long addr;
+	u32 n, need = 0;
+
+	mpp_rcb_sram_release(grant);
+
+	for (n = 0; n < cnt && need + elem[n].size <= size; n++)
+		need += elem[n].size;
+
+	while (n && need) {
+		addr = gen_pool_alloc_algo(pool, need, gen_pool_first_fit_align, &align);
+		if (addr) {
+			if (addr >= start && addr + need <= start + size) {
+				grant->pool = pool;
+				grant->addr = addr;
+				grant->size = need;
+				return n;
+			}
+			gen_pool_free(pool, addr, need);
+		}
+		need -= elem[--n].size;
+	}
+
+	return 0;
+}
+
+void mpp_rcb_sram_release(struct mpp_rcb_grant *grant)
+{
+	if (!grant->size)
+		return;
+
+	gen_pool_free(grant->pool, grant->addr, grant->size);
+	grant->size = 0;
+}
+
 int mpp_task_finalize(struct mpp_session *session,
 		      struct mpp_task *task)
 {
 	struct mpp_mem_region *mem_region = NULL, *n;
 	struct mpp_dev *mpp = mpp_get_task_used_device(task, session);
 
+	mpp_rcb_sram_release(&task->rcb_grant);
+
 	/* release memory region attach to this registers table. */
 	list_for_each_entry_safe(mem_region, n,
 				 &task->mem_region_list,
@@ -2005,6 +2603,21 @@ int mpp_task_finalize(struct mpp_session *session,
 		list_del_init(&mem_region->reg_link);
 	}
 
+	/* task never reached hardware, do not leave the waiter hanging */
+	if (task->out_fence) {
+		dma_fence_set_error(task->out_fence, -ECANCELED);
+		dma_fence_signal(task->out_fence);
+		dma_fence_put(task->out_fence);
+		task->out_fence = NULL;
+	}
+
+	if (task->in_fence) {
+		if (task->in_fence_armed)
+			dma_fence_remove_callback(task->in_fence, &task->in_fence_cb);
+		dma_fence_put(task->in_fence);
+		task->in_fence = NULL;
+	}
+
 	return 0;
 }
 
@@ -2128,6 +2741,7 @@ int mpp_dev_probe(struct mpp_dev *mpp,
 	/* power domain autosuspend delay 2s */
 	pm_runtime_set_autosuspend_delay(dev, 2000);
 	pm_runtime_use_autosuspend(dev);
+	rockchip_rpm_tune_init(&mpp->rpm_tune, dev);
 
 	kthread_init_work(&mpp->work, mpp_task_worker_default);
 
@@ -2256,6 +2870,8 @@ irqreturn_t mpp_dev_irq(int irq, void *param)
 		task->on_irq = ktime_get();
 		set_bit(TASK_TIMING_IRQ, &task->state);
 	}
+	if (task)
+		trace_mpp_task_irq(task);
 
 	if (mpp->dev_ops->irq)
 		irq_ret = mpp->dev_ops->irq(mpp);
@@ -2596,9 +3212,48 @@ mpp_procfs_create_u32(const char *name, umode_t mode,
 	return proc_create_data(name, mode, parent, &procfs_fops_u32, data);
 }
 
+static int mpp_show_qos_latency(struct seq_file *seq, void *offset)
+{
+	static const char * const class_name[MPP_QOS_CLASS_BUTT] = {
+		[MPP_QOS_CLASS_BACKGROUND]	= "background",
+		[MPP_QOS_CLASS_NORMAL]		= "normal",
+		[MPP_QOS_CLASS_REALTIME]	= "realtime",
+	};
+	struct mpp_dev *mpp = seq->private;
+	u32 i, j;
+
+	seq_printf(seq, "%-10s", "class");
+	for (j = 0; j < MPP_QOS_HIST_BINS - 1; j++)
+		seq_printf(seq, " %7s%-3u", "<", 1U << j);
+	seq_printf(seq, " %7s%-3u\n", ">=", 1U << (MPP_QOS_HIST_BINS - 2));
+
+	for (i = 0; i < MPP_QOS_CLASS_BUTT; i++) {
+		seq_printf(seq, "%-10s", class_name[i]);
+		for (j = 0; j < MPP_QOS_HIST_BINS; j++)
+			seq_printf(seq, " %10u", mpp->qos_hist[i][j]);
+		seq_puts(seq, "\n");
+	}
+
+	return 0;
+}
+
+static int mpp_show_rpm_tune(struct seq_file *seq, void *offset)
+{
+	struct mpp_dev *mpp = seq->private;
+
+	rockchip_rpm_tune_show(seq, &mpp->rpm_tune);
+
+	return 0;
+}
+
 void mpp_procfs_create_common(struct proc_dir_entry *parent, struct mpp_dev *mpp)
 {
 	mpp_procfs_create_u32("disable_work", 0644, parent, &mpp->disable);
 	mpp_procfs_create_u32("timing_check", 0644, parent, &mpp->timing_check);
+	mpp_procfs_create_u32("core_load", 0444, parent, &mpp->core_load);
+	proc_create_single_data("qos_latency", 0444, parent,
+				mpp_show_qos_latency, mpp);
+	proc_create_single_data("rpm_tune", 0444, parent,
+				mpp_show_rpm_tune, mpp);
 }
 #endif
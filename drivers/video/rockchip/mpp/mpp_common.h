@@ -14,6 +14,8 @@
 #include <linux/cdev.h>
 #include <linux/clk.h>
 #include <linux/dma-buf.h>
+#include <linux/dma-fence.h>
+#include <linux/genalloc.h>
 #include <linux/kfifo.h>
 #include <linux/types.h>
 #include <linux/time.h>
@@ -24,6 +26,7 @@
 #include <linux/poll.h>
 #include <linux/platform_device.h>
 #include <soc/rockchip/pm_domains.h>
+#include <soc/rockchip/rockchip_rpm_tune.h>
 #include <uapi/linux/rk-mpp.h>
 
 #define MHZ				(1000 * 1000)
@@ -39,6 +42,15 @@
 /* max 4 cores supported */
 #define MPP_MAX_CORE_NUM		(4)
 
+/* pending task waiting longer than this is served first */
+#define MPP_QOS_STARVE_MS		(200)
+/* max tasks run back to back on one device of a shared taskqueue */
+#define MPP_GRF_BATCH			(4)
+/* a task is only held back for batching if its deadline is further away */
+#define MPP_GRF_BATCH_SLACK_MS		(5)
+/* latency histogram bins: [0, 1) [1, 2) ... [64, inf) ms */
+#define MPP_QOS_HIST_BINS		(8)
+
 /**
  * Device type: classified by hardware feature
  */
@@ -174,6 +186,10 @@ struct mpp_task_msgs {
 
 	struct mpp_request reqs[MPP_MAX_MSG_NUM];
 	struct mpp_request *poll_req;
+
+	/* fence requested for the task */
+	struct dma_fence *in_fence;
+	struct mpp_request *out_fence_req;
 };
 
 struct mpp_grf_info {
@@ -318,10 +334,16 @@ struct mpp_dev {
 	/* multi-core data */
 	struct list_head queue_link;
 	s32 core_id;
+	/* decayed sum of task hardware time in us for core load balance */
+	u32 core_load;
+	/* measured power costs for the autosuspend delay */
+	struct rockchip_rpm_tune rpm_tune;
 
 	/* common per-device procfs */
 	u32 disable;
 	u32 timing_check;
+	/* submit to finish latency histogram of each qos class */
+	u32 qos_hist[MPP_QOS_CLASS_BUTT][MPP_QOS_HIST_BINS];
 };
 
 struct mpp_session {
@@ -368,6 +390,22 @@ struct mpp_session {
 	struct list_head list_msgs;
 	struct list_head list_msgs_idle;
 	spinlock_t lock_msgs;
+
+	/* qos set by user */
+	u32 qos_class;
+	u32 deadline_us;
+
+	/* task submit sequence in session */
+	atomic_t task_seq;
+	/* optional completion ring mapped to userspace */
+	struct mpp_done_ring *done_ring;
+	size_t done_ring_size;
+	/* lock for done ring producer */
+	spinlock_t done_lock;
+	wait_queue_head_t done_wait;
+
+	/* out fence timeline of the session */
+	u64 fence_context;
 };
 
 /* task state in work thread */
@@ -399,6 +437,18 @@ enum mpp_task_state {
 };
 
 /* The context for the a task */
+struct rcb_info_elem {
+	u32 index;
+	u32 size;
+};
+
+/* on-chip sram claimed from the shared sram pool for the rcb of one task */
+struct mpp_rcb_grant {
+	struct gen_pool *pool;
+	unsigned long addr;
+	u32 size;
+};
+
 struct mpp_task {
 	/* context belong to */
 	struct mpp_session *session;
@@ -424,6 +474,11 @@ struct mpp_task {
 	/* record context running start time */
 	ktime_t start;
 	ktime_t part;
+	/* hardware start time for core load accounting */
+	ktime_t hw_start;
+	/* push to taskqueue time and deadline for qos */
+	ktime_t on_queue;
+	ktime_t deadline;
 
 	/* debug timing */
 	ktime_t on_create;
@@ -440,6 +495,8 @@ struct mpp_task {
 	struct mpp_hw_info *hw_info;
 	u32 task_index;
 	u32 task_id;
+	/* submit sequence in session */
+	u32 seq;
 	u32 *reg;
 	u32 irq_status;
 	/* event for session wait thread */
@@ -450,6 +507,15 @@ struct mpp_task {
 	s32 core_id;
 	/* hw cycles */
 	u32 hw_cycles;
+
+	/* task waits in_fence before run and signals out_fence when done */
+	struct dma_fence *in_fence;
+	struct dma_fence_cb in_fence_cb;
+	bool in_fence_armed;
+	struct dma_fence *out_fence;
+
+	/* rcb sram held while the task runs */
+	struct mpp_rcb_grant rcb_grant;
 };
 
 struct mpp_taskqueue {
@@ -495,6 +561,16 @@ struct mpp_taskqueue {
 	u32 core_id_max;
 	u32 core_count;
 	unsigned long dev_active_flags;
+
+	/* task chained by the device to run next, protected by pending_lock */
+	struct mpp_task *next_task;
+
+	/* device batching, protected by pending_lock */
+	struct mpp_dev *last_mpp;
+	u32 batch_cnt;
+	u64 run_cnt;
+	u64 switch_cnt;
+	ktime_t stat_start;
 };
 
 struct mpp_reset_group {
@@ -534,6 +610,10 @@ struct mpp_service {
 
 	/* global timing record flag */
 	u32 timing_en;
+	/* qos starvation protection threshold */
+	u32 qos_starve_ms;
+	/* max tasks batched on one device of a shared taskqueue, 0 disables */
+	u32 grf_batch;
 };
 
 /*
@@ -631,6 +711,16 @@ void mpp_task_run_begin(struct mpp_task *task, u32 timing_en, u32 timeout);
 void mpp_task_run_end(struct mpp_task *task, u32 timing_en);
 int mpp_task_finalize(struct mpp_session *session,
 		      struct mpp_task *task);
+void mpp_session_post_done(struct mpp_session *session,
+			   struct mpp_task *task);
+int mpp_task_attach_fence(struct mpp_task *task, struct mpp_task_msgs *msgs);
+u32 mpp_rcb_sram_claim(struct gen_pool *pool, phys_addr_t start, u32 size,
+		       const struct rcb_info_elem *elem, u32 cnt,
+		       struct mpp_rcb_grant *grant);
+void mpp_rcb_sram_release(struct mpp_rcb_grant *grant);
+bool mpp_task_fence_ready(struct mpp_task *task);
+void mpp_session_post_slice(struct mpp_session *session, struct mpp_task *task,
+			    u32 slice_idx, u32 length, bool last);
 int mpp_task_dump_mem_region(struct mpp_dev *mpp,
 			     struct mpp_task *task);
 int mpp_task_dump_reg(struct mpp_dev *mpp,
@@ -647,6 +737,10 @@ void mpp_session_cleanup_detach(struct mpp_taskqueue *queue,
 				struct kthread_work *work);
 
 int mpp_taskqueue_pending_to_run(struct mpp_taskqueue *queue, struct mpp_task *task);
+struct mpp_task *mpp_taskqueue_get_pending_task(struct mpp_taskqueue *queue);
+s32 mpp_taskqueue_get_idle_core(struct mpp_taskqueue *queue,
+				unsigned long core_idle);
+void mpp_core_load_account(struct mpp_dev *mpp, struct mpp_task *task);
 
 int mpp_dev_probe(struct mpp_dev *mpp,
 		  struct platform_device *pdev);
@@ -224,6 +224,17 @@ struct iep2_dev {
 	struct reset_control *rst_s;
 
 	struct mpp_dma_buffer roi;
+
+	/*
+	 * Tables last written to the hardware. They rarely change from one
+	 * field to the next, so identical uploads are skipped while the
+	 * register file is known to still hold them.
+	 */
+	u32 osd_cache[8];
+	u32 tru_cache[2];
+	u32 mtn_cache[16];
+	bool cache_valid;
+	u32 cache_skip;
 };
 
 static int iep2_addr_rnum[] = {
@@ -503,32 +514,47 @@ static void iep2_config(struct mpp_dev *mpp, struct iep_task *task)
 			  IEP2_REG_BLE_BACKTOMA_NUM(cfg->ble_backtoma_num));
 }
 
+static void iep2_tab_write(struct mpp_dev *mpp, u32 *cache, u32 base,
+			   const u32 *val, int num)
+{
+	struct iep2_dev *iep = to_iep2_dev(mpp);
+	int i;
+
+	if (iep->cache_valid && !memcmp(cache, val, num * sizeof(*val))) {
+		iep->cache_skip++;
+		return;
+	}
+
+	for (i = 0; i < num; ++i)
+		mpp_write_relaxed(mpp, base + i * 4, val[i]);
+	memcpy(cache, val, num * sizeof(*val));
+}
+
 static void iep2_osd_cfg(struct mpp_dev *mpp, struct iep_task *task)
 {
+	struct iep2_dev *iep = to_iep2_dev(mpp);
 	struct iep2_params *hw_cfg = &task->params;
+	u32 reg[ARRAY_SIZE(iep->osd_cache)] = { 0 };
 	int i;
-	u32 reg;
 
-	for (i = 0; i < hw_cfg->osd_area_num; ++i) {
-		reg = IEP2_REG_OSD_X_STA(hw_cfg->osd_x_sta[i])
+	for (i = 0; i < hw_cfg->osd_area_num && i < ARRAY_SIZE(reg); ++i)
+		reg[i] = IEP2_REG_OSD_X_STA(hw_cfg->osd_x_sta[i])
 			| IEP2_REG_OSD_X_END(hw_cfg->osd_x_end[i])
 			| IEP2_REG_OSD_Y_STA(hw_cfg->osd_y_sta[i])
 			| IEP2_REG_OSD_Y_END(hw_cfg->osd_y_end[i]);
-		mpp_write_relaxed(mpp, IEP2_REG_OSD_AREA_CONF(i), reg);
-	}
 
-	for (; i < ARRAY_SIZE(hw_cfg->osd_x_sta); ++i)
-		mpp_write_relaxed(mpp, IEP2_REG_OSD_AREA_CONF(i), 0);
+	iep2_tab_write(mpp, iep->osd_cache, IEP2_REG_OSD_AREA_CONF(0),
+		       reg, ARRAY_SIZE(reg));
 }
 
 static void iep2_mtn_tab_cfg(struct mpp_dev *mpp, struct iep_task *task)
 {
+	struct iep2_dev *iep = to_iep2_dev(mpp);
 	struct iep2_params *hw_cfg = &task->params;
-	int i;
 	u32 *mtn_tab = hw_cfg->mtn_en ? hw_cfg->mtn_tab : iep2_mtn_tab;
 
-	for (i = 0; i < ARRAY_SIZE(hw_cfg->mtn_tab); ++i)
-		mpp_write_relaxed(mpp, IEP2_REG_DIL_MTN_TAB(i), mtn_tab[i]);
+	iep2_tab_write(mpp, iep->mtn_cache, IEP2_REG_DIL_MTN_TAB(0),
+		       mtn_tab, ARRAY_SIZE(iep->mtn_cache));
 }
 
 static u32 iep2_tru_list_vld_tab[] = {
@@ -540,31 +566,31 @@ static u32 iep2_tru_list_vld_tab[] = {
 
 static void iep2_tru_list_cfg(struct mpp_dev *mpp, struct iep_task *task)
 {
+	struct iep2_dev *iep = to_iep2_dev(mpp);
 	struct iep2_params *cfg = &task->params;
+	u32 reg[ARRAY_SIZE(iep->tru_cache)] = { 0 };
 	int i;
-	u32 reg;
 
 	for (i = 0; i < ARRAY_SIZE(cfg->mv_tru_list); i += 4) {
-		reg = 0;
-
 		if (cfg->mv_tru_vld[i])
-			reg |= IEP2_REG_MV_TRU_LIST0_4(cfg->mv_tru_list[i])
+			reg[i / 4] |= IEP2_REG_MV_TRU_LIST0_4(cfg->mv_tru_list[i])
 				| iep2_tru_list_vld_tab[i];
 
 		if (cfg->mv_tru_vld[i + 1])
-			reg |= IEP2_REG_MV_TRU_LIST1_5(cfg->mv_tru_list[i + 1])
+			reg[i / 4] |= IEP2_REG_MV_TRU_LIST1_5(cfg->mv_tru_list[i + 1])
 				| iep2_tru_list_vld_tab[i + 1];
 
 		if (cfg->mv_tru_vld[i + 2])
-			reg |= IEP2_REG_MV_TRU_LIST2_6(cfg->mv_tru_list[i + 2])
+			reg[i / 4] |= IEP2_REG_MV_TRU_LIST2_6(cfg->mv_tru_list[i + 2])
 				| iep2_tru_list_vld_tab[i + 2];
 
 		if (cfg->mv_tru_vld[i + 3])
-			reg |= IEP2_REG_MV_TRU_LIST3_7(cfg->mv_tru_list[i + 3])
+			reg[i / 4] |= IEP2_REG_MV_TRU_LIST3_7(cfg->mv_tru_list[i + 3])
 				| iep2_tru_list_vld_tab[i + 3];
-
-		mpp_write_relaxed(mpp, IEP2_REG_MV_TRU_LIST(i / 4), reg);
 	}
+
+	iep2_tab_write(mpp, iep->tru_cache, IEP2_REG_MV_TRU_LIST(0),
+		       reg, ARRAY_SIZE(reg));
 }
 
 static void iep2_comb_cfg(struct mpp_dev *mpp, struct iep_task *task)
@@ -587,6 +613,7 @@ static void iep2_comb_cfg(struct mpp_dev *mpp, struct iep_task *task)
 static int iep2_run(struct mpp_dev *mpp,
 		    struct mpp_task *mpp_task)
 {
+	struct iep2_dev *iep = to_iep2_dev(mpp);
 	struct iep_task *task = NULL;
 	u32 timing_en = mpp->srv->timing_en;
 
@@ -597,11 +624,20 @@ static int iep2_run(struct mpp_dev *mpp,
 	/* init current task */
 	mpp->cur_task = mpp_task;
 
+	/*
+	 * The interrupt enable is written by every task and only reads back
+	 * as zero once the power domain has been off, so use it to tell if
+	 * the cached tables are still in the register file.
+	 */
+	if (!mpp_read_relaxed(mpp, IEP2_REG_INT_EN))
+		iep->cache_valid = false;
+
 	iep2_config(mpp, task);
 	iep2_osd_cfg(mpp, task);
 	iep2_mtn_tab_cfg(mpp, task);
 	iep2_tru_list_cfg(mpp, task);
 	iep2_comb_cfg(mpp, task);
+	iep->cache_valid = true;
 
 	/* set interrupt enable bits */
 	mpp_write_relaxed(mpp, IEP2_REG_INT_EN,
@@ -803,6 +839,8 @@ static int iep2_procfs_init(struct mpp_dev *mpp)
 			      iep->procfs, &iep->aclk_info.debug_rate_hz);
 	mpp_procfs_create_u32("session_buffers", 0644,
 			      iep->procfs, &mpp->session_max_buffers);
+	mpp_procfs_create_u32("cache_skip", 0444,
+			      iep->procfs, &iep->cache_skip);
 
 	return 0;
 }
@@ -903,6 +941,8 @@ static int iep2_reset(struct mpp_dev *mpp)
 	int ret = 0;
 	u32 rst_status = 0;
 
+	iep->cache_valid = false;
+
 	/* soft rest first */
 	mpp_write(mpp, IEP2_REG_IEP_CONFIG0, IEP2_REG_ACLK_SRESET_P);
 	ret = readl_relaxed_poll_timeout(mpp->reg_base + IEP2_REG_STATUS,
@@ -27,47 +27,43 @@
 #include "mpp_iommu.h"
 #include "mpp_common.h"
 
+static struct mpp_dma_buffer *
+mpp_dma_find_buffer_locked(struct mpp_dma_session *dma, struct dma_buf *dmabuf)
+{
+	struct mpp_dma_buffer *buffer;
+
+	/*
+	 * fd may dup several and point the same dambuf.
+	 * thus, here should be distinguish with the dmabuf.
+	 */
+	hash_for_each_possible(dma->buf_hash, buffer, hnode, (unsigned long)dmabuf) {
+		if (buffer->dmabuf != dmabuf)
+			continue;
+
+		/* keep the list in lru order */
+		if (buffer->static_use)
+			list_move_tail(&buffer->link, &dma->static_list);
+		else
+			list_move_tail(&buffer->link, &dma->used_list);
+
+		return buffer;
+	}
+
+	return NULL;
+}
+
 struct mpp_dma_buffer *
 mpp_dma_find_buffer_fd(struct mpp_dma_session *dma, int fd)
 {
 	struct dma_buf *dmabuf;
 	struct mpp_dma_buffer *out = NULL;
-	struct mpp_dma_buffer *buffer = NULL, *n;
-	int find = 0;
 
 	dmabuf = dma_buf_get(fd);
 	if (IS_ERR(dmabuf))
 		return NULL;
 
 	mutex_lock(&dma->list_mutex);
-	list_for_each_entry_safe(buffer, n,
-				 &dma->used_list, link) {
-		/*
-		 * fd may dup several and point the same dambuf.
-		 * thus, here should be distinguish with the dmabuf.
-		 */
-		if (buffer->dmabuf == dmabuf) {
-			out = buffer;
-			find = 1;
-			list_move_tail(&buffer->link, &buffer->dma->used_list);
-			break;
-		}
-	}
-	if (!find) {
-		list_for_each_entry_safe(buffer, n,
-					&dma->static_list, link) {
-			/*
-			 * fd may dup several and point the same dambuf.
-			 * thus, here should be distinguish with the dmabuf.
-			 */
-			if (buffer->dmabuf == dmabuf) {
-				out = buffer;
-				list_move_tail(&buffer->link, &buffer->dma->static_list);
-				break;
-			}
-		}
-	}
-
+	out = mpp_dma_find_buffer_locked(dma, dmabuf);
 	mutex_unlock(&dma->list_mutex);
 	dma_buf_put(dmabuf);
 
@@ -82,6 +78,7 @@ static void mpp_dma_release_buffer(struct kref *ref)
 
 	buffer->dma->buffer_count--;
 	list_move_tail(&buffer->link, &buffer->dma->unused_list);
+	hash_del(&buffer->hnode);
 
 	dma_buf_unmap_attachment(buffer->attach, buffer->sgt, buffer->dir);
 	dma_buf_detach(buffer->dmabuf, buffer->attach);
@@ -95,6 +92,31 @@ static void mpp_dma_release_buffer(struct kref *ref)
 	buffer->size = 0;
 	buffer->vaddr = NULL;
 	buffer->last_used = 0;
+	buffer->static_use = false;
+}
+
+/*
+ * Drop the cached mapping whose dma-buf has been released by all the other
+ * users, the session reference is the last one to keep it alive.
+ */
+static void
+mpp_dma_remove_orphan_buffer(struct mpp_dma_session *dma)
+{
+	struct mpp_dma_buffer *n;
+	struct mpp_dma_buffer *buffer = NULL;
+
+	mutex_lock(&dma->list_mutex);
+	list_for_each_entry_safe(buffer, n, &dma->used_list, link) {
+		if (kref_read(&buffer->ref) != 1)
+			continue;
+
+		if (file_count(buffer->dmabuf->file) != 1)
+			continue;
+
+		dma->cache_evict++;
+		kref_put(&buffer->ref, mpp_dma_release_buffer);
+	}
+	mutex_unlock(&dma->list_mutex);
 }
 
 /* Remove the oldest buffer when count more than the setting */
@@ -114,8 +136,10 @@ mpp_dma_remove_extra_buffer(struct mpp_dma_session *dma)
 				break;
 			}
 		}
-		if (removable)
+		if (removable) {
+			dma->cache_evict++;
 			kref_put(&removable->ref, mpp_dma_release_buffer);
+		}
 		mutex_unlock(&dma->list_mutex);
 	}
 
@@ -212,10 +236,17 @@ struct mpp_dma_buffer *mpp_dma_import_fd(struct mpp_iommu_info *iommu_info,
 	/* Check whether in dma session */
 	buffer = mpp_dma_find_buffer_fd(dma, fd);
 	if (!IS_ERR_OR_NULL(buffer)) {
-		if (kref_get_unless_zero(&buffer->ref))
+		if (kref_get_unless_zero(&buffer->ref)) {
+			dma->cache_hit++;
 			return buffer;
+		}
 		dev_dbg(dma->dev, "missing the fd %d\n", fd);
 	}
+	dma->cache_miss++;
+
+	/* reclaim the slot of released dma-buf before a new mapping */
+	if (!IS_ENABLED(CONFIG_DMABUF_CACHE))
+		mpp_dma_remove_orphan_buffer(dma);
 
 	dmabuf = dma_buf_get(fd);
 	if (IS_ERR(dmabuf)) {
@@ -257,6 +288,7 @@ struct mpp_dma_buffer *mpp_dma_import_fd(struct mpp_iommu_info *iommu_info,
 	buffer->attach = attach;
 	buffer->sgt = sgt;
 	buffer->dma = dma;
+	buffer->static_use = static_use ? true : false;
 
 	kref_init(&buffer->ref);
 
@@ -270,6 +302,7 @@ struct mpp_dma_buffer *mpp_dma_import_fd(struct mpp_iommu_info *iommu_info,
 		list_add_tail(&buffer->link, &dma->static_list);
 	else
 		list_add_tail(&buffer->link, &dma->used_list);
+	hash_add(dma->buf_hash, &buffer->hnode, (unsigned long)buffer->dmabuf);
 	mutex_unlock(&dma->list_mutex);
 
 	return buffer;
@@ -376,6 +409,7 @@ mpp_dma_session_create(struct device *dev, u32 max_buffers)
 	INIT_LIST_HEAD(&dma->unused_list);
 	INIT_LIST_HEAD(&dma->used_list);
 	INIT_LIST_HEAD(&dma->static_list);
+	hash_init(dma->buf_hash);
 
 	if (max_buffers > MPP_SESSION_MAX_BUFFERS) {
 		mpp_debug(DEBUG_IOCTL, "session_max_buffer %d must less than %d\n",
@@ -389,6 +423,7 @@ mpp_dma_session_create(struct device *dev, u32 max_buffers)
 		buffer = &dma->dma_bufs[i];
 		buffer->dma = dma;
 		INIT_LIST_HEAD(&buffer->link);
+		INIT_HLIST_NODE(&buffer->hnode);
 		list_add_tail(&buffer->link, &dma->unused_list);
 	}
 	dma->dev = dev;
@@ -410,6 +445,10 @@ void mpp_dma_buf_sync(struct mpp_dma_buffer *buffer, u32 offset, u32 length,
 	unsigned int len = 0;
 	int i;
 
+	/* nothing to maintain for write-combined / uncached exporters */
+	if (dma_buf_is_uncached(buffer->dmabuf))
+		return;
+
 	for_each_sgtable_sg(sgt, sg, i) {
 		unsigned int sg_offset, sg_left, size = 0;
 
@@ -11,6 +11,7 @@
 #ifndef __ROCKCHIP_MPP_IOMMU_H__
 #define __ROCKCHIP_MPP_IOMMU_H__
 
+#include <linux/hashtable.h>
 #include <linux/iommu.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
@@ -31,6 +32,10 @@ struct mpp_iommu_dma_cookie {
 struct mpp_dma_buffer {
 	/* link to dma session buffer list */
 	struct list_head link;
+	/* link to dma session buffer hash keyed by dmabuf */
+	struct hlist_node hnode;
+	/* import by MPP_CMD_TRANS_FD_TO_IOVA */
+	bool static_use;
 
 	/* dma session belong */
 	struct mpp_dma_session *dma;
@@ -52,6 +57,7 @@ struct mpp_dma_buffer {
 };
 
 #define MPP_SESSION_MAX_BUFFERS		60
+#define MPP_SESSION_BUFFER_HASH_BITS	6
 
 struct mpp_dma_session {
 	/* the buffer used in session */
@@ -64,12 +70,18 @@ struct mpp_dma_session {
 	 */
 	struct list_head static_list;
 	struct mpp_dma_buffer dma_bufs[MPP_SESSION_MAX_BUFFERS];
+	/* the imported buffer hashed by dmabuf for fast lookup */
+	DECLARE_HASHTABLE(buf_hash, MPP_SESSION_BUFFER_HASH_BITS);
 	/* the mutex for the above buffer list */
 	struct mutex list_mutex;
 	/* the max buffer num for the buffer list */
 	u32 max_buffers;
 	/* the count for the buffer list */
 	int buffer_count;
+	/* mapping cache statistics */
+	u32 cache_hit;
+	u32 cache_miss;
+	u32 cache_evict;
 
 	struct device *dev;
 };
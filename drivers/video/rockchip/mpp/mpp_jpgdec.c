@@ -457,13 +457,29 @@ static int jpgdec_clk_off(struct mpp_dev *mpp)
 	return 0;
 }
 
+static void jpgdec_set_aclk(struct jpgdec_dev *dec, enum MPP_CLOCK_MODE mode)
+{
+	struct mpp_clk_info *clk_info = &dec->aclk_info;
+
+	/*
+	 * Thumbnails and mjpeg frames come in bursts of back to back tasks
+	 * that all ask for the same rate, keep the clock steady instead of
+	 * going through the clock framework for every small image.
+	 */
+	if (clk_info->used_rate_hz &&
+	    clk_info->used_rate_hz == mpp_get_clk_info_rate_hz(clk_info, mode))
+		return;
+
+	mpp_clk_set_rate(clk_info, mode);
+}
+
 static int jpgdec_set_freq(struct mpp_dev *mpp,
 			 struct mpp_task *mpp_task)
 {
 	struct jpgdec_dev *dec = to_jpgdec_dev(mpp);
 	struct jpgdec_task *task = to_jpgdec_task(mpp_task);
 
-	mpp_clk_set_rate(&dec->aclk_info, task->clk_mode);
+	jpgdec_set_aclk(dec, task->clk_mode);
 
 	return 0;
 }
@@ -472,7 +488,7 @@ static int jpgdec_reduce_freq(struct mpp_dev *mpp)
 {
 	struct jpgdec_dev *dec = to_jpgdec_dev(mpp);
 
-	mpp_clk_set_rate(&dec->aclk_info, CLK_MODE_REDUCE);
+	jpgdec_set_aclk(dec, CLK_MODE_REDUCE);
 
 	return 0;
 }
@@ -289,12 +289,21 @@ int mpp_set_rcbbuf(struct mpp_dev *mpp, struct mpp_session *session,
 		u32 reg_idx, rcb_size, rcb_offset;
 		struct rkvdec2_rcb_info *rcb_inf = &priv->rcb_inf;
 		u32 width = priv->codec_info[DEC_INFO_WIDTH].val;
+		u32 cnt = rcb_inf->cnt;
 
 		if (width < dec->rcb_min_width)
 			goto done;
 
 		rcb_offset = 0;
-		for (i = 0; i < rcb_inf->cnt; i++) {
+		/* shared sram, only the part claimed for this task is used */
+		if (dec->sram_pool) {
+			cnt = mpp_rcb_sram_claim(dec->sram_pool, dec->sram_start,
+						 dec->sram_size, rcb_inf->elem, cnt,
+						 &task->rcb_grant);
+			if (cnt)
+				rcb_offset = task->rcb_grant.addr - dec->sram_start;
+		}
+		for (i = 0; i < cnt; i++) {
 			reg_idx = rcb_inf->elem[i].index;
 			rcb_size = rcb_inf->elem[i].size;
 			if ((rcb_offset + rcb_size) > dec->rcb_size) {
@@ -386,7 +395,6 @@ void *rkvdec2_alloc_task(struct mpp_session *session,
 		kfree(task);
 		return NULL;
 	}
-	mpp_set_rcbbuf(session->mpp, session, &task->mpp_task);
 
 	return &task->mpp_task;
 }
@@ -424,6 +432,9 @@ static int rkvdec2_run(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 
 	mpp_debug_enter();
 
+	/* set rcb buffer when the task runs, so the pending ones hold no sram */
+	mpp_set_rcbbuf(mpp, mpp_task->session, mpp_task);
+
 	if (!mpp_debug_unlikely(DEBUG_CACHE_32B))
 		reg |= RKVDEC_CACHE_LINE_SIZE_64_BYTES;
 
@@ -499,6 +510,8 @@ static int rkvdec_vdpu383_run(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 
 	mpp_debug_enter();
 
+	mpp_set_rcbbuf(mpp, mpp_task->session, mpp_task);
+
 	if (!mpp_debug_unlikely(DEBUG_CACHE_32B))
 		reg |= RKVDEC_CACHE_LINE_SIZE_64_BYTES;
 
@@ -597,6 +610,7 @@ static int rkvdec2_isr(struct mpp_dev *mpp)
 	}
 	mpp_task->hw_cycles = mpp_read(mpp, RKVDEC_PERF_WORKING_CNT);
 	mpp_time_diff_with_hw_time(mpp_task, dec->cycle_clk->real_rate_hz);
+	rkvdec2_dvfs_account(dec, mpp_task);
 	mpp->cur_task = NULL;
 	task = to_rkvdec2_task(mpp_task);
 	task->irq_status = mpp->irq_status;
@@ -631,6 +645,7 @@ static int rkvdec_vdpu383_isr(struct mpp_dev *mpp)
 	}
 	mpp_task->hw_cycles = mpp_read(mpp, RKVDEC_PERF_WORKING_CNT);
 	mpp_time_diff_with_hw_time(mpp_task, dec->cycle_clk->real_rate_hz);
+	rkvdec2_dvfs_account(dec, mpp_task);
 	mpp->cur_task = NULL;
 	task = to_rkvdec2_task(mpp_task);
 	task->irq_status = mpp->irq_status;
@@ -694,6 +709,9 @@ static int rkvdec2_finish(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 
 	mpp_debug_enter();
 
+	/* hardware is done with the rcb, hand the sram back */
+	mpp_rcb_sram_release(&mpp_task->rcb_grant);
+
 	/* read register after running */
 	for (i = 0; i < task->r_req_cnt; i++) {
 		req = &task->r_reqs[i];
@@ -903,6 +921,16 @@ static int rkvdec2_procfs_init(struct mpp_dev *mpp)
 			   dec->procfs, rkvdec2_show_pref_sel_offset);
 	mpp_procfs_create_u32("task_count", 0644,
 			      dec->procfs, &mpp->task_index);
+	mpp_procfs_create_u32("reset_count", 0444,
+			      dec->procfs, &dec->reset_count);
+	mpp_procfs_create_u32("reset_last_us", 0444,
+			      dec->procfs, &dec->reset_last_us);
+	mpp_procfs_create_u32("reset_max_us", 0644,
+			      dec->procfs, &dec->reset_max_us);
+#ifdef CONFIG_PM_DEVFREQ
+	mpp_procfs_create_u32("dvfs_predict", 0644,
+			      dec->procfs, &dec->dvfs_predict);
+#endif
 
 	return 0;
 }
@@ -918,6 +946,78 @@ static inline int rkvdec2_procfs_init(struct mpp_dev *mpp)
 }
 #endif
 
+#ifdef CONFIG_PM_DEVFREQ
+static inline bool rkvdec2_dvfs_predict_en(struct rkvdec2_dev *dec)
+{
+	return dec->devfreq && dec->dvfs_predict;
+}
+
+/*
+ * Predict core clock rate from the workload submitted and still pending.
+ * The submitted pixel rate is sampled every RKVDEC2_DVFS_WINDOW_MS and the
+ * pending pixels should be drained in one window, so a new stream raises the
+ * clock on its first frame and a drained queue lowers it within one window.
+ * Called with queue pending_lock held.
+ */
+static void rkvdec2_dvfs_predict(struct rkvdec2_dev *dec, u32 pixels, u64 pending)
+{
+	ktime_t now = ktime_get();
+	s64 elapsed = ktime_ms_delta(now, dec->window_start);
+	u64 demand;
+	u64 rate_hz;
+
+	dec->window_pixels += pixels;
+	if (elapsed >= RKVDEC2_DVFS_WINDOW_MS) {
+		dec->pixel_rate = div_u64(dec->window_pixels * MSEC_PER_SEC, elapsed);
+		dec->window_pixels = 0;
+		dec->window_start = now;
+	}
+
+	demand = div_u64(pending * MSEC_PER_SEC, RKVDEC2_DVFS_WINDOW_MS);
+	demand = max(demand, dec->pixel_rate);
+
+	/* 25% headroom for bitstream complexity variance */
+	rate_hz = (demand * dec->cycles_per_pixel) >> RKVDEC2_DVFS_CPP_SHIFT;
+	dec->predict_rate_hz = rate_hz + (rate_hz >> 2);
+
+	mpp_debug(DEBUG_TASK_INFO, "pixel rate %llu pending %llu predict %lu Hz\n",
+		  dec->pixel_rate, pending, dec->predict_rate_hz);
+}
+
+/* learn core clock cycles per pixel from finished tasks */
+static void rkvdec2_dvfs_account(struct rkvdec2_dev *dec, struct mpp_task *mpp_task)
+{
+	struct rkvdec2_task *task = to_rkvdec2_task(mpp_task);
+	unsigned long cycle_rate = dec->cycle_clk->real_rate_hz;
+	u64 cycles;
+	u32 cpp;
+
+	if (!rkvdec2_dvfs_predict_en(dec) || !task->pixels ||
+	    !mpp_task->hw_cycles || !cycle_rate)
+		return;
+
+	/* perf counter runs on cycle clock, convert to core clock cycles */
+	cycles = div_u64((u64)mpp_task->hw_cycles * dec->core_clk_info.real_rate_hz,
+			 cycle_rate);
+	cpp = div_u64(cycles << RKVDEC2_DVFS_CPP_SHIFT, task->pixels);
+	/* moving average with 1/8 weight */
+	dec->cycles_per_pixel += ((s32)cpp - (s32)dec->cycles_per_pixel) / 8;
+}
+#else
+static inline bool rkvdec2_dvfs_predict_en(struct rkvdec2_dev *dec)
+{
+	return false;
+}
+
+static inline void rkvdec2_dvfs_predict(struct rkvdec2_dev *dec, u32 pixels, u64 pending)
+{
+}
+
+static inline void rkvdec2_dvfs_account(struct rkvdec2_dev *dec, struct mpp_task *mpp_task)
+{
+}
+#endif
+
 #ifdef CONFIG_PM_DEVFREQ
 static int rkvdec2_devfreq_target(struct device *dev,
 				  unsigned long *freq, u32 flags)
@@ -1080,6 +1180,11 @@ static int rkvdec2_devfreq_init(struct mpp_dev *mpp)
 	dec->devfreq->last_status.total_time = 1;
 	dec->devfreq->last_status.busy_time = 1;
 
+	/* start prediction with one core cycle per pixel */
+	dec->dvfs_predict = 1;
+	dec->cycles_per_pixel = 1 << RKVDEC2_DVFS_CPP_SHIFT;
+	dec->window_start = ktime_get();
+
 	devfreq_register_opp_notifier(mpp->dev, dec->devfreq);
 
 	vdec2_mdevp.data = dec->devfreq;
@@ -1117,20 +1222,33 @@ static int rkvdec2_devfreq_remove(struct mpp_dev *mpp)
 void mpp_devfreq_set_core_rate(struct mpp_dev *mpp, enum MPP_CLOCK_MODE mode)
 {
 	struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
+	struct mpp_clk_info *clk_info = &dec->core_clk_info;
 
 	if (dec->devfreq) {
 		unsigned long core_rate_hz;
+		bool predict = rkvdec2_dvfs_predict_en(dec) && dec->predict_rate_hz;
 
 		mutex_lock(&dec->devfreq->lock);
-		core_rate_hz = mpp_get_clk_info_rate_hz(&dec->core_clk_info, mode);
+		core_rate_hz = mpp_get_clk_info_rate_hz(clk_info, mode);
+		if (predict)
+			core_rate_hz = clamp(dec->predict_rate_hz,
+					     mpp_get_clk_info_rate_hz(clk_info, CLK_MODE_REDUCE),
+					     mpp_get_clk_info_rate_hz(clk_info, CLK_MODE_ADVANCED));
 		if (dec->core_rate_hz != core_rate_hz) {
 			dec->core_rate_hz = core_rate_hz;
 			update_devfreq(dec->devfreq);
 		}
 		mutex_unlock(&dec->devfreq->lock);
+
+		/* predicted rate is set by devfreq, only update clock info */
+		if (predict) {
+			clk_info->used_rate_hz = dec->core_last_rate_hz;
+			clk_info->real_rate_hz = clk_get_rate(clk_info->clk);
+			return;
+		}
 	}
 
-	mpp_clk_set_rate(&dec->core_clk_info, mode);
+	mpp_clk_set_rate(clk_info, mode);
 }
 #else
 static inline int rkvdec2_devfreq_init(struct mpp_dev *mpp)
@@ -1294,13 +1412,14 @@ static int rkvdec2_get_freq(struct mpp_dev *mpp,
 			    struct mpp_task *mpp_task)
 {
 	u32 task_cnt;
-	u32 workload;
+	u64 workload;
 	struct mpp_task *loop = NULL, *n;
 	struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
 	struct rkvdec2_task *task = to_rkvdec2_task(mpp_task);
+	bool predict = rkvdec2_dvfs_predict_en(dec);
 
 	/* if not set max load, consider not have advanced mode */
-	if (!dec->default_max_load || !task->pixels)
+	if ((!dec->default_max_load && !predict) || !task->pixels)
 		return 0;
 
 	task_cnt = 1;
@@ -1315,12 +1434,14 @@ static int rkvdec2_get_freq(struct mpp_dev *mpp,
 		task_cnt++;
 		workload += loop_task->pixels;
 	}
+	if (predict)
+		rkvdec2_dvfs_predict(dec, task->pixels, workload);
 	mutex_unlock(&mpp->queue->pending_lock);
 
-	if (workload > dec->default_max_load)
+	if (dec->default_max_load && workload > dec->default_max_load)
 		task->clk_mode = CLK_MODE_ADVANCED;
 
-	mpp_debug(DEBUG_TASK_INFO, "pending task %d, workload %d, clk_mode=%d\n",
+	mpp_debug(DEBUG_TASK_INFO, "pending task %d, workload %llu, clk_mode=%d\n",
 		  task_cnt, workload, task->clk_mode);
 
 	return 0;
@@ -1750,9 +1871,14 @@ static int rkvdec2_alloc_rcbbuf(struct platform_device *pdev, struct rkvdec2_dev
 		}
 		dec->rcb_page = page;
 	}
+	dec->sram_start = sram_start;
 	dec->sram_size = sram_size;
 	dec->rcb_size = rcb_size;
 	dec->rcb_iova = iova;
+	/* sram managed by a pool is shared with other ips, claim it per task */
+	dec->sram_pool = of_gen_pool_get(dev->of_node, "rockchip,sram", 0);
+	if (dec->sram_pool)
+		dev_info(dev, "sram shared by pool\n");
 	dev_info(dev, "sram_start %pa\n", &sram_start);
 	dev_info(dev, "rcb_iova %pad\n", &dec->rcb_iova);
 	dev_info(dev, "sram_size %u\n", dec->sram_size);
@@ -38,6 +38,11 @@
 #define RKVDEC_SOFTREST_EN		BIT(20)
 
 #define	RKVDEC_SESSION_MAX_BUFFERS	40
+
+/* workload predictive dvfs sample window and cycles per pixel precision */
+#define RKVDEC2_DVFS_WINDOW_MS		100
+#define RKVDEC2_DVFS_CPP_SHIFT		8
+
 /* The maximum registers number of all the version */
 #define RKVDEC_REG_NUM			360
 
@@ -106,11 +111,6 @@ enum RKVDEC_FMT {
 
 #define RKVDEC_MAX_RCB_NUM		(16)
 
-struct rcb_info_elem {
-	u32 index;
-	u32 size;
-};
-
 struct rkvdec2_rcb_info {
 	u32 cnt;
 	struct rcb_info_elem elem[RKVDEC_MAX_RCB_NUM];
@@ -190,9 +190,20 @@ struct rkvdec2_dev {
 	unsigned long core_last_rate_hz;
 	struct monitor_dev_info *mdev_info;
 	struct rockchip_opp_info opp_info;
+
+	/* workload prediction for devfreq */
+	u32 dvfs_predict;
+	/* core clock cycles per pixel in Q8 */
+	u32 cycles_per_pixel;
+	u64 window_pixels;
+	ktime_t window_start;
+	u64 pixel_rate;
+	unsigned long predict_rate_hz;
 #endif
 
 	/* internal rcb-memory */
+	struct gen_pool *sram_pool;
+	phys_addr_t sram_start;
 	u32 sram_size;
 	u32 rcb_size;
 	dma_addr_t rcb_iova;
@@ -209,6 +220,10 @@ struct rkvdec2_dev {
 	struct rkvdec2_ccu *ccu;
 	u32 core_mask;
 	u32 task_index;
+	/* time this core spent in error resets */
+	u32 reset_count;
+	u32 reset_last_us;
+	u32 reset_max_us;
 	/* mmu info */
 	void __iomem *mmu_base;
 	u32 mmu_fault;
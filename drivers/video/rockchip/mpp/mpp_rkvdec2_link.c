@@ -9,12 +9,14 @@
 #include <linux/delay.h>
 #include <linux/interrupt.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <soc/rockchip/pm_domains.h>
 #include <soc/rockchip/rockchip_dmc.h>
 #include <soc/rockchip/rockchip_iommu.h>
 
 #include "mpp_rkvdec2_link.h"
+#include "mpp_trace.h"
 
 #include "hack/mpp_rkvdec2_link_hack_rk3568.c"
 
@@ -410,16 +412,16 @@ static void rkvdec2_clear_cache(struct mpp_dev *mpp)
 }
 
 static int rkvdec2_link_enqueue(struct rkvdec_link_dev *link_dec,
-				struct mpp_task *mpp_task)
+				struct mpp_task **tasks, u32 frame_num)
 {
 	void __iomem *reg_base = link_dec->reg_base;
-	struct rkvdec2_task *task = to_rkvdec2_task(mpp_task);
+	struct rkvdec2_task *task = to_rkvdec2_task(tasks[0]);
 	struct mpp_dma_buffer *table = task->table;
 	struct rkvdec_link_info *link_info = link_dec->info;
 	u32 link_en = 0;
-	u32 frame_num = 1;
 	u32 link_mode;
 	u32 timing_en = link_dec->mpp->srv->timing_en;
+	u32 i;
 
 	link_en = readl(reg_base + RKVDEC_LINK_EN_BASE);
 	/* finish last work flow */
@@ -450,9 +452,10 @@ static int rkvdec2_link_enqueue(struct rkvdec_link_dev *link_dec,
 	wmb();
 
 	mpp_iommu_flush_tlb(link_dec->mpp->iommu_info);
-	mpp_task_run_begin(mpp_task, timing_en, MPP_WORK_TIMEOUT_DELAY);
+	for (i = 0; i < frame_num; i++)
+		mpp_task_run_begin(tasks[i], timing_en, MPP_WORK_TIMEOUT_DELAY);
 
-	link_dec->task_running++;
+	link_dec->task_running += frame_num;
 	/* configure done */
 	writel(RKVDEC_LINK_BIT_CFG_DONE, reg_base + RKVDEC_LINK_CFG_CTRL_BASE);
 	if (!link_en) {
@@ -461,7 +464,16 @@ static int rkvdec2_link_enqueue(struct rkvdec_link_dev *link_dec,
 		/* clear counter and enable link mode hardware */
 		writel(RKVDEC_LINK_BIT_EN, reg_base + RKVDEC_LINK_EN_BASE);
 	}
-	mpp_task_run_end(mpp_task, timing_en);
+	for (i = 0; i < frame_num; i++)
+		mpp_task_run_end(tasks[i], timing_en);
+
+	/* record link occupancy after each config */
+	link_dec->occupancy_sum += link_dec->task_running;
+	link_dec->occupancy_cnt++;
+	if (link_dec->task_running > link_dec->occupancy_max)
+		link_dec->occupancy_max = link_dec->task_running;
+	if (frame_num > link_dec->batch_max)
+		link_dec->batch_max = frame_num;
 
 	return 0;
 }
@@ -714,6 +726,22 @@ static int rkvdec2_link_alloc_table(struct mpp_dev *mpp,
 }
 
 #ifdef CONFIG_ROCKCHIP_MPP_PROC_FS
+static int rkvdec2_link_show_occupancy(struct seq_file *seq, void *offset)
+{
+	struct rkvdec_link_dev *link_dec = seq->private;
+	u32 cnt = link_dec->occupancy_cnt;
+
+	seq_printf(seq, "capacity %u depth %u running %u\n",
+		   link_dec->task_capacity, link_dec->task_depth,
+		   link_dec->task_running);
+	seq_printf(seq, "config %u avg %llu max %u batch max %u full %u\n",
+		   cnt, cnt ? div_u64(link_dec->occupancy_sum, cnt) : 0,
+		   link_dec->occupancy_max, link_dec->batch_max,
+		   link_dec->full_cnt);
+
+	return 0;
+}
+
 int rkvdec2_link_procfs_init(struct mpp_dev *mpp)
 {
 	struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
@@ -724,9 +752,12 @@ int rkvdec2_link_procfs_init(struct mpp_dev *mpp)
 
 	link_dec->statistic_count = 0;
 
-	if (dec->procfs)
+	if (dec->procfs) {
 		mpp_procfs_create_u32("statistic_count", 0644,
 				      dec->procfs, &link_dec->statistic_count);
+		proc_create_single_data("link_occupancy", 0444, dec->procfs,
+					rkvdec2_link_show_occupancy, link_dec);
+	}
 
 	return 0;
 }
@@ -772,16 +803,21 @@ int rkvdec2_link_init(struct platform_device *pdev, struct rkvdec2_dev *dec)
 	}
 
 	link_dec->task_capacity = mpp->task_capacity;
+	link_dec->task_depth = mpp->task_capacity;
 	/* if capacity<2, then not to alloc table array */
 	if (link_dec->task_capacity < 2)
 		goto out;
 
+	/* table is allocated for the deepest link, depth follows sessions */
+	link_dec->task_capacity = max_t(u32, mpp->task_capacity,
+					RKVDEC_LINK_MAX_CAPACITY);
+
 	ret = rkvdec2_link_alloc_table(&dec->mpp, link_dec);
 	if (ret)
 		goto done;
 
 	/* alloc table pointer array */
-	table = devm_kmalloc_array(mpp->dev, mpp->task_capacity,
+	table = devm_kmalloc_array(mpp->dev, link_dec->task_capacity,
 				   sizeof(*table), GFP_KERNEL | __GFP_ZERO);
 	if (!table)
 		return -ENOMEM;
@@ -790,7 +826,7 @@ int rkvdec2_link_init(struct platform_device *pdev, struct rkvdec2_dev *dec)
 	link_dec->table_array = table;
 	INIT_LIST_HEAD(&link_dec->used_list);
 	INIT_LIST_HEAD(&link_dec->unused_list);
-	for (i = 0; i < mpp->task_capacity; i++) {
+	for (i = 0; i < link_dec->task_capacity; i++) {
 		table[i].iova = link_dec->table->iova + i * link_dec->link_node_size;
 		table[i].vaddr = link_dec->table->vaddr + i * link_dec->link_node_size;
 		table[i].size = link_dec->link_node_size;
@@ -1020,7 +1056,7 @@ static void rkvdec2_link_resend(struct mpp_dev *mpp)
 		cancel_delayed_work_sync(&mpp_task->timeout_work);
 		clear_bit(TASK_STATE_TIMEOUT, &mpp_task->state);
 		clear_bit(TASK_STATE_HANDLE, &mpp_task->state);
-		rkvdec2_link_enqueue(link_dec, mpp_task);
+		rkvdec2_link_enqueue(link_dec, &mpp_task, 1);
 	}
 }
 
@@ -1127,6 +1163,7 @@ static void rkvdec2_link_try_dequeue(struct mpp_dev *mpp)
 				atomic_inc(&mpp->reset_request);
 		}
 
+		mpp_session_post_done(mpp_task->session, mpp_task);
 		wake_up(&mpp_task->wait);
 		kref_put(&mpp_task->ref, rkvdec2_link_free_task);
 	}
@@ -1136,15 +1173,35 @@ static void rkvdec2_link_try_dequeue(struct mpp_dev *mpp)
 		rkvdec2_link_resend(mpp);
 }
 
-static int mpp_task_queue(struct mpp_dev *mpp, struct mpp_task *mpp_task)
+static void rkvdec2_link_send(struct rkvdec_link_dev *link_dec,
+			      struct mpp_task **batch, u32 *batch_num)
+{
+	if (!*batch_num)
+		return;
+
+	rkvdec2_link_enqueue(link_dec, batch, *batch_num);
+
+	mpp_dbg_link("send %d task to hw pending %d running %d\n", *batch_num,
+		     atomic_read(&link_dec->task_pending), link_dec->task_running);
+	*batch_num = 0;
+}
+
+static int mpp_task_queue(struct mpp_dev *mpp, struct mpp_task *mpp_task,
+			  struct mpp_task **batch, u32 *batch_num)
 {
 	struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
 	struct rkvdec_link_dev *link_dec = dec->link_dec;
 	struct mpp_taskqueue *queue = mpp->queue;
 	struct rkvdec2_task *task = to_rkvdec2_task(mpp_task);
+	u32 task_used = link_dec->task_running + *batch_num;
 
 	mpp_debug_enter();
 
+	if (task_used >= link_dec->task_depth) {
+		link_dec->full_cnt++;
+		return -EBUSY;
+	}
+
 	rkvdec2_link_power_on(mpp);
 
 	/* hack for rk356x */
@@ -1152,11 +1209,14 @@ static int mpp_task_queue(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 		u32 *tb_reg;
 		struct mpp_dma_buffer *table;
 		struct rkvdec2_task *hack_task;
+		struct mpp_task *hack_mpp_task;
 		struct rkvdec_link_info *info = link_dec->info;
 
 		/* need reserved 2 unused task for need hack task */
-		if (link_dec->task_running > (link_dec->task_capacity - 2))
+		if (task_used > (link_dec->task_depth - 2)) {
+			link_dec->full_cnt++;
 			return -EBUSY;
+		}
 
 		table = list_first_entry_or_null(&link_dec->unused_list,
 						 struct mpp_dma_buffer,
@@ -1169,8 +1229,12 @@ static int mpp_task_queue(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 		if (!hack_task)
 			return -ENOMEM;
 
-		mpp_task_init(mpp_task->session, &hack_task->mpp_task);
-		INIT_DELAYED_WORK(&hack_task->mpp_task.timeout_work,
+		/* hack task must run right after the tasks already prepared */
+		rkvdec2_link_send(link_dec, batch, batch_num);
+
+		hack_mpp_task = &hack_task->mpp_task;
+		mpp_task_init(mpp_task->session, hack_mpp_task);
+		INIT_DELAYED_WORK(&hack_mpp_task->timeout_work,
 					rkvdec2_link_timeout_proc);
 
 		tb_reg = (u32 *)table->vaddr;
@@ -1179,25 +1243,28 @@ static int mpp_task_queue(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 		list_move_tail(&table->link, &link_dec->used_list);
 		hack_task->table = table;
 		hack_task->need_hack = RKVDEC2_LINK_HACK_TASK_FLAG;
-		rkvdec2_link_enqueue(link_dec, &hack_task->mpp_task);
-		mpp_taskqueue_pending_to_run(queue, &hack_task->mpp_task);
+		rkvdec2_link_enqueue(link_dec, &hack_mpp_task, 1);
+		mpp_taskqueue_pending_to_run(queue, hack_mpp_task);
 		link_dec->hack_task_running++;
 		mpp_dbg_link("hack task send to hw, hack running %d\n",
 			     link_dec->hack_task_running);
 	}
 
 	/* process normal */
-	if (!rkvdec2_link_prepare(mpp, mpp_task))
+	if (!rkvdec2_link_prepare(mpp, mpp_task)) {
+		link_dec->full_cnt++;
 		return -EBUSY;
+	}
 
-	rkvdec2_link_enqueue(link_dec, mpp_task);
+	/* the prepared task is sent to hw with the whole batch */
+	batch[(*batch_num)++] = mpp_task;
 
 	set_bit(TASK_STATE_RUNNING, &mpp_task->state);
 	atomic_dec(&link_dec->task_pending);
 	mpp_taskqueue_pending_to_run(queue, mpp_task);
 
-	mpp_dbg_link("session %d task %d send to hw pending %d running %d\n",
-		     mpp_task->session->index, mpp_task->task_index,
+	mpp_dbg_link("session %d task %d batch %d pending %d running %d\n",
+		     mpp_task->session->index, mpp_task->task_index, *batch_num,
 		     atomic_read(&link_dec->task_pending), link_dec->task_running);
 	mpp_debug_leave();
 
@@ -1270,6 +1337,8 @@ int rkvdec2_link_process_task(struct mpp_session *session,
 		mpp_err("alloc_task failed.\n");
 		return -ENOMEM;
 	}
+	/* link tasks sit in the hardware queue together, each holds its rcb */
+	mpp_set_rcbbuf(mpp, session, task);
 
 	if (link_info->hack_setup) {
 		u32 fmt;
@@ -1286,8 +1355,14 @@ int rkvdec2_link_process_task(struct mpp_session *session,
 	atomic_set(&task->abort_request, 0);
 	task->task_index = atomic_fetch_inc(&mpp->task_index);
 	task->task_id = atomic_fetch_inc(&mpp->queue->task_id);
+	task->seq = atomic_fetch_inc(&session->task_seq);
 	INIT_DELAYED_WORK(&task->timeout_work, rkvdec2_link_timeout_proc);
 
+	if (mpp_task_attach_fence(task, msgs)) {
+		rkvdec2_free_task(session, task);
+		return -EINVAL;
+	}
+
 	atomic_inc(&session->task_count);
 
 	kref_get(&task->ref);
@@ -1299,6 +1374,7 @@ int rkvdec2_link_process_task(struct mpp_session *session,
 	mutex_lock(&mpp->queue->pending_lock);
 	list_add_tail(&task->queue_link, &mpp->queue->pending_list);
 	mutex_unlock(&mpp->queue->pending_lock);
+	trace_mpp_task_submit(task);
 	atomic_inc(&link_dec->task_pending);
 
 	/* push current task to queue */
@@ -1327,6 +1403,7 @@ int rkvdec2_link_wait_result(struct mpp_session *session,
 	ret = wait_event_interruptible(mpp_task->wait, task_is_done(mpp_task));
 	if (ret == -ERESTARTSYS)
 		mpp_err("wait task break by signal\n");
+	trace_mpp_task_wake(mpp_task);
 
 	ret = rkvdec2_result(mpp, mpp_task, msgs);
 
@@ -1339,11 +1416,34 @@ int rkvdec2_link_wait_result(struct mpp_session *session,
 	return ret;
 }
 
+static void rkvdec2_link_update_depth(struct mpp_dev *mpp)
+{
+	struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
+	struct rkvdec_link_dev *link_dec = dec->link_dec;
+	struct mpp_taskqueue *queue = mpp->queue;
+	struct mpp_session *session;
+	u32 depth = 0;
+
+	mutex_lock(&queue->session_lock);
+	list_for_each_entry(session, &queue->session_attach, session_link)
+		depth += RKVDEC_LINK_SESSION_DEPTH;
+	mutex_unlock(&queue->session_lock);
+
+	depth = clamp(depth, mpp->task_capacity, link_dec->task_capacity);
+	if (depth != link_dec->task_depth)
+		mpp_dbg_link("link depth %d -> %d\n", link_dec->task_depth, depth);
+	link_dec->task_depth = depth;
+}
+
 void rkvdec2_link_worker(struct kthread_work *work_s)
 {
 	struct mpp_dev *mpp = container_of(work_s, struct mpp_dev, work);
+	struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
+	struct rkvdec_link_dev *link_dec = dec->link_dec;
 	struct mpp_task *task;
 	struct mpp_taskqueue *queue = mpp->queue;
+	struct mpp_task *batch[RKVDEC_LINK_BATCH_MAX];
+	u32 batch_num = 0;
 	u32 all_done;
 
 	mpp_debug_enter();
@@ -1359,6 +1459,8 @@ void rkvdec2_link_worker(struct kthread_work *work_s)
 			rkvdec2_link_resend(mpp);
 	}
 
+	rkvdec2_link_update_depth(mpp);
+
 again:
 	/* get pending task to process */
 	mutex_lock(&queue->pending_lock);
@@ -1382,11 +1484,20 @@ void rkvdec2_link_worker(struct kthread_work *work_s)
 		goto again;
 	}
 
+	/* hardware runs in order, wait the head task in fence signal */
+	if (!mpp_task_fence_ready(task))
+		goto done;
+
+	/* batch is full, send to hw and keep on refilling */
+	if (batch_num == RKVDEC_LINK_BATCH_MAX)
+		rkvdec2_link_send(link_dec, batch, &batch_num);
+
 	/* queue task to hw */
-	if (!mpp_task_queue(mpp, task))
+	if (!mpp_task_queue(mpp, task, batch, &batch_num))
 		goto again;
 
 done:
+	rkvdec2_link_send(link_dec, batch, &batch_num);
 
 	/* if no task in pending and running list, power off device */
 	mutex_lock(&queue->pending_lock);
@@ -1649,6 +1760,7 @@ static int rkvdec2_soft_ccu_dequeue(struct mpp_taskqueue *queue)
 			cancel_delayed_work(&mpp_task->timeout_work);
 			mpp_task->hw_cycles = mpp_read(mpp, RKVDEC_PERF_WORKING_CNT);
 			mpp_time_diff_with_hw_time(mpp_task, dec->cycle_clk->real_rate_hz);
+			mpp_core_load_account(mpp, mpp_task);
 			task->irq_status = irq_status;
 			mpp_debug(DEBUG_IRQ_CHECK, "irq_status=%08x, timeout=%u, abort=%u\n",
 				  irq_status, timeout_flag, abort_flag);
@@ -1662,6 +1774,7 @@ static int rkvdec2_soft_ccu_dequeue(struct mpp_taskqueue *queue)
 
 			set_bit(mpp->core_id, &queue->core_idle);
 			mpp_dbg_core("set core %d idle %lx\n", mpp->core_id, queue->core_idle);
+			mpp_session_post_done(mpp_task->session, mpp_task);
 			/* Wake up the GET thread */
 			wake_up(&mpp_task->wait);
 			/* free task */
@@ -1677,20 +1790,43 @@ static int rkvdec2_soft_ccu_dequeue(struct mpp_taskqueue *queue)
 	return 0;
 }
 
+static void rkvdec2_ccu_reset_account(struct rkvdec2_dev *dec, ktime_t start)
+{
+	u32 us = (u32)ktime_us_delta(ktime_get(), start);
+
+	dec->reset_count++;
+	dec->reset_last_us = us;
+	if (us > dec->reset_max_us)
+		dec->reset_max_us = us;
+}
+
+/*
+ * Only the cores which reported an error or timeout are reset, each one as
+ * soon as its own task is dequeued. The other cores keep decoding and take
+ * new tasks meanwhile, so one corrupt stream does not stall every channel.
+ */
 static int rkvdec2_soft_ccu_reset(struct mpp_taskqueue *queue,
 				  struct rkvdec2_ccu *ccu)
 {
+	bool pending = false;
 	int i;
 
 	for (i = queue->core_count - 1; i >= 0; i--) {
 		u32 val;
+		ktime_t start;
 
 		struct mpp_dev *mpp = queue->cores[i];
 		struct rkvdec2_dev *dec = to_rkvdec2_dev(mpp);
 
-		if (mpp->disable)
+		if (mpp->disable || !atomic_read(&mpp->reset_request))
 			continue;
+		/* the faulting task is still on the core */
+		if (!test_bit(i, &queue->core_idle)) {
+			pending = true;
+			continue;
+		}
 
+		start = ktime_get();
 		dev_info(mpp->dev, "resetting for err %#x\n", mpp->irq_status);
 		disable_hardirq(mpp->irq);
 
@@ -1728,9 +1864,11 @@ static int rkvdec2_soft_ccu_reset(struct mpp_taskqueue *queue,
 		atomic_set(&mpp->reset_request, 0);
 
 		enable_irq(mpp->irq);
-		dev_info(mpp->dev, "reset done\n");
+		rkvdec2_ccu_reset_account(dec, start);
+		dev_info(mpp->dev, "reset done in %u us\n", dec->reset_last_us);
 	}
-	atomic_set(&queue->reset_request, 0);
+	if (!pending)
+		atomic_set(&queue->reset_request, 0);
 
 	return 0;
 }
@@ -1812,6 +1950,7 @@ int rkvdec2_soft_ccu_iommu_fault_handle(struct iommu_domain *iommu,
 	if (mpp_task)
 		mpp_task_dump_mem_region(mpp, mpp_task);
 
+	atomic_inc(&mpp->reset_request);
 	atomic_inc(&mpp->queue->reset_request);
 	kthread_queue_work(&mpp->queue->worker, &mpp->work);
 
@@ -1959,26 +2098,21 @@ static int rkvdec2_soft_ccu_enqueue(struct mpp_dev *mpp, struct mpp_task *mpp_ta
 static struct mpp_dev *rkvdec2_get_idle_core(struct mpp_taskqueue *queue,
 					     struct mpp_task *mpp_task)
 {
-	u32 i = 0;
 	struct rkvdec2_dev *dec = NULL;
+	unsigned long core_idle = queue->core_idle;
+	s32 core_id;
+	u32 i;
 
-	for (i = 0; i < queue->core_count; i++) {
-		struct mpp_dev *mpp = queue->cores[i];
-		struct rkvdec2_dev *core = to_rkvdec2_dev(mpp);
+	/* a core waiting for its error reset takes no new task */
+	for (i = 0; i < queue->core_count; i++)
+		if (atomic_read(&queue->cores[i]->reset_request))
+			clear_bit(i, &core_idle);
 
-		if (mpp->disable)
-			continue;
+	/* set the idle core with the lowest recent hardware load */
+	core_id = mpp_taskqueue_get_idle_core(queue, core_idle);
+	if (core_id >= 0)
+		dec = to_rkvdec2_dev(queue->cores[core_id]);
 
-		if (test_bit(i, &queue->core_idle)) {
-			if (!dec) {
-				dec = core;
-				continue;
-			}
-			/* set the less work core */
-			if (core->task_index < dec->task_index)
-				dec = core;
-		}
-	}
 	/* if get core */
 	if (dec) {
 		mpp_task->mpp = &dec->mpp;
@@ -1993,23 +2127,21 @@ static struct mpp_dev *rkvdec2_get_idle_core(struct mpp_taskqueue *queue,
 	return NULL;
 }
 
-static bool rkvdec2_core_working(struct mpp_taskqueue *queue)
+static bool rkvdec2_core_reset_pending(struct mpp_taskqueue *queue)
 {
 	struct mpp_dev *mpp;
-	bool flag = false;
 	u32 i = 0;
 
+	if (atomic_read(&queue->reset_request))
+		return true;
+
 	for (i = 0; i < queue->core_count; i++) {
 		mpp = queue->cores[i];
-		if (mpp->disable)
-			continue;
-		if (!test_bit(i, &queue->core_idle)) {
-			flag = true;
-			break;
-		}
+		if (!mpp->disable && atomic_read(&mpp->reset_request))
+			return true;
 	}
 
-	return flag;
+	return false;
 }
 
 void rkvdec2_soft_ccu_worker(struct kthread_work *work_s)
@@ -2025,23 +2157,16 @@ void rkvdec2_soft_ccu_worker(struct kthread_work *work_s)
 	/* 1. process all finished task in running list */
 	rkvdec2_soft_ccu_dequeue(queue);
 
-	/* 2. process reset request */
-	if (atomic_read(&queue->reset_request)) {
-		if (!rkvdec2_core_working(queue)) {
-			rkvdec2_ccu_power_on(queue, dec->ccu);
-			rkvdec2_soft_ccu_reset(queue, dec->ccu);
-		}
+	/* 2. reset the faulting cores, the others keep running */
+	if (rkvdec2_core_reset_pending(queue)) {
+		rkvdec2_ccu_power_on(queue, dec->ccu);
+		rkvdec2_soft_ccu_reset(queue, dec->ccu);
 	}
 
 	/* 3. process pending task */
 	while (1) {
-		if (atomic_read(&queue->reset_request))
-			break;
 		/* get one task form pending list */
-		mutex_lock(&queue->pending_lock);
-		mpp_task = list_first_entry_or_null(&queue->pending_list,
-						struct mpp_task, queue_link);
-		mutex_unlock(&queue->pending_lock);
+		mpp_task = mpp_taskqueue_get_pending_task(queue);
 		if (!mpp_task)
 			break;
 
@@ -2263,6 +2388,7 @@ static int rkvdec2_hard_ccu_dequeue(struct mpp_taskqueue *queue,
 			list_move_tail(&task->table->link, &ccu->unused_list);
 			/* free task */
 			list_del_init(&mpp_task->queue_link);
+			mpp_session_post_done(mpp_task->session, mpp_task);
 			/* Wake up the GET thread */
 			wake_up(&mpp_task->wait);
 			if ((irq_status & hw->err_mask) || timeout_flag) {
@@ -2291,6 +2417,7 @@ static int rkvdec2_hard_ccu_dequeue(struct mpp_taskqueue *queue,
 
 static int rkvdec2_hard_ccu_reset(struct mpp_taskqueue *queue, struct rkvdec2_ccu *ccu)
 {
+	ktime_t start = ktime_get();
 	u32 i = 0;
 
 	mpp_debug_enter();
@@ -2341,6 +2468,11 @@ static int rkvdec2_hard_ccu_reset(struct mpp_taskqueue *queue, struct rkvdec2_cc
 	udelay(5);
 	mpp_safe_unreset(ccu->rst_a);
 
+	/* the hardware ccu sequences all cores, every core took the stall */
+	for (i = 0; i < queue->core_count; i++)
+		if (!queue->cores[i]->disable)
+			rkvdec2_ccu_reset_account(to_rkvdec2_dev(queue->cores[i]), start);
+
 	mpp_debug_leave();
 	return 0;
 }
@@ -2631,6 +2763,8 @@ void rkvdec2_hard_ccu_worker(struct kthread_work *work_s)
 			kref_put(&mpp_task->ref, mpp_free_task);
 			continue;
 		}
+		if (!mpp_task_fence_ready(mpp_task))
+			break;
 
 		mpp_task = rkvdec2_hard_ccu_prepare(mpp_task, dec->ccu, dec->link_dec->info);
 		if (!mpp_task)
@@ -48,6 +48,16 @@
 #define RKVDEC_LINK_EN_BASE		0x018
 #define RKVDEC_LINK_BIT_EN		BIT(0)
 
+/*
+ * link table is allocated with RKVDEC_LINK_MAX_CAPACITY nodes and the active
+ * depth grows by RKVDEC_LINK_SESSION_DEPTH for each attached session, starting
+ * from the dts task capacity. At most RKVDEC_LINK_BATCH_MAX nodes are committed
+ * to hardware by one link config.
+ */
+#define RKVDEC_LINK_MAX_CAPACITY	32
+#define RKVDEC_LINK_SESSION_DEPTH	2
+#define RKVDEC_LINK_BATCH_MAX		8
+
 /* define for ccu link hardware */
 #define RKVDEC_CCU_CTRL_BASE		0x000
 #define RKVDEC_CCU_BIT_AUTOGATE		BIT(0)
@@ -177,8 +187,17 @@ struct rkvdec_link_dev {
 	u64 stuff_cycle_sum;
 	u32 stuff_cnt;
 
+	/* link occupancy statistic */
+	u64 occupancy_sum;
+	u32 occupancy_cnt;
+	u32 occupancy_max;
+	u32 batch_max;
+	u32 full_cnt;
+
 	/* link info */
 	u32 task_capacity;
+	/* active link depth, no more than task_capacity */
+	u32 task_depth;
 	struct mpp_dma_buffer *table_array;
 	struct list_head unused_list;
 	struct list_head used_list;
@@ -32,10 +32,12 @@
 #include <soc/rockchip/rockchip_opp_select.h>
 #include <soc/rockchip/rockchip_system_monitor.h>
 #include <soc/rockchip/rockchip_iommu.h>
+#include <soc/rockchip/rockchip_dvbm.h>
 
 #include "mpp_debug.h"
 #include "mpp_iommu.h"
 #include "mpp_common.h"
+#include "mpp_trace.h"
 
 #define RKVENC_DRIVER_NAME			"mpp_rkvenc2"
 
@@ -260,6 +262,9 @@ struct rkvenc_task {
 
 	union rkvenc2_dual_core_handshake_id dchs_id;
 
+	/* first half of a frame split across two cores */
+	u32 split_pair;
+
 	/* split output / slice mode info */
 	u32 task_split;
 	u32 task_split_done;
@@ -276,11 +281,6 @@ struct rkvenc_task {
 
 #define RKVENC_MAX_RCB_NUM		(4)
 
-struct rcb_info_elem {
-	u32 index;
-	u32 size;
-};
-
 struct rkvenc2_rcb_info {
 	u32 cnt;
 	struct rcb_info_elem elem[RKVENC_MAX_RCB_NUM];
@@ -318,6 +318,8 @@ struct rkvenc_dev {
 	struct list_head core_link;
 
 	/* internal rcb-memory */
+	struct gen_pool *sram_pool;
+	phys_addr_t sram_start;
 	u32 sram_size;
 	u32 sram_used;
 	dma_addr_t sram_iova;
@@ -326,6 +328,12 @@ struct rkvenc_dev {
 
 	u32 bs_overflow;
 
+	/* online input from isp wrap buffer by dvbm */
+	struct dvbm_port *dvbm_port;
+	struct dvbm_isp_frm_info dvbm_frm;
+	u32 dvbm_frm_start;
+	u32 dvbm_frm_end;
+
 #ifdef CONFIG_PM_DEVFREQ
 	struct rockchip_opp_info opp_info;
 	struct monitor_dev_info *mdev_info;
@@ -940,9 +948,18 @@ static int rkvenc2_set_rcbbuf(struct mpp_dev *mpp, struct mpp_session *session,
 		u32 *reg;
 		u32 reg_idx, rcb_size, rcb_offset;
 		struct rkvenc2_rcb_info *rcb_inf = &priv->rcb_inf;
+		struct mpp_rcb_grant *grant = &task->mpp_task.rcb_grant;
+		u32 cnt = rcb_inf->cnt;
 
 		rcb_offset = 0;
-		for (i = 0; i < rcb_inf->cnt; i++) {
+		/* shared sram, only the part claimed for this task is used */
+		if (enc->sram_pool) {
+			cnt = mpp_rcb_sram_claim(enc->sram_pool, enc->sram_start,
+						 enc->sram_size, rcb_inf->elem, cnt, grant);
+			if (cnt)
+				rcb_offset = grant->addr - enc->sram_start;
+		}
+		for (i = 0; i < cnt; i++) {
 			reg_idx = rcb_inf->elem[i].index;
 			rcb_size = rcb_inf->elem[i].size;
 
@@ -1061,6 +1078,11 @@ static void *rkvenc_alloc_task(struct mpp_session *session,
 	ret = rkvenc_task_get_format(mpp, task);
 	if (ret)
 		goto free_task;
+	if (msgs->flags & MPP_FLAGS_SPLIT_PAIR) {
+		struct rkvenc_dev *enc = to_rkvenc_dev(mpp);
+
+		task->split_pair = enc->ccu && enc->ccu->core_num > 1;
+	}
 	/* process fd in register */
 	if (!(msgs->flags & MPP_FLAGS_REG_FD_NO_TRANS)) {
 		u32 i, j;
@@ -1140,30 +1162,51 @@ static void *rkvenc_alloc_task(struct mpp_session *session,
 	return NULL;
 }
 
+/* the second half of a split frame, once it is queued and ready to run */
+static struct mpp_task *rkvenc2_get_pair_task(struct mpp_taskqueue *queue,
+					      struct mpp_task *mpp_task)
+{
+	struct mpp_task *loop, *pair = NULL;
+
+	mutex_lock(&queue->pending_lock);
+	loop = mpp_task;
+	list_for_each_entry_continue(loop, &queue->pending_list, queue_link) {
+		if (loop->session != mpp_task->session)
+			continue;
+		if (mpp_task_fence_ready(loop))
+			pair = loop;
+		break;
+	}
+	mutex_unlock(&queue->pending_lock);
+
+	return pair;
+}
+
 static void *rkvenc2_prepare(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 {
 	struct mpp_taskqueue *queue = mpp->queue;
+	struct mpp_task *pair = NULL;
 	unsigned long core_idle;
 	unsigned long flags;
-	u32 core_id_max;
 	s32 core_id;
-	u32 i;
+
+	/* both halves of a split frame start together, or not at all */
+	if (to_rkvenc_task(mpp_task)->split_pair) {
+		pair = rkvenc2_get_pair_task(queue, mpp_task);
+		if (!pair)
+			return NULL;
+	}
 
 	spin_lock_irqsave(&queue->running_lock, flags);
 
 	core_idle = queue->core_idle;
-	core_id_max = queue->core_id_max;
-
-	for (i = 0; i <= core_id_max; i++) {
-		struct mpp_dev *mpp = queue->cores[i];
+	/* pick the idle core with the lowest load instead of the first one */
+	core_id = mpp_taskqueue_get_idle_core(queue, core_idle);
+	if (core_id >= 0 && pair &&
+	    mpp_taskqueue_get_idle_core(queue, core_idle & ~BIT(core_id)) < 0)
+		core_id = -1;
 
-		if (mpp && mpp->disable)
-			clear_bit(i, &core_idle);
-	}
-
-	core_id = find_first_bit(&core_idle, core_id_max + 1);
-
-	if (core_id >= core_id_max + 1 || !queue->cores[core_id]) {
+	if (core_id < 0) {
 		mpp_task = NULL;
 		mpp_dbg_core("core %d all busy %lx\n", core_id, core_idle);
 	} else {
@@ -1179,6 +1222,13 @@ static void *rkvenc2_prepare(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 
 	spin_unlock_irqrestore(&queue->running_lock, flags);
 
+	/* the worker takes the second half next, onto the other idle core */
+	if (mpp_task && pair) {
+		mutex_lock(&queue->pending_lock);
+		queue->next_task = pair;
+		mutex_unlock(&queue->pending_lock);
+	}
+
 	return mpp_task;
 }
 
@@ -1513,6 +1563,10 @@ static void rkvenc2_read_slice_len(struct mpp_dev *mpp, struct rkvenc_task *task
 				slice_info.last ? "last" : "");
 
 			kfifo_in(&task->slice_info, &slice_info, 1);
+			/* notify the session poller before the frame done */
+			mpp_session_post_slice(task->mpp_task.session, &task->mpp_task,
+					       task->slice_wr_cnt, slice_info.slice_len,
+					       slice_info.last);
 			task->slice_wr_cnt++;
 		}
 	}
@@ -1524,6 +1578,8 @@ static void rkvenc2_read_slice_len(struct mpp_dev *mpp, struct rkvenc_task *task
 			slice_info.last = 1;
 			slice_info.slice_len = 0;
 			kfifo_in(&task->slice_info, &slice_info, 1);
+			mpp_session_post_slice(task->mpp_task.session, &task->mpp_task,
+					       task->slice_wr_cnt, 0, true);
 		}
 	}
 
@@ -1714,6 +1770,10 @@ static int rkvenc_isr(struct mpp_dev *mpp)
 	if (task->irq_status & enc->hw_info->err_mask) {
 		atomic_inc(&mpp->reset_request);
 
+		/* online input lost sync with isp, restart from next isp frame */
+		if (enc->dvbm_port)
+			rk_dvbm_ctrl(enc->dvbm_port, DVBM_VEPU_SET_RESYNC, NULL);
+
 		/* dump register */
 		if (mpp_debug_unlikely(DEBUG_DUMP_ERR_REG))
 			mpp_task_dump_hw_reg(mpp);
@@ -1740,6 +1800,9 @@ static int rkvenc_finish(struct mpp_dev *mpp, struct mpp_task *mpp_task)
 
 	mpp_debug_enter();
 
+	/* hardware is done with the rcb, hand the sram back */
+	mpp_rcb_sram_release(&mpp_task->rcb_grant);
+
 	for (i = 0; i < task->r_req_cnt; i++) {
 		int ret;
 		int s, e;
@@ -1961,6 +2024,18 @@ static int rkvenc_show_session_info(struct seq_file *seq, void *offset)
 	return 0;
 }
 
+static int rkvenc2_show_dvbm(struct seq_file *seq, void *offset)
+{
+	struct rkvenc_dev *enc = seq->private;
+	struct dvbm_isp_frm_info *frm = &enc->dvbm_frm;
+
+	seq_printf(seq, "frame %u line %u/%u wrap %u start %u end %u\n",
+		   frm->frame_cnt, frm->line_cnt, frm->max_line_cnt,
+		   frm->wrap_line, enc->dvbm_frm_start, enc->dvbm_frm_end);
+
+	return 0;
+}
+
 static int rkvenc_procfs_init(struct mpp_dev *mpp)
 {
 	struct rkvenc_dev *enc = to_rkvenc_dev(mpp);
@@ -1993,6 +2068,9 @@ static int rkvenc_procfs_init(struct mpp_dev *mpp)
 	/* for show session info */
 	proc_create_single_data("sessions-info", 0444,
 				enc->procfs, rkvenc_show_session_info, mpp);
+	if (enc->dvbm_port)
+		proc_create_single_data("dvbm", 0444,
+					enc->procfs, rkvenc2_show_dvbm, enc);
 
 	return 0;
 }
@@ -2352,6 +2430,7 @@ static int rkvenc2_wait_result(struct mpp_session *session,
 		ret = wait_event_interruptible(task->wait, test_bit(TASK_STATE_DONE, &task->state));
 		if (ret == -ERESTARTSYS)
 			mpp_err("wait task break by signal in normal mode\n");
+		trace_mpp_task_wake(task);
 
 		return rkvenc2_task_default_process(mpp, task);
 
@@ -2724,10 +2803,15 @@ static int rkvenc2_alloc_rcbbuf(struct platform_device *pdev, struct rkvenc_dev
 		enc->rcb_page = page;
 	}
 
+	enc->sram_start = sram_start;
 	enc->sram_size = sram_size;
 	enc->sram_used = sram_used;
 	enc->sram_iova = iova;
 	enc->sram_enabled = -1;
+	/* sram managed by a pool is shared with other ips, claim it per task */
+	enc->sram_pool = of_gen_pool_get(dev->of_node, "rockchip,sram", 0);
+	if (enc->sram_pool)
+		dev_info(dev, "sram shared by pool\n");
 	dev_info(dev, "sram_start %pa\n", &sram_start);
 	dev_info(dev, "sram_iova %pad\n", &enc->sram_iova);
 	dev_info(dev, "sram_size %u\n", enc->sram_size);
@@ -2778,6 +2862,78 @@ static int rkvenc2_iommu_fault_handle(struct iommu_domain *iommu,
 	return 0;
 }
 
+/* isp progress on the wrap buffer, called from isp irq with dvbm locked */
+static int rkvenc2_dvbm_callback(void *ctx, enum dvbm_cb_event event, void *arg)
+{
+	struct rkvenc_dev *enc = ctx;
+
+	switch (event) {
+	case DVBM_VEPU_NOTIFY_FRM_STR: {
+		struct dvbm_addr_cfg *addr = arg;
+
+		enc->dvbm_frm.frame_cnt = addr->frame_id;
+		enc->dvbm_frm.line_cnt = 0;
+		enc->dvbm_frm_start++;
+	} break;
+	case DVBM_VEPU_NOTIFY_FRM_INFO: {
+		enc->dvbm_frm = *(struct dvbm_isp_frm_info *)arg;
+	} break;
+	case DVBM_VEPU_NOTIFY_FRM_END: {
+		enc->dvbm_frm = *(struct dvbm_isp_frm_info *)arg;
+		enc->dvbm_frm_end++;
+	} break;
+	default:
+		break;
+	}
+	mpp_debug(DEBUG_IRQ_STATUS, "dvbm event %#x frame %d line %d\n", event,
+		  enc->dvbm_frm.frame_cnt, enc->dvbm_frm.line_cnt);
+
+	return 0;
+}
+
+static void rkvenc2_dvbm_get(struct platform_device *pdev, struct rkvenc_dev *enc)
+{
+	struct device_node *np_dvbm = of_parse_phandle(pdev->dev.of_node, "dvbm", 0);
+	struct platform_device *p_dvbm;
+	struct dvbm_port *port;
+	struct dvbm_cb cb;
+
+	if (!np_dvbm)
+		return;
+
+	if (!of_device_is_available(np_dvbm))
+		goto done;
+
+	p_dvbm = of_find_device_by_node(np_dvbm);
+	port = rk_dvbm_get_port(p_dvbm, DVBM_VEPU_PORT);
+	if (p_dvbm)
+		put_device(&p_dvbm->dev);
+	if (IS_ERR(port)) {
+		dev_warn(&pdev->dev, "dvbm port is not ready %ld\n", PTR_ERR(port));
+		goto done;
+	}
+
+	cb.cb = rkvenc2_dvbm_callback;
+	cb.ctx = enc;
+	cb.event = 0;
+	rk_dvbm_set_cb(port, &cb);
+	rk_dvbm_link(port);
+	enc->dvbm_port = port;
+	dev_info(&pdev->dev, "online mode by dvbm enabled\n");
+done:
+	of_node_put(np_dvbm);
+}
+
+static void rkvenc2_dvbm_put(struct rkvenc_dev *enc)
+{
+	if (!enc->dvbm_port)
+		return;
+
+	rk_dvbm_unlink(enc->dvbm_port);
+	rk_dvbm_put(enc->dvbm_port);
+	enc->dvbm_port = NULL;
+}
+
 static int rkvenc_core_probe(struct platform_device *pdev)
 {
 	int ret = 0;
@@ -2875,6 +3031,7 @@ static int rkvenc_probe_default(struct platform_device *pdev)
 	}
 	mpp->session_max_buffers = RKVENC_SESSION_MAX_BUFFERS;
 	enc->hw_info = to_rkvenc_info(mpp->var->hw_info);
+	rkvenc2_dvbm_get(pdev, enc);
 	rkvenc_procfs_init(mpp);
 	mpp_dev_register_srv(mpp, mpp->srv);
 
@@ -2950,6 +3107,7 @@ static int rkvenc_remove(struct platform_device *pdev)
 		struct rkvenc_dev *enc = to_rkvenc_dev(mpp);
 
 		dev_info(dev, "remove device\n");
+		rkvenc2_dvbm_put(enc);
 		rkvenc2_free_rcbbuf(pdev, enc);
 		mpp_dev_remove(mpp);
 		rkvenc_procfs_remove(mpp);
@@ -222,6 +222,9 @@ static int mpp_dump_session(struct mpp_session *session, struct seq_file *s)
 	seq_printf(s, "session: pid=%d index=%d\n", session->pid, session->index);
 	seq_printf(s, " device: %s\n", dev_name(session->mpp->dev));
 	seq_printf(s, " memory: %lu MiB\n", K(K(t)));
+	seq_printf(s, "  cache: buffers %d/%u hit %u miss %u evict %u\n",
+		   dma->buffer_count, dma->max_buffers, dma->cache_hit,
+		   dma->cache_miss, dma->cache_evict);
 
 	return 0;
 }
@@ -254,6 +257,33 @@ static int mpp_show_session_summary(struct seq_file *seq, void *offset)
 	return 0;
 }
 
+static int mpp_show_taskqueue_switch(struct seq_file *seq, void *offset)
+{
+	struct mpp_service *srv = seq->private;
+	u32 i;
+
+	for (i = 0; i < srv->taskqueue_cnt; i++) {
+		struct mpp_taskqueue *queue = srv->task_queues[i];
+		u64 run_cnt, switch_cnt;
+		s64 ms;
+
+		if (!queue)
+			continue;
+
+		mutex_lock(&queue->pending_lock);
+		run_cnt = queue->run_cnt;
+		switch_cnt = queue->switch_cnt;
+		ms = ktime_ms_delta(ktime_get(), queue->stat_start);
+		mutex_unlock(&queue->pending_lock);
+
+		seq_printf(seq, "taskqueue %u: runs %llu switches %llu switches/s %llu\n",
+			   i, run_cnt, switch_cnt,
+			   ms > 0 ? div64_u64(switch_cnt * MSEC_PER_SEC, ms) : 0);
+	}
+
+	return 0;
+}
+
 static int mpp_show_support_cmd(struct seq_file *file, void *v)
 {
 	seq_puts(file, "------------- SUPPORT CMD -------------\n");
@@ -269,6 +299,9 @@ static int mpp_show_support_cmd(struct seq_file *file, void *v)
 	seq_printf(file, "SET_REG_WRITE:        0x%08x\n", MPP_CMD_SET_REG_WRITE);
 	seq_printf(file, "SET_REG_READ:         0x%08x\n", MPP_CMD_SET_REG_READ);
 	seq_printf(file, "SET_REG_ADDR_OFFSET:  0x%08x\n", MPP_CMD_SET_REG_ADDR_OFFSET);
+	seq_printf(file, "SET_TASK_SPLIT:       0x%08x\n", MPP_CMD_SET_TASK_SPLIT);
+	seq_printf(file, "SET_IN_FENCE:         0x%08x\n", MPP_CMD_SET_IN_FENCE);
+	seq_printf(file, "SET_OUT_FENCE:        0x%08x\n", MPP_CMD_SET_OUT_FENCE);
 	seq_printf(file, "SEND_BUTT:            0x%08x\n", MPP_CMD_SEND_BUTT);
 	seq_puts(file, "----\n");
 	seq_printf(file, "POLL_HW_FINISH:       0x%08x\n", MPP_CMD_POLL_HW_FINISH);
@@ -278,6 +311,7 @@ static int mpp_show_support_cmd(struct seq_file *file, void *v)
 	seq_printf(file, "TRANS_FD_TO_IOVA:     0x%08x\n", MPP_CMD_TRANS_FD_TO_IOVA);
 	seq_printf(file, "RELEASE_FD:           0x%08x\n", MPP_CMD_RELEASE_FD);
 	seq_printf(file, "SEND_CODEC_INFO:      0x%08x\n", MPP_CMD_SEND_CODEC_INFO);
+	seq_printf(file, "SET_SESSION_QOS:      0x%08x\n", MPP_CMD_SET_SESSION_QOS);
 	seq_printf(file, "CONTROL_BUTT:         0x%08x\n", MPP_CMD_CONTROL_BUTT);
 
 	return 0;
@@ -328,6 +362,10 @@ static int mpp_procfs_init(struct mpp_service *srv)
 	proc_create_single_data("supports-device", 0444,
 				srv->procfs, mpp_show_support_device, srv);
 	mpp_procfs_create_u32("timing_en", 0644, srv->procfs, &srv->timing_en);
+	mpp_procfs_create_u32("qos_starve_ms", 0644, srv->procfs, &srv->qos_starve_ms);
+	mpp_procfs_create_u32("grf_batch", 0644, srv->procfs, &srv->grf_batch);
+	proc_create_single_data("taskqueue-switch", 0444,
+				srv->procfs, mpp_show_taskqueue_switch, srv);
 
 	return 0;
 }
@@ -358,6 +396,8 @@ static int mpp_service_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	srv->dev = dev;
+	srv->qos_starve_ms = MPP_QOS_STARVE_MS;
+	srv->grf_batch = MPP_GRF_BATCH;
 	atomic_set(&srv->shutdown_request, 0);
 	platform_set_drvdata(pdev, srv);
 
@@ -378,6 +418,8 @@ static int mpp_service_probe(struct platform_device *pdev)
 		if (!queue)
 			continue;
 
+		queue->srv = srv;
+
 		kthread_init_worker(&queue->worker);
 		queue->kworker_task = kthread_run(kthread_worker_fn, &queue->worker,
 						  "mpp_worker_%d", i);
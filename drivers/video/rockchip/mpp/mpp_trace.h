@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: (GPL-2.0+ OR MIT) */
+/*
+ * Copyright (c) 2023 Rockchip Electronics Co., Ltd
+ *
+ * Task timeline tracepoints for mpp service
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mpp
+
+#if !defined(__ROCKCHIP_MPP_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __ROCKCHIP_MPP_TRACE_H__
+
+#include <linux/tracepoint.h>
+
+#include "mpp_common.h"
+
+DECLARE_EVENT_CLASS(mpp_task,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(mpp_get_task_used_device(task, task->session)->dev))
+		__field(pid_t, pid)
+		__field(u32, session)
+		__field(u32, task_id)
+		__field(s32, core_id)
+		__field(u32, hw_cycles)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(mpp_get_task_used_device(task, task->session)->dev));
+		__entry->pid = task->session->pid;
+		__entry->session = task->session->index;
+		__entry->task_id = task->task_id;
+		__entry->core_id = task->core_id;
+		__entry->hw_cycles = task->hw_cycles;
+	),
+
+	TP_printk("%s pid=%d session=%u task=%u core=%d hw_cycles=%u",
+		  __get_str(dev), __entry->pid, __entry->session,
+		  __entry->task_id, __entry->core_id, __entry->hw_cycles)
+);
+
+/* task pushed to taskqueue pending list */
+DEFINE_EVENT(mpp_task, mpp_task_submit,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task)
+);
+
+/* task moved from pending list to running list */
+DEFINE_EVENT(mpp_task, mpp_task_run,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task)
+);
+
+/* registers configured and hardware started */
+DEFINE_EVENT(mpp_task, mpp_task_hw_start,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task)
+);
+
+/* hardware irq of the task received */
+DEFINE_EVENT(mpp_task, mpp_task_irq,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task)
+);
+
+/* task result read back and task marked done */
+DEFINE_EVENT(mpp_task, mpp_task_finish,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task)
+);
+
+/* userspace waiter woken up for the task */
+DEFINE_EVENT(mpp_task, mpp_task_wake,
+	TP_PROTO(struct mpp_task *task),
+	TP_ARGS(task)
+);
+
+#endif /* __ROCKCHIP_MPP_TRACE_H__ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mpp_trace
+
+#include <trace/define_trace.h>
@@ -9,6 +9,8 @@
 #include <asm/cacheflush.h>
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/dma-buf.h>
+#include <linux/file.h>
 #include <linux/iopoll.h>
 #include <linux/interrupt.h>
 #include <linux/module.h>
@@ -18,6 +20,7 @@
 #include <linux/uaccess.h>
 #include <linux/regmap.h>
 #include <linux/proc_fs.h>
+#include <linux/rk-dma-heap.h>
 #include <soc/rockchip/pm_domains.h>
 
 #include "mpp_debug.h"
@@ -77,6 +80,12 @@ struct vdpp_task {
 	struct mpp_request r_reqs[MPP_MAX_MSG_NUM];
 };
 
+struct vdpp_session_priv {
+	/* output pool, see MPP_CMD_INIT_OUT_POOL */
+	u32 pool_count;
+	u32 pool_size;
+};
+
 struct vdpp_dev {
 	struct mpp_dev mpp;
 	struct vdpp_hw_info *hw_info;
@@ -482,6 +491,133 @@ static int vdpp_free_task(struct mpp_session *session,
 	return 0;
 }
 
+static int vdpp_init_out_pool(struct mpp_session *session,
+			      struct mpp_request *req)
+{
+	struct vdpp_session_priv *priv = session->priv;
+	struct mpp_dev *mpp = session->mpp;
+	struct dma_buf *bufs[MPP_OUT_POOL_MAX_COUNT] = { NULL };
+	struct mpp_dma_buffer *buffer;
+	struct mpp_out_pool pool;
+	struct rk_dma_heap *heap;
+	int ret = 0;
+	u32 i;
+
+	if (req->size < sizeof(pool))
+		return -EINVAL;
+	if (copy_from_user(&pool, req->data, sizeof(pool)))
+		return -EFAULT;
+	if (!pool.count || pool.count > MPP_OUT_POOL_MAX_COUNT || !pool.size)
+		return -EINVAL;
+	if (priv->pool_count)
+		return -EBUSY;
+
+	heap = rk_dma_heap_find("rk-dma-heap-cma");
+	if (!heap) {
+		mpp_err("no reserved heap for the output pool\n");
+		return -ENODEV;
+	}
+
+	pool.size = PAGE_ALIGN(pool.size);
+	for (i = 0; i < MPP_OUT_POOL_MAX_COUNT; i++)
+		pool.fds[i] = -1;
+
+	for (i = 0; i < pool.count; i++) {
+		bufs[i] = rk_dma_heap_buffer_alloc(heap, pool.size, O_RDWR, 0,
+						   dev_name(mpp->dev));
+		if (IS_ERR(bufs[i])) {
+			ret = PTR_ERR(bufs[i]);
+			bufs[i] = NULL;
+			goto fail;
+		}
+		pool.fds[i] = get_unused_fd_flags(O_CLOEXEC);
+		if (pool.fds[i] < 0) {
+			ret = pool.fds[i];
+			pool.fds[i] = -1;
+			goto fail;
+		}
+	}
+
+	if (copy_to_user(req->data, &pool, sizeof(pool))) {
+		ret = -EFAULT;
+		goto fail;
+	}
+
+	for (i = 0; i < pool.count; i++) {
+		fd_install(pool.fds[i], bufs[i]->file);
+		/* map once, the static mapping lives until the session closes */
+		buffer = mpp_dma_import_fd(mpp->iommu_info, session->dma,
+					   pool.fds[i], 1);
+		if (IS_ERR(buffer))
+			mpp_err("output pool fd %d premap failed\n", pool.fds[i]);
+	}
+
+	priv->pool_count = pool.count;
+	priv->pool_size = pool.size;
+	mpp_debug(DEBUG_IOCTL, "session %d output pool %d x %d\n",
+		  session->index, pool.count, pool.size);
+
+	return 0;
+
+fail:
+	for (i = 0; i < pool.count; i++) {
+		if (pool.fds[i] >= 0)
+			put_unused_fd(pool.fds[i]);
+		if (bufs[i])
+			rk_dma_heap_buffer_free(bufs[i]);
+	}
+	mpp_err("session %d output pool alloc failed %d\n", session->index, ret);
+
+	return ret;
+}
+
+static int vdpp_control(struct mpp_session *session, struct mpp_request *req)
+{
+	if (!session || !session->priv) {
+		mpp_err("session info null\n");
+		return -EINVAL;
+	}
+
+	switch (req->cmd) {
+	case MPP_CMD_INIT_OUT_POOL: {
+		return vdpp_init_out_pool(session, req);
+	} break;
+	default: {
+		mpp_err("unknown mpp ioctl cmd %x\n", req->cmd);
+	} break;
+	}
+
+	return 0;
+}
+
+static int vdpp_init_session(struct mpp_session *session)
+{
+	struct vdpp_session_priv *priv;
+
+	if (!session) {
+		mpp_err("session is null\n");
+		return -EINVAL;
+	}
+
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+	session->priv = priv;
+
+	return 0;
+}
+
+static int vdpp_free_session(struct mpp_session *session)
+{
+	/* pool mappings go with the session dma, the buffers with their fds */
+	if (session && session->priv) {
+		kfree(session->priv);
+		session->priv = NULL;
+	}
+
+	return 0;
+}
+
 #ifdef CONFIG_ROCKCHIP_MPP_PROC_FS
 static int vdpp_procfs_remove(struct mpp_dev *mpp)
 {
@@ -713,6 +849,9 @@ static struct mpp_dev_ops vdpp_v1_dev_ops = {
 	.finish = vdpp_finish,
 	.result = vdpp_result,
 	.free_task = vdpp_free_task,
+	.ioctl = vdpp_control,
+	.init_session = vdpp_init_session,
+	.free_session = vdpp_free_session,
 };
 
 static const struct mpp_dev_var vdpp_v1_data = {
@@ -60,6 +60,7 @@ enum force_value {
 enum {
 	NUM_SOURCE_BUFFERS = 5, /*5 src buffer for cif*/
 	NUM_TARGET_BUFFERS = 3, /*3 dst buffer rga*/
+	NUM_FIELD_BUFFERS = 2, /*2 deinterlaced buffer between the stages*/
 };
 
 enum buffer_state {
@@ -92,6 +93,7 @@ struct graphic_buffer {
 	unsigned long phy_addr;
 	void *vir_addr;
 	int rotation;
+	u32 drm_rotation;	/* scanout rotation, 0 for RGA rendered buffers */
 	int offset;
 	int len;
 	int width;
@@ -136,6 +138,17 @@ struct flinger {
 	struct drm_plane *plane;
 	const char *crtc_name;
 	const char *plane_name;
+	/* cif buffers go straight to the plane, no rga copy */
+	bool force_rga;
+	bool direct_show;
+	struct graphic_buffer *direct_buffer;
+	/* cvbs: deinterlace of field N+1 overlaps the scale of field N */
+	struct workqueue_struct *scale_workqueue;
+	struct graphic_buffer field_buffer[NUM_FIELD_BUFFERS];
+	wait_queue_head_t field_wait;
+	int field_index;
+	int scale_count;
+	bool field_pipeline;
 };
 
 static struct flinger *flinger;
@@ -278,6 +291,15 @@ static int rk_flinger_create_worker(struct flinger *flinger)
 	}
 	flinger->render_workqueue = wq;
 
+	wq = create_singlethread_workqueue("flinger-scale");
+	if (!wq) {
+		VEHICLE_DGERR("Failed to create flinger scale workqueue\n");
+		destroy_workqueue(flinger->render_workqueue);
+		flinger->render_workqueue = NULL;
+		return -ENODEV;
+	}
+	flinger->scale_workqueue = wq;
+
 	return 0;
 }
 
@@ -288,6 +310,8 @@ static int rk_flinger_destroy_worker(struct flinger *flinger)
 
 	if (flinger->render_workqueue)
 		destroy_workqueue(flinger->render_workqueue);
+	if (flinger->scale_workqueue)
+		destroy_workqueue(flinger->scale_workqueue);
 
 	return 0;
 }
@@ -312,6 +336,8 @@ static int vehicle_flinger_parse_dt(struct flinger *flinger)
 							__func__, flinger->plane_name);
 	}
 
+	flinger->force_rga = of_property_read_bool(dev->of_node, "vehicle,force-rga");
+
 	return 0;
 }
 
@@ -360,6 +386,7 @@ int vehicle_flinger_init(struct device *dev, struct vehicle_cfg *v_cfg)
 	mutex_init(&flg->target_buffer_lock);
 	INIT_LIST_HEAD(&flg->queue_buffer_list);
 	init_waitqueue_head(&flg->worker_wait);
+	init_waitqueue_head(&flg->field_wait);
 	atomic_set(&flg->worker_cond_atomic, 0);
 	atomic_set(&flg->worker_running_atomic, 1);
 
@@ -455,6 +482,9 @@ __maybe_unused int vehicle_flinger_deinit(void)
 	for (i = 0; i < NUM_TARGET_BUFFERS; i++)
 		rk_flinger_free_buffer(flg, &flg->target_buffer[i]);
 
+	for (i = 0; i < NUM_FIELD_BUFFERS; i++)
+		rk_flinger_free_buffer(flg, &flg->field_buffer[i]);
+
 	kfree(flg);
 
 	return 0;
@@ -1015,9 +1045,9 @@ static int rk_flinger_rga_render(struct flinger *flinger,
 	return 0;
 }
 
-static void rk_drm_vehicle_commit(struct flinger *flinger, struct graphic_buffer *buffer)
+static int rk_drm_vehicle_commit(struct flinger *flinger, struct graphic_buffer *buffer)
 {
-	struct rockchip_drm_direct_show_commit_info commit_info;
+	struct rockchip_drm_direct_show_commit_info commit_info = { 0 };
 	int hdisplay = flinger->crtc->state->adjusted_mode.hdisplay;
 	int vdisplay = flinger->crtc->state->adjusted_mode.vdisplay;
 
@@ -1043,6 +1073,7 @@ static void rk_drm_vehicle_commit(struct flinger *flinger, struct graphic_buffer
 	commit_info.dst_w = hdisplay;
 	commit_info.dst_h = vdisplay;
 
+	commit_info.rotation = buffer->drm_rotation;
 	commit_info.top_zpos  = true;
 
 	commit_info.buffer = buffer->drm_buffer;
@@ -1076,13 +1107,16 @@ static void rk_drm_vehicle_commit(struct flinger *flinger, struct graphic_buffer
 			}
 		}
 	}
-	rockchip_drm_direct_show_commit(flinger->drm_dev, &commit_info);
+
+	return rockchip_drm_direct_show_commit(flinger->drm_dev, &commit_info);
 }
 
 static int drop_frames_number;
 static int rk_flinger_vop_show(struct flinger *flinger,
 			       struct graphic_buffer *buffer)
 {
+	int ret;
+
 	if (!flinger || !buffer)
 		return -EINVAL;
 
@@ -1110,7 +1144,11 @@ static int rk_flinger_vop_show(struct flinger *flinger,
 		return -EINVAL;
 	}
 
-	rk_drm_vehicle_commit(flinger, buffer);
+	ret = rk_drm_vehicle_commit(flinger, buffer);
+	if (ret) {
+		VEHICLE_DGERR("error: vop commit failed(%d)\n", ret);
+		return ret;
+	}
 
 	flinger->debug_vop_count++;
 	/* save vop show buffer */
@@ -1175,6 +1213,65 @@ static void rk_flinger_first_done(struct work_struct *work)
 	}
 }
 
+/* Second stage, scales one deinterlaced field to the screen buffer */
+static void rk_flinger_scale_show(struct work_struct *work)
+{
+	struct graphic_buffer *field_buffer =
+			container_of(work, struct graphic_buffer, render_work);
+	struct graphic_buffer *dst_buffer, *buffer;
+	struct flinger *flg = flinger;
+	int i;
+
+	if (!flg)
+		return;
+
+	dst_buffer = &flg->target_buffer[flg->scale_count++ %
+					 (NUM_TARGET_BUFFERS - 1)];
+	dst_buffer->state = ACQUIRE;
+	rk_flinger_rga_scaler(flg, field_buffer, dst_buffer);
+	/* the field buffer is free again once it has been read */
+	wake_up(&flg->field_wait);
+
+	rk_flinger_vop_show(flg, dst_buffer);
+	for (i = 0; i < NUM_TARGET_BUFFERS; i++) {
+		buffer = &flg->target_buffer[i];
+		if (buffer->state == DISPLAY)
+			buffer->state = FREE;
+	}
+	dst_buffer->state = DISPLAY;
+}
+
+/*
+ * First stage, rotates and deinterlaces into the next field buffer and
+ * hands it to the scale worker. The field buffer state is the fence: it
+ * is only reused once the scaler has consumed it.
+ */
+static void rk_flinger_field_render(struct flinger *flg,
+				    struct graphic_buffer *src_buffer)
+{
+	struct graphic_buffer *rot_buffer, *field_buffer;
+
+	field_buffer = &flg->field_buffer[flg->field_index % NUM_FIELD_BUFFERS];
+	if (!wait_event_timeout(flg->field_wait, field_buffer->state == FREE,
+				msecs_to_jiffies(100))) {
+		VEHICLE_DGERR("%s: scaler stalled, drop frame\n", __func__);
+		src_buffer->state = FREE;
+		return;
+	}
+	flg->field_index++;
+
+	rot_buffer = &flg->target_buffer[NUM_TARGET_BUFFERS - 1];
+	rot_buffer->state = ACQUIRE;
+	field_buffer->state = ACQUIRE;
+	rk_flinger_rga_render(flg, src_buffer, rot_buffer, field_buffer);
+	src_buffer->state = FREE;
+	rk_flinger_iep_deinterlace(flg, rot_buffer, field_buffer);
+
+	field_buffer->state = QUEUE;
+	INIT_WORK(&field_buffer->render_work, rk_flinger_scale_show);
+	queue_work(flg->scale_workqueue, &field_buffer->render_work);
+}
+
 static void rk_flinger_render_show(struct work_struct *work)
 {
 	struct graphic_buffer *src_buffer, *dst_buffer, *iep_buffer, *buffer;
@@ -1264,6 +1361,29 @@ static void rk_flinger_render_show(struct work_struct *work)
 			}
 		}
 
+		/*
+		 * Zero copy: the cif buffer itself is scanned out and scaled by
+		 * the vop, it is held until the next one is on screen.
+		 */
+		if (flg->direct_show) {
+			if (!rk_flinger_vop_show(flg, src_buffer)) {
+				if (flg->direct_buffer)
+					flg->direct_buffer->state = FREE;
+				src_buffer->state = DISPLAY;
+				flg->direct_buffer = src_buffer;
+				continue;
+			}
+			VEHICLE_INFO("direct show failed, fall back to rga\n");
+			flg->direct_show = false;
+		}
+
+		if (flg->field_pipeline &&
+		    (flg->v_cfg.input_format == CIF_INPUT_FORMAT_PAL ||
+		     flg->v_cfg.input_format == CIF_INPUT_FORMAT_NTSC)) {
+			rk_flinger_field_render(flg, src_buffer);
+			continue;
+		}
+
 		/*  2. find dst buffer */
 		dst_buffer = NULL;
 		iep_buffer = NULL;
@@ -1404,6 +1524,108 @@ static bool vehicle_rotation_param_check(struct vehicle_cfg *v_cfg)
 		return false;
 	}
 }
+/*
+ * The cif writes Y with a stride of the frame width and UV right behind
+ * it, which is the layout of a width x height drm buffer once the width
+ * is 64 aligned. Only rotation needs rga, mirroring is done by the vop.
+ */
+static u32 rk_flinger_direct_show_rotation(struct flinger *flg,
+					   struct vehicle_cfg *v_cfg)
+{
+	u32 rotation = 0;
+
+	if (flg->force_rga)
+		return 0;
+
+	if (v_cfg->input_format == CIF_INPUT_FORMAT_PAL ||
+	    v_cfg->input_format == CIF_INPUT_FORMAT_NTSC)
+		return 0;
+
+	if (v_cfg->width % 64)
+		return 0;
+
+	switch (v_cfg->rotate_mirror & RGA_TRANSFORM_ROT_MASK) {
+	case RGA_TRANSFORM_ROT_0:
+		break;
+	case RGA_TRANSFORM_ROT_180:
+		rotation = DRM_MODE_REFLECT_X | DRM_MODE_REFLECT_Y;
+		break;
+	default:
+		return 0;
+	}
+
+	if (v_cfg->rotate_mirror & RGA_TRANSFORM_FLIP_H)
+		rotation ^= DRM_MODE_REFLECT_X;
+	if (v_cfg->rotate_mirror & RGA_TRANSFORM_FLIP_V)
+		rotation ^= DRM_MODE_REFLECT_Y;
+
+	return DRM_MODE_ROTATE_0 | rotation;
+}
+
+static int rk_flinger_direct_show_realloc(struct flinger *flg,
+					  int w, int h, int f)
+{
+	struct graphic_buffer *buffer;
+	int i, ret;
+	int ow, oh, os, of;
+
+	for (i = 0; i < NUM_SOURCE_BUFFERS; i++) {
+		buffer = &flg->source_buffer[i];
+		if (buffer->width == w && buffer->height == h &&
+		    buffer->format == f)
+			continue;
+
+		ow = buffer->width;
+		oh = buffer->height;
+		os = buffer->stride;
+		of = buffer->format;
+		rk_flinger_free_buffer(flg, buffer);
+		kfree(buffer->drm_buffer);
+		buffer->drm_buffer = NULL;
+		ret = rk_flinger_alloc_buffer(flg, buffer, w, h, w, f);
+		if (ret) {
+			VEHICLE_DGERR("direct show realloc buffer[%d] failed\n", i);
+			kfree(buffer->drm_buffer);
+			buffer->drm_buffer = NULL;
+			rk_flinger_alloc_buffer(flg, buffer, ow, oh, os, of);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* Field buffers are only needed by cvbs, allocate them on first use */
+static void rk_flinger_field_pipeline_setup(struct flinger *flg)
+{
+	struct graphic_buffer *target = &flg->target_buffer[0];
+	struct graphic_buffer *buffer;
+	int i, ret;
+
+	flush_workqueue(flg->scale_workqueue);
+
+	for (i = 0; i < NUM_FIELD_BUFFERS; i++) {
+		buffer = &flg->field_buffer[i];
+		if (!buffer->drm_buffer) {
+			ret = rk_flinger_alloc_buffer(flg, buffer,
+						      target->width, target->height,
+						      target->stride, target->format);
+			if (ret) {
+				VEHICLE_DGERR("alloc field buffer failed(%d)\n", ret);
+				kfree(buffer->drm_buffer);
+				buffer->drm_buffer = NULL;
+				flg->field_pipeline = false;
+				return;
+			}
+		}
+		buffer->state = FREE;
+	}
+
+	flg->field_index = 0;
+	flg->scale_count = 0;
+	flg->field_pipeline = true;
+}
+
 int vehicle_flinger_reverse_open(struct vehicle_cfg *v_cfg,
 				bool android_is_ready)
 {
@@ -1413,6 +1635,7 @@ int vehicle_flinger_reverse_open(struct vehicle_cfg *v_cfg,
 	struct flinger *flg = flinger;
 	struct graphic_buffer *buffer;
 	int hal_format;
+	u32 drm_rotation;
 
 	width = v_cfg->width;
 	height = v_cfg->height;
@@ -1427,6 +1650,16 @@ int vehicle_flinger_reverse_open(struct vehicle_cfg *v_cfg,
 	else
 		hal_format = HAL_PIXEL_FORMAT_YCrCb_NV12;
 
+	/*  0. cif buffers directly on the plane when there is no rotation */
+	drm_rotation = rk_flinger_direct_show_rotation(flg, v_cfg);
+	if (drm_rotation &&
+	    rk_flinger_direct_show_realloc(flg, width, height, hal_format))
+		drm_rotation = 0;
+	flg->direct_show = !!drm_rotation;
+	flg->direct_buffer = NULL;
+	VEHICLE_INFO("%s: direct show %s, rotation(0x%x)\n", __func__,
+		     flg->direct_show ? "on" : "off", drm_rotation);
+
 	/*  1. reinit buffer format */
 	for (i = 0; i < NUM_SOURCE_BUFFERS; i++) {
 		buffer = &(flg->source_buffer[i]);
@@ -1436,6 +1669,7 @@ int vehicle_flinger_reverse_open(struct vehicle_cfg *v_cfg,
 		rk_flinger_set_buffer_rotation(buffer, v_cfg->rotate_mirror);
 		rk_flinger_cacultae_dst_rect_by_rotation(buffer);
 		buffer->dst.f = buffer->src.f;
+		buffer->drm_rotation = drm_rotation;
 		buffer->state = FREE;
 	}
 
@@ -1444,6 +1678,10 @@ int vehicle_flinger_reverse_open(struct vehicle_cfg *v_cfg,
 		buffer->state = FREE;
 	}
 
+	if (v_cfg->input_format == CIF_INPUT_FORMAT_PAL ||
+	    v_cfg->input_format == CIF_INPUT_FORMAT_NTSC)
+		rk_flinger_field_pipeline_setup(flg);
+
 	/*2. fill buffer info*/
 	for (i = 0; i < NUM_SOURCE_BUFFERS && i < MAX_BUF_NUM; i++) {
 		v_cfg->buf_phy_addr[i] = flinger->source_buffer[i].phy_addr;
@@ -287,6 +287,32 @@ struct dma_buf_ops {
 	void (*vunmap)(struct dma_buf *dmabuf, struct iosys_map *map);
 };
 
+#define DMA_BUF_ACCT_NAME_LEN	32
+
+enum dma_buf_acct_type {
+	DMA_BUF_ACCT_EXPORTER,
+	DMA_BUF_ACCT_PROCESS,
+	DMA_BUF_ACCT_DEVICE,
+};
+
+struct dma_buf_acct;
+
+/**
+ * struct dma_buf_acct_info - snapshot of one account
+ * @name:	exporter name, process comm or importer device name
+ * @pid:	tgid of the owner process, 0 for the other types
+ * @count:	number of buffers, or of attachments for devices
+ * @bytes:	bytes currently accounted
+ * @peak:	highest @bytes since the last dma_buf_acct_reset_peak()
+ */
+struct dma_buf_acct_info {
+	const char *name;
+	pid_t pid;
+	unsigned int count;
+	unsigned long bytes;
+	unsigned long peak;
+};
+
 #ifdef CONFIG_DMABUF_CACHE
 /**
  * dma_buf_destructor - dma-buf destructor function
@@ -396,6 +422,15 @@ struct dma_buf {
 	/** @priv: exporter specific private data for this buffer object. */
 	void *priv;
 
+	/**
+	 * @uncached:
+	 *
+	 * Set by the exporter when no mapping of the buffer, cpu or device,
+	 * goes through the cpu caches. Importers may skip their cache
+	 * maintenance on such buffers, see dma_buf_is_uncached().
+	 */
+	bool uncached;
+
 	/**
 	 * @resv:
 	 *
@@ -474,6 +509,10 @@ struct dma_buf {
 	void *dtor_data;
 	struct mutex cache_lock;
 #endif
+#if IS_ENABLED(CONFIG_RK_DMABUF_DEBUG)
+	/* exporter and owner process accounts */
+	struct dma_buf_acct *acct[DMA_BUF_ACCT_PROCESS + 1];
+#endif
 };
 
 /**
@@ -543,6 +582,9 @@ struct dma_buf_attachment {
 	const struct dma_buf_attach_ops *importer_ops;
 	void *importer_priv;
 	void *priv;
+#if IS_ENABLED(CONFIG_RK_DMABUF_DEBUG)
+	struct dma_buf_acct *acct;
+#endif
 };
 
 /**
@@ -554,6 +596,7 @@ struct dma_buf_attachment {
  * @flags:	mode flags for the file
  * @resv:	reservation-object, NULL to allocate default one
  * @priv:	Attach private data of allocator to this buffer
+ * @uncached:	the buffer is only mapped uncached or write-combined
  *
  * This structure holds the information required to export the buffer. Used
  * with dma_buf_export() only.
@@ -566,6 +609,7 @@ struct dma_buf_export_info {
 	int flags;
 	struct dma_resv *resv;
 	void *priv;
+	bool uncached;
 };
 
 /**
@@ -676,14 +720,40 @@ static inline void dma_buf_set_destructor(struct dma_buf *dmabuf,
 }
 #endif
 
+/**
+ * dma_buf_is_uncached - check whether cache maintenance can be skipped
+ * @dmabuf:	[in]	pointer to dma-buf
+ *
+ * Returns true when the exporter maps the buffer uncached everywhere, so
+ * importers don't need to sync it for cpu or device.
+ */
+static inline bool dma_buf_is_uncached(struct dma_buf *dmabuf)
+{
+	return dmabuf && dmabuf->uncached;
+}
+
 #if IS_ENABLED(CONFIG_RK_DMABUF_DEBUG)
 void dma_buf_reset_peak_size(void);
 size_t dma_buf_get_peak_size(void);
 size_t dma_buf_get_total_size(void);
+int dma_buf_acct_for_each(enum dma_buf_acct_type type,
+			  int (*callback)(const struct dma_buf_acct_info *info,
+					  void *private),
+			  void *private);
+void dma_buf_acct_reset_peak(void);
 #else
 static inline void dma_buf_reset_peak_size(void) {}
 static inline size_t dma_buf_get_peak_size(void) { return 0; }
 static inline size_t dma_buf_get_total_size(void) { return 0; }
+static inline int
+dma_buf_acct_for_each(enum dma_buf_acct_type type,
+		      int (*callback)(const struct dma_buf_acct_info *info,
+				      void *private),
+		      void *private)
+{
+	return 0;
+}
+static inline void dma_buf_acct_reset_peak(void) {}
 #endif
 
 int dma_buf_vmap_unlocked(struct dma_buf *dmabuf, struct iosys_map *map);
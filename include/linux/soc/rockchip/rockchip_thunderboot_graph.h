@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2024 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef _ROCKCHIP_THUNDERBOOT_GRAPH_H
+#define _ROCKCHIP_THUNDERBOOT_GRAPH_H
+
+#include <linux/bits.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+
+/* Resources handed over by the loader or the MCU during thunder boot */
+enum rk_tb_res {
+	RK_TB_RES_MCU,		/* MCU finished early capture, camera is free */
+	RK_TB_RES_STORAGE,	/* storage controller released by the loader */
+	RK_TB_RES_IMAGE,	/* pre-loaded image passed the sha256 check */
+	RK_TB_RES_MAX,
+};
+
+#define RK_TB_RES(x)	BIT(RK_TB_RES_##x)
+
+/**
+ * struct rk_tb_node - one step of the early-init graph
+ * @name: shown in the timing report
+ * @needs: RK_TB_RES() mask that must be ready before @fn runs
+ * @provides: RK_TB_RES() mask made ready once @fn returned 0
+ * @fn: the step itself, runs on an unbound worker in process context
+ * @data: argument of @fn
+ *
+ * Nodes whose needs are met run concurrently. The remaining fields are
+ * private to the graph.
+ */
+struct rk_tb_node {
+	const char *name;
+	unsigned long needs;
+	unsigned long provides;
+	int (*fn)(void *data);
+	void *data;
+
+	struct list_head node;
+	struct work_struct work;
+	ktime_t t_ready;
+	ktime_t t_start;
+	ktime_t t_end;
+	int ret;
+	bool queued;
+};
+
+#ifdef CONFIG_ROCKCHIP_THUNDER_BOOT
+int rk_tb_node_register(struct rk_tb_node *node);
+void rk_tb_res_provide(unsigned long res);
+bool rk_tb_res_is_ready(unsigned long res);
+#else
+static inline int rk_tb_node_register(struct rk_tb_node *node)
+{
+	return node->fn(node->data);
+}
+
+static inline void rk_tb_res_provide(unsigned long res) { }
+
+static inline bool rk_tb_res_is_ready(unsigned long res)
+{
+	return true;
+}
+#endif
+
+#endif
@@ -13,7 +13,31 @@
 #include <linux/dma-buf.h>
 #include <linux/mm.h>
 
+/*
+ * Flags of sram_heap_client_alloc().
+ *
+ * SRAM_HEAP_FLAG_HOT: latency critical buffer, may use the sram kept back
+ *	by the hot_reserve module parameter.
+ * SRAM_HEAP_FLAG_FALLBACK_DDR: take cached ddr pages when the sram or the
+ *	client quota is exhausted. Those need begin/end_cpu_access around cpu
+ *	accesses, sram_heap_is_sram() tells which one was returned.
+ */
+#define SRAM_HEAP_FLAG_HOT		BIT(0)
+#define SRAM_HEAP_FLAG_FALLBACK_DDR	BIT(1)
+
+/* smallest alignment class, a cache line */
+#define SRAM_HEAP_ALIGN_MIN		64
+
+struct sram_heap_client;
+
 #if IS_REACHABLE(CONFIG_DMABUF_HEAPS_SRAM)
+struct sram_heap_client *sram_heap_client_create(const char *name, size_t quota);
+void sram_heap_client_destroy(struct sram_heap_client *client);
+struct dma_buf *sram_heap_client_alloc(struct sram_heap_client *client,
+				       size_t size, size_t align,
+				       unsigned int flags);
+bool sram_heap_is_sram(struct dma_buf *dmabuf);
+
 struct dma_buf *sram_heap_alloc_dma_buf(size_t size);
 struct page *sram_heap_alloc_pages(size_t size);
 void sram_heap_free_pages(struct page *p);
@@ -22,6 +46,26 @@ void *sram_heap_get_vaddr(struct dma_buf *dmabuf);
 phys_addr_t sram_heap_get_paddr(struct dma_buf *dmabuf);
 
 #else
+static inline struct sram_heap_client *sram_heap_client_create(const char *name,
+								size_t quota)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline void sram_heap_client_destroy(struct sram_heap_client *client) {}
+
+static inline struct dma_buf *sram_heap_client_alloc(struct sram_heap_client *client,
+						     size_t size, size_t align,
+						     unsigned int flags)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline bool sram_heap_is_sram(struct dma_buf *dmabuf)
+{
+	return false;
+}
+
 static inline struct dma_buf *sram_heap_alloc_dma_buf(size_t size)
 {
 	return NULL;
@@ -16,10 +16,13 @@ int rockchip_pmu_block(void);
 void rockchip_pmu_unblock(void);
 int rockchip_pmu_pd_on(struct device *dev);
 int rockchip_pmu_pd_off(struct device *dev);
+int rockchip_pmu_pd_on_batch(struct device **devs, int num);
 bool rockchip_pmu_pd_is_on(struct device *dev);
 int rockchip_pmu_idle_request(struct device *dev, bool idle);
 int rockchip_save_qos(struct device *dev);
 int rockchip_restore_qos(struct device *dev);
+int rockchip_raise_qos_priority(struct device *dev, u32 priority);
+int rockchip_reset_qos_priority(struct device *dev);
 void rockchip_dump_pmu(void);
 
 #else /* CONFIG_ROCKCHIP_PM_DOMAINS */
@@ -41,6 +44,11 @@ static inline int rockchip_pmu_pd_off(struct device *dev)
 	return -ENOTSUPP;
 }
 
+static inline int rockchip_pmu_pd_on_batch(struct device **devs, int num)
+{
+	return -ENOTSUPP;
+}
+
 static inline bool rockchip_pmu_pd_is_on(struct device *dev)
 {
 	return true;
@@ -61,6 +69,16 @@ static inline int rockchip_restore_qos(struct device *dev)
 	return -ENOTSUPP;
 }
 
+static inline int rockchip_raise_qos_priority(struct device *dev, u32 priority)
+{
+	return -ENOTSUPP;
+}
+
+static inline int rockchip_reset_qos_priority(struct device *dev)
+{
+	return -ENOTSUPP;
+}
+
 static inline void rockchip_dump_pmu(void)
 {
 }
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Copyright (C) 2023 Rockchip Electronics Co., Ltd
+ */
+
+#ifndef _ROCKCHIP_DECOMPRESS_JOB
+#define _ROCKCHIP_DECOMPRESS_JOB
+
+#include <linux/errno.h>
+#include <linux/list.h>
+#include <linux/types.h>
+
+/**
+ * struct rk_decom_job - an asynchronous decompress request
+ * @node:		queue entry, owned by the driver while queued
+ * @mode:		LZ4_MOD, GZIP_MOD or ZLIB_MOD
+ * @src:		dma address of the contiguous compressed input
+ * @dst:		dma address of the contiguous output
+ * @dst_max_size:	size of the output buffer
+ * @timeout_ms:		hardware time limit, 0 for the default
+ * @deadline:		jiffies the running job times out at, driver private
+ * @done:		called from process context once the job has finished;
+ *			the job may be freed or requeued from within
+ * @status:		0, or the error the job failed with
+ * @decom_len:		length of the decompressed data
+ *
+ * The engine runs one job at a time, queued jobs are started back to back
+ * from the completion of the previous one.
+ */
+struct rk_decom_job {
+	struct list_head node;
+	u32 mode;
+	phys_addr_t src;
+	phys_addr_t dst;
+	u32 dst_max_size;
+	u32 timeout_ms;
+	unsigned long deadline;
+	void (*done)(struct rk_decom_job *job);
+	int status;
+	u64 decom_len;
+};
+
+#ifdef CONFIG_ROCKCHIP_HW_DECOMPRESS
+int rk_decom_queue_job(struct rk_decom_job *job);
+ssize_t rk_decom_buf(u32 mode, const void *src, size_t src_len,
+		     void *dst, size_t dst_len);
+#else
+static inline int rk_decom_queue_job(struct rk_decom_job *job)
+{
+	return -ENODEV;
+}
+
+static inline ssize_t rk_decom_buf(u32 mode, const void *src, size_t src_len,
+				   void *dst, size_t dst_len)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
@@ -14,6 +14,7 @@
 #define __SOC_ROCKCHIP_DMC_H
 
 #include <linux/devfreq.h>
+#include <linux/seq_file.h>
 
 /* for lcdc_type */
 #define SCREEN_NULL		0
@@ -44,15 +45,38 @@ struct rl_map_table {
 	unsigned int rl; /* readlatency */
 };
 
+/* latency classes of a rockchip_bw_request, lowest first */
+enum rockchip_bw_class {
+	ROCKCHIP_BW_BACKGROUND,
+	ROCKCHIP_BW_NORMAL,
+	ROCKCHIP_BW_REALTIME,
+};
+
+/*
+ * Declared bandwidth of an IP driver (MPP, ISP, NPU, RGA, ...), see
+ * rockchip_dmcfreq_bw_request_add().
+ */
+struct rockchip_bw_request {
+	struct list_head node;
+	struct device *dev;
+	enum rockchip_bw_class class;
+	unsigned int bw_mbyte;
+	bool is_qos_raised;
+};
+
 struct dmcfreq_common_info {
 	struct device *dev;
 	struct devfreq *devfreq;
+	struct freq_map_table *bw_req_tbl;
 	struct freq_map_table *vop_bw_tbl;
 	struct freq_map_table *vop_frame_bw_tbl;
 	struct rl_map_table *vop_pn_rl_tbl;
 	struct delayed_work msch_rl_work;
 	unsigned long vop_4k_rate;
 	unsigned long vop_req_rate;
+	unsigned long bw_req_rate;
+	unsigned long bw_background_max_rate;
+	unsigned int bw_realtime_qos_prio;
 	unsigned int read_latency;
 	unsigned int auto_freq_en;
 	unsigned int stall_time_ns;
@@ -78,6 +102,13 @@ int rockchip_dmcfreq_vop_bandwidth_init(struct dmcfreq_common_info *info);
 int rockchip_dmcfreq_vop_bandwidth_request(struct dmcfreq_vop_info *vop_info);
 void rockchip_dmcfreq_vop_bandwidth_update(struct dmcfreq_vop_info *vop_info);
 unsigned int rockchip_dmcfreq_get_stall_time_ns(void);
+void rockchip_dmcfreq_trans_latency_show(struct seq_file *m);
+int rockchip_dmcfreq_bw_request_add(struct rockchip_bw_request *req,
+				    struct device *dev,
+				    enum rockchip_bw_class class);
+void rockchip_dmcfreq_bw_request_update(struct rockchip_bw_request *req,
+					unsigned int bw_mbyte);
+void rockchip_dmcfreq_bw_request_remove(struct rockchip_bw_request *req);
 #else
 static inline void rockchip_dmcfreq_lock(void)
 {
@@ -126,6 +157,29 @@ rockchip_dmcfreq_get_stall_time_ns(void)
 {
 	return 0;
 }
+
+static inline void rockchip_dmcfreq_trans_latency_show(struct seq_file *m)
+{
+}
+
+static inline int
+rockchip_dmcfreq_bw_request_add(struct rockchip_bw_request *req,
+				struct device *dev,
+				enum rockchip_bw_class class)
+{
+	return 0;
+}
+
+static inline void
+rockchip_dmcfreq_bw_request_update(struct rockchip_bw_request *req,
+				   unsigned int bw_mbyte)
+{
+}
+
+static inline void
+rockchip_dmcfreq_bw_request_remove(struct rockchip_bw_request *req)
+{
+}
 #endif
 
 #endif
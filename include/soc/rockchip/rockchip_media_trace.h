@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef __SOC_ROCKCHIP_MEDIA_TRACE_H
+#define __SOC_ROCKCHIP_MEDIA_TRACE_H
+
+#include <linux/types.h>
+
+struct device;
+struct dma_buf;
+
+/*
+ * A frame is followed across drivers by the dma-buf that carries it. The
+ * producer tags the buffer with a frame id, every driver that touches the
+ * buffer emits rk_media_buf at queue, start and done with that id, so a
+ * trace shows the latency of one frame split by stage and device.
+ */
+enum rk_media_stage {
+	RK_MEDIA_QUEUE,
+	RK_MEDIA_START,
+	RK_MEDIA_DONE,
+};
+
+#if IS_REACHABLE(CONFIG_ROCKCHIP_MEDIA_TRACE)
+bool rk_media_trace_enabled(void);
+void rk_media_buf_set_frame(struct dma_buf *dmabuf, u64 frame);
+u64 rk_media_buf_get_frame(struct dma_buf *dmabuf);
+void rk_media_buf_copy_frame(struct dma_buf *dst, struct dma_buf *src);
+void rk_media_buf_trace(struct device *dev, struct dma_buf *dmabuf,
+			enum rk_media_stage stage);
+#else
+static inline bool rk_media_trace_enabled(void)
+{
+	return false;
+}
+
+static inline void rk_media_buf_set_frame(struct dma_buf *dmabuf, u64 frame)
+{
+}
+
+static inline u64 rk_media_buf_get_frame(struct dma_buf *dmabuf)
+{
+	return 0;
+}
+
+static inline void rk_media_buf_copy_frame(struct dma_buf *dst, struct dma_buf *src)
+{
+}
+
+static inline void rk_media_buf_trace(struct device *dev, struct dma_buf *dmabuf,
+				      enum rk_media_stage stage)
+{
+}
+#endif
+
+#endif
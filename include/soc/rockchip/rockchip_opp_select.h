@@ -73,6 +73,7 @@ struct pvtpll_opp_table {
  * @pvtpll_avg_offset:	Register offset of pvtm value.
  * @pvtpll_min_rate:	Minimum frequency which needs calibration.
  * @pvtpll_volt_step:	Voltage step of pvtpll calibration.
+ * @pvtpll_calib_cache:	Marks if calibrated voltages are kept in vendor storage.
  * @volt_rm_tbl:	Pointer to voltage to memory read margin conversion table.
  * @grf:		General Register Files regmap.
  * @dsu_grf:		DSU General Register Files regmap.
@@ -108,6 +109,7 @@ struct rockchip_opp_info {
 	unsigned int pvtpll_avg_offset;
 	unsigned int pvtpll_min_rate;
 	unsigned int pvtpll_volt_step;
+	bool pvtpll_calib_cache;
 
 	struct volt_rm_table *volt_rm_tbl;
 	struct regmap *grf;
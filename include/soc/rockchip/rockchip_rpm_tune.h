@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ */
+#ifndef __SOC_ROCKCHIP_RPM_TUNE_H
+#define __SOC_ROCKCHIP_RPM_TUNE_H
+
+#include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+
+/**
+ * struct rockchip_rpm_tune - adaptive autosuspend of a job based device
+ * @dev:		The device powered around its jobs
+ * @lock:		Protects the fields below
+ * @last_put:		When the last job released the device
+ * @resume_ns:		Decayed average of the measured power up cost
+ * @suspend_ns:		Decayed average of the measured power down cost
+ * @gap_ns:		Decayed average of the idle time between two jobs
+ * @max_delay_ms:	Autosuspend delay while jobs are queued, as set by the
+ *			driver before rockchip_rpm_tune_init()
+ * @delay_ms:		Autosuspend delay currently programmed
+ * @resume_cnt:		Number of measured power ups
+ * @suspend_cnt:	Number of measured power downs
+ * @linger_cnt:		Number of idle puts kept powered by the tuning
+ */
+struct rockchip_rpm_tune {
+	struct device *dev;
+	spinlock_t lock;
+	ktime_t last_put;
+	u64 resume_ns;
+	u64 suspend_ns;
+	u64 gap_ns;
+	int max_delay_ms;
+	int delay_ms;
+	u64 resume_cnt;
+	u64 suspend_cnt;
+	u64 linger_cnt;
+};
+
+#if IS_REACHABLE(CONFIG_ROCKCHIP_RPM_TUNE)
+void rockchip_rpm_tune_init(struct rockchip_rpm_tune *tune, struct device *dev);
+int rockchip_rpm_tune_get_sync(struct rockchip_rpm_tune *tune);
+void rockchip_rpm_tune_put(struct rockchip_rpm_tune *tune, bool busy);
+void rockchip_rpm_tune_show(struct seq_file *m, struct rockchip_rpm_tune *tune);
+#else
+static inline void rockchip_rpm_tune_init(struct rockchip_rpm_tune *tune,
+					  struct device *dev)
+{
+	tune->dev = dev;
+}
+
+static inline int rockchip_rpm_tune_get_sync(struct rockchip_rpm_tune *tune)
+{
+	return pm_runtime_get_sync(tune->dev);
+}
+
+static inline void rockchip_rpm_tune_put(struct rockchip_rpm_tune *tune,
+					 bool busy)
+{
+	if (busy) {
+		pm_runtime_mark_last_busy(tune->dev);
+		pm_runtime_put_autosuspend(tune->dev);
+	} else {
+		pm_runtime_put_sync_suspend(tune->dev);
+	}
+}
+
+static inline void rockchip_rpm_tune_show(struct seq_file *m,
+					  struct rockchip_rpm_tune *tune)
+{
+}
+#endif /* CONFIG_ROCKCHIP_RPM_TUNE */
+
+#endif
@@ -6,15 +6,39 @@
 #ifndef __SOC_ROCKCHIP_SYSTEM_MONITOR_H
 #define __SOC_ROCKCHIP_SYSTEM_MONITOR_H
 
+#include <linux/ktime.h>
 #include <linux/pm_opp.h>
 #include <linux/pm_qos.h>
 #include <linux/regulator/consumer.h>
+#include <linux/spinlock.h>
 
 enum monitor_dev_type {
 	MONITOR_TYPE_CPU = 0,	/* CPU */
 	MONITOR_TYPE_DEV,	/* GPU, NPU, DMC, and so on */
 };
 
+/* who capped the maximum frequency of a monitored device */
+enum monitor_cap_source {
+	MONITOR_CAP_THERMAL = 0,	/* high temperature limit */
+	MONITOR_CAP_WIDE_TEMP,		/* low temperature limit */
+	MONITOR_CAP_STATUS,		/* system status and reboot */
+	MONITOR_CAP_SOURCE_MAX,
+};
+
+/**
+ * struct monitor_cap_stat - statistics of one frequency cap source
+ * @freq:	Current cap in KHz, 0 if not capping
+ * @since:	Time the current cap was applied
+ * @capped_ns:	Total time spent capped, not counting the current cap
+ * @count:	Number of times the cap was applied or changed
+ */
+struct monitor_cap_stat {
+	unsigned long freq;
+	ktime_t since;
+	u64 capped_ns;
+	unsigned int count;
+};
+
 enum system_monitor_event_type {
 	SYSTEM_MONITOR_CHANGE_TEMP = 0,
 };
@@ -92,6 +116,15 @@ struct temp_opp_table {
  * @is_high_temp:	True if current temperature greater than high_temp
  * @is_low_temp_enabled:	True if device node contains low temperature
  *				configuration
+ * @min_boost_freq_req:	CPU minimum frequency constraint raised on deadline
+ *			misses.
+ * @dev_min_boost_req:	Devices minimum frequency constraint raised on
+ *			deadline misses.
+ * @boost_max_freq:	Maximum frequency the deadline boost scales from, in
+ *			KHz, 0 if the device is not boosted
+ * @cap_lock:		Protects @cap_stat
+ * @cap_stat:		Frequency cap statistics of each cap source
+ * @debugfs:		Per device cap statistics file
  */
 struct monitor_dev_info {
 	struct device *dev;
@@ -122,6 +155,12 @@ struct monitor_dev_info {
 	bool is_low_temp;
 	bool is_high_temp;
 	bool is_low_temp_enabled;
+	struct freq_qos_request min_boost_freq_req;
+	struct dev_pm_qos_request dev_min_boost_req;
+	unsigned long boost_max_freq;
+	spinlock_t cap_lock;
+	struct monitor_cap_stat cap_stat[MONITOR_CAP_SOURCE_MAX];
+	struct dentry *debugfs;
 };
 
 struct monitor_dev_profile {
@@ -151,6 +190,7 @@ int rockchip_monitor_dev_high_temp_adjust(struct monitor_dev_info *info,
 int rockchip_monitor_suspend_low_temp_adjust(int cpu);
 int rockchip_system_monitor_register_notifier(struct notifier_block *nb);
 void rockchip_system_monitor_unregister_notifier(struct notifier_block *nb);
+void rockchip_monitor_deadline_miss(void);
 #else
 static inline struct monitor_dev_info *
 rockchip_system_monitor_register(struct device *dev,
@@ -211,6 +251,10 @@ static inline void
 rockchip_system_monitor_unregister_notifier(struct notifier_block *nb)
 {
 };
+
+static inline void rockchip_monitor_deadline_miss(void)
+{
+};
 #endif /* CONFIG_ROCKCHIP_SYSTEM_MONITOR */
 
 #ifdef CONFIG_ROCKCHIP_EARLYSUSPEND
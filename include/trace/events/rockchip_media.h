@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ *
+ * Per-frame buffer tracepoints shared by the rockchip media drivers
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rockchip_media
+
+#if !defined(_TRACE_ROCKCHIP_MEDIA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ROCKCHIP_MEDIA_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rk_media_buf,
+	TP_PROTO(const char *dev, unsigned long buf, u64 frame, int stage),
+	TP_ARGS(dev, buf, frame, stage),
+
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(unsigned long, buf)
+		__field(u64, frame)
+		__field(int, stage)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->buf = buf;
+		__entry->frame = frame;
+		__entry->stage = stage;
+	),
+
+	TP_printk("%s buf=%lu frame=%llu %s", __get_str(dev), __entry->buf,
+		  __entry->frame,
+		  __print_symbolic(__entry->stage,
+				   { 0, "queue" },
+				   { 1, "start" },
+				   { 2, "done" }))
+);
+
+#endif /* _TRACE_ROCKCHIP_MEDIA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rockchip_system_monitor
+
+#if !defined(_TRACE_ROCKCHIP_SYSTEM_MONITOR_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ROCKCHIP_SYSTEM_MONITOR_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rockchip_monitor_freq_cap,
+	TP_PROTO(struct device *dev, const char *source, unsigned long old_freq,
+		 unsigned long freq, u64 capped_ns),
+
+	TP_ARGS(dev, source, old_freq, freq, capped_ns),
+
+	TP_STRUCT__entry(
+		__string(dev_name, dev_name(dev))
+		__string(source, source)
+		__field(unsigned long, old_freq)
+		__field(unsigned long, freq)
+		__field(u64, capped_ns)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev_name, dev_name(dev));
+		__assign_str(source, source);
+		__entry->old_freq = old_freq;
+		__entry->freq = freq;
+		__entry->capped_ns = capped_ns;
+	),
+
+	TP_printk("dev=%s source=%s old_khz=%lu khz=%lu capped_ns=%llu",
+		  __get_str(dev_name), __get_str(source), __entry->old_freq,
+		  __entry->freq, __entry->capped_ns)
+);
+
+#endif /* _TRACE_ROCKCHIP_SYSTEM_MONITOR_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -43,9 +43,11 @@ enum drm_rockchip_gem_mem_type {
 	ROCKCHIP_BO_ALLOC_KMAP	= 1 << 4,
 	/* alloc page with gfp_dma32 */
 	ROCKCHIP_BO_DMA32	= 1 << 5,
+	/* alloc pages from the 2M/1M/64K chunk pool for iommu buffer */
+	ROCKCHIP_BO_LARGE_PAGE	= 1 << 6,
 	ROCKCHIP_BO_MASK	= ROCKCHIP_BO_CONTIG | ROCKCHIP_BO_CACHABLE |
 				ROCKCHIP_BO_WC | ROCKCHIP_BO_SECURE | ROCKCHIP_BO_ALLOC_KMAP |
-				ROCKCHIP_BO_DMA32,
+				ROCKCHIP_BO_DMA32 | ROCKCHIP_BO_LARGE_PAGE,
 };
 
 /**
@@ -104,6 +106,43 @@ enum rockchip_plane_feture {
 	ROCKCHIP_DRM_PLANE_FEATURE_MAX,
 };
 
+#define ROCKCHIP_WB_STREAM_MAX_BUFS	8
+
+enum drm_rockchip_wb_stream_cmd {
+	ROCKCHIP_WB_STREAM_START,
+	ROCKCHIP_WB_STREAM_STOP,
+	ROCKCHIP_WB_STREAM_ACQUIRE,
+	ROCKCHIP_WB_STREAM_RELEASE,
+};
+
+/**
+ * Continuous write back of the composed frames of a crtc into a ring of
+ * framebuffers, without an atomic commit for each captured frame.
+ *
+ * @cmd: one of enum drm_rockchip_wb_stream_cmd.
+ * @crtc_id: the crtc to capture, must be active.
+ * @count: number of framebuffers in @fb_ids, for START.
+ * @index: returned slot by ACQUIRE, slot to give back by RELEASE.
+ * @fb_ids: framebuffers of the ring, for START. All of them must have the
+ *     same size and format, smaller than the mode means scale down.
+ * @fence_fd: returned by ACQUIRE, a sync_file signaled when the slot has
+ *     been written, with error -ECANCELED if the stream is stopped before.
+ * @frame: returned by ACQUIRE, frame sequence of the slot.
+ * @timeout_ms: time ACQUIRE waits for a frame, 0 for no wait.
+ * @dropped: returned number of frames not captured so far.
+ */
+struct drm_rockchip_wb_stream {
+	uint32_t cmd;
+	uint32_t crtc_id;
+	uint32_t count;
+	uint32_t index;
+	uint32_t fb_ids[ROCKCHIP_WB_STREAM_MAX_BUFS];
+	int32_t fence_fd;
+	uint32_t frame;
+	uint32_t timeout_ms;
+	uint32_t dropped;
+};
+
 enum rockchip_cabc_mode {
 	ROCKCHIP_DRM_CABC_MODE_DISABLE,
 	ROCKCHIP_DRM_CABC_MODE_NORMAL,
@@ -117,6 +156,7 @@ enum rockchip_cabc_mode {
 #define DRM_ROCKCHIP_GEM_CPU_RELEASE	0x03
 #define DRM_ROCKCHIP_GEM_GET_PHYS	0x04
 #define DRM_ROCKCHIP_GET_VCNT_EVENT	0x05
+#define DRM_ROCKCHIP_WB_STREAM		0x06
 
 #define DRM_IOCTL_ROCKCHIP_GEM_CREATE	DRM_IOWR(DRM_COMMAND_BASE + \
 		DRM_ROCKCHIP_GEM_CREATE, struct drm_rockchip_gem_create)
@@ -136,4 +176,7 @@ enum rockchip_cabc_mode {
 #define DRM_IOCTL_ROCKCHIP_GET_VCNT_EVENT	DRM_IOWR(DRM_COMMAND_BASE + \
 		DRM_ROCKCHIP_GET_VCNT_EVENT, union drm_wait_vblank)
 
+#define DRM_IOCTL_ROCKCHIP_WB_STREAM		DRM_IOWR(DRM_COMMAND_BASE + \
+		DRM_ROCKCHIP_WB_STREAM, struct drm_rockchip_wb_stream)
+
 #endif /* _UAPI_ROCKCHIP_DRM_H */
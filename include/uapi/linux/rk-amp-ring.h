@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef _UAPI__RK_AMP_RING_H__
+#define _UAPI__RK_AMP_RING_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Shared memory channel between Linux and the AMP core, on the amp-ringN
+ * misc device.
+ *
+ * The reserved memory holds two single producer single consumer rings, TX
+ * (Linux to remote) first and RX (remote to Linux) second. Each ring is a
+ * control page followed by data_size bytes of data, and the whole region is
+ * mapped with mmap() at offset 0, so messages are written and read in place.
+ *
+ * head and tail are byte offsets that only grow, the data of offset n lives
+ * at n % data_size. The producer writes a message at head and then advances
+ * head, the consumer reads it at tail and then advances tail. Messages are
+ * framed like rpmsg: a struct rk_amp_ring_hdr followed by len bytes of
+ * payload, padded to RK_AMP_RING_ALIGN. A message never wraps; when it does
+ * not fit before the end of the data, the producer fills up the end with a
+ * message flagged RK_AMP_RING_F_PAD.
+ *
+ * Doorbells are batched: a consumer sets need_kick before it sleeps and
+ * rechecks head, and a producer only rings the doorbell when need_kick is
+ * set, so a burst of messages costs one interrupt. need_room works the same
+ * way for a producer waiting for the consumer to free some data.
+ */
+#define RK_AMP_RING_ALIGN		16
+#define RK_AMP_RING_CTRL_SIZE		4096
+
+#define RK_AMP_RING_F_PAD		0x1
+
+struct rk_amp_ring_hdr {
+	__u32 src;
+	__u32 dst;
+	__u32 reserved;
+	__u16 len;
+	__u16 flags;
+};
+
+/* the control page, indexes on their own cache lines */
+struct rk_amp_ring_ctrl {
+	__u32 head;
+	__u32 pad0[15];
+	__u32 tail;
+	__u32 pad1[15];
+	__u32 need_kick;	/* set by the consumer before sleeping */
+	__u32 need_room;	/* set by the producer before sleeping */
+	__u32 data_size;
+};
+
+struct rk_amp_ring_info {
+	__u32 tx_offset;	/* mmap offset of the TX control page */
+	__u32 rx_offset;	/* mmap offset of the RX control page */
+	__u32 data_size;	/* bytes of data of each ring */
+	__u32 map_size;
+};
+
+struct rk_amp_ring_wait {
+	__u32 events;		/* in: RK_AMP_RING_EV_*, out: ready events */
+	__u32 timeout_ms;
+	__u32 tx_tail;		/* in: TX tail last seen, for RK_AMP_RING_EV_TX */
+};
+
+#define RK_AMP_RING_EV_RX		0x1	/* RX has data */
+#define RK_AMP_RING_EV_TX		0x2	/* TX tail moved from tx_tail */
+
+#define RK_AMP_RING_IOC_MAGIC		'A'
+
+#define RK_AMP_RING_GET_INFO	_IOR(RK_AMP_RING_IOC_MAGIC, 0x60, struct rk_amp_ring_info)
+/* Ring the remote doorbell for TX, if the remote asked for it */
+#define RK_AMP_RING_KICK	_IO(RK_AMP_RING_IOC_MAGIC, 0x61)
+/* Wait for RX data or TX room, need_kick is handled by the driver */
+#define RK_AMP_RING_WAIT	_IOWR(RK_AMP_RING_IOC_MAGIC, 0x62, struct rk_amp_ring_wait)
+
+#endif
@@ -20,8 +20,22 @@
 /* Valid FD_FLAGS are O_CLOEXEC, O_RDONLY, O_WRONLY, O_RDWR */
 #define RK_DMA_HEAP_VALID_FD_FLAGS (O_CLOEXEC | O_ACCMODE)
 
-/* Currently no heap flags */
-#define RK_DMA_HEAP_VALID_HEAP_FLAGS (0)
+/*
+ * Place the buffer on one DDR channel instead of the default memory, which
+ * is interleaved across all channels. The channel index is carried in
+ * RK_DMA_HEAP_FLAG_CHANNEL_MASK, and is served from the per channel cma
+ * area declared with "rk_dma_heap_cma_ch=" on the kernel command line.
+ * Allocations fail with -ENODEV when that channel has no area.
+ */
+#define RK_DMA_HEAP_FLAG_CHANNEL_LOCAL	(1 << 0)
+#define RK_DMA_HEAP_FLAG_CHANNEL_SHIFT	4
+#define RK_DMA_HEAP_FLAG_CHANNEL_MASK	(0xf << RK_DMA_HEAP_FLAG_CHANNEL_SHIFT)
+#define RK_DMA_HEAP_FLAG_CHANNEL(ch)	(RK_DMA_HEAP_FLAG_CHANNEL_LOCAL | \
+					 (((ch) << RK_DMA_HEAP_FLAG_CHANNEL_SHIFT) & \
+					  RK_DMA_HEAP_FLAG_CHANNEL_MASK))
+
+#define RK_DMA_HEAP_VALID_HEAP_FLAGS (RK_DMA_HEAP_FLAG_CHANNEL_LOCAL | \
+				      RK_DMA_HEAP_FLAG_CHANNEL_MASK)
 
 /**
  * struct rk_dma_heap_allocation_data - metadata passed from userspace for
@@ -41,6 +55,45 @@ struct rk_dma_heap_allocation_data {
 	__u64 heap_flags;
 };
 
+/* Buffers of the pool are mapped write-combined, no cache maintenance */
+#define RK_DMA_HEAP_POOL_UNCACHED	(1 << 0)
+
+#define RK_DMA_HEAP_VALID_POOL_FLAGS	(RK_DMA_HEAP_POOL_UNCACHED)
+
+/**
+ * struct rk_dma_heap_pool_data - metadata passed from userspace to create a
+ *                                pool of fixed size buffers
+ * @size:		size of each buffer of the pool
+ * @count:		number of buffers of the pool
+ * @flags:		RK_DMA_HEAP_POOL_* flags
+ * @fd:			will be populated with a fd for the pool, closing it
+ *			frees the pool once all of its buffers are released
+ * @fd_flags:		file descriptor flags of the pool fd, only O_CLOEXEC
+ *
+ * Provided by userspace as an argument to the ioctl
+ */
+struct rk_dma_heap_pool_data {
+	__u64 size;
+	__u32 count;
+	__u32 flags;
+	__u32 fd;
+	__u32 fd_flags;
+};
+
+/**
+ * struct rk_dma_heap_pool_alloc_data - metadata passed from userspace to take
+ *                                      a buffer out of a pool
+ * @fd:			will be populated with a fd which provides the
+ *			handle to the dma-buf
+ * @fd_flags:		file descriptor flags used when allocating
+ *
+ * Provided by userspace as an argument to the ioctl on the pool fd
+ */
+struct rk_dma_heap_pool_alloc_data {
+	__u32 fd;
+	__u32 fd_flags;
+};
+
 #define RK_DMA_HEAP_IOC_MAGIC		'R'
 
 /**
@@ -52,4 +105,26 @@ struct rk_dma_heap_allocation_data {
 #define RK_DMA_HEAP_IOCTL_ALLOC	_IOWR(RK_DMA_HEAP_IOC_MAGIC, 0x0,\
 				      struct rk_dma_heap_allocation_data)
 
+/**
+ * DOC: RK_DMA_HEAP_IOCTL_POOL_CREATE - create a pool of fixed size buffers
+ *
+ * Takes a rk_dma_heap_pool_data struct and returns it with the fd field
+ * populated with the pool handle. Only supported by heaps that export
+ * pools, others return -ENOTTY.
+ */
+#define RK_DMA_HEAP_IOCTL_POOL_CREATE	_IOWR(RK_DMA_HEAP_IOC_MAGIC, 0x1,\
+				      struct rk_dma_heap_pool_data)
+
+/**
+ * DOC: RK_DMA_HEAP_POOL_IOCTL_ALLOC - take a buffer out of a pool
+ *
+ * Issued on the pool fd. Takes a rk_dma_heap_pool_alloc_data struct and
+ * returns it with the fd field populated with the dmabuf handle, or fails
+ * with -EAGAIN when all buffers of the pool are in use. Releasing the dmabuf
+ * gives the buffer back to the pool, its content is not cleared and its
+ * device mappings are kept for the next user.
+ */
+#define RK_DMA_HEAP_POOL_IOCTL_ALLOC	_IOWR(RK_DMA_HEAP_IOC_MAGIC, 0x2,\
+				      struct rk_dma_heap_pool_alloc_data)
+
 #endif /* _UAPI_LINUX_DMABUF_POOL_H */
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef _UAPI__RK_FLEXBUS_FSPI_H__
+#define _UAPI__RK_FLEXBUS_FSPI_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Streaming mode of the flexbus fspi controller, for parallel links such as
+ * an FPGA on the four data lines.
+ *
+ * The ring of block_num * block_size bytes is mapped with mmap() on the
+ * device once it is set up. The controller DMA ping-pongs between two ring
+ * blocks with the bus clock running continuously, so no cycles are lost at
+ * block boundaries. Data is carried raw, in bus order.
+ *
+ * RX: blocks [tail, head) hold data. Consume them and advance tail. If the
+ *     ring overflows, the oldest block is dropped and xruns is counted.
+ * TX: the blocks from tail onwards are free to fill. Advance tail once they
+ *     are written, which may happen before START. If the hardware catches
+ *     up with tail, it resends stale data to keep the bus clocked, and
+ *     xruns is counted.
+ *
+ * Block indexes are monotonic; a block lives at ring offset
+ * (index % block_num) * block_size.
+ */
+#define FLEXBUS_FSPI_STREAM_RX		0
+#define FLEXBUS_FSPI_STREAM_TX		1
+
+#define FLEXBUS_FSPI_STREAM_CMD_MAX	8
+
+struct flexbus_fspi_stream_cfg {
+	__u32 dir;		/* FLEXBUS_FSPI_STREAM_RX/TX */
+	__u32 block_size;	/* bytes, multiple of 64 */
+	__u32 block_num;	/* >= 2 */
+	__u32 cmd_len;		/* bytes of cmd sent on one line before the data */
+	__u8 cmd[FLEXBUS_FSPI_STREAM_CMD_MAX];
+};
+
+struct flexbus_fspi_stream_status {
+	__u64 head;		/* blocks completed by the hardware */
+	__u64 tail;		/* blocks consumed (RX) or filled (TX) by userspace */
+	__u32 xruns;		/* overflows (RX) or underruns (TX) */
+	__u32 timeout_ms;	/* in: FLEXBUS_FSPI_STREAM_WAIT timeout */
+};
+
+#define FLEXBUS_FSPI_IOC_MAGIC		'F'
+
+/* Allocate the ring and reset the indexes, stream must be stopped */
+#define FLEXBUS_FSPI_STREAM_SETUP	_IOW(FLEXBUS_FSPI_IOC_MAGIC, 0xa0, struct flexbus_fspi_stream_cfg)
+#define FLEXBUS_FSPI_STREAM_START	_IO(FLEXBUS_FSPI_IOC_MAGIC, 0xa1)
+#define FLEXBUS_FSPI_STREAM_STOP	_IO(FLEXBUS_FSPI_IOC_MAGIC, 0xa2)
+/* Wait for data (RX) or room (TX), returns the current indexes */
+#define FLEXBUS_FSPI_STREAM_WAIT	_IOWR(FLEXBUS_FSPI_IOC_MAGIC, 0xa3, struct flexbus_fspi_stream_status)
+/* Advance tail by the given number of blocks */
+#define FLEXBUS_FSPI_STREAM_ADVANCE	_IOW(FLEXBUS_FSPI_IOC_MAGIC, 0xa4, __u32)
+
+#endif
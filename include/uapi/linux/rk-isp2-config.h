@@ -118,6 +118,13 @@
 #define RKISP_CMD_SET_EXPANDER \
 	_IOW('V', BASE_VIDIOC_PRIVATE + 114, struct rkmodule_hdr_cfg)
 
+#define RKISP_CMD_SET_STATS_RING \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 115, struct rkisp_stats_ring_cfg)
+
+/* for params video device, first params before 3a start */
+#define RKISP_CMD_SET_PARAMS_SNAPSHOT \
+	_IOW('V', BASE_VIDIOC_PRIVATE + 116, struct rkisp_params_snapshot)
+
 /**********************EVENT_PRIVATE***************************/
 #define RKISP_V4L2_EVENT_AIISP_LINECNT (V4L2_EVENT_PRIVATE_START + 1)
 
@@ -573,6 +580,70 @@ struct rkisp_info2ddr {
 	__u32 vsize;
 } __attribute__ ((packed));
 
+#define RKISP_STATS_RING_SLOT_MAX	16
+
+/* struct rkisp_stats_ring_cfg
+ * stats written to a ring mapped by user instead of the stats video buffers
+ *
+ * slot_num: slots of the ring, 2~RKISP_STATS_RING_SLOT_MAX. 0 to free the ring.
+ * event_fd: eventfd signaled for each stats written, -1 for none.
+ * buf_fd: fd of the ring memory, for mmap. return result.
+ * buf_size: size of the ring memory. return result.
+ */
+struct rkisp_stats_ring_cfg {
+	__u32 slot_num;
+	__s32 event_fd;
+	__s32 buf_fd;
+	__u32 buf_size;
+} __attribute__ ((packed));
+
+/* struct rkisp_params_snapshot
+ * full params of the isp version, saved by user from the last converged
+ * frame. used as the first params of the next stream on if no params
+ * queued by 3a yet, and the stream on no wait for 3a.
+ *
+ * buf_fd: dmabuf fd with the params, copied by driver then fd can close.
+ * size: params size, same as the params video buffer. 0 to drop the snapshot.
+ */
+struct rkisp_params_snapshot {
+	__s32 buf_fd;
+	__u32 size;
+} __attribute__ ((packed));
+
+/* struct rkisp_stats_ring_head
+ * start of the ring memory, slots follow from data_offset
+ *
+ * slot_num: slots of the ring.
+ * slot_size: size of a slot, struct rkisp_stats_ring_slot and the stats buffer.
+ * data_offset: offset of the first slot.
+ * latest: slot index of the newest stats, valid if count isn't 0.
+ * count: stats written to the ring.
+ */
+struct rkisp_stats_ring_head {
+	__u32 slot_num;
+	__u32 slot_size;
+	__u32 data_offset;
+	__u32 latest;
+	__u64 count;
+} __attribute__ ((packed));
+
+/* struct rkisp_stats_ring_slot
+ * head of a slot, the stats buffer of the isp version follows
+ *
+ * seq: odd while the slot is written. read seq, copy the stats and read seq
+ *	again, the copy is whole if both seq are the same and even.
+ * frame_id: frame of the stats.
+ * timestamp: time of the stats, same as the stats video buffer, ns.
+ * size: size of the stats buffer.
+ */
+struct rkisp_stats_ring_slot {
+	__u32 seq;
+	__u32 frame_id;
+	__u64 timestamp;
+	__u32 size;
+	__u32 reserved;
+} __attribute__ ((packed));
+
 struct isp2x_ispgain_buf {
 	__u32 gain_dmaidx;
 	__u32 mfbc_dmaidx;
@@ -29,6 +29,8 @@ enum MPP_DEV_COMMAND_TYPE {
 	MPP_CMD_INIT_CLIENT_TYPE	= MPP_CMD_INIT_BASE + 0,
 	MPP_CMD_INIT_DRIVER_DATA	= MPP_CMD_INIT_BASE + 1,
 	MPP_CMD_INIT_TRANS_TABLE	= MPP_CMD_INIT_BASE + 2,
+	MPP_CMD_INIT_DONE_RING		= MPP_CMD_INIT_BASE + 3,
+	MPP_CMD_INIT_OUT_POOL		= MPP_CMD_INIT_BASE + 4,
 	MPP_CMD_INIT_BUTT,
 
 	MPP_CMD_SEND_BASE		= 0x200,
@@ -37,6 +39,9 @@ enum MPP_DEV_COMMAND_TYPE {
 	MPP_CMD_SET_REG_ADDR_OFFSET	= MPP_CMD_SEND_BASE + 2,
 	MPP_CMD_SET_RCB_INFO		= MPP_CMD_SEND_BASE + 3,
 	MPP_CMD_SET_SESSION_FD		= MPP_CMD_SEND_BASE + 4,
+	MPP_CMD_SET_TASK_SPLIT		= MPP_CMD_SEND_BASE + 5,
+	MPP_CMD_SET_IN_FENCE		= MPP_CMD_SEND_BASE + 6,
+	MPP_CMD_SET_OUT_FENCE		= MPP_CMD_SEND_BASE + 7,
 	MPP_CMD_SEND_BUTT,
 
 	MPP_CMD_POLL_BASE		= 0x300,
@@ -49,6 +54,7 @@ enum MPP_DEV_COMMAND_TYPE {
 	MPP_CMD_TRANS_FD_TO_IOVA	= MPP_CMD_CONTROL_BASE + 1,
 	MPP_CMD_RELEASE_FD		= MPP_CMD_CONTROL_BASE + 2,
 	MPP_CMD_SEND_CODEC_INFO		= MPP_CMD_CONTROL_BASE + 3,
+	MPP_CMD_SET_SESSION_QOS		= MPP_CMD_CONTROL_BASE + 4,
 	MPP_CMD_CONTROL_BUTT,
 
 	MPP_CMD_BUTT,
@@ -60,6 +66,12 @@ enum MPP_DEV_COMMAND_TYPE {
 #define MPP_FLAGS_REG_FD_NO_TRANS	(0x00000004)
 #define MPP_FLAGS_SCL_FD_NO_TRANS	(0x00000008)
 #define MPP_FLAGS_REG_NO_OFFSET		(0x00000010)
+/*
+ * The task is the first half of one frame split into two slice groups, the
+ * next task of the session is the second half. On a multi-core device both
+ * halves are started together on two cores.
+ */
+#define MPP_FLAGS_SPLIT_PAIR		(0x00000020)
 #define MPP_FLAGS_SECURE_MODE		(0x00010000)
 
 /* data common struct for parse out */
@@ -71,6 +83,12 @@ struct mpp_request {
 	void __user *data;
 };
 
+/*
+ * MPP_CMD_SET_IN_FENCE data is a __s32 sync_file fd, the task is not started
+ * before the fence signals. MPP_CMD_SET_OUT_FENCE data is a __s32 where the
+ * kernel returns a new sync_file fd, which signals when the task is done.
+ */
+
 #define MPP_BAT_MSG_DONE		(0x00000001)
 
 struct mpp_bat_msg {
@@ -79,4 +97,75 @@ struct mpp_bat_msg {
 	__s32 ret;
 };
 
+/* session qos class, the higher class is served first */
+enum MPP_QOS_CLASS {
+	MPP_QOS_CLASS_BACKGROUND	= 0,
+	MPP_QOS_CLASS_NORMAL		= 1,
+	MPP_QOS_CLASS_REALTIME		= 2,
+	MPP_QOS_CLASS_BUTT,
+};
+
+/*
+ * Session qos for MPP_CMD_SET_SESSION_QOS. A non-zero deadline_us gives each
+ * task of the session a deadline relative to its submit time, tasks with the
+ * same class are served earliest deadline first.
+ */
+struct mpp_session_qos {
+	__u32 qos_class;
+	__u32 deadline_us;
+};
+
+/*
+ * Output buffer pool for MPP_CMD_INIT_OUT_POOL, post-processor only.
+ * The kernel allocates count physically contiguous buffers of size bytes
+ * from the reserved cma heap, maps them once for the session and returns
+ * them as dma-buf fds. User space cycles through them as the output of
+ * the tasks and passes them on to display, so an inline decode, vdpp and
+ * display chain, joined by MPP_CMD_SET_IN_FENCE/OUT_FENCE, does not
+ * allocate or map per frame.
+ */
+#define MPP_OUT_POOL_MAX_COUNT		(8)
+
+struct mpp_out_pool {
+	__u32 count;
+	__u32 size;
+	__s32 fds[MPP_OUT_POOL_MAX_COUNT];
+};
+
+/*
+ * Completion ring shared with userspace by mmap on the session fd.
+ * The kernel is the only producer and advances head, the userspace poller
+ * is the only consumer and advances tail. Entry seq is the submit order of
+ * the task in the session, counted from zero.
+ *
+ * Encoder with split output also posts one entry per slice as soon as the
+ * slice is written. These entries have MPP_DONE_FLAG_SLICE set, slice_idx
+ * and length tell the slice index in the frame and the slice byte size. The
+ * frame entry follows after the last slice.
+ */
+#define MPP_DONE_RING_MAX_COUNT		(4096)
+
+#define MPP_DONE_FLAG_SLICE		(0x00000001)
+#define MPP_DONE_FLAG_LAST_SLICE	(0x00000002)
+
+struct mpp_done_entry {
+	__u32 seq;
+	__u32 task_id;
+	__u32 hw_cycles;
+	__u32 irq_status;
+	__u32 flags;
+	__u32 slice_idx;
+	__u32 length;
+	__u32 reserved;
+};
+
+struct mpp_done_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 count;
+	__u32 drop;
+	__u32 reserved[12];
+	struct mpp_done_entry entries[];
+};
+
 #endif /* _UAPI_RK_MPP_H */
@@ -47,6 +47,39 @@ struct pcie_ep_dma_block_req {
 	struct pcie_ep_dma_block block;
 };
 
+/*
+ * Submit up to PCIE_EP_DMA_LIST_MAX blocks as one linked-list transfer,
+ * the ioctl returns once the whole chain has completed.
+ */
+#define PCIE_EP_DMA_LIST_MAX	1024
+
+struct pcie_ep_dma_list_req {
+	__u16 vir_id;	/* Default 0 */
+	__u8 chn;
+	__u8 wr;
+	__u32 flag;
+	__u32 nr_blocks;
+	__u32 reserved;
+	__u64 blocks;	/* User pointer to struct pcie_ep_dma_block[nr_blocks] */
+};
+
+/*
+ * Transfer straight from/to a dma-buf (system heap, MPP, NPU, ...), the
+ * driver maps it for its own device and chains its scatter list, so no
+ * copy through the reserved mmap buffers is needed.
+ */
+struct pcie_ep_dma_dmabuf_req {
+	__u16 vir_id;	/* Default 0 */
+	__u8 chn;
+	__u8 wr;	/* 1: dma-buf to bus_paddr, 0: bus_paddr to dma-buf */
+	__u32 flag;
+	__s32 fd;
+	__u32 reserved;
+	__u64 offset;	/* Start offset inside the dma-buf */
+	__u64 size;
+	__u64 bus_paddr;
+};
+
 #define	PCIE_EP_OBJ_INFO_MAGIC 0x524B4550
 
 enum pcie_ep_obj_irq_type {
@@ -86,7 +119,14 @@ struct pcie_ep_obj_info {
 		__u16 submode;
 	} devmode;
 	__u32 msi_data[PCIE_EP_OBJ_INFO_MSI_DATA_NUM];
-	__u8 reserved[0x1D0];
+	__u32 dma_ll_off;					/* eDMA linked-list area offset in BAR0, since version 2 */
+	__u32 dma_ll_size;					/* 0 if the ep has no linked-list area */
+	__u32 queue_off;					/* Queue rings offset in BAR0, since version 3 */
+	__u64 dma_ll_base;					/* Same area in ep local address */
+	__u32 queue_stride;					/* Bytes between two struct pcie_ep_queue_ring */
+	__u16 queue_num;					/* 0 if the ep has no queue rings */
+	__u16 queue_depth;
+	__u8 reserved[0x1B4];
 
 	__u32 irq_type_rc;					/* Generate in ep isr, valid only for rc, clear in rc */
 	struct pcie_ep_obj_irq_dma_status dma_status_rc;	/* Generate in ep isr, valid only for rc, clear in rc */
@@ -96,6 +136,65 @@ struct pcie_ep_obj_info {
 	__u32 irq_user_data_ep;					/* Generate in rc, valid only for ep, No need to clear */
 };
 
+/*
+ * Host queues: each rc process owns one queue pair in BAR0 and nobody else
+ * touches it, so no lock is shared between processes or with the ep:
+ *  - The rc fills sq[sq_tail % depth], then advances sq_tail and rings the
+ *    queue doorbell (ELBI interrupt PCIE_EP_QUEUE_ELBI_BASE + qid).
+ *  - The ep consumes up to sq_tail, posts to cq[cq_tail % depth] with the
+ *    phase flipped on every wrap, advances sq_head/cq_tail and raises MSI
+ *    vector msi_vector.
+ *  - The rc consumes completions while the phase matches, then advances
+ *    cq_head.
+ * Each index is written by one side only; doorbells may coalesce, the
+ * indices are the only state.
+ */
+#define PCIE_EP_QUEUE_MAX		16
+#define PCIE_EP_QUEUE_DEPTH		64
+#define PCIE_EP_QUEUE_ELBI_BASE		1
+#define PCIE_EP_QUEUE_STATE_FREE	0
+#define PCIE_EP_QUEUE_STATE_READY	1
+
+struct pcie_ep_queue_sqe {
+	__u16 opcode;
+	__u16 flags;
+	__u32 tag;
+	__u64 args[7];
+};
+
+struct pcie_ep_queue_cqe {
+	__u32 tag;
+	__s32 status;
+	__u32 result;
+	__u16 sq_head;
+	__u16 phase;
+};
+
+struct pcie_ep_queue_ring {
+	/* Written by the rc only */
+	__u32 sq_tail;
+	__u32 cq_head;
+	__u32 msi_vector;
+	__u32 state;
+	__u32 reserved_rc[12];
+	/* Written by the ep only */
+	__u32 sq_head;
+	__u32 cq_tail;
+	__u32 reserved_ep[14];
+	struct pcie_ep_queue_sqe sq[PCIE_EP_QUEUE_DEPTH];
+	struct pcie_ep_queue_cqe cq[PCIE_EP_QUEUE_DEPTH];
+};
+
+/*
+ * Queue wait, rc: sleep until completions are signalled on qid.
+ * ep: sleep until any doorbell rings, pending returns the qid bitmap.
+ */
+struct pcie_ep_queue_wait {
+	__u32 qid;
+	__u32 timeout_ms;	/* 0: wait forever */
+	__u32 pending;
+};
+
 /*
  * rockchip driver ep_obj poll ioctrl input param
  */
@@ -118,5 +217,12 @@ struct pcie_ep_obj_poll_virtual_id_cfg {
 #define PCIE_EP_RAISE_IRQ_USER		_IOW(PCIE_BASE, 18, int)
 #define PCIE_EP_POLL_IRQ_USER		_IOW(PCIE_BASE, 19, struct pcie_ep_obj_poll_virtual_id_cfg)
 #define PCIE_EP_DMA_XFER_BLOCK		_IOW(PCIE_BASE, 32, struct pcie_ep_dma_block_req)
+#define PCIE_EP_DMA_XFER_LIST		_IOW(PCIE_BASE, 33, struct pcie_ep_dma_list_req)
+#define PCIE_EP_DMA_XFER_DMABUF		_IOW(PCIE_BASE, 34, struct pcie_ep_dma_dmabuf_req)
+#define PCIE_EP_QUEUE_REQUEST		_IOR(PCIE_BASE, 40, int)
+#define PCIE_EP_QUEUE_RELEASE		_IOW(PCIE_BASE, 41, int)
+#define PCIE_EP_QUEUE_DOORBELL		_IOW(PCIE_BASE, 42, int)
+#define PCIE_EP_QUEUE_WAIT		_IOWR(PCIE_BASE, 43, struct pcie_ep_queue_wait)
+#define PCIE_EP_QUEUE_NOTIFY		_IOW(PCIE_BASE, 44, int)
 
 #endif
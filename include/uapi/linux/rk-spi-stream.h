@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef _UAPI__RK_SPI_STREAM_H__
+#define _UAPI__RK_SPI_STREAM_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Streaming mode of the rkspi-devN misc device, for SPI ADCs and displays
+ * that need the bus clocked without gaps.
+ *
+ * Once set up, the ring of block_num * block_size bytes is mapped with
+ * mmap() at offset RKSPI_STREAM_MMAP_OFFSET; offset 0 still maps the
+ * controller registers. The ring is run by cyclic DMA with chip select held,
+ * one block per DMA period, so there is no per-message setup at all.
+ *
+ * RX: blocks [tail, head) hold data. Consume them and advance tail. If the
+ *     ring overflows, the oldest block is dropped and xruns is counted.
+ *     All zeros are sent on MOSI.
+ * TX: the blocks from tail onwards are free to fill. Advance tail once they
+ *     are written, which may happen before START. If the DMA catches up
+ *     with tail, stale data is sent again and xruns is counted.
+ *
+ * Block indexes are monotonic; a block lives at ring offset
+ * (index % block_num) * block_size.
+ */
+#define RKSPI_STREAM_RX			0
+#define RKSPI_STREAM_TX			1
+
+#define RKSPI_STREAM_MMAP_OFFSET	0x100000
+
+struct rkspi_stream_cfg {
+	__u32 dir;		/* RKSPI_STREAM_RX/TX */
+	__u32 block_size;	/* bytes, multiple of 64 */
+	__u32 block_num;	/* >= 2 */
+	__u32 speed_hz;
+	__u8 chip_select;
+	__u8 mode;		/* SPI_CPHA | SPI_CPOL */
+	__u8 bits_per_word;	/* 8 or 16 */
+	__u8 reserved;
+};
+
+struct rkspi_stream_status {
+	__u64 head;		/* blocks completed by the DMA */
+	__u64 tail;		/* blocks consumed (RX) or filled (TX) by userspace */
+	__u32 xruns;		/* overflows (RX) or underruns (TX) */
+	__u32 timeout_ms;	/* in: RKSPI_STREAM_WAIT timeout */
+};
+
+#define RKSPI_IOC_MAGIC			'k'
+
+/* Allocate the ring and reset the indexes, stream must be stopped */
+#define RKSPI_STREAM_SETUP	_IOW(RKSPI_IOC_MAGIC, 0xb0, struct rkspi_stream_cfg)
+#define RKSPI_STREAM_START	_IO(RKSPI_IOC_MAGIC, 0xb1)
+#define RKSPI_STREAM_STOP	_IO(RKSPI_IOC_MAGIC, 0xb2)
+/* Wait for data (RX) or room (TX), returns the current indexes */
+#define RKSPI_STREAM_WAIT	_IOWR(RKSPI_IOC_MAGIC, 0xb3, struct rkspi_stream_status)
+/* Advance tail by the given number of blocks */
+#define RKSPI_STREAM_ADVANCE	_IOW(RKSPI_IOC_MAGIC, 0xb4, __u32)
+
+#endif
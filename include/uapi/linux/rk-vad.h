@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Copyright (c) 2024 Rockchip Electronics Co., Ltd.
+ */
+
+#ifndef _UAPI__RK_VAD_H__
+#define _UAPI__RK_VAD_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Zero-copy access to the audio captured by the VAD before wake-up.
+ *
+ * The /dev/vad misc device maps the whole VAD sram read-only with mmap() at
+ * offset 0. Once the capture stream has been started after a wake-up, the
+ * pre-roll lives at ring offset pos and is size bytes long, wrapping at end
+ * when loop is set. Frames are packed, channels * sample_bytes each, in the
+ * layout of the capture stream.
+ *
+ * Samples consumed straight from the mapping are dropped from the PCM read
+ * path with RK_VAD_CONSUME, so they are not delivered twice.
+ */
+struct rk_vad_buf_info {
+	__u32 map_size;		/* bytes of sram to mmap */
+	__u32 pos;		/* offset of the oldest pre-roll byte */
+	__u32 end;		/* offset the ring wraps at */
+	__u32 size;		/* pre-roll bytes left */
+	__u32 loop;		/* the ring has wrapped */
+	__u32 channels;
+	__u32 sample_bytes;
+	__u32 reserved;
+};
+
+#define RK_VAD_IOC_MAGIC	'v'
+
+#define RK_VAD_GET_BUF_INFO	_IOR(RK_VAD_IOC_MAGIC, 0xd0, struct rk_vad_buf_info)
+/* Drop the given number of pre-roll bytes, rounded down to whole frames */
+#define RK_VAD_CONSUME		_IOW(RK_VAD_IOC_MAGIC, 0xd1, __u32)
+
+#endif
@@ -68,6 +68,13 @@
 #define RKVPSS_CMD_CHECKPARAMS \
 	_IOW('V', BASE_VIDIOC_PRIVATE + 55, struct rkvpss_frame_cfg)
 
+/* queue frame handle and return at once, out_fence_fd signal at frame end */
+#define RKVPSS_CMD_FRAME_HANDLE_ASYNC \
+	_IOWR('V', BASE_VIDIOC_PRIVATE + 56, struct rkvpss_frame_async)
+
+#define RKVPSS_CMD_SET_OUTPUT_SKIP \
+	_IOW('V', BASE_VIDIOC_PRIVATE + 57, struct rkvpss_output_skip)
+
 /********************************************************************/
 
 /* struct rkvpss_mirror_flip
@@ -264,6 +271,29 @@ struct rkvpss_frame_cfg {
 	struct rkvpss_output_cfg output[RKVPSS_OUTPUT_MAX];
 } __attribute__ ((packed));
 
+/* struct rkvpss_frame_async
+ * cfg: frame handle configure, the same as RKVPSS_CMD_FRAME_HANDLE.
+ * out_fence_fd: sync file fd return by driver, signal when the frame is done,
+ *		 fence error if the frame handle fail.
+ */
+struct rkvpss_frame_async {
+	struct rkvpss_frame_cfg cfg;
+	int out_fence_fd;
+} __attribute__ ((packed));
+
+/* struct rkvpss_output_skip
+ * output skip rate of one device for frame handle
+ *
+ * dev_id: device id, range 0~127.
+ * skip: channel output one frame every skip + 1 frames, the frame whose
+ *       sequence is divisible by skip + 1. 0: no skip. other frames are handled
+ *       with the channel disabled, and no run at all if all channels skip.
+ */
+struct rkvpss_output_skip {
+	int dev_id;
+	unsigned char skip[RKVPSS_OUTPUT_MAX];
+} __attribute__ ((packed));
+
 #define RKVPSS_BUF_MAX 32
 
 /* struct rkvpss_buf_info
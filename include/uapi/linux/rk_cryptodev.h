@@ -45,6 +45,35 @@ struct crypt_auth_fd_op {
 	__u32   iv_len;
 };
 
+#define RK_CRYPT_BATCH_MAX	64
+
+/* one range of RIOCCRYPT_FD_BATCH */
+struct crypt_fd_batch_range {
+	int	src_fd;		/* source data */
+	int	dst_fd;		/* output data, may be src_fd */
+	__u32	src_offset;	/* offset of the data in src_fd */
+	__u32	dst_offset;	/* offset of the output in dst_fd */
+	__u32	len;		/* length of the data */
+	__s32	status;		/* out: 0 or the error of this range */
+	__u8	iv[16];		/* initialization vector, ivsize of the session */
+};
+
+/*
+ * input of RIOCCRYPT_FD_BATCH
+ *
+ * All ranges are queued to the engine before waiting, and the ioctl
+ * returns once every one of them has finished. It fails only if the batch
+ * itself is invalid, the outcome of each range is in its status.
+ */
+struct crypt_fd_batch_op {
+	__u32	ses;		/* session identifier, cipher sessions only */
+	__u16	op;		/* COP_ENCRYPT or COP_DECRYPT */
+	__u16	flags;		/* COP_FLAG_WRITE_IV returns the final ivs */
+	__u32	count;		/* number of ranges, up to RK_CRYPT_BATCH_MAX */
+	__u32	reserved;
+	__u64	ranges;		/* struct crypt_fd_batch_range[count] */
+};
+
 /* input of RIOCCRYPT_FD_MAP/RIOCCRYPT_FD_UNMAP */
 struct crypt_fd_map_op {
 	int	dma_fd;		/* session identifier */
@@ -74,6 +103,36 @@ struct crypt_rsa_op {
 	__u32		out_len;	/* length of output data */
 };
 
+#define RK_RSA_BATCH_MAX	32
+
+/* one operation of RIOCCRYPT_RSA_BATCH */
+struct crypt_rsa_batch_item {
+	__u16		op;		/* AOP_ENCRYPT/AOP_DECRYPT */
+	__u8		reserve[2];
+	__s32		status;		/* out: 0 or the error of this item */
+	__u64		in;		/* pointer to input data */
+	__u64		out;		/* pointer to output data */
+	__u32		in_len;		/* length of input data */
+	__u32		out_len;	/* size of out, then length of output data */
+};
+
+/*
+ * input of RIOCCRYPT_RSA_BATCH
+ *
+ * The key is decoded once and every item is queued to the engine before
+ * waiting. The ioctl fails only if the batch itself is invalid, the
+ * outcome of each item is in its status.
+ */
+struct crypt_rsa_batch_op {
+	__u16		flags;		/* see COP_FLAG_RSA_* */
+	__u8		reserve[2];
+	__u32		count;		/* number of items, up to RK_RSA_BATCH_MAX */
+	__u64		key;		/* BER coding RSA key */
+	__u32		key_len;	/* length of key data */
+	__u32		reserve2;
+	__u64		items;		/* struct crypt_rsa_batch_item[count] */
+};
+
 #define RIOCCRYPT_FD		_IOWR('r', 104, struct crypt_fd_op)
 #define RIOCCRYPT_FD_MAP	_IOWR('r', 105, struct crypt_fd_map_op)
 #define RIOCCRYPT_FD_UNMAP	_IOW('r',  106, struct crypt_fd_map_op)
@@ -81,5 +140,7 @@ struct crypt_rsa_op {
 #define RIOCCRYPT_DEV_ACCESS	_IOW('r',  108, struct crypt_fd_map_op)
 #define RIOCCRYPT_RSA_CRYPT	_IOWR('r', 109, struct crypt_rsa_op)
 #define RIOCAUTHCRYPT_FD	_IOWR('r', 110, struct crypt_auth_fd_op)
+#define RIOCCRYPT_FD_BATCH	_IOWR('r', 111, struct crypt_fd_batch_op)
+#define RIOCCRYPT_RSA_BATCH	_IOWR('r', 112, struct crypt_rsa_batch_op)
 
 #endif
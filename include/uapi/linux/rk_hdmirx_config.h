@@ -114,4 +114,34 @@ enum hdmirx_edid_mode {
 #define RK_HDMIRX_V4L2_EVENT_AUDIOINFO \
 	(V4L2_EVENT_PRIVATE_START + 2)
 
+/*
+ * Sent in low latency mode once the first lines lines of frame sequence
+ * are written to memory, struct rk_hdmirx_slice is in u.data.
+ * The last slice is not reported, the frame fence signals it.
+ */
+#define RK_HDMIRX_V4L2_EVENT_SLICE \
+	(V4L2_EVENT_PRIVATE_START + 3)
+
+struct rk_hdmirx_slice {
+	__u32 sequence;
+	__u32 lines;
+} __attribute__ ((packed));
+
+/*
+ * Sent with the fast_switch module parameter when the input mode changed
+ * and the stream kept running, frames from sequence on are in the new
+ * format, struct rk_hdmirx_fmt_change is in u.data.
+ */
+#define RK_HDMIRX_V4L2_EVENT_FMT_CHANGE \
+	(V4L2_EVENT_PRIVATE_START + 4)
+
+struct rk_hdmirx_fmt_change {
+	__u32 sequence;
+	__u32 width;
+	__u32 height;
+	__u32 pixelformat;
+	__u32 bytesperline;
+	__u32 sizeimage;
+} __attribute__ ((packed));
+
 #endif /* _UAPI_RK_HDMIRX_CONFIG_H */
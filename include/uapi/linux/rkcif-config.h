@@ -19,6 +19,7 @@
 
 #define V4L2_EVENT_RESET_DEV		0X1001
 #define V4L2_EVENT_EXPOSURE		0X1002
+#define V4L2_EVENT_LINE_WATERMARK	0X1003
 
 #define RKCIF_CMD_GET_CSI_MEMORY_MODE \
 	_IOR('V', BASE_VIDIOC_PRIVATE + 0, int)
@@ -77,6 +78,27 @@
 #define RKCIF_CMD_GET_CONNECT_ID \
 	_IOWR('V', BASE_VIDIOC_PRIVATE + 19, int)
 
+#define RKCIF_CMD_SET_LINE_WATERMARK \
+	_IOW('V', BASE_VIDIOC_PRIVATE + 20, unsigned int)
+
+#define RKCIF_CMD_SET_START_GROUP \
+	_IOW('V', BASE_VIDIOC_PRIVATE + 21, struct rkcif_start_group)
+
+/* struct rkcif_line_event
+ * payload of V4L2_EVENT_LINE_WATERMARK, queued on the capture video node
+ * once the frame has reached the line set by RKCIF_CMD_SET_LINE_WATERMARK,
+ * the lines above are in memory while the rest comes in.
+ *
+ * sequence: sequence of the frame, same as its buffer.
+ * line: line reached.
+ * timestamp: time of the line, same clock as the buffer timestamp.
+ */
+struct rkcif_line_event {
+	__u32 sequence;
+	__u32 line;
+	__u64 timestamp;
+} __attribute__ ((packed));
+
 /* cif memory mode
  * 0: raw12/raw10/raw8 8bit memory compact
  * 1: raw12/raw10 16bit memory one pixel
@@ -120,6 +142,21 @@ struct rkcif_csi_info {
 	int dphy_vendor[RKCIF_MAX_CSI_NUM];
 };
 
+/* struct rkcif_start_group
+ * joins the capture video node to a start group, set before stream on.
+ * STREAMON of a member arms its capture and returns without starting the
+ * sensor, once stream_num members are on, the sensor and phy bring-up of
+ * all of them runs in parallel, so a camera array comes up in the time of
+ * its slowest sensor and the first frames are close together.
+ *
+ * group: 0 ~ 3, or -1 to leave the group.
+ * stream_num: video nodes in the group.
+ */
+struct rkcif_start_group {
+	__s32 group;
+	__u32 stream_num;
+};
+
 struct rkcif_quick_stream_param {
 	int on;
 	__u32 frame_num;
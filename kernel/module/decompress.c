@@ -11,6 +11,7 @@
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <linux/vmalloc.h>
+#include <asm/unaligned.h>
 
 #include "internal.h"
 
@@ -52,6 +53,10 @@ static struct page *module_get_next_page(struct load_info *info)
 
 #ifdef CONFIG_MODULE_COMPRESS_GZIP
 #include <linux/zlib.h>
+#ifdef CONFIG_ROCKCHIP_HW_DECOMPRESS
+#include <linux/soc/rockchip/rockchip_decompress.h>
+#include <soc/rockchip/rockchip_decompress_job.h>
+#endif
 #define MODULE_COMPRESSION	gzip
 #define MODULE_DECOMPRESS_FN	module_gzip_decompress
 
@@ -82,6 +87,61 @@ static size_t module_gzip_header_len(const u8 *buf, size_t size)
 	return len;
 }
 
+#ifdef CONFIG_ROCKCHIP_HW_DECOMPRESS
+/*
+ * Inflate with the Rockchip decompressor. The gzip trailer carries the
+ * decompressed size, so all pages are allocated up front and the engine
+ * writes the whole module in one go while this task sleeps.
+ */
+static ssize_t module_gzip_hw_decompress(struct load_info *info,
+					 const void *buf, size_t size)
+{
+	unsigned int i, n_pages;
+	ssize_t retval;
+	size_t isize;
+	void *dst;
+
+	if (size < 18)
+		return -EINVAL;
+
+	/* a bogus trailer must not make us allocate gigabytes */
+	isize = get_unaligned_le32(buf + size - 4);
+	if (!isize || isize / 64 > size)
+		return -EINVAL;
+
+	n_pages = DIV_ROUND_UP(isize, PAGE_SIZE);
+	for (i = 0; i < n_pages; i++) {
+		struct page *page = module_get_next_page(info);
+
+		if (IS_ERR(page)) {
+			retval = PTR_ERR(page);
+			goto out;
+		}
+	}
+
+	dst = vmap(info->pages, n_pages, VM_MAP, PAGE_KERNEL);
+	if (!dst) {
+		retval = -ENOMEM;
+		goto out;
+	}
+
+	retval = rk_decom_buf(GZIP_MOD, buf, size, dst, isize);
+	vunmap(dst);
+
+	if (retval >= 0 && retval != isize)
+		retval = -EINVAL;
+
+out:
+	if (retval < 0) {
+		for (i = 0; i < info->used_pages; i++)
+			__free_page(info->pages[i]);
+		info->used_pages = 0;
+	}
+
+	return retval;
+}
+#endif
+
 static ssize_t module_gzip_decompress(struct load_info *info,
 				      const void *buf, size_t size)
 {
@@ -97,6 +157,14 @@ static ssize_t module_gzip_decompress(struct load_info *info,
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_ROCKCHIP_HW_DECOMPRESS
+	retval = module_gzip_hw_decompress(info, buf, size);
+	if (retval >= 0)
+		return retval;
+	if (retval != -ENODEV)
+		pr_debug("hardware decompression failed %zd, falling back\n", retval);
+#endif
+
 	s.next_in = buf + gzip_hdr_len;
 	s.avail_in = size - gzip_hdr_len;
 
@@ -19,6 +19,13 @@
 
 #include "rockchip_dlp.h"
 
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+#include <asm/neon.h>
+#include <asm/simd.h>
+#include "rockchip_dlp_neon.h"
+#define DLP_NEON
+#endif
+
 #define PBUF_CNT			2
 
 /* MUST: dlp_text should be match to enum dlp_mode */
@@ -261,26 +268,64 @@ static int dlp_get_offset_size(struct dlp_runtime_data *drd,
 	return ret;
 }
 
-static int dlp_mix_frame_buffer(struct dlp_runtime_data *drd, void *buf)
+#ifdef DLP_NEON
+static bool dlp_mix_frames_neon(struct dlp_runtime_data *drd, char *dst,
+				int dst_stride, const char *src, int frames)
 {
 	int sample_bytes = dlp_channels_to_bytes(drd, 1);
-	int16_t *p16 = (int16_t *)buf, v16 = 0;
-	int32_t *p32 = (int32_t *)buf, v32 = 0;
-	int i = 0;
-
-	switch (sample_bytes) {
-	case 2:
-		for (i = 0; i < drd->channels; i++)
-			v16 += (p16[i] / drd->channels);
-		p16[0] = v16;
-		break;
-	case 4:
-		for (i = 0; i < drd->channels; i++)
-			v32 += (p32[i] / drd->channels);
-		p32[0] = v32;
-		break;
-	default:
-		return -EINVAL;
+
+	if (!may_use_simd())
+		return false;
+
+	if (sample_bytes == 2 && !(drd->channels % 8)) {
+		kernel_neon_begin();
+		dlp_mix_s16_neon(dst, dst_stride, src, drd->frame_bytes,
+				 drd->channels, frames);
+		kernel_neon_end();
+		return true;
+	}
+
+	if (sample_bytes == 4 && !(drd->channels % 4)) {
+		kernel_neon_begin();
+		dlp_mix_s32_neon(dst, dst_stride, src, drd->frame_bytes,
+				 drd->channels, frames);
+		kernel_neon_end();
+		return true;
+	}
+
+	return false;
+}
+#endif
+
+/* mix all the channels of @frames frames of @drd into one sample of @dst */
+static int dlp_mix_frames(struct dlp_runtime_data *drd, char *dst,
+			  int dst_stride, const char *src, int frames)
+{
+	int sample_bytes = dlp_channels_to_bytes(drd, 1);
+	int i, f;
+	s64 v;
+
+#ifdef DLP_NEON
+	if (dlp_mix_frames_neon(drd, dst, dst_stride, src, frames))
+		return 0;
+#endif
+
+	for (f = 0; f < frames; f++, dst += dst_stride, src += drd->frame_bytes) {
+		v = 0;
+		switch (sample_bytes) {
+		case 2:
+			for (i = 0; i < drd->channels; i++)
+				v += ((const int16_t *)src)[i];
+			*(int16_t *)dst = div_s64(v, drd->channels);
+			break;
+		case 4:
+			for (i = 0; i < drd->channels; i++)
+				v += ((const int32_t *)src)[i];
+			*(int32_t *)dst = div_s64(v, drd->channels);
+			break;
+		default:
+			return -EINVAL;
+		}
 	}
 
 	return 0;
@@ -422,6 +467,14 @@ static void drd_rdy_list_free(struct dlp *dlp)
 	}
 }
 
+/* called with dlp->lock held whenever drd_ref_list changes */
+static inline void drd_ref_list_update(struct dlp *dlp)
+{
+	WRITE_ONCE(dlp->drd_ref_first,
+		   list_first_entry_or_null(&dlp->drd_ref_list,
+					    struct dlp_runtime_data, node));
+}
+
 static void drd_ref_list_add(struct dlp *dlp, struct dlp_runtime_data *drd)
 {
 	unsigned long flags;
@@ -429,20 +482,17 @@ static void drd_ref_list_add(struct dlp *dlp, struct dlp_runtime_data *drd)
 	/* push valid playback into ref list */
 	spin_lock_irqsave(&dlp->lock, flags);
 	list_add_tail(&drd->node, &dlp->drd_ref_list);
+	drd_ref_list_update(dlp);
 	spin_unlock_irqrestore(&dlp->lock, flags);
 }
 
+/*
+ * The drds are part of struct dlp, so the first one can be peeked without
+ * the lock, the caller takes its reference with drd_get() as before.
+ */
 static struct dlp_runtime_data *drd_ref_list_first(struct dlp *dlp)
 {
-	struct dlp_runtime_data *drd = NULL;
-	unsigned long flags;
-
-	spin_lock_irqsave(&dlp->lock, flags);
-	if (!list_empty(&dlp->drd_ref_list))
-		drd = list_first_entry(&dlp->drd_ref_list, struct dlp_runtime_data, node);
-	spin_unlock_irqrestore(&dlp->lock, flags);
-
-	return drd;
+	return READ_ONCE(dlp->drd_ref_first);
 }
 
 static struct dlp_runtime_data *drd_ref_list_del(struct dlp *dlp,
@@ -452,6 +502,7 @@ static struct dlp_runtime_data *drd_ref_list_del(struct dlp *dlp,
 
 	spin_lock_irqsave(&dlp->lock, flags);
 	list_del(&drd->node);
+	drd_ref_list_update(dlp);
 	spin_unlock_irqrestore(&dlp->lock, flags);
 
 	return drd;
@@ -465,6 +516,7 @@ static void drd_ref_list_free(struct dlp *dlp)
 
 	spin_lock_irqsave(&dlp->lock, flags);
 	list_replace_init(&dlp->drd_ref_list, &drd_list);
+	drd_ref_list_update(dlp);
 	spin_unlock_irqrestore(&dlp->lock, flags);
 
 	while (!list_empty(&drd_list)) {
@@ -680,10 +732,10 @@ static int process_capture(struct snd_soc_component *component,
 	struct dlp_runtime_data *drd_ref = NULL;
 	snd_pcm_sframes_t frames = 0;
 	snd_pcm_sframes_t frames_consumed = 0, frames_residue = 0, frames_tmp = 0;
-	snd_pcm_sframes_t ofs = 0;
+	snd_pcm_sframes_t ofs = 0, run;
 	snd_pcm_uframes_t appl_ptr;
 	int ofs_cap, ofs_play, size_cap, size_play;
-	int i = 0, j = 0, ret = 0;
+	int i = 0, j = 0, k, ret = 0;
 	bool free_ref = false, mix = false;
 	char *cbuf = NULL, *pbuf = NULL;
 	void *dma_ptr;
@@ -778,12 +830,19 @@ static int process_capture(struct snd_soc_component *component,
 	dev_dbg(dlp->dev, "applptr: %8lu, ofs: %8ld, frames: %5ld, refc: %u\n",
 		appl_ptr, ofs, frames, kref_read(&drd_ref->refcount));
 
-	for (i = 0; i < frames; i++, j++) {
+	/* in runs of frames up to the wrap of the ref buffer */
+	for (i = 0; i < frames; i += run, j += run) {
+		run = min_t(snd_pcm_sframes_t, frames - i,
+			    drd_ref->buf_sz - (i + ofs) % drd_ref->buf_sz);
 		cbuf = drd->buf + dlp_frames_to_bytes(drd, j + frames_consumed) + ofs_cap;
 		pbuf = drd_ref->buf + dlp_frames_to_bytes(drd_ref, ((i + ofs) % drd_ref->buf_sz)) + ofs_play;
-		if (mix)
-			dlp_mix_frame_buffer(drd_ref, pbuf);
-		memcpy(cbuf, pbuf, size_cap);
+		if (mix) {
+			dlp_mix_frames(drd_ref, cbuf, drd->frame_bytes, pbuf, run);
+			continue;
+		}
+		for (k = 0; k < run; k++)
+			memcpy(cbuf + dlp_frames_to_bytes(drd, k),
+			       pbuf + dlp_frames_to_bytes(drd_ref, k), size_cap);
 	}
 
 	appl_ptr += frames;
@@ -60,6 +60,8 @@ struct dlp {
 	struct list_head drd_avl_list;
 	struct list_head drd_rdy_list;
 	struct list_head drd_ref_list;
+	/* first of drd_ref_list, read without the lock on every period */
+	struct dlp_runtime_data *drd_ref_first;
 	struct dlp_runtime_data drds[DLP_MAX_DRDS];
 	struct dlp_runtime_data *drd_pb_shadow;
 	struct snd_soc_component component;
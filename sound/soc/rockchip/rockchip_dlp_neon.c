@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Rockchip DLP (Digital Loopback) NEON mixing
+ *
+ * Copyright (c) 2024 Rockchip Electronics Co. Ltd.
+ *
+ * Built with the NEON flags of lib/raid6, only <arm_neon.h> may be used.
+ */
+
+#include <arm_neon.h>
+#include "rockchip_dlp_neon.h"
+
+void dlp_mix_s16_neon(void *dst, int dst_stride, const void *src,
+		      int src_stride, int channels, int frames)
+{
+	const char *s = src;
+	char *d = dst;
+	int32x4_t acc;
+	int f, c;
+
+	for (f = 0; f < frames; f++, s += src_stride, d += dst_stride) {
+		acc = vdupq_n_s32(0);
+		for (c = 0; c < channels; c += 8)
+			acc = vpadalq_s16(acc, vld1q_s16((const int16_t *)s + c));
+		*(int16_t *)d = vaddvq_s32(acc) / channels;
+	}
+}
+
+void dlp_mix_s32_neon(void *dst, int dst_stride, const void *src,
+		      int src_stride, int channels, int frames)
+{
+	const char *s = src;
+	char *d = dst;
+	int64x2_t acc;
+	int f, c;
+
+	for (f = 0; f < frames; f++, s += src_stride, d += dst_stride) {
+		acc = vdupq_n_s64(0);
+		for (c = 0; c < channels; c += 4)
+			acc = vpadalq_s32(acc, vld1q_s32((const int32_t *)s + c));
+		*(int32_t *)d = vaddvq_s64(acc) / channels;
+	}
+}
@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Rockchip DLP (Digital Loopback) NEON mixing
+ *
+ * Copyright (c) 2024 Rockchip Electronics Co. Ltd.
+ *
+ */
+
+#ifndef _ROCKCHIP_DLP_NEON_H
+#define _ROCKCHIP_DLP_NEON_H
+
+/*
+ * Mix each frame of @src down to one sample of @dst, the strides are in
+ * bytes. s16 needs channels in multiples of 8, s32 in multiples of 4.
+ * Must be called between kernel_neon_begin() and kernel_neon_end().
+ */
+void dlp_mix_s16_neon(void *dst, int dst_stride, const void *src,
+		      int src_stride, int channels, int frames);
+void dlp_mix_s32_neon(void *dst, int dst_stride, const void *src,
+		      int src_stride, int channels, int frames);
+
+#endif
@@ -138,6 +138,8 @@ struct rk_i2s_tdm_dev {
 	bool tdm_fsync_half_frame;
 	bool is_dma_active[SNDRV_PCM_STREAM_LAST + 1];
 	bool dma_guard_initialized;
+	bool low_latency;
+	struct rockchip_clk_track clk_track;
 	unsigned int mclk_rx_freq;
 	unsigned int mclk_tx_freq;
 	unsigned int mclk_root0_freq;
@@ -1817,9 +1819,12 @@ static int rockchip_i2s_tdm_hw_params(struct snd_pcm_substream *substream,
 	dma_data = snd_soc_dai_get_dma_data(dai, substream);
 	dma_data->maxburst = MAXBURST_PER_FIFO * params_channels(params) / 2;
 
-	if (i2s_tdm->mclk_calibrate)
+	if (i2s_tdm->mclk_calibrate) {
 		rockchip_i2s_tdm_calibrate_mclk(i2s_tdm, substream,
 						params_rate(params));
+		rockchip_utils_clk_track_start(&i2s_tdm->clk_track, substream,
+					       i2s_tdm->clk_ppm);
+	}
 
 	ret = rockchip_i2s_tdm_set_mclk(i2s_tdm, substream, &mclk);
 	if (ret)
@@ -1875,6 +1880,9 @@ static int rockchip_i2s_tdm_hw_params(struct snd_pcm_substream *substream,
 static int rockchip_i2s_tdm_hw_free(struct snd_pcm_substream *substream,
 				    struct snd_soc_dai *dai)
 {
+	struct rk_i2s_tdm_dev *i2s_tdm = to_info(dai);
+
+	rockchip_utils_clk_track_stop(&i2s_tdm->clk_track, substream);
 	rockchip_utils_put_performance(substream, dai);
 
 	return 0;
@@ -1948,20 +1956,10 @@ static int rockchip_i2s_tdm_clk_compensation_get(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
-static int rockchip_i2s_tdm_clk_compensation_put(struct snd_kcontrol *kcontrol,
-						 struct snd_ctl_elem_value *ucontrol)
+static int rockchip_i2s_tdm_set_clk_ppm(struct rk_i2s_tdm_dev *i2s_tdm, int ppm)
 {
-	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
-	struct rk_i2s_tdm_dev *i2s_tdm = snd_soc_component_get_drvdata(component);
-	int ret = 0, ppm = 0;
-	int changed = 0;
 	unsigned long old_rate;
-
-	if (ucontrol->value.integer.value[0] < CLK_PPM_MIN ||
-	    ucontrol->value.integer.value[0] > CLK_PPM_MAX)
-		return -EINVAL;
-
-	ppm = ucontrol->value.integer.value[0];
+	int ret, changed = 0;
 
 	old_rate = clk_get_rate(i2s_tdm->mclk_root0);
 	ret = rockchip_i2s_tdm_clk_set_rate(i2s_tdm, i2s_tdm->mclk_root0,
@@ -1985,12 +1983,78 @@ static int rockchip_i2s_tdm_clk_compensation_put(struct snd_kcontrol *kcontrol,
 	return changed;
 }
 
-static struct snd_kcontrol_new rockchip_i2s_tdm_compensation_control = {
-	.iface = SNDRV_CTL_ELEM_IFACE_PCM,
-	.name = "PCM Clk Compensation In PPM",
-	.info = rockchip_i2s_tdm_clk_compensation_info,
-	.get = rockchip_i2s_tdm_clk_compensation_get,
-	.put = rockchip_i2s_tdm_clk_compensation_put,
+static int rockchip_i2s_tdm_clk_track_set_ppm(void *priv, int ppm)
+{
+	int ret = rockchip_i2s_tdm_set_clk_ppm(priv, ppm);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int rockchip_i2s_tdm_clk_compensation_put(struct snd_kcontrol *kcontrol,
+						 struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct rk_i2s_tdm_dev *i2s_tdm = snd_soc_component_get_drvdata(component);
+
+	if (ucontrol->value.integer.value[0] < CLK_PPM_MIN ||
+	    ucontrol->value.integer.value[0] > CLK_PPM_MAX)
+		return -EINVAL;
+
+	return rockchip_i2s_tdm_set_clk_ppm(i2s_tdm, ucontrol->value.integer.value[0]);
+}
+
+static const char *const clk_track_text[] = {
+	"Off",
+	"Playback",
+	"Capture",
+};
+
+static SOC_ENUM_SINGLE_EXT_DECL(clk_track_enum, clk_track_text);
+
+static int rockchip_i2s_tdm_clk_track_get(struct snd_kcontrol *kcontrol,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct rk_i2s_tdm_dev *i2s_tdm = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.enumerated.item[0] = i2s_tdm->clk_track.stream + 1;
+
+	return 0;
+}
+
+static int rockchip_i2s_tdm_clk_track_put(struct snd_kcontrol *kcontrol,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct rk_i2s_tdm_dev *i2s_tdm = snd_soc_component_get_drvdata(component);
+	struct rockchip_clk_track *track = &i2s_tdm->clk_track;
+	int stream = ucontrol->value.enumerated.item[0];
+
+	if (stream >= ARRAY_SIZE(clk_track_text))
+		return -EINVAL;
+
+	stream -= 1;
+	if (stream == track->stream)
+		return 0;
+
+	/* takes effect from the next hw_params of that stream */
+	rockchip_utils_clk_track_stop(track, track->substream);
+	track->stream = stream;
+
+	return 1;
+}
+
+static struct snd_kcontrol_new rockchip_i2s_tdm_compensation_controls[] = {
+	{
+		.iface = SNDRV_CTL_ELEM_IFACE_PCM,
+		.name = "PCM Clk Compensation In PPM",
+		.info = rockchip_i2s_tdm_clk_compensation_info,
+		.get = rockchip_i2s_tdm_clk_compensation_get,
+		.put = rockchip_i2s_tdm_clk_compensation_put,
+	},
+	SOC_ENUM_EXT("PCM Clk Compensation Track", clk_track_enum,
+		     rockchip_i2s_tdm_clk_track_get,
+		     rockchip_i2s_tdm_clk_track_put),
 };
 
 /* loopback mode select */
@@ -2197,8 +2261,8 @@ static int rockchip_i2s_tdm_dai_probe(struct snd_soc_dai *dai)
 
 	if (i2s_tdm->mclk_calibrate)
 		snd_soc_add_component_controls(dai->component,
-					       &rockchip_i2s_tdm_compensation_control,
-					       1);
+					       rockchip_i2s_tdm_compensation_controls,
+					       ARRAY_SIZE(rockchip_i2s_tdm_compensation_controls));
 
 	return 0;
 }
@@ -2255,11 +2319,34 @@ static int rockchip_i2s_tdm_startup(struct snd_pcm_substream *substream,
 	if (i2s_tdm->wait_time[stream])
 		substream->wait_time = msecs_to_jiffies(i2s_tdm->wait_time[stream]);
 
+	/*
+	 * Tiny periods without a DMA interrupt each: the position comes
+	 * from the DMA residue plus the FIFO level, and underrun/overrun
+	 * are still caught by the FIFO xrun irq.
+	 */
+	if (i2s_tdm->low_latency)
+		substream->runtime->hw.info |= SNDRV_PCM_INFO_NO_PERIOD_WAKEUP;
+
 	i2s_tdm->substreams[stream] = substream;
 
 	return 0;
 }
 
+static int rockchip_i2s_tdm_get_fifo_count(struct device *dev,
+					   struct snd_pcm_substream *substream);
+
+static snd_pcm_sframes_t rockchip_i2s_tdm_delay(struct snd_pcm_substream *substream,
+						struct snd_soc_dai *dai)
+{
+	struct rk_i2s_tdm_dev *i2s_tdm = snd_soc_dai_get_drvdata(dai);
+
+	if (!i2s_tdm->low_latency)
+		return 0;
+
+	return rockchip_i2s_tdm_get_fifo_count(i2s_tdm->dev, substream) /
+	       substream->runtime->channels;
+}
+
 static void rockchip_i2s_tdm_shutdown(struct snd_pcm_substream *substream,
 				      struct snd_soc_dai *dai)
 {
@@ -2278,6 +2365,7 @@ static const struct snd_soc_dai_ops rockchip_i2s_tdm_dai_ops = {
 	.set_fmt = rockchip_i2s_tdm_set_fmt,
 	.set_tdm_slot = rockchip_dai_tdm_slot,
 	.trigger = rockchip_i2s_tdm_trigger,
+	.delay = rockchip_i2s_tdm_delay,
 };
 
 static const struct snd_soc_component_driver rockchip_i2s_tdm_component = {
@@ -2648,8 +2736,12 @@ static int rockchip_i2s_tdm_get_calibrate_mclks(struct rk_i2s_tdm_dev *i2s_tdm)
 	if (num_mclks < 4 && num_mclks != 0)
 		return -ENOENT;
 
-	if (num_mclks == 4)
+	if (num_mclks == 4) {
 		i2s_tdm->mclk_calibrate = 1;
+		rockchip_utils_clk_track_init(&i2s_tdm->clk_track,
+					      rockchip_i2s_tdm_clk_track_set_ppm,
+					      i2s_tdm);
+	}
 
 	return 0;
 }
@@ -2868,6 +2960,8 @@ static int rockchip_i2s_tdm_register_platform(struct device *dev)
 		return ret;
 	}
 
+	i2s_tdm->low_latency = device_property_read_bool(dev, "rockchip,low-latency");
+
 	ret = devm_snd_dmaengine_pcm_register(dev, NULL, 0);
 	if (ret)
 		dev_err(dev, "Could not register PCM\n");
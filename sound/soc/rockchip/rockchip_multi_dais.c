@@ -109,10 +109,17 @@ static int rockchip_mdais_hw_free(struct snd_pcm_substream *substream,
 	return 0;
 }
 
-static int rockchip_mdais_trigger(struct snd_pcm_substream *substream,
-				  int cmd, struct snd_soc_dai *dai)
+static bool mdais_dai_is_clk_consumer(struct rk_dai *rk_dai)
+{
+	if (!(rk_dai->fmt_msk & SND_SOC_DAIFMT_MASTER_MASK))
+		return false;
+
+	return (rk_dai->fmt & SND_SOC_DAIFMT_MASTER_MASK) == SND_SOC_DAIFMT_CBM_CFM;
+}
+
+static int mdais_trigger_dais(struct snd_pcm_substream *substream, int cmd,
+			      struct rk_mdais_dev *mdais, bool consumer)
 {
-	struct rk_mdais_dev *mdais = to_info(dai);
 	struct snd_soc_dai *child;
 	unsigned int *channel_maps;
 	int ret = 0, i = 0;
@@ -124,6 +131,9 @@ static int rockchip_mdais_trigger(struct snd_pcm_substream *substream,
 		if (!channel_maps[i])
 			continue;
 
+		if (mdais_dai_is_clk_consumer(&mdais->dais[i]) != consumer)
+			continue;
+
 		child = mdais->dais[i].dai;
 		if (child->driver->ops && child->driver->ops->trigger) {
 			ret = child->driver->ops->trigger(substream,
@@ -136,6 +146,34 @@ static int rockchip_mdais_trigger(struct snd_pcm_substream *substream,
 	return 0;
 }
 
+static int rockchip_mdais_trigger(struct snd_pcm_substream *substream,
+				  int cmd, struct snd_soc_dai *dai)
+{
+	struct rk_mdais_dev *mdais = to_info(dai);
+	int ret;
+
+	/*
+	 * DAIs clocked by a sibling's bclk/lrck are armed first and the
+	 * clock provider goes last, so all of them latch on the same first
+	 * frame and the channels stay sample aligned. Stop the other way
+	 * round so no consumer sees a partial frame.
+	 */
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		ret = mdais_trigger_dais(substream, cmd, mdais, true);
+		if (ret < 0)
+			return ret;
+		return mdais_trigger_dais(substream, cmd, mdais, false);
+	default:
+		ret = mdais_trigger_dais(substream, cmd, mdais, false);
+		if (ret < 0)
+			return ret;
+		return mdais_trigger_dais(substream, cmd, mdais, true);
+	}
+}
+
 static int rockchip_mdais_startup(struct snd_pcm_substream *substream,
 				  struct snd_soc_dai *dai)
 {
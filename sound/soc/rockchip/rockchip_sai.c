@@ -75,6 +75,8 @@ struct rk_sai_dev {
 	bool is_clk_auto;
 	bool is_mclk_calibrate;
 	bool is_tx_auto_gate; /* auto gate clk when TX FIFO empty */
+	bool low_latency;
+	struct rockchip_clk_track clk_track;
 };
 
 static const struct sai_of_quirks {
@@ -615,12 +617,19 @@ static int rockchip_sai_hw_params(struct snd_pcm_substream *substream,
 
 	rockchip_utils_get_performance(substream, params, dai, fifo);
 
+	if (sai->is_mclk_calibrate)
+		rockchip_utils_clk_track_start(&sai->clk_track, substream,
+					       sai->clk_ppm);
+
 	return 0;
 }
 
 static int rockchip_sai_hw_free(struct snd_pcm_substream *substream,
 				struct snd_soc_dai *dai)
 {
+	struct rk_sai_dev *sai = snd_soc_dai_get_drvdata(dai);
+
+	rockchip_utils_clk_track_stop(&sai->clk_track, substream);
 	rockchip_utils_put_performance(substream, dai);
 
 	return 0;
@@ -904,12 +913,63 @@ static int rockchip_sai_clk_compensation_put(struct snd_kcontrol *kcontrol,
 	return rockchip_sai_set_mclk_root_ppm(sai, ppm);
 }
 
-static struct snd_kcontrol_new rockchip_sai_compensation_control = {
-	.iface = SNDRV_CTL_ELEM_IFACE_PCM,
-	.name = "PCM Clk Compensation In PPM",
-	.info = rockchip_sai_clk_compensation_info,
-	.get = rockchip_sai_clk_compensation_get,
-	.put = rockchip_sai_clk_compensation_put,
+static int rockchip_sai_clk_track_set_ppm(void *priv, int ppm)
+{
+	return rockchip_sai_set_mclk_root_ppm(priv, ppm);
+}
+
+static const char *const clk_track_text[] = {
+	"Off",
+	"Playback",
+	"Capture",
+};
+
+static SOC_ENUM_SINGLE_EXT_DECL(clk_track_enum, clk_track_text);
+
+static int rockchip_sai_clk_track_get(struct snd_kcontrol *kcontrol,
+				      struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *compnt = snd_soc_kcontrol_component(kcontrol);
+	struct rk_sai_dev *sai = snd_soc_component_get_drvdata(compnt);
+
+	ucontrol->value.enumerated.item[0] = sai->clk_track.stream + 1;
+
+	return 0;
+}
+
+static int rockchip_sai_clk_track_put(struct snd_kcontrol *kcontrol,
+				      struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *compnt = snd_soc_kcontrol_component(kcontrol);
+	struct rk_sai_dev *sai = snd_soc_component_get_drvdata(compnt);
+	struct rockchip_clk_track *track = &sai->clk_track;
+	int stream = ucontrol->value.enumerated.item[0];
+
+	if (stream >= ARRAY_SIZE(clk_track_text))
+		return -EINVAL;
+
+	stream -= 1;
+	if (stream == track->stream)
+		return 0;
+
+	/* takes effect from the next hw_params of that stream */
+	rockchip_utils_clk_track_stop(track, track->substream);
+	track->stream = stream;
+
+	return 1;
+}
+
+static struct snd_kcontrol_new rockchip_sai_compensation_controls[] = {
+	{
+		.iface = SNDRV_CTL_ELEM_IFACE_PCM,
+		.name = "PCM Clk Compensation In PPM",
+		.info = rockchip_sai_clk_compensation_info,
+		.get = rockchip_sai_clk_compensation_get,
+		.put = rockchip_sai_clk_compensation_put,
+	},
+	SOC_ENUM_EXT("PCM Clk Compensation Track", clk_track_enum,
+		     rockchip_sai_clk_track_get,
+		     rockchip_sai_clk_track_put),
 };
 
 static int rockchip_sai_dai_probe(struct snd_soc_dai *dai)
@@ -922,8 +982,8 @@ static int rockchip_sai_dai_probe(struct snd_soc_dai *dai)
 
 	if (sai->is_mclk_calibrate)
 		snd_soc_add_component_controls(dai->component,
-					       &rockchip_sai_compensation_control,
-					       1);
+					       rockchip_sai_compensation_controls,
+					       ARRAY_SIZE(rockchip_sai_compensation_controls));
 
 	return 0;
 }
@@ -940,11 +1000,31 @@ static int rockchip_sai_startup(struct snd_pcm_substream *substream,
 	if (sai->wait_time[stream])
 		substream->wait_time = msecs_to_jiffies(sai->wait_time[stream]);
 
+	/* no period irq, see rockchip_sai_delay() for the position */
+	if (sai->low_latency)
+		substream->runtime->hw.info |= SNDRV_PCM_INFO_NO_PERIOD_WAKEUP;
+
 	sai->substreams[stream] = substream;
 
 	return 0;
 }
 
+static int rockchip_sai_get_fifo_count(struct device *dev,
+				       struct snd_pcm_substream *substream);
+
+static snd_pcm_sframes_t rockchip_sai_delay(struct snd_pcm_substream *substream,
+					    struct snd_soc_dai *dai)
+{
+	struct rk_sai_dev *sai = snd_soc_dai_get_drvdata(dai);
+
+	/* the DMA residue alone misses the frames still in the FIFO */
+	if (!sai->low_latency)
+		return 0;
+
+	return rockchip_sai_get_fifo_count(sai->dev, substream) /
+	       substream->runtime->channels;
+}
+
 static void rockchip_sai_shutdown(struct snd_pcm_substream *substream,
 				      struct snd_soc_dai *dai)
 {
@@ -981,6 +1061,7 @@ static const struct snd_soc_dai_ops rockchip_sai_dai_ops = {
 	.prepare = rockchip_sai_prepare,
 	.trigger = rockchip_sai_trigger,
 	.set_tdm_slot = rockchip_sai_set_tdm_slot,
+	.delay = rockchip_sai_delay,
 };
 
 static struct snd_soc_dai_driver rockchip_sai_dai = {
@@ -1871,6 +1952,8 @@ static int rockchip_sai_probe(struct platform_device *pdev)
 
 		sai->mclk_root_initial_rate = clk_get_rate(sai->mclk_root);
 		sai->mclk_root_rate = sai->mclk_root_initial_rate;
+		rockchip_utils_clk_track_init(&sai->clk_track,
+					      rockchip_sai_clk_track_set_ppm, sai);
 
 		dev_info(&pdev->dev, "Have mclk compensation feature\n");
 	}
@@ -1934,10 +2017,13 @@ static int rockchip_sai_probe(struct platform_device *pdev)
 		return 0;
 	}
 
-	if (device_property_read_bool(&pdev->dev, "rockchip,digital-loopback"))
+	if (device_property_read_bool(&pdev->dev, "rockchip,digital-loopback")) {
 		ret = devm_snd_dmaengine_dlp_register(&pdev->dev, &dconfig);
-	else
+	} else {
+		sai->low_latency = device_property_read_bool(&pdev->dev,
+							     "rockchip,low-latency");
 		ret = devm_snd_dmaengine_pcm_register(&pdev->dev, NULL, 0);
+	}
 
 	if (ret)
 		goto err_runtime_suspend;
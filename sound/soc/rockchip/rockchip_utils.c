@@ -16,6 +16,21 @@
 #define DMC_STALL_TIME_US_DEFAULT	100
 #define TIME_MARGIN_US			20
 
+#define CLK_TRACK_PPM_MAX		1000
+#define CLK_TRACK_WARMUP		16
+
+static unsigned int clk_track_period_ms = 100;
+module_param(clk_track_period_ms, uint, 0644);
+MODULE_PARM_DESC(clk_track_period_ms, "mclk tracking update period in ms");
+
+static unsigned int clk_track_kp = 20;
+module_param(clk_track_kp, uint, 0644);
+MODULE_PARM_DESC(clk_track_kp, "mclk tracking ppm per ms of fill error");
+
+static unsigned int clk_track_ki = 5;
+module_param(clk_track_ki, uint, 0644);
+MODULE_PARM_DESC(clk_track_ki, "mclk tracking ppm per ms*s of integrated fill error");
+
 static DEFINE_MUTEX(list_mutex);
 static LIST_HEAD(substream_ref_list);
 
@@ -147,4 +162,110 @@ void rockchip_utils_put_performance(struct snd_pcm_substream *substream,
 }
 EXPORT_SYMBOL_GPL(rockchip_utils_put_performance);
 
+/*
+ * A PI loop on the fill level of a bridged stream: the other end (hdmirx,
+ * a network clock, ...) feeds or drains the buffer at its own rate, so
+ * the fill drifts by the ppm difference between the two clocks. Lock the
+ * fill seen after the warm-up as the target and trim mclk until it holds.
+ */
+static void clk_track_work(struct work_struct *work)
+{
+	struct rockchip_clk_track *track =
+		container_of(to_delayed_work(work), struct rockchip_clk_track, work);
+	struct snd_pcm_substream *substream = track->substream;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	s64 fill, err_us, integ, ppm;
+	unsigned int rate;
+	bool running;
+
+	snd_pcm_stream_lock_irq(substream);
+	running = runtime->status->state == SNDRV_PCM_STATE_RUNNING;
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		fill = snd_pcm_playback_hw_avail(runtime);
+	else
+		fill = snd_pcm_capture_avail(runtime);
+	rate = runtime->rate;
+	snd_pcm_stream_unlock_irq(substream);
+
+	if (!running || !rate) {
+		track->samples = 0;
+		goto out;
+	}
+
+	/* average out the period granularity of the application */
+	fill <<= 8;
+	if (!track->samples)
+		track->avg = fill;
+	else
+		track->avg += (fill - track->avg) >> 3;
+
+	if (++track->samples <= CLK_TRACK_WARMUP) {
+		track->target = track->avg;
+		track->integ = 0;
+		goto out;
+	}
+
+	err_us = div_s64((track->avg - track->target) * USEC_PER_SEC,
+			 (s64)rate << 8);
+	/* playback filling up or capture draining: mclk is too slow */
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+		err_us = -err_us;
+
+	integ = track->integ + div_s64(err_us * clk_track_period_ms, MSEC_PER_SEC);
+	ppm = track->base_ppm +
+	      div_s64(err_us * clk_track_kp + integ * clk_track_ki, 1000);
+	if (ppm > CLK_TRACK_PPM_MAX || ppm < -CLK_TRACK_PPM_MAX)
+		ppm = clamp_t(s64, ppm, -CLK_TRACK_PPM_MAX, CLK_TRACK_PPM_MAX);
+	else
+		track->integ = integ; /* no windup while saturated */
+
+	if (ppm != track->ppm && !track->set_ppm(track->priv, ppm))
+		track->ppm = ppm;
+out:
+	schedule_delayed_work(&track->work, msecs_to_jiffies(clk_track_period_ms));
+}
+
+void rockchip_utils_clk_track_init(struct rockchip_clk_track *track,
+				   int (*set_ppm)(void *priv, int ppm),
+				   void *priv)
+{
+	track->set_ppm = set_ppm;
+	track->priv = priv;
+	track->stream = -1;
+	INIT_DELAYED_WORK(&track->work, clk_track_work);
+}
+EXPORT_SYMBOL_GPL(rockchip_utils_clk_track_init);
+
+void rockchip_utils_clk_track_start(struct rockchip_clk_track *track,
+				    struct snd_pcm_substream *substream,
+				    int cur_ppm)
+{
+	might_sleep();
+
+	if (track->stream != substream->stream)
+		return;
+
+	rockchip_utils_clk_track_stop(track, track->substream);
+
+	track->substream = substream;
+	track->base_ppm = cur_ppm;
+	track->ppm = cur_ppm;
+	track->samples = 0;
+	schedule_delayed_work(&track->work, msecs_to_jiffies(clk_track_period_ms));
+}
+EXPORT_SYMBOL_GPL(rockchip_utils_clk_track_start);
+
+void rockchip_utils_clk_track_stop(struct rockchip_clk_track *track,
+				   struct snd_pcm_substream *substream)
+{
+	might_sleep();
+
+	if (!substream || track->substream != substream)
+		return;
+
+	cancel_delayed_work_sync(&track->work);
+	track->substream = NULL;
+}
+EXPORT_SYMBOL_GPL(rockchip_utils_clk_track_stop);
+
 MODULE_LICENSE("GPL");
@@ -8,11 +8,44 @@
 #ifndef _ROCKCHIP_UTILS_H
 #define _ROCKCHIP_UTILS_H
 
+#include <linux/workqueue.h>
+
+/**
+ * struct rockchip_clk_track - mclk ppm loop locked to a stream fill level
+ * @set_ppm: apply an absolute mclk ppm, called from process context
+ * @priv: argument of @set_ppm
+ * @stream: direction to track, -1 for off
+ *
+ * The remaining fields are private to rockchip_utils.
+ */
+struct rockchip_clk_track {
+	int (*set_ppm)(void *priv, int ppm);
+	void *priv;
+	int stream;
+
+	struct delayed_work work;
+	struct snd_pcm_substream *substream;
+	unsigned int samples;
+	int base_ppm;
+	int ppm;
+	s64 avg;
+	s64 target;
+	s64 integ;
+};
+
 void rockchip_utils_get_performance(struct snd_pcm_substream *substream,
 				    struct snd_pcm_hw_params *params,
 				    struct snd_soc_dai *dai,
 				    int fifo_word);
 void rockchip_utils_put_performance(struct snd_pcm_substream *substream,
 				    struct snd_soc_dai *dai);
+void rockchip_utils_clk_track_init(struct rockchip_clk_track *track,
+				   int (*set_ppm)(void *priv, int ppm),
+				   void *priv);
+void rockchip_utils_clk_track_start(struct rockchip_clk_track *track,
+				    struct snd_pcm_substream *substream,
+				    int cur_ppm);
+void rockchip_utils_clk_track_stop(struct rockchip_clk_track *track,
+				   struct snd_pcm_substream *substream);
 
 #endif /* _ROCKCHIP_UTILS_H */
@@ -10,7 +10,10 @@
 #include <linux/uaccess.h>
 #include <linux/clk.h>
 #include <linux/interrupt.h>
+#include <linux/fs.h>
 #include <linux/io.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/of_device.h>
 #include <linux/of_address.h>
 #include <linux/pm_runtime.h>
@@ -18,6 +21,7 @@
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
 #include <sound/soc.h>
+#include <uapi/linux/rk-vad.h>
 
 #include "rockchip_vad.h"
 #include "rockchip_multi_dais.h"
@@ -83,10 +87,13 @@ struct rockchip_vad {
 	u32 audio_src;
 	u32 audio_src_addr;
 	u32 audio_chnl;
+	u32 det_chnl_mask;
 	u32 channels;
 	u32 sample_bytes;
+	snd_pcm_format_t format;
 	u32 buffer_time; /* msec */
 	struct dentry *debugfs_dir;
+	struct miscdevice miscdev;
 	void *buf;
 	bool acodec_cfg;
 	bool vswitch;
@@ -378,30 +385,64 @@ snd_pcm_sframes_t snd_pcm_vad_read(struct snd_pcm_substream *substream,
 }
 EXPORT_SYMBOL(snd_pcm_vad_read);
 
+/*
+ * Reduce one sample to the 16bit the preprocess runs on, the same way the
+ * vad takes it: the high 16bit, or 24bit saturated to 16bit.
+ */
+static inline s16 vad_sample_s16(struct rockchip_vad *vad, const void *p)
+{
+	s32 val;
+
+	switch (vad->format) {
+	case SNDRV_PCM_FORMAT_S16_LE:
+		return *(const s16 *)p;
+	case SNDRV_PCM_FORMAT_S24_LE:
+		val = sign_extend32(*(const u32 *)p, 23);
+		break;
+	default:
+		val = *(const s32 *)p >> 8;
+		break;
+	}
+
+	if (vad->h_16bit)
+		return val >> 8;
+
+	return clamp_t(s32, val, S16_MIN, S16_MAX);
+}
+
 int snd_pcm_vad_preprocess(struct snd_pcm_substream *substream,
 			   void *buf, snd_pcm_uframes_t size)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct rockchip_vad *vad = NULL;
-	unsigned int i;
-	s16 *data;
+	unsigned long mask;
+	unsigned int i, ch, frame_sz, sample_sz;
+	s16 data, val;
 
 	vad = substream_get_drvdata(substream);
 
 	if (!vad)
 		return 0;
 
-	buf += samples_to_bytes(runtime, vad->audio_chnl);
-	/* retrieve the high 16bit data */
-	if (runtime->sample_bits == 32 && vad->h_16bit)
-		buf += 2;
+	mask = vad->det_chnl_mask & GENMASK(runtime->channels - 1, 0);
+	if (!mask)
+		mask = BIT(vad->audio_chnl);
+	frame_sz = frames_to_bytes(runtime, 1);
+	sample_sz = samples_to_bytes(runtime, 1);
+
 	for (i = 0; i < size; i++) {
-		data = buf;
-		if (vad_preprocess(*data))
+		/* the loudest of the detect channels drives the decision */
+		data = 0;
+		for_each_set_bit(ch, &mask, runtime->channels) {
+			val = vad_sample_s16(vad, buf + ch * sample_sz);
+			if (abs(val) > abs(data))
+				data = val;
+		}
+		if (vad_preprocess(data))
 			voice_inactive_frames = 0;
 		else
 			voice_inactive_frames++;
-		buf += frames_to_bytes(runtime, 1);
+		buf += frame_sz;
 	}
 
 	vad_preprocess_update_params(&vad->uparams);
@@ -782,6 +823,7 @@ static int rockchip_vad_hw_params(struct snd_pcm_substream *substream,
 
 	rockchip_vad_params_fixup(substream, params, dai);
 	vad->channels = params_channels(params);
+	vad->format = params_format(params);
 	switch (params_format(params)) {
 	case SNDRV_PCM_FORMAT_S16_LE:
 		val = AUDIO_CHNL_16B;
@@ -1116,6 +1158,82 @@ static const struct file_operations rockchip_vad_reg_debugfs_fops = {
 };
 #endif
 
+static long rockchip_vad_misc_ioctl(struct file *file, unsigned int cmd,
+				    unsigned long arg)
+{
+	struct rockchip_vad *vad = container_of(file->private_data,
+						struct rockchip_vad, miscdev);
+	struct vad_buf *vbuf = &vad->vbuf;
+	void __user *argp = (void __user *)arg;
+	struct rk_vad_buf_info info;
+	u32 bytes, frame_sz;
+
+	switch (cmd) {
+	case RK_VAD_GET_BUF_INFO:
+		/* the rk1808es stores the ring rotated per chunk */
+		if (vbuf->size > 0 && vad_buffer_sort(vad) < 0)
+			return -EIO;
+
+		memset(&info, 0, sizeof(info));
+		info.map_size = vad->memphy_end - vad->memphy + 0x8;
+		if (vbuf->size > 0) {
+			info.pos = vbuf->pos - vbuf->begin;
+			info.end = vbuf->end - vbuf->begin;
+			info.size = vbuf->size;
+			info.loop = vbuf->loop;
+		}
+		info.channels = vad->channels;
+		info.sample_bytes = vad->sample_bytes;
+		if (copy_to_user(argp, &info, sizeof(info)))
+			return -EFAULT;
+		return 0;
+	case RK_VAD_CONSUME:
+		if (get_user(bytes, (u32 __user *)argp))
+			return -EFAULT;
+		if (vbuf->size <= 0)
+			return 0;
+
+		frame_sz = vad->channels * vad->sample_bytes;
+		bytes = min_t(u32, rounddown(bytes, frame_sz), vbuf->size);
+		vbuf->pos += bytes;
+		if (vbuf->pos >= vbuf->end)
+			vbuf->pos = vbuf->begin + (vbuf->pos - vbuf->end);
+		vbuf->size -= bytes;
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int rockchip_vad_misc_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct rockchip_vad *vad = container_of(file->private_data,
+						struct rockchip_vad, miscdev);
+	size_t size = vma->vm_end - vma->vm_start;
+	size_t map_size = vad->memphy_end - vad->memphy + 0x8;
+
+	if (!PAGE_ALIGNED(vad->memphy))
+		return -ENXIO;
+	if (vma->vm_pgoff || size > PAGE_ALIGN(map_size))
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+
+	return remap_pfn_range(vma, vma->vm_start, PHYS_PFN(vad->memphy), size,
+			       vma->vm_page_prot);
+}
+
+static const struct file_operations rockchip_vad_misc_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = rockchip_vad_misc_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap = rockchip_vad_misc_mmap,
+};
+
 static void rockchip_vad_init(struct rockchip_vad *vad)
 {
 	unsigned int val, mask;
@@ -1194,6 +1312,7 @@ static int rockchip_vad_probe(struct platform_device *pdev)
 	vad->acodec_cfg = of_property_read_bool(np, "rockchip,acodec-cfg");
 	of_property_read_u32(np, "rockchip,mode", &vad->mode);
 	of_property_read_u32(np, "rockchip,det-channel", &vad->audio_chnl);
+	of_property_read_u32(np, "rockchip,det-channel-mask", &vad->det_chnl_mask);
 	of_property_read_u32(np, "rockchip,buffer-time-ms", &vad->buffer_time);
 
 	res = platform_get_resource_byname(pdev, IORESOURCE_MEM, "vad");
@@ -1284,6 +1403,15 @@ static int rockchip_vad_probe(struct platform_device *pdev)
 	if (ret)
 		goto err;
 
+	vad->miscdev.minor = MISC_DYNAMIC_MINOR;
+	vad->miscdev.name = "vad";
+	vad->miscdev.fops = &rockchip_vad_misc_fops;
+	vad->miscdev.parent = &pdev->dev;
+	if (misc_register(&vad->miscdev)) {
+		dev_warn(&pdev->dev, "failed to register vad misc device\n");
+		vad->miscdev.fops = NULL;
+	}
+
 	of_node_put(sram_np);
 
 	return 0;
@@ -1302,6 +1430,8 @@ static int rockchip_vad_remove(struct platform_device *pdev)
 	if (!IS_ERR(vad->hclk))
 		clk_disable_unprepare(vad->hclk);
 	of_node_put(vad->audio_node);
+	if (vad->miscdev.fops)
+		misc_deregister(&vad->miscdev);
 	snd_soc_unregister_component(&pdev->dev);
 	return 0;
 }